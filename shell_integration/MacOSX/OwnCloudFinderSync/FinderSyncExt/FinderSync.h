@@ -23,6 +23,9 @@
     NSString *_shareMenuTitle;
     NSMutableDictionary *_strings;
     NSMutableArray *_menuItems;
+    // The selection _menuItems were fetched for, Finder asks for the menu of each menu kind
+    NSString *_menuItemsPaths;
+    NSDate *_menuItemsDate;
 }
 
 @end
@@ -101,11 +101,20 @@
     NSMutableSet *rootPaths = [[NSMutableSet alloc] init];
     [syncController.directoryURLs enumerateObjectsUsingBlock:^(id obj, BOOL *stop) { [rootPaths addObject:[obj path]]; }];
 
+    // The strings are pushed once per connection, without them the client isn't ready to answer
+    id contextMenuTitle = [_strings objectForKey:@"CONTEXT_MENU_TITLE"];
+    if (!contextMenuTitle) {
+        return nil;
+    }
+
     NSString *paths = [self selectedPathsSeparatedByRecordSeparator];
-    // calling this IPC calls us back from client with several MENU_ITEM entries and then our askOnSocket returns again
-    [_syncClientProxy askOnSocket:paths query:@"GET_MENU_ITEMS"];
+    if (![paths isEqualToString:_menuItemsPaths] || [_menuItemsDate timeIntervalSinceNow] < -2) {
+        // calling this IPC calls us back from client with several MENU_ITEM entries and then our askOnSocket returns again
+        [_syncClientProxy askOnSocket:paths query:@"GET_MENU_ITEMS"];
+        _menuItemsPaths = paths;
+        _menuItemsDate = [NSDate date];
+    }
 
-    id contextMenuTitle = [_strings objectForKey:@"CONTEXT_MENU_TITLE"];
     if (contextMenuTitle && _menuItems.count != 0) {
         NSMenu *menu = [[NSMenu alloc] initWithTitle:@""];
         NSMenu *subMenu = [[NSMenu alloc] initWithTitle:@""];
@@ -136,6 +145,8 @@
     long idx = [(NSMenuItem *)sender tag];
     NSString *command = [[_menuItems objectAtIndex:idx] valueForKey:@"command"];
     NSString *paths = [self selectedPathsSeparatedByRecordSeparator];
+    // The action probably changes the menu of these files
+    _menuItemsPaths = nil;
     [_syncClientProxy askOnSocket:paths query:command];
 }
 
@@ -181,6 +192,7 @@
 - (void)connectionDidDie
 {
     [_strings removeAllObjects];
+    _menuItemsPaths = nil;
     [_registeredDirectories removeAllObjects];
     // For some reason the FIFinderSync cache doesn't seem to be cleared for the root item when
     // we reset the directoryURLs (seen on macOS 10.12 at least).
@@ -33,6 +33,12 @@
 @interface SyncClientProxy : NSObject <ChannelProtocol> {
     NSString *_serverName;
     NSDistantObject<ChannelProtocol> *_remoteEnd;
+    // paths to ask for with the next batched status request, guarded by @synchronized(self)
+    NSMutableArray *_pendingIconPaths;
+    NSUInteger _requestId;
+    // the status table published by the client, guarded by @synchronized(self)
+    const void *_statusTable;
+    size_t _statusTableSize;
 }
 
 @property (weak) id<SyncClientProxyDelegate> delegate;
@@ -14,6 +14,41 @@
 
 #import "SyncClientProxy.h"
 
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The layout of the status table, this must match SocketApiStatusTable in src/gui/socketapi of the client
+static const uint32_t StatusTableMagic = 0x5453434f; // "OCST"
+static const uint32_t StatusTableVersion = 2;
+static const uint32_t StatusTableMaximumProbes = 32;
+// the status of a slot the client removed, the lookup continues over it
+static const uint32_t StatusTableRemoved = 0xffffffff;
+
+typedef struct {
+    _Atomic uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    _Atomic uint32_t sequence;
+} StatusTableHeader;
+
+typedef struct {
+    _Atomic uint32_t sequence;
+    _Atomic uint32_t status;
+    _Atomic uint64_t hash;
+} StatusTableSlot;
+
+_Static_assert(sizeof(StatusTableHeader) == 16 && sizeof(StatusTableSlot) == 16, "The layout is shared with the client");
+_Static_assert(offsetof(StatusTableHeader, sequence) == 12 && offsetof(StatusTableSlot, status) == 4 && offsetof(StatusTableSlot, hash) == 8,
+    "The layout is shared with the client");
+
+// The order is part of the shared layout
+static NSString *const StatusTableStrings[] = {@"NOP", @"SYNC", @"SYNC+SWM", @"IGNORE", @"IGNORE+SWM", @"OK", @"OK+SWM", @"ERROR", @"ERROR+SWM"};
+
 @protocol ServerProtocol <NSObject>
 - (void)registerClient:(id)client;
 @end
@@ -31,6 +66,10 @@
     self.delegate = arg1;
     _serverName = serverName;
     _remoteEnd = nil;
+    _pendingIconPaths = [[NSMutableArray alloc] init];
+    _requestId = 0;
+    _statusTable = NULL;
+    _statusTableSize = 0;
 
     return self;
 }
@@ -68,6 +107,7 @@
     // The server replied with the distant object that we will use for tx
     _remoteEnd = (NSDistantObject<ChannelProtocol> *)tx;
     [_remoteEnd setProtocolForProxy:@protocol(ChannelProtocol)];
+    [self openStatusTable];
 
     // Everything is set up, start querying
     [self askOnSocket:@"" query:@"GET_STRINGS"];
@@ -82,11 +122,109 @@
 {
 #pragma unused(notification)
     _remoteEnd = nil;
+    [self closeStatusTable];
     [_delegate connectionDidDie];
 
     [self scheduleRetry];
 }
 
+#pragma mark - Status table
+
+- (void)openStatusTable
+{
+    // The client publishes the table in the container of our App Group, which is the server name without the suffix
+    NSString *group = [_serverName stringByReplacingOccurrencesOfString:@".socketApi" withString:@"" options:NSAnchoredSearch | NSBackwardsSearch range:NSMakeRange(0, [_serverName length])];
+    NSURL *container = [[NSFileManager defaultManager] containerURLForSecurityApplicationGroupIdentifier:group];
+    if (!container) {
+        return;
+    }
+    int fd = open([[[container URLByAppendingPathComponent:@"statustable"] path] fileSystemRepresentation], O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(StatusTableHeader)) {
+        data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return;
+    }
+    @synchronized(self) {
+        [self closeStatusTable];
+        _statusTable = data;
+        _statusTableSize = (size_t)info.st_size;
+    }
+}
+
+- (void)closeStatusTable
+{
+    @synchronized(self) {
+        if (_statusTable) {
+            munmap((void *)_statusTable, _statusTableSize);
+            _statusTable = NULL;
+            _statusTableSize = 0;
+        }
+    }
+}
+
+// Returns the status the client published for path, or nil. This never blocks on the client.
+- (NSString *)publishedStatusForPath:(NSString *)path
+{
+    @synchronized(self) {
+        if (!_statusTable) {
+            return nil;
+        }
+        StatusTableHeader *header = (StatusTableHeader *)_statusTable;
+        if (atomic_load_explicit(&header->magic, memory_order_acquire) != StatusTableMagic || header->version != StatusTableVersion) {
+            return nil;
+        }
+        const uint32_t slotCount = header->slotCount;
+        if (slotCount == 0 || sizeof(StatusTableHeader) + (size_t)slotCount * sizeof(StatusTableSlot) > _statusTableSize) {
+            return nil;
+        }
+        const uint32_t tableSequence = atomic_load_explicit(&header->sequence, memory_order_acquire);
+        if (tableSequence & 1) {
+            return nil;
+        }
+
+        // FNV-1a over the UTF-16 code units
+        uint64_t hash = 14695981039346656037ull;
+        const NSUInteger length = [path length];
+        for (NSUInteger i = 0; i < length; ++i) {
+            hash ^= [path characterAtIndex:i];
+            hash *= 1099511628211ull;
+        }
+
+        StatusTableSlot *slots = (StatusTableSlot *)((const char *)_statusTable + sizeof(StatusTableHeader));
+        uint32_t code = 0;
+        for (uint32_t i = 0; i < StatusTableMaximumProbes; ++i) {
+            StatusTableSlot *slot = &slots[(hash + i) % slotCount];
+            const uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+            const uint32_t status = atomic_load_explicit(&slot->status, memory_order_relaxed);
+            const uint64_t slotHash = atomic_load_explicit(&slot->hash, memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if ((sequence & 1) || atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence || status == 0) {
+                return nil;
+            }
+            if (status == StatusTableRemoved) {
+                continue;
+            }
+            if (slotHash == hash) {
+                code = status;
+                break;
+            }
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (code == 0 || code > sizeof(StatusTableStrings) / sizeof(StatusTableStrings[0])
+            || atomic_load_explicit(&header->sequence, memory_order_relaxed) != tableSequence) {
+            return nil;
+        }
+        return StatusTableStrings[code - 1];
+    }
+}
+
 #pragma mark - Communication logic
 
 - (void)sendMessage:(NSData *)msg
@@ -95,6 +233,23 @@
 
     // Cut the trailing newline. We always only receive one line from the client.
     answer = [answer substringToIndex:[answer length] - 1];
+
+    if ([answer hasPrefix:@"V2/RETRIEVE_FILE_STATUS_RESULT:"] || [answer hasPrefix:@"V2/STATUS:"]) {
+        // Batched replies and pushes: {"arguments":{"statuses":{"path":"status",...}}}
+        NSString *json = [answer substringFromIndex:[answer rangeOfString:@":"].location + 1];
+        NSDictionary *object = [NSJSONSerialization JSONObjectWithData:[json dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil];
+        NSDictionary *statuses = [[object objectForKey:@"arguments"] objectForKey:@"statuses"];
+        if (![statuses isKindOfClass:[NSDictionary class]]) {
+            NSLog(@"SyncState: Invalid status reply %@", answer);
+            return;
+        }
+        [statuses enumerateKeysAndObjectsUsingBlock:^(NSString *path, NSString *result, BOOL *stop) {
+#pragma unused(stop)
+            [self->_delegate setResultForPath:path result:result];
+        }];
+        return;
+    }
+
     NSArray *chunks = [answer componentsSeparatedByString:@":"];
 
     if ([[chunks objectAtIndex:0] isEqualToString:@"STATUS"]) {
@@ -149,8 +304,46 @@
 
 - (void)askForIcon:(NSString *)path isDirectory:(BOOL)isDir
 {
-    NSString *verb = isDir ? @"RETRIEVE_FOLDER_STATUS" : @"RETRIEVE_FILE_STATUS";
-    [self askOnSocket:path query:verb];
+#pragma unused(isDir)
+    NSString *published = [self publishedStatusForPath:path];
+    if (published) {
+        // The client pushes the changes of published statuses like for the ones we asked for
+        [_delegate setResultForPath:path result:published];
+        return;
+    }
+
+    // Finder asks for every visible item, collect them and ask with a single request
+    BOOL scheduleFlush;
+    @synchronized(self) {
+        scheduleFlush = [_pendingIconPaths count] == 0;
+        [_pendingIconPaths addObject:path];
+    }
+    if (scheduleFlush) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self flushIconRequests];
+        });
+    }
+}
+
+- (void)flushIconRequests
+{
+    NSArray *paths;
+    NSUInteger requestId;
+    @synchronized(self) {
+        paths = [_pendingIconPaths copy];
+        [_pendingIconPaths removeAllObjects];
+        requestId = ++_requestId;
+    }
+    if ([paths count] == 0) {
+        return;
+    }
+
+    NSDictionary *request = @{
+        @"id" : [NSString stringWithFormat:@"%lu", (unsigned long)requestId],
+        @"arguments" : @{@"paths" : paths}
+    };
+    NSData *json = [NSJSONSerialization dataWithJSONObject:request options:0 error:nil];
+    [self askOnSocket:[[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding] query:@"V2/RETRIEVE_FILE_STATUS"];
 }
 
 @end
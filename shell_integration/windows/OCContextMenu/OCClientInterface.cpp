@@ -27,6 +27,7 @@
 #include <sstream>
 #include <string>
 #include <iterator>
+#include <mutex>
 #include <unordered_set>
 
 // gdiplus min/max
@@ -96,23 +97,74 @@ std::shared_ptr<HBITMAP> saveImage(const string &data)
                                          Gdiplus::GdiplusShutdown(gdiplusToken);
                                      } };
 }
+
+// How long the folders of the client are trusted to skip asking for the menu of other files
+constexpr ULONGLONG watchedDirectoriesLifetimeC = 30 * 1000; // ms
+
+// The parts of the context menu that don't depend on the selection, shared by all menus of the session
+struct SessionInfo
+{
+    std::mutex mutex;
+    bool valid = false;
+    ULONGLONG fetchedAt = 0;
+    wstring contextMenuTitle;
+    std::shared_ptr<HBITMAP> icon;
+    vector<wstring> watchedDirectories;
+};
+
+SessionInfo &sessionInfo()
+{
+    // Never destroyed, releasing the icon shuts down GDI+ which must not happen while the dll unloads
+    static auto *info = new SessionInfo;
+    return *info;
+}
+
+// The client might have been restarted with another language or theme
+void resetSessionInfo()
+{
+    auto &session = sessionInfo();
+    lock_guard<std::mutex> lock(session.mutex);
+    session.valid = false;
+    session.icon.reset();
+    session.watchedDirectories.clear();
+}
 }
 
 OCClientInterface::ContextMenuInfo OCClientInterface::FetchInfo(const std::wstring &files)
 {
+    auto &session = sessionInfo();
+    ContextMenuInfo info;
+    bool haveSession = false;
+    {
+        lock_guard<std::mutex> lock(session.mutex);
+        if (session.valid) {
+            haveSession = true;
+            info.contextMenuTitle = session.contextMenuTitle;
+            info.icon = session.icon;
+            // The client has no menu for files outside of its folders, don't wait for it to tell us
+            if (GetTickCount64() - session.fetchedAt < watchedDirectoriesLifetimeC && !StringUtil::areDescendantsOf(files, L'\x1e', session.watchedDirectories)) {
+                return {};
+            }
+        }
+    }
+
     auto pipename = CommunicationSocket::DefaultPipePath();
 
     CommunicationSocket socket;
     if (!WaitNamedPipe(pipename.data(), PIPE_TIMEOUT)) {
         OCShell::logWinError(L"OCClientInterface::FetchInfo: Failed to connect to " + pipename);
+        resetSessionInfo();
         return {};
     }
     if (!socket.Connect(pipename)) {
         OCShell::log(L"OCClientInterface::FetchInfo: Failed to connect to " + pipename);
+        resetSessionInfo();
         return {};
     }
-    bool ok = sendV2(socket, L"V2/GET_CLIENT_ICON", { { "size", 16 } })
-        && socket.SendMsg(L"GET_STRINGS:CONTEXT_MENU_TITLE\n")
+    // The title and the icon don't change while the client runs, only ask for them once
+    bool ok = (haveSession
+                  || (sendV2(socket, L"V2/GET_CLIENT_ICON", { { "size", 16 } })
+                      && socket.SendMsg(L"GET_STRINGS:CONTEXT_MENU_TITLE\n")))
         && socket.SendMsg(L"GET_MENU_ITEMS:" + files + L"\n");
 
     if (!ok) {
@@ -122,15 +174,17 @@ OCClientInterface::ContextMenuInfo OCClientInterface::FetchInfo(const std::wstri
     }
 
 
-    ContextMenuInfo info;
     bool endReceived = false;
-    bool iconReceived = false;
+    bool iconReceived = haveSession;
     auto ready = [&] { return endReceived && iconReceived; };
 
     std::wstring response;
     int sleptCount = 0;
     while (sleptCount < 5) {
-        if (socket.ReadLine(&response)) {
+        if (!socket.ReadLine(&response)) {
+            break;
+        }
+        if (!response.empty()) {
             if (StringUtil::begins_with(response, wstring(L"V2/"))) {
                 const auto msg = parseV2(response);
                 const auto &arguments = msg.second["arguments"];
@@ -164,11 +218,18 @@ OCClientInterface::ContextMenuInfo OCClientInterface::FetchInfo(const std::wstri
                 endReceived = true;
             }
             if (ready()) {
+                // The client registers all its folders before it answers
+                lock_guard<std::mutex> lock(session.mutex);
+                session.valid = true;
+                session.fetchedAt = GetTickCount64();
+                session.contextMenuTitle = info.contextMenuTitle;
+                session.icon = info.icon;
+                session.watchedDirectories = info.watchedDirectories;
                 return info;
             }
         }
-        else {
-            Sleep(50);
+        else if (WaitForSingleObject(socket.Event(), 50) == WAIT_TIMEOUT) {
+            // Only count the waits for which nothing arrived
             ++sleptCount;
         }
     }
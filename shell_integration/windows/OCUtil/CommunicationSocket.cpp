@@ -51,15 +51,27 @@ std::wstring CommunicationSocket::DefaultPipePath()
     return pipename;
 }
 
+std::wstring CommunicationSocket::DefaultStatusTableName()
+{
+    // This must match Utility::socketApiStatusTablePath() in the client
+    auto name = std::wstring(L"Local\\ownCloud-");
+    name += getUserName().c_str();
+    name += L"-status";
+    return name;
+}
+
 CommunicationSocket::CommunicationSocket()
     : _pipe(INVALID_HANDLE_VALUE)
 {
-    _overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    _readOverlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    _writeOverlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
 }
 
 CommunicationSocket::~CommunicationSocket()
 {
     Close();
+    CloseHandle(_readOverlapped.hEvent);
+    CloseHandle(_writeOverlapped.hEvent);
 }
 
 bool CommunicationSocket::Close()
@@ -67,8 +79,16 @@ bool CommunicationSocket::Close()
     if (_pipe == INVALID_HANDLE_VALUE) {
         return false;
     }
+    if (_readPending) {
+        // The pending read writes into _readBuffer, wait for the cancellation before reusing it
+        DWORD numBytesRead = 0;
+        CancelIoEx(_pipe, &_readOverlapped);
+        GetOverlappedResult(_pipe, &_readOverlapped, &numBytesRead, TRUE);
+        _readPending = false;
+    }
     CloseHandle(_pipe);
     _pipe = INVALID_HANDLE_VALUE;
+    _buffer.clear();
     return true;
 }
 
@@ -90,13 +110,13 @@ bool CommunicationSocket::SendMsg(const wstring &message) const
 
     DWORD numBytesWritten = 0;
 
-    if (!WriteFile(_pipe, utf8_msg.c_str(), static_cast<DWORD>(utf8_msg.size()), &numBytesWritten, &_overlapped)) {
+    if (!WriteFile(_pipe, utf8_msg.c_str(), static_cast<DWORD>(utf8_msg.size()), &numBytesWritten, &_writeOverlapped)) {
         if (GetLastError() == ERROR_IO_PENDING) {
-            if (WaitForSingleObject(_overlapped.hEvent, timeoutC) != WAIT_OBJECT_0) {
+            if (WaitForSingleObject(_writeOverlapped.hEvent, timeoutC) != WAIT_OBJECT_0) {
                 OCShell::logWinError(L"SendMsg timed out");
                 return false;
             }
-            if (!GetOverlappedResult(_pipe, &_overlapped, &numBytesWritten, FALSE)) {
+            if (!GetOverlappedResult(_pipe, &_writeOverlapped, &numBytesWritten, FALSE)) {
                 OCShell::logWinError(L"GetOverlappedResult failed");
                 return false;
             }
@@ -115,42 +135,40 @@ bool CommunicationSocket::ReadLine(wstring *response) const
     }
 
     while (true) {
-        int lbPos = 0;
-        auto it = std::find(_buffer.begin() + lbPos, _buffer.end(), '\n');
+        auto it = std::find(_buffer.begin(), _buffer.end(), '\n');
         if (it != _buffer.end()) {
             *response = StringUtil::toUtf16(_buffer.data(), distance(_buffer.begin(), it));
             _buffer.erase(_buffer.begin(), it + 1);
+            if (response->empty()) {
+                // An empty response means that nothing arrived yet
+                continue;
+            }
             return true;
         }
 
-        std::array<char, 128> resp_utf8;
         DWORD numBytesRead = 0;
-        DWORD totalBytesAvailable = 0;
-
-        if (!PeekNamedPipe(_pipe, nullptr, 0, nullptr, &totalBytesAvailable, nullptr)) {
-            return false;
-        }
-        if (totalBytesAvailable == 0) {
-            return true;
-        }
-
-        if (!ReadFile(_pipe, resp_utf8.data(), DWORD(resp_utf8.size()), &numBytesRead, &_overlapped)) {
-            if (GetLastError() == ERROR_IO_PENDING) {
-                if (WaitForSingleObject(_overlapped.hEvent, timeoutC) != WAIT_OBJECT_0) {
-                    OCShell::logWinError(L"ReadLine timed out");
-                }
-                if (!GetOverlappedResult(_pipe, &_overlapped, &numBytesRead, FALSE)) {
-                    OCShell::logWinError(L"GetOverlappedResult failed");
-                    return false;
-                }
-            } else {
-                return false;
+        BOOL ok;
+        if (_readPending) {
+            ok = GetOverlappedResult(_pipe, &_readOverlapped, &numBytesRead, FALSE);
+            if (!ok && GetLastError() == ERROR_IO_INCOMPLETE) {
+                // Still waiting, Event() gets signaled once the data is there
+                return true;
+            }
+            _readPending = false;
+        } else {
+            // This resets Event() until the read completes
+            ok = ReadFile(_pipe, _readBuffer.data(), DWORD(_readBuffer.size()), &numBytesRead, &_readOverlapped);
+            if (!ok && GetLastError() == ERROR_IO_PENDING) {
+                _readPending = true;
+                return true;
             }
         }
-        if (numBytesRead <= 0) {
+        if (!ok && GetLastError() != ERROR_MORE_DATA) {
+            return false;
+        }
+        if (numBytesRead == 0) {
             return false;
         }
-        _buffer.insert(_buffer.end(), resp_utf8.begin(), resp_utf8.begin()+numBytesRead);
-        continue;
+        _buffer.insert(_buffer.end(), _readBuffer.begin(), _readBuffer.begin() + numBytesRead);
     }
 }
@@ -19,6 +19,7 @@
 
 #pragma warning (disable : 4251)
 
+#include <array>
 #include <string>
 #include <vector>
 #include <WinSock2.h>
@@ -27,6 +28,8 @@ class __declspec(dllexport) CommunicationSocket
 {
 public:
     static std::wstring DefaultPipePath();
+    // The name of the status table the client publishes next to the pipe
+    static std::wstring DefaultStatusTableName();
 
     CommunicationSocket();
     ~CommunicationSocket();
@@ -35,16 +38,25 @@ public:
     bool Close();
 
     [[nodiscard]] bool SendMsg(const std::wstring &) const;
+    /**
+     * Returns the next complete line in \a response, or an empty one if none arrived yet.
+     * Returns false once the pipe is broken.
+     */
     [[nodiscard]] bool ReadLine(std::wstring *) const;
 
-    HANDLE Event() { return _pipe; }
+    bool IsConnected() const { return _pipe != INVALID_HANDLE_VALUE; }
+    // Signaled when data for ReadLine arrived or the pipe got broken
+    HANDLE Event() const { return _readOverlapped.hEvent; }
 
 private:    
     HANDLE _pipe;
     mutable std::vector<char> _buffer;
-    bool _connected;
 
-    mutable OVERLAPPED _overlapped = {};
+    // ReadLine keeps a read pending between calls so that Event() wakes up the reader
+    mutable std::array<char, 4096> _readBuffer;
+    mutable bool _readPending = false;
+    mutable OVERLAPPED _readOverlapped = {};
+    mutable OVERLAPPED _writeOverlapped = {};
 };
 
 #endif
@@ -22,6 +22,9 @@
 #include <iostream>
 #include <sstream>
 #include <iterator>
+#include <string>
+#include <utility>
+#include <set>
 #include <unordered_set>
 #include <cassert>
 
@@ -29,6 +32,13 @@
 
 using namespace std;
 
+namespace {
+
+// How long to wait before trying to connect again while the client isn't running
+constexpr DWORD reconnectIntervalC = 500;
+
+}
+
 // This code is run in a thread
 void RemotePathChecker::workerThreadLoop()
 {
@@ -36,41 +46,90 @@ void RemotePathChecker::workerThreadLoop()
     bool connected = false;
     CommunicationSocket socket;
     std::unordered_set<std::wstring> asked;
+    // The directories whose entries we asked for, ordered like _cache
+    std::set<std::wstring> listedDirectories;
+    unsigned long long requestId = 0;
 
     while(!_stop) {
-        Sleep(50);
-
         if (!connected) {
             asked.clear();
-            if (!WaitNamedPipe(pipename.data(), 100)) {
-                continue;
-            }
-            if (!socket.Connect(pipename)) {
+            listedDirectories.clear();
+            if (!WaitNamedPipe(pipename.data(), 100) || !socket.Connect(pipename)) {
+                // _newQueries is only signaled by the destructor while we are not connected
+                WaitForSingleObject(_newQueries, reconnectIntervalC);
                 continue;
             }
             connected = true;
             std::unique_lock<std::mutex> lock(_mutex);
             _connected = true;
+            _statusTable.open(CommunicationSocket::DefaultStatusTableName());
         }
 
         {
-            std::unique_lock<std::mutex> lock(_mutex);
-            while (!_pending.empty() && !_stop) {
-                auto filePath = _pending.front();
-                _pending.pop();
-
-                lock.unlock();
-                if (!asked.count(filePath)) {
-                    asked.insert(filePath);
-                    if (!socket.SendMsg(L"RETRIEVE_FILE_STATUS:" + filePath + L'\n')) {
-                        _stop = true;
-                        break;
+            // Ask for all pending paths with a single request, explorer queries every visible item.
+            // The first query for a directory asks for all its entries, so that the following
+            // queries are answered from the cache instead of waiting for a reply and a refresh.
+            wstring paths, directories;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (!_pending.empty()) {
+                    auto filePath = std::move(_pending.front());
+                    _pending.pop();
+                    const auto separator = filePath.find_last_of(L'\\');
+                    if (separator != wstring::npos && listedDirectories.insert(filePath.substr(0, separator)).second) {
+                        if (!directories.empty()) {
+                            directories += L',';
+                        }
+                        directories += StringUtil::toJsonString(filePath.substr(0, separator));
+                    }
+                    if (asked.insert(filePath).second) {
+                        if (!paths.empty()) {
+                            paths += L',';
+                        }
+                        paths += StringUtil::toJsonString(filePath);
                     }
                 }
-                lock.lock();
+            }
+            if (!paths.empty() && !_stop) {
+                const auto query = L"V2/RETRIEVE_FILE_STATUS:{\"id\":\"" + to_wstring(++requestId) + L"\",\"arguments\":{\"paths\":[" + paths
+                    + L"],\"directories\":[" + directories + L"]}}\n";
+                if (!socket.SendMsg(query)) {
+                    // Reconnect, the pipe is broken or the client stopped answering
+                    socket.Close();
+                }
             }
         }
 
+        auto updateStatus = [&](const wstring &responsePath, const wstring &responseStatus, bool listed) {
+            auto state = _StrToFileState(responseStatus);
+            bool wasAsked = asked.erase(responsePath) > 0;
+
+            bool updateView = false;
+            {   std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _cache.find(responsePath);
+                if (it == _cache.end()) {
+                    // The client only approximates requested files, if the bloom
+                    // filter becomes saturated after navigating multiple directories we'll start getting
+                    // status pushes that we never requested and fill our cache. Ignore those.
+                    if (!wasAsked) {
+                        // Explorer didn't ask for the entries of a listed directory yet, it will find them
+                        // in the cache when it does, so there is nothing to refresh.
+                        if (listed) {
+                            _cache.emplace(responsePath, state);
+                        }
+                        return;
+                    }
+                    it = _cache.emplace(responsePath, StateNone).first;
+                }
+
+                updateView = it->second != state;
+                it->second = state;
+            }
+            if (updateView) {
+                SHChangeNotify(SHCNE_UPDATEITEM, SHCNF_PATH | SHCNF_FLUSHNOWAIT, responsePath.data(), nullptr);
+            }
+        };
+
         std::wstring response;
         while (!_stop) {
             if (!socket.ReadLine(&response)) {
@@ -78,6 +137,7 @@ void RemotePathChecker::workerThreadLoop()
                 break;
             }
             if (response.empty()) {
+                // Nothing left to read, socket.Event() tells us when there is more
                 break;
             }
             if (StringUtil::begins_with(response, wstring(L"REGISTER_PATH:"))) {
@@ -102,20 +162,25 @@ void RemotePathChecker::workerThreadLoop()
                     vectorCopy->end());
                 atomic_store(&_watchedDirectories, shared_ptr<const vector<wstring>>(vectorCopy));
 
+                StringUtil::eraseDescendants(listedDirectories, responsePath);
+
                 vector<wstring> removedPaths;
                 {   std::unique_lock<std::mutex> lock(_mutex);
-                    // Remove any item from the cache
-                    for (auto it = _cache.begin(); it != _cache.end() ; ) {
-                        if (StringUtil::isDescendantOf(it->first, responsePath)) {
-                            removedPaths.emplace_back(std::move(it->first));
-                            it = _cache.erase(it);
-                        } else {
-                            ++it;
-                        }
-                    }
+                    // Remove the items of the folder from the cache
+                    removedPaths = StringUtil::eraseDescendants(_cache, responsePath);
                 }
                 for (auto& path : removedPaths)
                     SHChangeNotify(SHCNE_UPDATEITEM, SHCNF_PATH | SHCNF_FLUSHNOWAIT, path.data(), nullptr);
+            } else if (StringUtil::begins_with(response, wstring(L"V2/RETRIEVE_FILE_STATUS_RESULT:")) ||
+                    StringUtil::begins_with(response, wstring(L"V2/STATUS:"))) {
+                // Batched replies and pushes: {"arguments":{"statuses":{"path":"status",...}}}
+                vector<pair<wstring, wstring>> statuses;
+                if (!StringUtil::extractJsonStringMap(response.substr(response.find(L':') + 1), L"statuses", statuses))
+                    continue;
+                const bool isReply = StringUtil::begins_with(response, wstring(L"V2/RETRIEVE_FILE_STATUS_RESULT:"));
+                for (const auto &status : statuses) {
+                    updateStatus(status.first, status.second, isReply);
+                }
             } else if (StringUtil::begins_with(response, wstring(L"STATUS:")) ||
                     StringUtil::begins_with(response, wstring(L"BROADCAST:"))) {
 
@@ -123,38 +188,18 @@ void RemotePathChecker::workerThreadLoop()
                 if (!StringUtil::extractChunks(response, responseStatus, responsePath))
                     continue;
 
-                auto state = _StrToFileState(responseStatus);
-                bool wasAsked = asked.erase(responsePath) > 0;
-
-                bool updateView = false;
-                {   std::unique_lock<std::mutex> lock(_mutex);
-                    auto it = _cache.find(responsePath);
-                    if (it == _cache.end()) {
-                        // The client only approximates requested files, if the bloom
-                        // filter becomes saturated after navigating multiple directories we'll start getting
-                        // status pushes that we never requested and fill our cache. Ignore those.
-                        if (!wasAsked) {
-                            continue;
-                        }
-                        it = _cache.insert(make_pair(responsePath, StateNone)).first;
-                    }
-
-                    updateView = it->second != state;
-                    it->second = state;
-                }
-                if (updateView) {
-                    SHChangeNotify(SHCNE_UPDATEITEM, SHCNF_PATH | SHCNF_FLUSHNOWAIT, responsePath.data(), nullptr);
-                }
+                updateStatus(responsePath, responseStatus, false);
             }
         }
 
-        if (socket.Event() == INVALID_HANDLE_VALUE) {
+        if (!socket.IsConnected()) {
             atomic_store(&_watchedDirectories, make_shared<const vector<wstring>>());
             std::unique_lock<std::mutex> lock(_mutex);
             _connected = connected = false;
+            _statusTable.close();
 
             // Swap to make a copy of the cache under the mutex and clear the one stored.
-            std::unordered_map<std::wstring, FileState> cache;
+            std::map<std::wstring, FileState> cache;
             swap(cache, _cache);
             lock.unlock();
             // Let explorer know about each invalidated cache entry that needs to get its icon removed.
@@ -163,12 +208,13 @@ void RemotePathChecker::workerThreadLoop()
             }
         }
 
-        if (_stop) {
-            return;
+        if (_stop || !connected) {
+            continue;
         }
 
+        // Sleep until explorer asks for new paths or the client sends something
         HANDLE handles[2] = { _newQueries, socket.Event() };
-        WaitForMultipleObjects(2, handles, false, 0);
+        WaitForMultipleObjects(2, handles, false, INFINITE);
     }
 }
 
@@ -214,6 +260,15 @@ bool RemotePathChecker::IsMonitoredPath(const wchar_t* filePath, int* state)
         return true;
     }
 
+    std::wstring status;
+    if (_statusTable.lookup(path, &status)) {
+        // The client pushes the changes of published statuses, so we can cache it like an asked one
+        auto fileState = _StrToFileState(status);
+        _cache.emplace(std::move(path), fileState);
+        *state = fileState;
+        return true;
+    }
+
     _pending.push(filePath);
 
     lock.unlock();
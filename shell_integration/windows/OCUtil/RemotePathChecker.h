@@ -14,9 +14,11 @@
 #ifndef PATHCHECKER_H
 #define PATHCHECKER_H
 
+#include "StatusTable.h"
+
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <map>
 #include <queue>
 #include <thread>
 #include <memory>
@@ -52,7 +54,10 @@ private:
      * send that to the socket. */
     std::queue<std::wstring> _pending;
 
-    std::unordered_map<std::wstring, FileState> _cache;
+    // Ordered so that the entries below a folder can be invalidated without visiting the others
+    std::map<std::wstring, FileState> _cache;
+    // The statuses the client publishes, consulted before asking over the socket
+    StatusTable _statusTable;
     // The vector is const since it will be accessed from multiple threads through OCOverlay::IsMemberOf.
     // Each modification needs to be made onto a copy and then atomically replaced in the shared_ptr.
     std::shared_ptr<const std::vector<std::wstring>> _watchedDirectories;
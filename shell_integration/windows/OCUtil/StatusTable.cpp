@@ -0,0 +1,114 @@
+/**
+* Copyright (c) 2014 ownCloud GmbH. All rights reserved.
+*
+* This library is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 2.1 of the License
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+* details.
+*/
+
+#include "StatusTable.h"
+
+namespace {
+// The order is part of the shared layout
+const wchar_t *const statusStringsC[] = { L"NOP", L"SYNC", L"SYNC+SWM", L"IGNORE", L"IGNORE+SWM", L"OK", L"OK+SWM", L"ERROR", L"ERROR+SWM" };
+constexpr uint32_t statusCountC = sizeof(statusStringsC) / sizeof(statusStringsC[0]);
+
+uint64_t hashPath(const std::wstring &path)
+{
+    // FNV-1a over the UTF-16 code units
+    uint64_t h = 14695981039346656037ull;
+    for (auto c : path) {
+        h ^= static_cast<uint16_t>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+}
+
+StatusTable::~StatusTable()
+{
+    close();
+}
+
+bool StatusTable::open(const std::wstring &name)
+{
+    if (_header) {
+        return true;
+    }
+    _mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+    if (!_mapping) {
+        return false;
+    }
+    auto data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        close();
+        return false;
+    }
+    _header = static_cast<const Header *>(data);
+    _slots = reinterpret_cast<const Slot *>(static_cast<const char *>(data) + sizeof(Header));
+    return true;
+}
+
+void StatusTable::close()
+{
+    if (_header) {
+        UnmapViewOfFile(_header);
+        _header = nullptr;
+        _slots = nullptr;
+    }
+    if (_mapping) {
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+    }
+}
+
+bool StatusTable::lookup(const std::wstring &path, std::wstring *status) const
+{
+    if (!_header || _header->magic.load(std::memory_order_acquire) != Magic || _header->version != Version) {
+        return false;
+    }
+    const auto tableSequence = _header->sequence.load(std::memory_order_acquire);
+    if (tableSequence & 1) {
+        return false;
+    }
+
+    const auto slotCount = _header->slotCount;
+    if (slotCount == 0) {
+        return false;
+    }
+    const auto hash = hashPath(path);
+    uint32_t code = 0;
+    for (uint32_t i = 0; i < MaximumProbes; ++i) {
+        const auto &slot = _slots[(hash + i) % slotCount];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto slotStatus = slot.status.load(std::memory_order_relaxed);
+        const auto slotHash = slot.hash.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((sequence & 1) || slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            // the client is writing the slot
+            return false;
+        }
+        if (slotStatus == 0) {
+            return false;
+        }
+        if (slotStatus == Removed) {
+            continue;
+        }
+        if (slotHash == hash) {
+            code = slotStatus;
+            break;
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (code == 0 || code > statusCountC || _header->sequence.load(std::memory_order_relaxed) != tableSequence) {
+        return false;
+    }
+    *status = statusStringsC[code - 1];
+    return true;
+}
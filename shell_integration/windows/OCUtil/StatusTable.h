@@ -0,0 +1,71 @@
+/**
+* Copyright (c) 2014 ownCloud GmbH. All rights reserved.
+*
+* This library is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 2.1 of the License
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+* details.
+*/
+
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Read only access to the file status table published by the client.
+ *
+ * The layout must match SocketApiStatusTable in src/gui/socketapi of the client.
+ * Lookups never block, a slot that is written while we read it is reported as a miss.
+ */
+class StatusTable
+{
+public:
+    StatusTable() = default;
+    ~StatusTable();
+    StatusTable(const StatusTable &) = delete;
+    StatusTable &operator=(const StatusTable &) = delete;
+
+    /** Maps the table, returns false if the client does not publish one */
+    bool open(const std::wstring &name);
+    void close();
+
+    /** Sets \a status to the socket api status string of \a path and returns true if it is in the table */
+    bool lookup(const std::wstring &path, std::wstring *status) const;
+
+private:
+    static constexpr uint32_t Magic = 0x5453434f; // "OCST"
+    static constexpr uint32_t Version = 2;
+    static constexpr uint32_t MaximumProbes = 32;
+    // the status of a slot the client removed, the lookup continues over it
+    static constexpr uint32_t Removed = 0xffffffff;
+
+    struct Header
+    {
+        std::atomic<uint32_t> magic;
+        uint32_t version;
+        uint32_t slotCount;
+        std::atomic<uint32_t> sequence;
+    };
+
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint32_t> status;
+        std::atomic<uint64_t> hash;
+    };
+    static_assert(sizeof(Header) == 16 && sizeof(Slot) == 16, "The layout is shared with the client");
+    static_assert(offsetof(Header, sequence) == 12 && offsetof(Slot, status) == 4 && offsetof(Slot, hash) == 8, "The layout is shared with the client");
+
+    HANDLE _mapping = nullptr;
+    const Header *_header = nullptr;
+    const Slot *_slots = nullptr;
+};
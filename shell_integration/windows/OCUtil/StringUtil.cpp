@@ -14,6 +14,7 @@
 #include <locale>
 #include <string>
 #include <codecvt>
+#include <cwchar>
 
 #include "StringUtil.h"
 
@@ -28,3 +29,132 @@ std::wstring StringUtil::toUtf16(const char *utf8, size_t len)
     std::wstring_convert<std::codecvt_utf8_utf16<wchar_t> > converter;
     return converter.from_bytes(utf8, utf8+len);
 }
+
+std::wstring StringUtil::toJsonString(const std::wstring &str)
+{
+    std::wstring out;
+    out.reserve(str.size() + 2);
+    out += L'"';
+    for (auto c : str) {
+        switch (c) {
+        case L'"':
+            out += L"\\\"";
+            break;
+        case L'\\':
+            out += L"\\\\";
+            break;
+        default:
+            if (c < 0x20) {
+                wchar_t buf[7];
+                swprintf(buf, 7, L"\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += L'"';
+    return out;
+}
+
+namespace {
+// the value of the hex digit \a c, or -1 if it is none
+int hexDigit(wchar_t c)
+{
+    if (c >= L'0' && c <= L'9') {
+        return c - L'0';
+    }
+    if (c >= L'a' && c <= L'f') {
+        return c - L'a' + 10;
+    }
+    if (c >= L'A' && c <= L'F') {
+        return c - L'A' + 10;
+    }
+    return -1;
+}
+
+// parses the json string starting at the quote at \a pos, \a pos is moved behind the closing quote
+bool parseJsonString(const std::wstring &json, size_t &pos, std::wstring &out)
+{
+    out.clear();
+    if (pos >= json.size() || json[pos] != L'"') {
+        return false;
+    }
+    for (++pos; pos < json.size(); ++pos) {
+        auto c = json[pos];
+        if (c == L'"') {
+            ++pos;
+            return true;
+        }
+        if (c != L'\\') {
+            out += c;
+            continue;
+        }
+        if (++pos >= json.size()) {
+            return false;
+        }
+        switch (json[pos]) {
+        case L'b':
+            out += L'\b';
+            break;
+        case L'f':
+            out += L'\f';
+            break;
+        case L'n':
+            out += L'\n';
+            break;
+        case L'r':
+            out += L'\r';
+            break;
+        case L't':
+            out += L'\t';
+            break;
+        case L'u': {
+            if (pos + 4 >= json.size()) {
+                return false;
+            }
+            // no exceptions, the extension must not take down the explorer on a malformed reply
+            wchar_t code = 0;
+            for (size_t i = pos + 1; i <= pos + 4; ++i) {
+                const int digit = hexDigit(json[i]);
+                if (digit < 0) {
+                    return false;
+                }
+                code = static_cast<wchar_t>(code * 16 + digit);
+            }
+            out += code;
+            pos += 4;
+            break;
+        }
+        default:
+            // '"', '\\' and '/'
+            out += json[pos];
+        }
+    }
+    return false;
+}
+}
+
+bool StringUtil::extractJsonStringMap(const std::wstring &json, const std::wstring &key, std::vector<std::pair<std::wstring, std::wstring>> &out)
+{
+    const auto needle = toJsonString(key) + L":{";
+    auto pos = json.find(needle);
+    if (pos == std::wstring::npos) {
+        return false;
+    }
+    pos += needle.size();
+    std::wstring name, value;
+    while (pos < json.size()) {
+        if (json[pos] == L'}') {
+            return true;
+        }
+        if (!parseJsonString(json, pos, name) || pos >= json.size() || json[pos++] != L':' || !parseJsonString(json, pos, value)) {
+            return false;
+        }
+        out.emplace_back(std::move(name), std::move(value));
+        if (pos < json.size() && json[pos] == L',') {
+            ++pos;
+        }
+    }
+    return false;
+}
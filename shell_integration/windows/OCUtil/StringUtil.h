@@ -14,7 +14,10 @@
 #pragma once
 
 #include <windows.h>
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 #include <cassert>
 
 class __declspec(dllexport) StringUtil {
@@ -44,6 +47,60 @@ public:
             && wcsncmp(child, parent, parentLength) == 0;
     }
 
+    /**
+     * Removes \a parent and its descendants from \a paths, a std::set of paths or a std::map keyed by path.
+     * The descendants are sorted right after \a parent, so the other entries are not visited.
+     * Returns the removed paths.
+     */
+    template <class Container>
+    static std::vector<std::wstring> eraseDescendants(Container &paths, const std::wstring &parent)
+    {
+        std::vector<std::wstring> removed;
+        for (auto it = paths.lower_bound(parent); it != paths.end();) {
+            const std::wstring &path = pathOf(*it);
+            if (path.compare(0, parent.size(), parent) != 0) {
+                break;
+            }
+            if (isDescendantOf(path, parent)) {
+                removed.push_back(path);
+                it = paths.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return removed;
+    }
+
+    /** Whether each of the \a separator separated \a paths is a descendant of one of the \a directories */
+    static bool areDescendantsOf(const std::wstring &paths, wchar_t separator, const std::vector<std::wstring> &directories)
+    {
+        size_t start = 0;
+        while (start <= paths.size()) {
+            auto end = paths.find(separator, start);
+            if (end == std::wstring::npos) {
+                end = paths.size();
+            }
+            const auto isDescendant = std::any_of(directories.cbegin(), directories.cend(),
+                [&](const std::wstring &directory) { return isDescendantOf(paths.data() + start, end - start, directory); });
+            if (!isDescendant) {
+                return false;
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+    /** Returns \a str as a quoted json string */
+    static std::wstring toJsonString(const std::wstring &str);
+
+    /**
+     * Extracts the members of the json object \a key, whose values must be strings.
+     *
+     * This is no generic json parser, it only understands the compact replies of the
+     * socket api, e.g. {"id":"1","arguments":{"statuses":{"C:\\a":"OK"}}}
+     */
+    static bool extractJsonStringMap(const std::wstring &json, const std::wstring &key, std::vector<std::pair<std::wstring, std::wstring>> &out);
+
     static bool extractChunks(const std::wstring &source, std::wstring &secondChunk, std::wstring &thirdChunk) {
         auto statusBegin = source.find(L':', 0);
         assert(statusBegin != std::wstring::npos);
@@ -83,4 +140,13 @@ public:
         forthChunk = source.substr(thirdColon + 1);
         return true;
     }
+
+private:
+    static const std::wstring &pathOf(const std::wstring &path) { return path; }
+
+    template <class T>
+    static const std::wstring &pathOf(const std::pair<const std::wstring, T> &entry)
+    {
+        return entry.first;
+    }
 };
@@ -28,15 +28,36 @@
 
 #include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QDataStream>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QNetworkProxy>
+#include <QPointer>
+#include <QProcess>
+#include <QSet>
 #include <QUrl>
 
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <random>
 
 
@@ -44,13 +65,25 @@ using namespace OCC;
 
 namespace {
 
+struct FolderPair
+{
+    QString sourceDir;
+    QString remoteFolder;
+};
+
 struct CmdOptions
 {
-    QString source_dir;
+    // a single pair, unless a batch file was passed
+    QVector<FolderPair> folders;
     QUrl target_url;
     QUrl server_url;
 
-    QString remoteFolder;
+    QString batchFile;
+    int maxParallel = 2;
+    // sync every folder in its own process, see WorkerProcess
+    bool workers = false;
+    // set in a worker process, the local server of the parent
+    QString workerServer;
     QString config_directory;
     QString user;
     QString password;
@@ -64,8 +97,99 @@ struct CmdOptions
     int restartTimes = 3;
     int downlimit = 0;
     int uplimit = 0;
+
+    // override the SyncOptions read from the environment
+    std::optional<int> parallelJobs;
+    bool adaptiveParallel = false;
+    std::optional<qint64> chunkSize;
+    std::optional<qint64> minChunkSize;
+    std::optional<qint64> maxChunkSize;
+    std::optional<std::chrono::milliseconds> targetChunkUploadDuration;
+    std::optional<SyncOptions::PropagationOrder> propagationOrder;
+    bool batchedJournalCommits = false;
+    bool journalSnapshot = false;
+    bool dryRun = false;
+    // sync again after this interval instead of exiting, zero to exit
+    std::chrono::seconds daemonInterval = {};
+
+    QString statsFile;
+};
+
+struct FolderResult
+{
+    bool success = false;
+    std::chrono::milliseconds duration = {};
+    qint64 uploadedBytes = 0;
+    qint64 downloadedBytes = 0;
+    int uploadedFiles = 0;
+    int downloadedFiles = 0;
+    int errors = 0;
+    // the items announced for propagation, by instruction
+    QMap<QString, int> instructions;
+    QJsonObject metrics;
+};
+
+/**
+ * The messages of a worker process to its parent, each one is a WorkerMessage
+ * followed by its values in a QDataStream
+ *
+ * The parent answers the process id the worker sends after connecting with the
+ * index of the folder in the batch, the user and the password.
+ */
+enum class WorkerMessage : quint8 {
+    // the completed files and their bytes so far
+    Progress,
+    // the FolderResult, the last message
+    Result
 };
 
+QDataStream &operator<<(QDataStream &stream, const FolderResult &result)
+{
+    return stream << result.success << static_cast<qint64>(result.duration.count()) << result.uploadedBytes << result.downloadedBytes
+                  << result.uploadedFiles << result.downloadedFiles << result.errors << result.instructions << result.metrics;
+}
+
+QDataStream &operator>>(QDataStream &stream, FolderResult &result)
+{
+    qint64 duration = 0;
+    stream >> result.success >> duration >> result.uploadedBytes >> result.downloadedBytes >> result.uploadedFiles >> result.downloadedFiles
+        >> result.errors >> result.instructions >> result.metrics;
+    result.duration = std::chrono::milliseconds(duration);
+    return stream;
+}
+
+void sendToParent(QLocalSocket *socket, WorkerMessage type, const std::function<void(QDataStream &)> &writeValues)
+{
+    QDataStream stream(socket);
+    stream << static_cast<quint8>(type);
+    writeValues(stream);
+}
+
+/// The peak resident memory of the process in bytes, 0 if unknown
+qint64 peakMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_UNIX)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss;
+#else
+    // in KiB
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
 struct SyncCTX
 {
     explicit SyncCTX(const CmdOptions &cmdOptions)
@@ -77,6 +201,8 @@ struct SyncCTX
     bool promptRemoveAllFiles;
     AccountPtr account;
     QString user;
+    // the connection to the parent in a worker process
+    QLocalSocket *workerSocket = nullptr;
 };
 
 /* If the selective sync list is different from before, we need to disable the read from db
@@ -103,7 +229,40 @@ void selectiveSyncFixup(OCC::SyncJournalDb *journal, const QSet<QString> &newLis
 }
 
 
-void sync(const SyncCTX &ctx)
+void applyTuningOptions(const CmdOptions &options, SyncOptions *opt)
+{
+    if (options.parallelJobs) {
+        opt->_parallelNetworkJobs = *options.parallelJobs;
+        opt->_parallelDiscoveryJobs = *options.parallelJobs;
+    }
+    if (options.adaptiveParallel) {
+        opt->_transferConcurrencyMode = SyncOptions::TransferConcurrencyMode::Adaptive;
+    }
+    if (options.chunkSize) {
+        opt->_initialChunkSize = *options.chunkSize;
+    }
+    if (options.minChunkSize) {
+        opt->_minChunkSize = *options.minChunkSize;
+    }
+    if (options.maxChunkSize) {
+        opt->_maxChunkSize = *options.maxChunkSize;
+    }
+    if (options.targetChunkUploadDuration) {
+        opt->_targetChunkUploadDuration = *options.targetChunkUploadDuration;
+    }
+    if (options.propagationOrder) {
+        opt->_propagationOrder = *options.propagationOrder;
+    }
+    if (options.batchedJournalCommits) {
+        opt->_batchedJournalCommits = true;
+    }
+    if (options.journalSnapshot) {
+        opt->_journalSnapshotDiscovery = true;
+    }
+    opt->_dryRun = options.dryRun;
+}
+
+void sync(const SyncCTX &ctx, const FolderPair &folder, std::function<void(const FolderResult &)> &&done)
 {
     const auto selectiveSyncList = [&]() -> QSet<QString> {
         if (!ctx.options.unsyncedfolders.isEmpty()) {
@@ -128,7 +287,7 @@ void sync(const SyncCTX &ctx)
         return {};
     }();
 
-    const QString dbPath = ctx.options.source_dir + SyncJournalDb::makeDbName(ctx.options.source_dir);
+    const QString dbPath = folder.sourceDir + SyncJournalDb::makeDbName(folder.sourceDir);
     auto db = new SyncJournalDb(dbPath, qApp);
     if (!selectiveSyncList.empty()) {
         selectiveSyncFixup(db, selectiveSyncList);
@@ -136,30 +295,63 @@ void sync(const SyncCTX &ctx)
 
     SyncOptions opt { QSharedPointer<Vfs>(VfsPluginManager::instance().createVfsFromPlugin(Vfs::Off).release()) };
     opt.fillFromEnvironmentVariables();
+    applyTuningOptions(ctx.options, &opt);
     opt.verifyChunkSizes();
-    auto engine = new SyncEngine(
-        ctx.account, ctx.options.target_url, ctx.options.source_dir, ctx.options.remoteFolder, db);
+    auto engine = new SyncEngine(ctx.account, ctx.options.target_url, folder.sourceDir, folder.remoteFolder, db);
     engine->setSyncOptions(opt);
     engine->setParent(db);
 
-    QObject::connect(engine, &SyncEngine::finished, engine, [engine, ctx, restartCount = std::make_shared<int>(0)](bool result) {
-        if (!result) {
-            qWarning() << "Failed to sync";
-            exit(EXIT_FAILURE);
-        } else {
-            if (engine->isAnotherSyncNeeded()) {
-                if (*restartCount < ctx.options.restartTimes) {
+    auto result = std::make_shared<FolderResult>();
+    // includes the restarts
+    auto timer = std::make_shared<QElapsedTimer>();
+    timer->start();
+    QObject::connect(engine, &SyncEngine::itemCompleted, engine, [result, socket = ctx.workerSocket](const SyncFileItemPtr &item) {
+        if (item->hasErrorStatus()) {
+            ++result->errors;
+        } else if (item->_status == SyncFileItem::Success && !item->isDirectory()
+            && item->_instruction & (CSYNC_INSTRUCTION_NEW | CSYNC_INSTRUCTION_SYNC | CSYNC_INSTRUCTION_CONFLICT | CSYNC_INSTRUCTION_TYPE_CHANGE)) {
+            if (item->_direction == SyncFileItem::Up) {
+                ++result->uploadedFiles;
+                result->uploadedBytes += item->_size;
+            } else if (item->_direction == SyncFileItem::Down) {
+                ++result->downloadedFiles;
+                result->downloadedBytes += item->_size;
+            }
+            if (socket) {
+                sendToParent(socket, WorkerMessage::Progress, [&result](QDataStream &stream) {
+                    stream << result->uploadedFiles + result->downloadedFiles << result->uploadedBytes + result->downloadedBytes;
+                });
+            }
+        }
+    });
+
+    QObject::connect(engine, &SyncEngine::aboutToPropagate, engine, [result](const SyncFileItemSet &items) {
+        for (const auto &item : items) {
+            ++result->instructions[Utility::enumToString(item->_instruction)];
+        }
+    });
+
+    QObject::connect(engine, &SyncEngine::finished, engine,
+        [engine, db, result, timer, restartTimes = ctx.options.dryRun ? 0 : ctx.options.restartTimes, restartCount = std::make_shared<int>(0),
+            done = std::move(done)](bool success) {
+            if (!success) {
+                qWarning() << "Failed to sync" << engine->localPath();
+            } else if (engine->isAnotherSyncNeeded()) {
+                if (*restartCount < restartTimes) {
                     (*restartCount)++;
                     qDebug() << "Restarting Sync, because another sync is needed" << *restartCount;
                     engine->startSync();
                     return;
                 }
                 qWarning() << "Another sync is needed, but not done because restart count is exceeded" << *restartCount;
-            } else {
-                qApp->quit();
             }
-        }
-    });
+            // release the journal, a batch can contain many folders
+            db->deleteLater();
+            result->success = success;
+            result->duration = std::chrono::milliseconds(timer->elapsed());
+            result->metrics = engine->lastSyncMetrics().toJson();
+            done(*result);
+        });
     QObject::connect(engine, &SyncEngine::syncError, engine,
         [](const QString &error) { qWarning() << "Sync error:" << error; });
     engine->setIgnoreHiddenFiles(ctx.options.ignoreHiddenFiles);
@@ -187,6 +379,319 @@ void sync(const SyncCTX &ctx)
     engine->startSync();
 }
 
+/**
+ * Syncs one folder of a batch in a child process, see --workers.
+ *
+ * The child runs this executable with the same arguments and --worker. It connects
+ * to the local server of BatchSync, which hands the connection over with setConnection(),
+ * and reports its progress and its FolderResult, see WorkerMessage.
+ * A crash of the child only fails its folder.
+ */
+class WorkerProcess : public QObject
+{
+public:
+    WorkerProcess(const SyncCTX &ctx, qsizetype index, const QString &serverName, std::function<void(const FolderResult &)> &&done, QObject *parent)
+        : QObject(parent)
+        , _ctx(ctx)
+        , _index(index)
+        , _done(std::move(done))
+    {
+        _process.setProcessChannelMode(QProcess::ForwardedChannels);
+        connect(&_process, &QProcess::finished, this, &WorkerProcess::finish);
+        connect(&_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                qWarning() << "Failed to start the worker for" << folder().sourceDir << _process.errorString();
+                finish();
+            }
+        });
+        _process.start(QCoreApplication::applicationFilePath(), QCoreApplication::arguments().mid(1) << QStringLiteral("--worker") << serverName);
+    }
+
+    qint64 processId() const { return _process.processId(); }
+
+    /// Sends the folder and the credentials to the connected child
+    void setConnection(QLocalSocket *socket)
+    {
+        _socket = socket;
+        _socket->setParent(this);
+        connect(_socket, &QLocalSocket::readyRead, this, &WorkerProcess::readMessages);
+        QDataStream stream(_socket);
+        stream << static_cast<qint32>(_index) << _ctx.user << qobject_cast<HttpCredentialsText *>(_ctx.account->credentials())->password();
+    }
+
+private:
+    const FolderPair &folder() const { return _ctx.options.folders.at(_index); }
+
+    void readMessages()
+    {
+        QDataStream stream(_socket);
+        while (!_socket->atEnd()) {
+            stream.startTransaction();
+            quint8 type;
+            stream >> type;
+            switch (static_cast<WorkerMessage>(type)) {
+            case WorkerMessage::Progress: {
+                int files;
+                qint64 bytes;
+                stream >> files >> bytes;
+                if (!stream.commitTransaction()) {
+                    return;
+                }
+                qDebug() << folder().sourceDir << "transferred" << files << "files," << bytes << "bytes";
+                break;
+            }
+            case WorkerMessage::Result: {
+                FolderResult result;
+                stream >> result;
+                if (!stream.commitTransaction()) {
+                    return;
+                }
+                _result = result;
+                break;
+            }
+            default:
+                if (stream.commitTransaction()) {
+                    qWarning() << "Invalid message" << type << "of the worker for" << folder().sourceDir;
+                    _process.kill();
+                }
+                return;
+            }
+        }
+    }
+
+    void finish()
+    {
+        if (_socket) {
+            readMessages();
+        }
+        if (!_result) {
+            qWarning() << "The worker for" << folder().sourceDir << "exited without a result, exit code" << _process.exitCode() << _process.exitStatus();
+        }
+        deleteLater();
+        _done(_result.value_or(FolderResult{}));
+    }
+
+    const SyncCTX &_ctx;
+    const qsizetype _index;
+    std::function<void(const FolderResult &)> _done;
+    QProcess _process;
+    QLocalSocket *_socket = nullptr;
+    std::optional<FolderResult> _result;
+};
+
+/**
+ * Runs the syncs of all folder pairs, up to maxParallel at the same time.
+ *
+ * The folders share the account, so the authentication, the capabilities
+ * and the connections of the access manager are reused, and the transfers
+ * of all engines are limited by the transfer concurrency of the account.
+ * With --workers every folder is synced by a WorkerProcess instead, the folders
+ * then use their own account and can use a core each.
+ */
+class BatchSync : public QObject
+{
+public:
+    explicit BatchSync(const SyncCTX &ctx)
+        : QObject(qApp)
+        , _ctx(ctx)
+        , _results(ctx.options.folders.size())
+    {
+        if (_ctx.options.workers) {
+            _server = new QLocalServer(this);
+            // the password is sent to the workers
+            _server->setSocketOptions(QLocalServer::UserAccessOption);
+            const QString name = QStringLiteral("%1cmd-%2").arg(Theme::instance()->appName(), QString::number(QCoreApplication::applicationPid()));
+            QLocalServer::removeServer(name);
+            if (!_server->listen(name)) {
+                qCritical() << "Cannot listen for the workers:" << _server->errorString();
+                exit(EXIT_FAILURE);
+            }
+            connect(_server, &QLocalServer::newConnection, this, &BatchSync::acceptWorkers);
+        }
+    }
+
+    void start()
+    {
+        _timer.start();
+        while (_running < _ctx.options.maxParallel && _next < _ctx.options.folders.size()) {
+            startNext();
+        }
+    }
+
+private:
+    void startNext()
+    {
+        const auto index = _next++;
+        ++_running;
+        auto done = [this, index](const FolderResult &result) {
+            _results[index] = result;
+            --_running;
+            if (_next < _ctx.options.folders.size()) {
+                startNext();
+            } else if (_running == 0) {
+                finish();
+            }
+        };
+        if (_server) {
+            _workers.append(new WorkerProcess(_ctx, index, _server->fullServerName(), std::move(done), this));
+        } else {
+            sync(_ctx, _ctx.options.folders.at(index), std::move(done));
+        }
+    }
+
+    // a worker identifies itself with its process id
+    void acceptWorkers()
+    {
+        while (auto *socket = _server->nextPendingConnection()) {
+            connect(socket, &QLocalSocket::readyRead, this, [this, socket] {
+                QDataStream stream(socket);
+                stream.startTransaction();
+                qint64 pid;
+                stream >> pid;
+                if (!stream.commitTransaction()) {
+                    return;
+                }
+                disconnect(socket, &QLocalSocket::readyRead, this, nullptr);
+                const auto it = std::find_if(_workers.cbegin(), _workers.cend(), [pid](const auto &worker) { return worker && worker->processId() == pid; });
+                if (it == _workers.cend()) {
+                    qWarning() << "Connection of an unknown worker" << pid;
+                    socket->deleteLater();
+                    return;
+                }
+                (*it)->setConnection(socket);
+            });
+        }
+    }
+
+    void finish()
+    {
+        const bool success = std::all_of(_results.cbegin(), _results.cend(), [](const FolderResult &result) { return result.success; });
+        _workers.clear();
+        if (_ctx.workerSocket) {
+            sendToParent(_ctx.workerSocket, WorkerMessage::Result, [this](QDataStream &stream) { stream << _results.constFirst(); });
+            _ctx.workerSocket->waitForBytesWritten();
+            qApp->exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+            return;
+        }
+        if (!_ctx.options.batchFile.isEmpty()) {
+            for (qsizetype i = 0; i < _results.size(); ++i) {
+                const auto &folder = _ctx.options.folders.at(i);
+                std::cout << (_results.at(i).success ? "OK" : "FAILED") << '\t' << qPrintable(folder.sourceDir) << '\t' << qPrintable(folder.remoteFolder)
+                          << std::endl;
+            }
+        }
+        if (!_ctx.options.statsFile.isEmpty()) {
+            writeStats();
+        }
+        if (_ctx.options.daemonInterval.count() > 0) {
+            // the local changes are found by the local discovery of the next run, there is no file system watcher
+            qInfo() << "Sync" << (success ? "succeeded" : "failed") << ", syncing again in" << _ctx.options.daemonInterval;
+            _results.fill({});
+            _next = 0;
+            QTimer::singleShot(_ctx.options.daemonInterval, this, &BatchSync::start);
+            return;
+        }
+        qApp->exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    // the throughput is computed from the wall clock time, of all folders for the totals
+    void writeStats() const
+    {
+        const auto toJson = [](const FolderResult &result, qint64 durationMs) {
+            const qint64 bytes = result.uploadedBytes + result.downloadedBytes;
+            QJsonObject instructions;
+            for (auto it = result.instructions.cbegin(); it != result.instructions.cend(); ++it) {
+                instructions.insert(it.key(), it.value());
+            }
+            return QJsonObject{{QStringLiteral("instructions"), instructions},{QStringLiteral("success"), result.success}, {QStringLiteral("durationMs"), durationMs},
+                {QStringLiteral("uploadedBytes"), result.uploadedBytes}, {QStringLiteral("downloadedBytes"), result.downloadedBytes},
+                {QStringLiteral("uploadedFiles"), result.uploadedFiles}, {QStringLiteral("downloadedFiles"), result.downloadedFiles},
+                {QStringLiteral("errors"), result.errors}, {QStringLiteral("bytesPerSecond"), durationMs > 0 ? bytes * 1000 / durationMs : 0}};
+        };
+        QJsonArray folders;
+        FolderResult total;
+        total.success = true;
+        for (qsizetype i = 0; i < _results.size(); ++i) {
+            const auto &result = _results.at(i);
+            auto json = toJson(result, result.duration.count());
+            json.insert(QStringLiteral("sourceDir"), _ctx.options.folders.at(i).sourceDir);
+            json.insert(QStringLiteral("remoteFolder"), _ctx.options.folders.at(i).remoteFolder);
+            json.insert(QStringLiteral("metrics"), result.metrics);
+            folders.append(json);
+
+            total.success = total.success && result.success;
+            total.uploadedBytes += result.uploadedBytes;
+            total.downloadedBytes += result.downloadedBytes;
+            total.uploadedFiles += result.uploadedFiles;
+            total.downloadedFiles += result.downloadedFiles;
+            total.errors += result.errors;
+            for (auto it = result.instructions.cbegin(); it != result.instructions.cend(); ++it) {
+                total.instructions[it.key()] += it.value();
+            }
+        }
+        auto json = toJson(total, _timer.elapsed());
+        json.insert(QStringLiteral("folders"), folders);
+        json.insert(QStringLiteral("dryRun"), _ctx.options.dryRun);
+        json.insert(QStringLiteral("peakMemoryBytes"), peakMemory());
+        const QByteArray data = QJsonDocument(json).toJson();
+
+        if (_ctx.options.statsFile == QLatin1String("-")) {
+            std::cout << data.constData() << std::flush;
+            return;
+        }
+        QFile f(_ctx.options.statsFile);
+        if (!f.open(QFile::WriteOnly) || f.write(data) != data.size()) {
+            qCritical() << "Failed to write the statistics to" << _ctx.options.statsFile << f.errorString();
+        }
+    }
+
+    const SyncCTX _ctx;
+    QVector<FolderResult> _results;
+    QElapsedTimer _timer;
+    qsizetype _next = 0;
+    int _running = 0;
+    QLocalServer *_server = nullptr;
+    QVector<QPointer<WorkerProcess>> _workers;
+};
+
+/// Receives the folder and the credentials from the parent of a worker process, see WorkerProcess
+void connectToParent(SyncCTX &ctx)
+{
+    auto *socket = new QLocalSocket(qApp);
+    socket->connectToServer(ctx.options.workerServer);
+    if (!socket->waitForConnected()) {
+        qCritical() << "Cannot connect to the parent process:" << socket->errorString();
+        exit(EXIT_FAILURE);
+    }
+    QDataStream stream(socket);
+    stream << static_cast<qint64>(QCoreApplication::applicationPid());
+    qint32 index = -1;
+    QString user;
+    QString password;
+    do {
+        if (!socket->waitForReadyRead()) {
+            qCritical() << "The parent process did not answer:" << socket->errorString();
+            exit(EXIT_FAILURE);
+        }
+        stream.startTransaction();
+        stream >> index >> user >> password;
+    } while (!stream.commitTransaction());
+    if (index < 0 || index >= ctx.options.folders.size()) {
+        qCritical() << "Invalid folder index" << index << "from the parent process";
+        exit(EXIT_FAILURE);
+    }
+
+    // sync the one folder, the parent prints and writes the results
+    ctx.options.folders = {ctx.options.folders.at(index)};
+    ctx.options.user = user;
+    ctx.options.password = password;
+    ctx.options.interactive = false;
+    ctx.options.batchFile.clear();
+    ctx.options.statsFile.clear();
+    ctx.options.daemonInterval = {};
+    ctx.workerSocket = socket;
+}
+
 void setupCredentials(SyncCTX &ctx)
 {
     // Order of retrieval attempt (later attempts override earlier ones):
@@ -263,6 +768,52 @@ void setupCredentials(SyncCTX &ctx)
         });
     }
 }
+
+QString absoluteSourceDir(const QString &arg)
+{
+    const QFileInfo fi(arg);
+    if (!fi.exists()) {
+        qCritical() << "Source dir" << arg << "does not exist.";
+        exit(EXIT_FAILURE);
+    }
+    QString sourceDir = fi.absoluteFilePath();
+    if (!sourceDir.endsWith(QLatin1Char('/'))) {
+        sourceDir.append(QLatin1Char('/'));
+    }
+    return sourceDir;
+}
+
+/// Reads the lines "source_dir<TAB>remote_folder" of a batch file, empty lines and comments are skipped
+QVector<FolderPair> readBatchFile(const QString &path)
+{
+    QFile f(path);
+    if (!f.open(QFile::ReadOnly)) {
+        qCritical() << "Cannot read batch file '" << path << "': " << f.errorString();
+        exit(EXIT_FAILURE);
+    }
+    QVector<FolderPair> folders;
+    QSet<QString> sourceDirs;
+    for (const auto &line : QString::fromUtf8(f.readAll()).split(QLatin1Char('\n'))) {
+        const QString trimmed = line.trimmed();
+        if (trimmed.isEmpty() || trimmed.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        const auto fields = trimmed.split(QLatin1Char('\t'));
+        FolderPair folder{absoluteSourceDir(fields.at(0)), fields.value(1)};
+        if (sourceDirs.contains(folder.sourceDir)) {
+            // the journal can't be shared
+            qCritical() << "Source dir" << folder.sourceDir << "is listed more than once in the batch file.";
+            exit(EXIT_FAILURE);
+        }
+        sourceDirs.insert(folder.sourceDir);
+        folders.append(std::move(folder));
+    }
+    if (folders.isEmpty()) {
+        qCritical() << "The batch file" << path << "contains no folders.";
+        exit(EXIT_FAILURE);
+    }
+    return folders;
+}
 }
 
 CmdOptions parseOptions(const QStringList &app_args)
@@ -297,6 +848,31 @@ CmdOptions parseOptions(const QStringList &app_args)
     auto downloadLimitption = addOption({ { QStringLiteral("downlimit") }, QStringLiteral("Limit the download speed of files to n KB/s"), QStringLiteral("n") });
     auto syncHiddenFilesOption = addOption({ { QStringLiteral("sync-hidden-files") }, QStringLiteral("Enables synchronization of hidden files") });
 
+    auto batchOption = addOption({{QStringLiteral("batch")},
+        QStringLiteral("Sync the folders listed in [file], one \"source_dir<TAB>remote_folder\" per line. Only the server_url is passed as argument"),
+        QStringLiteral("file")});
+    auto parallelJobsOption = addOption({{QStringLiteral("parallel-jobs")}, QStringLiteral("Run up to n network jobs in parallel (default to 6)"), QStringLiteral("n")});
+    auto adaptiveParallelOption = addOption({{QStringLiteral("adaptive-parallel")}, QStringLiteral("Adjust the number of parallel transfers to the throughput")});
+    auto chunkSizeOption = addOption({{QStringLiteral("chunk-size")}, QStringLiteral("The initial upload chunk size in bytes"), QStringLiteral("bytes")});
+    auto minChunkSizeOption = addOption({{QStringLiteral("min-chunk-size")}, QStringLiteral("The minimum upload chunk size in bytes"), QStringLiteral("bytes")});
+    auto maxChunkSizeOption = addOption({{QStringLiteral("max-chunk-size")}, QStringLiteral("The maximum upload chunk size in bytes"), QStringLiteral("bytes")});
+    auto targetChunkDurationOption = addOption({{QStringLiteral("target-chunk-duration")},
+        QStringLiteral("Adjust the chunk size to upload a chunk in about ms milliseconds, 0 keeps the initial size"), QStringLiteral("ms")});
+    auto propagationOrderOption = addOption({{QStringLiteral("propagation-order")},
+        QStringLiteral("Propagate the files in path order, the recently modified or the smallest first"), QStringLiteral("path|recent|smallest")});
+    auto batchedCommitsOption = addOption(
+        {{QStringLiteral("batched-journal-commits")}, QStringLiteral("Commit the journal in batches, the latest changes are lost on a crash")});
+    auto journalSnapshotOption = addOption({{QStringLiteral("journal-snapshot")}, QStringLiteral("Read the journal into memory for the discovery")});
+    auto statsOption = addOption(
+        {{QStringLiteral("stats")}, QStringLiteral("Write the transfer statistics as JSON to [file] when done, - for the standard output"), QStringLiteral("file")});
+    auto dryRunOption = addOption({{QStringLiteral("dry-run")},
+        QStringLiteral("Only run the discovery, nothing is changed. The statistics are written to the standard output unless --stats is passed")});
+    auto maxParallelOption = addOption({{QStringLiteral("max-parallel")}, QStringLiteral("Sync up to n folders of a batch at the same time (default to 2)"), QStringLiteral("n")});
+    auto workersOption = addOption({{QStringLiteral("workers")}, QStringLiteral("Sync every folder of a batch in its own process")});
+    auto workerOption = addOption({{QStringLiteral("worker")}, QStringLiteral("Internal: sync a folder for the process listening on [server]"), QStringLiteral("server")},
+        QCommandLineOption::HiddenFromHelp);
+    auto daemonOption = addOption({{QStringLiteral("daemon")}, QStringLiteral("Keep running and sync again every n seconds"), QStringLiteral("n")});
+
     auto logdebugOption = addOption({ { QStringLiteral("logdebug") }, QStringLiteral("More verbose logging") });
 
     const auto testCrashReporter =
@@ -313,25 +889,76 @@ CmdOptions parseOptions(const QStringList &app_args)
 
 
     const QStringList args = parser.positionalArguments();
-    if (args.size() < 2 || args.size() > 3) {
-        parser.showHelp(EXIT_FAILURE);
+    if (parser.isSet(batchOption)) {
+        // only the server_url is passed, the folders are listed in the file
+        if (args.size() != 1) {
+            parser.showHelp(EXIT_FAILURE);
+        }
+        options.batchFile = parser.value(batchOption);
+        options.folders = readBatchFile(options.batchFile);
+        options.target_url = QUrl::fromUserInput(args[0]);
+    } else {
+        if (args.size() < 2 || args.size() > 3) {
+            parser.showHelp(EXIT_FAILURE);
+        }
+        options.folders.append({absoluteSourceDir(args[0]), args.value(2)});
+        options.target_url = QUrl::fromUserInput(args[1]);
     }
-
-    options.source_dir = [arg = args[0]] {
-        const QFileInfo fi(arg);
-        if (!fi.exists()) {
-            qCritical() << "Source dir" << arg << "does not exist.";
+    if (parser.isSet(maxParallelOption)) {
+        options.maxParallel = std::max(1, parser.value(maxParallelOption).toInt());
+    }
+    if (parser.isSet(workerOption)) {
+        // the worker got the arguments of its parent, it doesn't start workers itself
+        options.workerServer = parser.value(workerOption);
+    } else {
+        options.workers = parser.isSet(workersOption);
+    }
+    const auto positiveValue = [&parser](const QCommandLineOption &option) {
+        bool ok;
+        const qint64 value = parser.value(option).toLongLong(&ok);
+        if (!ok || value < 0) {
+            qCritical() << "Invalid value for" << option.names().constFirst() << parser.value(option);
             exit(EXIT_FAILURE);
         }
-        QString sourceDir = fi.absoluteFilePath();
-        if (!sourceDir.endsWith(QLatin1Char('/'))) {
-            sourceDir.append(QLatin1Char('/'));
+        return value;
+    };
+    if (parser.isSet(parallelJobsOption)) {
+        options.parallelJobs = static_cast<int>(std::max<qint64>(1, positiveValue(parallelJobsOption)));
+    }
+    options.adaptiveParallel = parser.isSet(adaptiveParallelOption);
+    if (parser.isSet(chunkSizeOption)) {
+        options.chunkSize = positiveValue(chunkSizeOption);
+    }
+    if (parser.isSet(minChunkSizeOption)) {
+        options.minChunkSize = positiveValue(minChunkSizeOption);
+    }
+    if (parser.isSet(maxChunkSizeOption)) {
+        options.maxChunkSize = positiveValue(maxChunkSizeOption);
+    }
+    if (parser.isSet(targetChunkDurationOption)) {
+        options.targetChunkUploadDuration = std::chrono::milliseconds(positiveValue(targetChunkDurationOption));
+    }
+    if (parser.isSet(propagationOrderOption)) {
+        options.propagationOrder = SyncOptions::propagationOrderFromName(parser.value(propagationOrderOption));
+        if (!options.propagationOrder) {
+            qCritical() << "Invalid value for" << propagationOrderOption.names().constFirst() << parser.value(propagationOrderOption);
+            exit(EXIT_FAILURE);
         }
-        return sourceDir;
-    }();
-    options.target_url = QUrl::fromUserInput(args[1]);
-    if (args.size() == 3) {
-        options.remoteFolder = args[2];
+    }
+    options.batchedJournalCommits = parser.isSet(batchedCommitsOption);
+    options.journalSnapshot = parser.isSet(journalSnapshotOption);
+    options.dryRun = parser.isSet(dryRunOption);
+    if (parser.isSet(daemonOption)) {
+        options.daemonInterval = std::chrono::seconds(std::max<qint64>(1, positiveValue(daemonOption)));
+    }
+    if (options.daemonInterval.count() > 0 && options.dryRun) {
+        qCritical() << "--daemon can't be combined with --dry-run";
+        exit(EXIT_FAILURE);
+    }
+    if (parser.isSet(statsOption)) {
+        options.statsFile = parser.value(statsOption);
+    } else if (options.dryRun) {
+        options.statsFile = QStringLiteral("-");
     }
 
     if (parser.isSet(httpproxyOption)) {
@@ -408,6 +1035,10 @@ int main(int argc, char **argv)
             qSetMessagePattern(Logger::loggerPattern());
         }
 
+        if (!ctx.options.workerServer.isEmpty()) {
+            connectToParent(ctx);
+        }
+
         ctx.account = Account::create(QUuid::createUuid());
 
         if (!ctx.account) {
@@ -478,9 +1109,12 @@ int main(int argc, char **argv)
                             }
                         }
 
-                        // much lower age than the default since this utility is usually made to be run right after a change in the tests
-                        SyncEngine::minimumFileAgeForUpload = std::chrono::seconds(0);
-                        sync(ctx);
+                        // much lower age than the default since this utility is usually made to be run right after a change in the tests,
+                        // a daemon keeps the default to not upload files that are still being written
+                        if (ctx.options.daemonInterval.count() == 0) {
+                            SyncEngine::minimumFileAgeForUpload = std::chrono::seconds(0);
+                        }
+                        (new BatchSync(ctx))->start();
                     });
                     userJob->start();
                 });
@@ -27,6 +27,9 @@ public:
 
     void askFromUser() override;
 
+    /** The password, passed on to the worker processes of a batch */
+    QString password() const { return _password; }
+
 private:
     HttpCredentialsText(const QString &user, const QString &password);
 };
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "libsync/httplogger.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QUuid>
+
+#include <iostream>
+
+using namespace OCC;
+
+namespace {
+QString verbName(uint8_t verb)
+{
+    const auto &verbs = HttpLogger::traceVerbs();
+    return verb > 0 && verb <= verbs.size() ? QString::fromLatin1(verbs.at(verb - 1)) : QStringLiteral("OTHER");
+}
+
+QString flagNames(uint8_t flags)
+{
+    QStringList out;
+    out << (flags & HttpLogger::TraceRecord::Http2 ? QStringLiteral("HTTP/2") : QStringLiteral("HTTP/1.1"));
+    if (flags & HttpLogger::TraceRecord::Cached) {
+        out << QStringLiteral("cached");
+    }
+    if (flags & HttpLogger::TraceRecord::Redirected) {
+        out << QStringLiteral("redirected");
+    }
+    if (flags & HttpLogger::TraceRecord::Error) {
+        out << QStringLiteral("error");
+    }
+    return out.join(QLatin1Char(','));
+}
+
+bool dump(const QString &path, bool csv)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << qPrintable(path) << ": " << qPrintable(file.errorString()) << std::endl;
+        return false;
+    }
+    HttpLogger::TraceHeader header;
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header) || header.magic != HttpLogger::TraceHeader::Magic) {
+        std::cerr << qPrintable(path) << ": not a http trace" << std::endl;
+        return false;
+    }
+    if (header.version != HttpLogger::TraceHeader::Version || header.recordSize != sizeof(HttpLogger::TraceRecord)) {
+        std::cerr << qPrintable(path) << ": unsupported trace version " << header.version << std::endl;
+        return false;
+    }
+
+    if (csv) {
+        std::cout << "start,request_id,verb,url_hash,status,network_error,flags,queued_ms,duration_ms,request_size,reply_size" << std::endl;
+    }
+    HttpLogger::TraceRecord record;
+    while (file.read(reinterpret_cast<char *>(&record), sizeof(record)) == sizeof(record)) {
+        const QString fields[] = {QDateTime::fromMSecsSinceEpoch(record.startTime).toString(Qt::ISODateWithMs),
+            QUuid::fromRfc4122(QByteArrayView(reinterpret_cast<const char *>(record.requestId), sizeof(record.requestId))).toString(QUuid::WithoutBraces),
+            verbName(record.verb), QString::number(record.urlHash, 16).rightJustified(16, QLatin1Char('0')), QString::number(record.httpStatus),
+            QString::number(record.networkError), flagNames(record.flags), QString::number(record.queuedDuration), QString::number(record.duration),
+            QString::number(record.requestSize), QString::number(record.replySize)};
+        QStringList line(std::begin(fields), std::end(fields));
+        if (csv) {
+            // the flags contain commas
+            line[6] = QLatin1Char('"') + line[6] + QLatin1Char('"');
+            std::cout << qPrintable(line.join(QLatin1Char(','))) << '\n';
+        } else {
+            std::cout << qPrintable(line.join(QLatin1Char(' '))) << '\n';
+        }
+    }
+    std::cout.flush();
+    return true;
+}
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Decodes the http traces written if OWNCLOUD_HTTP_TRACE_FILE is set."));
+    parser.addHelpOption();
+    const QCommandLineOption csvOption({QStringLiteral("csv")}, QStringLiteral("Print comma separated values"));
+    const QCommandLineOption hashOption({QStringLiteral("hash")}, QStringLiteral("Print the hash used in the trace for [url]"), QStringLiteral("url"));
+    parser.addOption(csvOption);
+    parser.addOption(hashOption);
+    parser.addPositionalArgument(QStringLiteral("trace"), QStringLiteral("The trace files to decode"), QStringLiteral("[trace...]"));
+    parser.process(app);
+
+    for (const auto &url : parser.values(hashOption)) {
+        std::cout << qPrintable(QString::number(HttpLogger::traceUrlHash(QUrl(url)), 16).rightJustified(16, QLatin1Char('0'))) << " "
+                  << qPrintable(url) << std::endl;
+    }
+
+    bool ok = true;
+    for (const auto &path : parser.positionalArguments()) {
+        ok &= dump(path, parser.isSet(csvOption));
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
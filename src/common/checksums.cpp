@@ -29,6 +29,12 @@
 
 #include <zlib.h>
 
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
 /** \file checksums.cpp
  *
  * \brief Computing and validating file checksums
@@ -88,24 +94,41 @@
 
 namespace {
 
-QByteArray calcAdler32(QIODevice *device)
+// QCryptographicHash::addData(QIODevice *) reads in small chunks, which
+// costs a lot of read calls for large files
+constexpr qint64 ChecksumBufferSize = 1024 * 1024; // 1 MiB
+
+/**
+ * Reads the remaining data of device and passes it to consume in chunks
+ *
+ * Files are not mapped into memory: they might get truncated while we read
+ * them, which would crash us on access.
+ */
+template <typename F>
+bool readChunks(QIODevice *device, F &&consume)
 {
-    const qint64 BUFSIZE(500 * 1024); // 500 KiB
-    if (device->size() == 0) {
-        return QByteArray();
+#ifdef Q_OS_LINUX
+    if (auto file = qobject_cast<QFile *>(device)) {
+        if (file->handle() != -1) {
+            // allow the kernel to read ahead more aggressively
+            posix_fadvise(file->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
     }
-    QByteArray buf(BUFSIZE, Qt::Uninitialized);
-
-    unsigned int adler = adler32(0L, Z_NULL, 0);
-    qint64 size;
+#endif
+    QByteArray buf(ChecksumBufferSize, Qt::Uninitialized);
     while (!device->atEnd()) {
-        size = device->read(buf.data(), BUFSIZE);
-        if (size > 0)
-            adler = adler32(adler, (const Bytef *)buf.data(), size);
+        const qint64 size = device->read(buf.data(), ChecksumBufferSize);
+        if (size < 0) {
+            return false;
+        }
+        if (size == 0) {
+            break;
+        }
+        consume(QByteArrayView(buf.constData(), size));
     }
-
-    return QByteArray::number(adler, 16);
+    return true;
 }
+
 }
 
 namespace OCC {
@@ -113,6 +136,67 @@ namespace OCC {
 Q_LOGGING_CATEGORY(lcChecksums, "sync.checksums", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcChecksumsHeader, "sync.checksums.header", QtInfoMsg)
 
+ChecksumCalculator::ChecksumCalculator(CheckSums::Algorithm algorithm)
+    : _algorithm(algorithm)
+{
+    switch (algorithm) {
+    case CheckSums::Algorithm::SHA3_256:
+        [[fallthrough]];
+    case CheckSums::Algorithm::SHA256:
+        [[fallthrough]];
+    case CheckSums::Algorithm::SHA1:
+        [[fallthrough]];
+    case CheckSums::Algorithm::MD5:
+        _crypto = std::make_unique<QCryptographicHash>(static_cast<QCryptographicHash::Algorithm>(algorithm));
+        break;
+    case CheckSums::Algorithm::ADLER32:
+        _adler = adler32(0L, Z_NULL, 0);
+        break;
+    case CheckSums::Algorithm::DUMMY_FOR_TESTS:
+        [[fallthrough]];
+    case CheckSums::Algorithm::PARSE_ERROR:
+        break;
+    case CheckSums::Algorithm::NONE:
+        Q_UNREACHABLE();
+    }
+}
+
+void ChecksumCalculator::addData(QByteArrayView data)
+{
+    _size += data.size();
+    if (_crypto) {
+        _crypto->addData(data);
+    } else if (_algorithm == CheckSums::Algorithm::ADLER32) {
+        _adler = adler32(_adler, reinterpret_cast<const Bytef *>(data.data()), static_cast<uInt>(data.size()));
+    }
+}
+
+QByteArray ChecksumCalculator::result() const
+{
+    switch (_algorithm) {
+    case CheckSums::Algorithm::SHA3_256:
+        [[fallthrough]];
+    case CheckSums::Algorithm::SHA256:
+        [[fallthrough]];
+    case CheckSums::Algorithm::SHA1:
+        [[fallthrough]];
+    case CheckSums::Algorithm::MD5:
+        return _crypto->result().toHex();
+    case CheckSums::Algorithm::ADLER32:
+        if (_size == 0) {
+            return {};
+        }
+        return QByteArray::number(static_cast<uint>(_adler), 16);
+    case CheckSums::Algorithm::DUMMY_FOR_TESTS:
+        return QByteArrayLiteral("0x1");
+    case CheckSums::Algorithm::PARSE_ERROR:
+        return {};
+    case CheckSums::Algorithm::NONE:
+        Q_UNREACHABLE();
+    }
+    Q_UNREACHABLE();
+}
+
 ChecksumHeader ChecksumHeader::parseChecksumHeader(const QByteArray &header)
 {
     if (header.isEmpty()) {
@@ -291,41 +375,56 @@ QByteArray ComputeChecksum::computeNowOnFile(const QString &filePath, CheckSums:
     return computeNow(&file, checksumType);
 }
 
+QVector<QByteArray> ComputeChecksum::computeNowOnFile(const QString &filePath, const QVector<CheckSums::Algorithm> &algorithms)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcChecksums) << "Could not open file" << filePath << "for reading and computing checksum" << file.errorString();
+        return QVector<QByteArray>(algorithms.size());
+    }
+
+    return computeNow(&file, algorithms);
+}
+
 QByteArray ComputeChecksum::computeNow(QIODevice *device, CheckSums::Algorithm algorithm)
+{
+    return computeNow(device, QVector<CheckSums::Algorithm>{algorithm}).first();
+}
+
+QVector<QByteArray> ComputeChecksum::computeNow(QIODevice *device, const QVector<CheckSums::Algorithm> &algorithms)
 {
     // const cast to prevent stream to "device"
-    const auto log = qScopeGuard([device, algorithm, timer = Utility::ChronoElapsedTimer()] {
+    const auto log = qScopeGuard([device, &algorithms, timer = Utility::ChronoElapsedTimer()] {
         if (auto file = qobject_cast<QFile *>(device)) {
-            qCDebug(lcChecksums) << "Finished" << algorithm << "computation for" << file->fileName() << timer.duration();
+            qCDebug(lcChecksums) << "Finished" << algorithms << "computation for" << file->fileName() << timer.duration();
         } else {
-            qCDebug(lcChecksums) << "Finished" << algorithm << "computation for" << device << timer.duration();
+            qCDebug(lcChecksums) << "Finished" << algorithms << "computation for" << device << timer.duration();
         }
     });
-    switch (algorithm) {
-    case CheckSums::Algorithm::SHA3_256:
-        [[fallthrough]];
-    case CheckSums::Algorithm::SHA256:
-        [[fallthrough]];
-    case CheckSums::Algorithm::SHA1:
-        [[fallthrough]];
-    case CheckSums::Algorithm::MD5: {
-        QCryptographicHash crypto(static_cast<QCryptographicHash::Algorithm>(algorithm));
-        if (crypto.addData(device)) {
-            return crypto.result().toHex();
-        }
-        qCWarning(lcChecksums) << "Failed to compoute checksum" << Utility::enumToString(algorithm);
-        return {};
+
+    std::vector<ChecksumCalculator> calculators;
+    calculators.reserve(algorithms.size());
+    bool needsData = false;
+    for (const auto algorithm : algorithms) {
+        calculators.emplace_back(algorithm);
+        needsData |= algorithm != CheckSums::Algorithm::DUMMY_FOR_TESTS && algorithm != CheckSums::Algorithm::PARSE_ERROR;
     }
-    case CheckSums::Algorithm::ADLER32:
-        return calcAdler32(device);
-    case CheckSums::Algorithm::DUMMY_FOR_TESTS:
-        return QByteArrayLiteral("0x1");
-    case CheckSums::Algorithm::PARSE_ERROR:
-        return {};
-    case CheckSums::Algorithm::NONE:
-        Q_UNREACHABLE();
+
+    QVector<QByteArray> out;
+    out.reserve(algorithms.size());
+    if (needsData && !readChunks(device, [&calculators](QByteArrayView data) {
+            for (auto &calculator : calculators) {
+                calculator.addData(data);
+            }
+        })) {
+        qCWarning(lcChecksums) << "Failed to compoute checksum" << algorithms;
+        out.resize(algorithms.size());
+        return out;
     }
-    Q_UNREACHABLE();
+    for (const auto &calculator : calculators) {
+        out.append(calculator.result());
+    }
+    return out;
 }
 
 void ComputeChecksum::slotCalculationDone()
@@ -344,17 +443,25 @@ ValidateChecksumHeader::ValidateChecksumHeader(QObject *parent)
 {
 }
 
-ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+bool ValidateChecksumHeader::parseExpectedChecksum(const QByteArray &checksumHeader)
 {
     // If the incoming header is empty no validation can happen. Just continue.
     if (checksumHeader.isEmpty()) {
         Q_EMIT validated(CheckSums::Algorithm::PARSE_ERROR, QByteArray());
-        return nullptr;
+        return false;
     }
     _expectedChecksum = ChecksumHeader::parseChecksumHeader(checksumHeader);
     if (!_expectedChecksum.isValid()) {
         qCWarning(lcChecksums) << "Checksum header malformed:" << checksumHeader;
         Q_EMIT validationFailed(_expectedChecksum.error());
+        return false;
+    }
+    return true;
+}
+
+ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+{
+    if (!parseExpectedChecksum(checksumHeader)) {
         return nullptr;
     }
 
@@ -377,6 +484,13 @@ void ValidateChecksumHeader::start(std::unique_ptr<QIODevice> device, const QByt
         calculator->start(std::move(device));
 }
 
+void ValidateChecksumHeader::validate(const QByteArray &checksumHeader, const QByteArray &checksum)
+{
+    if (parseExpectedChecksum(checksumHeader)) {
+        slotChecksumCalculated(_expectedChecksum.type(), checksum);
+    }
+}
+
 void ValidateChecksumHeader::slotChecksumCalculated(CheckSums::Algorithm checksumType,
     const QByteArray &checksum)
 {
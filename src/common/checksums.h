@@ -25,6 +25,7 @@
 #include <QCryptographicHash>
 #include <QFutureWatcher>
 #include <QObject>
+#include <QVector>
 
 #include <memory>
 
@@ -80,6 +81,33 @@ private:
 /// Checks OWNCLOUD_DISABLE_CHECKSUM_UPLOAD
 OCSYNC_EXPORT bool uploadChecksumEnabled();
 
+/**
+ * Computes a checksum incrementally from data that is passed in piece by piece.
+ * \ingroup libsync
+ */
+class OCSYNC_EXPORT ChecksumCalculator
+{
+public:
+    explicit ChecksumCalculator(CheckSums::Algorithm algorithm);
+
+    CheckSums::Algorithm algorithm() const { return _algorithm; }
+
+    void addData(QByteArrayView data);
+
+    /**
+     * The hex encoded checksum of all data added so far.
+     *
+     * Like computeNow() an Adler32 checksum of no data is empty.
+     */
+    QByteArray result() const;
+
+private:
+    CheckSums::Algorithm _algorithm;
+    std::unique_ptr<QCryptographicHash> _crypto;
+    unsigned long _adler = 0;
+    qint64 _size = 0;
+};
+
 /**
  * Computes the checksum of a file.
  * \ingroup libsync
@@ -120,11 +148,24 @@ public:
      */
     static QByteArray computeNow(QIODevice *device, CheckSums::Algorithm algo);
 
+    /**
+     * Computes the checksums of several algorithms synchronously with a single
+     * read of the device.
+     *
+     * The results are in the order of \a algorithms, on a read error they are all empty.
+     */
+    static QVector<QByteArray> computeNow(QIODevice *device, const QVector<CheckSums::Algorithm> &algorithms);
+
     /**
      * Computes the checksum synchronously on file. Convenience wrapper for computeNow().
      */
     static QByteArray computeNowOnFile(const QString &filePath, CheckSums::Algorithm checksumType);
 
+    /**
+     * Computes several checksums synchronously on file. Convenience wrapper for computeNow().
+     */
+    static QVector<QByteArray> computeNowOnFile(const QString &filePath, const QVector<CheckSums::Algorithm> &algorithms);
+
 Q_SIGNALS:
     void done(CheckSums::Algorithm checksumType, const QByteArray &checksum);
 
@@ -169,6 +210,15 @@ public:
      */
     void start(std::unique_ptr<QIODevice> device, const QByteArray &checksumHeader);
 
+    /**
+     * Check an already computed checksum against the provided checksumHeader
+     *
+     * Like start() but for a checksum that was computed while the data was
+     * received, \a checksum must be of the type of the header.
+     * The signals are emitted before this function returns.
+     */
+    void validate(const QByteArray &checksumHeader, const QByteArray &checksum);
+
 Q_SIGNALS:
     void validated(CheckSums::Algorithm checksumType, const QByteArray &checksum);
     void validationFailed(const QString &errMsg);
@@ -177,6 +227,7 @@ private Q_SLOTS:
     void slotChecksumCalculated(CheckSums::Algorithm checksumType, const QByteArray &checksum);
 
 private:
+    bool parseExpectedChecksum(const QByteArray &checksumHeader);
     ComputeChecksum *prepareStart(const QByteArray &checksumHeader);
 
     ChecksumHeader _expectedChecksum;
@@ -11,6 +11,7 @@ set(common_SOURCES
     ${CMAKE_CURRENT_LIST_DIR}/preparedsqlquerymanager.cpp
     ${CMAKE_CURRENT_LIST_DIR}/syncjournaldb.cpp
     ${CMAKE_CURRENT_LIST_DIR}/syncjournalfilerecord.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/syncjournalsnapshot.cpp
     ${CMAKE_CURRENT_LIST_DIR}/utility.cpp
     ${CMAKE_CURRENT_LIST_DIR}/remotepermissions.cpp
     ${CMAKE_CURRENT_LIST_DIR}/vfs.cpp
@@ -51,14 +51,23 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcFileSystem, "sync.filesystem", QtInfoMsg)
 
+// Most file names are ASCII, which the local 8 bit encodings share with Latin-1.
+// The Latin-1 conversions skip the codec and its validation.
 QByteArray FileSystem::encodeFileName(const QString &fileName)
 {
+    if (QtPrivate::isAscii(fileName)) {
+        return fileName.toLatin1();
+    }
     return fileName.toLocal8Bit();
 }
 
 QString FileSystem::decodeFileName(const char *localFileName)
 {
-    return QString::fromLocal8Bit(localFileName);
+    const QLatin1String name(localFileName);
+    if (QtPrivate::isAscii(name)) {
+        return QString(name);
+    }
+    return QString::fromLocal8Bit(localFileName, name.size());
 }
 
 QString FileSystem::longWinPath(const QString &inpath)
@@ -70,20 +79,28 @@ QString FileSystem::longWinPath(const QString &inpath)
     if (inpath.isEmpty()) {
         return inpath;
     }
-    const QString str = QDir::toNativeSeparators(inpath);
     const QLatin1Char sep('\\');
+    const QLatin1Char slash('/');
+    const auto isSeparator = [&](int i) { return inpath.size() > i && (inpath.at(i) == sep || inpath.at(i) == slash); };
 
-    // we already have a unc path
-    if (str.startsWith(sep + sep)) {
-        return str;
+    // we already have a unc path, or a path that was converted before
+    if (isSeparator(0) && isSeparator(1)) {
+        return QDir::toNativeSeparators(inpath);
     }
-    // prepend \\?\ and to support long names
 
-    if (str.at(0) == sep) {
+    // prepend \\?\ and to support long names,
+    // built in one go as this is called for every local file operation
+    const QLatin1String prefix = isSeparator(0)
         // should not happen as we require the path to be absolute
-        return QStringLiteral("\\\\?") + str;
-    }
-    return QStringLiteral("\\\\?\\") + str;
+        ? QLatin1String("\\\\?")
+        : QLatin1String("\\\\?\\");
+    QString str;
+    str.reserve(prefix.size() + inpath.size());
+    str.append(prefix);
+    for (const QChar c : inpath) {
+        str.append(c == slash ? QChar(sep) : c);
+    }
+    return str;
 #endif
 }
 
@@ -174,11 +191,7 @@ bool FileSystem::rename(const QString &originFileName,
 #ifdef Q_OS_WIN
     const QString originalFileNameLong = longWinPath(originFileName);
     const QString dest = longWinPath(destinationFileName);
-    if (FileSystem::isFileLocked(dest, FileSystem::LockMode::Exclusive)) {
-        error = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(destinationFileName);
-    } else if (FileSystem::isFileLocked(originalFileNameLong, FileSystem::LockMode::Exclusive)) {
-        error = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(originFileName);
-    } else if (isLnkFile(originFileName) || isLnkFile(destinationFileName)) {
+    if (isLnkFile(originFileName) || isLnkFile(destinationFileName)) {
         success = MoveFileEx((wchar_t *)originalFileNameLong.utf16(), (wchar_t *)dest.utf16(), MOVEFILE_COPY_ALLOWED | MOVEFILE_WRITE_THROUGH);
         if (!success) {
             error = Utility::formatWinError(GetLastError());
@@ -194,6 +207,14 @@ bool FileSystem::rename(const QString &originFileName,
     }
 
     if (!success) {
+#ifdef Q_OS_WIN
+        // Probing the locks before each rename is slow on network drives, only explain a failure
+        if (FileSystem::isFileLocked(dest, FileSystem::LockMode::Exclusive)) {
+            error = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(destinationFileName);
+        } else if (FileSystem::isFileLocked(originalFileNameLong, FileSystem::LockMode::Exclusive)) {
+            error = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(originFileName);
+        }
+#endif
         qCWarning(lcFileSystem) << "Error renaming file" << originFileName
                                 << "to" << destinationFileName
                                 << "failed: " << error;
@@ -226,21 +247,20 @@ bool FileSystem::uncheckedRenameReplace(const QString &originFileName,
     }
     const QString orig = longWinPath(originFileName);
     const QString dest = longWinPath(destinationFileName);
-    if (FileSystem::isFileLocked(dest, FileSystem::LockMode::Exclusive)) {
-        *errorString = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(destinationFileName);
-        qCWarning(lcFileSystem) << "Renaming failed: " << *errorString;
-        return false;
-    }
-    if (FileSystem::isFileLocked(orig, FileSystem::LockMode::Exclusive)) {
-        *errorString = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(originFileName);
-        qCWarning(lcFileSystem) << "Renaming failed: " << *errorString;
-        return false;
-    }
     const BOOL ok = MoveFileEx(reinterpret_cast<const wchar_t *>(orig.utf16()),
         reinterpret_cast<const wchar_t *>(dest.utf16()),
         MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED | MOVEFILE_WRITE_THROUGH);
     if (!ok) {
-        *errorString = Utility::formatWinError(GetLastError());
+        const auto error = GetLastError();
+        // only probe the locks to explain a failure, the rename itself is the cheapest probe
+        const bool mayBeLocked = error == ERROR_SHARING_VIOLATION || error == ERROR_LOCK_VIOLATION || error == ERROR_ACCESS_DENIED;
+        if (mayBeLocked && FileSystem::isFileLocked(dest, FileSystem::LockMode::Exclusive)) {
+            *errorString = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(destinationFileName);
+        } else if (mayBeLocked && FileSystem::isFileLocked(orig, FileSystem::LockMode::Exclusive)) {
+            *errorString = QCoreApplication::translate("FileSystem", "Can't rename %1, the file is currently in use").arg(originFileName);
+        } else {
+            *errorString = Utility::formatWinError(error);
+        }
         qCWarning(lcFileSystem) << "Renaming temp file to final failed: " << *errorString;
         return false;
     }
@@ -271,7 +291,7 @@ bool FileSystem::openAndSeekFileSharedRead(QFile *file, QString *errorOrNull, qi
     SECURITY_ATTRIBUTES securityAtts = {sizeof(SECURITY_ATTRIBUTES), nullptr, FALSE};
     QString fName = longWinPath(file->fileName());
 
-    HANDLE fileHandle = CreateFileW((const wchar_t *)fName.utf16(), accessRights, shareMode, &securityAtts, creationDisp, FILE_ATTRIBUTE_NORMAL, nullptr);
+    HANDLE fileHandle = CreateFileW((const wchar_t *)fName.utf16(), accessRights, shareMode, &securityAtts, creationDisp, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
 
     // Bail out on error.
     if (fileHandle == INVALID_HANDLE_VALUE) {
@@ -288,7 +308,7 @@ bool FileSystem::openAndSeekFileSharedRead(QFile *file, QString *errorOrNull, qi
         CloseHandle(fileHandle);
         return false;
     }
-    if (!file->open(fd, QIODevice::ReadOnly, QFile::AutoCloseHandle)) {
+    if (!file->open(fd, QIODevice::ReadOnly | QIODevice::Unbuffered, QFile::AutoCloseHandle)) {
         error = file->errorString();
         _close(fd); // implicitly closes fileHandle
         return false;
@@ -304,7 +324,7 @@ bool FileSystem::openAndSeekFileSharedRead(QFile *file, QString *errorOrNull, qi
 
     return true;
 #else
-    if (!file->open(QFile::ReadOnly)) {
+    if (!file->open(QFile::ReadOnly | QFile::Unbuffered)) {
         error = file->errorString();
         return false;
     }
@@ -139,6 +139,9 @@ namespace FileSystem {
      * Replacement for QFile::open(ReadOnly) followed by a seek().
      * This version sets a more permissive sharing mode on Windows.
      *
+     * The file is opened unbuffered and for sequential access, it is meant to be
+     * read in large blocks from start to end.
+     *
      * Warning: The resulting file may have an empty fileName and be unsuitable for use
      * with QFileInfo! Calling seek() on the QFile with >32bit signed values will fail!
      */
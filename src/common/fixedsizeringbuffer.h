@@ -15,6 +15,7 @@
 
 #include <QtGlobal>
 
+#include <algorithm>
 #include <array>
 #include <functional>
 #include <vector>
@@ -65,6 +66,16 @@ public:
         return isFull() ? _data.end() : _data.begin() + size();
     }
 
+    auto begin() const
+    {
+        return cbegin();
+    }
+
+    auto end() const
+    {
+        return cend();
+    }
+
     auto cbegin() const
     {
         return _data.cbegin();
@@ -89,10 +100,26 @@ public:
     void push_back(TYPE &&data)
     {
         Q_ASSERT(!isFull());
-        _data[convertToIndex(size())] = data;
+        _data[convertToIndex(size())] = std::move(data);
         _end++;
     }
 
+    /*
+     * Remove count items starting at index, the following items keep their order
+     */
+    void erase(size_t index, size_t count)
+    {
+        Q_ASSERT(index + count <= size());
+        if (_start != 0) {
+            // begin() expects the window of a buffer that is not full to start at the raw data
+            std::rotate(_data.begin(), _data.begin() + _start, _data.end());
+            _end -= _start;
+            _start = 0;
+        }
+        std::move(_data.begin() + index + count, _data.begin() + size(), _data.begin() + index);
+        _end -= count;
+    }
+
     const TYPE &at(size_t index) const
     {
         return _data.at(convertToIndex(index));
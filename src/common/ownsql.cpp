@@ -236,6 +236,15 @@ bool SqlDatabase::commit()
     return _errId == SQLITE_OK;
 }
 
+bool SqlDatabase::rollback()
+{
+    if (!_db) {
+        return false;
+    }
+    SQLITE_DO(sqlite3_exec(_db, "ROLLBACK", nullptr, nullptr, nullptr));
+    return _errId == SQLITE_OK;
+}
+
 sqlite3 *SqlDatabase::sqliteDb()
 {
     return _db;
@@ -462,6 +471,22 @@ void SqlQuery::bindValueInternal(int pos, const QVariant &value)
     OC_ASSERT(res == SQLITE_OK);
 }
 
+void SqlQuery::bindBlob(int pos, const QByteArray &value)
+{
+    if (!_stmt) {
+        OC_ASSERT(false);
+        return;
+    }
+    if (lcSql().isDebugEnabled() && !_boundValues.isEmpty()) {
+        _boundValues[pos - 1].value = QStringLiteral("X'%1'").arg(QString::fromLatin1(value.toHex()));
+    }
+    const int res = sqlite3_bind_blob(_stmt, pos, value.constData(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+    if (res != SQLITE_OK) {
+        qCWarning(lcSql) << "ERROR binding SQL blob:" << value.toHex() << "error:" << res;
+    }
+    OC_ASSERT(res == SQLITE_OK);
+}
+
 bool SqlQuery::nullValue(int index)
 {
     return sqlite3_column_type(_stmt, index) == SQLITE_NULL;
@@ -50,6 +50,7 @@ public:
     bool openReadOnly(const QString &filename);
     bool transaction();
     bool commit();
+    bool rollback();
     void close();
     QString error() const;
     sqlite3 *sqliteDb();
@@ -149,6 +150,9 @@ public:
         bindValueInternal(pos, converted);
     }
 
+    /// Binds \a value as a blob, bindValue() binds a QByteArray as text
+    void bindBlob(int pos, const QByteArray &value);
+
     const QByteArray &lastQuery() const;
     int numRowsAffected();
     void reset_and_clear_bindings();
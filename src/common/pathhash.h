@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+#pragma once
+
+#include <QtCore/qendian.h>
+#include <QtCore/qglobal.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace OCC {
+
+/**
+ * @brief The hash of the journal paths, see SyncJournalDb::getPHash()
+ *
+ * wyhash (version final 3) by Wang Yi, released into the public domain: it reads 16 or 48 bytes
+ * per round and mixes them with one 64x64->128 bit multiplication each, instead
+ * of the shift and subtract rounds of the Jenkins hash in c_jhash.h.
+ *
+ * The input is read as little endian, so a journal has the same hashes on all machines.
+ * The values are stored in the journal, changing them needs a migration of the journal.
+ */
+namespace PathHash {
+    namespace Detail {
+        constexpr uint64_t Secret[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+        // the 128 bit product of a and b, the low half in a, the high one in b
+        inline void multiply(uint64_t *a, uint64_t *b)
+        {
+#if defined(__SIZEOF_INT128__)
+            __uint128_t r = *a;
+            r *= *b;
+            *a = static_cast<uint64_t>(r);
+            *b = static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+            *a = _umul128(*a, *b, b);
+#else
+            const uint64_t ha = *a >> 32, hb = *b >> 32, la = static_cast<uint32_t>(*a), lb = static_cast<uint32_t>(*b);
+            const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+            const uint64_t t = rl + (rm0 << 32);
+            uint64_t carry = t < rl;
+            const uint64_t lo = t + (rm1 << 32);
+            carry += lo < t;
+            *a = lo;
+            *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+        }
+
+        inline uint64_t mix(uint64_t a, uint64_t b)
+        {
+            multiply(&a, &b);
+            return a ^ b;
+        }
+
+        inline uint64_t read8(const uint8_t *p) { return qFromLittleEndian<quint64>(p); }
+        inline uint64_t read4(const uint8_t *p) { return qFromLittleEndian<quint32>(p); }
+        // 1 to 3 bytes
+        inline uint64_t read3(const uint8_t *p, size_t len) { return (uint64_t(p[0]) << 16) | (uint64_t(p[len >> 1]) << 8) | p[len - 1]; }
+    }
+
+    inline uint64_t hash(const void *data, size_t len, uint64_t seed = 0)
+    {
+        using namespace Detail;
+        auto p = static_cast<const uint8_t *>(data);
+        seed ^= mix(seed ^ Secret[0], Secret[1]);
+        uint64_t a = 0;
+        uint64_t b = 0;
+        if (Q_LIKELY(len <= 16)) {
+            if (Q_LIKELY(len >= 4)) {
+                a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+                b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+            } else if (Q_LIKELY(len > 0)) {
+                a = read3(p, len);
+            }
+        } else {
+            size_t i = len;
+            if (Q_UNLIKELY(i >= 48)) {
+                uint64_t seed1 = seed;
+                uint64_t seed2 = seed;
+                do {
+                    seed = mix(read8(p) ^ Secret[1], read8(p + 8) ^ seed);
+                    seed1 = mix(read8(p + 16) ^ Secret[2], read8(p + 24) ^ seed1);
+                    seed2 = mix(read8(p + 32) ^ Secret[3], read8(p + 40) ^ seed2);
+                    p += 48;
+                    i -= 48;
+                } while (Q_LIKELY(i >= 48));
+                seed ^= seed1 ^ seed2;
+            }
+            while (Q_UNLIKELY(i > 16)) {
+                seed = mix(read8(p) ^ Secret[1], read8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+        a ^= Secret[1];
+        b ^= seed;
+        multiply(&a, &b);
+        return mix(a ^ Secret[0] ^ len, b ^ Secret[1]);
+    }
+}
+}
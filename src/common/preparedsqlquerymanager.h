@@ -62,9 +62,12 @@ public:
         GetFileRecordQuery,
         GetFileRecordQueryByInode,
         GetFileRecordQueryByFileId,
+        GetFileRecordQueryByContentChecksum,
         GetFilesBelowPathQuery,
         GetAllFilesQuery,
         ListFilesInPathQuery,
+        ListFilesInPathPageQuery,
+        CountFilesInPathQuery,
         SetFileRecordQuery,
         SetFileRecordChecksumQuery,
         GetDownloadInfoQuery,
@@ -82,18 +85,34 @@ public:
         GetChecksumTypeIdQuery,
         GetChecksumTypeQuery,
         InsertChecksumTypeQuery,
+        GetRemotePermissionsIdQuery,
+        InsertRemotePermissionsQuery,
         GetDataFingerprintQuery,
         SetDataFingerprintQuery1,
         SetDataFingerprintQuery2,
+        GetChangeJournalPositionQuery,
+        SetChangeJournalPositionQuery1,
+        SetChangeJournalPositionQuery2,
+        GetSyncTokenQuery,
+        SetSyncTokenQuery1,
+        SetSyncTokenQuery2,
         GetConflictRecordQuery,
         SetConflictRecordQuery,
         DeleteConflictRecordQuery,
-        GetRawPinStateQuery,
-        GetEffectivePinStateQuery,
-        GetSubPinsQuery,
         CountDehydratedFilesQuery,
         SetPinStateQuery,
         WipePinStateQuery,
+        GetHydrationTimeQuery,
+        SetHydrationTimeQuery,
+        GetHydratedAroundQuery,
+        SetAccessTimeQuery,
+        GetLeastRecentlyUsedFilesQuery,
+        GetHydratedFilesSizeQuery,
+        GetHydratedRangesQuery,
+        SetHydratedRangeQuery,
+        DeleteHydratedRangesQuery,
+        GetCachedChecksumQuery,
+        SetCachedChecksumQuery,
 
         GetFileReocrdsWithDirtyPlaceholdersQuery,
 
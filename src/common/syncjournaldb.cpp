@@ -19,9 +19,9 @@
 #include "common/syncjournaldb.h"
 
 #include "common/asserts.h"
-#include "common/c_jhash.h"
 #include "common/checksums.h"
 #include "common/filesystembase.h"
+#include "common/pathhash.h"
 #include "common/preparedsqlquerymanager.h"
 #include "common/version.h"
 
@@ -29,12 +29,18 @@
 #include <QElapsedTimer>
 #include <QFile>
 #include <QLoggingCategory>
+#include <QScopedValueRollback>
 #include <QStringList>
+#include <QThread>
 #include <QUrl>
 
 #include <sqlite3.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstring>
+#include <vector>
 
 Q_LOGGING_CATEGORY(lcDb, "sync.database", QtInfoMsg)
 
@@ -46,12 +52,109 @@ Q_LOGGING_CATEGORY(lcDb, "sync.database", QtInfoMsg)
     "(" path " == " prefix " OR " IS_PREFIX_PATH_OF(prefix, path) ")"
 
 namespace {
+// limits of a batch of deferred commits in CommitMode::Batched
+constexpr int MaximumDeferredCommits = 500;
+constexpr auto MaximumCommitDelay = std::chrono::seconds(2);
+// rows of the write-behind queue that trigger writing it before the delay passed
+constexpr qsizetype MaximumPendingWrites = 500;
+// SQLITE_MAX_VARIABLE_NUMBER of sqlite versions before 3.32
+constexpr int MaximumBoundValues = 999;
+// the hash function of phash and parent_hash(), stored as the user_version of the journal
+constexpr int PathHashVersion = 1;
+// the statements of updatePathHashes() and the structure update after them, see SyncJournalDb::upgradeProgress()
+constexpr int PathHashStepCount = 7;
+constexpr int UpgradeStepCount = PathHashStepCount + 1;
+
+/**
+ * Writes the queued changes of a table with as few statements as possible.
+ *
+ * The rows are written with "<insert> VALUES (...), (...)" where \a bindRow binds the
+ * \a columns values of one row, deleted rows with "<remove> (?, ?)" where \a bindKey
+ * binds the key of one row.
+ */
+template <typename Key, typename Row, typename BindRow, typename BindKey>
+bool writeRows(OCC::SqlDatabase &db, const std::map<Key, std::optional<Row>> &rows, const QByteArray &insert, int columns, BindRow &&bindRow,
+    const QByteArray &remove, BindKey &&bindKey)
+{
+    std::vector<std::pair<const Key *, const Row *>> written;
+    std::vector<const Key *> removed;
+    for (const auto &[key, row] : rows) {
+        if (row) {
+            written.emplace_back(&key, &*row);
+        } else {
+            removed.push_back(&key);
+        }
+    }
+
+    const auto placeholders = [](size_t count) {
+        QByteArray out = QByteArray("?,").repeated(static_cast<qsizetype>(count));
+        out.chop(1);
+        return out;
+    };
+
+    OCC::SqlQuery query(db);
+    const size_t rowsPerStatement = MaximumBoundValues / columns;
+    const QByteArray rowValues = '(' + placeholders(columns) + "),";
+    for (size_t first = 0; first < written.size(); first += rowsPerStatement) {
+        const size_t count = std::min(written.size() - first, rowsPerStatement);
+        QByteArray values = rowValues.repeated(static_cast<qsizetype>(count));
+        values.chop(1);
+        if (query.prepare(insert + " VALUES " + values) != SQLITE_OK) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            bindRow(query, static_cast<int>(i) * columns + 1, *written[first + i].first, *written[first + i].second);
+        }
+        if (!query.exec()) {
+            return false;
+        }
+    }
+    for (size_t first = 0; first < removed.size(); first += MaximumBoundValues) {
+        const size_t count = std::min(removed.size() - first, size_t(MaximumBoundValues));
+        if (query.prepare(remove + " (" + placeholders(count) + ')') != SQLITE_OK) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            bindKey(query, static_cast<int>(i) + 1, *removed[first + i]);
+        }
+        if (!query.exec()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Content checksums are stored as their binary value, half the size of the hex text.
+// A checksum that doesn't survive the round trip, like an Adler32 without its
+// leading zeros, is kept as text.
+std::optional<QByteArray> binaryChecksum(const QByteArray &checksum)
+{
+    if (checksum.isEmpty() || checksum.size() % 2 != 0) {
+        return {};
+    }
+    auto binary = QByteArray::fromHex(checksum);
+    if (binary.toHex() != checksum) {
+        return {};
+    }
+    return binary;
+}
+
+void bindChecksum(OCC::SqlQuery &query, int pos, const QByteArray &checksum)
+{
+    if (const auto binary = binaryChecksum(checksum)) {
+        query.bindBlob(pos, *binary);
+    } else {
+        query.bindValue(pos, checksum);
+    }
+}
+
 // base query used to select file record objects, used in combination with WHERE statements.
-const auto getFileRecordQueryC = QByteArrayLiteral("SELECT path, inode, modtime, type, md5, fileid, remotePerm, filesize,"
-                                                   " ignoredChildrenRemote, contentchecksumtype.name || ':' || contentChecksum,"
+const auto getFileRecordQueryC = QByteArrayLiteral("SELECT path, inode, modtime, type, md5, fileid, remotepermissions.perm, filesize,"
+                                                   " ignoredChildrenRemote, contentchecksumtype.name || ':' || checksum_hex(contentChecksum),"
                                                    " hasDirtyPlaceholder"
                                                    " FROM metadata"
-                                                   " LEFT JOIN checksumtype as contentchecksumtype ON metadata.contentChecksumTypeId == contentchecksumtype.id ");
+                                                   " LEFT JOIN checksumtype as contentchecksumtype ON metadata.contentChecksumTypeId == contentchecksumtype.id"
+                                                   " LEFT JOIN remotepermissions ON metadata.remotePermId == remotepermissions.id ");
 
 
 void fillFileRecordFromGetQuery(OCC::SyncJournalFileRecord &rec, OCC::SqlQuery &query)
@@ -105,6 +208,24 @@ SyncJournalDb::SyncJournalDb(const QString &dbFilePath, QObject *parent)
     if (_journalMode.isEmpty()) {
         _journalMode = defaultJournalMode(_dbFile);
     }
+
+    _ioThreadPool.setMaxThreadCount(1);
+    _ioThreadPool.setObjectName(QStringLiteral("SyncJournalDb I/O"));
+
+    _deferredCommitTimer.setSingleShot(true);
+    _deferredCommitTimer.setInterval(MaximumCommitDelay);
+    connect(&_deferredCommitTimer, &QTimer::timeout, this, [this] {
+        // nobody is waiting for the result, so don't block the event loop with the disk sync
+        runAsync(
+            this,
+            [](SyncJournalDb *db) {
+                QMutexLocker lock(&db->_mutex);
+                if (db->_deferredCommits > 0 || db->pendingWriteCount() > 0) {
+                    db->commitInternal(QStringLiteral("deferred commits timeout"), true);
+                }
+            },
+            [] {});
+    });
 }
 
 QString SyncJournalDb::makeDbName(const QString &localPath,
@@ -158,6 +279,12 @@ bool SyncJournalDb::exists()
     return (!_dbFile.isEmpty() && QFile::exists(_dbFile));
 }
 
+bool SyncJournalDb::isMetadataTableEmpty()
+{
+    QMutexLocker locker(&_mutex);
+    return checkConnect() && _metadataTableIsEmpty;
+}
+
 QString SyncJournalDb::databaseFilePath() const
 {
     return _dbFile;
@@ -168,6 +295,11 @@ QString SyncJournalDb::databaseFilePath() const
 // Then the next sync (and the SocketAPI) will have a faster access.
 void SyncJournalDb::walCheckpoint()
 {
+    QMutexLocker locker(&_mutex);
+    if (!_db.isOpen()) {
+        return;
+    }
+
     QElapsedTimer t;
     t.start();
     SqlQuery pragma1(_db);
@@ -177,6 +309,139 @@ void SyncJournalDb::walCheckpoint()
     }
 }
 
+void SyncJournalDb::runMaintenance(std::chrono::milliseconds budget)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_db.isOpen()) {
+        return;
+    }
+
+    QElapsedTimer t;
+    t.start();
+    SqlQuery query(_db);
+    const auto pragmaValue = [&query](const QByteArray &pragma) -> qint64 {
+        query.prepare("PRAGMA " + pragma + ";");
+        if (!query.exec() || !query.next().hasData) {
+            return -1;
+        }
+        return query.int64Value(0);
+    };
+
+    // vacuuming and checkpointing need the open transaction to be committed
+    commitInternal(QStringLiteral("runMaintenance"), false);
+
+    const qint64 freePages = pragmaValue("freelist_count");
+    const qint64 pages = pragmaValue("page_count");
+    if (freePages > 0) {
+        if (pragmaValue("auto_vacuum") == 2) {
+            // incremental, free the pages in steps until the budget is used up
+            constexpr qint64 pagesPerStep = 256;
+            qint64 remaining = freePages;
+            while (remaining > 0 && t.elapsed() < budget.count()) {
+                query.prepare("PRAGMA incremental_vacuum(" + QByteArray::number(pagesPerStep) + ");");
+                if (!query.exec()) {
+                    break;
+                }
+                // the pragma returns a row for each freed page
+                while (query.next().hasData) { }
+                remaining -= pagesPerStep;
+
+                // let the readers on the gui thread, like the socket api, in between the steps
+                locker.unlock();
+                QThread::yieldCurrentThread();
+                locker.relock();
+                if (!_db.isOpen()) {
+                    return;
+                }
+            }
+        } else if (freePages * 2 > pages) {
+            // Journals created before incremental vacuuming was enabled need a full
+            // vacuum to switch, only worth it once most of the file is unused.
+            query.prepare("PRAGMA auto_vacuum = INCREMENTAL;");
+            query.exec();
+            query.prepare("VACUUM;");
+            if (!query.exec()) {
+                qCWarning(lcDb) << "VACUUM failed:" << query.error();
+            }
+        }
+    }
+
+    // only analyzes the tables whose statistics are outdated, usually none
+    query.prepare("PRAGMA optimize;");
+    query.exec();
+
+    // a write between the vacuum steps might have started a transaction
+    commitInternal(QStringLiteral("runMaintenance"), false);
+    query.prepare("PRAGMA wal_checkpoint(TRUNCATE);");
+    query.exec();
+    startTransaction();
+
+    qCInfo(lcDb) << "Maintenance of" << _dbFile << "with" << freePages << "of" << pages << "pages unused took" << t.elapsed() << "msec";
+}
+
+void SyncJournalDb::setPerformanceProfile(const PerformanceProfile &profile)
+{
+    QMutexLocker locker(&_mutex);
+    _performanceProfile = profile;
+}
+
+SyncJournalDb::PerformanceProfile SyncJournalDb::performanceProfile() const
+{
+    QMutexLocker locker(&_mutex);
+    return _performanceProfile;
+}
+
+bool SyncJournalDb::loadMetadataSnapshot()
+{
+    QMutexLocker locker(&_mutex);
+
+    _metadataSnapshot.reset();
+    if (!checkConnect()) {
+        return false;
+    }
+
+    QElapsedTimer t;
+    t.start();
+    SqlQuery query(getFileRecordQueryC, _db);
+    if (!query.exec()) {
+        return false;
+    }
+
+    auto snapshot = std::make_unique<SyncJournalSnapshot>();
+    SyncJournalFileRecord rec;
+    while (true) {
+        auto next = query.next();
+        if (!next.ok) {
+            sqlFail(QStringLiteral("loadMetadataSnapshot"), query);
+            return false;
+        }
+        if (!next.hasData) {
+            break;
+        }
+        fillFileRecordFromGetQuery(rec, query);
+        if (!snapshot->append(rec)) {
+            qCWarning(lcDb) << "The journal is too large for a metadata snapshot";
+            return false;
+        }
+    }
+    snapshot->finalize();
+    qCInfo(lcDb) << "Loaded" << snapshot->size() << "records into the metadata snapshot, took" << t.elapsed() << "msec";
+    _metadataSnapshot = std::move(snapshot);
+    return true;
+}
+
+void SyncJournalDb::dropMetadataSnapshot()
+{
+    QMutexLocker locker(&_mutex);
+    _metadataSnapshot.reset();
+}
+
+bool SyncJournalDb::hasMetadataSnapshot() const
+{
+    QMutexLocker locker(&_mutex);
+    return _metadataSnapshot != nullptr;
+}
+
 void SyncJournalDb::startTransaction()
 {
     if (_transaction == 0) {
@@ -193,11 +458,16 @@ void SyncJournalDb::startTransaction()
 void SyncJournalDb::commitTransaction()
 {
     if (_transaction == 1) {
+        const auto start = std::chrono::steady_clock::now();
         if (!_db.commit()) {
             qCWarning(lcDb) << "ERROR committing to the database:" << _db.error();
             return;
         }
+        _commitStatistics.commits++;
+        _commitStatistics.duration += std::chrono::steady_clock::now() - start;
         _transaction = 0;
+        // a still running _deferredCommitTimer will find nothing to commit
+        _deferredCommits = 0;
     } else {
         qCDebug(lcDb) << "No database Transaction to commit";
     }
@@ -218,6 +488,10 @@ bool SyncJournalDb::checkConnect()
         qCWarning(lcDb) << Q_FUNC_INFO << "after the db was closed";
         return false;
     }
+    if (!_flushingPendingWrites && pendingWriteCount() > 0) {
+        // connects as well
+        return flushPendingWrites();
+    }
     if (autotestFailCounter >= 0) {
         if (!autotestFailCounter--) {
             qCInfo(lcDb) << "Error Simulated";
@@ -267,6 +541,22 @@ bool SyncJournalDb::checkConnect()
         qCInfo(lcDb) << "sqlite3 locking_mode=" << pragma1.stringValue(0);
     }
 
+    // The page size can't be changed once the database is in WAL mode
+    if (_performanceProfile.pageSize > 0) {
+        pragma1.prepare("PRAGMA page_size = " + QByteArray::number(_performanceProfile.pageSize) + ";");
+        if (!pragma1.exec()) {
+            return sqlFail(QStringLiteral("Set PRAGMA page_size"), pragma1);
+        }
+        qCInfo(lcDb) << "sqlite3 page_size =" << _performanceProfile.pageSize;
+    }
+
+    // Only applies to new databases, the space of deleted records can then be
+    // returned to the file system without rewriting the database, see runMaintenance()
+    pragma1.prepare("PRAGMA auto_vacuum = INCREMENTAL;");
+    if (!pragma1.exec()) {
+        return sqlFail(QStringLiteral("Set PRAGMA auto_vacuum"), pragma1);
+    }
+
     pragma1.prepare("PRAGMA journal_mode=" + _journalMode + ";");
     if (!pragma1.exec()) {
         return sqlFail(QStringLiteral("Set PRAGMA journal_mode"), pragma1);
@@ -297,22 +587,35 @@ bool SyncJournalDb::checkConnect()
         qCInfo(lcDb) << "sqlite3 synchronous=" << synchronousMode;
     }
 
-    pragma1.prepare("PRAGMA case_sensitive_like = ON;");
-    if (!pragma1.exec()) {
-        return sqlFail(QStringLiteral("Set PRAGMA case_sensitivity"), pragma1);
+    if (_performanceProfile.mmapSize > 0) {
+        pragma1.prepare("PRAGMA mmap_size = " + QByteArray::number(_performanceProfile.mmapSize) + ";");
+        if (!pragma1.exec()) {
+            return sqlFail(QStringLiteral("Set PRAGMA mmap_size"), pragma1);
+        }
+        pragma1.next();
+        qCInfo(lcDb) << "sqlite3 mmap_size =" << pragma1.int64Value(0);
     }
 
-    {
-        // Future version of the client (2.6) will have an index 'metadata_parent' which
-        // depends on a custom sqlite function which does not exist yet in 2.5.
-        // So make sure to remove the index if it exists, otherwise we will crash when inserting
-        // rows in the metadata database.
-        // The 2.6 client will anyway re-creates this index if it does not exist.
-        SqlQuery query(_db);
-        query.prepare("DROP INDEX IF EXISTS metadata_parent;");
-        if (!query.exec()) {
-            return sqlFail(QStringLiteral("updateMetadataTableStructure: remove index metadata_parent"), query);
+    if (_performanceProfile.cacheSize > 0) {
+        // negative values are interpreted as KiB instead of pages
+        pragma1.prepare("PRAGMA cache_size = -" + QByteArray::number(_performanceProfile.cacheSize) + ";");
+        if (!pragma1.exec()) {
+            return sqlFail(QStringLiteral("Set PRAGMA cache_size"), pragma1);
+        }
+        qCInfo(lcDb) << "sqlite3 cache_size =" << _performanceProfile.cacheSize << "KiB";
+    }
+
+    if (_performanceProfile.walAutoCheckpoint > 0) {
+        pragma1.prepare("PRAGMA wal_autocheckpoint = " + QByteArray::number(_performanceProfile.walAutoCheckpoint) + ";");
+        if (!pragma1.exec()) {
+            return sqlFail(QStringLiteral("Set PRAGMA wal_autocheckpoint"), pragma1);
         }
+        qCInfo(lcDb) << "sqlite3 wal_autocheckpoint =" << _performanceProfile.walAutoCheckpoint;
+    }
+
+    pragma1.prepare("PRAGMA case_sensitive_like = ON;");
+    if (!pragma1.exec()) {
+        return sqlFail(QStringLiteral("Set PRAGMA case_sensitivity"), pragma1);
     }
 
     sqlite3_create_function(_db.sqliteDb(), "parent_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
@@ -320,10 +623,44 @@ bool SyncJournalDb::checkConnect()
                                     auto text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
                                     const char *end = std::strrchr(text, '/');
                                     if (!end) end = text;
-                                    sqlite3_result_int64(ctx, c_jhash64(reinterpret_cast<const uint8_t*>(text),
-                                                                        end - text, 0));
+                                    sqlite3_result_int64(ctx, PathHash::hash(text, end - text));
                                 }, nullptr, nullptr);
 
+    // the phash of a path, see getPHash()
+    sqlite3_create_function(_db.sqliteDb(), "path_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+        [](sqlite3_context *ctx, int, sqlite3_value **argv) {
+            auto text = sqlite3_value_text(argv[0]);
+            sqlite3_result_int64(ctx, PathHash::hash(text, sqlite3_value_bytes(argv[0])));
+        },
+        nullptr, nullptr);
+
+    // the text of a content checksum, see bindChecksum()
+    sqlite3_create_function(_db.sqliteDb(), "checksum_hex", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+        [](sqlite3_context *ctx, int, sqlite3_value **argv) {
+            if (sqlite3_value_type(argv[0]) != SQLITE_BLOB) {
+                sqlite3_result_value(ctx, argv[0]);
+                return;
+            }
+            const auto *data = static_cast<const char *>(sqlite3_value_blob(argv[0]));
+            const auto hex = QByteArray::fromRawData(data, sqlite3_value_bytes(argv[0])).toHex();
+            sqlite3_result_text(ctx, hex.constData(), static_cast<int>(hex.size()), SQLITE_TRANSIENT);
+        },
+        nullptr, nullptr);
+
+    // the stored value of a content checksum, used to migrate the text checksums
+    sqlite3_create_function(_db.sqliteDb(), "checksum_binary", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+        [](sqlite3_context *ctx, int, sqlite3_value **argv) {
+            if (sqlite3_value_type(argv[0]) == SQLITE_TEXT) {
+                const auto *text = reinterpret_cast<const char *>(sqlite3_value_text(argv[0]));
+                if (const auto binary = binaryChecksum(QByteArray(text, sqlite3_value_bytes(argv[0])))) {
+                    sqlite3_result_blob(ctx, binary->constData(), static_cast<int>(binary->size()), SQLITE_TRANSIENT);
+                    return;
+                }
+            }
+            sqlite3_result_value(ctx, argv[0]);
+        },
+        nullptr, nullptr);
+
     /* Because insert is so slow, we do everything in a transaction, and only need one call to commit */
     startTransaction();
 
@@ -347,6 +684,7 @@ bool SyncJournalDb::checkConnect()
                         // contentChecksum
                         // contentChecksumTypeId
                         // hasDirtyPlaceholder
+                        // remotePermId
                         "PRIMARY KEY(phash)"
                         ");");
 
@@ -422,6 +760,15 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table checksumtype"), createQuery);
     }
 
+    // the remote permissions of the metadata table, a folder only has a few distinct ones
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS remotepermissions("
+                        "id INTEGER PRIMARY KEY,"
+                        "perm TEXT UNIQUE"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table remotepermissions"), createQuery);
+    }
+
     // create the datafingerprint table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS datafingerprint("
                         "fingerprint TEXT UNIQUE"
@@ -430,6 +777,22 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table datafingerprint"), createQuery);
     }
 
+    // create the changejournal table.
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS changejournal("
+                        "position TEXT"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table changejournal"), createQuery);
+    }
+
+    // create the synctoken table.
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS synctoken("
+                        "token TEXT"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table synctoken"), createQuery);
+    }
+
     // create the flags table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS flags ("
                         "path TEXT PRIMARY KEY,"
@@ -450,6 +813,58 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table conflicts"), createQuery);
     }
 
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS hydrations("
+                        "path TEXT PRIMARY KEY,"
+                        "time INTEGER"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table hydrations"), createQuery);
+    }
+    createQuery.prepare("CREATE INDEX IF NOT EXISTS hydrations_time ON hydrations(time);");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create index hydrations_time"), createQuery);
+    }
+
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS accesstimes("
+                        "path TEXT PRIMARY KEY,"
+                        "time INTEGER"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table accesstimes"), createQuery);
+    }
+
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS hydratedranges("
+                        "path TEXT,"
+                        "etag TEXT,"
+                        "rangestart INTEGER,"
+                        "rangeend INTEGER,"
+                        "PRIMARY KEY(path, rangestart)"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table hydratedranges"), createQuery);
+    }
+
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS checksumcache("
+                        "inode INTEGER,"
+                        "checksumTypeId INTEGER,"
+                        "modtime INTEGER(8),"
+                        "filesize BIGINT,"
+                        "checksum TEXT,"
+                        "PRIMARY KEY(inode, checksumTypeId)"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table checksumcache"), createQuery);
+    }
+
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS localfolderfingerprints("
+                        "path TEXT PRIMARY KEY,"
+                        "modtime INTEGER(8),"
+                        "inode INTEGER"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table localfolderfingerprints"), createQuery);
+    }
+
     createQuery.prepare("CREATE TABLE IF NOT EXISTS version("
                         "major INTEGER(8),"
                         "minor INTEGER(8),"
@@ -460,13 +875,33 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table version"), createQuery);
     }
 
+    // the client version that last wrote the version row knowing about PathHash,
+    // older clients update the row but leave this column alone
+    SqlQuery versionColumnQuery("SELECT count(*) FROM pragma_table_info('version') WHERE name = 'pathhashclient';", _db);
+    const bool hasPathHashClient = versionColumnQuery.next().hasData && versionColumnQuery.intValue(0) > 0;
+    versionColumnQuery.finish();
+    if (!hasPathHashClient) {
+        createQuery.prepare("ALTER TABLE version ADD COLUMN pathhashclient VARCHAR(256);");
+        if (!createQuery.exec()) {
+            return sqlFail(QStringLiteral("Add column pathhashclient"), createQuery);
+        }
+    }
+
     bool forceRemoteDiscovery = false;
+    bool versionChanged = false;
+
+    int pathHashVersion = 0;
+    SqlQuery userVersionQuery("PRAGMA user_version;", _db);
+    if (userVersionQuery.next().hasData) {
+        pathHashVersion = userVersionQuery.intValue(0);
+    }
+    bool updateHashes = pathHashVersion < PathHashVersion;
 
-    SqlQuery versionQuery("SELECT major, minor, patch FROM version;", _db);
+    SqlQuery versionQuery("SELECT major, minor, patch, pathhashclient FROM version;", _db);
     if (!versionQuery.next().hasData) {
         forceRemoteDiscovery = true;
 
-        createQuery.prepare("INSERT INTO version VALUES (?1, ?2, ?3, ?4);");
+        createQuery.prepare("INSERT INTO version (major, minor, patch, custom) VALUES (?1, ?2, ?3, ?4);");
         const auto segments = OCC::Version::versionWithBuildNumber().segments();
         for (int i = 0; i < segments.size(); ++i) {
             createQuery.bindValue(i + 1, segments[i]);
@@ -494,8 +929,18 @@ bool SyncJournalDb::checkConnect()
             forceRemoteDiscovery = true;
         }
 
+        // A client older than PathHash used the journal since we last wrote to it,
+        // its rows carry Jenkins hashes and it didn't track what changed meanwhile
+        const QString lastVersion = QVersionNumber(major, minor, patch).toString();
+        if (!updateHashes && versionQuery.stringValue(3) != lastVersion) {
+            qCInfo(lcDb) << "downgrade to client" << lastVersion << "detected! forcing remote discovery";
+            updateHashes = true;
+            forceRemoteDiscovery = true;
+        }
+
         // Not comparing the BUILD id here, correct?
         if (QVersionNumber(major, minor, patch) != OCC::Version::version()) {
+            versionChanged = true;
             createQuery.prepare("UPDATE version SET major=?1, minor=?2, patch =?3, custom=?4 "
                                 "WHERE major=?5 AND minor=?6 AND patch=?7;");
             const auto segments = OCC::Version::versionWithBuildNumber().segments();
@@ -511,12 +956,30 @@ bool SyncJournalDb::checkConnect()
         }
     }
 
+    createQuery.prepare("UPDATE version SET pathhashclient=?1;");
+    createQuery.bindValue(1, OCC::Version::version().toString());
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Update version"), createQuery);
+    }
+
+    if (updateHashes) {
+        if (!updatePathHashes(versionChanged)) {
+            return false;
+        }
+    }
+
     commitInternal(QStringLiteral("checkConnect"));
 
+    if (versionChanged) {
+        Q_EMIT upgradeProgress(PathHashStepCount, UpgradeStepCount);
+    }
     bool rc = updateDatabaseStructure();
     if (!rc) {
         qCWarning(lcDb) << "Failed to update the database structure!";
     }
+    if (versionChanged) {
+        Q_EMIT upgradeProgress(UpgradeStepCount, UpgradeStepCount);
+    }
 
     /*
      * If we are upgrading from a client version older than 1.5,
@@ -573,10 +1036,15 @@ void SyncJournalDb::close()
     QMutexLocker locker(&_mutex);
     qCInfo(lcDb) << "Closing DB" << _dbFile;
 
+    flushPendingWrites();
     commitTransaction();
     _db.close();
     clearEtagStorageFilter();
     _metadataTableIsEmpty = false;
+    _metadataSnapshot.reset();
+    _pinStates.reset();
+    _remotePermissionsCache.clear();
+    _selectiveSyncListCache.clear();
     _closed = true;
 }
 
@@ -595,6 +1063,31 @@ bool SyncJournalDb::updateDatabaseStructure()
     return true;
 }
 
+bool SyncJournalDb::updatePathHashes(bool reportProgress)
+{
+    qCInfo(lcDb) << "Updating the path hashes of the journal to version" << PathHashVersion;
+    // the index on parent_hash() is outdated as well, updateMetadataTableStructure() creates it again
+    const std::array<QByteArray, PathHashStepCount> statements = {QByteArrayLiteral("DROP INDEX IF EXISTS metadata_parent;"), //
+        QByteArrayLiteral("CREATE TEMP TABLE rehashed AS SELECT * FROM metadata ORDER BY rowid;"), //
+        QByteArrayLiteral("UPDATE temp.rehashed SET phash = path_hash(path);"), //
+        QByteArrayLiteral("DELETE FROM metadata;"), //
+        // after a downgrade a path can have rows under both hashes, the one written last wins
+        QByteArrayLiteral("INSERT OR REPLACE INTO metadata SELECT * FROM temp.rehashed ORDER BY rowid;"), //
+        QByteArrayLiteral("DROP TABLE temp.rehashed;"), //
+        "PRAGMA user_version = " + QByteArray::number(PathHashVersion) + ";"};
+    SqlQuery query(_db);
+    for (int step = 0; step < PathHashStepCount; ++step) {
+        if (reportProgress) {
+            Q_EMIT upgradeProgress(step, UpgradeStepCount);
+        }
+        const auto &sql = statements[step];
+        if (query.prepare(sql) != SQLITE_OK || !query.exec()) {
+            return sqlFail(QStringLiteral("updatePathHashes"), query);
+        }
+    }
+    return true;
+}
+
 bool SyncJournalDb::updateMetadataTableStructure()
 {
     auto columns = tableColumns("metadata");
@@ -649,6 +1142,21 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal(QStringLiteral("update database structure: add inode index"));
     }
 
+    {
+        SqlQuery query(_db);
+        query.prepare("DROP INDEX IF EXISTS metadata_large_content_checksum;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: remove index large content checksum"), query);
+            re = false;
+        }
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_content_checksum ON metadata(filesize, contentChecksum);");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: create index content checksum"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add content checksum index"));
+    }
+
     {
         SqlQuery query(_db);
         query.prepare("CREATE INDEX IF NOT EXISTS metadata_path ON metadata(path);");
@@ -661,7 +1169,7 @@ bool SyncJournalDb::updateMetadataTableStructure()
 
     {
         SqlQuery query(_db);
-        query.prepare("CREATE INDEX IF NOT EXISTS metadata_parent ON metadata(parent_hash(path));");
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_parent ON metadata(parent_hash(path), path);");
         if (!query.exec()) {
             sqlFail(QStringLiteral("updateMetadataTableStructure: create index parent"), query);
             re = false;
@@ -714,6 +1222,29 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal(QStringLiteral("update database structure: add hasDirtyPlaceholder col"));
     }
 
+    if (columns.indexOf("remotePermId") == -1) {
+        // The permissions move to the remotepermissions table and the content checksums
+        // are stored as binary, see bindFileRecord()
+        SqlQuery query(_db);
+        query.prepare("ALTER TABLE metadata ADD COLUMN remotePermId INTEGER;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: add remotePermId column"), query);
+            re = false;
+        }
+        query.prepare("INSERT OR IGNORE INTO remotepermissions (perm) SELECT DISTINCT remotePerm FROM metadata WHERE remotePerm != '';");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: fill remotepermissions"), query);
+            re = false;
+        }
+        query.prepare("UPDATE metadata SET remotePermId = (SELECT id FROM remotepermissions WHERE perm = metadata.remotePerm), remotePerm = NULL,"
+                      " contentChecksum = checksum_binary(contentChecksum);");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: compact metadata"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add remotePermId col"));
+    }
+
     auto uploadInfoColumns = tableColumns("uploadinfo");
     if (uploadInfoColumns.isEmpty())
         return false;
@@ -824,17 +1355,46 @@ QVector<QByteArray> SyncJournalDb::tableColumns(const QByteArray &table)
 
 qint64 SyncJournalDb::getPHash(const QByteArray &file)
 {
-    qint64 h;
-    int len = file.length();
-
-    h = c_jhash64((uint8_t *)file.data(), len, 0);
-    return h;
+    return PathHash::hash(file.constData(), file.size());
+}
+
+void SyncJournalDb::bindFileRecord(SqlQuery &query, int firstPos, const SyncJournalFileRecord &record)
+{
+    QByteArray etag(record._etag);
+    if (etag.isEmpty())
+        etag = "";
+    QByteArray fileId(record._fileId);
+    if (fileId.isEmpty())
+        fileId = "";
+    const int remotePermId = mapRemotePermissions(record._remotePerm);
+
+    const auto checksumHeader = ChecksumHeader::parseChecksumHeader(record._checksumHeader);
+    int contentChecksumTypeId = mapChecksumType(checksumHeader.type());
+
+    query.bindValue(firstPos, getPHash(record._path));
+    query.bindValue(firstPos + 1, record._path.length());
+    query.bindValue(firstPos + 2, record._path);
+    query.bindValue(firstPos + 3, record._inode);
+    query.bindValue(firstPos + 4, 0); // uid Not used
+    query.bindValue(firstPos + 5, 0); // gid Not used
+    query.bindValue(firstPos + 6, 0); // mode Not used
+    query.bindValue(firstPos + 7, record._modtime);
+    query.bindValue(firstPos + 8, record._type);
+    query.bindValue(firstPos + 9, etag);
+    query.bindValue(firstPos + 10, fileId);
+    query.bindValue(firstPos + 11, remotePermId);
+    query.bindValue(firstPos + 12, record._fileSize);
+    query.bindValue(firstPos + 13, record._serverHasIgnoredFiles ? 1 : 0);
+    bindChecksum(query, firstPos + 14, checksumHeader.checksum());
+    query.bindValue(firstPos + 15, contentChecksumTypeId);
+    query.bindValue(firstPos + 16, record._hasDirtyPlaceholder);
 }
 
 Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &_record)
 {
     SyncJournalFileRecord record = _record;
     QMutexLocker locker(&_mutex);
+    _metadataSnapshot.reset();
 
     if (!_etagStorageFilter.isEmpty()) {
         // If we are a directory that should not be read from db next time, don't write the etag
@@ -853,45 +1413,21 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
                  << "etag:" << record._etag << "fileId:" << record._fileId << "remotePerm:" << record._remotePerm.toString()
                  << "fileSize:" << record._fileSize << "checksum:" << record._checksumHeader << "hasDirtyPlaceholder:" << record._hasDirtyPlaceholder;
 
-    const qint64 phash = getPHash(record._path);
+    if (enqueueWrite(_pendingFileRecords, record._path, std::make_optional(record))) {
+        // Can't be true anymore.
+        _metadataTableIsEmpty = false;
+        return {};
+    }
+
     if (checkConnect()) {
-        int plen = record._path.length();
-
-        QByteArray etag(record._etag);
-        if (etag.isEmpty())
-            etag = "";
-        QByteArray fileId(record._fileId);
-        if (fileId.isEmpty())
-            fileId = "";
-        QByteArray remotePerm = record._remotePerm.toDbValue();
-
-        const auto checksumHeader = ChecksumHeader::parseChecksumHeader(record._checksumHeader);
-        int contentChecksumTypeId = mapChecksumType(checksumHeader.type());
         const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordQuery, QByteArrayLiteral("INSERT OR REPLACE INTO metadata "
-                                                                                                            "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePerm, filesize, ignoredChildrenRemote, contentChecksum, contentChecksumTypeId, hasDirtyPlaceholder) "
+                                                                                                            "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePermId, filesize, ignoredChildrenRemote, contentChecksum, contentChecksumTypeId, hasDirtyPlaceholder) "
                                                                                                             "VALUES (?1 , ?2, ?3 , ?4 , ?5 , ?6 , ?7,  ?8 , ?9 , ?10, ?11, ?12, ?13, ?14, ?15, ?16, ?17);"),
             _db);
         if (!query) {
             return query->error();
         }
-
-        query->bindValue(1, phash);
-        query->bindValue(2, plen);
-        query->bindValue(3, record._path);
-        query->bindValue(4, record._inode);
-        query->bindValue(5, 0); // uid Not used
-        query->bindValue(6, 0); // gid Not used
-        query->bindValue(7, 0); // mode Not used
-        query->bindValue(8, record._modtime);
-        query->bindValue(9, record._type);
-        query->bindValue(10, etag);
-        query->bindValue(11, fileId);
-        query->bindValue(12, remotePerm);
-        query->bindValue(13, record._fileSize);
-        query->bindValue(14, record._serverHasIgnoredFiles ? 1 : 0);
-        query->bindValue(15, checksumHeader.checksum());
-        query->bindValue(16, contentChecksumTypeId);
-        query->bindValue(17, record._hasDirtyPlaceholder);
+        bindFileRecord(*query, 1, record);
 
         if (!query->exec()) {
             return query->error();
@@ -907,10 +1443,15 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
     }
 }
 
-// TODO: filename -> QBytearray?
-bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
+bool SyncJournalDb::deleteFileRecord(const QByteArray &filename, bool recursively)
 {
     QMutexLocker locker(&_mutex);
+    _metadataSnapshot.reset();
+
+    // recursive deletes write the queue first, see checkConnect()
+    if (!recursively && enqueueWrite(_pendingFileRecords, filename, std::optional<SyncJournalFileRecord>())) {
+        return true;
+    }
 
     if (checkConnect()) {
         // if (!recursively) {
@@ -922,7 +1463,7 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
                 return false;
             }
 
-            const qint64 phash = getPHash(filename.toUtf8());
+            const qint64 phash = getPHash(filename);
             query->bindValue(1, phash);
 
             if (!query->exec()) {
@@ -959,6 +1500,13 @@ bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRec
     if (_metadataTableIsEmpty)
         return true; // no error, yet nothing found (rec->isValid() == false)
 
+    if (_metadataSnapshot) {
+        if (!filename.isEmpty()) {
+            _metadataSnapshot->findRecord(filename, rec);
+        }
+        return true;
+    }
+
     if (!checkConnect())
         return false;
 
@@ -1001,6 +1549,11 @@ bool SyncJournalDb::getFileRecordByInode(quint64 inode, SyncJournalFileRecord *r
     if (!inode || _metadataTableIsEmpty)
         return true; // no error, yet nothing found (rec->isValid() == false)
 
+    if (_metadataSnapshot) {
+        _metadataSnapshot->findRecordByInode(inode, rec);
+        return true;
+    }
+
     if (!checkConnect())
         return false;
     const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByInode, getFileRecordQueryC + QByteArrayLiteral("WHERE inode=?1"), _db);
@@ -1028,6 +1581,11 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     if (fileId.isEmpty() || _metadataTableIsEmpty)
         return true; // no error, yet nothing found (rec->isValid() == false)
 
+    if (_metadataSnapshot) {
+        _metadataSnapshot->listRecordsByFileId(fileId, rowCallback);
+        return true;
+    }
+
     if (!checkConnect())
         return false;
 
@@ -1056,17 +1614,61 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     return true;
 }
 
-bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
+bool SyncJournalDb::getFileRecordsByContentChecksum(
+    const QByteArray &checksumHeader, qint64 size, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
 {
     QMutexLocker locker(&_mutex);
 
-    if (_metadataTableIsEmpty)
+    const auto header = ChecksumHeader::parseChecksumHeader(checksumHeader);
+    if (!header.isValid() || _metadataTableIsEmpty)
         return true; // no error, yet nothing found
 
     if (!checkConnect())
         return false;
 
-    auto _exec = [&rowCallback](SqlQuery &query) {
+    const int checksumTypeId = mapChecksumType(header.type());
+    if (!checksumTypeId)
+        return false;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByContentChecksum,
+        getFileRecordQueryC + QByteArrayLiteral("WHERE filesize=?1 AND contentChecksum=?2 AND contentChecksumTypeId=?3"), _db);
+    if (!query) {
+        return false;
+    }
+
+    query->bindValue(1, size);
+    bindChecksum(*query, 2, header.checksum());
+    query->bindValue(3, checksumTypeId);
+
+    if (!query->exec())
+        return false;
+
+    while (true) {
+        auto next = query->next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, *query);
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
+bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return true; // no error, yet nothing found
+
+    if (!checkConnect())
+        return false;
+
+    auto _exec = [&rowCallback](SqlQuery &query) {
         if (!query.exec()) {
             return false;
         }
@@ -1091,7 +1693,7 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
         // and find nothing. So, unfortunately, we have to use a different query for
         // retrieving the whole tree.
 
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetAllFilesQuery, getFileRecordQueryC + QByteArrayLiteral("ORDER BY path||'/' ASC"), _db);
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetAllFilesQuery, getFileRecordQueryC + QByteArrayLiteral("ORDER BY path ASC"), _db);
         if (!query) {
             return false;
         }
@@ -1099,14 +1701,11 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
     } else {
         // This query is used to skip discovery and fill the tree from the
         // database instead
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFilesBelowPathQuery, getFileRecordQueryC + QByteArrayLiteral("WHERE " IS_PREFIX_PATH_OF("?1", "path")
-                                                                                                  // We want to ensure that the contents of a directory are sorted
-                                                                                                  // directly behind the directory itself. Without this ORDER BY
-                                                                                                  // an ordering like foo, foo-2, foo/file would be returned.
-                                                                                                  // With the trailing /, we get foo-2, foo, foo/file. This property
-                                                                                                  // is used in fill_tree_from_db().
-                                                                                                  " ORDER BY path||'/' ASC"),
-            _db);
+        // The prefix check is a range on path, both it and the ORDER BY are served by the
+        // metadata_path index. Ordering by an expression like path||'/' would sort the
+        // whole subtree in a temporary b-tree instead.
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFilesBelowPathQuery,
+            getFileRecordQueryC + QByteArrayLiteral("WHERE " IS_PREFIX_PATH_OF("?1", "path") " ORDER BY path ASC"), _db);
         if (!query) {
             return false;
         }
@@ -1123,6 +1722,11 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
     if (_metadataTableIsEmpty)
         return true;
 
+    if (_metadataSnapshot) {
+        _metadataSnapshot->listFilesInPath(path, rowCallback);
+        return true;
+    }
+
     if (!checkConnect())
         return false;
 
@@ -1154,6 +1758,84 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
     return true;
 }
 
+bool SyncJournalDb::listFilesInPath(
+    const QByteArray &path, const QByteArray &after, int limit, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return true;
+
+    if (_metadataSnapshot) {
+        _metadataSnapshot->listFilesInPath(path, after, limit, rowCallback);
+        return true;
+    }
+
+    if (!checkConnect())
+        return false;
+
+    // Within one directory the order of the paths is the one of the names. The metadata_parent
+    // index covers (parent_hash(path), path), so a page is a range scan that starts right
+    // after the previous one, instead of a sort of the whole directory for every page.
+    const auto query = _queryManager.get(PreparedSqlQueryManager::ListFilesInPathPageQuery,
+        getFileRecordQueryC + QByteArrayLiteral("WHERE parent_hash(path) = ?1 AND path > ?2 ORDER BY path LIMIT ?3"), _db);
+    if (!query) {
+        return false;
+    }
+    query->bindValue(1, getPHash(path));
+    query->bindValue(2, after);
+    query->bindValue(3, limit);
+
+    if (!query->exec())
+        return false;
+
+    while (true) {
+        auto next = query->next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, *query);
+        if (!rec._path.startsWith(path) || rec._path.indexOf("/", path.size() + 1) > 0) {
+            qWarning(lcDb) << "hash collision" << path << rec._path;
+            continue;
+        }
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
+int SyncJournalDb::countFilesInPath(const QByteArray &path)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return 0;
+
+    if (_metadataSnapshot) {
+        int count = 0;
+        _metadataSnapshot->listFilesInPath(path, [&count](const SyncJournalFileRecord &) { ++count; });
+        return count;
+    }
+
+    if (!checkConnect())
+        return -1;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::CountFilesInPathQuery, QByteArrayLiteral("SELECT COUNT(*) FROM metadata WHERE parent_hash(path) = ?1"), _db);
+    if (!query) {
+        return -1;
+    }
+    query->bindValue(1, getPHash(path));
+
+    if (!query->exec() || !query->next().hasData)
+        return -1;
+
+    return query->intValue(0);
+}
+
 int SyncJournalDb::getFileRecordCount()
 {
     QMutexLocker locker(&_mutex);
@@ -1173,15 +1855,14 @@ int SyncJournalDb::getFileRecordCount()
     return -1;
 }
 
-bool SyncJournalDb::updateFileRecordChecksum(const QString &filename,
-    const QByteArray &contentChecksum,
-    CheckSums::Algorithm contentChecksumType)
+bool SyncJournalDb::updateFileRecordChecksum(const QByteArray &filename, const QByteArray &contentChecksum, CheckSums::Algorithm contentChecksumType)
 {
     QMutexLocker locker(&_mutex);
+    _metadataSnapshot.reset();
 
     qCInfo(lcDb) << "Updating file checksum" << filename << contentChecksum << contentChecksumType;
 
-    const qint64 phash = getPHash(filename.toUtf8());
+    const qint64 phash = getPHash(filename);
     if (!checkConnect()) {
         qCWarning(lcDb) << "Failed to connect database.";
         return false;
@@ -1197,7 +1878,7 @@ bool SyncJournalDb::updateFileRecordChecksum(const QString &filename,
         return false;
     }
     query->bindValue(1, phash);
-    query->bindValue(2, contentChecksum);
+    bindChecksum(*query, 2, contentChecksum);
     query->bindValue(3, checksumTypeId);
     return query->exec();
 }
@@ -1245,21 +1926,23 @@ static void toDownloadInfo(SqlQuery &query, SyncJournalDb::DownloadInfo *res)
     res->_valid = ok;
 }
 
-static bool deleteBatch(SqlQuery &query, const QStringList &entries, const QString &name)
+bool SyncJournalDb::setKeptPaths(const QStringList &keep)
 {
-    if (entries.isEmpty())
-        return true;
-
-    qCDebug(lcDb) << "Removing stale" << name << "entries:" << entries.join(QStringLiteral(", "));
-    // FIXME: Was ported from execBatch, check if correct!
-    for (const auto &entry : entries) {
-        query.reset_and_clear_bindings();
-        query.bindValue(1, entry);
-        if (!query.exec()) {
+    SqlQuery createQuery("CREATE TEMP TABLE IF NOT EXISTS keptpaths (path TEXT PRIMARY KEY);", _db);
+    SqlQuery clearQuery("DELETE FROM temp.keptpaths;", _db);
+    if (!createQuery.exec() || !clearQuery.exec()) {
+        qCWarning(lcDb) << "Failed to clear the kept paths" << createQuery.error() << clearQuery.error();
+        return false;
+    }
+    SqlQuery insQuery("INSERT OR IGNORE INTO temp.keptpaths VALUES (?1);", _db);
+    for (const auto &path : keep) {
+        insQuery.reset_and_clear_bindings();
+        insQuery.bindValue(1, path);
+        if (!insQuery.exec()) {
+            qCWarning(lcDb) << "Failed to insert the kept path" << path << insQuery.error();
             return false;
         }
     }
-
     return true;
 }
 
@@ -1292,6 +1975,10 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
 {
     QMutexLocker locker(&_mutex);
 
+    if (enqueueWrite(_pendingDownloadInfos, file, i._valid ? std::make_optional(i) : std::nullopt)) {
+        return;
+    }
+
     if (!checkConnect()) {
         return;
     }
@@ -1317,46 +2004,61 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
     }
 }
 
-QVector<SyncJournalDb::DownloadInfo> SyncJournalDb::getAndDeleteStaleDownloadInfos(const QSet<QString> &keep)
+QVector<SyncJournalDb::DownloadInfo> SyncJournalDb::getAndDeleteStaleDownloadInfos(const QStringList &keep)
 {
-    QVector<SyncJournalDb::DownloadInfo> empty_result;
     QMutexLocker locker(&_mutex);
 
-    if (!checkConnect()) {
-        return empty_result;
+    if (!checkConnect() || !setKeptPaths(keep)) {
+        return {};
     }
 
-    QStringList superfluousPaths;
     QVector<SyncJournalDb::DownloadInfo> deleted_entries;
-    {
-        SqlQuery query(_db);
-        // The selected values *must* match the ones expected by toDownloadInfo().
-        query.prepare("SELECT tmpfile, etag, errorcount, path FROM downloadinfo");
-
-        if (!query.exec()) {
-            return empty_result;
-        }
-
-        while (query.next().hasData) {
-            const QString file = query.stringValue(3); // path
-            if (!keep.contains(file)) {
-                superfluousPaths.append(file);
-                DownloadInfo info;
-                toDownloadInfo(query, &info);
-                deleted_entries.append(info);
-            }
-        }
+    SqlQuery query(_db);
+    // The selected values *must* match the ones expected by toDownloadInfo().
+    query.prepare("SELECT tmpfile, etag, errorcount, path FROM downloadinfo WHERE path NOT IN (SELECT path FROM temp.keptpaths);");
+    if (!query.exec()) {
+        return {};
     }
-    {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteDownloadInfoQuery);
-        if (!deleteBatch(*query, superfluousPaths, QStringLiteral("downloadinfo"))) {
-            return empty_result;
-        }
+    while (query.next().hasData) {
+        DownloadInfo info;
+        toDownloadInfo(query, &info);
+        deleted_entries.append(info);
+    }
+    if (deleted_entries.isEmpty()) {
+        return {};
     }
 
+    qCDebug(lcDb) << "Removing" << deleted_entries.size() << "stale downloadinfo entries";
+    SqlQuery delQuery("DELETE FROM downloadinfo WHERE path NOT IN (SELECT path FROM temp.keptpaths);", _db);
+    if (!delQuery.exec()) {
+        return {};
+    }
     return deleted_entries;
 }
 
+QHash<QString, SyncJournalDb::DownloadInfo> SyncJournalDb::getDownloadInfos()
+{
+    QHash<QString, DownloadInfo> res;
+    QMutexLocker locker(&_mutex);
+
+    if (!checkConnect()) {
+        return res;
+    }
+
+    SqlQuery query(_db);
+    // The selected values *must* match the ones expected by toDownloadInfo().
+    query.prepare("SELECT tmpfile, etag, errorcount, path FROM downloadinfo");
+    if (!query.exec()) {
+        return res;
+    }
+    while (query.next().hasData) {
+        DownloadInfo info;
+        toDownloadInfo(query, &info);
+        res.insert(query.stringValue(3), info);
+    }
+    return res;
+}
+
 int SyncJournalDb::downloadInfoCount()
 {
     int re = 0;
@@ -1447,6 +2149,10 @@ void SyncJournalDb::setUploadInfo(const QString &file, const SyncJournalDb::Uplo
 {
     QMutexLocker locker(&_mutex);
 
+    if (enqueueWrite(_pendingUploadInfos, file, i._valid ? std::make_optional(i) : std::nullopt)) {
+        return;
+    }
+
     if (!checkConnect()) {
         return;
     }
@@ -1482,95 +2188,99 @@ void SyncJournalDb::setUploadInfo(const QString &file, const SyncJournalDb::Uplo
     }
 }
 
-QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QSet<QString> &keep)
+QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QStringList &keep)
 {
     QMutexLocker locker(&_mutex);
 
-    if (!checkConnect()) {
+    if (!checkConnect() || !setKeptPaths(keep)) {
         return {};
     }
 
     SqlQuery query(_db);
-    query.prepare("SELECT path,transferid FROM uploadinfo");
-
+    query.prepare("SELECT transferid FROM uploadinfo WHERE path NOT IN (SELECT path FROM temp.keptpaths);");
     if (!query.exec()) {
         return {};
     }
 
-    QStringList superfluousPaths;
     QVector<uint> ids;
-
     while (query.next().hasData) {
-        const QString file = query.stringValue(0);
-        if (!keep.contains(file)) {
-            superfluousPaths.append(file);
-            ids.append(query.intValue(1));
-        }
+        ids.append(query.intValue(0));
+    }
+    if (ids.isEmpty()) {
+        return ids;
     }
-    qCDebug(lcDb) << Q_FUNC_INFO << "Keep:" << keep << "Removing Stale:" << superfluousPaths;
-    const auto deleteUploadInfoQuery = _queryManager.get(PreparedSqlQueryManager::DeleteUploadInfoQuery);
-    deleteBatch(*deleteUploadInfoQuery, superfluousPaths, QStringLiteral("uploadinfo"));
+
+    qCDebug(lcDb) << "Removing" << ids.size() << "stale uploadinfo entries";
+    SqlQuery delQuery("DELETE FROM uploadinfo WHERE path NOT IN (SELECT path FROM temp.keptpaths);", _db);
+    delQuery.exec();
     return ids;
 }
 
+// The selected values *must* match the ones of the GetErrorBlacklistQuery
+static SyncJournalErrorBlacklistRecord toErrorBlacklistRecord(SqlQuery &query, const QString &file)
+{
+    SyncJournalErrorBlacklistRecord entry;
+    entry._lastTryEtag = query.baValue(0);
+    entry._lastTryModtime = query.int64Value(1);
+    entry._retryCount = query.intValue(2);
+    entry._errorString = query.stringValue(3);
+    entry._lastTryTime = query.int64Value(4);
+    entry._ignoreDuration = query.int64Value(5);
+    entry._renameTarget = query.stringValue(6);
+    entry._errorCategory = static_cast<SyncJournalErrorBlacklistRecord::Category>(query.intValue(7));
+    entry._requestId = query.baValue(8);
+    entry._file = file;
+    return entry;
+}
+
 SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString &file)
 {
     QMutexLocker locker(&_mutex);
-    SyncJournalErrorBlacklistRecord entry;
 
     if (file.isEmpty())
-        return entry;
+        return {};
 
     if (checkConnect()) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::GetErrorBlacklistQuery);
         query->bindValue(1, file);
-        if (query->exec()) {
-            if (query->next().hasData) {
-                entry._lastTryEtag = query->baValue(0);
-                entry._lastTryModtime = query->int64Value(1);
-                entry._retryCount = query->intValue(2);
-                entry._errorString = query->stringValue(3);
-                entry._lastTryTime = query->int64Value(4);
-                entry._ignoreDuration = query->int64Value(5);
-                entry._renameTarget = query->stringValue(6);
-                entry._errorCategory = static_cast<SyncJournalErrorBlacklistRecord::Category>(
-                    query->intValue(7));
-                entry._requestId = query->baValue(8);
-                entry._file = file;
-            }
+        if (query->exec() && query->next().hasData) {
+            return toErrorBlacklistRecord(*query, file);
         }
     }
 
-    return entry;
+    return {};
 }
 
-bool SyncJournalDb::deleteStaleErrorBlacklistEntries(const QSet<QString> &keep)
+QVector<SyncJournalErrorBlacklistRecord> SyncJournalDb::errorBlacklistEntries()
 {
     QMutexLocker locker(&_mutex);
 
+    QVector<SyncJournalErrorBlacklistRecord> entries;
     if (!checkConnect()) {
-        return false;
+        return entries;
     }
-
     SqlQuery query(_db);
-    query.prepare("SELECT path FROM blacklist");
-
+    query.prepare("SELECT lastTryEtag, lastTryModtime, retrycount, errorstring, lastTryTime, ignoreDuration, renameTarget, errorCategory, requestId, path "
+                  "FROM blacklist");
     if (!query.exec()) {
-        return false;
+        return entries;
+    }
+    while (query.next().hasData) {
+        entries.append(toErrorBlacklistRecord(query, query.stringValue(9)));
     }
+    return entries;
+}
 
-    QStringList superfluousPaths;
+bool SyncJournalDb::deleteStaleErrorBlacklistEntries(const QStringList &keep)
+{
+    QMutexLocker locker(&_mutex);
 
-    while (query.next().hasData) {
-        const QString file = query.stringValue(0);
-        if (!keep.contains(file)) {
-            superfluousPaths.append(file);
-        }
+    if (!checkConnect() || !setKeptPaths(keep)) {
+        return false;
     }
 
-    SqlQuery delQuery(_db);
-    delQuery.prepare("DELETE FROM blacklist WHERE path = ?");
-    return deleteBatch(delQuery, superfluousPaths, QStringLiteral("blacklist"));
+    SqlQuery delQuery("DELETE FROM blacklist WHERE path NOT IN (SELECT path FROM temp.keptpaths);", _db);
+    return delQuery.exec();
 }
 
 void SyncJournalDb::deleteStaleFlagsEntries()
@@ -1581,6 +2291,7 @@ void SyncJournalDb::deleteStaleFlagsEntries()
 
     SqlQuery delQuery("DELETE FROM flags WHERE path != '' AND path NOT IN (SELECT path from metadata);", _db);
     delQuery.exec();
+    _pinStates.reset();
 }
 
 int SyncJournalDb::errorBlackListEntryCount()
@@ -1715,6 +2426,11 @@ QSet<QString> SyncJournalDb::getSelectiveSyncList(SyncJournalDb::SelectiveSyncLi
         *ok = false;
         return result;
     }
+    const auto cached = _selectiveSyncListCache.constFind(type);
+    if (cached != _selectiveSyncListCache.cend()) {
+        *ok = true;
+        return cached.value();
+    }
 
     const auto query = _queryManager.get(PreparedSqlQueryManager::GetSelectiveSyncListQuery, QByteArrayLiteral("SELECT path FROM selectivesync WHERE type=?1"), _db);
     if (!query) {
@@ -1743,6 +2459,7 @@ QSet<QString> SyncJournalDb::getSelectiveSyncList(SyncJournalDb::SelectiveSyncLi
         result.insert(entry);
     }
     *ok = true;
+    _selectiveSyncListCache.insert(type, result);
 
     return result;
 }
@@ -1754,6 +2471,7 @@ void SyncJournalDb::setSelectiveSyncList(SyncJournalDb::SelectiveSyncListType ty
         return;
     }
 
+    _selectiveSyncListCache.remove(type);
     startTransaction();
 
     //first, delete all entries of this type
@@ -1784,6 +2502,7 @@ void SyncJournalDb::avoidRenamesOnNextSync(const QByteArray &path)
         return;
     }
 
+    _metadataSnapshot.reset();
     SqlQuery query(_db);
     query.prepare("UPDATE metadata SET fileid = '', inode = '0' WHERE " IS_PREFIX_PATH_OR_EQUAL("?1", "path"));
     query.bindValue(1, path);
@@ -1807,6 +2526,7 @@ void SyncJournalDb::schedulePathForRemoteDiscovery(const QByteArray &fileName)
     if (argument.endsWith('/'))
         argument.chop(1);
 
+    _metadataSnapshot.reset();
     SqlQuery query(_db);
     // This query will match entries for which the path is a prefix of fileName
     // Note: ItemTypeDirectory == 2
@@ -1839,6 +2559,7 @@ void SyncJournalDb::forceRemoteDiscoveryNextSync()
 void SyncJournalDb::forceRemoteDiscoveryNextSyncLocked()
 {
     qCInfo(lcDb) << "Forcing remote re-discovery by deleting folder Etags";
+    _metadataSnapshot.reset();
     SqlQuery deleteRemoteFolderEtagsQuery(_db);
     deleteRemoteFolderEtagsQuery.prepare("UPDATE metadata SET md5='_invalid_' WHERE type=2;");
     deleteRemoteFolderEtagsQuery.exec();
@@ -1915,6 +2636,48 @@ int SyncJournalDb::mapChecksumType(CheckSums::Algorithm checksumType)
     }
 }
 
+int SyncJournalDb::mapRemotePermissions(const RemotePermissions &permissions)
+{
+    if (permissions.isNull()) {
+        return 0;
+    }
+
+    const auto perm = permissions.toDbValue();
+    auto it = _remotePermissionsCache.constFind(perm);
+    if (it != _remotePermissionsCache.cend()) {
+        return *it;
+    }
+
+    {
+        const auto query = _queryManager.get(
+            PreparedSqlQueryManager::InsertRemotePermissionsQuery, QByteArrayLiteral("INSERT OR IGNORE INTO remotepermissions (perm) VALUES (?1)"), _db);
+        if (!query) {
+            return 0;
+        }
+        query->bindValue(1, perm);
+        if (!query->exec()) {
+            return 0;
+        }
+    }
+
+    const auto query =
+        _queryManager.get(PreparedSqlQueryManager::GetRemotePermissionsIdQuery, QByteArrayLiteral("SELECT id FROM remotepermissions WHERE perm=?1"), _db);
+    if (!query) {
+        return 0;
+    }
+    query->bindValue(1, perm);
+    if (!query->exec()) {
+        return 0;
+    }
+    if (!query->next().hasData) {
+        qCWarning(lcDb) << "No remote permissions mapping found for" << perm;
+        return 0;
+    }
+    const auto value = query->intValue(0);
+    _remotePermissionsCache.insert(perm, value);
+    return value;
+}
+
 QByteArray SyncJournalDb::dataFingerprint()
 {
     QMutexLocker locker(&_mutex);
@@ -1956,45 +2719,135 @@ void SyncJournalDb::setDataFingerprint(const QByteArray &dataFingerprint)
     setDataFingerprintQuery2->exec();
 }
 
-void SyncJournalDb::setConflictRecord(const ConflictRecord &record)
+QByteArray SyncJournalDb::changeJournalPosition()
 {
     QMutexLocker locker(&_mutex);
-    if (!checkConnect())
-        return;
+    if (!checkConnect()) {
+        return QByteArray();
+    }
 
-    const auto query = _queryManager.get(PreparedSqlQueryManager::SetConflictRecordQuery, QByteArrayLiteral("INSERT OR REPLACE INTO conflicts "
-                                                                                                            "(path, baseFileId, baseModtime, baseEtag, basePath) "
-                                                                                                            "VALUES (?1, ?2, ?3, ?4, ?5);"),
-        _db);
-    OC_ASSERT(query);
-    query->bindValue(1, record.path);
-    query->bindValue(2, record.baseFileId);
-    query->bindValue(3, record.baseModtime);
-    query->bindValue(4, record.baseEtag);
-    query->bindValue(5, record.initialBasePath);
-    OC_ASSERT(query->exec());
+    const auto query =
+        _queryManager.get(PreparedSqlQueryManager::GetChangeJournalPositionQuery, QByteArrayLiteral("SELECT position FROM changejournal"), _db);
+    if (!query) {
+        return QByteArray();
+    }
+
+    if (!query->exec()) {
+        return QByteArray();
+    }
+
+    if (!query->next().hasData) {
+        return QByteArray();
+    }
+    return query->baValue(0);
 }
 
-ConflictRecord SyncJournalDb::conflictRecord(const QByteArray &path)
+void SyncJournalDb::setChangeJournalPosition(const QByteArray &position)
 {
-    ConflictRecord entry;
-
     QMutexLocker locker(&_mutex);
     if (!checkConnect()) {
-        return entry;
+        return;
     }
-    const auto query = _queryManager.get(PreparedSqlQueryManager::GetConflictRecordQuery, QByteArrayLiteral("SELECT baseFileId, baseModtime, baseEtag, basePath FROM conflicts WHERE path=?1;"), _db);
-    OC_ASSERT(query);
-    query->bindValue(1, path);
-    OC_ASSERT(query->exec());
-    if (!query->next().hasData)
-        return entry;
 
-    entry.path = path;
-    entry.baseFileId = query->baValue(0);
-    entry.baseModtime = query->int64Value(1);
-    entry.baseEtag = query->baValue(2);
-    entry.initialBasePath = query->baValue(3);
+    const auto setPositionQuery1 =
+        _queryManager.get(PreparedSqlQueryManager::SetChangeJournalPositionQuery1, QByteArrayLiteral("DELETE FROM changejournal;"), _db);
+    const auto setPositionQuery2 = _queryManager.get(
+        PreparedSqlQueryManager::SetChangeJournalPositionQuery2, QByteArrayLiteral("INSERT INTO changejournal (position) VALUES (?1);"), _db);
+    if (!setPositionQuery1 || !setPositionQuery2) {
+        return;
+    }
+
+    setPositionQuery1->exec();
+
+    if (!position.isEmpty()) {
+        setPositionQuery2->bindValue(1, position);
+        setPositionQuery2->exec();
+    }
+}
+
+QByteArray SyncJournalDb::syncToken()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return QByteArray();
+    }
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetSyncTokenQuery, QByteArrayLiteral("SELECT token FROM synctoken"), _db);
+    if (!query) {
+        return QByteArray();
+    }
+
+    if (!query->exec()) {
+        return QByteArray();
+    }
+
+    if (!query->next().hasData) {
+        return QByteArray();
+    }
+    return query->baValue(0);
+}
+
+void SyncJournalDb::setSyncToken(const QByteArray &token)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    const auto setTokenQuery1 = _queryManager.get(PreparedSqlQueryManager::SetSyncTokenQuery1, QByteArrayLiteral("DELETE FROM synctoken;"), _db);
+    const auto setTokenQuery2 =
+        _queryManager.get(PreparedSqlQueryManager::SetSyncTokenQuery2, QByteArrayLiteral("INSERT INTO synctoken (token) VALUES (?1);"), _db);
+    if (!setTokenQuery1 || !setTokenQuery2) {
+        return;
+    }
+
+    setTokenQuery1->exec();
+
+    if (!token.isEmpty()) {
+        setTokenQuery2->bindValue(1, token);
+        setTokenQuery2->exec();
+    }
+}
+
+void SyncJournalDb::setConflictRecord(const ConflictRecord &record)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::SetConflictRecordQuery, QByteArrayLiteral("INSERT OR REPLACE INTO conflicts "
+                                                                                                            "(path, baseFileId, baseModtime, baseEtag, basePath) "
+                                                                                                            "VALUES (?1, ?2, ?3, ?4, ?5);"),
+        _db);
+    OC_ASSERT(query);
+    query->bindValue(1, record.path);
+    query->bindValue(2, record.baseFileId);
+    query->bindValue(3, record.baseModtime);
+    query->bindValue(4, record.baseEtag);
+    query->bindValue(5, record.initialBasePath);
+    OC_ASSERT(query->exec());
+}
+
+ConflictRecord SyncJournalDb::conflictRecord(const QByteArray &path)
+{
+    ConflictRecord entry;
+
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return entry;
+    }
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetConflictRecordQuery, QByteArrayLiteral("SELECT baseFileId, baseModtime, baseEtag, basePath FROM conflicts WHERE path=?1;"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, path);
+    OC_ASSERT(query->exec());
+    if (!query->next().hasData)
+        return entry;
+
+    entry.path = path;
+    entry.baseFileId = query->baValue(0);
+    entry.baseModtime = query->int64Value(1);
+    entry.baseEtag = query->baValue(2);
+    entry.initialBasePath = query->baValue(3);
     return entry;
 }
 
@@ -2010,6 +2863,289 @@ void SyncJournalDb::deleteConflictRecord(const QByteArray &path)
     OC_ASSERT(query->exec());
 }
 
+void SyncJournalDb::setHydrationTime(const QByteArray &path, qint64 time)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    const auto query =
+        _queryManager.get(PreparedSqlQueryManager::SetHydrationTimeQuery, QByteArrayLiteral("INSERT OR REPLACE INTO hydrations (path, time) VALUES (?1, ?2);"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, path);
+    query->bindValue(2, time);
+    OC_ASSERT(query->exec());
+}
+
+qint64 SyncJournalDb::hydrationTime(const QByteArray &path)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return 0;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetHydrationTimeQuery, QByteArrayLiteral("SELECT time FROM hydrations WHERE path=?1;"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, path);
+    OC_ASSERT(query->exec());
+    if (!query->next().hasData)
+        return 0;
+    return query->int64Value(0);
+}
+
+QByteArrayList SyncJournalDb::hydratedAround(qint64 time, qint64 window, int limit)
+{
+    QByteArrayList paths;
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return paths;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetHydratedAroundQuery,
+        QByteArrayLiteral("SELECT path FROM hydrations WHERE time BETWEEN ?1 AND ?2 ORDER BY abs(time - ?3) LIMIT ?4;"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, time - window);
+    query->bindValue(2, time + window);
+    query->bindValue(3, time);
+    query->bindValue(4, limit);
+    OC_ASSERT(query->exec());
+    while (query->next().hasData) {
+        paths.append(query->baValue(0));
+    }
+    return paths;
+}
+
+void SyncJournalDb::deleteHydrationsBefore(qint64 time)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    SqlQuery query("DELETE FROM hydrations WHERE time < ?1;", _db);
+    query.bindValue(1, time);
+    OC_ASSERT(query.exec());
+}
+
+void SyncJournalDb::setAccessTime(const QByteArray &path, qint64 time)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    const auto query =
+        _queryManager.get(PreparedSqlQueryManager::SetAccessTimeQuery, QByteArrayLiteral("INSERT OR REPLACE INTO accesstimes (path, time) VALUES (?1, ?2);"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, path);
+    query->bindValue(2, time);
+    OC_ASSERT(query->exec());
+}
+
+QVector<SyncJournalDb::HydratedFile> SyncJournalDb::leastRecentlyUsedFiles(int limit, int offset)
+{
+    QVector<HydratedFile> files;
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return files;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetLeastRecentlyUsedFilesQuery,
+        QByteArrayLiteral("SELECT metadata.path, metadata.filesize, COALESCE(accesstimes.time, metadata.modtime * 1000) AS lastaccess FROM metadata "
+                          "LEFT JOIN accesstimes ON accesstimes.path = metadata.path WHERE metadata.type = ?1 ORDER BY lastaccess ASC LIMIT ?2 OFFSET ?3;"),
+        _db);
+    OC_ASSERT(query);
+    query->bindValue(1, ItemTypeFile);
+    query->bindValue(2, limit);
+    query->bindValue(3, offset);
+    OC_ASSERT(query->exec());
+    while (query->next().hasData) {
+        files.append({query->baValue(0), query->int64Value(1), query->int64Value(2)});
+    }
+    return files;
+}
+
+qint64 SyncJournalDb::hydratedFilesSize()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return 0;
+
+    const auto query = _queryManager.get(
+        PreparedSqlQueryManager::GetHydratedFilesSizeQuery, QByteArrayLiteral("SELECT COALESCE(SUM(filesize), 0) FROM metadata WHERE type = ?1;"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, ItemTypeFile);
+    OC_ASSERT(query->exec());
+    if (!query->next().hasData)
+        return 0;
+    return query->int64Value(0);
+}
+
+void SyncJournalDb::deleteStaleAccessTimes()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    SqlQuery query("DELETE FROM accesstimes WHERE path NOT IN (SELECT path FROM metadata);", _db);
+    OC_ASSERT(query.exec());
+}
+
+QByteArray SyncJournalDb::cachedChecksum(quint64 inode, qint64 modtime, qint64 size, CheckSums::Algorithm checksumType)
+{
+    QMutexLocker locker(&_mutex);
+    if (inode == 0 || !checkConnect())
+        return {};
+
+    const int checksumTypeId = mapChecksumType(checksumType);
+    if (checksumTypeId == 0)
+        return {};
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetCachedChecksumQuery,
+        QByteArrayLiteral("SELECT checksum FROM checksumcache WHERE inode=?1 AND checksumTypeId=?2 AND modtime=?3 AND filesize=?4;"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, inode);
+    query->bindValue(2, checksumTypeId);
+    query->bindValue(3, modtime);
+    query->bindValue(4, size);
+    OC_ASSERT(query->exec());
+    if (!query->next().hasData)
+        return {};
+    return query->baValue(0);
+}
+
+void SyncJournalDb::setCachedChecksum(quint64 inode, qint64 modtime, qint64 size, CheckSums::Algorithm checksumType, const QByteArray &checksum)
+{
+    QMutexLocker locker(&_mutex);
+    if (inode == 0 || checksum.isEmpty() || !checkConnect())
+        return;
+
+    const int checksumTypeId = mapChecksumType(checksumType);
+    if (checksumTypeId == 0)
+        return;
+
+    // the primary key replaces the checksum of a previous version of the file
+    const auto query = _queryManager.get(PreparedSqlQueryManager::SetCachedChecksumQuery,
+        QByteArrayLiteral("INSERT OR REPLACE INTO checksumcache (inode, checksumTypeId, modtime, filesize, checksum) VALUES (?1, ?2, ?3, ?4, ?5);"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, inode);
+    query->bindValue(2, checksumTypeId);
+    query->bindValue(3, modtime);
+    query->bindValue(4, size);
+    query->bindValue(5, checksum);
+    OC_ASSERT(query->exec());
+}
+
+void SyncJournalDb::deleteStaleCachedChecksums(const QSet<quint64> &keep)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    // the checksums of files that are in sync with the db stay useful for later conflicts and uploads
+    SqlQuery query("SELECT DISTINCT inode FROM checksumcache WHERE NOT EXISTS (SELECT 1 FROM metadata WHERE metadata.inode = checksumcache.inode "
+                   "AND metadata.modtime = checksumcache.modtime AND metadata.filesize = checksumcache.filesize);",
+        _db);
+    if (!query.exec())
+        return;
+
+    QVector<quint64> superfluous;
+    while (query.next().hasData) {
+        const auto inode = static_cast<quint64>(query.int64Value(0));
+        if (!keep.contains(inode)) {
+            superfluous.append(inode);
+        }
+    }
+    if (superfluous.isEmpty())
+        return;
+
+    qCDebug(lcDb) << "Removing" << superfluous.size() << "stale cached checksums";
+    SqlQuery delQuery("DELETE FROM checksumcache WHERE inode=?1;", _db);
+    for (const auto inode : std::as_const(superfluous)) {
+        delQuery.reset_and_clear_bindings();
+        delQuery.bindValue(1, inode);
+        if (!delQuery.exec()) {
+            return;
+        }
+    }
+}
+
+QHash<QString, SyncJournalDb::LocalFolderFingerprint> SyncJournalDb::localFolderFingerprints()
+{
+    QHash<QString, LocalFolderFingerprint> fingerprints;
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return fingerprints;
+
+    SqlQuery query("SELECT path, modtime, inode FROM localfolderfingerprints;", _db);
+    if (!query.exec())
+        return fingerprints;
+    while (query.next().hasData) {
+        fingerprints.insert(query.stringValue(0), {static_cast<qint64>(query.int64Value(1)), query.int64Value(2)});
+    }
+    return fingerprints;
+}
+
+void SyncJournalDb::setLocalFolderFingerprints(const QHash<QString, LocalFolderFingerprint> &fingerprints)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    SqlQuery query("INSERT OR REPLACE INTO localfolderfingerprints (path, modtime, inode) VALUES (?1, ?2, ?3);", _db);
+    for (auto it = fingerprints.cbegin(); it != fingerprints.cend(); ++it) {
+        query.reset_and_clear_bindings();
+        query.bindValue(1, it.key());
+        query.bindValue(2, it->modtime);
+        query.bindValue(3, it->inode);
+        if (!query.exec()) {
+            return;
+        }
+    }
+    // the root folder has no file record
+    SqlQuery deleteQuery("DELETE FROM localfolderfingerprints WHERE path != '' AND path NOT IN (SELECT path FROM metadata);", _db);
+    deleteQuery.exec();
+}
+
+QVector<SyncJournalDb::ByteRange> SyncJournalDb::hydratedRanges(const QByteArray &path, const QByteArray &etag)
+{
+    QVector<ByteRange> ranges;
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return ranges;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetHydratedRangesQuery,
+        QByteArrayLiteral("SELECT rangestart, rangeend FROM hydratedranges WHERE path=?1 AND etag=?2 ORDER BY rangestart;"), _db);
+    OC_ASSERT(query);
+    query->bindValue(1, path);
+    query->bindValue(2, etag);
+    OC_ASSERT(query->exec());
+    while (query->next().hasData) {
+        ranges.append({query->int64Value(0), query->int64Value(1)});
+    }
+    return ranges;
+}
+
+void SyncJournalDb::setHydratedRanges(const QByteArray &path, const QByteArray &etag, const QVector<ByteRange> &ranges)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    const auto deleteQuery =
+        _queryManager.get(PreparedSqlQueryManager::DeleteHydratedRangesQuery, QByteArrayLiteral("DELETE FROM hydratedranges WHERE path=?1;"), _db);
+    OC_ASSERT(deleteQuery);
+    deleteQuery->bindValue(1, path);
+    OC_ASSERT(deleteQuery->exec());
+
+    const auto insertQuery = _queryManager.get(PreparedSqlQueryManager::SetHydratedRangeQuery,
+        QByteArrayLiteral("INSERT INTO hydratedranges (path, etag, rangestart, rangeend) VALUES (?1, ?2, ?3, ?4);"), _db);
+    OC_ASSERT(insertQuery);
+    for (const auto &range : ranges) {
+        insertQuery->reset_and_clear_bindings();
+        insertQuery->bindValue(1, path);
+        insertQuery->bindValue(2, etag);
+        insertQuery->bindValue(3, range.start);
+        insertQuery->bindValue(4, range.end);
+        OC_ASSERT(insertQuery->exec());
+    }
+}
+
 QByteArrayList SyncJournalDb::conflictRecordPaths()
 {
     QMutexLocker locker(&_mutex);
@@ -2046,17 +3182,116 @@ QByteArray SyncJournalDb::conflictFileBaseName(const QByteArray &conflictName)
 void SyncJournalDb::clearFileTable()
 {
     QMutexLocker lock(&_mutex);
+    _metadataSnapshot.reset();
     SqlQuery query(_db);
     query.prepare("DELETE FROM metadata;");
     query.exec();
 }
 
+bool SyncJournalDb::rebasePaths(const QByteArray &from, const QByteArray &to)
+{
+    QMutexLocker lock(&_mutex);
+    if (!checkConnect())
+        return false;
+
+    _metadataSnapshot.reset();
+    _pinStates.reset();
+    // the rebase is a single transaction of its own, it either applies completely or not at all
+    commitTransaction();
+    if (!_db.transaction()) {
+        qCWarning(lcDb) << "ERROR starting transaction:" << _db.error();
+        return false;
+    }
+
+    const QByteArray fromPrefix = from.isEmpty() ? QByteArray() : from + '/';
+    const QByteArray toPrefix = to.isEmpty() ? QByteArray() : to + '/';
+
+    auto exec = [this](const QByteArray &sql, const QVariantList &values) {
+        SqlQuery query(_db);
+        if (query.prepare(sql) != 0) {
+            return false;
+        }
+        for (int i = 0; i < values.size(); ++i) {
+            query.bindValue(i + 1, values.at(i));
+        }
+        if (!query.exec()) {
+            qCWarning(lcDb) << "Rebasing the journal failed" << query.error();
+            return false;
+        }
+        return true;
+    };
+
+    // The rows are moved through a temporary table, updating the paths in place could
+    // collide with rows that were not moved yet, like "sub/sub/a" becoming "sub/a".
+    // The prefix is cut off in bytes, sqlite counts the length of text in characters.
+    auto rebaseTable = [&](const QByteArray &table, const QByteArray &derivedColumns) {
+        const QByteArray newPath = "?1 || CAST(substr(CAST(path AS BLOB), ?2) AS TEXT)";
+        return exec("DELETE FROM " + table + " WHERE NOT ((?1 == '' AND path != '') OR " IS_PREFIX_PATH_OF("?1", "path") ");", {from})
+            && exec("CREATE TEMP TABLE rebased AS SELECT * FROM " + table + ";", {}) //
+            && exec("DELETE FROM " + table + ";", {}) //
+            && exec("UPDATE temp.rebased SET path = " + newPath + ";", {toPrefix, fromPrefix.size() + 1})
+            && (derivedColumns.isEmpty() || exec("UPDATE temp.rebased SET " + derivedColumns + ";", {}))
+            && exec("INSERT INTO " + table + " SELECT * FROM temp.rebased;", {}) //
+            && exec("DROP TABLE temp.rebased;", {});
+    };
+
+    bool ok = rebaseTable(QByteArrayLiteral("metadata"), QByteArrayLiteral("phash = path_hash(path), pathlen = length(CAST(path AS BLOB))"));
+    for (const auto &table : {"downloadinfo", "uploadinfo", "blacklist", "selectivesync", "flags", "conflicts", "hydrations", "accesstimes", "hydratedranges"}) {
+        ok = ok && rebaseTable(table, {});
+    }
+    // both belong to the old root of the folder
+    ok = ok && exec(QByteArrayLiteral("DELETE FROM synctoken;"), {}) && exec(QByteArrayLiteral("DELETE FROM changejournal;"), {});
+
+    if (!ok) {
+        _db.rollback();
+        return false;
+    }
+    if (!_db.commit()) {
+        qCWarning(lcDb) << "ERROR committing to the database:" << _db.error();
+        return false;
+    }
+    _metadataTableIsEmpty = (getFileRecordCount() == 0);
+    _selectiveSyncListCache.clear();
+    qCInfo(lcDb) << "Rebased the journal from" << from << "to" << to;
+    return true;
+}
+
+bool SyncJournalDb::getFileRecordsSample(const QByteArray &path, int count, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker lock(&_mutex);
+    if (!checkConnect())
+        return false;
+
+    // ORDER BY random() with a LIMIT keeps only the chosen rows while scanning, it never sorts the whole table
+    static_assert(ItemTypeFile == 0, "");
+    SqlQuery query(
+        getFileRecordQueryC + QByteArrayLiteral("WHERE type == 0 AND (?1 == '' OR " IS_PREFIX_PATH_OF("?1", "path") ") ORDER BY random() LIMIT ?2;"), _db);
+    query.bindValue(1, path);
+    query.bindValue(2, count);
+    if (!query.exec())
+        return false;
+
+    while (true) {
+        auto next = query.next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, query);
+        rowCallback(rec);
+    }
+    return true;
+}
+
 void SyncJournalDb::markVirtualFileForDownloadRecursively(const QByteArray &path)
 {
     QMutexLocker lock(&_mutex);
     if (!checkConnect())
         return;
 
+    _metadataSnapshot.reset();
     static_assert(ItemTypeVirtualFile == 4 && ItemTypeVirtualFileDownload == 5, "");
     SqlQuery query("UPDATE metadata SET type=5 WHERE "
                    "(" IS_PREFIX_PATH_OF("?1", "path") " OR ?1 == '') "
@@ -2073,53 +3308,63 @@ void SyncJournalDb::markVirtualFileForDownloadRecursively(const QByteArray &path
     query.exec();
 }
 
+const std::map<QByteArray, PinState> *SyncJournalDb::pinStates()
+{
+    if (_pinStates) {
+        return &*_pinStates;
+    }
+    if (!checkConnect())
+        return nullptr;
+
+    SqlQuery query("SELECT path, pinState FROM flags WHERE pinState is not null AND pinState != 0;", _db);
+    if (!query.exec())
+        return nullptr;
+
+    std::map<QByteArray, PinState> states;
+    while (true) {
+        auto next = query.next();
+        if (!next.ok)
+            return nullptr;
+        if (!next.hasData)
+            break;
+        states.emplace(query.baValue(0), static_cast<PinState>(query.intValue(1)));
+    }
+    _pinStates = std::move(states);
+    return &*_pinStates;
+}
+
 Optional<PinState> SyncJournalDb::PinStateInterface::rawForPath(const QByteArray &path)
 {
     QMutexLocker lock(&_db->_mutex);
-    if (!_db->checkConnect())
+    const auto *states = _db->pinStates();
+    if (!states)
         return {};
 
-    const auto query = _db->_queryManager.get(PreparedSqlQueryManager::GetRawPinStateQuery, QByteArrayLiteral("SELECT pinState FROM flags WHERE path == ?1;"), _db->_db);
-    OC_ASSERT(query);
-    query->bindValue(1, path);
-    query->exec();
-
-    auto next = query->next();
-    if (!next.ok)
-        return {};
     // no-entry means Inherited
-    if (!next.hasData)
-        return PinState::Inherited;
-
-    return static_cast<PinState>(query->intValue(0));
+    const auto it = states->find(path);
+    return it == states->cend() ? PinState::Inherited : it->second;
 }
 
 Optional<PinState> SyncJournalDb::PinStateInterface::effectiveForPath(const QByteArray &path)
 {
     QMutexLocker lock(&_db->_mutex);
-    if (!_db->checkConnect())
+    const auto *states = _db->pinStates();
+    if (!states)
         return {};
 
-    const auto query = _db->_queryManager.get(PreparedSqlQueryManager::GetEffectivePinStateQuery, QByteArrayLiteral("SELECT pinState FROM flags WHERE"
-                                                                                                                    // explicitly allow "" to represent the root path
-                                                                                                                    // (it'd be great if paths started with a / and "/" could be the root)
-                                                                                                                    " (" IS_PREFIX_PATH_OR_EQUAL("path", "?1") " OR path == '')"
-                                                                                                                                                               " AND pinState is not null AND pinState != 0"
-                                                                                                                                                               " ORDER BY length(path) DESC LIMIT 1;"),
-        _db->_db);
-    OC_ASSERT(query);
-    query->bindValue(1, path);
-    query->exec();
-
-    auto next = query->next();
-    if (!next.ok)
-        return {};
-    // If the root path has no setting, assume Unspecified
-    if (!next.hasData) {
-        return PinState::Unspecified;
+    // the closest entry of the path itself or of a parent,
+    // "" represents the root path
+    QByteArray parent = path;
+    while (true) {
+        const auto it = states->find(parent);
+        if (it != states->cend())
+            return it->second;
+        if (parent.isEmpty())
+            break;
+        parent.truncate(std::max<qsizetype>(parent.lastIndexOf('/'), 0));
     }
-
-    return static_cast<PinState>(query->intValue(0));
+    // If the root path has no setting, assume Unspecified
+    return PinState::Unspecified;
 }
 
 Optional<PinState> SyncJournalDb::PinStateInterface::effectiveForPathRecursive(const QByteArray &path)
@@ -2131,27 +3376,18 @@ Optional<PinState> SyncJournalDb::PinStateInterface::effectiveForPathRecursive(c
         return {};
 
     QMutexLocker lock(&_db->_mutex);
-    if (!_db->checkConnect())
+    const auto *states = _db->pinStates();
+    if (!states)
         return {};
 
-    // Find all the non-inherited pin states below the item
-    const auto query = _db->_queryManager.get(PreparedSqlQueryManager::GetSubPinsQuery, QByteArrayLiteral("SELECT DISTINCT pinState FROM flags WHERE"
-                                                                                                          " (" IS_PREFIX_PATH_OF("?1", "path") " OR ?1 == '')"
-                                                                                                                                               " AND pinState is not null and pinState != 0;"),
-        _db->_db);
-    OC_ASSERT(query);
-    query->bindValue(1, path);
-    query->exec();
-
-    // Check if they are all identical
-    while (true) {
-        auto next = query->next();
-        if (!next.ok)
-            return {};
-        if (!next.hasData)
-            break;
-        const auto subPin = static_cast<PinState>(query->intValue(0));
-        if (subPin != *basePin)
+    // Check if all the non-inherited pin states below the item are identical,
+    // they are the entries between path + '/' and path + '0' (see IS_PREFIX_PATH_OF)
+    auto it = path.isEmpty() ? states->cbegin() : states->lower_bound(path + '/');
+    const auto end = path.isEmpty() ? states->cend() : states->lower_bound(path + '0');
+    for (; it != end; ++it) {
+        if (it->first.isEmpty())
+            continue;
+        if (it->second != *basePin)
             return PinState::Inherited;
     }
 
@@ -2175,7 +3411,18 @@ void SyncJournalDb::PinStateInterface::setForPath(const QByteArray &path, PinSta
     OC_ASSERT(query);
     query->bindValue(1, path);
     query->bindValue(2, state);
-    query->exec();
+    if (!query->exec()) {
+        _db->_pinStates.reset();
+        return;
+    }
+
+    if (_db->_pinStates) {
+        if (state == PinState::Inherited) {
+            _db->_pinStates->erase(path);
+        } else {
+            (*_db->_pinStates)[path] = state;
+        }
+    }
 }
 
 void SyncJournalDb::PinStateInterface::wipeForPathAndBelow(const QByteArray &path)
@@ -2190,7 +3437,19 @@ void SyncJournalDb::PinStateInterface::wipeForPathAndBelow(const QByteArray &pat
         _db->_db);
     OC_ASSERT(query);
     query->bindValue(1, path);
-    query->exec();
+    if (!query->exec()) {
+        _db->_pinStates.reset();
+        return;
+    }
+
+    if (_db->_pinStates) {
+        if (path.isEmpty()) {
+            _db->_pinStates->clear();
+        } else {
+            _db->_pinStates->erase(path);
+            _db->_pinStates->erase(_db->_pinStates->lower_bound(path + '/'), _db->_pinStates->lower_bound(path + '0'));
+        }
+    }
 }
 
 Optional<QVector<QPair<QByteArray, PinState>>>
@@ -2223,9 +3482,113 @@ SyncJournalDb::PinStateInterface SyncJournalDb::internalPinStates()
 void SyncJournalDb::commit(const QString &context, bool startTrans)
 {
     QMutexLocker lock(&_mutex);
+    if (_commitMode == CommitMode::Batched && startTrans && _transaction == 1 && ++_deferredCommits < MaximumDeferredCommits) {
+        qCDebug(lcDb) << "Deferring transaction commit" << context;
+        if (!_deferredCommitTimer.isActive()) {
+            _deferredCommitTimer.start();
+        }
+        return;
+    }
     commitInternal(context, startTrans);
 }
 
+void SyncJournalDb::setCommitMode(CommitMode mode)
+{
+    QMutexLocker lock(&_mutex);
+    if (_commitMode == mode) {
+        return;
+    }
+    qCInfo(lcDb) << "Switching commit mode to" << mode;
+    _commitMode = mode;
+    if (mode == CommitMode::Immediate && (_deferredCommits > 0 || pendingWriteCount() > 0)) {
+        commitInternal(QStringLiteral("leaving batched commit mode"), true);
+    }
+}
+
+SyncJournalDb::CommitMode SyncJournalDb::commitMode() const
+{
+    QMutexLocker lock(&_mutex);
+    return _commitMode;
+}
+
+qsizetype SyncJournalDb::pendingWriteCount() const
+{
+    QMutexLocker lock(&_mutex);
+    return static_cast<qsizetype>(_pendingFileRecords.size() + _pendingDownloadInfos.size() + _pendingUploadInfos.size());
+}
+
+template <typename Key, typename Row>
+bool SyncJournalDb::enqueueWrite(std::map<Key, std::optional<Row>> &queue, const Key &key, std::optional<Row> &&row)
+{
+    if (_commitMode != CommitMode::Batched || _closed) {
+        return false;
+    }
+    queue.insert_or_assign(key, std::move(row));
+    if (pendingWriteCount() >= MaximumPendingWrites) {
+        flushPendingWrites();
+    } else if (!_deferredCommitTimer.isActive()) {
+        _deferredCommitTimer.start();
+    }
+    return true;
+}
+
+bool SyncJournalDb::flushPendingWrites()
+{
+    if (_flushingPendingWrites || pendingWriteCount() == 0) {
+        return true;
+    }
+    const QScopedValueRollback<bool> flushing(_flushingPendingWrites, true);
+    if (!checkConnect()) {
+        return false;
+    }
+    qCDebug(lcDb) << "Writing" << pendingWriteCount() << "queued changes";
+
+    // like after a crash, changes that could not be written are discovered again by the next sync
+    const auto fileRecords = std::exchange(_pendingFileRecords, {});
+    const auto downloadInfos = std::exchange(_pendingDownloadInfos, {});
+    const auto uploadInfos = std::exchange(_pendingUploadInfos, {});
+
+    const auto bindPath = [](SqlQuery &query, int pos, const QString &path) { query.bindValue(pos, path); };
+    const bool ok = writeRows(
+                        _db, fileRecords,
+                        QByteArrayLiteral("INSERT OR REPLACE INTO metadata "
+                                          "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePermId, filesize, ignoredChildrenRemote, contentChecksum, contentChecksumTypeId, hasDirtyPlaceholder)"),
+                        17, [this](SqlQuery &query, int pos, const QByteArray &, const SyncJournalFileRecord &record) { bindFileRecord(query, pos, record); },
+                        QByteArrayLiteral("DELETE FROM metadata WHERE phash IN"), [](SqlQuery &query, int pos, const QByteArray &path) { query.bindValue(pos, getPHash(path)); })
+        && writeRows(
+            _db, downloadInfos, QByteArrayLiteral("INSERT OR REPLACE INTO downloadinfo (path, tmpfile, etag, errorcount)"), 4,
+            [](SqlQuery &query, int pos, const QString &path, const DownloadInfo &info) {
+                query.bindValue(pos, path);
+                query.bindValue(pos + 1, info._tmpfile);
+                query.bindValue(pos + 2, info._etag);
+                query.bindValue(pos + 3, info._errorCount);
+            },
+            QByteArrayLiteral("DELETE FROM downloadinfo WHERE path IN"), bindPath)
+        && writeRows(
+            _db, uploadInfos, QByteArrayLiteral("INSERT OR REPLACE INTO uploadinfo (path, chunk, transferid, errorcount, size, modtime, contentChecksum, url)"), 8,
+            [](SqlQuery &query, int pos, const QString &path, const UploadInfo &info) {
+                query.bindValue(pos, path);
+                query.bindValue(pos + 1, info._chunk);
+                query.bindValue(pos + 2, info._transferid);
+                query.bindValue(pos + 3, info._errorCount);
+                query.bindValue(pos + 4, info._size);
+                query.bindValue(pos + 5, info._modtime);
+                query.bindValue(pos + 6, info._contentChecksum);
+                query.bindValue(pos + 7, info._url.toEncoded());
+            },
+            QByteArrayLiteral("DELETE FROM uploadinfo WHERE path IN"), bindPath);
+    if (!ok) {
+        qCWarning(lcDb) << "Failed to write the queued changes";
+    }
+    return ok;
+}
+
+SyncJournalDb::CommitStatistics SyncJournalDb::commitStatistics() const
+{
+    QMutexLocker lock(&_mutex);
+    return _commitStatistics;
+}
+
 void SyncJournalDb::commitIfNeededAndStartNewTransaction(const QString &context)
 {
     QMutexLocker lock(&_mutex);
@@ -2251,6 +3614,7 @@ bool SyncJournalDb::isOpen() const
 void SyncJournalDb::commitInternal(const QString &context, bool startTrans)
 {
     qCDebug(lcDb) << "Transaction commit" << context << (startTrans ? "and starting new transaction" : "");
+    flushPendingWrites();
     commitTransaction();
 
     if (startTrans) {
@@ -2260,6 +3624,7 @@ void SyncJournalDb::commitInternal(const QString &context, bool startTrans)
 
 SyncJournalDb::~SyncJournalDb()
 {
+    _ioThreadPool.waitForDone();
     close();
 }
 
@@ -2267,6 +3632,7 @@ const QVector<SyncJournalFileRecord> SyncJournalDb::getFileRecordsWithDirtyPlace
 {
     QMutexLocker locker(&_mutex);
 
+    const_cast<SyncJournalDb *>(this)->flushPendingWrites();
     if (OC_ENSURE(isOpen())) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileReocrdsWithDirtyPlaceholdersQuery, getFileRecordQueryC + QByteArrayLiteral("WHERE hasDirtyPlaceholder=TRUE"), const_cast<SyncJournalDb *>(this)->_db);
         if (!OC_ENSURE(query)) {
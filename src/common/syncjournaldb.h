@@ -23,7 +23,15 @@
 #include <qmutex.h>
 #include <QDateTime>
 #include <QHash>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentRun>
+#include <chrono>
 #include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <tuple>
 
 #include "common/checksumalgorithms.h"
 #include "common/ownsql.h"
@@ -31,6 +39,7 @@
 #include "common/preparedsqlquerymanager.h"
 #include "common/result.h"
 #include "common/syncjournalfilerecord.h"
+#include "common/syncjournalsnapshot.h"
 #include "common/utility.h"
 
 namespace OCC {
@@ -60,15 +69,45 @@ public:
     bool getFileRecord(const QByteArray &filename, SyncJournalFileRecord *rec);
     bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
     bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    // The records of files with the content checksum \a checksumHeader and the size \a size
+    bool getFileRecordsByContentChecksum(
+        const QByteArray &checksumHeader, qint64 size, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    // The records are reported in path order, a directory before its contents
     bool getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     bool listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
+    /**
+     * Lists at most \a limit direct children of \a path, in the byte order of their names.
+     * Only the children after the record with the path \a after are listed, pass the path of the
+     * last record of a page to get the next one. A page of less than \a limit records is the last one.
+     */
+    bool listFilesInPath(const QByteArray &path, const QByteArray &after, int limit, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /**
+     * The number of direct children of \a path, or -1 on error.
+     * The hash collisions of listFilesInPath() are not filtered, the count is an estimate.
+     */
+    int countFilesInPath(const QByteArray &path);
     const QVector<SyncJournalFileRecord> getFileRecordsWithDirtyPlaceholders() const;
     Result<void, QString> setFileRecord(const SyncJournalFileRecord &record);
 
-    bool deleteFileRecord(const QString &filename, bool recursively = false);
-    bool updateFileRecordChecksum(const QString &filename,
-        const QByteArray &contentChecksum,
-        CheckSums::Algorithm contentChecksumType);
+    bool deleteFileRecord(const QString &filename, bool recursively = false) { return deleteFileRecord(filename.toUtf8(), recursively); }
+    bool deleteFileRecord(const QByteArray &filename, bool recursively = false);
+
+    /**
+     * Moves the records below \a from to below \a to in a single transaction, all other records are dropped
+     *
+     * Used when the root of a folder changes to one of its subdirectories (from "sub" to "")
+     * or to its parent (from "" to "sub"): the records keep their etags and file ids, so the
+     * next sync doesn't transfer the files again.
+     */
+    bool rebasePaths(const QByteArray &from, const QByteArray &to);
+
+    /// Up to \a count randomly chosen records of files below \a path, to cheaply check whether the journal matches a tree
+    bool getFileRecordsSample(const QByteArray &path, int count, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    bool updateFileRecordChecksum(const QString &filename, const QByteArray &contentChecksum, CheckSums::Algorithm contentChecksumType)
+    {
+        return updateFileRecordChecksum(filename.toUtf8(), contentChecksum, contentChecksumType);
+    }
+    bool updateFileRecordChecksum(const QByteArray &filename, const QByteArray &contentChecksum, CheckSums::Algorithm contentChecksumType);
 
     /// Return value for hasHydratedOrDehydratedFiles()
     struct HasHydratedDehydrated
@@ -81,8 +120,61 @@ public:
     Optional<HasHydratedDehydrated> hasHydratedOrDehydratedFiles(const QByteArray &filename);
 
     bool exists();
+
+    /** Whether the journal has no file records, like before the first sync of a folder */
+    bool isMetadataTableEmpty();
+
+    /** Incorporate the changes of the -wal file into the database
+     *
+     * This might take a while for large journals, call it while no sync is running.
+     */
     void walCheckpoint();
 
+    /** Keep a long-lived journal small and its query plans current
+     *
+     * Returns the pages freed by deletions to the file system, refreshes the
+     * statistics of the query planner and truncates the -wal file. Stops freeing
+     * pages once \a budget is used up, the rest is freed by the next call.
+     * Call it while no sync is running.
+     */
+    void runMaintenance(std::chrono::milliseconds budget);
+
+    /**
+     * SQLite tuning for large journals
+     *
+     * A value of 0 keeps the SQLite default.
+     */
+    struct PerformanceProfile
+    {
+        /// PRAGMA mmap_size, in bytes
+        qint64 mmapSize = 0;
+        /// PRAGMA cache_size, in KiB
+        qint64 cacheSize = 0;
+        /// PRAGMA page_size, in bytes, only applies to new databases
+        int pageSize = 0;
+        /// PRAGMA wal_autocheckpoint, in pages
+        int walAutoCheckpoint = 0;
+
+        bool operator==(const PerformanceProfile &other) const
+        {
+            return mmapSize == other.mmapSize && cacheSize == other.cacheSize && pageSize == other.pageSize && walAutoCheckpoint == other.walAutoCheckpoint;
+        }
+    };
+
+    /** The profile is applied the next time the database is opened */
+    void setPerformanceProfile(const PerformanceProfile &profile);
+    PerformanceProfile performanceProfile() const;
+
+    /** Load the whole metadata table into memory
+     *
+     * Until the next write to the metadata table or close(), getFileRecord()
+     * and listFilesInPath() are answered from the snapshot instead of SQLite.
+     * Used by discovery, which reads every directory of the journal.
+     */
+    bool loadMetadataSnapshot();
+    void dropMetadataSnapshot();
+    bool hasMetadataSnapshot() const;
+
     QString databaseFilePath() const;
 
     static qint64 getPHash(const QByteArray &);
@@ -134,18 +226,27 @@ public:
 
     DownloadInfo getDownloadInfo(const QString &file);
     void setDownloadInfo(const QString &file, const DownloadInfo &i);
-    QVector<DownloadInfo> getAndDeleteStaleDownloadInfos(const QSet<QString> &keep);
+    /**
+     * Deletes the download infos of all paths but the ones in \a keep, returns the deleted ones
+     *
+     * The stale rows are found by the database, \a keep is only written to a temporary table.
+     */
+    QVector<DownloadInfo> getAndDeleteStaleDownloadInfos(const QStringList &keep);
+    /// All download infos by their path, to find the resumable downloads of a sync
+    QHash<QString, DownloadInfo> getDownloadInfos();
     int downloadInfoCount();
 
     UploadInfo getUploadInfo(const QString &file);
     std::vector<UploadInfo> getUploadInfos();
 
     void setUploadInfo(const QString &file, const UploadInfo &i);
-    // Return the list of transfer ids that were removed.
-    QVector<uint> deleteStaleUploadInfos(const QSet<QString> &keep);
+    // Return the list of transfer ids that were removed, see getAndDeleteStaleDownloadInfos().
+    QVector<uint> deleteStaleUploadInfos(const QStringList &keep);
 
     SyncJournalErrorBlacklistRecord errorBlacklistEntry(const QString &);
-    bool deleteStaleErrorBlacklistEntries(const QSet<QString> &keep);
+    /// All entries of the error blacklist, read with a single query
+    QVector<SyncJournalErrorBlacklistRecord> errorBlacklistEntries();
+    bool deleteStaleErrorBlacklistEntries(const QStringList &keep);
 
     /// Delete flags table entries that have no metadata correspondent
     void deleteStaleFlagsEntries();
@@ -168,7 +269,7 @@ public:
     };
     Q_ENUM(SelectiveSyncListType)
 
-    /* return the specified list from the database */
+    /* return the specified list from the database, the list is kept in memory until it is changed */
     QSet<QString> getSelectiveSyncList(SelectiveSyncListType type, bool *ok);
     /* Write the selective sync list (remove all other entries of that list */
     void setSelectiveSyncList(SelectiveSyncListType type, const QSet<QString> &list);
@@ -206,10 +307,66 @@ public:
 
     /* Because sqlite transactions are really slow, we encapsulate everything in big transactions
      * Commit will actually commit the transaction and create a new one.
+     *
+     * In CommitMode::Batched commit() requests that start a new transaction
+     * are coalesced, see setCommitMode().
      */
     void commit(const QString &context, bool startTrans = true);
     void commitIfNeededAndStartNewTransaction(const QString &context);
 
+    enum class CommitMode {
+        /// Every commit() is written to disk right away
+        Immediate,
+        /** commit() requests are collected and written with a single commit once
+         * enough of them accumulated or the oldest one waited for too long.
+         *
+         * File records, their deletion and the upload and download infos are
+         * queued in memory and written together with multi-row statements, see
+         * flushPendingWrites(). Any other access of the journal writes them first.
+         *
+         * After a crash the journal might miss the latest changes, which
+         * causes them to be discovered again by the next sync.
+         */
+        Batched
+    };
+    Q_ENUM(CommitMode)
+
+    /**
+     * Run \a request on the journal I/O thread and pass its result to \a callback
+     *
+     * Requests are handled one after the other in the order they were made,
+     * so slow disk access does not block the thread of \a context.
+     * \a callback is invoked in the thread of \a context and dropped if
+     * \a context is destroyed before the request finished.
+     *
+     * \a request is called with this journal and may use all of its functions.
+     *
+     * Only the long operations that nobody waits for go through here, the
+     * discovery, the propagator and the file status lookups still use the
+     * synchronous functions and wait for the journal mutex.
+     */
+    template <typename Request, typename Callback>
+    void runAsync(QObject *context, Request &&request, Callback &&callback)
+    {
+        std::ignore = QtConcurrent::run(&_ioThreadPool, [this, request = std::forward<Request>(request)]() mutable { return request(this); })
+                          .then(context, std::forward<Callback>(callback));
+    }
+
+    /** Switching back to CommitMode::Immediate commits the pending changes */
+    void setCommitMode(CommitMode mode);
+    CommitMode commitMode() const;
+
+    /** The number of rows queued in CommitMode::Batched that were not written yet */
+    qsizetype pendingWriteCount() const;
+
+    struct CommitStatistics
+    {
+        quint64 commits = 0;
+        std::chrono::nanoseconds duration = {};
+    };
+    /** The number of transactions committed since the journal was created and the time it took */
+    CommitStatistics commitStatistics() const;
+
     /** Open the db if it isn't already.
      *
      * This usually creates some temporary files next to the db file, like
@@ -242,6 +399,20 @@ public:
     void setDataFingerprint(const QByteArray &dataFingerprint);
     QByteArray dataFingerprint();
 
+    /**
+     * The position in the change journal of the file system up to which all
+     * local changes were synced, see FolderWatcher::journalPosition()
+     */
+    void setChangeJournalPosition(const QByteArray &position);
+    QByteArray changeJournalPosition();
+
+    /**
+     * The sync token of the remote state that was synced completely, used to
+     * list only the changes since then, see SyncCollectionJob
+     */
+    void setSyncToken(const QByteArray &token);
+    QByteArray syncToken();
+
 
     // Conflict record functions
 
@@ -265,6 +436,88 @@ public:
      */
     QByteArray conflictFileBaseName(const QByteArray &conflictName);
 
+    // Hydration history, used to predict the files a user will open next
+
+    /// Record that \a path was hydrated on request of the user at \a time, in ms since epoch
+    void setHydrationTime(const QByteArray &path, qint64 time);
+
+    /// The time \a path was last hydrated on request of the user, 0 if never
+    qint64 hydrationTime(const QByteArray &path);
+
+    /// The paths hydrated within \a window ms of \a time, the closest first
+    QByteArrayList hydratedAround(qint64 time, qint64 window, int limit);
+
+    /// Forget hydrations older than \a time
+    void deleteHydrationsBefore(qint64 time);
+
+    // Access times of the hydrated files, used to free space by dehydrating the least recently used ones
+
+    /// Record that the hydrated file \a path was used at \a time, in ms since epoch
+    void setAccessTime(const QByteArray &path, qint64 time);
+
+    struct HydratedFile
+    {
+        QByteArray path;
+        qint64 size = 0;
+        /// in ms since epoch, the modification time for files without an access time
+        qint64 accessTime = 0;
+    };
+
+    /// The hydrated files, the least recently used first
+    QVector<HydratedFile> leastRecentlyUsedFiles(int limit, int offset);
+
+    /// The total size of the hydrated files
+    qint64 hydratedFilesSize();
+
+    /// Forget the access times of files that are no longer in the db
+    void deleteStaleAccessTimes();
+
+    // Content checksums of local files, to avoid reading unchanged files again
+
+    /// The cached \a checksumType checksum of the file with \a inode, empty unless \a modtime and \a size match
+    QByteArray cachedChecksum(quint64 inode, qint64 modtime, qint64 size, CheckSums::Algorithm checksumType);
+
+    /// Remember the \a checksumType checksum of the file with \a inode, \a modtime and \a size
+    void setCachedChecksum(quint64 inode, qint64 modtime, qint64 size, CheckSums::Algorithm checksumType, const QByteArray &checksum);
+
+    /// Forget the cached checksums that don't match a file record, unless their inode is in \a keep
+    void deleteStaleCachedChecksums(const QSet<quint64> &keep);
+
+    // Fingerprints of local folders, see LocalDiscoveryStyle::FilesystemUnlessUnchanged
+
+    /// The state of a local folder when it was listed, it changes when entries are added, removed or renamed
+    struct LocalFolderFingerprint
+    {
+        qint64 modtime = 0;
+        quint64 inode = 0;
+
+        friend bool operator==(const LocalFolderFingerprint &a, const LocalFolderFingerprint &b) { return a.modtime == b.modtime && a.inode == b.inode; }
+    };
+
+    /// The fingerprints of the local folders, keyed by their path
+    QHash<QString, LocalFolderFingerprint> localFolderFingerprints();
+
+    /// Store \a fingerprints and forget the ones of folders that are no longer in the db
+    void setLocalFolderFingerprints(const QHash<QString, LocalFolderFingerprint> &fingerprints);
+
+    // Partially hydrated files, see PartialHydration
+
+    /// A range of bytes of a file, end is exclusive
+    struct ByteRange
+    {
+        qint64 start = 0;
+        qint64 end = 0;
+
+        qint64 size() const { return end - start; }
+        bool operator==(const ByteRange &other) const { return start == other.start && end == other.end; }
+    };
+
+    /// The hydrated ranges of \a path, sorted and not overlapping, empty if they belong to another \a etag
+    QVector<ByteRange> hydratedRanges(const QByteArray &path, const QByteArray &etag);
+
+    /// Replaces the hydrated ranges of \a path, an empty list removes them
+    void setHydratedRanges(const QByteArray &path, const QByteArray &etag, const QVector<ByteRange> &ranges);
+
     /**
      * Delete any file entry. This will force the next sync to re-sync everything as if it was new,
      * restoring everyfile on every remote. If a file is there both on the client and server side,
@@ -375,17 +628,37 @@ public:
      */
     int autotestFailCounter = -1;
 
+Q_SIGNALS:
+    /**
+     * Emitted by open() while it migrates a journal written by another client version,
+     * \a step of \a steps are done.
+     *
+     * The migration can take a while for large journals, it is emitted in the thread
+     * that opens the journal, usually the one of runAsync().
+     */
+    void upgradeProgress(int step, int steps);
+
 private:
     int getFileRecordCount();
     bool updateDatabaseStructure();
+    // recomputes phash when the hash function changed, see PathHash
+    bool updatePathHashes(bool reportProgress);
     bool updateMetadataTableStructure();
     bool updateErrorBlacklistTableStructure();
     bool sqlFail(const QString &log, const SqlQuery &query);
     void commitInternal(const QString &context, bool startTrans = true);
+    /** Queues a change in CommitMode::Batched, returns false if it has to be written right away */
+    template <typename Key, typename Row>
+    bool enqueueWrite(std::map<Key, std::optional<Row>> &queue, const Key &key, std::optional<Row> &&row);
+    /** Writes the queued changes, called by checkConnect() before any other access */
+    bool flushPendingWrites();
+    void bindFileRecord(SqlQuery &query, int firstPos, const SyncJournalFileRecord &record);
     void startTransaction();
     void commitTransaction();
     QVector<QByteArray> tableColumns(const QByteArray &table);
     bool checkConnect();
+    /** Replaces the paths of the temporary keptpaths table, that the deleteStale*() functions join with */
+    bool setKeptPaths(const QStringList &keep);
 
     bool createUploadInfo();
 
@@ -397,13 +670,56 @@ private:
     // Returns 0 on failure and for empty checksum types.
     int mapChecksumType(CheckSums::Algorithm checksumType);
 
+    // Returns the integer id of the remote permissions, they are stored once in the
+    // remotepermissions table
+    //
+    // Returns 0 on failure and for null permissions.
+    int mapRemotePermissions(const RemotePermissions &permissions);
+
+    // The cached pin states, loaded on first use. Returns nullptr on db error.
+    const std::map<QByteArray, PinState> *pinStates();
+
+    // The only connection: with locking_mode EXCLUSIVE no other connection can read the
+    // database. The sync engine and the gui readers share the thread and never wait for
+    // each other, they only wait for the jobs of runAsync(), which should release the
+    // mutex regularly.
     SqlDatabase _db;
     QString _dbFile;
     mutable QRecursiveMutex _mutex; // Public functions are protected with the mutex.
     QMap<CheckSums::Algorithm, int> _checksymTypeCache;
+    QHash<QByteArray, int> _remotePermissionsCache;
+    // the lists read by getSelectiveSyncList(), they are read for every sync
+    QHash<SelectiveSyncListType, QSet<QString>> _selectiveSyncListCache;
     int _transaction;
     bool _metadataTableIsEmpty;
 
+    // see setCommitMode()
+    CommitMode _commitMode = CommitMode::Immediate;
+    int _deferredCommits = 0;
+    QTimer _deferredCommitTimer;
+
+    // The write-behind queue of CommitMode::Batched, keyed by path.
+    // Only the latest change of a path is kept, std::nullopt deletes the row.
+    std::map<QByteArray, std::optional<SyncJournalFileRecord>> _pendingFileRecords;
+    std::map<QString, std::optional<DownloadInfo>> _pendingDownloadInfos;
+    std::map<QString, std::optional<UploadInfo>> _pendingUploadInfos;
+    bool _flushingPendingWrites = false;
+    CommitStatistics _commitStatistics;
+
+    // a single thread, see runAsync()
+    QThreadPool _ioThreadPool;
+
+    // see loadMetadataSnapshot(), reset by every write to the metadata table
+    std::unique_ptr<SyncJournalSnapshot> _metadataSnapshot;
+
+    /* The non-inherited pin states of the flags table, by path.
+     *
+     * Pin states are queried for every item of a sync and for the shell integration,
+     * but they rarely change: the whole table is kept in memory and updated along
+     * with the database. Sorted, so the states below a path are a range.
+     */
+    std::optional<std::map<QByteArray, PinState>> _pinStates;
+
     /* Storing etags to these folders, or their parent folders, is filtered out.
      *
      * When schedulePathForRemoteDiscovery() is called some etags to _invalid_ in the
@@ -425,6 +741,7 @@ private:
      * variable, for specific filesystems, or when WAL fails in a particular way.
      */
     QByteArray _journalMode;
+    PerformanceProfile _performanceProfile;
 
     mutable PreparedSqlQueryManager _queryManager;
 
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "common/syncjournalsnapshot.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace OCC {
+
+bool SyncJournalSnapshot::addString(const QByteArray &value, String *string)
+{
+    if (static_cast<quint64>(_pool.size()) + value.size() > std::numeric_limits<quint32>::max()) {
+        return false;
+    }
+    string->offset = static_cast<quint32>(_pool.size());
+    string->size = static_cast<quint32>(value.size());
+    _pool.append(value);
+    return true;
+}
+
+QByteArray SyncJournalSnapshot::string(const String &string) const
+{
+    return QByteArray(_pool.constData() + string.offset, string.size);
+}
+
+QByteArrayView SyncJournalSnapshot::view(const String &string) const
+{
+    return QByteArrayView(_pool.constData() + string.offset, string.size);
+}
+
+QByteArrayView SyncJournalSnapshot::parent(const Entry &entry) const
+{
+    return view(entry.path).first(entry.parentSize);
+}
+
+QByteArrayView SyncJournalSnapshot::name(const Entry &entry) const
+{
+    return entry.parentSize == 0 ? view(entry.path) : view(entry.path).sliced(entry.parentSize + 1);
+}
+
+bool SyncJournalSnapshot::append(const SyncJournalFileRecord &record)
+{
+    if (_entries.size() >= std::numeric_limits<quint32>::max()) {
+        return false;
+    }
+    Entry entry;
+    if (!addString(record._path, &entry.path) || !addString(record._etag, &entry.etag) || !addString(record._fileId, &entry.fileId)
+        || !addString(record._checksumHeader, &entry.checksumHeader)) {
+        return false;
+    }
+    const auto slash = record._path.lastIndexOf('/');
+    entry.parentSize = slash < 0 ? 0 : static_cast<quint32>(slash);
+    entry.inode = record._inode;
+    entry.modtime = record._modtime;
+    entry.fileSize = record._fileSize;
+    entry.remotePerm = record._remotePerm;
+    entry.type = record._type;
+    entry.serverHasIgnoredFiles = record._serverHasIgnoredFiles;
+    _entries.push_back(entry);
+    return true;
+}
+
+void SyncJournalSnapshot::finalize()
+{
+    std::sort(_entries.begin(), _entries.end(), [this](const Entry &a, const Entry &b) {
+        const int cmp = parent(a).compare(parent(b));
+        return cmp != 0 ? cmp < 0 : name(a) < name(b);
+    });
+    _entries.shrink_to_fit();
+    _pool.squeeze();
+
+    // the stable sorts keep the path order for records with the same key
+    _byInode.clear();
+    _byFileId.clear();
+    for (quint32 i = 0; i < _entries.size(); ++i) {
+        if (_entries[i].inode != 0) {
+            _byInode.push_back(i);
+        }
+        if (_entries[i].fileId.size != 0) {
+            _byFileId.push_back(i);
+        }
+    }
+    std::stable_sort(_byInode.begin(), _byInode.end(), [this](quint32 a, quint32 b) { return _entries[a].inode < _entries[b].inode; });
+    std::stable_sort(_byFileId.begin(), _byFileId.end(), [this](quint32 a, quint32 b) { return view(_entries[a].fileId) < view(_entries[b].fileId); });
+}
+
+void SyncJournalSnapshot::fillRecord(const Entry &entry, SyncJournalFileRecord *record) const
+{
+    record->_path = string(entry.path);
+    record->_inode = entry.inode;
+    record->_modtime = entry.modtime;
+    record->_type = entry.type;
+    record->_etag = string(entry.etag);
+    record->_fileId = string(entry.fileId);
+    record->_remotePerm = entry.remotePerm;
+    record->_fileSize = entry.fileSize;
+    record->_serverHasIgnoredFiles = entry.serverHasIgnoredFiles;
+    record->_checksumHeader = string(entry.checksumHeader);
+}
+
+bool SyncJournalSnapshot::findRecord(const QByteArray &path, SyncJournalFileRecord *record) const
+{
+    const auto slash = path.lastIndexOf('/');
+    const QByteArrayView parentPath = slash < 0 ? QByteArrayView() : QByteArrayView(path).first(slash);
+    const QByteArrayView fileName = slash < 0 ? QByteArrayView(path) : QByteArrayView(path).sliced(slash + 1);
+
+    auto it = std::lower_bound(_entries.cbegin(), _entries.cend(), 0, [&](const Entry &entry, int) {
+        const int cmp = parent(entry).compare(parentPath);
+        return cmp != 0 ? cmp < 0 : name(entry) < fileName;
+    });
+    if (it == _entries.cend() || parent(*it) != parentPath || name(*it) != fileName) {
+        return false;
+    }
+    fillRecord(*it, record);
+    return true;
+}
+
+void SyncJournalSnapshot::listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const
+{
+    const QByteArrayView parentPath(path);
+    auto it = std::lower_bound(
+        _entries.cbegin(), _entries.cend(), 0, [&](const Entry &entry, int) { return parent(entry).compare(parentPath) < 0; });
+    SyncJournalFileRecord record;
+    for (; it != _entries.cend() && parent(*it) == parentPath; ++it) {
+        fillRecord(*it, &record);
+        rowCallback(record);
+    }
+}
+
+void SyncJournalSnapshot::listFilesInPath(
+    const QByteArray &path, const QByteArray &after, int limit, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const
+{
+    const QByteArrayView parentPath(path);
+    const auto slash = after.lastIndexOf('/');
+    const QByteArrayView afterName = slash < 0 ? QByteArrayView(after) : QByteArrayView(after).sliced(slash + 1);
+    auto it = std::upper_bound(_entries.cbegin(), _entries.cend(), 0, [&](int, const Entry &entry) {
+        const int cmp = parentPath.compare(parent(entry));
+        return cmp != 0 ? cmp < 0 : afterName < name(entry);
+    });
+    SyncJournalFileRecord record;
+    for (; limit > 0 && it != _entries.cend() && parent(*it) == parentPath; ++it, --limit) {
+        fillRecord(*it, &record);
+        rowCallback(record);
+    }
+}
+
+bool SyncJournalSnapshot::findRecordByInode(quint64 inode, SyncJournalFileRecord *record) const
+{
+    auto it = std::lower_bound(_byInode.cbegin(), _byInode.cend(), inode, [this](quint32 index, quint64 value) { return _entries[index].inode < value; });
+    if (it == _byInode.cend() || _entries[*it].inode != inode) {
+        return false;
+    }
+    fillRecord(_entries[*it], record);
+    return true;
+}
+
+void SyncJournalSnapshot::listRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const
+{
+    const QByteArrayView id(fileId);
+    auto it = std::lower_bound(
+        _byFileId.cbegin(), _byFileId.cend(), 0, [&](quint32 index, int) { return view(_entries[index].fileId) < id; });
+    for (; it != _byFileId.cend() && view(_entries[*it].fileId) == id; ++it) {
+        SyncJournalFileRecord record;
+        fillRecord(_entries[*it], &record);
+        rowCallback(record);
+    }
+}
+
+}
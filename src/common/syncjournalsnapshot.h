@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "ocsynclib.h"
+#include "common/syncjournalfilerecord.h"
+
+#include <functional>
+#include <vector>
+
+namespace OCC {
+
+/**
+ * @brief Read only in-memory copy of the metadata table
+ * @ingroup libsync
+ *
+ * All strings are stored in one pool and the records only hold offsets into it,
+ * so a snapshot of a million files needs a few allocations instead of millions.
+ * The records are sorted by parent directory and name, so both lookups of a
+ * single path and listings of a directory are binary searches. Two index arrays
+ * sorted by inode and by file id make the lookups of the move detection binary
+ * searches as well.
+ */
+class OCSYNC_EXPORT SyncJournalSnapshot
+{
+public:
+    /** Add a record, must be followed by finalize() before any lookup */
+    bool append(const SyncJournalFileRecord &record);
+
+    /** Sort the records, called once all records were appended */
+    void finalize();
+
+    qsizetype size() const { return _entries.size(); }
+
+    /** Returns false if there is no record for \a path */
+    bool findRecord(const QByteArray &path, SyncJournalFileRecord *record) const;
+
+    /** Call \a rowCallback for every direct child of \a path, "" is the root */
+    void listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const;
+
+    /** Same as SyncJournalDb::listFilesInPath() with a page of at most \a limit children after \a after */
+    void listFilesInPath(const QByteArray &path, const QByteArray &after, int limit, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const;
+
+    /** Same as SyncJournalDb::getFileRecordByInode(), returns false if there is no record */
+    bool findRecordByInode(quint64 inode, SyncJournalFileRecord *record) const;
+
+    /** Call \a rowCallback for every record with the file id \a fileId */
+    void listRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const;
+
+private:
+    struct String
+    {
+        quint32 offset = 0;
+        quint32 size = 0;
+    };
+
+    struct Entry
+    {
+        String path;
+        // the size of the parent path in path, the name starts after the following slash
+        quint32 parentSize = 0;
+        String etag;
+        String fileId;
+        String checksumHeader;
+        quint64 inode = 0;
+        qint64 modtime = 0;
+        qint64 fileSize = 0;
+        RemotePermissions remotePerm;
+        ItemType type = ItemTypeSkip;
+        bool serverHasIgnoredFiles = false;
+    };
+
+    bool addString(const QByteArray &value, String *string);
+    QByteArray string(const String &string) const;
+    QByteArrayView view(const String &string) const;
+    QByteArrayView parent(const Entry &entry) const;
+    QByteArrayView name(const Entry &entry) const;
+    void fillRecord(const Entry &entry, SyncJournalFileRecord *record) const;
+
+    QByteArray _pool;
+    std::vector<Entry> _entries;
+    // indexes into _entries, only of the entries with an inode or a file id
+    std::vector<quint32> _byInode;
+    std::vector<quint32> _byFileId;
+};
+
+}
@@ -175,6 +175,14 @@ public:
      */
     virtual bool socketApiPinStateActionsShown() const = 0;
 
+    /** Whether the plugin hydrates the parts of a file that are read
+     *
+     * Such plugins serve the reads of applications with a PartialHydration, which
+     * downloads the missing blocks with range requests and keeps track of the
+     * present ones in the journal. Other plugins always hydrate whole files.
+     */
+    virtual bool supportsPartialHydration() const { return false; }
+
     /// Create a new dehydrated placeholder. Called from PropagateDownload.
     [[nodiscard]] virtual Result<void, QString> createPlaceholder(const SyncFileItem &item) = 0;
 
@@ -31,8 +31,12 @@
 
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 #include <QString>
 
+#include <algorithm>
+
 namespace {
 
 // See http://support.microsoft.com/kb/74496 and
@@ -224,6 +228,79 @@ static CSYNC_EXCLUDE_TYPE _csync_excluded_common(QStringView path, bool excludeC
 
 using namespace OCC;
 
+bool ExcludedFiles::BnameMatcher::add(const QString &pattern, CSYNC_EXCLUDE_TYPE type)
+{
+    auto isSpecial = [](QChar c) {
+        return c == QLatin1Char('*') || c == QLatin1Char('?') || c == QLatin1Char('[') || c == QLatin1Char('\\');
+    };
+    const auto special = std::count_if(pattern.cbegin(), pattern.cend(), isSpecial);
+    if (special == 0) {
+        insert(_literals, pattern, type);
+    } else if (special == 1 && pattern.endsWith(QLatin1Char('*'))) {
+        const QString prefix = pattern.chopped(1);
+        insert(_prefixes, prefix, type);
+        _prefixLengths.insert(prefix.size());
+    } else if (special == 1 && pattern.startsWith(QLatin1Char('*'))) {
+        const QString suffix = pattern.mid(1);
+        insert(_suffixes, suffix, type);
+        _suffixLengths.insert(suffix.size());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void ExcludedFiles::BnameMatcher::clear(Qt::CaseSensitivity cs)
+{
+    _literals = Table(Less{cs});
+    _prefixes = Table(Less{cs});
+    _suffixes = Table(Less{cs});
+    _prefixLengths.clear();
+    _suffixLengths.clear();
+}
+
+void ExcludedFiles::BnameMatcher::insert(Table &table, const QString &key, CSYNC_EXCLUDE_TYPE type)
+{
+    // like in the regular expressions a plain exclude wins over an exclude and remove
+    auto it = table.emplace(key, type).first;
+    if (type == CSYNC_FILE_EXCLUDE_LIST) {
+        it->second = type;
+    }
+}
+
+CSYNC_EXCLUDE_TYPE ExcludedFiles::BnameMatcher::match(QStringView bname) const
+{
+    CSYNC_EXCLUDE_TYPE result = CSYNC_NOT_EXCLUDED;
+    auto check = [&result](const Table &table, QStringView key) {
+        auto it = table.find(key);
+        if (it != table.end() && result != CSYNC_FILE_EXCLUDE_LIST) {
+            result = it->second;
+        }
+        return result == CSYNC_FILE_EXCLUDE_LIST;
+    };
+
+    if (check(_literals, bname)) {
+        return result;
+    }
+    for (const auto length : _prefixLengths) {
+        if (length > bname.size()) {
+            break;
+        }
+        if (check(_prefixes, bname.left(length))) {
+            return result;
+        }
+    }
+    for (const auto length : _suffixLengths) {
+        if (length > bname.size()) {
+            break;
+        }
+        if (check(_suffixes, bname.right(length))) {
+            return result;
+        }
+    }
+    return result;
+}
+
 ExcludedFiles::ExcludedFiles()
     : _clientVersion(OCC::Version::version())
 {
@@ -397,17 +474,24 @@ CSYNC_EXCLUDE_TYPE ExcludedFiles::traversalPatternMatch(QStringView path, ItemTy
         bnameStr = path.mid(lastSlash + 1);
     }
 
+    // The simple patterns first, a plain exclude can't be beaten by the regex
+    match = filetype == ItemTypeDirectory ? _compiled->_bnameMatcherDir.match(bnameStr) : _compiled->_bnameMatcherFile.match(bnameStr);
+    if (match == CSYNC_FILE_EXCLUDE_LIST)
+        return match;
+    if (!(filetype == ItemTypeDirectory ? _compiled->_hasBnameTraversalRegexDir : _compiled->_hasBnameTraversalRegexFile))
+        return match;
+
     QRegularExpressionMatch m;
     if (filetype == ItemTypeDirectory) {
-        m = _bnameTraversalRegexDir.match(bnameStr);
+        m = _compiled->_bnameTraversalRegexDir.match(bnameStr);
     } else {
-        m = _bnameTraversalRegexFile.match(bnameStr);
+        m = _compiled->_bnameTraversalRegexFile.match(bnameStr);
     }
     if (!m.hasMatch())
-        return CSYNC_NOT_EXCLUDED;
+        return match;
     if (m.capturedStart(QStringLiteral("exclude")) != -1) {
         return CSYNC_FILE_EXCLUDE_LIST;
-    } else if (m.capturedStart(QStringLiteral("excluderemove")) != -1) {
+    } else if (match != CSYNC_NOT_EXCLUDED || m.capturedStart(QStringLiteral("excluderemove")) != -1) {
         return CSYNC_FILE_EXCLUDE_AND_REMOVE;
     }
 
@@ -415,9 +499,9 @@ CSYNC_EXCLUDE_TYPE ExcludedFiles::traversalPatternMatch(QStringView path, ItemTy
     QStringView pathStr = path;
 
     if (filetype == ItemTypeDirectory) {
-        m = _fullTraversalRegexDir.match(pathStr);
+        m = _compiled->_fullTraversalRegexDir.match(pathStr);
     } else {
-        m = _fullTraversalRegexFile.match(pathStr);
+        m = _compiled->_fullTraversalRegexFile.match(pathStr);
     }
     if (m.hasMatch()) {
         if (m.capturedStart(QStringLiteral("exclude")) != -1) {
@@ -439,9 +523,9 @@ CSYNC_EXCLUDE_TYPE ExcludedFiles::fullPatternMatch(QStringView p, ItemType filet
 
     QRegularExpressionMatch m;
     if (filetype == ItemTypeDirectory) {
-        m = _fullRegexDir.match(p);
+        m = _compiled->_fullRegexDir.match(p);
     } else {
-        m = _fullRegexFile.match(p);
+        m = _compiled->_fullRegexFile.match(p);
     }
     if (m.hasMatch()) {
         if (m.capturedStart(QStringLiteral("exclude")) != -1) {
@@ -586,6 +670,29 @@ QString ExcludedFiles::extractBnameTrigger(const QString &exclude, bool wildcard
 
 void ExcludedFiles::prepare()
 {
+    // the compiled patterns of the instances that are still alive
+    static QMutex mutex;
+    static QHash<QString, std::weak_ptr<const CompiledPatterns>> cache;
+
+    // fsCasePreserving() can be changed by the tests
+    const QString key = QStringLiteral("%1%2\n").arg(QString::number(_wildcardsMatchSlash), QString::number(OCC::Utility::fsCasePreserving()))
+        + _allExcludes.join(QLatin1Char('\n'));
+
+    QMutexLocker lock(&mutex);
+    _compiled = cache.value(key).lock();
+    if (!_compiled) {
+        _compiled = compile(_allExcludes, _wildcardsMatchSlash);
+        for (auto it = cache.begin(); it != cache.end();) {
+            it = it.value().expired() ? cache.erase(it) : std::next(it);
+        }
+        cache.insert(key, _compiled);
+    }
+}
+
+std::shared_ptr<const ExcludedFiles::CompiledPatterns> ExcludedFiles::compile(const QStringList &excludes, bool wildcardsMatchSlash)
+{
+    auto out = std::make_shared<CompiledPatterns>();
+
     // Build regular expressions for the different cases.
     //
     // To compose the _bnameTraversalRegex, _fullTraversalRegex and _fullRegex
@@ -620,6 +727,15 @@ void ExcludedFiles::prepare()
     QString bnameTriggerFileDir;
     QString bnameTriggerDir;
 
+    const auto caseSensitivity = OCC::Utility::fsCasePreserving() ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    out->_bnameMatcherFile.clear(caseSensitivity);
+    out->_bnameMatcherDir.clear(caseSensitivity);
+
+    QString bnameTraversalFileDirKeep;
+    QString bnameTraversalFileDirRemove;
+    QString bnameTraversalDirKeep;
+    QString bnameTraversalDirRemove;
+
     auto regexAppend = [](QString &fileDirPattern, QString &dirPattern, const QString &appendMe, bool dirOnly) {
         QString &pattern = dirOnly ? dirPattern : fileDirPattern;
         if (!pattern.isEmpty())
@@ -627,7 +743,7 @@ void ExcludedFiles::prepare()
         pattern.append(appendMe);
     };
 
-    for (auto exclude : std::as_const(_allExcludes)) {
+    for (auto exclude : excludes) {
         if (exclude[0] == QLatin1Char('\n'))
             continue; // empty line
         if (exclude[0] == QLatin1Char('\r'))
@@ -649,19 +765,31 @@ void ExcludedFiles::prepare()
         auto &fullFileDir = removeExcluded ? fullFileDirRemove : fullFileDirKeep;
         auto &fullDir = removeExcluded ? fullDirRemove : fullDirKeep;
 
-        auto regexExclude = convertToRegexpSyntax(exclude, _wildcardsMatchSlash);
+        auto regexExclude = convertToRegexpSyntax(exclude, wildcardsMatchSlash);
         if (!fullPath) {
             regexAppend(bnameFileDir, bnameDir, regexExclude, matchDirOnly);
+
+            // A bname never contains a slash, so wildcardsMatchSlash does not matter for the BnameMatcher
+            const auto type = removeExcluded ? CSYNC_FILE_EXCLUDE_AND_REMOVE : CSYNC_FILE_EXCLUDE_LIST;
+            if (!out->_bnameMatcherDir.add(exclude, type)) {
+                regexAppend(removeExcluded ? bnameTraversalFileDirRemove : bnameTraversalFileDirKeep,
+                    removeExcluded ? bnameTraversalDirRemove : bnameTraversalDirKeep, regexExclude, matchDirOnly);
+            } else if (!matchDirOnly) {
+                out->_bnameMatcherFile.add(exclude, type);
+            }
         } else {
             regexAppend(fullFileDir, fullDir, regexExclude, matchDirOnly);
 
             // For activation, trigger on the 'bname' part of the full pattern.
-            QString bnameExclude = extractBnameTrigger(exclude, _wildcardsMatchSlash);
+            QString bnameExclude = extractBnameTrigger(exclude, wildcardsMatchSlash);
             auto regexBname = convertToRegexpSyntax(bnameExclude, true);
             regexAppend(bnameTriggerFileDir, bnameTriggerDir, regexBname, matchDirOnly);
         }
     }
 
+    out->_hasBnameTraversalRegexFile = !bnameTraversalFileDirKeep.isEmpty() || !bnameTraversalFileDirRemove.isEmpty() || !bnameTriggerFileDir.isEmpty();
+    out->_hasBnameTraversalRegexDir = out->_hasBnameTraversalRegexFile || !bnameTraversalDirKeep.isEmpty() || !bnameTraversalDirRemove.isEmpty() || !bnameTriggerDir.isEmpty();
+
     // The empty pattern would match everything - change it to match-nothing
     auto emptyMatchNothing = [](QString &pattern) {
         if (pattern.isEmpty())
@@ -677,6 +805,11 @@ void ExcludedFiles::prepare()
     emptyMatchNothing(bnameDirKeep);
     emptyMatchNothing(bnameDirRemove);
 
+    emptyMatchNothing(bnameTraversalFileDirKeep);
+    emptyMatchNothing(bnameTraversalFileDirRemove);
+    emptyMatchNothing(bnameTraversalDirKeep);
+    emptyMatchNothing(bnameTraversalDirRemove);
+
     emptyMatchNothing(bnameTriggerFileDir);
     emptyMatchNothing(bnameTriggerDir);
 
@@ -685,28 +818,30 @@ void ExcludedFiles::prepare()
     // (exclude)|(excluderemove)|(bname triggers).
     // If the third group matches, the fullActivatedRegex needs to be applied
     // to the full path.
-    _bnameTraversalRegexFile.setPattern(
+    // The patterns handled by the BnameMatcher are left out.
+    out->_bnameTraversalRegexFile.setPattern(
         QStringLiteral("^(?P<exclude>%1)$|"
                        "^(?P<excluderemove>%2)$|"
                        "^(?P<trigger>%3)$")
-            .arg(bnameFileDirKeep, bnameFileDirRemove, bnameTriggerFileDir));
-    _bnameTraversalRegexDir.setPattern(
+            .arg(bnameTraversalFileDirKeep, bnameTraversalFileDirRemove, bnameTriggerFileDir));
+    out->_bnameTraversalRegexDir.setPattern(
         QStringLiteral("^(?P<exclude>%1|%2)$|"
                        "^(?P<excluderemove>%3|%4)$|"
                        "^(?P<trigger>%5|%6)$")
-            .arg(bnameFileDirKeep, bnameDirKeep, bnameFileDirRemove, bnameDirRemove, bnameTriggerFileDir, bnameTriggerDir));
+            .arg(bnameTraversalFileDirKeep, bnameTraversalDirKeep, bnameTraversalFileDirRemove, bnameTraversalDirRemove, bnameTriggerFileDir,
+                bnameTriggerDir));
 
     // The full traveral regex is applied to the full path if the trigger capture of
     // the bname regex matches. Its basic form is (exclude)|(excluderemove)".
     // This pattern can be much simpler than fullRegex since we can assume a traversal
     // situation and doesn't need to look for bname patterns in parent paths.
-    _fullTraversalRegexFile.setPattern(
+    out->_fullTraversalRegexFile.setPattern(
         // Full patterns are anchored to the beginning
         QStringLiteral("^(?P<exclude>%1)(?:$|/)"
                        "|"
                        "^(?P<excluderemove>%2)(?:$|/)")
             .arg(fullFileDirKeep, fullFileDirRemove));
-    _fullTraversalRegexDir.setPattern(
+    out->_fullTraversalRegexDir.setPattern(
         QStringLiteral("^(?P<exclude>%1|%2)(?:$|/)"
                        "|"
                        "^(?P<excluderemove>%3|%4)(?:$|/)")
@@ -714,7 +849,7 @@ void ExcludedFiles::prepare()
 
     // The full regex is applied to the full path and incorporates both bname and
     // full-path patterns. It has the form "(exclude)|(excluderemove)".
-    _fullRegexFile.setPattern(
+    out->_fullRegexFile.setPattern(
         QStringLiteral("(?P<exclude>"
                        // Full patterns are anchored to the beginning
                        "^(?:%1)(?:$|/)|"
@@ -729,7 +864,7 @@ void ExcludedFiles::prepare()
                        "(?:^|/)(?:%5)(?:$|/)|"
                        "(?:^|/)(?:%6)/)")
             .arg(fullFileDirKeep, bnameFileDirKeep, bnameDirKeep, fullFileDirRemove, bnameFileDirRemove, bnameDirRemove));
-    _fullRegexDir.setPattern(
+    out->_fullRegexDir.setPattern(
         QStringLiteral("(?P<exclude>"
                        "^(?:%1|%2)(?:$|/)|"
                        "(?:^|/)(?:%3|%4)(?:$|/))"
@@ -742,16 +877,17 @@ void ExcludedFiles::prepare()
     QRegularExpression::PatternOptions patternOptions = QRegularExpression::NoPatternOption;
     if (OCC::Utility::fsCasePreserving())
         patternOptions |= QRegularExpression::CaseInsensitiveOption;
-    _bnameTraversalRegexFile.setPatternOptions(patternOptions);
-    _bnameTraversalRegexFile.optimize();
-    _bnameTraversalRegexDir.setPatternOptions(patternOptions);
-    _bnameTraversalRegexDir.optimize();
-    _fullTraversalRegexFile.setPatternOptions(patternOptions);
-    _fullTraversalRegexFile.optimize();
-    _fullTraversalRegexDir.setPatternOptions(patternOptions);
-    _fullTraversalRegexDir.optimize();
-    _fullRegexFile.setPatternOptions(patternOptions);
-    _fullRegexFile.optimize();
-    _fullRegexDir.setPatternOptions(patternOptions);
-    _fullRegexDir.optimize();
+    out->_bnameTraversalRegexFile.setPatternOptions(patternOptions);
+    out->_bnameTraversalRegexFile.optimize();
+    out->_bnameTraversalRegexDir.setPatternOptions(patternOptions);
+    out->_bnameTraversalRegexDir.optimize();
+    out->_fullTraversalRegexFile.setPatternOptions(patternOptions);
+    out->_fullTraversalRegexFile.optimize();
+    out->_fullTraversalRegexDir.setPatternOptions(patternOptions);
+    out->_fullTraversalRegexDir.optimize();
+    out->_fullRegexFile.setPatternOptions(patternOptions);
+    out->_fullRegexFile.optimize();
+    out->_fullRegexDir.setPatternOptions(patternOptions);
+    out->_fullRegexDir.optimize();
+    return out;
 }
@@ -32,6 +32,9 @@
 #include <QVersionNumber>
 
 #include <functional>
+#include <map>
+#include <memory>
+#include <set>
 
 enum CSYNC_EXCLUDE_TYPE {
     CSYNC_NOT_EXCLUDED = 0,
@@ -148,6 +151,68 @@ public Q_SLOTS:
     bool reloadExcludeFiles();
 
 private:
+    /**
+     * The simple bname patterns, matched without a regular expression
+     *
+     * Most patterns in the exclude lists are literal names like ".DS_Store",
+     * prefixes like "~$*" or suffixes like "*.part". These are looked up in
+     * sorted tables, only the remaining bname patterns end up in the
+     * _bnameTraversalRegex.
+     */
+    class BnameMatcher
+    {
+    public:
+        /**
+         * Adds \a pattern with the result \a type, returns false if the pattern
+         * is not simple enough and needs to be matched with a regular expression.
+         */
+        bool add(const QString &pattern, CSYNC_EXCLUDE_TYPE type);
+
+        /// Removes all patterns, the new ones will be matched with \a cs
+        void clear(Qt::CaseSensitivity cs);
+
+        /// CSYNC_FILE_EXCLUDE_LIST, CSYNC_FILE_EXCLUDE_AND_REMOVE or CSYNC_NOT_EXCLUDED
+        CSYNC_EXCLUDE_TYPE match(QStringView bname) const;
+
+    private:
+        struct Less
+        {
+            using is_transparent = void;
+            bool operator()(QStringView lhs, QStringView rhs) const { return lhs.compare(rhs, caseSensitivity) < 0; }
+            Qt::CaseSensitivity caseSensitivity;
+        };
+        using Table = std::map<QString, CSYNC_EXCLUDE_TYPE, Less>;
+
+        static void insert(Table &table, const QString &key, CSYNC_EXCLUDE_TYPE type);
+
+        Table _literals{Less{Qt::CaseSensitive}};
+        Table _prefixes{Less{Qt::CaseSensitive}};
+        Table _suffixes{Less{Qt::CaseSensitive}};
+        // the distinct lengths of the keys in _prefixes and _suffixes
+        std::set<qsizetype> _prefixLengths;
+        std::set<qsizetype> _suffixLengths;
+    };
+
+    /**
+     * The matchers built from a list of exclude patterns by prepare()
+     *
+     * They are never changed once they are built, so the instances with the same
+     * patterns, usually the sync engines of all folders, share them.
+     */
+    struct CompiledPatterns
+    {
+        BnameMatcher _bnameMatcherFile;
+        BnameMatcher _bnameMatcherDir;
+        bool _hasBnameTraversalRegexFile = false;
+        bool _hasBnameTraversalRegexDir = false;
+        QRegularExpression _bnameTraversalRegexFile;
+        QRegularExpression _bnameTraversalRegexDir;
+        QRegularExpression _fullTraversalRegexFile;
+        QRegularExpression _fullTraversalRegexDir;
+        QRegularExpression _fullRegexFile;
+        QRegularExpression _fullRegexDir;
+    };
+
     /**
      * Returns true if the version directive indicates the next line
      * should be skipped.
@@ -203,9 +268,17 @@ private:
      * Note: The traversal matcher will return not-excluded on some paths that the
      * full matcher would exclude. Example: "b" is excluded. traversal("b/c")
      * returns not-excluded because "c" isn't a bname activation pattern.
+     *
+     * The simple bname patterns are put into _bnameMatcherFile/_bnameMatcherDir
+     * instead of the _bnameTraversalRegex, see BnameMatcher.
+     *
+     * The compiled patterns are looked up in a cache of the whole process first,
+     * see CompiledPatterns.
      */
     void prepare();
 
+    static std::shared_ptr<const CompiledPatterns> compile(const QStringList &excludes, bool wildcardsMatchSlash);
+
     static QString extractBnameTrigger(const QString &exclude, bool wildcardsMatchSlash);
     static QString convertToRegexpSyntax(QString exclude, bool wildcardsMatchSlash);
 
@@ -218,13 +291,8 @@ private:
     /// List of all active exclude patterns
     QStringList _allExcludes;
 
-    /// see prepare()
-    QRegularExpression _bnameTraversalRegexFile;
-    QRegularExpression _bnameTraversalRegexDir;
-    QRegularExpression _fullTraversalRegexFile;
-    QRegularExpression _fullTraversalRegexDir;
-    QRegularExpression _fullRegexFile;
-    QRegularExpression _fullRegexDir;
+    /// see prepare(), shared with the other instances that have the same patterns
+    std::shared_ptr<const CompiledPatterns> _compiled;
 
     bool _excludeConflictFiles = true;
 
@@ -25,6 +25,8 @@
 
 #include <QString>
 
+#include <vector>
+
 struct csync_vio_handle_t;
 namespace OCC {
 class Vfs;
@@ -34,6 +36,24 @@ csync_vio_handle_t OCSYNC_EXPORT *csync_vio_local_opendir(const QString &name);
 int OCSYNC_EXPORT csync_vio_local_closedir(csync_vio_handle_t *dhandle);
 std::unique_ptr<csync_file_stat_t> OCSYNC_EXPORT csync_vio_local_readdir(csync_vio_handle_t *dhandle, OCC::Vfs *vfs);
 
+/**
+ * Read all remaining entries of the directory at once
+ *
+ * This is cheaper than repeated csync_vio_local_readdir() calls: the entries
+ * are stat'ed relative to the open directory and stored in one vector.
+ *
+ * Returns false and sets errno if reading the directory failed, \a entries
+ * contains the entries read until then.
+ */
+bool OCSYNC_EXPORT csync_vio_local_readdir_all(csync_vio_handle_t *dhandle, OCC::Vfs *vfs, std::vector<csync_file_stat_t> *entries);
+
 int OCSYNC_EXPORT csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf);
 
+/**
+ * Same as csync_vio_local_stat() for the open file descriptor \a fd, like the one of QFile::handle()
+ *
+ * The path is not resolved again, so the result is the one of the file that was opened.
+ */
+int OCSYNC_EXPORT csync_vio_local_fstat(int fd, csync_file_stat_t *buf);
+
 #endif /* _CSYNC_VIO_LOCAL_H */
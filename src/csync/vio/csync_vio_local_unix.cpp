@@ -25,6 +25,7 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "csync.h"
 
@@ -34,6 +35,12 @@
 
 #include <QtCore/QLoggingCategory>
 
+#include <tuple>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
 Q_LOGGING_CATEGORY(lcCSyncVIOLocal, "sync.csync.vio_local", QtInfoMsg)
 
 /*
@@ -116,14 +123,8 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
 }
 
 
-int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
+static void fillFileStat(const struct stat &sb, csync_file_stat_t *buf)
 {
-    struct stat sb;
-
-    if (lstat(OCC::FileSystem::encodeFileName(uri).constData(), &sb) < 0) {
-      return -1;
-    }
-
     switch (sb.st_mode & S_IFMT) {
     case S_IFDIR:
       buf->type = ItemTypeDirectory;
@@ -149,5 +150,108 @@ int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
   buf->inode = sb.st_ino;
   buf->modtime = sb.st_mtime;
   buf->size = sb.st_size;
-  return 0;
+}
+
+int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
+{
+    struct stat sb;
+
+    if (lstat(OCC::FileSystem::encodeFileName(uri).constData(), &sb) < 0) {
+      return -1;
+    }
+    fillFileStat(sb, buf);
+    return 0;
+}
+
+int csync_vio_local_fstat(int fd, csync_file_stat_t *buf)
+{
+    struct stat sb;
+
+    if (fstat(fd, &sb) < 0) {
+        return -1;
+    }
+    fillFileStat(sb, buf);
+    return 0;
+}
+
+namespace {
+// stat the entry relative to the directory and append it to entries
+void appendEntry(int dirFd, const char *name, OCC::Vfs *vfs, std::vector<csync_file_stat_t> *entries)
+{
+    if (qstrcmp(name, ".") == 0 || qstrcmp(name, "..") == 0) {
+        return;
+    }
+    auto &file_stat = entries->emplace_back();
+    file_stat.path = OCC::FileSystem::decodeFileName(name);
+
+    struct stat sb;
+    if (fstatat(dirFd, name, &sb, AT_SYMLINK_NOFOLLOW) < 0) {
+        // Will get excluded by _csync_detect_update.
+        file_stat.type = ItemTypeSkip;
+    } else {
+        fillFileStat(sb, &file_stat);
+    }
+
+    // Override type for virtual files if desired
+    if (vfs) {
+        std::ignore = vfs->statTypeVirtualFile(&file_stat, nullptr);
+    }
+}
+
+#ifdef Q_OS_LINUX
+// the layout the kernel uses for getdents64
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// large enough for a few thousand entries per syscall, readdir uses 32KiB
+constexpr size_t DirentBufferSize = 256 * 1024;
+#endif
+}
+
+bool csync_vio_local_readdir_all(csync_vio_handle_t *handle, OCC::Vfs *vfs, std::vector<csync_file_stat_t> *entries)
+{
+    const int fd = dirfd(handle->dh);
+    if (fd < 0) {
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    // Read the entries in larger chunks than readdir does.
+    // The DIR stream must not be used for reading afterwards.
+    std::unique_ptr<char[]> buffer(new char[DirentBufferSize]);
+    while (true) {
+        const auto nread = syscall(SYS_getdents64, fd, buffer.get(), DirentBufferSize);
+        if (nread < 0) {
+            return false;
+        }
+        if (nread == 0) {
+            break;
+        }
+        for (long offset = 0; offset < nread;) {
+            const auto *dirent = reinterpret_cast<const linux_dirent64 *>(buffer.get() + offset);
+            appendEntry(fd, dirent->d_name, vfs, entries);
+            offset += dirent->d_reclen;
+        }
+    }
+#else
+    while (true) {
+        errno = 0;
+        const struct dirent *dirent = readdir(handle->dh);
+        if (!dirent) {
+            if (errno != 0) {
+                return false;
+            }
+            break;
+        }
+        appendEntry(fd, dirent->d_name, vfs, entries);
+    }
+#endif
+    errno = 0;
+    return true;
 }
@@ -20,6 +20,7 @@
  */
 
 #include <errno.h>
+#include <io.h>
 
 #include "common/filesystembase.h"
 #include "common/utility.h"
@@ -42,7 +43,8 @@ struct csync_vio_handle_t
     WIN32_FIND_DATA ffd;
     HANDLE hFind;
     int firstFind;
-    QString path; // Always ends with '\'
+    QString path; // Always ends with '\', already in the long native form
+    QString entryPath; // Reused for the entries of the directory to avoid an allocation per entry
 };
 
 csync_vio_handle_t *csync_vio_local_opendir(const QString &name)
@@ -52,7 +54,10 @@ csync_vio_handle_t *csync_vio_local_opendir(const QString &name)
     // the file wildcard has to be attached
     QString dirname = OCC::FileSystem::longWinPath(name + QLatin1String("/*"));
 
-    handle->hFind = FindFirstFile(reinterpret_cast<const wchar_t *>(dirname.utf16()), &(handle->ffd));
+    // We don't use the short names, skipping them and fetching
+    // larger chunks of entries speeds up large directories
+    handle->hFind = FindFirstFileExW(reinterpret_cast<const wchar_t *>(dirname.utf16()), FindExInfoBasic, &(handle->ffd), FindExSearchNameMatch, nullptr,
+        FIND_FIRST_EX_LARGE_FETCH);
 
     if (handle->hFind == INVALID_HANDLE_VALUE) {
         int retcode = GetLastError();
@@ -68,6 +73,7 @@ csync_vio_handle_t *csync_vio_local_opendir(const QString &name)
 
     dirname.chop(1); // remove the *
     handle->path = std::move(dirname);
+    handle->entryPath = handle->path;
     return handle.release();
 }
 
@@ -105,6 +111,49 @@ static time_t FileTimeToUnixTime(FILETIME *filetime, DWORD *remainder)
     }
 }
 
+static time_t FileTimeToUnixTime(const LARGE_INTEGER &time)
+{
+    FILETIME filetime;
+    filetime.dwLowDateTime = time.LowPart;
+    filetime.dwHighDateTime = time.HighPart;
+    DWORD rem;
+    return FileTimeToUnixTime(&filetime, &rem);
+}
+
+// Determine the type from the attributes of a directory entry
+static void fillTypeFromFindData(WIN32_FIND_DATA *ffd, OCC::Vfs *vfs, csync_file_stat_t *file_stat)
+{
+    if (vfs && vfs->statTypeVirtualFile(file_stat, ffd)) {
+        // all good
+    } else if (ffd->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        file_stat->type = ItemTypeDirectory;
+    } else if (ffd->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        // Detect symlinks, and treat junctions as symlinks too.
+        if (ffd->dwReserved0 == IO_REPARSE_TAG_SYMLINK
+            || ffd->dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT) {
+            file_stat->type = ItemTypeSoftLink;
+        } else {
+            // The SIS and DEDUP reparse points should be treated as
+            // regular files. We don't know about the other ones yet,
+            // but will also treat them normally for now.
+            file_stat->type = ItemTypeFile;
+        }
+    } else if (ffd->dwFileAttributes & FILE_ATTRIBUTE_DEVICE
+        || ffd->dwFileAttributes & FILE_ATTRIBUTE_OFFLINE) {
+        file_stat->type = ItemTypeSkip;
+    } else {
+        file_stat->type = ItemTypeFile;
+    }
+
+    /* Check for the hidden flag */
+    if (ffd->dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) {
+        file_stat->is_hidden = true;
+    }
+}
+
+// Like csync_vio_local_stat() for a path that already went through longWinPath()
+static int statLongPath(const QString &uri, csync_file_stat_t *buf);
+
 std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *handle, OCC::Vfs *vfs)
 {
     std::unique_ptr<csync_file_stat_t> file_stat;
@@ -134,39 +183,15 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
     file_stat.reset(new csync_file_stat_t);
     file_stat->path = path;
 
-    if (vfs && vfs->statTypeVirtualFile(file_stat.get(), &handle->ffd)) {
-        // all good
-    } else if (handle->ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-        file_stat->type = ItemTypeDirectory;
-    } else if (handle->ffd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
-        // Detect symlinks, and treat junctions as symlinks too.
-        if (handle->ffd.dwReserved0 == IO_REPARSE_TAG_SYMLINK
-            || handle->ffd.dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT) {
-            file_stat->type = ItemTypeSoftLink;
-        } else {
-            // The SIS and DEDUP reparse points should be treated as
-            // regular files. We don't know about the other ones yet,
-            // but will also treat them normally for now.
-            file_stat->type = ItemTypeFile;
-        }
-    } else if (handle->ffd.dwFileAttributes & FILE_ATTRIBUTE_DEVICE
-        || handle->ffd.dwFileAttributes & FILE_ATTRIBUTE_OFFLINE) {
-        file_stat->type = ItemTypeSkip;
-    } else {
-        file_stat->type = ItemTypeFile;
-    }
-
-    /* Check for the hidden flag */
-    if (handle->ffd.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) {
-        file_stat->is_hidden = true;
-    }
+    fillTypeFromFindData(&handle->ffd, vfs, file_stat.get());
 
     file_stat->size = (handle->ffd.nFileSizeHigh * ((int64_t)(MAXDWORD) + 1)) + handle->ffd.nFileSizeLow;
     file_stat->modtime = FileTimeToUnixTime(&handle->ffd.ftLastWriteTime, &rem);
 
-    // path always ends with '\', by construction
-
-    if (csync_vio_local_stat(handle->path + path, file_stat.get()) < 0) {
+    // path always ends with '\' and is already converted by longWinPath(), by construction
+    handle->entryPath.truncate(handle->path.size());
+    handle->entryPath.append(path);
+    if (statLongPath(handle->entryPath, file_stat.get()) < 0) {
         // Will get excluded by _csync_detect_update.
         file_stat->type = ItemTypeSkip;
     }
@@ -174,7 +199,85 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
     return file_stat;
 }
 
-int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
+bool csync_vio_local_readdir_all(csync_vio_handle_t *handle, OCC::Vfs *vfs, std::vector<csync_file_stat_t> *entries)
+{
+    // Enumerate the directory with its file ids, which saves opening every entry
+    // in csync_vio_local_stat() to call GetFileInformationByHandle().
+    const HANDLE dir = CreateFileW(reinterpret_cast<const wchar_t *>(handle->path.utf16()), FILE_LIST_DIRECTORY,
+        FILE_SHARE_WRITE | FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (dir == INVALID_HANDLE_VALUE) {
+        qCWarning(lcCSyncVIOLocal) << "Could not open" << handle->path << "for listing:" << OCC::Utility::formatWinError(GetLastError());
+        errno = 0;
+        while (auto dirent = csync_vio_local_readdir(handle, vfs)) {
+            entries->push_back(std::move(*dirent));
+        }
+        return errno == 0;
+    }
+
+    // FILE_ID_BOTH_DIR_INFO needs to be 8 byte aligned
+    constexpr DWORD bufferSize = 64 * 1024;
+    std::unique_ptr<LONGLONG[]> buffer(new LONGLONG[bufferSize / sizeof(LONGLONG)]);
+    auto infoClass = FileIdBothDirectoryRestartInfo;
+    while (GetFileInformationByHandleEx(dir, infoClass, buffer.get(), bufferSize)) {
+        infoClass = FileIdBothDirectoryInfo;
+        auto *info = reinterpret_cast<const FILE_ID_BOTH_DIR_INFO *>(buffer.get());
+        while (true) {
+            const QString name = QString::fromWCharArray(info->FileName, info->FileNameLength / sizeof(wchar_t));
+            if (name != QLatin1String(".") && name != QLatin1String("..")) {
+                // the vfs plugins expect the data FindNextFile would have returned
+                WIN32_FIND_DATA ffd = {};
+                ffd.dwFileAttributes = info->FileAttributes;
+                ffd.ftLastWriteTime = {info->LastWriteTime.LowPart, static_cast<DWORD>(info->LastWriteTime.HighPart)};
+                ffd.nFileSizeLow = info->EndOfFile.LowPart;
+                ffd.nFileSizeHigh = static_cast<DWORD>(info->EndOfFile.HighPart);
+                // for reparse points EaSize contains the reparse tag
+                ffd.dwReserved0 = (info->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ? info->EaSize : 0;
+                name.left(MAX_PATH - 1).toWCharArray(ffd.cFileName);
+
+                auto &file_stat = entries->emplace_back();
+                file_stat.path = name;
+                fillTypeFromFindData(&ffd, vfs, &file_stat);
+                file_stat.size = info->EndOfFile.QuadPart;
+                file_stat.modtime = FileTimeToUnixTime(info->LastWriteTime);
+                /* Get the Windows file id as an inode replacement. */
+                file_stat.inode = info->FileId.QuadPart & 0x0000FFFFFFFFFFFF;
+            }
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            info = reinterpret_cast<const FILE_ID_BOTH_DIR_INFO *>(reinterpret_cast<const char *>(info) + info->NextEntryOffset);
+        }
+    }
+    const DWORD error = GetLastError();
+    CloseHandle(dir);
+    if (error != ERROR_NO_MORE_FILES) {
+        qCWarning(lcCSyncVIOLocal) << "Listing" << handle->path << "failed:" << OCC::Utility::formatWinError(error);
+        errno = EACCES;
+        return false;
+    }
+    errno = 0;
+    return true;
+}
+
+static void fillFileStat(const BY_HANDLE_FILE_INFORMATION &fileInfo, csync_file_stat_t *buf)
+{
+    ULARGE_INTEGER FileIndex;
+
+    /* Get the Windows file id as an inode replacement. */
+    FileIndex.HighPart = fileInfo.nFileIndexHigh;
+    FileIndex.LowPart = fileInfo.nFileIndexLow;
+    FileIndex.QuadPart &= 0x0000FFFFFFFFFFFF;
+    /* printf("Index: %I64i\n", FileIndex.QuadPart); */
+    buf->inode = FileIndex.QuadPart;
+
+    buf->size = ULARGE_INTEGER { { fileInfo.nFileSizeLow, fileInfo.nFileSizeHigh } }.QuadPart;
+
+    DWORD rem;
+    FILETIME lastWriteTime = fileInfo.ftLastWriteTime;
+    buf->modtime = FileTimeToUnixTime(&lastWriteTime, &rem);
+}
+
+static int statLongPath(const QString &uri, csync_file_stat_t *buf)
 {
     /* Almost nothing to do since csync_vio_local_readdir already filled up most of the information
        But we still need to fetch the file ID.
@@ -183,9 +286,8 @@ int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
 
     HANDLE h;
     BY_HANDLE_FILE_INFORMATION fileInfo;
-    ULARGE_INTEGER FileIndex;
 
-    h = CreateFileW(reinterpret_cast<const wchar_t *>(OCC::FileSystem::longWinPath(uri).utf16()), 0, FILE_SHARE_WRITE | FILE_SHARE_READ | FILE_SHARE_DELETE,
+    h = CreateFileW(reinterpret_cast<const wchar_t *>(uri.utf16()), 0, FILE_SHARE_WRITE | FILE_SHARE_READ | FILE_SHARE_DELETE,
         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr);
     if (h == INVALID_HANDLE_VALUE) {
         errno = GetLastError();
@@ -199,19 +301,30 @@ int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
         CloseHandle(h);
         return -1;
     }
+    fillFileStat(fileInfo, buf);
 
-    /* Get the Windows file id as an inode replacement. */
-    FileIndex.HighPart = fileInfo.nFileIndexHigh;
-    FileIndex.LowPart = fileInfo.nFileIndexLow;
-    FileIndex.QuadPart &= 0x0000FFFFFFFFFFFF;
-    /* printf("Index: %I64i\n", FileIndex.QuadPart); */
-    buf->inode = FileIndex.QuadPart;
-
-    buf->size = ULARGE_INTEGER { { fileInfo.nFileSizeLow, fileInfo.nFileSizeHigh } }.QuadPart;
+    CloseHandle(h);
+    return 0;
+}
 
-    DWORD rem;
-    buf->modtime = FileTimeToUnixTime(&fileInfo.ftLastWriteTime, &rem);
+int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
+{
+    return statLongPath(OCC::FileSystem::longWinPath(uri), buf);
+}
 
-    CloseHandle(h);
+int csync_vio_local_fstat(int fd, csync_file_stat_t *buf)
+{
+    const HANDLE h = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+    if (h == INVALID_HANDLE_VALUE) {
+        errno = ERROR_INVALID_HANDLE;
+        return -1;
+    }
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    if (!GetFileInformationByHandle(h, &fileInfo)) {
+        errno = GetLastError();
+        qCCritical(lcCSyncVIOLocal) << "GetFileInformationByHandle failed on" << fd << OCC::Utility::formatWinError(errno);
+        return -1;
+    }
+    fillFileStat(fileInfo, buf);
     return 0;
 }
@@ -17,6 +17,7 @@
 #include "configfile.h"
 #include "creds/credentialmanager.h"
 #include "guiutility.h"
+#include "gui/startuptrace.h"
 #include <creds/httpcredentialsgui.h>
 #include <theme.h>
 
@@ -120,9 +121,12 @@ bool AccountManager::restore()
     }
 
     for (const auto &accountId : childGroups) {
+        const StartupTrace::Span span(QStringLiteral("Restore account"), {{QStringLiteral("id"), accountId}});
         settings->beginGroup(accountId);
         if (auto acc = loadAccountHelper(*settings)) {
             acc->_id = accountId;
+            // read the credentials of all accounts right away instead of when each account gets to connect
+            acc->credentialManager()->prefetch();
             if (auto accState = AccountState::loadFromSettings(acc, *settings)) {
                 addAccountState(std::move(accState));
             }
@@ -43,6 +43,7 @@
 #include "theme.h"
 
 #include <QAction>
+#include <QFileDialog>
 #include <QMessageBox>
 #include <QSortFilterProxyModel>
 #include <QtQuickWidgets/QtQuickWidgets>
@@ -255,6 +256,7 @@ void AccountSettings::slotCustomContextMenuRequested(Folder *folder)
             }
             if (!folder->virtualFilesEnabled()) {
                 menu->addAction(tr("Choose what to sync"), this, [folder, this] { showSelectiveSyncDialog(folder); });
+                menu->addAction(tr("Change local folder..."), this, [folder, this] { slotMoveCurrentFolder(folder); });
             }
             menu->popup(QCursor::pos());
             menu->setFocus(); // for accassebility (keyboard navigation)
@@ -280,8 +282,15 @@ void AccountSettings::showSelectiveSyncDialog(Folder *folder)
     auto *modalWidget = new AccountModalWidget(tr("Choose what to sync"), selectiveSync, this);
     modalWidget->setStandardButtons(QDialogButtonBox::Cancel | QDialogButtonBox::Ok);
     connect(modalWidget, &AccountModalWidget::accepted, this, [selectiveSync, folder, this] {
-        folder->journalDb()->setSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, selectiveSync->createBlackList());
-        doForceSyncCurrentFolder(folder);
+        if (!folder->setSelectiveSyncBlackList(selectiveSync->createBlackList())) {
+            doForceSyncCurrentFolder(folder);
+            return;
+        }
+        // only folders were included again, sync them right away without a full local discovery
+        if (folder->isSyncRunning()) {
+            folder->slotTerminateSync(tr("Selective sync changed"));
+        }
+        FolderMan::instance()->scheduler()->enqueueFolder(folder, SyncScheduler::Priority::High);
     });
     addModalWidget(modalWidget);
 }
@@ -396,6 +405,28 @@ void AccountSettings::slotDisableVfsCurrentFolder(Folder *folder)
     msgBox->open();
 }
 
+void AccountSettings::slotMoveCurrentFolder(Folder *folder)
+{
+    auto *dialog = new QFileDialog(this, tr("Choose the new location of %1").arg(folder->shortGuiLocalPath()), folder->path());
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setFileMode(QFileDialog::Directory);
+    dialog->setOption(QFileDialog::ShowDirsOnly);
+    connect(dialog, &QFileDialog::fileSelected, this, [folder = QPointer<Folder>(folder), this](const QString &localPath) {
+        if (!folder) {
+            return;
+        }
+        qCInfo(lcAccountSettings) << "Moving folder" << folder->path() << "to" << localPath;
+        // the synced files were moved to localPath, the folder keeps its journal
+        const auto result = FolderMan::instance()->rerootFolder(folder, localPath, folder->remotePath());
+        if (!result) {
+            auto *msgBox = new QMessageBox(QMessageBox::Warning, tr("Could not change the local folder"), result.error(), QMessageBox::Ok, this);
+            msgBox->setAttribute(Qt::WA_DeleteOnClose);
+            msgBox->open();
+        }
+    });
+    dialog->open();
+}
+
 void AccountSettings::showConnectionLabel(const QString &message, StatusIcon statusIcon, QStringList errors)
 {
     if (errors.isEmpty()) {
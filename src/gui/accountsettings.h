@@ -88,6 +88,8 @@ protected Q_SLOTS:
     void slotRemoveCurrentFolder(Folder *folder);
     void slotEnableVfsCurrentFolder(Folder *folder);
     void slotDisableVfsCurrentFolder(Folder *folder);
+    /// Lets the user pick the new location of the moved local folder, see FolderMan::rerootFolder()
+    void slotMoveCurrentFolder(Folder *folder);
     void slotFolderWizardAccepted();
     void slotDeleteAccount();
     void slotOpenAccountInBrowser();
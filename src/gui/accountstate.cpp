@@ -19,6 +19,7 @@
 #include "configfile.h"
 #include "fetchserversettings.h"
 
+#include "libsync/coalescedtimer.h"
 #include "libsync/creds/abstractcredentials.h"
 #include "libsync/creds/httpcredentials.h"
 
@@ -123,6 +124,9 @@ AccountState::AccountState(AccountPtr account)
         case NetworkInformation::Reachability::Disconnected:
             // explicitly set disconnected, this way a successful checkConnectivity call above will trigger a local discover
             if (state() != State::SignedOut) {
+                // Hold back the jobs of the running syncs, the jobs whose connection is lost wait in the queue as well.
+                // Once the connection was validated again they continue, without setting up the syncs from scratch.
+                _queueGuard.block();
                 setState(State::Disconnected);
             }
             [[fallthrough]];
@@ -169,9 +173,9 @@ AccountState::AccountState(AccountPtr account)
     }
 
     // as a fallback and to recover after server issues we also poll
-    auto timer = new QTimer(this);
+    auto timer = new CoalescedTimer(this);
     timer->setInterval(ConnectionValidator::DefaultCallingInterval);
-    connect(timer, &QTimer::timeout, this, [this] { checkConnectivity(false); });
+    connect(timer, &CoalescedTimer::timeout, this, [this] { checkConnectivity(false); });
     timer->start();
 
     connect(account->credentials(), &AbstractCredentials::requestLogout, this, [this] {
@@ -425,12 +429,11 @@ void AccountState::checkConnectivity(bool blockJobs)
     if (isConnected()) {
         // Use a small authed propfind as a minimal ping when we're
         // already connected.
+        // The settings are updated by the FetchServerSettingsJob started once connected.
         if (blockJobs) {
             _connectionValidator->setClearCookies(true);
-            mode = ConnectionValidator::ValidationMode::ValidateAuth;
-        } else {
-            mode = ConnectionValidator::ValidationMode::ValidateAuthAndUpdate;
         }
+        mode = ConnectionValidator::ValidationMode::ValidateAuth;
     } else {
         // Check the server and then the auth.
         if (_waitingForNewCredentials) {
@@ -642,7 +645,7 @@ void AccountState::setSettingUp(bool settingUp)
 }
 bool AccountState::readyForSync() const
 {
-    return !_fetchCapabilitiesJob && isConnected();
+    return isConnected() && !_spaceMigrationRunning && (!_fetchCapabilitiesJob || _account->hasCapabilities());
 }
 
 } // namespace OCC
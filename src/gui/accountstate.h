@@ -29,6 +29,8 @@
 class QDialog;
 class QMessageBox;
 class QSettings;
+class TestAccountState;
+class TestSpacesMigration;
 
 namespace OCC {
 
@@ -114,6 +116,11 @@ public:
 
     bool isSignedOut() const;
 
+    /** Whether the account is connected and its capabilities are known
+     *
+     * The capabilities of the last session are used while they are refreshed
+     * after a connect, so the sync doesn't wait for the server settings.
+     */
     [[nodiscard]] bool readyForSync() const;
 
     /** A user-triggered sign out which disconnects, stops syncs
@@ -196,6 +203,8 @@ private:
     QPointer<UpdateUrlDialog> _updateUrlDialog;
     QPointer<TlsErrorDialog> _tlsDialog;
     bool _supportsSpaces = true;
+    // The folders can't sync while SpaceMigration changes their urls
+    bool _spaceMigrationRunning = false;
 
     bool _settingUp = false;
 
@@ -216,6 +225,8 @@ private:
     QPointer<FetchServerSettingsJob> _fetchCapabilitiesJob;
 
     friend class SpaceMigration;
+    friend class ::TestAccountState;
+    friend class ::TestSpacesMigration;
 };
 }
 
@@ -128,10 +128,13 @@ void ActivityWidget::slotRefreshNotifications(const AccountStatePtr &ptr)
     // are running
     if (_notificationRequestsRunning == 0) {
         ServerNotificationHandler *snh = new ServerNotificationHandler;
-        connect(snh, &ServerNotificationHandler::newNotificationList,
-            this, &ActivityWidget::slotBuildNotificationDisplay);
+        connect(snh, &ServerNotificationHandler::newNotificationList, this,
+            [this, accountUuid = ptr->account()->uuid()](const ActivityList &list, const QByteArray &etag) {
+                _notificationEtags[accountUuid] = etag;
+                slotBuildNotificationDisplay(list);
+            });
 
-        snh->slotFetchNotifications(ptr);
+        snh->slotFetchNotifications(ptr, _notificationEtags.value(ptr->account()->uuid()));
     } else {
         qCWarning(lcActivity) << "Notification request counter not zero.";
     }
@@ -139,6 +142,7 @@ void ActivityWidget::slotRefreshNotifications(const AccountStatePtr &ptr)
 
 void ActivityWidget::slotRemoveAccount(const AccountStatePtr &ptr)
 {
+    _notificationEtags.remove(ptr->account()->uuid());
     _model->slotRemoveAccount(ptr);
 }
 
@@ -475,7 +479,7 @@ ActivitySettings::ActivitySettings(QWidget *parent)
     _progressIndicator = new QProgressIndicator(this);
     _tab->setCornerWidget(_progressIndicator);
 
-    connect(&_notificationCheckTimer, &QTimer::timeout,
+    connect(&_notificationCheckTimer, &CoalescedTimer::timeout,
         this, &ActivitySettings::slotRegularNotificationCheck);
 
     // connect a model signal to stop the animation.
@@ -491,7 +495,7 @@ ActivitySettings::ActivitySettings(QWidget *parent)
 void ActivitySettings::setNotificationRefreshInterval(std::chrono::milliseconds interval)
 {
     qCDebug(lcActivity) << "Starting Notification refresh timer with " << interval.count() / 1000 << " sec interval";
-    _notificationCheckTimer.start(interval.count());
+    _notificationCheckTimer.start(interval);
 }
 
 void ActivitySettings::setActivityTabHidden(bool hidden)
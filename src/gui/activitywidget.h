@@ -25,6 +25,7 @@
 #include "owncloudgui.h"
 #include "account.h"
 #include "activitydata.h"
+#include "libsync/coalescedtimer.h"
 
 #include "models/models.h"
 
@@ -112,6 +113,9 @@ private:
     // no query for notifications is started.
     int _notificationRequestsRunning;
 
+    // the ETags of the last notifications shown per account, unchanged ones are not fetched again
+    QHash<QUuid, QByteArray> _notificationEtags;
+
     ActivityListModel *_model;
     Models::SignalledQSortFilterProxyModel *_sortModel;
     QVBoxLayout *_notificationsLayout;
@@ -161,7 +165,7 @@ private:
     ProtocolWidget *_protocolWidget;
     IssuesWidget *_issuesWidget;
     QProgressIndicator *_progressIndicator;
-    QTimer _notificationCheckTimer;
+    CoalescedTimer _notificationCheckTimer;
     QHash<AccountState *, QElapsedTimer> _timeSinceLastCheck;
 };
 }
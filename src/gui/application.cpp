@@ -146,7 +146,10 @@ void Application::slotAccountStateAdded(AccountStatePtr accountState) const
     connect(accountState.data(), &AccountState::isConnectedChanged, FolderMan::instance(), &FolderMan::slotIsConnectedChanged);
     connect(accountState->account().data(), &Account::serverVersionChanged, FolderMan::instance(),
         [account = accountState->account().data()] { FolderMan::instance()->slotServerVersionChanged(account); });
-    accountState->checkConnectivity();
+    // the restored accounts started connecting right after they were loaded
+    if (accountState->state() == AccountState::Disconnected) {
+        accountState->checkConnectivity();
+    }
 }
 
 void Application::slotCleanup()
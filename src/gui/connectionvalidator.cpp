@@ -102,6 +102,9 @@ void ConnectionValidator::systemProxyLookupDone(const QNetworkProxy &proxy)
 // The actual check
 void ConnectionValidator::slotCheckServerAndAuth()
 {
+    // the status check uses a separate access manager, meanwhile establish the connections for the following requests
+    _account->accessManager()->warmUp(_account->url());
+
     auto checkServerFactory = CheckServerJobFactory::createFromAccount(_account, _clearCookies, this);
     auto checkServerJob = checkServerFactory.startJob(_account->url(), this);
 
@@ -201,6 +204,18 @@ void ConnectionValidator::checkAuthentication()
     connect(job, &PropfindJob::finishedWithoutError, this, &ConnectionValidator::slotAuthSuccess);
     connect(job, &PropfindJob::finishedWithError, this, &ConnectionValidator::slotAuthFailed);
     job->start();
+
+    if (_mode != ConnectionValidator::ValidationMode::ValidateAuth) {
+        // the settings are fetched at the same time, their result is used once the authentication succeeded
+        auto *fetchSetting = new FetchServerSettingsJob(_account, this);
+        connect(fetchSetting, &FetchServerSettingsJob::finishedSignal, this, [this](FetchServerSettingsJob::Result result) {
+            _settingsResult = result;
+            if (_authSucceeded) {
+                reportSettingsResult();
+            }
+        });
+        fetchSetting->start();
+    }
 }
 
 void ConnectionValidator::slotAuthFailed()
@@ -235,40 +250,43 @@ void ConnectionValidator::slotAuthSuccess()
 {
     _errors.clear();
     if (_mode != ConnectionValidator::ValidationMode::ValidateAuth) {
-        auto *fetchSetting = new FetchServerSettingsJob(_account, this);
-        const auto unsupportedServerError = [this] {
-            _errors.append({tr("The configured server for this client is too old."), tr("Please update to the latest server and restart the client.")});
-        };
-        connect(fetchSetting, &FetchServerSettingsJob::finishedSignal, this, [unsupportedServerError, this](FetchServerSettingsJob::Result result) {
-            switch (result) {
-            case FetchServerSettingsJob::Result::UnsupportedServer:
-                unsupportedServerError();
-                reportResult(ServerVersionMismatch);
-                break;
-            case FetchServerSettingsJob::Result::InvalidCredentials:
-                reportResult(CredentialsWrong);
-                break;
-            case FetchServerSettingsJob::Result::TimeOut:
-                reportResult(Timeout);
-                break;
-            case FetchServerSettingsJob::Result::Success:
-                if (_account->serverSupportLevel() == Account::ServerSupportLevel::Unknown) {
-                    unsupportedServerError();
-                }
-                reportResult(Connected);
-                break;
-            case FetchServerSettingsJob::Result::Undefined:
-                reportResult(Undefined);
-                break;
-            }
-        });
-
-        fetchSetting->start();
+        _authSucceeded = true;
+        if (_settingsResult.has_value()) {
+            reportSettingsResult();
+        }
         return;
     }
     reportResult(Connected);
 }
 
+void ConnectionValidator::reportSettingsResult()
+{
+    const auto unsupportedServerError = [this] {
+        _errors.append({tr("The configured server for this client is too old."), tr("Please update to the latest server and restart the client.")});
+    };
+    switch (_settingsResult.value()) {
+    case FetchServerSettingsJob::Result::UnsupportedServer:
+        unsupportedServerError();
+        reportResult(ServerVersionMismatch);
+        break;
+    case FetchServerSettingsJob::Result::InvalidCredentials:
+        reportResult(CredentialsWrong);
+        break;
+    case FetchServerSettingsJob::Result::TimeOut:
+        reportResult(Timeout);
+        break;
+    case FetchServerSettingsJob::Result::Success:
+        if (_account->serverSupportLevel() == Account::ServerSupportLevel::Unknown) {
+            unsupportedServerError();
+        }
+        reportResult(Connected);
+        break;
+    case FetchServerSettingsJob::Result::Undefined:
+        reportResult(Undefined);
+        break;
+    }
+}
+
 void ConnectionValidator::reportResult(Status status)
 {
     if (OC_ENSURE(!_finished)) {
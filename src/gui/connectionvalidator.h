@@ -17,6 +17,7 @@
 #include "gui/owncloudguilib.h"
 
 #include "common/chronoelapsedtimer.h"
+#include "gui/fetchserversettings.h"
 #include "gui/guiutility.h"
 #include "libsync/accountfwd.h"
 
@@ -26,6 +27,7 @@
 #include <QVariantMap>
 
 #include <chrono>
+#include <optional>
 
 namespace OCC {
 
@@ -55,24 +57,13 @@ namespace OCC {
   +---------------------------+
   |
 *-+-> checkAuthentication (PROPFIND on root)
-        PropfindJob
-        |
-        +-> slotAuthFailed --> X
-        |
-        +-> slotAuthSuccess --+--> X (depending if coming from checkServerAndAuth or not)
-                              |
-  +---------------------------+
-  |
-  +-> checkServerCapabilities
-        JsonApiJob (cloud/capabilities) -> slotCapabilitiesRecieved -+
-                                                                     |
-  +------------------------------------------------------------------+
-  |
-  +-> fetchUser -+
-                 |
-                 +-> AvatarJob
-                            |
-                            +-> slotAvatarImage --> reportResult()
+        PropfindJob                       FetchServerSettingsJob (at the same time, unless ValidateAuth)
+        |                                 JsonApiJob (cloud/capabilities) and JsonApiJob (cloud/user)
+        +-> slotAuthFailed --> X          |
+        |                                 |
+        +-> slotAuthSuccess --+--> X (ValidateAuth)
+                              |           |
+                              +-----------+-> reportSettingsResult --> reportResult()
 
     \endcode
  */
@@ -138,6 +129,7 @@ protected Q_SLOTS:
 
 private:
     void reportResult(Status status);
+    void reportSettingsResult();
 
     QStringList _errors;
     AccountPtr _account;
@@ -146,6 +138,9 @@ private:
     Utility::ChronoElapsedTimer _duration;
     bool _finished = false;
 
+    bool _authSucceeded = false;
+    std::optional<FetchServerSettingsJob::Result> _settingsResult;
+
     ConnectionValidator::ValidationMode _mode = ConnectionValidator::ValidationMode::ValidateAuthAndUpdate;
 };
 }
@@ -47,8 +47,19 @@ void FetchServerSettingsJob::start()
     auto *job = new JsonApiJob(_account, QStringLiteral("ocs/v2.php/cloud/capabilities"), {}, {}, this);
     job->setAuthenticationJob(isAuthJob());
     job->setTimeout(fetchSettingsTimeout());
+    // the disk cache of the account revalidates the replies with their ETag and honours their Cache-Control
+    job->setStoreInCache(true);
+
+    // the user doesn't depend on the capabilities, request it at the same time
+    auto *userJob = new JsonApiJob(_account, QStringLiteral("ocs/v2.php/cloud/user"), SimpleNetworkJob::UrlQuery{}, QNetworkRequest{}, this);
+    userJob->setAuthenticationJob(isAuthJob());
+    userJob->setTimeout(fetchSettingsTimeout());
+    userJob->setStoreInCache(true);
 
     connect(job, &JsonApiJob::finishedSignal, this, [job, this] {
+        if (_finished) {
+            return;
+        }
         auto caps =
             job->data().value(QStringLiteral("ocs")).toObject().value(QStringLiteral("data")).toObject().value(QStringLiteral("capabilities")).toObject();
         qCInfo(lcfetchserversettings) << "Server capabilities" << caps;
@@ -56,7 +67,7 @@ void FetchServerSettingsJob::start()
             // Record that the server supports HTTP/2
             // Actual decision if we should use HTTP/2 is done in AccessManager::createRequest
             // TODO: http2 support is currently disabled in the client code
-            if (auto reply = job->reply()) {
+            if (auto reply = job->reply(); reply && !reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
                 _account->setHttp2Supported(reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool());
             }
             _account->setCapabilities({_account->url(), caps.toVariantMap()});
@@ -67,45 +78,63 @@ void FetchServerSettingsJob::start()
             case Account::ServerSupportLevel::Supported:
                 break;
             case Account::ServerSupportLevel::Unsupported:
-                Q_EMIT finishedSignal(Result::UnsupportedServer);
+                finish(Result::UnsupportedServer);
                 return;
             }
-            auto *userJob = new JsonApiJob(_account, QStringLiteral("ocs/v2.php/cloud/user"), SimpleNetworkJob::UrlQuery{}, QNetworkRequest{}, this);
-            userJob->setAuthenticationJob(isAuthJob());
-            userJob->setTimeout(fetchSettingsTimeout());
-            connect(userJob, &JsonApiJob::finishedSignal, this, [userJob, this] {
-                if (userJob->timedOut()) {
-                    Q_EMIT finishedSignal(Result::TimeOut);
-                } else if (userJob->httpStatusCode() == 401) {
-                    Q_EMIT finishedSignal(Result::InvalidCredentials);
-                } else if (userJob->ocsSuccess()) {
-                    const auto userData = userJob->data().value(QStringLiteral("ocs")).toObject().value(QStringLiteral("data")).toObject();
-                    const QString user = userData.value(QStringLiteral("id")).toString();
-                    if (!user.isEmpty()) {
-                        _account->setDavUser(user);
-                    }
-                    const QString displayName = userData.value(QStringLiteral("display-name")).toString();
-                    if (!displayName.isEmpty()) {
-                        _account->setDavDisplayName(displayName);
-                    }
-                    runAsyncUpdates();
-                    Q_EMIT finishedSignal(Result::Success);
-                } else {
-                    Q_EMIT finishedSignal(Result::Undefined);
-                }
-            });
-            userJob->start();
+            _capabilitiesFetched = true;
+            if (_userResult.has_value()) {
+                handleUser();
+            }
         } else {
             if (job->timedOut()) {
-                Q_EMIT finishedSignal(Result::TimeOut);
+                finish(Result::TimeOut);
             } else if (job->httpStatusCode() == 401) {
-                Q_EMIT finishedSignal(Result::InvalidCredentials);
+                finish(Result::InvalidCredentials);
             } else {
-                Q_EMIT finishedSignal(Result::Undefined);
+                finish(Result::Undefined);
             }
         }
     });
+    connect(userJob, &JsonApiJob::finishedSignal, this, [userJob, this] {
+        if (userJob->timedOut()) {
+            _userResult = Result::TimeOut;
+        } else if (userJob->httpStatusCode() == 401) {
+            _userResult = Result::InvalidCredentials;
+        } else if (userJob->ocsSuccess()) {
+            _userData = userJob->data().value(QStringLiteral("ocs")).toObject().value(QStringLiteral("data")).toObject();
+            _userResult = Result::Success;
+        } else {
+            _userResult = Result::Undefined;
+        }
+        if (_capabilitiesFetched && !_finished) {
+            handleUser();
+        }
+    });
     job->start();
+    userJob->start();
+}
+
+void FetchServerSettingsJob::handleUser()
+{
+    // the user is only applied once the capabilities confirmed the server is supported
+    if (_userResult == Result::Success) {
+        const QString user = _userData.value(QStringLiteral("id")).toString();
+        if (!user.isEmpty()) {
+            _account->setDavUser(user);
+        }
+        const QString displayName = _userData.value(QStringLiteral("display-name")).toString();
+        if (!displayName.isEmpty()) {
+            _account->setDavDisplayName(displayName);
+        }
+        runAsyncUpdates();
+    }
+    finish(_userResult.value());
+}
+
+void FetchServerSettingsJob::finish(Result result)
+{
+    _finished = true;
+    Q_EMIT finishedSignal(result);
 }
 
 void FetchServerSettingsJob::runAsyncUpdates()
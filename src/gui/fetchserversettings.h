@@ -16,8 +16,11 @@
 
 #include "libsync/accountfwd.h"
 
+#include <QJsonObject>
 #include <QObject>
 
+#include <optional>
+
 namespace OCC {
 class Capabilities;
 
@@ -35,12 +38,20 @@ Q_SIGNALS:
     void finishedSignal(Result);
 
 private:
+    void handleUser();
+    void finish(Result result);
     void runAsyncUpdates();
 
     // returns whether the started jobs should be excluded from the retry queue
     bool isAuthJob() const;
 
     const AccountPtr _account;
+
+    // the requests run at the same time, the user is handled once both finished
+    bool _capabilitiesFetched = false;
+    std::optional<Result> _userResult;
+    QJsonObject _userData;
+    bool _finished = false;
 };
 
 }
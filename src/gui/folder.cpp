@@ -31,8 +31,15 @@
 #include "folderman.h"
 #include "folderwatcher.h"
 #include "gui/accountsettings.h"
+#include "gui/hydrationprefetcher.h"
+#include "gui/hydrationrequests.h"
+#include "gui/startuptrace.h"
+#include "gui/vfscachemanager.h"
 #include "libsync/graphapi/spacesmanager.h"
+#include "libsync/logger.h"
 #include "localdiscoverytracker.h"
+#include "quotainfo.h"
+#include "scheduling/bandwidthschedule.h"
 #include "scheduling/syncscheduler.h"
 #include "settingsdialog.h"
 #include "socketapi/socketapi.h"
@@ -61,6 +68,13 @@ namespace {
  */
 constexpr int retrySyncLimitC = 3;
 
+// how often the listeners are sent the transfer progress, see pollProgress()
+constexpr auto progressPollIntervalC = 100ms;
+
+constexpr auto journalMaintenanceIntervalC = 1h;
+// the time a maintenance may delay a sync that is started meanwhile
+constexpr auto journalMaintenanceBudgetC = 1s;
+
 /*
  * [Accounts]
  * 1\Folders\4\version=2
@@ -95,6 +109,31 @@ auto priorityC()
 {
     return QStringLiteral("priority");
 }
+
+auto journalMmapSizeC()
+{
+    return QStringLiteral("journalMmapSize");
+}
+
+auto journalCacheSizeC()
+{
+    return QStringLiteral("journalCacheSize");
+}
+
+auto journalPageSizeC()
+{
+    return QStringLiteral("journalPageSize");
+}
+
+auto journalWalAutoCheckpointC()
+{
+    return QStringLiteral("journalWalAutoCheckpoint");
+}
+
+auto syncDirectionC()
+{
+    return QStringLiteral("syncDirection");
+}
 }
 
 namespace OCC {
@@ -111,6 +150,7 @@ Folder::Folder(const FolderDefinition &definition, const AccountStatePtr &accoun
     , _fileLog(new SyncRunFileLog)
     , _vfs(vfs.release())
 {
+    _journal.setPerformanceProfile(_definition.journalProfile);
     _timeSinceLastSyncStart.start();
     _timeSinceLastSyncDone.start();
 
@@ -122,28 +162,28 @@ Folder::Folder(const FolderDefinition &definition, const AccountStatePtr &accoun
     // check if the local path exists
     if (checkLocalPath()) {
         prepareFolder(path());
-        // those errors should not persist over sessions
-        _journal.wipeErrorBlacklistCategory(SyncJournalErrorBlacklistRecord::Category::LocalSoftError);
         _engine.reset(new SyncEngine(_accountState->account(), webDavUrl(), path(), remotePath(), &_journal));
         // pass the setting if hidden files are to be ignored, will be read in csync_update
         _engine->setIgnoreHiddenFiles(_definition.ignoreHiddenFiles);
 
-        if (!_engine->loadDefaultExcludes()) {
-            qCWarning(lcFolder, "Could not read system exclude file");
-        }
-
         connect(_accountState.data(), &AccountState::isConnectedChanged, this, &Folder::canSyncChanged);
 
         connect(_engine.data(), &SyncEngine::started, this, &Folder::slotSyncStarted, Qt::QueuedConnection);
         connect(_engine.data(), &SyncEngine::finished, this, &Folder::slotSyncFinished, Qt::QueuedConnection);
 
-        connect(_engine.data(), &SyncEngine::transmissionProgress, this,
-            [this](const ProgressInfo &pi) { Q_EMIT ProgressDispatcher::instance()->progressInfo(this, pi); });
-        connect(_engine.data(), &SyncEngine::itemCompleted, this, &Folder::slotItemCompleted);
+        connect(_engine.data(), &SyncEngine::transmissionProgress, this, &Folder::slotTransmissionProgress);
+        _progressPollTimer.setInterval(progressPollIntervalC);
+        connect(&_progressPollTimer, &QTimer::timeout, this, &Folder::pollProgress);
+        connect(_engine.data(), &SyncEngine::itemsCompleted, this, &Folder::slotItemsCompleted);
         connect(_engine.data(), &SyncEngine::seenLockedFile, FolderMan::instance(), &FolderMan::slotSyncOnceFileUnlocks);
         connect(_engine.data(), &SyncEngine::aboutToPropagate,
             this, &Folder::slotLogPropagationStart);
         connect(_engine.data(), &SyncEngine::syncError, this, &Folder::slotSyncError);
+        connect(_engine.data(), &SyncEngine::rootQuota, this, [this](const RemoteQuota &quota) {
+            if (!_accountState->supportsSpaces()) {
+                _accountState->quotaInfo()->updateFromListing(remotePath(), quota);
+            }
+        });
 
         connect(ProgressDispatcher::instance(), &ProgressDispatcher::folderConflicts,
             this, &Folder::slotFolderConflicts);
@@ -155,6 +195,10 @@ Folder::Folder(const FolderDefinition &definition, const AccountStatePtr &accoun
         connect(_engine.data(), &SyncEngine::itemCompleted,
             _localDiscoveryTracker.data(), &LocalDiscoveryTracker::slotItemCompleted);
 
+        _hydrationPrefetcher = new HydrationPrefetcher(this);
+        _hydrationRequests = new HydrationRequests(this);
+        _vfsCacheManager = new VfsCacheManager(this);
+
         connect(_accountState->account()->spacesManager(), &GraphApi::SpacesManager::spaceChanged, this, [this](GraphApi::Space *changedSpace) {
             if (_definition.spaceId() == changedSpace->id()) {
                 Q_EMIT spaceChanged();
@@ -163,8 +207,54 @@ Folder::Folder(const FolderDefinition &definition, const AccountStatePtr &accoun
 
         // Potentially upgrade suffix vfs to windows vfs
         OC_ENFORCE(_vfs);
-        // Initialize the vfs plugin. Do this after the UI is running, so we can show a dialog when something goes wrong.
-        QTimer::singleShot(0, this, &Folder::startVfs);
+        // The journal and the vfs plugin are initialized after the UI is running, one folder at a time,
+        // so we can show a dialog when something goes wrong and the UI stays responsive with many folders.
+        FolderMan::instance()->scheduleStartUp(this);
+    }
+}
+
+void Folder::startUp()
+{
+    if (!OC_ENSURE(_engine && !_startedUp)) {
+        return;
+    }
+    _startedUp = true;
+    const StartupTrace::Span span(QStringLiteral("Start folder"), {{QStringLiteral("path"), path()}});
+    if (!_engine->loadDefaultExcludes()) {
+        qCWarning(lcFolder, "Could not read system exclude file");
+    }
+    // Opening the journal migrates the journals of other client versions, which takes a while
+    // for large folders. Do it in the background so the other folders can start in the meantime.
+    connect(&_journal, &SyncJournalDb::upgradeProgress, this, &Folder::slotJournalUpgradeProgress);
+    _journal.runAsync(
+        this, [](SyncJournalDb *journal) { return journal->open(); },
+        [this](bool opened) {
+            disconnect(&_journal, &SyncJournalDb::upgradeProgress, this, &Folder::slotJournalUpgradeProgress);
+            if (!opened) {
+                const QString error = tr("%1 failed to open the database.").arg(_definition.localPath());
+                qCWarning(lcFolder) << error;
+                _syncResult.appendErrorString(error);
+                setSyncState(SyncResult::SetupError);
+                return;
+            }
+            if (_syncResult.status() == SyncResult::Upgrading) {
+                setSyncState(syncPaused() ? SyncResult::Paused : SyncResult::NotYetStarted);
+            }
+            // those errors should not persist over sessions
+            _journal.wipeErrorBlacklistCategory(SyncJournalErrorBlacklistRecord::Category::LocalSoftError);
+            startVfs();
+        });
+}
+
+void Folder::slotJournalUpgradeProgress(int step, int steps)
+{
+    _journalUpgradePercent = steps > 0 ? step * 100 / steps : 0;
+    if (_syncResult.status() == SyncResult::Upgrading) {
+        // setSyncState() only notifies about changes of the state
+        Q_EMIT syncStateChange();
+    } else {
+        qCInfo(lcFolder) << "Upgrading the database of" << path();
+        setSyncState(SyncResult::Upgrading);
     }
 }
 
@@ -227,9 +317,6 @@ bool Folder::checkLocalPath()
 
         if (error.isEmpty()) {
             qCDebug(lcFolder) << "Checked local path ok";
-            if (!_journal.open()) {
-                error = tr("%1 failed to open the database.").arg(_definition.localPath());
-            }
         }
     } else {
         // Check directory again
@@ -260,11 +347,19 @@ SyncOptions Folder::loadSyncOptions()
     opt._moveFilesToTrash = cfgFile.moveToTrash();
     opt._vfs = _vfs;
     opt._parallelNetworkJobs = _accountState->account()->isHttp2Supported() ? 20 : 6;
+    opt._parallelDiscoveryJobs = opt._parallelNetworkJobs;
 
     opt._initialChunkSize = cfgFile.chunkSize();
     opt._minChunkSize = cfgFile.minChunkSize();
     opt._maxChunkSize = cfgFile.maxChunkSize();
     opt._targetChunkUploadDuration = cfgFile.targetChunkUploadDuration();
+    if (cfgFile.adaptiveTransferConcurrency()) {
+        opt._transferConcurrencyMode = SyncOptions::TransferConcurrencyMode::Adaptive;
+    }
+    if (const auto propagationOrder = SyncOptions::propagationOrderFromName(cfgFile.propagationOrder())) {
+        opt._propagationOrder = *propagationOrder;
+    }
+    opt._syncDirection = _definition.syncDirection;
 
     opt.fillFromEnvironmentVariables();
     opt.verifyChunkSizes();
@@ -369,6 +464,63 @@ bool Folder::isSyncRunning() const
     return !hasSetupError() && _engine->isSyncRunning();
 }
 
+qint64 Folder::remoteQuotaAvailable() const
+{
+    if (_accountState->supportsSpaces()) {
+        // the spaces are refreshed regularly, with their quota
+        if (auto *space = this->space()) {
+            const auto quota = space->drive().getQuota();
+            if (quota.isValid() && quota.getTotal() > 0) {
+                return std::max<qint64>(0, quota.getTotal() - quota.getUsed());
+            }
+        }
+        return -1;
+    }
+    return _accountState->quotaInfo()->freshQuotaAvailableBytes();
+}
+
+void Folder::slotTransmissionProgress(const ProgressInfo &progress)
+{
+    // The transfers report their progress every few kilobytes, much more often than the
+    // listeners can show it. That progress is picked up by pollProgress(), status changes
+    // and completed items are forwarded right away.
+    if (progress.status() == ProgressInfo::Propagation) {
+        if (progress._lastCompletedItem.isEmpty()) {
+            if (!_progressPollTimer.isActive()) {
+                _progressPollTimer.start();
+            }
+            return;
+        }
+    } else {
+        _progressPollTimer.stop();
+    }
+    _publishedProgressGeneration = progress.generation();
+    Q_EMIT ProgressDispatcher::instance()->progressInfo(this, progress);
+}
+
+void Folder::pollProgress()
+{
+    if (!_engine || !_engine->isSyncRunning()) {
+        _progressPollTimer.stop();
+        return;
+    }
+    const auto &progress = _engine->progressInfo();
+    if (progress.generation() != _publishedProgressGeneration) {
+        _publishedProgressGeneration = progress.generation();
+        Q_EMIT ProgressDispatcher::instance()->progressInfo(this, progress);
+    }
+}
+
+void Folder::runJournalMaintenance()
+{
+    if (hasSetupError() || isSyncRunning()
+        || (_timeSinceLastJournalMaintenance.isValid() && std::chrono::milliseconds(_timeSinceLastJournalMaintenance.elapsed()) < journalMaintenanceIntervalC)) {
+        return;
+    }
+    _timeSinceLastJournalMaintenance.start();
+    _journal.runAsync(this, [](SyncJournalDb *journal) { journal->runMaintenance(journalMaintenanceBudgetC); }, [] {});
+}
+
 QString Folder::remotePath() const
 {
     return _definition.targetPath();
@@ -608,7 +760,8 @@ void Folder::startVfs()
         _vfsIsReady = false;
     });
 
-    slotNextSyncFullLocalDiscovery();
+    // unless the folder watcher can replay the changes since the last sync
+    _timeSinceLastFullLocalDiscovery.invalidate();
     _vfs->start(vfsParams);
 }
 
@@ -616,9 +769,7 @@ void Folder::slotDiscardDownloadProgress()
 {
     // Delete from journal and from filesystem.
     QDir folderpath(_definition.localPath());
-    QSet<QString> keep_nothing;
-    const QVector<SyncJournalDb::DownloadInfo> deleted_infos =
-        _journal.getAndDeleteStaleDownloadInfos(keep_nothing);
+    const QVector<SyncJournalDb::DownloadInfo> deleted_infos = _journal.getAndDeleteStaleDownloadInfos({});
     for (const auto &deleted_info : deleted_infos) {
         const QString tmppath = folderpath.filePath(deleted_info._tmpfile);
         qCInfo(lcFolder) << "Deleting temporary file: " << tmppath;
@@ -694,12 +845,18 @@ void Folder::slotWatchedPathsChanged(const QSet<QString> &paths, ChangeReason re
         needSync = true;
     }
     if (needSync && canSync()) {
-        FolderMan::instance()->scheduler()->enqueueFolder(this);
+        // the user just saved a file, sync it before the folders that are only polled
+        FolderMan::instance()->scheduler()->enqueueFolder(this, SyncScheduler::Priority::Medium);
     }
 }
 
 void Folder::implicitlyHydrateFile(const QString &relativepath)
 {
+    if (_hydrationRequests && _hydrationRequests->isPending(relativepath)) {
+        // an other application opened the file as well, it waits for the same hydration
+        _hydrationRequests->add(relativepath);
+        return;
+    }
     qCInfo(lcFolder) << "Implicitly hydrate virtual file:" << relativepath;
 
     // Set in the database that we should download the file
@@ -725,7 +882,54 @@ void Folder::implicitlyHydrateFile(const QString &relativepath)
 
     // Add to local discovery
     schedulePathForLocalDiscovery(relativepath);
-    FolderMan::instance()->scheduler()->enqueueFolder(this);
+    prioritizePath(relativepath);
+    if (_hydrationRequests) {
+        _hydrationRequests->add(relativepath);
+    } else {
+        FolderMan::instance()->scheduler()->enqueueFolder(this, SyncScheduler::Priority::Medium);
+    }
+
+    if (_hydrationPrefetcher) {
+        _hydrationPrefetcher->fileRequested(relativepath);
+    }
+    if (_vfsCacheManager) {
+        _vfsCacheManager->fileUsed(_vfs->underlyingFileName(relativepath));
+    }
+}
+
+void Folder::prioritizePath(const QString &relativePath)
+{
+    _priorityPaths.insert(relativePath);
+}
+
+bool Folder::setSelectiveSyncBlackList(const QSet<QString> &blackList)
+{
+    bool ok = false;
+    const auto oldBlackList = _journal.getSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, &ok);
+    _journal.setSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, blackList);
+    if (!ok) {
+        return false;
+    }
+    // the entries end with a slash
+    const auto isExcluded = [&blackList](const QString &path) {
+        return std::any_of(blackList.cbegin(), blackList.cend(), [&path](const QString &entry) { return path.startsWith(entry); });
+    };
+    if (std::any_of(blackList.cbegin(), blackList.cend(), [&oldBlackList](const QString &entry) {
+            return std::none_of(oldBlackList.cbegin(), oldBlackList.cend(), [&entry](const QString &oldEntry) { return entry.startsWith(oldEntry); });
+        })) {
+        return false;
+    }
+    for (const auto &entry : oldBlackList) {
+        if (isExcluded(entry)) {
+            continue;
+        }
+        const QString path = entry.chopped(1);
+        qCInfo(lcFolder) << "Syncing" << path << "again";
+        _journal.schedulePathForRemoteDiscovery(path);
+        schedulePathForLocalDiscovery(path);
+        prioritizePath(path);
+    }
+    return true;
 }
 
 void Folder::setVirtualFilesEnabled(bool enabled)
@@ -955,13 +1159,19 @@ void Folder::startSync()
     // get the latest touched files
     // this will enque this folder again, it doesn't matter
     slotWatchedPathsChanged(_folderWatcher->popChangeSet(), Folder::ChangeReason::Other);
+    _journalPositionAtSyncStart = _folderWatcher->journalPosition();
 
     const std::chrono::milliseconds fullLocalDiscoveryInterval = ConfigFile().fullLocalDiscoveryInterval();
     const bool hasDoneFullLocalDiscovery = _timeSinceLastFullLocalDiscovery.isValid();
     // negative fullLocalDiscoveryInterval means we don't require periodic full runs
     const bool periodicFullLocalDiscoveryNow =
         fullLocalDiscoveryInterval.count() >= 0 && _timeSinceLastFullLocalDiscovery.hasExpired(fullLocalDiscoveryInterval.count());
-    if (_folderWatcher && _folderWatcher->isReliable()
+    if (_localDiscoveryTracker->preferFullDiscovery()) {
+        // e.g. after a checkout of another branch, listing everything is cheaper than looking up each path
+        qCInfo(lcFolder) << "Too many paths to rediscover locally" << _localDiscoveryTracker->localDiscoveryPaths().size() << ", forbidding local discovery to read from the database";
+        _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemOnly);
+        _localDiscoveryTracker->startSyncFullDiscovery();
+    } else if (_folderWatcher && _folderWatcher->isReliable()
         && hasDoneFullLocalDiscovery
         && !periodicFullLocalDiscoveryNow) {
         qCInfo(lcFolder) << "Allowing local discovery to read from the database";
@@ -969,6 +1179,10 @@ void Folder::startSync()
             LocalDiscoveryStyle::DatabaseAndFilesystem,
             _localDiscoveryTracker->localDiscoveryPaths());
         _localDiscoveryTracker->startSyncPartialDiscovery();
+    } else if (_engine->syncOptions()._skipUnchangedLocalFolders && hasDoneFullLocalDiscovery && !periodicFullLocalDiscoveryNow) {
+        // the tracked paths are kept for the next partial or full discovery
+        qCInfo(lcFolder) << "Allowing local discovery to read unchanged folders from the database";
+        _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemUnlessUnchanged);
     } else {
         qCInfo(lcFolder) << "Forbidding local discovery to read from the database";
         _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemOnly);
@@ -976,6 +1190,12 @@ void Folder::startSync()
     }
 
     _engine->setIgnoreHiddenFiles(_definition.ignoreHiddenFiles);
+    _engine->setRemoteQuotaAvailable(remoteQuotaAvailable());
+    // the timeline goes with the debug logs
+    const auto *logger = Logger::instance();
+    const QString logDir = logger->logDebug() ? logger->logDir() : QString();
+    _engine->setTimelinePath(logDir.isEmpty() ? QString() : QDir(logDir).filePath(QStringLiteral("%1_sync_timeline.json").arg(QString::fromUtf8(id()))));
+    _engine->setPriorityPaths(std::exchange(_priorityPaths, {}));
     QMetaObject::invokeMethod(_engine.data(), &SyncEngine::startSync, Qt::QueuedConnection);
 
     Q_EMIT syncStarted();
@@ -984,24 +1204,8 @@ void Folder::startSync()
 void Folder::setDirtyNetworkLimits()
 {
     Q_ASSERT(isReady());
-    ConfigFile cfg;
-    int downloadLimit = -75; // 75%
-    int useDownLimit = cfg.useDownloadLimit();
-    if (useDownLimit >= 1) {
-        downloadLimit = cfg.downloadLimit() * 1000;
-    } else if (useDownLimit == 0) {
-        downloadLimit = 0;
-    }
-
-    int uploadLimit = -75; // 75%
-    int useUpLimit = cfg.useUploadLimit();
-    if (useUpLimit >= 1) {
-        uploadLimit = cfg.uploadLimit() * 1000;
-    } else if (useUpLimit == 0) {
-        uploadLimit = 0;
-    }
-
-    _engine->setNetworkLimits(uploadLimit, downloadLimit);
+    const auto limits = FolderMan::instance()->bandwidthSchedule()->currentLimits();
+    _engine->setNetworkLimits(limits.upload, limits.download);
 }
 
 void Folder::reloadSyncOptions()
@@ -1065,6 +1269,12 @@ void Folder::slotSyncFinished(bool success)
     if (syncStatus == SyncResult::Success && success) {
         // Clear the white list as all the folders that should be on that list are sync-ed
         journalDb()->setSelectiveSyncList(SyncJournalDb::SelectiveSyncWhiteList, {});
+
+        // all local changes up to the start of the sync are synced, after a restart
+        // the folder watcher only needs to report what changed since then
+        if (!_journalPositionAtSyncStart.isEmpty()) {
+            journalDb()->setChangeJournalPosition(_journalPositionAtSyncStart);
+        }
     }
 
     if ((syncStatus == SyncResult::Success || syncStatus == SyncResult::Problem) && success) {
@@ -1080,6 +1290,14 @@ void Folder::slotSyncFinished(bool success)
     // syncStateChange from setSyncState needs to be emitted first
     QTimer::singleShot(0, this, [this] { Q_EMIT syncFinished(_syncResult); });
 
+    // Checkpoint while no sync is running, the auto checkpoints during the
+    // next sync then have less to do
+    QTimer::singleShot(0, this, [this] {
+        if (isReady() && !isSyncRunning()) {
+            _journal.runAsync(this, [](SyncJournalDb *journal) { journal->walCheckpoint(); }, [] {});
+        }
+    });
+
     _lastSyncDuration = std::chrono::milliseconds(_timeSinceLastSyncStart.elapsed());
     _timeSinceLastSyncDone.start();
 
@@ -1102,18 +1320,25 @@ void Folder::slotSyncFinished(bool success)
     }
 }
 
-// a item is completed: count the errors and forward to the ProgressDispatcher
-void Folder::slotItemCompleted(const SyncFileItemPtr &item)
+// items are completed: count the errors and forward to the ProgressDispatcher
+void Folder::slotItemsCompleted(const QVector<SyncFileItemPtr> &items)
 {
-    if (item->_status == SyncFileItem::Success && (item->instruction() & (CSYNC_INSTRUCTION_NONE | CSYNC_INSTRUCTION_UPDATE_METADATA))) {
-        // We only care about the updates that deserve to be shown in the UI
-        return;
-    }
+    QVector<SyncFileItemPtr> shown;
+    shown.reserve(items.size());
+    for (const auto &item : items) {
+        if (item->_status == SyncFileItem::Success && (item->instruction() & (CSYNC_INSTRUCTION_NONE | CSYNC_INSTRUCTION_UPDATE_METADATA))) {
+            // We only care about the updates that deserve to be shown in the UI
+            continue;
+        }
 
-    _syncResult.processCompletedItem(item);
+        _syncResult.processCompletedItem(item);
 
-    _fileLog->logItem(*item);
-    Q_EMIT ProgressDispatcher::instance()->itemCompleted(this, item);
+        _fileLog->logItem(*item);
+        shown.append(item);
+    }
+    if (!shown.isEmpty()) {
+        Q_EMIT ProgressDispatcher::instance()->itemsCompleted(this, shown);
+    }
 }
 
 void Folder::slotLogPropagationStart()
@@ -1124,6 +1349,8 @@ void Folder::slotLogPropagationStart()
 void Folder::slotNextSyncFullLocalDiscovery()
 {
     _timeSinceLastFullLocalDiscovery.invalidate();
+    // a restart before the next sync must not skip the full discovery either
+    _journal.setChangeJournalPosition({});
 }
 
 void Folder::schedulePathForLocalDiscovery(const QString &relativePath)
@@ -1207,7 +1434,15 @@ void Folder::registerFolderWatcher()
         this, &Folder::slotNextSyncFullLocalDiscovery);
     connect(_folderWatcher.data(), &FolderWatcher::becameUnreliable,
         this, &Folder::slotWatcherUnreliable);
-    _folderWatcher->init(path());
+    connect(_folderWatcher.data(), &FolderWatcher::journalReplayed, this, [this] {
+        // The changes since the last successful sync are known,
+        // the database is as good as after a full local discovery
+        if (!_timeSinceLastFullLocalDiscovery.isValid()) {
+            qCInfo(lcFolder) << "Local changes since the last sync were replayed, no full local discovery needed";
+            _timeSinceLastFullLocalDiscovery.start();
+        }
+    });
+    _folderWatcher->init(path(), _journal.changeJournalPosition());
     _folderWatcher->startNotificatonTest(path() + QLatin1String(".owncloudsync.log"));
 }
 
@@ -1251,6 +1486,20 @@ void FolderDefinition::save(QSettings &settings, const FolderDefinition &folder)
 
     settings.setValue(QStringLiteral("virtualFilesMode"), Utility::enumToString(folder.virtualFilesMode));
 
+    // only written if set, they are meant to be configured by the admin
+    const auto saveProfileValue = [&settings](const QString &key, qint64 value) {
+        if (value > 0) {
+            settings.setValue(key, value);
+        }
+    };
+    saveProfileValue(journalMmapSizeC(), folder.journalProfile.mmapSize);
+    saveProfileValue(journalCacheSizeC(), folder.journalProfile.cacheSize);
+    saveProfileValue(journalPageSizeC(), folder.journalProfile.pageSize);
+    saveProfileValue(journalWalAutoCheckpointC(), folder.journalProfile.walAutoCheckpoint);
+    if (folder.syncDirection != SyncOptions::SyncDirection::Bidirectional) {
+        settings.setValue(syncDirectionC(), SyncOptions::syncDirectionName(folder.syncDirection));
+    }
+
     // Prevent loading of profiles in old clients
     settings.setValue(versionC(), ConfigFile::UnusedLegacySettingsVersionNumber);
 }
@@ -1266,6 +1515,19 @@ FolderDefinition FolderDefinition::load(QSettings &settings, const QByteArray &i
     folder._deployed = settings.value(deployedC(), false).toBool();
     folder._priority = settings.value(priorityC(), 0).toUInt();
 
+    folder.journalProfile.mmapSize = settings.value(journalMmapSizeC(), 0).toLongLong();
+    folder.journalProfile.cacheSize = settings.value(journalCacheSizeC(), 0).toLongLong();
+    folder.journalProfile.pageSize = settings.value(journalPageSizeC(), 0).toInt();
+    folder.journalProfile.walAutoCheckpoint = settings.value(journalWalAutoCheckpointC(), 0).toInt();
+    const QString syncDirection = settings.value(syncDirectionC()).toString();
+    if (!syncDirection.isEmpty()) {
+        if (const auto direction = SyncOptions::syncDirectionFromName(syncDirection)) {
+            folder.syncDirection = *direction;
+        } else {
+            qCWarning(lcFolder) << "Unknown syncDirection:" << syncDirection << "assuming 'both'";
+        }
+    }
+
     folder.virtualFilesMode = Vfs::Off;
     QString vfsModeString = settings.value(QStringLiteral("virtualFilesMode")).toString();
     if (!vfsModeString.isEmpty()) {
@@ -28,6 +28,8 @@
 
 #include <QDateTime>
 #include <QObject>
+#include <QPointer>
+#include <QSet>
 #include <QUuid>
 #include <QtQml/QtQml>
 
@@ -45,6 +47,9 @@ class SyncEngine;
 class SyncRunFileLog;
 class FolderWatcher;
 class LocalDiscoveryTracker;
+class HydrationPrefetcher;
+class HydrationRequests;
+class VfsCacheManager;
 
 /**
  * @brief The FolderDefinition class
@@ -71,6 +76,12 @@ public:
     /// Whether the vfs mode shall silently be updated if possible
     bool upgradeVfsMode = false;
 
+    /// SQLite tuning of the journal, the defaults are fine unless the folder is huge
+    SyncJournalDb::PerformanceProfile journalProfile;
+
+    /// Which changes the folder syncs, e.g. only the local ones for a backup
+    SyncOptions::SyncDirection syncDirection = SyncOptions::SyncDirection::Bidirectional;
+
     /// Saves the folder definition into the current settings group.
     static void save(QSettings &settings, const FolderDefinition &folder);
 
@@ -230,6 +241,14 @@ public:
      */
     bool isReady() const;
 
+    /**
+     * Opens the journal in the background and starts the vfs, called by the FolderMan after the construction
+     */
+    void startUp();
+
+    /** How far the migration of the journal is, while the state is SyncResult::Upgrading */
+    int journalUpgradePercent() const { return _journalUpgradePercent; }
+
     bool hasSetupError() const
     {
         return _syncResult.status() == SyncResult::SetupError;
@@ -240,6 +259,12 @@ public:
     /** True if the folder is currently synchronizing */
     bool isSyncRunning() const;
 
+    /** Vacuum and optimize the journal, at most once an hour
+     *
+     * Called by the SyncScheduler while no sync is running.
+     */
+    void runJournalMaintenance();
+
     /**
      * return the last sync result with error message and status
      */
@@ -400,9 +425,17 @@ public Q_SLOTS:
      * relativepath is the folder-relative path to the file (including the extension)
      *
      * Note, passing directories is not supported. Files only.
+     *
+     * A file that already waits for its hydration is not requested again, see HydrationRequests.
      */
     void implicitlyHydrateFile(const QString &relativepath);
 
+    /** Propagate \a relativePath, a file or directory, before the other items of the next sync
+     *
+     * For files the user is waiting for, see OwncloudPropagator::setPriorityPaths().
+     */
+    void prioritizePath(const QString &relativePath);
+
     /** Ensures that the next sync performs a full local discovery. */
     void slotNextSyncFullLocalDiscovery();
 
@@ -417,6 +450,15 @@ public Q_SLOTS:
     /// Reloads the excludes, used when changing the user-defined excludes after saving them to disk.
     bool reloadExcludes();
 
+    /** Replaces the selective sync black list
+     *
+     * The folders that are synced again are scheduled for the remote and the local
+     * discovery and are propagated first, so the next sync doesn't need a full local
+     * discovery to download them. Returns false if folders were excluded, their local
+     * copies are only removed by a full local discovery.
+     */
+    bool setSelectiveSyncBlackList(const QSet<QString> &blackList);
+
 private Q_SLOTS:
     void slotSyncStarted();
     void slotSyncFinished(bool);
@@ -425,7 +467,13 @@ private Q_SLOTS:
      */
     void slotSyncError(const QString &message, ErrorCategory category = ErrorCategory::Normal);
 
-    void slotItemCompleted(const SyncFileItemPtr &);
+    void slotItemsCompleted(const QVector<SyncFileItemPtr> &items);
+
+    /** Forwards status changes and completed items to the ProgressDispatcher */
+    void slotTransmissionProgress(const ProgressInfo &progress);
+
+    /** Forwards the engine's progress to the ProgressDispatcher if it changed since it was last sent */
+    void pollProgress();
 
     void slotLogPropagationStart();
 
@@ -442,6 +490,9 @@ private Q_SLOTS:
     /** Warn users about an unreliable folder watcher */
     void slotWatcherUnreliable(const QString &message);
 
+    /** Shows the migration of the journal, see SyncJournalDb::upgradeProgress() */
+    void slotJournalUpgradeProgress(int step, int steps);
+
 private:
     void showSyncResultPopup();
 
@@ -449,6 +500,9 @@ private:
 
     SyncOptions loadSyncOptions();
 
+    /** The bytes the uploads may add on the server, negative if that is unknown, see SyncEngine::setRemoteQuotaAvailable() */
+    qint64 remoteQuotaAvailable() const;
+
     /**
      * Sets up this folder's folderWatcher if possible.
      *
@@ -480,8 +534,13 @@ private:
     QElapsedTimer _timeSinceLastSyncDone;
     QElapsedTimer _timeSinceLastSyncStart;
     QElapsedTimer _timeSinceLastFullLocalDiscovery;
+    QElapsedTimer _timeSinceLastJournalMaintenance;
     std::chrono::milliseconds _lastSyncDuration = {};
 
+    /// The FolderWatcher::journalPosition() when the current sync started,
+    /// stored in the journal once the sync succeeded
+    QByteArray _journalPositionAtSyncStart;
+
     /// The number of syncs that failed in a row.
     /// Reset when a sync is successful.
     int _consecutiveFailingSyncs = 0;
@@ -496,10 +555,17 @@ private:
 
     QTimer _scheduleSelfTimer;
 
+    // polls the transfer progress while propagating, see pollProgress()
+    QTimer _progressPollTimer;
+    quint64 _publishedProgressGeneration = 0;
+
     /**
      * Setting up vfs is a async operation
      */
     bool _vfsIsReady = false;
+    bool _startedUp = false;
+    // see journalUpgradePercent()
+    int _journalUpgradePercent = 0;
 
     /**
      * Watches this folder's local directory for changes.
@@ -513,11 +579,30 @@ private:
      */
     QScopedPointer<LocalDiscoveryTracker> _localDiscoveryTracker;
 
+    /**
+     * Hydrates the files that are likely to be opened after an implicitly hydrated one.
+     */
+    QPointer<HydrationPrefetcher> _hydrationPrefetcher;
+
+    /**
+     * Dedups the implicit hydrations and schedules the sync for a burst of them at once.
+     */
+    QPointer<HydrationRequests> _hydrationRequests;
+
+    // the paths handed to the next sync, see prioritizePath()
+    QSet<QString> _priorityPaths;
+
+    /**
+     * Dehydrates the least recently used files when the hydrated files exceed a quota.
+     */
+    QPointer<VfsCacheManager> _vfsCacheManager;
+
     /**
      * The vfs mode instance (created by plugin) to use. Never null.
      */
     QSharedPointer<Vfs> _vfs;
 
+    friend class FolderMan;
     friend class SpaceMigration;
 };
 }
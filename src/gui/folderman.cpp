@@ -18,12 +18,15 @@
 #include "accountmanager.h"
 #include "accountstate.h"
 #include "common/asserts.h"
+#include "common/syncjournalfilerecord.h"
 #include "configfile.h"
 #include "folder.h"
 #include "gui/networkinformation.h"
+#include "gui/startuptrace.h"
 #include "guiutility.h"
 #include "libsync/syncengine.h"
 #include "lockwatcher.h"
+#include "scheduling/bandwidthschedule.h"
 #include "scheduling/syncscheduler.h"
 #include "socketapi/socketapi.h"
 #include "syncresult.h"
@@ -36,6 +39,7 @@
 #include <QMessageBox>
 #include <QMutableSetIterator>
 #include <QNetworkProxy>
+#include <QSaveFile>
 #include <QtCore>
 
 using namespace std::chrono;
@@ -58,11 +62,19 @@ QString makeLegacyDbName(const OCC::FolderDefinition &def, const OCC::AccountPtr
     const QString key = QStringLiteral("%1@%2:%3").arg(account->credentials()->user(), legacyUrl.toString(), def.targetPath());
     return OCC::SyncJournalDb::makeDbName(def.localPath(), QString::fromUtf8(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).left(6).toHex()));
 }
+
+// the number of files compared with their records before a folder is moved with its journal
+constexpr int rerootSampleSizeC = 100;
 }
 
 namespace OCC {
 Q_LOGGING_CATEGORY(lcFolderMan, "gui.folder.manager", QtInfoMsg)
 
+TrayOverallStatusResult::TrayOverallStatusResult()
+    : _networkPaused(NetworkInformation::instance()->isBehindCaptivePortal() || NetworkInformation::instance()->isMetered())
+{
+}
+
 void TrayOverallStatusResult::addResult(Folder *f)
 {
     _overallStatus._numNewConflictItems += f->syncResult()._numNewConflictItems;
@@ -74,9 +86,7 @@ void TrayOverallStatusResult::addResult(Folder *f)
         lastSyncDone = time;
     }
 
-    auto status = f->syncPaused() || NetworkInformation::instance()->isBehindCaptivePortal() || NetworkInformation::instance()->isMetered()
-        ? SyncResult::Paused
-        : f->syncResult().status();
+    auto status = f->syncPaused() || _networkPaused ? SyncResult::Paused : f->syncResult().status();
     if (status == SyncResult::Undefined) {
         status = SyncResult::Problem;
     }
@@ -95,10 +105,12 @@ FolderMan *FolderMan::_instance = nullptr;
 FolderMan::FolderMan()
     : _lockWatcher(new LockWatcher)
     , _scheduler(new SyncScheduler(this))
+    , _bandwidthSchedule(new BandwidthSchedule(this))
     , _socketApi(new SocketApi)
 {
     connect(AccountManager::instance(), &AccountManager::accountRemoved,
         this, &FolderMan::slotRemoveFoldersForAccount);
+    connect(_bandwidthSchedule, &BandwidthSchedule::limitsChanged, this, &FolderMan::setDirtyNetworkLimits);
 
     connect(_lockWatcher.data(), &LockWatcher::fileUnlocked, this, [this](const QString &path, FileSystem::LockMode) {
         if (Folder *f = folderForPath(path)) {
@@ -106,6 +118,26 @@ FolderMan::FolderMan()
             f->slotWatchedPathsChanged({path}, Folder::ChangeReason::UnLock);
         }
     });
+
+    _startUpTimer.setInterval(0);
+    connect(&_startUpTimer, &QTimer::timeout, this, [this] {
+        while (!_pendingStartUps.isEmpty()) {
+            if (auto folder = _pendingStartUps.dequeue()) {
+                folder->startUp();
+                break;
+            }
+        }
+        if (_pendingStartUps.isEmpty()) {
+            _startUpTimer.stop();
+            StartupTrace::instance().finish();
+        }
+    });
+}
+
+void FolderMan::scheduleStartUp(Folder *folder)
+{
+    _pendingStartUps.enqueue(folder);
+    _startUpTimer.start();
 }
 
 FolderMan *FolderMan::instance()
@@ -131,6 +163,7 @@ void FolderMan::unloadFolder(Folder *f)
     Q_ASSERT(f);
 
     _folders.removeAll(f);
+    _pendingStartUps.removeAll(f);
     _socketApi->slotUnregisterPath(f);
 
 
@@ -147,6 +180,8 @@ void FolderMan::unloadFolder(Folder *f)
 void FolderMan::unloadAndDeleteAllFolders()
 {
     // clear the list of existing folders.
+    _pendingStartUps.clear();
+    _startUpTimer.stop();
     const auto folders = std::move(_folders);
     for (auto *folder : folders) {
         folder->saveToSettings();
@@ -221,6 +256,7 @@ bool FolderMan::setupFoldersHelper(QSettings &settings, AccountStatePtr account)
 {
     const auto &childGroups = settings.childGroups();
     for (const auto &folderAlias : childGroups) {
+        const StartupTrace::Span span(QStringLiteral("Set up folder"), {{QStringLiteral("alias"), folderAlias}});
         settings.beginGroup(folderAlias);
         FolderDefinition folderDefinition = FolderDefinition::load(settings, folderAlias.toUtf8());
         const auto defaultJournalPath = [&account, folderDefinition] {
@@ -495,6 +531,27 @@ void FolderMan::slotFolderSyncFinished(const SyncResult &)
 
     qCInfo(lcFolderMan) << "<========== Sync finished for folder [" << f->shortGuiLocalPath() << "] of account ["
                         << f->accountState()->account()->displayNameWithHost() << "] with remote [" << f->remoteUrl().toDisplayString() << "]";
+
+    writeSyncMetrics();
+}
+
+void FolderMan::writeSyncMetrics() const
+{
+    static const QString path = qEnvironmentVariable("OWNCLOUD_SYNC_METRICS_FILE");
+    if (path.isEmpty()) {
+        return;
+    }
+    QMap<QString, SyncMetrics> metrics;
+    for (auto *folder : std::as_const(_folders)) {
+        if (folder->isReady() && folder->syncEngine().lastSyncMetrics().isValid()) {
+            metrics.insert(folder->path(), folder->syncEngine().lastSyncMetrics());
+        }
+    }
+    // replace the file in one go, so the collector never reads a partial file
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(SyncMetrics::toPrometheus(metrics)) == -1 || !file.commit()) {
+        qCWarning(lcFolderMan) << "Failed to write the sync metrics to" << path << file.errorString();
+    }
 }
 
 Folder *FolderMan::addFolder(const AccountStatePtr &accountState, const FolderDefinition &folderDefinition)
@@ -635,6 +692,136 @@ void FolderMan::removeFolder(Folder *f)
     Q_EMIT folderListChanged();
 }
 
+Result<Folder *, QString> FolderMan::rerootFolder(Folder *f, const QString &localPath, const QString &targetPath)
+{
+    if (!OC_ENSURE(f)) {
+        return QString();
+    }
+    if (f->isSyncRunning()) {
+        return tr("The folder can't be moved while it is syncing.");
+    }
+    if (f->virtualFilesEnabled()) {
+        // the placeholders are registered with the old root
+        return tr("Folders with virtual files can't be moved.");
+    }
+
+    FolderDefinition definition = f->_definition;
+    definition.setLocalPath(localPath);
+    definition.setTargetPath(targetPath);
+
+    // The journal records of the new root are the ones below `from` with `from` replaced by `to`
+    auto relativeTo = [](const QString &parent, const QString &child) -> std::optional<QString> {
+        if (child == parent) {
+            return QString();
+        }
+        if (parent == QLatin1String("/")) {
+            return child.mid(1);
+        }
+        if (child.startsWith(parent + QLatin1Char('/'))) {
+            return child.mid(parent.size() + 1);
+        }
+        return {};
+    };
+    QString from;
+    QString to;
+    if (const auto sub = relativeTo(f->_definition.targetPath(), definition.targetPath())) {
+        from = *sub;
+    } else if (const auto parent = relativeTo(definition.targetPath(), f->_definition.targetPath())) {
+        to = *parent;
+    } else {
+        return tr("The new folder on the server must be the old one, one of its subfolders or one of its parents.");
+    }
+
+    QString oldJournal = f->journalDb()->databaseFilePath();
+    if (!QFile::exists(oldJournal) && from.isEmpty() && to.isEmpty()) {
+        // the local folder was moved including its journal
+        oldJournal = QDir(definition.localPath()).filePath(f->_definition.journalPath);
+    }
+    if (!QFile::exists(oldJournal)) {
+        return tr("The sync journal of the folder was not found.");
+    }
+
+    // A cheap check that the new location holds the synced files, a mistake here would
+    // propagate the missing files as deletions to the server
+    const QString fromPrefix = from.isEmpty() ? QString() : from + QLatin1Char('/');
+    const QString toPrefix = to.isEmpty() ? QString() : to + QLatin1Char('/');
+    int sampled = 0;
+    int unchanged = 0;
+    f->journalDb()->getFileRecordsSample(from.toUtf8(), rerootSampleSizeC, [&](const SyncJournalFileRecord &record) {
+        const QString path = toPrefix + QString::fromUtf8(record._path).mid(fromPrefix.size());
+        ++sampled;
+        if (!FileSystem::fileChanged(QFileInfo(QDir(definition.localPath()).filePath(path)), record._fileSize, record._modtime)) {
+            ++unchanged;
+        }
+    });
+    // files changed since the last sync are fine, as long as they are few
+    if (unchanged * 10 < sampled * 9) {
+        qCWarning(lcFolderMan) << "Not moving" << f->path() << "to" << definition.localPath() << "only" << unchanged << "of" << sampled
+                               << "sampled files match the journal";
+        return tr("The files in %1 don't match the synced files of the folder.").arg(QDir::toNativeSeparators(definition.localPath()));
+    }
+
+    const QString newJournal = definition.absoluteJournalPath();
+    if (QFileInfo(newJournal) != QFileInfo(oldJournal) && !ensureJournalGone(newJournal)) {
+        return tr("An old sync journal could not be removed from %1.").arg(QDir::toNativeSeparators(definition.localPath()));
+    }
+
+    auto vfs = VfsPluginManager::instance().createVfsFromPlugin(definition.virtualFilesMode);
+    if (!vfs) {
+        return tr("Could not load the plugin for the virtual files mode of the folder.");
+    }
+    const auto accountState = f->accountState();
+
+    qCInfo(lcFolderMan) << "Moving" << f->path() << f->remotePath() << "to" << definition.localPath() << definition.targetPath();
+    const FolderDefinition oldDefinition = f->_definition;
+    // loads the old folder again with its journal
+    auto restore = [&](const QString &error) -> Result<Folder *, QString> {
+        auto folder = addFolderInternal(oldDefinition, accountState, VfsPluginManager::instance().createVfsFromPlugin(oldDefinition.virtualFilesMode));
+        Q_EMIT folderSyncStateChange(folder);
+        Q_EMIT folderListChanged();
+        return error;
+    };
+    unloadFolder(f);
+    const bool journalMovedAway = QFileInfo(f->journalDb()->databaseFilePath()) != QFileInfo(oldJournal);
+    f->journalDb()->close();
+    f->deleteLater();
+    Q_EMIT folderRemoved(f);
+    if (journalMovedAway) {
+        // closing checkpointed the journal through its open file, the moved -wal is outdated
+        QFile::remove(oldJournal + QStringLiteral("-wal"));
+        QFile::remove(oldJournal + QStringLiteral("-shm"));
+    }
+
+    const bool journalMoves = QFileInfo(newJournal) != QFileInfo(oldJournal);
+    // the -wal and -shm files are gone after the journal was closed
+    if (journalMoves && !QFile::rename(oldJournal, newJournal)) {
+        qCWarning(lcFolderMan) << "Could not move the journal" << oldJournal << "to" << newJournal;
+        return restore(tr("The sync journal could not be moved to %1.").arg(QDir::toNativeSeparators(definition.localPath())));
+    }
+    if (!from.isEmpty() || !to.isEmpty()) {
+        SyncJournalDb journal(newJournal);
+        const bool rebased = journal.rebasePaths(from.toUtf8(), to.toUtf8());
+        journal.close();
+        if (!rebased) {
+            // the rebase is a single transaction, the journal is unchanged
+            qCWarning(lcFolderMan) << "Could not rebase the journal" << newJournal;
+            if (journalMoves && !QFile::rename(newJournal, oldJournal)) {
+                qCWarning(lcFolderMan) << "Could not move the journal back to" << oldJournal;
+            }
+            return restore(tr("The sync journal could not be updated for the new folder."));
+        }
+    }
+
+    auto folder = addFolderInternal(definition, accountState, std::move(vfs));
+    folder->saveToSettings();
+    if (folder->canSync()) {
+        scheduler()->enqueueFolder(folder);
+    }
+    Q_EMIT folderSyncStateChange(folder);
+    Q_EMIT folderListChanged();
+    return folder;
+}
+
 QString FolderMan::getBackupName(QString fullPathName) const
 {
     if (fullPathName.endsWith(QLatin1String("/")))
@@ -22,8 +22,11 @@
 
 #include <QList>
 #include <QObject>
+#include <QPointer>
 #include <QQueue>
+#include <QTimer>
 
+class TestFolderMan;
 class TestFolderMigration;
 
 namespace OCC {
@@ -38,6 +41,7 @@ class Application;
 class SyncResult;
 class SocketApi;
 class LockWatcher;
+class BandwidthSchedule;
 
 /**
  * @brief Return object for Folder::trayOverallStatus.
@@ -46,6 +50,8 @@ class LockWatcher;
 class TrayOverallStatusResult
 {
 public:
+    TrayOverallStatusResult();
+
     QDateTime lastSyncDone;
 
     void addResult(Folder *f);
@@ -53,6 +59,8 @@ public:
 
 private:
     SyncResult _overallStatus;
+    // the same for all folders, looked up once per aggregation
+    bool _networkPaused;
 };
 
 /**
@@ -182,6 +190,18 @@ public:
     /** Removes a folder */
     void removeFolder(Folder *);
 
+    /**
+     * Moves the folder \a f to \a localPath and to \a targetPath on the server, keeping its journal
+     *
+     * Either the local folder was moved as it is, or the root changes to a subdirectory or to the
+     * parent of the old root on both sides. The journal is rebased instead of starting over, which
+     * would compare every file with the server again. A sample of the files in the new location
+     * must match their records before anything is changed.
+     *
+     * @returns the folder replacing \a f or why it couldn't be moved.
+     */
+    Result<Folder *, QString> rerootFolder(Folder *f, const QString &localPath, const QString &targetPath);
+
     /**
      * Returns the folder which the file or directory stored in path is in
      *
@@ -266,6 +286,18 @@ public:
 
     SyncScheduler *scheduler() { return _scheduler; }
 
+    /**
+     * Calls Folder::startUp() on \a folder once the folders scheduled before were started.
+     * One folder is started per event loop iteration, so the UI stays responsive during the startup.
+     */
+    void scheduleStartUp(Folder *folder);
+
+    /// Whether folders are waiting for their start up
+    bool isStartingUp() const { return !_pendingStartUps.isEmpty(); }
+
+    /// The bandwidth limits for the current time and network
+    BandwidthSchedule *bandwidthSchedule() { return _bandwidthSchedule; }
+
 
     /** Queues all folders for syncing. */
     void scheduleAllFolders();
@@ -343,6 +375,9 @@ private:
     // makes the folder known to the socket api
     void registerFolderWithSocketApi(Folder *folder);
 
+    /** Writes the metrics of the last sync runs to OWNCLOUD_SYNC_METRICS_FILE in the Prometheus text format, if it is set */
+    void writeSyncMetrics() const;
+
     /// \returns false when a downgrade of the database is detected, true otherwise.
     bool setupFoldersHelper(QSettings &settings, AccountStatePtr account);
 
@@ -359,12 +394,19 @@ private:
     /// Scheduled folders that should be synced as soon as possible
     SyncScheduler *_scheduler;
 
+    /// Folders waiting for Folder::startUp()
+    QQueue<QPointer<Folder>> _pendingStartUps;
+    QTimer _startUpTimer;
+
+    BandwidthSchedule *_bandwidthSchedule;
+
     std::unique_ptr<SocketApi> _socketApi;
 
     mutable QMap<QString, Result<void, QString>> _unsupportedConfigurationError;
 
     static FolderMan *_instance;
     friend class OCC::Application;
+    friend class ::TestFolderMan;
     friend class ::TestFolderMigration;
 };
 
@@ -434,7 +434,11 @@ void FolderStatusModel::slotFolderSyncStateChange(Folder *f)
     auto &pi = _folders.at(folderIndex)->_progress;
 
     SyncResult::Status state = f->syncResult().status();
-    if (!f->canSync()) {
+    if (state == SyncResult::Upgrading) {
+        pi = {};
+        pi._overallSyncString = Utility::enumToDisplayName(SyncResult::Upgrading);
+        pi._overallPercent = f->journalUpgradePercent();
+    } else if (!f->canSync()) {
         // Reset progress info.
         pi = {};
     } else if (state == SyncResult::NotYetStarted) {
@@ -15,6 +15,7 @@
 // event masks
 #include "folderwatcher.h"
 
+#include <cmath>
 #include <cstdint>
 
 #include <QFlags>
@@ -34,7 +35,15 @@
 using namespace std::chrono_literals;
 
 namespace {
-constexpr auto notificationTimeoutC = 10s;
+// the quiet period for isolated changes, it grows with the rate of changes
+constexpr auto minimumQuietPeriodC = 1s;
+constexpr auto maximumQuietPeriodC = 5s;
+// changes are always reported after this time
+constexpr auto maximumDelayC = 10s;
+// the time constant of the decay of the change rate
+constexpr std::chrono::duration<double> rateDecayC = 5s;
+// the change rate that doubles the quiet period, in changes per second
+constexpr double rateScaleC = 10;
 }
 
 namespace OCC {
@@ -45,23 +54,26 @@ FolderWatcher::FolderWatcher(Folder *folder)
     : QObject(folder)
     , _folder(folder)
 {
-    _timer.setInterval(notificationTimeoutC);
-    connect(&_timer, &QTimer::timeout, this, [this] {
-        auto paths = popChangeSet();
-        if (!paths.isEmpty()) {
-            qCInfo(lcFolderWatcher) << "Detected changes in paths:" << paths;
-            Q_EMIT pathChanged(paths);
-        }
-    });
+    _timer.setSingleShot(true);
+    connect(&_timer, &QTimer::timeout, this, &FolderWatcher::reportChanges);
 }
 
 FolderWatcher::~FolderWatcher()
 {
 }
 
-void FolderWatcher::init(const QString &root)
+void FolderWatcher::init(const QString &root, const QByteArray &journalPosition)
 {
+    _root = root;
     _d.reset(new FolderWatcherPrivate(this, root));
+    if (!journalPosition.isEmpty()) {
+        _d->replayJournal(journalPosition);
+    }
+}
+
+QByteArray FolderWatcher::journalPosition() const
+{
+    return _d ? _d->journalPosition() : QByteArray();
 }
 
 bool FolderWatcher::pathIsIgnored(const QString &path) const
@@ -77,7 +89,8 @@ bool FolderWatcher::pathIsIgnored(const QString &path) const
 
 bool FolderWatcher::isReliable() const
 {
-    return _isReliable;
+    // changes might be missed while the watches are set up
+    return _isReliable && _d && _d->isReady();
 }
 
 void FolderWatcher::startNotificatonTest(const QString &path)
@@ -118,7 +131,7 @@ void FolderWatcher::startNotificationTestWhenReady()
         f.open(QIODevice::WriteOnly | QIODevice::Append);
     }
 
-    QTimer::singleShot(notificationTimeoutC + 5s, this, [this]() {
+    QTimer::singleShot(maximumDelayC + 5s, this, [this]() {
         if (!_testNotificationPath.isEmpty())
             Q_EMIT becameUnreliable(tr("The watcher did not receive a test notification."));
         _testNotificationPath.clear();
@@ -138,9 +151,78 @@ int FolderWatcher::testLinuxWatchCount() const
 void FolderWatcher::changeDetected(const QSet<QString> &paths)
 {
     Q_ASSERT(thread() == QThread::currentThread());
+    const auto now = std::chrono::steady_clock::now();
+    if (_changeSet.isEmpty()) {
+        _firstPendingChange = now;
+    }
     _changeSet.unite(paths);
-    if (!_timer.isActive()) {
-        _timer.start();
+    _pendingEvents += paths.size();
+    updateActivity(paths);
+
+    // wait until nothing changed for the quiet period, but not longer than the maximum delay
+    const auto deadline = std::min(now + quietPeriod(), _firstPendingChange + maximumDelayC);
+    _timer.start(std::max(0ms, std::chrono::ceil<std::chrono::milliseconds>(deadline - now)));
+}
+
+void FolderWatcher::updateActivity(const QSet<QString> &paths)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::unordered_map<QString, int> counts;
+    for (const auto &path : paths) {
+        // the changes are grouped by the top level directory
+        QStringView relative = QStringView(path).mid(_root.size());
+        while (relative.startsWith(QLatin1Char('/'))) {
+            relative = relative.mid(1);
+        }
+        counts[relative.left(relative.indexOf(QLatin1Char('/'))).toString()]++;
+    }
+    for (const auto &[subtree, count] : counts) {
+        auto &activity = _activity[subtree];
+        const std::chrono::duration<double> elapsed = now - activity.lastChange;
+        activity.rate = activity.rate * std::exp(-elapsed / rateDecayC) + count / rateDecayC.count();
+        activity.lastChange = now;
+    }
+}
+
+std::chrono::milliseconds FolderWatcher::quietPeriod() const
+{
+    const auto now = std::chrono::steady_clock::now();
+    double rate = 0;
+    for (const auto &[subtree, activity] : _activity) {
+        const std::chrono::duration<double> elapsed = now - activity.lastChange;
+        rate = std::max(rate, activity.rate * std::exp(-elapsed / rateDecayC));
+    }
+    const auto period = std::chrono::duration_cast<std::chrono::milliseconds>(minimumQuietPeriodC * (1 + rate / rateScaleC));
+    return std::min<std::chrono::milliseconds>(period, maximumQuietPeriodC);
+}
+
+std::chrono::milliseconds FolderWatcher::maximumDelay()
+{
+    return maximumDelayC;
+}
+
+void FolderWatcher::reportChanges()
+{
+    const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _firstPendingChange);
+    const int events = _pendingEvents;
+    _pendingEvents = 0;
+
+    // forget the directories that calmed down
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = _activity.begin(); it != _activity.end();) {
+        if (now - it->second.lastChange > 10 * rateDecayC) {
+            it = _activity.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    auto paths = popChangeSet();
+    if (!paths.isEmpty()) {
+        qCInfo(lcFolderWatcher) << "Detected changes in" << paths.size() << "paths from" << events << "events after" << delay.count()
+                                << "ms, quiet period:" << quietPeriod().count() << "ms";
+        qCDebug(lcFolderWatcher) << "Changed paths:" << paths;
+        Q_EMIT pathChanged(paths);
     }
 }
 
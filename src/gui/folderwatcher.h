@@ -28,6 +28,9 @@
 #include <QStringList>
 #include <QTimer>
 
+#include <chrono>
+#include <unordered_map>
+
 
 namespace OCC {
 
@@ -43,6 +46,13 @@ class Folder;
  * for changes in the local file system. Changes are signalled
  * through the pathChanged() signal.
  *
+ * The changes are collected until the file system was quiet for a while.
+ * The quiet period adapts to the rate of changes in the top level
+ * directory they happened in: a single saved document is reported after
+ * about a second, while a build that rewrites thousands of files keeps
+ * extending it up to a few seconds. The changes are reported at the
+ * latest maximumDelay() after the first one.
+ *
  * @ingroup gui
  */
 
@@ -56,8 +66,20 @@ public:
 
     /**
      * @param root Path of the root of the folder
+     * @param journalPosition A journalPosition() of an earlier run, the
+     *        changes since then are reported and journalReplayed() is
+     *        emitted once all of them are known.
      */
-    void init(const QString &root);
+    void init(const QString &root, const QByteArray &journalPosition = {});
+
+    /**
+     * The position in the change journal of the file system up to which
+     * changes were reported
+     *
+     * The value is opaque and only meaningful on the same machine. It is
+     * empty if the platform has no persistent change journal.
+     */
+    QByteArray journalPosition() const;
 
     /* Check if the path is ignored. */
     virtual bool pathIsIgnored(const QString &path) const;
@@ -67,7 +89,8 @@ public:
      * notifications.
      *
      * For example, this can happen on linux if the inotify user limit from
-     * /proc/sys/fs/inotify/max_user_watches is exceeded.
+     * /proc/sys/fs/inotify/max_user_watches is exceeded. The watcher is also
+     * not reliable while it is still setting up its watches.
      */
     bool isReliable() const;
 
@@ -85,6 +108,12 @@ public:
     // pop the accumulated changes
     QSet<QString> popChangeSet();
 
+    /// How long the watcher currently waits for the file system to become quiet
+    std::chrono::milliseconds quietPeriod() const;
+
+    /// The longest the watcher waits before it reports a change
+    static std::chrono::milliseconds maximumDelay();
+
 
 Q_SIGNALS:
     /** Emitted when one of the watched directories or one
@@ -107,6 +136,13 @@ Q_SIGNALS:
      */
     void becameUnreliable(const QString &message);
 
+    /**
+     * All changes since the journal position passed to init() were reported
+     *
+     * Not emitted if that position was unusable or changes were lost.
+     */
+    void journalReplayed();
+
 protected Q_SLOTS:
     // called from the implementations to indicate a change in path
     void changeDetected(const QSet<QString> &paths);
@@ -115,9 +151,24 @@ private Q_SLOTS:
     void startNotificationTestWhenReady();
 
 private:
+    void updateActivity(const QSet<QString> &paths);
+    void reportChanges();
+
     QScopedPointer<FolderWatcherPrivate> _d;
+    QString _root;
     QTimer _timer;
     QSet<QString> _changeSet;
+
+    /// The rate of changes per top level directory, decaying over time
+    struct Activity
+    {
+        double rate = 0;
+        std::chrono::steady_clock::time_point lastChange;
+    };
+    std::unordered_map<QString, Activity> _activity;
+    std::chrono::steady_clock::time_point _firstPendingChange;
+    // for the statistics logged with the changes
+    int _pendingEvents = 0;
     Folder *_folder;
     bool _isReliable = true;
 
@@ -13,6 +13,9 @@
  */
 
 #include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/fanotify.h>
 #include <sys/inotify.h>
 #include <unistd.h>
 
@@ -21,8 +24,20 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QTimer>
 #include <QVarLengthArray>
 
+namespace {
+// The number of directories listed per event loop iteration while registering inotify watches
+constexpr int FolderBatchSize = 200;
+
+bool isJournalFile(const QByteArray &fileName)
+{
+    // Filter out journal changes - redundant with filtering in FolderWatcher::pathIsIgnored.
+    return fileName.startsWith("._sync_") || fileName.startsWith(".csync_journal.db") || fileName.startsWith(".sync_");
+}
+}
+
 namespace OCC {
 
 FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path)
@@ -30,6 +45,10 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
     , _parent(p)
     , _folder(path)
 {
+    if (startFanotify()) {
+        return;
+    }
+
     _fd = inotify_init();
     if (_fd != -1) {
         _socket.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
@@ -38,7 +57,123 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
         qCWarning(lcFolderWatcher) << "notify_init() failed: " << strerror(errno);
     }
 
-    QMetaObject::invokeMethod(this, [path, this] { slotAddFolderRecursive(path); });
+    // not ready until the registration is complete
+    _pendingFolders.enqueue(QString());
+    QMetaObject::invokeMethod(this, [path, this] {
+        _pendingFolders.clear();
+        slotAddFolderRecursive(path);
+    });
+}
+
+FolderWatcherPrivate::~FolderWatcherPrivate()
+{
+    _socket.reset();
+    _fanotifySocket.reset();
+    if (_fd != -1) {
+        close(_fd);
+    }
+    if (_fanotifyFd != -1) {
+        close(_fanotifyFd);
+    }
+    if (_fanotifyMountFd != -1) {
+        close(_fanotifyMountFd);
+    }
+}
+
+bool FolderWatcherPrivate::startFanotify()
+{
+#ifdef FAN_REPORT_DFID_NAME
+    if (qEnvironmentVariableIsSet("OWNCLOUD_DISABLE_FANOTIFY")) {
+        return false;
+    }
+    const int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY | O_LARGEFILE);
+    if (fd == -1) {
+        // usually EPERM, only privileged processes may use fanotify this way
+        qCDebug(lcFolderWatcher) << "fanotify is not available:" << strerror(errno);
+        return false;
+    }
+    const QByteArray folder = _folder.toUtf8();
+    constexpr uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_ONDIR;
+    if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, folder.constData()) == -1) {
+        qCDebug(lcFolderWatcher) << "Could not watch the file system of" << _folder << "with fanotify:" << strerror(errno);
+        close(fd);
+        return false;
+    }
+    _fanotifyMountFd = open(folder.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (_fanotifyMountFd == -1) {
+        close(fd);
+        return false;
+    }
+    _fanotifyFd = fd;
+    _fanotifySocket.reset(new QSocketNotifier(_fanotifyFd, QSocketNotifier::Read));
+    connect(_fanotifySocket.data(), &QSocketNotifier::activated, this, &FolderWatcherPrivate::slotReceivedFanotifyNotification);
+    qCInfo(lcFolderWatcher) << "Using fanotify to watch" << _folder;
+    return true;
+#else
+    return false;
+#endif
+}
+
+QString FolderWatcherPrivate::fanotifyDirectoryPath(void *handle) const
+{
+    // resolving needs CAP_DAC_READ_SEARCH, which we have if we were allowed to set the mark
+    const int fd = open_by_handle_at(_fanotifyMountFd, static_cast<file_handle *>(handle), O_PATH | O_CLOEXEC);
+    if (fd == -1) {
+        // the directory is gone already, its parent reports the removal
+        return {};
+    }
+    char path[PATH_MAX];
+    const ssize_t len = readlink(QByteArray("/proc/self/fd/" + QByteArray::number(fd)).constData(), path, sizeof(path));
+    close(fd);
+    if (len <= 0) {
+        return {};
+    }
+    return QString::fromUtf8(path, len);
+}
+
+void FolderWatcherPrivate::slotReceivedFanotifyNotification(int fd)
+{
+#ifdef FAN_REPORT_DFID_NAME
+    alignas(fanotify_event_metadata) char buffer[8192];
+    const QString folderSlash = _folder + QLatin1Char('/');
+    QSet<QString> paths;
+
+    while (true) {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            // EAGAIN: all events are read
+            break;
+        }
+        for (auto *metadata = reinterpret_cast<fanotify_event_metadata *>(buffer); FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len)) {
+            if (metadata->mask & FAN_Q_OVERFLOW) {
+                qCWarning(lcFolderWatcher) << "fanotify queue overflow";
+                Q_EMIT _parent->lostChanges();
+                continue;
+            }
+            auto *info = reinterpret_cast<fanotify_event_info_fid *>(metadata + 1);
+            if (metadata->event_len <= sizeof(*metadata) || info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                continue;
+            }
+            auto *handle = reinterpret_cast<file_handle *>(info->handle);
+            const QByteArray fileName(reinterpret_cast<const char *>(handle->f_handle + handle->handle_bytes));
+            if (isJournalFile(fileName)) {
+                continue;
+            }
+
+            // the mark covers the whole file system, only report what is below the folder
+            const QString dir = fanotifyDirectoryPath(handle);
+            if (dir != _folder && !dir.startsWith(folderSlash)) {
+                continue;
+            }
+            paths.insert(dir + QLatin1Char('/') + QString::fromUtf8(fileName));
+        }
+    }
+    if (!paths.isEmpty()) {
+        _parent->changeDetected(paths);
+    }
+#else
+    Q_UNUSED(fd)
+#endif
 }
 
 // attention: result list passed by reference!
@@ -90,37 +225,51 @@ void FolderWatcherPrivate::slotAddFolderRecursive(const QString &path)
         return;
     }
 
-    int subdirCount = 0;
     qCDebug(lcFolderWatcher) << "(+) Watcher:" << path;
 
-    QDir inPath(path);
-    inotifyRegisterPath(inPath.absolutePath());
+    // The folder itself is watched right away so no changes in it get lost,
+    // the sub folders are registered from the event loop. Changes in them
+    // before they are watched are found by the next sync: new directories
+    // are always discovered completely and the watcher is not reliable
+    // before the initial registration is done.
+    inotifyRegisterPath(QDir(path).absolutePath());
+    _pendingFolders.enqueue(path);
+    processPendingFolders();
+}
 
-    QStringList allSubfolders;
-    if (!findFoldersBelow(QDir(path), allSubfolders)) {
-        qCWarning(lcFolderWatcher).nospace() << "Could not traverse all sub folders of '"
-                                             << path << "'";
-    }
+void FolderWatcherPrivate::processPendingFolders()
+{
+    const QDir::Filters filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
 
-    for (const auto &subfolder : std::as_const(allSubfolders)) {
-        QDir folder(subfolder);
-        if (folder.exists() && !_pathToWatch.contains(folder.absolutePath())) {
-            ++subdirCount;
-            if (_parent->pathIsIgnored(subfolder)) {
-                qCDebug(lcFolderWatcher) << "* Not adding" << folder.path();
+    for (int i = 0; i < FolderBatchSize && !_pendingFolders.isEmpty(); ++i) {
+        const QDir dir(_pendingFolders.dequeue());
+        if (!dir.exists() || !dir.isReadable()) {
+            qCWarning(lcFolderWatcher).nospace() << "Could not traverse all sub folders of '" << dir.path() << "'";
+            continue;
+        }
+        for (const QString &name : dir.entryList({QStringLiteral("*")}, filter)) {
+            const QString fullPath = dir.path() + QLatin1Char('/') + name;
+            if (_pathToWatch.contains(QDir(fullPath).absolutePath())) {
                 continue;
             }
-            inotifyRegisterPath(folder.absolutePath());
-        } else {
-            qCDebug(lcFolderWatcher) << "    `-> discarded:" << folder.path();
+            if (_parent->pathIsIgnored(fullPath)) {
+                qCDebug(lcFolderWatcher) << "* Not adding" << fullPath;
+                continue;
+            }
+            inotifyRegisterPath(QDir(fullPath).absolutePath());
+            _pendingFolders.enqueue(fullPath);
         }
     }
 
-    if (subdirCount > 0) {
-        qCDebug(lcFolderWatcher) << "    `-> and" << subdirCount << "subdirectories";
+    if (_pendingFolders.isEmpty()) {
+        qCDebug(lcFolderWatcher) << "    --- Finished scanning," << _pathToWatch.size() << "directories are watched";
+    } else if (!_processScheduled) {
+        _processScheduled = true;
+        QTimer::singleShot(0, this, [this] {
+            _processScheduled = false;
+            processPendingFolders();
+        });
     }
-
-    qCDebug(lcFolderWatcher) << "    --- Finished scanning" << path;
 }
 
 void FolderWatcherPrivate::slotReceivedNotification(int fd)
@@ -170,11 +319,7 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
         }
 
         const QByteArray fileName(event->name);
-
-        // Filter out journal changes - redundant with filtering in FolderWatcher::pathIsIgnored.
-        if (fileName.startsWith("._sync_")
-            || fileName.startsWith(".csync_journal.db")
-            || fileName.startsWith(".sync_")) {
+        if (isJournalFile(fileName)) {
             continue;
         }
 
@@ -203,6 +348,8 @@ void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
 
     const QString pathSlash = path + QLatin1Char('/');
 
+    _pendingFolders.removeIf([&](const QString &pending) { return pending == path || pending.startsWith(pathSlash); });
+
     // Remove the entry and all subentries
     while (it != _pathToWatch.end()) {
         auto itPath = it.key();
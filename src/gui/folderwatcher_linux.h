@@ -19,6 +19,7 @@
 #include <QSocketNotifier>
 #include <QHash>
 #include <QDir>
+#include <QQueue>
 
 #include "folderwatcher.h"
 
@@ -27,8 +28,16 @@ class QTimer;
 namespace OCC {
 
 /**
- * @brief Linux (inotify) API implementation of FolderWatcher
+ * @brief Linux (fanotify or inotify) API implementation of FolderWatcher
  * @ingroup gui
+ *
+ * If the process may watch the whole file system of the folder, a single
+ * fanotify mark reporting the directory and name of the changes is used.
+ * This requires CAP_SYS_ADMIN and a kernel with FAN_REPORT_DFID_NAME (5.9).
+ *
+ * Otherwise every directory needs its own inotify watch. The directories
+ * are registered in batches from the event loop, the watcher is not ready
+ * until all of them are watched.
  */
 class OWNCLOUDGUI_EXPORT FolderWatcherPrivate : public QObject
 {
@@ -37,13 +46,20 @@ public:
     FolderWatcherPrivate() {}
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
 
+    ~FolderWatcherPrivate() override;
+
     int testWatchCount() const { return _pathToWatch.size(); }
 
-    /// On linux the watcher is ready when the ctor finished.
-    constexpr bool isReady() const { return true; }
+    /// There is no persistent change journal we could replay
+    QByteArray journalPosition() const { return {}; }
+    void replayJournal(const QByteArray &) { }
+
+    /// The watcher is ready once all directories are registered
+    bool isReady() const { return _pendingFolders.isEmpty(); }
 
 protected Q_SLOTS:
     void slotReceivedNotification(int fd);
+    void slotReceivedFanotifyNotification(int fd);
     void slotAddFolderRecursive(const QString &path);
 
 protected:
@@ -52,12 +68,25 @@ protected:
     void removeFoldersBelow(const QString &path);
 
 private:
+    bool startFanotify();
+    QString fanotifyDirectoryPath(void *handle) const;
+    void processPendingFolders();
+
     FolderWatcher *_parent;
 
     QString _folder;
     QHash<int, QString> _watchToPath;
     QMap<QString, int> _pathToWatch;
     QScopedPointer<QSocketNotifier> _socket;
-    int _fd;
+    int _fd = -1;
+
+    /// Watched directories whose sub directories still need to be registered
+    QQueue<QString> _pendingFolders;
+    bool _processScheduled = false;
+
+    QScopedPointer<QSocketNotifier> _fanotifySocket;
+    int _fanotifyFd = -1;
+    /// A descriptor on the file system of the folder, to resolve the reported file handles
+    int _fanotifyMountFd = -1;
 };
 }
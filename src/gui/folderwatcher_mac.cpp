@@ -16,6 +16,7 @@
 #include "folderwatcher_mac.h"
 
 #include <cerrno>
+#include <sys/stat.h>
 
 #include <QScopeGuard>
 #include <QStringList>
@@ -27,14 +28,81 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
     : _parent(p)
     , _folder(path)
 {
+    struct stat info;
+    if (stat(_folder.toUtf8().constData(), &info) == 0) {
+        if (CFUUIDRef uuid = FSEventsCopyUUIDForDevice(info.st_dev)) {
+            CFStringRef uuidString = CFUUIDCreateString(nullptr, uuid);
+            _deviceUuid = QString::fromCFString(uuidString).toUtf8();
+            CFRelease(uuidString);
+            CFRelease(uuid);
+        }
+    }
     this->startWatching();
 }
 
 FolderWatcherPrivate::~FolderWatcherPrivate()
 {
-    FSEventStreamStop(_stream);
-    FSEventStreamInvalidate(_stream);
-    FSEventStreamRelease(_stream);
+    stopWatching();
+}
+
+void FolderWatcherPrivate::stopWatching()
+{
+    if (_stream) {
+        FSEventStreamStop(_stream);
+        FSEventStreamInvalidate(_stream);
+        FSEventStreamRelease(_stream);
+        _stream = nullptr;
+    }
+}
+
+QByteArray FolderWatcherPrivate::journalPosition() const
+{
+    if (_deviceUuid.isEmpty() || _replaying) {
+        return {};
+    }
+    return _deviceUuid + '/' + QByteArray::number(static_cast<quint64>(_lastEventId));
+}
+
+void FolderWatcherPrivate::replayJournal(const QByteArray &position)
+{
+    const auto parts = position.split('/');
+    bool ok = false;
+    const auto eventId = parts.size() == 2 ? parts[1].toULongLong(&ok) : 0;
+    if (!ok || _deviceUuid.isEmpty() || parts[0] != _deviceUuid) {
+        // another volume or its event database was recreated
+        qCInfo(lcFolderWatcher) << "Can't replay the file system events of" << _folder << "from" << position;
+        return;
+    }
+    if (eventId > FSEventsGetCurrentEventId()) {
+        return;
+    }
+    qCInfo(lcFolderWatcher) << "Replaying the file system events of" << _folder << "since" << eventId;
+    stopWatching();
+    _replaying = true;
+    _replayFailed = false;
+    startWatching(eventId);
+}
+
+void FolderWatcherPrivate::eventReceived(FSEventStreamEventId eventId, FSEventStreamEventFlags flags)
+{
+    const FSEventStreamEventFlags lostFlags = kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagUserDropped
+        | kFSEventStreamEventFlagKernelDropped | kFSEventStreamEventFlagEventIdsWrapped | kFSEventStreamEventFlagRootChanged;
+
+    if (eventId > _lastEventId) {
+        _lastEventId = eventId;
+    }
+    if (flags & lostFlags) {
+        qCWarning(lcFolderWatcher) << "File system events were lost for" << _folder << flags;
+        _replayFailed = true;
+        Q_EMIT _parent->lostChanges();
+    }
+    if (_replaying && (flags & kFSEventStreamEventFlagHistoryDone)) {
+        _replaying = false;
+        if (!_replayFailed) {
+            qCInfo(lcFolderWatcher) << "Replayed the file system events of" << _folder;
+            Q_EMIT _parent->journalReplayed();
+        }
+    }
 }
 
 static void callback(
@@ -46,8 +114,6 @@ static void callback(
     const FSEventStreamEventId eventIds[])
 {
     Q_UNUSED(streamRef)
-    Q_UNUSED(eventFlags)
-    Q_UNUSED(eventIds)
 
     const FSEventStreamEventFlags c_interestingFlags =
         kFSEventStreamEventFlagItemCreated // for new folder/file
@@ -57,10 +123,13 @@ static void callback(
         | kFSEventStreamEventFlagItemModified; // for content change
     // We ignore other flags, e.g. for owner change, xattr change, Finder label change etc
 
+    auto *d = reinterpret_cast<FolderWatcherPrivate *>(clientCallBackInfo);
     QSet<QString> paths;
     CFArrayRef eventPaths = static_cast<CFArrayRef>(eventPathsVoid);
 
     for (CFIndex i = 0; i < static_cast<CFIndex>(numEvents); ++i) {
+        d->eventReceived(eventIds[i], eventFlags[i]);
+
         auto cfPath = reinterpret_cast<CFStringRef>(CFArrayGetValueAtIndex(eventPaths, i));
         const auto qPath = QString::fromCFString(cfPath).normalized(QString::NormalizationForm_C);
 
@@ -73,11 +142,11 @@ static void callback(
     }
 
     if (!paths.isEmpty()) {
-        reinterpret_cast<FolderWatcherPrivate *>(clientCallBackInfo)->doNotifyParent(paths);
+        d->doNotifyParent(paths);
     }
 }
 
-void FolderWatcherPrivate::startWatching()
+void FolderWatcherPrivate::startWatching(FSEventStreamEventId sinceWhen)
 {
     qCDebug(lcFolderWatcher) << "FolderWatcherPrivate::startWatching()" << _folder;
 
@@ -95,10 +164,13 @@ void FolderWatcherPrivate::startWatching()
         &callback,
         &ctx,
         pathsToWatch,
-        kFSEventStreamEventIdSinceNow,
+        sinceWhen,
         0, // latency
         kFSEventStreamCreateFlagUseCFTypes | kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagIgnoreSelf);
 
+    if (sinceWhen == kFSEventStreamEventIdSinceNow) {
+        _lastEventId = FSEventsGetCurrentEventId();
+    }
     FSEventStreamScheduleWithRunLoop(_stream, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
     FSEventStreamStart(_stream);
 }
@@ -35,18 +35,32 @@ public:
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
     ~FolderWatcherPrivate();
 
-    void startWatching();
+    void startWatching(FSEventStreamEventId sinceWhen = kFSEventStreamEventIdSinceNow);
+    void stopWatching();
     void doNotifyParent(const QSet<QString> &);
 
     /// On OSX the watcher is ready when the ctor finished.
     constexpr bool isReady() const { return true; }
 
+    /// The uuid of the FSEvents database of the volume and the last event id
+    QByteArray journalPosition() const;
+    /// Restart the stream with the events after \a position
+    void replayJournal(const QByteArray &position);
+
+    // called from the stream callback
+    void eventReceived(FSEventStreamEventId eventId, FSEventStreamEventFlags flags);
+
 private:
     FolderWatcher *_parent;
 
     QString _folder;
 
-    FSEventStreamRef _stream;
+    FSEventStreamRef _stream = nullptr;
+
+    QByteArray _deviceUuid;
+    FSEventStreamEventId _lastEventId = 0;
+    bool _replaying = false;
+    bool _replayFailed = false;
 };
 
 } // namespace OCC
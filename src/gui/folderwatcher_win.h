@@ -73,6 +73,10 @@ public:
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
     ~FolderWatcherPrivate() override;
 
+    /// There is no persistent change journal we could replay
+    QByteArray journalPosition() const { return {}; }
+    void replayJournal(const QByteArray &) { }
+
     /// Set to non-zero once the WatcherThread is capturing events.
     bool isReady() const
     {
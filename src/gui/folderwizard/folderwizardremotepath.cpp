@@ -120,9 +120,8 @@ void FolderWizardRemotePath::slotHandleMkdirNetworkError(QNetworkReply *reply)
     }
 }
 
-void FolderWizardRemotePath::slotHandleLsColNetworkError()
+void FolderWizardRemotePath::slotHandleLsColNetworkError(PropfindJob *job)
 {
-    auto *job = qobject_cast<PropfindJob *>(sender());
     // Ignore 404s, otherwise users will get annoyed by error popups
     // when not typing fast enough. It's still clear that a given path
     // was not found, because the 'Next' button is disabled and no entry
@@ -146,7 +145,7 @@ static QTreeWidgetItem *findFirstChild(QTreeWidgetItem *parent, const QString &t
     return nullptr;
 }
 
-void FolderWizardRemotePath::recursiveInsert(QTreeWidgetItem *parent, QStringList pathTrail, const QString &path)
+void FolderWizardRemotePath::recursiveInsert(QTreeWidgetItem *parent, QStringList pathTrail, const QString &path, const QString &etag)
 {
     if (pathTrail.isEmpty())
         return;
@@ -168,9 +167,12 @@ void FolderWizardRemotePath::recursiveInsert(QTreeWidgetItem *parent, QStringLis
         item->setToolTip(0, folderPath);
         item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
     }
+    if (pathTrail.size() == 1 && !etag.isEmpty()) {
+        item->setData(0, EtagRole, etag);
+    }
 
     pathTrail.removeFirst();
-    recursiveInsert(item, pathTrail, path);
+    recursiveInsert(item, pathTrail, path, etag);
 }
 
 bool FolderWizardRemotePath::selectByPath(QString path)
@@ -206,7 +208,7 @@ const QString &FolderWizardRemotePath::targetPath() const
     return _targetPath;
 }
 
-void FolderWizardRemotePath::slotUpdateDirectories(const QStringList &list)
+void FolderWizardRemotePath::slotUpdateDirectories(const QStringList &list, const QHash<QString, qint64> &, const QHash<QString, QString> &etags)
 {
     QString webdavFolder = folderWizardPrivate()->davUrl().path();
 
@@ -221,18 +223,19 @@ void FolderWizardRemotePath::slotUpdateDirectories(const QStringList &list)
     QStringList sortedList = list;
     Utility::sortFilenames(sortedList);
     for (auto path : std::as_const(sortedList)) {
+        const QString etag = etags.value(path);
         path.remove(webdavFolder);
         QStringList paths = path.split(QLatin1Char('/'));
         if (paths.last().isEmpty())
             paths.removeLast();
-        recursiveInsert(root, paths, path);
+        recursiveInsert(root, paths, path, etag);
     }
     root->setExpanded(true);
 }
 
 void FolderWizardRemotePath::slotRefreshFolders()
 {
-    runPropFindJob(QStringLiteral("/"));
+    runListingJob(QStringLiteral("/"));
     _ui->folderTreeWidget->clear();
     _ui->folderEntry->clear();
 }
@@ -243,7 +246,8 @@ void FolderWizardRemotePath::slotItemExpanded(QTreeWidgetItem *item)
     if (!dir.startsWith(QLatin1Char('/'))) {
         dir.prepend(QLatin1Char('/'));
     }
-    runPropFindJob(dir);
+    // the etag from the listing of the parent, an unchanged folder is taken from the cache
+    runListingJob(dir, item->data(0, EtagRole).toString());
 }
 
 void FolderWizardRemotePath::slotCurrentItemChanged(QTreeWidgetItem *item)
@@ -274,29 +278,29 @@ void FolderWizardRemotePath::slotLsColFolderEntry()
 {
     QString path = _ui->folderEntry->text();
 
-    PropfindJob *job = runPropFindJob(path);
+    SubfolderListingJob *job = runListingJob(path);
     // No error handling, no updating, we do this manually
     // because of extra logic in the typed-path case.
     disconnect(job, nullptr, this, nullptr);
-    connect(job, &PropfindJob::finishedWithError,
+    connect(job, &SubfolderListingJob::finishedWithError,
         this, &FolderWizardRemotePath::slotHandleLsColNetworkError);
-    connect(job, &PropfindJob::directoryListingSubfolders,
+    connect(job, &SubfolderListingJob::subfoldersListed,
         this, &FolderWizardRemotePath::slotTypedPathFound);
 }
 
-void FolderWizardRemotePath::slotTypedPathFound(const QStringList &subpaths)
+void FolderWizardRemotePath::slotTypedPathFound(const QStringList &subpaths, const QHash<QString, qint64> &sizes, const QHash<QString, QString> &etags)
 {
-    slotUpdateDirectories(subpaths);
+    slotUpdateDirectories(subpaths, sizes, etags);
     selectByPath(_ui->folderEntry->text());
 }
 
-PropfindJob *FolderWizardRemotePath::runPropFindJob(const QString &path)
+SubfolderListingJob *FolderWizardRemotePath::runListingJob(const QString &path, const QString &expectedEtag)
 {
-    PropfindJob *job = new PropfindJob(folderWizardPrivate()->accountState()->account(), folderWizardPrivate()->davUrl(), path, PropfindJob::Depth::One, this);
-    job->setProperties({ QByteArrayLiteral("resourcetype") });
-    connect(job, &PropfindJob::directoryListingSubfolders,
+    auto *job = new SubfolderListingJob(folderWizardPrivate()->accountState()->account(), folderWizardPrivate()->davUrl(), path, this);
+    job->setExpectedEtag(expectedEtag);
+    connect(job, &SubfolderListingJob::subfoldersListed,
         this, &FolderWizardRemotePath::slotUpdateDirectories);
-    connect(job, &PropfindJob::finishedWithError,
+    connect(job, &SubfolderListingJob::finishedWithError,
         this, &FolderWizardRemotePath::slotHandleLsColNetworkError);
     job->start();
 
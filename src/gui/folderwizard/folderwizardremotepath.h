@@ -21,6 +21,7 @@
 
 #include "gui/folder.h"
 #include "gui/folderwizard/folderwizard_p.h"
+#include "libsync/remotelistingcache.h"
 
 #include <QWizardPage>
 
@@ -57,18 +58,20 @@ protected Q_SLOTS:
     void slotCreateRemoteFolder(const QString &);
     void slotCreateRemoteFolderFinished();
     void slotHandleMkdirNetworkError(QNetworkReply *);
-    void slotHandleLsColNetworkError();
-    void slotUpdateDirectories(const QStringList &);
+    void slotHandleLsColNetworkError(PropfindJob *job);
+    void slotUpdateDirectories(const QStringList &list, const QHash<QString, qint64> &sizes, const QHash<QString, QString> &etags);
     void slotRefreshFolders();
     void slotItemExpanded(QTreeWidgetItem *);
     void slotCurrentItemChanged(QTreeWidgetItem *);
     void slotFolderEntryEdited(const QString &text);
     void slotLsColFolderEntry();
-    void slotTypedPathFound(const QStringList &subpaths);
+    void slotTypedPathFound(const QStringList &subpaths, const QHash<QString, qint64> &sizes, const QHash<QString, QString> &etags);
 
 private:
-    PropfindJob *runPropFindJob(const QString &path);
-    void recursiveInsert(QTreeWidgetItem *parent, QStringList pathTrail, const QString &path);
+    SubfolderListingJob *runListingJob(const QString &path, const QString &expectedEtag = {});
+    void recursiveInsert(QTreeWidgetItem *parent, QStringList pathTrail, const QString &path, const QString &etag);
+    // the etag of a folder item
+    static constexpr int EtagRole = Qt::UserRole + 1;
     bool selectByPath(QString path);
     Ui_FolderWizardTargetPage *_ui;
     bool _warnWasVisible;
@@ -52,6 +52,9 @@ namespace Utility {
 
     QString socketApiSocketPath();
 
+    /** The name of the shared file status table read by the shell integration, empty if there is no reader */
+    QString socketApiStatusTablePath();
+
     OWNCLOUDGUI_EXPORT void markDirectoryAsSyncRoot(const QString &path, const QUuid &accountUuid);
     std::pair<QString, QUuid> getDirectorySyncRootMarkings(const QString &path);
     void unmarkDirectoryAsSyncRoot(const QString &path);
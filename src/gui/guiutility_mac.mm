@@ -21,6 +21,7 @@
 #include <QProcess>
 
 #import <Foundation/NSBundle.h>
+#import <Foundation/NSFileManager.h>
 
 namespace OCC {
 
@@ -58,4 +59,15 @@ QString Utility::socketApiSocketPath()
     return QStringLiteral("%1%2.socketApi").arg(QStringLiteral(SOCKETAPI_TEAM_IDENTIFIER_PREFIX), Theme::instance()->orgDomainName());
 }
 
+QString Utility::socketApiStatusTablePath()
+{
+    // The sandboxed extension can only read the container of the App Group, see socketApiSocketPath()
+    const QString group = QStringLiteral(SOCKETAPI_TEAM_IDENTIFIER_PREFIX) + Theme::instance()->orgDomainName();
+    NSURL *container = [[NSFileManager defaultManager] containerURLForSecurityApplicationGroupIdentifier:group.toNSString()];
+    if (!container) {
+        return {};
+    }
+    return QUrl::fromNSURL(container).toLocalFile() + QStringLiteral("/statustable");
+}
+
 } // namespace OCC
@@ -28,4 +28,10 @@ QString Utility::socketApiSocketPath()
     return QStringLiteral("%1/ownCloud/socket").arg(QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation));
 }
 
+QString Utility::socketApiStatusTablePath()
+{
+    // none of the file manager integrations reads it
+    return {};
+}
+
 } // namespace OCC
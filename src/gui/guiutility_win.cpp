@@ -28,4 +28,10 @@ QString Utility::socketApiSocketPath()
     return QStringLiteral(R"(\\.\pipe\ownCloud-%1)").arg(qEnvironmentVariable("USERNAME"));
 }
 
+QString Utility::socketApiStatusTablePath()
+{
+    // This must match RemotePathChecker in the shell integration
+    return QStringLiteral(R"(Local\ownCloud-%1-status)").arg(qEnvironmentVariable("USERNAME"));
+}
+
 } // namespace OCC
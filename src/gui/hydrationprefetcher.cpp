@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "gui/hydrationprefetcher.h"
+
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+#include "common/utility.h"
+#include "common/vfs.h"
+#include "folder.h"
+#include "folderman.h"
+#include "owncloudpropagator.h"
+#include "scheduling/syncscheduler.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+using namespace std::chrono_literals;
+
+namespace {
+constexpr qint64 DefaultBudgetMiB = 100;
+// files hydrated within this time of each other are considered to be used together
+constexpr std::chrono::milliseconds CoAccessWindow = 10min;
+// the budget is renewed after this time without requests
+constexpr std::chrono::milliseconds BudgetRenewal = 1h;
+// the hydration history is kept this long
+constexpr std::chrono::milliseconds HistoryAge = std::chrono::hours(24 * 90);
+constexpr int MaximumPrefetchFiles = 10;
+
+qint64 budgetFromEnvironment()
+{
+    bool ok;
+    const qint64 mib = qEnvironmentVariableIntValue("OWNCLOUD_HYDRATION_PREFETCH_BUDGET", &ok);
+    return (ok ? std::max<qint64>(mib, 0) : DefaultBudgetMiB) * 1024 * 1024;
+}
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcHydrationPrefetcher, "gui.hydrationprefetcher", QtInfoMsg)
+
+HydrationPrefetcher::HydrationPrefetcher(Folder *folder)
+    : QObject(folder)
+    , _folder(folder)
+    , _budget(budgetFromEnvironment())
+{
+    connect(_folder, &Folder::syncFinished, this, &HydrationPrefetcher::slotSyncFinished);
+    _folder->journalDb()->deleteHydrationsBefore(QDateTime::currentMSecsSinceEpoch() - HistoryAge.count());
+}
+
+void HydrationPrefetcher::fileRequested(const QString &relativePath)
+{
+    if (_budget <= 0) {
+        return;
+    }
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - _lastRequest > BudgetRenewal.count()) {
+        _prefetchedBytes = 0;
+    }
+    _lastRequest = now;
+
+    _requested.insert(relativePath);
+    if (_pending.removeOne(relativePath)) {
+        SyncJournalFileRecord record;
+        _folder->journalDb()->getFileRecord(relativePath, &record);
+        _pendingBytes -= record._fileSize;
+    }
+
+    for (const auto &path : predict(relativePath)) {
+        if (_pending.size() >= MaximumPrefetchFiles) {
+            break;
+        }
+        if (_requested.contains(path) || _pending.contains(path)) {
+            continue;
+        }
+        SyncJournalFileRecord record;
+        if (!_folder->journalDb()->getFileRecord(path, &record) || !accepts(path, record)) {
+            continue;
+        }
+        if (_prefetchedBytes + _pendingBytes + record._fileSize > _budget) {
+            continue;
+        }
+        _pending.append(path);
+        _pendingBytes += record._fileSize;
+    }
+    _folder->journalDb()->setHydrationTime(relativePath.toUtf8(), now);
+    qCDebug(lcHydrationPrefetcher) << "Requested" << relativePath << "pending" << _pending;
+}
+
+QStringList HydrationPrefetcher::predict(const QString &relativePath)
+{
+    auto *journal = _folder->journalDb();
+    QStringList out;
+
+    // the files used together with this one the last time
+    if (const qint64 lastHydration = journal->hydrationTime(relativePath.toUtf8())) {
+        for (const auto &path : journal->hydratedAround(lastHydration, CoAccessWindow.count(), MaximumPrefetchFiles + 1)) {
+            if (path != relativePath.toUtf8()) {
+                out.append(QString::fromUtf8(path));
+            }
+        }
+    }
+
+    // the siblings of the same type, the ones following the requested file first
+    const int slash = relativePath.lastIndexOf(QLatin1Char('/'));
+    const QString parent = slash < 0 ? QString() : relativePath.left(slash);
+    const QString suffix = QFileInfo(_folder->vfs().underlyingFileName(relativePath)).suffix();
+    QStringList siblings;
+    journal->listFilesInPath(parent.toUtf8(), [&](const SyncJournalFileRecord &record) {
+        const QString path = QString::fromUtf8(record._path);
+        if (record.isVirtualFile() && QFileInfo(_folder->vfs().underlyingFileName(path)).suffix().compare(suffix, Qt::CaseInsensitive) == 0) {
+            siblings.append(path);
+        }
+    });
+    std::sort(siblings.begin(), siblings.end());
+    const auto it = std::upper_bound(siblings.begin(), siblings.end(), relativePath);
+    std::rotate(siblings.begin(), it, siblings.end());
+    siblings.removeOne(relativePath);
+    out.append(siblings);
+    return out;
+}
+
+bool HydrationPrefetcher::accepts(const QString &relativePath, const SyncJournalFileRecord &record) const
+{
+    if (!record.isValid() || record._type != ItemTypeVirtualFile) {
+        return false;
+    }
+    // a hydrated OnlineOnly file would be dehydrated by the next sync
+    const auto pin = _folder->vfs().pinState(relativePath);
+    return !pin || *pin != PinState::OnlineOnly;
+}
+
+void HydrationPrefetcher::slotSyncFinished()
+{
+    if (_pending.isEmpty()) {
+        return;
+    }
+    auto *journal = _folder->journalDb();
+    // prefetch once the requested files are there, so we don't delay them
+    for (const auto &path : std::as_const(_requested)) {
+        SyncJournalFileRecord record;
+        if (journal->getFileRecord(path, &record) && record._type == ItemTypeVirtualFileDownload) {
+            return;
+        }
+    }
+    _requested.clear();
+
+    qint64 available = std::numeric_limits<qint64>::max();
+    const qint64 freeSpace = Utility::freeDiskSpace(_folder->path());
+    if (freeSpace >= 0) {
+        available = freeSpace - freeSpaceLimit();
+    }
+
+    int count = 0;
+    for (const auto &path : std::as_const(_pending)) {
+        SyncJournalFileRecord record;
+        if (!journal->getFileRecord(path, &record) || !accepts(path, record) || record._fileSize > available) {
+            continue;
+        }
+        record._type = ItemTypeVirtualFileDownload;
+        if (!journal->setFileRecord(record)) {
+            continue;
+        }
+        _folder->schedulePathForLocalDiscovery(path);
+        _prefetchedBytes += record._fileSize;
+        available -= record._fileSize;
+        ++count;
+    }
+    _pending.clear();
+    _pendingBytes = 0;
+
+    if (count > 0) {
+        qCInfo(lcHydrationPrefetcher) << "Prefetching" << count << "files in" << _folder->path() << "budget left" << _budget - _prefetchedBytes;
+        FolderMan::instance()->scheduler()->enqueueFolder(_folder, SyncScheduler::Priority::Low);
+    }
+}
+}
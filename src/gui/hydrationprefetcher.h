@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "gui/owncloudguilib.h"
+
+#include <QLoggingCategory>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+namespace OCC {
+
+Q_DECLARE_LOGGING_CATEGORY(lcHydrationPrefetcher)
+
+class Folder;
+class SyncJournalFileRecord;
+
+/**
+ * @brief Hydrates the virtual files a user is likely to open next
+ * @ingroup gui
+ *
+ * Every implicit hydration of a virtual file is recorded in the journal. The
+ * prefetcher then predicts the next files from
+ *  - the files that were hydrated around the time the file was hydrated the last time,
+ *  - the virtual files with the same extension in the same directory, in name order
+ *    starting after the requested file.
+ *
+ * The predicted files are marked for download once the sync that hydrates the
+ * requested file is done, and the folder is scheduled with low priority.
+ *
+ * The prefetched bytes are limited by a budget, OWNCLOUD_HYDRATION_PREFETCH_BUDGET
+ * in MiB, 0 disables the prefetching. The budget is renewed after an hour without
+ * requests. Files that are pinned OnlineOnly and files that don't fit on the disk
+ * without going below freeSpaceLimit() are never prefetched.
+ */
+class OWNCLOUDGUI_EXPORT HydrationPrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HydrationPrefetcher(Folder *folder);
+
+    /** Called for a file that is implicitly hydrated, see Folder::implicitlyHydrateFile() */
+    void fileRequested(const QString &relativePath);
+
+    /** The files that will be prefetched after the current sync */
+    const QStringList &pending() const { return _pending; }
+
+    qint64 budget() const { return _budget; }
+    void setBudget(qint64 budget) { _budget = budget; }
+
+private:
+    void slotSyncFinished();
+    QStringList predict(const QString &relativePath);
+    bool accepts(const QString &relativePath, const SyncJournalFileRecord &record) const;
+
+    Folder *_folder;
+    qint64 _budget;
+
+    QStringList _pending;
+    qint64 _pendingBytes = 0;
+
+    // the requested files whose hydration we wait for
+    QSet<QString> _requested;
+
+    // bytes prefetched since the budget was renewed
+    qint64 _prefetchedBytes = 0;
+    qint64 _lastRequest = 0;
+};
+}
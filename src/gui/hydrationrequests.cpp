@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "gui/hydrationrequests.h"
+
+#include "common/vfs.h"
+#include "folder.h"
+#include "folderman.h"
+#include "scheduling/syncscheduler.h"
+#include "syncengine.h"
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcHydrationRequests, "gui.hydrationrequests", QtInfoMsg)
+
+HydrationRequests::HydrationRequests(Folder *folder)
+    : QObject(folder)
+    , _folder(folder)
+{
+    _scheduleTimer.setSingleShot(true);
+    _scheduleTimer.setInterval(CoalescingDelay);
+    connect(&_scheduleTimer, &QTimer::timeout, this, [this] { FolderMan::instance()->scheduler()->enqueueFolder(_folder, SyncScheduler::Priority::Medium); });
+    connect(_folder, &Folder::syncStarted, this, &HydrationRequests::slotSyncStarted);
+    connect(&_folder->syncEngine(), &SyncEngine::itemCompleted, this, &HydrationRequests::slotItemCompleted);
+    connect(_folder, &Folder::syncFinished, this, &HydrationRequests::slotSyncFinished);
+}
+
+bool HydrationRequests::add(const QString &relativePath)
+{
+    auto it = _pending.find(relativePath);
+    if (it != _pending.end()) {
+        ++it->count;
+        qCDebug(lcHydrationRequests) << "Hydration of" << relativePath << "is already requested" << it->count << "times";
+        return false;
+    }
+    Request request;
+    request.timer.start();
+    _pending.insert(relativePath, request);
+    // don't restart the timer, the first request must not wait for the last one
+    if (!_scheduleTimer.isActive()) {
+        _scheduleTimer.start();
+    }
+    return true;
+}
+
+void HydrationRequests::slotSyncStarted()
+{
+    for (auto &request : _pending) {
+        request.inSync = true;
+    }
+}
+
+void HydrationRequests::slotItemCompleted(const SyncFileItemPtr &item)
+{
+    if (_pending.isEmpty() || item->isDirectory()) {
+        return;
+    }
+    // with the suffix vfs the file is requested with its suffix, the item may be the one without
+    for (const auto &path : {item->_file, item->destination(), QString(item->_file + _folder->vfs().fileSuffix())}) {
+        if (_pending.contains(path)) {
+            finish(path, item);
+            return;
+        }
+    }
+}
+
+void HydrationRequests::finish(const QString &relativePath, const SyncFileItemPtr &item)
+{
+    const auto request = _pending.take(relativePath);
+    const std::chrono::milliseconds latency(request.timer.elapsed());
+    qCInfo(lcHydrationRequests) << "Hydrated" << relativePath << "in" << latency.count() << "ms, requested" << request.count << "times, status"
+                                << item->_status;
+    Q_EMIT hydrated(relativePath, latency, request.count);
+}
+
+void HydrationRequests::slotSyncFinished(const SyncResult &)
+{
+    // the requests the sync didn't hydrate failed before the propagation, a new request tries again
+    for (auto it = _pending.begin(); it != _pending.end();) {
+        if (it->inSync) {
+            qCInfo(lcHydrationRequests) << "The sync did not hydrate" << it.key();
+            it = _pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+}
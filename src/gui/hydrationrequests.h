@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "gui/owncloudguilib.h"
+
+#include "libsync/syncfileitem.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QObject>
+#include <QTimer>
+
+#include <chrono>
+
+namespace OCC {
+
+Q_DECLARE_LOGGING_CATEGORY(lcHydrationRequests)
+
+class Folder;
+class SyncResult;
+
+/**
+ * @brief The implicit hydrations a folder waits for
+ * @ingroup gui
+ *
+ * Indexers, previewers and virus scanners often open the same virtual file at
+ * about the same time. Only the first request marks the file for download, the
+ * further ones wait for the same hydration.
+ *
+ * The sync that hydrates the files is scheduled CoalescingDelay after the first
+ * request, so a burst of requests, like a previewer going through a directory,
+ * is handled by one sync run instead of one run for the first file and an other
+ * one for the rest.
+ *
+ * The time from the first request to the end of the hydration is reported by
+ * hydrated().
+ */
+class OWNCLOUDGUI_EXPORT HydrationRequests : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr std::chrono::milliseconds CoalescingDelay{200};
+
+    explicit HydrationRequests(Folder *folder);
+
+    /** Returns false if the hydration of \a relativePath was already requested and is not done yet */
+    bool add(const QString &relativePath);
+
+    bool isPending(const QString &relativePath) const { return _pending.contains(relativePath); }
+
+Q_SIGNALS:
+    /** \a relativePath was hydrated, or failed to, \a latency after it was first requested */
+    void hydrated(const QString &relativePath, std::chrono::milliseconds latency, int requests);
+
+private:
+    void slotSyncStarted();
+    void slotItemCompleted(const SyncFileItemPtr &item);
+    void slotSyncFinished(const SyncResult &result);
+    void finish(const QString &relativePath, const SyncFileItemPtr &item);
+
+    struct Request
+    {
+        QElapsedTimer timer;
+        int count = 1;
+        // the request was made before the current sync started, so that sync handles it
+        bool inSync = false;
+    };
+
+    Folder *_folder;
+    QHash<QString, Request> _pending;
+    QTimer _scheduleTimer;
+};
+}
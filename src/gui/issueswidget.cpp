@@ -191,8 +191,8 @@ IssuesWidget::IssuesWidget(QWidget *parent)
 
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::progressInfo,
         this, &IssuesWidget::slotProgressInfo);
-    connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemCompleted,
-        this, &IssuesWidget::slotItemCompleted);
+    connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemsCompleted,
+        this, &IssuesWidget::slotItemsCompleted);
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::syncError,
         this, [this](Folder *folder, const QString &message, ErrorCategory) {
             auto item = SyncFileItemPtr::create();
@@ -316,6 +316,10 @@ void IssuesWidget::slotProgressInfo(Folder *folder, const ProgressInfo &progress
             if (style == LocalDiscoveryStyle::FilesystemOnly) {
                 return true;
             }
+            if (style == LocalDiscoveryStyle::FilesystemUnlessUnchanged) {
+                // the folders that were read from the db aren't known here
+                return false;
+            }
             if (!persistsUntilLocalDiscovery(item)) {
                 return true;
             }
@@ -346,11 +350,13 @@ void IssuesWidget::slotProgressInfo(Folder *folder, const ProgressInfo &progress
     }
 }
 
-void IssuesWidget::slotItemCompleted(Folder *folder, const SyncFileItemPtr &item)
+void IssuesWidget::slotItemsCompleted(Folder *folder, const QVector<SyncFileItemPtr> &items)
 {
-    if (!item->showInIssuesTab())
-        return;
-    _model->addProtocolItem(ProtocolItem { folder, item });
+    for (const auto &item : items) {
+        if (item->showInIssuesTab()) {
+            _model->addProtocolItem(ProtocolItem { folder, item });
+        }
+    }
 }
 
 void IssuesWidget::filterDidChange()
@@ -50,7 +50,7 @@ public:
 
 public Q_SLOTS:
     void slotProgressInfo(Folder *folder, const ProgressInfo &progress);
-    void slotItemCompleted(Folder *folder, const SyncFileItemPtr &item);
+    void slotItemsCompleted(Folder *folder, const QVector<SyncFileItemPtr> &items);
     void filterDidChange();
 
 Q_SIGNALS:
@@ -18,7 +18,9 @@
 #include <QLoggingCategory>
 #include <QTimer>
 
+#include <algorithm>
 #include <chrono>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -28,25 +30,36 @@ Q_LOGGING_CATEGORY(lcLockWatcher, "gui.lockwatcher", QtInfoMsg)
 
 namespace {
 const auto check_frequency = 20s;
+// most locks are released within seconds, check often at first
+const auto initial_check_delay = 1s;
 }
 
 LockWatcher::LockWatcher(QObject *parent)
     : QObject(parent)
+    , _checkInterval(check_frequency)
 {
+    _timer.setSingleShot(true);
     connect(&_timer, &QTimer::timeout,
         this, &LockWatcher::checkFiles);
-    _timer.start(check_frequency);
 }
 
 void LockWatcher::addFile(const QString &path, FileSystem::LockMode mode)
 {
     qCInfo(lcLockWatcher) << "Watching for lock of" << path << mode << "being released";
-    _watchedPaths.insert({ path, mode });
+    const auto interval = std::min<std::chrono::milliseconds>(initial_check_delay, _checkInterval);
+    // keep the backoff of a file that is reported again
+    _watchedPaths.try_emplace({ path, mode }, Entry { std::chrono::steady_clock::now() + interval, interval });
+    scheduleNextCheck();
 }
 
 void LockWatcher::setCheckInterval(std::chrono::milliseconds interval)
 {
-    _timer.start(interval.count());
+    _checkInterval = interval;
+    for (auto &[key, entry] : _watchedPaths) {
+        entry.interval = std::min(entry.interval, interval);
+        entry.nextCheck = std::min(entry.nextCheck, std::chrono::steady_clock::now() + interval);
+    }
+    scheduleNextCheck();
 }
 
 bool LockWatcher::contains(const QString &path, OCC::FileSystem::LockMode mode) const
@@ -54,19 +67,42 @@ bool LockWatcher::contains(const QString &path, OCC::FileSystem::LockMode mode)
     return _watchedPaths.find({ path, mode }) != _watchedPaths.cend();
 }
 
+void LockWatcher::scheduleNextCheck()
+{
+    if (_watchedPaths.empty()) {
+        _timer.stop();
+        return;
+    }
+    auto next = std::chrono::steady_clock::time_point::max();
+    for (const auto &[key, entry] : _watchedPaths) {
+        next = std::min(next, entry.nextCheck);
+    }
+    const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+    _timer.start(std::max(delay, 0ms));
+}
+
 void LockWatcher::checkFiles()
 {
-    // copy as Q_EMIT fileUnlocked might trigger a new insert
-    const auto watchedPathsCopy = _watchedPaths;
-    decltype(_watchedPaths) unlocked;
-    for (const auto &p : watchedPathsCopy) {
-        if (!FileSystem::isFileLocked(p.first, p.second)) {
-            qCInfo(lcLockWatcher) << "Lock of" << p.first << p.second << "was released";
-            Q_EMIT fileUnlocked(p.first, p.second);
-            unlocked.insert(p);
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<LockKey> unlocked;
+    for (auto &[key, entry] : _watchedPaths) {
+        if (entry.nextCheck > now) {
+            continue;
         }
+        if (!FileSystem::isFileLocked(key.first, key.second)) {
+            qCInfo(lcLockWatcher) << "Lock of" << key.first << key.second << "was released";
+            unlocked.push_back(key);
+        } else {
+            entry.interval = std::min(entry.interval * 2, _checkInterval);
+            entry.nextCheck = now + entry.interval;
+        }
+    }
+    for (const auto &key : unlocked) {
+        _watchedPaths.erase(key);
     }
-    for (const auto &removed : std::as_const(unlocked)) {
-        _watchedPaths.erase(removed);
+    // Q_EMIT fileUnlocked might trigger a new insert
+    for (const auto &key : unlocked) {
+        Q_EMIT fileUnlocked(key.first, key.second);
     }
+    scheduleNextCheck();
 }
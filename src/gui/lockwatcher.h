@@ -25,7 +25,9 @@
 #include <QTimer>
 
 #include <chrono>
-#include <unordered_set>
+#include <unordered_map>
+
+class TestLockedFiles;
 
 namespace OCC {
 
@@ -40,6 +42,12 @@ namespace OCC {
  * becomes available again. To do that, we need to regularly check whether
  * the file is still being locked.
  *
+ * A lock is usually short lived, the file is checked again after a second
+ * and the interval is doubled for every check that still finds it locked,
+ * up to the check interval. The timer only runs while files are watched.
+ * The unlocked path is handed to the folder like a file watcher notification,
+ * so the following sync only needs to discover that single file locally.
+ *
  * @ingroup gui
  */
 
@@ -56,7 +64,7 @@ public:
      */
     void addFile(const QString &path, OCC::FileSystem::LockMode mode);
 
-    /** Adjusts the default interval for checking whether the lock is still present */
+    /** Adjusts the maximum interval for checking whether the lock is still present */
     void setCheckInterval(std::chrono::milliseconds interval);
 
     /** Whether the path is being watched for lock-changes */
@@ -81,7 +89,19 @@ private:
         }
     };
 
-    std::unordered_set<LockKey, HashLockKey> _watchedPaths;
+    friend class ::TestLockedFiles;
+
+    struct Entry
+    {
+        std::chrono::steady_clock::time_point nextCheck;
+        std::chrono::milliseconds interval;
+    };
+
+    /// Starts the timer for the earliest due check
+    void scheduleNextCheck();
+
+    std::unordered_map<LockKey, Entry, HashLockKey> _watchedPaths;
+    std::chrono::milliseconds _checkInterval;
     QTimer _timer;
 };
 }
@@ -19,8 +19,10 @@
 #include "gui/application.h"
 #include "gui/logbrowser.h"
 #include "gui/networkinformation.h"
+#include "gui/startuptrace.h"
 #include "libsync/configfile.h"
 #include "libsync/platform.h"
+#include "libsync/stallwatchdog.h"
 #include "libsync/theme.h"
 #include "resources/loadresources.h"
 
@@ -86,6 +88,8 @@ struct CommandLineOptions
 
     bool debugMode = false;
 
+    QString traceStartupFile;
+
     QString fileToOpen;
 };
 
@@ -133,6 +137,8 @@ CommandLineOptions parseOptions(const QStringList &arguments)
     auto logFlushOption = addOption({QStringLiteral("logflush"), QApplication::translate("CommandLine", "Flush the log file after every write.")});
     auto logDebugOption = addOption({QStringLiteral("logdebug"), QApplication::translate("CommandLine", "Output debug-level messages in the log.")});
     auto debugOption = addOption({QStringLiteral("debug"), QApplication::translate("CommandLine", "Enable debug mode.")});
+    auto traceStartupOption = addOption({QStringLiteral("trace-startup"),
+        QApplication::translate("CommandLine", "Write a trace of the startup in the Chrome trace event format to file."), QStringLiteral("filename")});
     addOption({QStringLiteral("cmd"), QApplication::translate("CommandLine", "Forward all arguments to the cmd client. This argument must be the first.")});
 
     // virtual file system parameters (optional)
@@ -168,6 +174,9 @@ CommandLineOptions parseOptions(const QStringList &arguments)
         out.logDebug = true;
         out.debugMode = true;
     }
+    if (parser.isSet(traceStartupOption)) {
+        out.traceStartupFile = parser.value(traceStartupOption);
+    }
 
     auto positionalArguments = parser.positionalArguments();
 
@@ -406,19 +415,28 @@ int main(int argc, char **argv)
             return cmd.exitCode();
         }
 
+        // the spans are recorded until the options are parsed
+        StartupTrace::instance();
+
         // load the resources
+        StartupTrace::Span resourcesSpan(QStringLiteral("Load resources"));
         const OCC::ResourcesLoader resource;
+        resourcesSpan.end();
 
         // Create a `Platform` instance so it can set-up/tear-down stuff for us, and do any
         // initialisation that needs to be done before creating a QApplication
+        StartupTrace::Span platformSpan(QStringLiteral("Create platform"));
         const auto platform = Platform::create();
+        platformSpan.end();
 
         // Create the (Q)Application instance:
+        StartupTrace::Span applicationSpan(QStringLiteral("Create QApplication"));
         QApplication app(argc, argv);
         app.setOrganizationDomain(Theme::instance()->orgDomainName());
         app.setApplicationName(Theme::instance()->piappName());
         app.setWindowIcon(Theme::instance()->applicationIcon());
         app.setApplicationVersion(Theme::instance()->versionSwitchOutput());
+        applicationSpan.end();
 
 #ifdef Q_OS_LINUX
         // HACK:
@@ -432,11 +450,14 @@ int main(int argc, char **argv)
 #endif
 
         // Load the translations before option parsing, so we can localize help text and error messages.
+        StartupTrace::Span translationsSpan(QStringLiteral("Load translations"));
         const QString displayLanguage = setupTranslations(&app);
+        translationsSpan.end();
 
         // parse the arguments before we handle singleApplication
         // errors and help/version need to be handled in this instance
         const auto options = parseOptions(app.arguments());
+        StartupTrace::instance().setOutputFile(options.traceStartupFile);
 
         KDSingleApplication singleApplication;
 
@@ -466,12 +487,14 @@ int main(int argc, char **argv)
         }
 
         setupLogging(options);
+        StallWatchdog::instance()->startFromEnvironment();
         NetworkInformation::instance(); //
 
         platform->setApplication(&app);
 
         auto folderManager = FolderMan::createInstance();
 
+        StartupTrace::Span accountsSpan(QStringLiteral("Restore accounts"));
         if (!AccountManager::instance()->restore()) {
             qCCritical(lcMain) << "Could not read the account settings, quitting";
             QMessageBox::critical(nullptr, QCoreApplication::translate("account loading", "Error accessing the configuration file"),
@@ -480,17 +503,28 @@ int main(int argc, char **argv)
                 QMessageBox::Close);
             return -1;
         }
+        accountsSpan.end();
+
+        // The connection checks of the accounts run while the folders and the gui are set up,
+        // the folders of each account are scheduled as soon as their own account is connected.
+        for (const auto &accountState : AccountManager::instance()->accounts()) {
+            accountState->checkConnectivity();
+        }
 
         // Setup the folders. This includes a downgrade-detection, in which case the return value
         // is empty. Note that the value 0 (zero) is a valid return value (non-empty), in which case
         // the dialog is not shown.
+        StartupTrace::Span foldersSpan(QStringLiteral("Set up folders"));
         if (!FolderMan::instance()->setupFolders().has_value()) {
             // Empty return value: there was a downgrade detected on one of the databases
             showDowngradeDialog();
             return -1;
         }
+        foldersSpan.end();
 
+        StartupTrace::Span guiSpan(QStringLiteral("Create application"));
         auto ocApp = Application::createInstance(platform.get(), displayLanguage, options.debugMode);
+        guiSpan.end();
 
         QObject::connect(platform.get(), &Platform::requestAttention, ocApp->gui(), &ownCloudGui::slotShowSettings);
 
@@ -542,6 +576,11 @@ int main(int argc, char **argv)
         // Now that everything is up and running, start accepting connections/requests from the shell integration.
         folderManager->socketApi()->startShellIntegration();
 
+        // the trace is written once the folders were started, see FolderMan::scheduleStartUp()
+        if (!folderManager->isStartingUp()) {
+            QTimer::singleShot(0, qApp, [] { StartupTrace::instance().finish(); });
+        }
+
         return app.exec();
     }).exec(argc, argv);
 }
@@ -36,6 +36,7 @@ ActivityListModel::ActivityListModel(QObject *parent)
 {
     connect(AccountManager::instance(), &AccountManager::accountRemoved, this, [this](const AccountStatePtr &accountStatePtr) {
         _activityLists.remove(accountStatePtr.get());
+        _activityEtags.remove(accountStatePtr.get());
         if (auto *job = _currentlyFetching.take(accountStatePtr.get())) {
             job->abort();
         }
@@ -187,10 +188,16 @@ void ActivityListModel::startFetchJob(AccountStatePtr ast)
         return;
     }
     auto *job = new JsonApiJob(ast->account(), QStringLiteral("ocs/v2.php/cloud/activity"), { { QStringLiteral("page"), QStringLiteral("0") }, { QStringLiteral("pagesize"), QStringLiteral("100") } }, {}, this);
+    job->setIfNoneMatch(_activityEtags.value(ast));
 
     QObject::connect(
         job, &JsonApiJob::finishedSignal, this, [job, ast, this] {
             _currentlyFetching.remove(ast);
+            if (job->notModified()) {
+                // only the successful answers are remembered
+                Q_EMIT activityJobStatusCode(ast, 200);
+                return;
+            }
             const auto activities = job->data().value(QStringLiteral("ocs")).toObject().value(QStringLiteral("data")).toArray();
 
             /*
@@ -214,11 +221,15 @@ void ActivityListModel::startFetchJob(AccountStatePtr ast)
                     QDateTime::fromString(json.value(QStringLiteral("date")).toString(), Qt::ISODate)});
             }
 
+            updateActivities(ast->account()->uuid(), list);
             _activityLists[ast] = std::move(list);
+            if (job->ocsSuccess()) {
+                _activityEtags[ast] = job->etag();
+            } else {
+                _activityEtags.remove(ast);
+            }
 
             Q_EMIT activityJobStatusCode(ast, job->ocsStatus());
-
-            combineActivityLists();
         });
 
     _currentlyFetching.insert(ast, job);
@@ -227,13 +238,52 @@ void ActivityListModel::startFetchJob(AccountStatePtr ast)
 }
 
 
-void ActivityListModel::combineActivityLists()
+void ActivityListModel::updateActivities(const QUuid &accountUuid, const ActivityList &activities)
 {
-    ActivityList resultList;
-    for (const ActivityList &list : std::as_const(_activityLists)) {
-        resultList.append(list);
+    QSet<QString> newIds;
+    newIds.reserve(activities.size());
+    for (const auto &activity : activities) {
+        newIds.insert(activity.id());
+    }
+
+    // remove the rows of the account that are gone, from the back to keep the indices valid
+    QSet<QString> existingIds;
+    int rangeEnd = -1;
+    const auto removeRange = [&](int first) {
+        if (rangeEnd >= first) {
+            beginRemoveRows(QModelIndex(), first, rangeEnd);
+            _finalList.erase(_finalList.begin() + first, _finalList.begin() + rangeEnd + 1);
+            endRemoveRows();
+        }
+        rangeEnd = -1;
+    };
+    for (int row = static_cast<int>(_finalList.size()) - 1; row >= 0; --row) {
+        const auto &activity = _finalList.at(row);
+        if (activity.accountUuid() == accountUuid && !newIds.contains(activity.id())) {
+            if (rangeEnd == -1) {
+                rangeEnd = row;
+            }
+        } else {
+            removeRange(row + 1);
+            if (activity.accountUuid() == accountUuid) {
+                existingIds.insert(activity.id());
+            }
+        }
+    }
+    removeRange(0);
+
+    ActivityList added;
+    for (const auto &activity : activities) {
+        if (!existingIds.contains(activity.id())) {
+            added.append(activity);
+        }
+    }
+    if (!added.isEmpty()) {
+        const int first = static_cast<int>(_finalList.size());
+        beginInsertRows(QModelIndex(), first, first + static_cast<int>(added.size()) - 1);
+        _finalList.append(std::move(added));
+        endInsertRows();
     }
-    setActivityList(std::move(resultList));
 }
 
 void ActivityListModel::setActivityList(const ActivityList &&resultList)
@@ -255,8 +305,9 @@ void ActivityListModel::fetchMore(const QModelIndex &)
 
 void ActivityListModel::slotRefreshActivity(const AccountStatePtr &ast)
 {
-    if (ast && _activityLists.contains(ast)) {
-        _activityLists.remove(ast);
+    // the current activities are kept until the new ones arrived, only the differences are applied
+    if (ast && _currentlyFetching.contains(ast)) {
+        return;
     }
     startFetchJob(ast);
 }
@@ -280,6 +331,7 @@ void ActivityListModel::slotRemoveAccount(AccountStatePtr ast)
             }
         }
         _activityLists.remove(ast);
+        _activityEtags.remove(ast);
         _currentlyFetching.remove(ast);
     }
 }
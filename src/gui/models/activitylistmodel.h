@@ -72,11 +72,19 @@ Q_SIGNALS:
 private:
     void setActivityList(const ActivityList &&resultList);
     void startFetchJob(AccountStatePtr s);
-    void combineActivityLists();
+
+    /** Replaces the activities of the account \a accountUuid with \a activities
+     *
+     * Only the rows of activities that are no longer reported are removed and
+     * the new activities are appended, the view is not reset.
+     */
+    void updateActivities(const QUuid &accountUuid, const ActivityList &activities);
 
     QMap<AccountState *, ActivityList> _activityLists;
     ActivityList _finalList;
     QMap<AccountState *, AbstractNetworkJob *> _currentlyFetching;
+    // the ETags of the activities in _activityLists, unchanged ones are not fetched again
+    QMap<AccountState *, QByteArray> _activityEtags;
 
     friend class TestActivityModel;
 };
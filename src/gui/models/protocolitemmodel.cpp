@@ -21,6 +21,7 @@
 #include "theme.h"
 
 #include <QIcon>
+#include <QTimer>
 
 using namespace OCC;
 
@@ -172,14 +173,40 @@ QVariant ProtocolItemModel::headerData(int section, Qt::Orientation orientation,
 
 void ProtocolItemModel::addProtocolItem(ProtocolItem &&item)
 {
-    if (_data.isFull()) {
-        beginRemoveRows(QModelIndex(), 0, 0);
-        _data.pop_front();
+    if (_pendingItems.empty()) {
+        QTimer::singleShot(0, this, &ProtocolItemModel::flushPendingItems);
+    }
+    _pendingItems.push_back(std::move(item));
+}
+
+void ProtocolItemModel::flushPendingItems()
+{
+    if (_pendingItems.empty()) {
+        return;
+    }
+    auto pending = std::move(_pendingItems);
+    _pendingItems.clear();
+
+    // only the newest items fit
+    auto first = pending.begin();
+    if (pending.size() > _data.capacity()) {
+        first = pending.end() - static_cast<std::ptrdiff_t>(_data.capacity());
+    }
+    const auto count = static_cast<size_t>(pending.end() - first);
+
+    if (_data.size() + count > _data.capacity()) {
+        const auto overflow = _data.size() + count - _data.capacity();
+        beginRemoveRows(QModelIndex(), 0, static_cast<int>(overflow) - 1);
+        for (size_t i = 0; i < overflow; ++i) {
+            _data.pop_front();
+        }
         endRemoveRows();
     }
     const auto size = static_cast<int>(_data.size());
-    beginInsertRows(QModelIndex(), size, size);
-    _data.push_back(std::move(item));
+    beginInsertRows(QModelIndex(), size, size + static_cast<int>(count) - 1);
+    for (auto it = first; it != pending.end(); ++it) {
+        _data.push_back(std::move(*it));
+    }
     endInsertRows();
 }
 
@@ -192,16 +219,47 @@ const ProtocolItem &ProtocolItemModel::protocolItem(const QModelIndex &index) co
 void ProtocolItemModel::reset(std::vector<ProtocolItem> &&data)
 {
     beginResetModel();
+    _pendingItems.clear();
     _data.reset(std::move(data));
     endResetModel();
 }
 
 void ProtocolItemModel::remove_if(const std::function<bool(const ProtocolItem &)> &filter)
 {
+    flushPendingItems();
     if (_data.empty()) {
         return;
     }
-    beginResetModel();
-    _data.remove_if(filter);
-    endResetModel();
+
+    // the matching rows as ranges of consecutive rows, the filter is called once per row
+    std::vector<bool> matches(_data.size());
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t i = 0; i < _data.size(); ++i) {
+        matches[i] = filter(_data.at(i));
+        if (matches[i]) {
+            if (!ranges.empty() && ranges.back().second == i) {
+                ranges.back().second++;
+            } else {
+                ranges.emplace_back(i, i + 1);
+            }
+        }
+    }
+
+    // Removing the ranges one by one keeps the selection and the scroll position of the
+    // views, but each removal moves the following rows.
+    constexpr size_t maximumRemovals = 64;
+    if (ranges.size() > maximumRemovals) {
+        beginResetModel();
+        // visits the rows in order
+        size_t row = 0;
+        _data.remove_if([&matches, &row](const ProtocolItem &) { return matches[row++]; });
+        endResetModel();
+        return;
+    }
+    // from the back, so the rows of the remaining ranges don't change
+    for (auto it = ranges.crbegin(); it != ranges.crend(); ++it) {
+        beginRemoveRows(QModelIndex(), static_cast<int>(it->first), static_cast<int>(it->second) - 1);
+        _data.erase(it->first, it->second - it->first);
+        endRemoveRows();
+    }
 }
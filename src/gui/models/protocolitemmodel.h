@@ -52,28 +52,38 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
+    /**
+     * The items added during one iteration of the event loop are inserted
+     * together, see flushPendingItems()
+     */
     void addProtocolItem(ProtocolItem &&item);
     const ProtocolItem &protocolItem(const QModelIndex &index) const;
 
+    /** Insert the items added since the last insertion right away */
+    void flushPendingItems();
+
     bool isModelFull() const
     {
         return _data.isFull();
     }
 
     /**
-     * Return underlying unordered raw data
+     * Return underlying unordered raw data, including the pending items
      */
-    auto rawData() const
+    const FixedSizeRingBuffer<ProtocolItem> &rawData()
     {
+        flushPendingItems();
         return _data;
     }
 
     void reset(std::vector<ProtocolItem> &&data);
 
+    /** Removes the matching rows, the others keep their order */
     void remove_if(const std::function<bool(const ProtocolItem &)> &filter);
 
 private:
     FixedSizeRingBuffer<ProtocolItem> _data;
+    std::vector<ProtocolItem> _pendingItems;
     bool _issueMode;
     int _maxLogSize;
 
@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#include "selectivesyncmodel.h"
+
+#include "common/utility.h"
+#include "libsync/theme.h"
+
+#include "resources/resources.h"
+
+#include <QCollator>
+
+#include <algorithm>
+
+using namespace OCC;
+
+struct SelectiveSyncModel::Node
+{
+    enum class State {
+        NotListed,
+        Listing,
+        Listed
+    };
+
+    Node *parent = nullptr;
+    // the position in the children of the parent
+    int row = 0;
+    QString name;
+    // without a trailing /, empty for the root
+    QString path;
+    QString etag;
+    qint64 size = -1;
+    Qt::CheckState checkState = Qt::Checked;
+    State state = State::NotListed;
+    std::vector<std::unique_ptr<Node>> children;
+    // the first children that are rows of the model
+    int shown = 0;
+};
+
+SelectiveSyncModel::SelectiveSyncModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+    clear();
+}
+
+SelectiveSyncModel::~SelectiveSyncModel() = default;
+
+void SelectiveSyncModel::setRoot(const QString &rootName, qint64 size, const QSet<QString> &oldBlackList)
+{
+    beginResetModel();
+    _top = std::make_unique<Node>();
+    auto root = std::make_unique<Node>();
+    root->parent = _top.get();
+    root->name = rootName;
+    root->size = size;
+    // the root is listed by the widget before it is created
+    root->state = Node::State::Listing;
+    _root = root.get();
+    _top->children.push_back(std::move(root));
+    _top->shown = 1;
+    _top->state = Node::State::Listed;
+    _oldBlackList = oldBlackList;
+    endResetModel();
+}
+
+void SelectiveSyncModel::clear()
+{
+    beginResetModel();
+    _top = std::make_unique<Node>();
+    _top->state = Node::State::Listed;
+    _root = nullptr;
+    _oldBlackList.clear();
+    endResetModel();
+}
+
+void SelectiveSyncModel::setListing(const QString &path, const QVector<RemoteListingCache::Folder> &folders)
+{
+    Node *node = find(path);
+    if (!node || node->state == Node::State::Listed) {
+        return;
+    }
+
+    const auto childPath = [&path](const QString &name) { return path.isEmpty() ? name : path + QLatin1Char('/') + name; };
+
+    // Since / cannot be in the blacklist, expand it to the actual
+    // list of top-level folders as soon as possible.
+    if (_oldBlackList.size() == 1 && _oldBlackList.contains(QStringLiteral("/"))) {
+        _oldBlackList.clear();
+        for (const auto &folder : folders) {
+            _oldBlackList.insert(childPath(folder.name) + QLatin1Char('/'));
+        }
+    }
+
+    node->children.reserve(folders.size());
+    for (const auto &folder : folders) {
+        auto child = std::make_unique<Node>();
+        child->parent = node;
+        child->name = folder.name;
+        child->path = childPath(folder.name);
+        child->etag = folder.etag;
+        child->size = folder.size;
+        if (node->checkState == Qt::Unchecked) {
+            child->checkState = Qt::Unchecked;
+        } else {
+            const QString blackListPath = child->path + QLatin1Char('/');
+            for (const auto &str : std::as_const(_oldBlackList)) {
+                if (str == blackListPath || str == QLatin1Char('/')) {
+                    child->checkState = Qt::Unchecked;
+                    break;
+                } else if (str.startsWith(blackListPath)) {
+                    child->checkState = Qt::PartiallyChecked;
+                }
+            }
+        }
+        node->children.push_back(std::move(child));
+    }
+    node->state = Node::State::Listed;
+    sortChildren(node);
+
+    // Root is partially checked if any children are not checked
+    if (node == _root
+        && std::any_of(node->children.cbegin(), node->children.cend(), [](const auto &child) { return child->checkState != Qt::Checked; })) {
+        setCheckState(node, Qt::PartiallyChecked);
+    }
+
+    const auto index = indexOf(node);
+    if (!index.isValid()) {
+        return;
+    }
+    if (node->children.empty()) {
+        // hides the expansion indicator
+        Q_EMIT dataChanged(index, index);
+    } else {
+        insertPage(node);
+    }
+}
+
+bool SelectiveSyncModel::showMore(const QModelIndex &parent)
+{
+    Node *n = node(parent);
+    if (n == _top.get() || n->shown >= static_cast<int>(n->children.size()) || !indexOf(n).isValid()) {
+        return false;
+    }
+    insertPage(n);
+    return true;
+}
+
+void SelectiveSyncModel::insertPage(Node *node)
+{
+    const int count = std::min(PageSize, static_cast<int>(node->children.size()) - node->shown);
+    beginInsertRows(indexOf(node), node->shown, node->shown + count - 1);
+    node->shown += count;
+    endInsertRows();
+}
+
+QString SelectiveSyncModel::path(const QModelIndex &index) const
+{
+    return node(index)->path;
+}
+
+QModelIndex SelectiveSyncModel::rootIndex() const
+{
+    return indexOf(_root);
+}
+
+QSet<QString> SelectiveSyncModel::createBlackList() const
+{
+    if (!_root) {
+        return {};
+    }
+    return createBlackList(_root);
+}
+
+QSet<QString> SelectiveSyncModel::createBlackList(const Node *node) const
+{
+    switch (node->checkState) {
+    case Qt::Unchecked:
+        return {node->path + QLatin1Char('/')};
+    case Qt::Checked:
+        return {};
+    case Qt::PartiallyChecked:
+        break;
+    }
+
+    QSet<QString> result;
+    if (!node->children.empty()) {
+        for (const auto &child : node->children) {
+            result += createBlackList(child.get());
+        }
+    } else {
+        // We did not load from the server so we re-use the one from the old black list
+        for (const auto &it : _oldBlackList) {
+            if (it.startsWith(node->path)) {
+                result += it;
+            }
+        }
+    }
+    return result;
+}
+
+qint64 SelectiveSyncModel::estimatedSize() const
+{
+    if (!_root) {
+        return -1;
+    }
+    return estimatedSize(_root);
+}
+
+qint64 SelectiveSyncModel::estimatedSize(const Node *node) const
+{
+    switch (node->checkState) {
+    case Qt::Unchecked:
+        return 0;
+    case Qt::Checked:
+        return std::max<qint64>(node->size, 0);
+    case Qt::PartiallyChecked:
+        break;
+    }
+
+    if (node->children.empty()) {
+        // We did not load from the server so we have no idea how much we will sync from this branch
+        return -1;
+    }
+    qint64 result = 0;
+    for (const auto &child : node->children) {
+        const auto size = estimatedSize(child.get());
+        if (size < 0) {
+            return size;
+        }
+        result += size;
+    }
+    return result;
+}
+
+SelectiveSyncModel::Node *SelectiveSyncModel::node(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return _top.get();
+    }
+    return static_cast<Node *>(index.internalPointer());
+}
+
+QModelIndex SelectiveSyncModel::indexOf(Node *node, int column) const
+{
+    if (!node || node == _top.get() || node->row >= node->parent->shown) {
+        return {};
+    }
+    return createIndex(node->row, column, node);
+}
+
+SelectiveSyncModel::Node *SelectiveSyncModel::find(const QString &path) const
+{
+    Node *node = _root;
+    const auto names = path.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    for (const auto &name : names) {
+        if (!node) {
+            break;
+        }
+        const auto it = std::find_if(node->children.cbegin(), node->children.cend(), [&name](const auto &child) { return child->name == name; });
+        node = it != node->children.cend() ? it->get() : nullptr;
+    }
+    return node;
+}
+
+void SelectiveSyncModel::sortChildren(Node *node)
+{
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    const auto lessThan = [&](const std::unique_ptr<Node> &a, const std::unique_ptr<Node> &b) {
+        const auto &[first, second] = _sortOrder == Qt::AscendingOrder ? std::tie(a, b) : std::tie(b, a);
+        if (_sortColumn == static_cast<int>(Column::Size) && first->size != second->size) {
+            return first->size < second->size;
+        }
+        return collator.compare(first->name, second->name) < 0;
+    };
+    // the shown rows stay shown, the pages that are not shown yet follow in order
+    std::stable_sort(node->children.begin(), node->children.begin() + node->shown, lessThan);
+    std::stable_sort(node->children.begin() + node->shown, node->children.end(), lessThan);
+    for (int i = 0; i < static_cast<int>(node->children.size()); ++i) {
+        node->children[i]->row = i;
+    }
+}
+
+void SelectiveSyncModel::changeCheckState(Node *node, Qt::CheckState state)
+{
+    if (state != Qt::PartiallyChecked) {
+        // the children follow the state of their parent
+        const auto setSubtree = [this](Node *node, Qt::CheckState state, const auto &setSubtree) -> void {
+            for (const auto &child : node->children) {
+                child->checkState = state;
+                setSubtree(child.get(), state, setSubtree);
+            }
+            if (node->shown > 0 && indexOf(node).isValid()) {
+                Q_EMIT dataChanged(index(0, 0, indexOf(node)), index(node->shown - 1, 0, indexOf(node)), {Qt::CheckStateRole});
+            }
+        };
+        setSubtree(node, state, setSubtree);
+    }
+    // Can't uncheck the root.
+    setCheckState(node, node == _root && state == Qt::Unchecked ? Qt::PartiallyChecked : state);
+
+    for (Node *child = node; child->parent != _top.get(); child = child->parent) {
+        Node *parent = child->parent;
+        Qt::CheckState parentState = parent->checkState;
+        switch (child->checkState) {
+        case Qt::Checked:
+            // If we are checked, check that we may need to check the parent as well if
+            // all the siblings are also checked
+            if (std::all_of(parent->children.cbegin(), parent->children.cend(), [](const auto &sibling) { return sibling->checkState == Qt::Checked; })) {
+                parentState = Qt::Checked;
+            } else if (parentState == Qt::Unchecked) {
+                parentState = Qt::PartiallyChecked;
+            }
+            break;
+        case Qt::Unchecked:
+            if (parentState == Qt::Checked) {
+                parentState = Qt::PartiallyChecked;
+            }
+            break;
+        case Qt::PartiallyChecked:
+            parentState = Qt::PartiallyChecked;
+            break;
+        }
+        if (parentState == parent->checkState) {
+            break;
+        }
+        setCheckState(parent, parentState);
+    }
+}
+
+void SelectiveSyncModel::setCheckState(Node *node, Qt::CheckState state)
+{
+    node->checkState = state;
+    const auto index = indexOf(node);
+    if (index.isValid()) {
+        Q_EMIT dataChanged(index, index, {Qt::CheckStateRole});
+    }
+}
+
+QModelIndex SelectiveSyncModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent)) {
+        return {};
+    }
+    return createIndex(row, column, node(parent)->children[row].get());
+}
+
+QModelIndex SelectiveSyncModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return {};
+    }
+    return indexOf(node(index)->parent);
+}
+
+int SelectiveSyncModel::rowCount(const QModelIndex &parent) const
+{
+    Q_ASSERT(checkIndex(parent));
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return node(parent)->shown;
+}
+
+int SelectiveSyncModel::columnCount(const QModelIndex &parent) const
+{
+    Q_ASSERT(checkIndex(parent));
+    return static_cast<int>(Column::ColumnCount);
+}
+
+bool SelectiveSyncModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return false;
+    }
+    const Node *n = node(parent);
+    // a folder that is not listed yet might have subfolders
+    return n->state != Node::State::Listed || !n->children.empty();
+}
+
+QVariant SelectiveSyncModel::data(const QModelIndex &index, int role) const
+{
+    Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
+    const Node *n = node(index);
+    switch (static_cast<Column>(index.column())) {
+    case Column::Name:
+        switch (role) {
+        case Qt::DisplayRole:
+            return n->name;
+        case Qt::DecorationRole:
+            return n == _root ? Theme::instance()->applicationIcon() : Resources::getCoreIcon(QStringLiteral("folder-sync"));
+        case Qt::ToolTipRole:
+            if (n != _root) {
+                return n->path;
+            }
+            break;
+        case Qt::CheckStateRole:
+            return static_cast<int>(n->checkState);
+        }
+        break;
+    case Column::Size:
+        if (role == Qt::DisplayRole && n->size >= 0) {
+            return Utility::octetsToString(n->size);
+        }
+        break;
+    case Column::ColumnCount:
+        Q_UNREACHABLE();
+    }
+    return {};
+}
+
+bool SelectiveSyncModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.column() != static_cast<int>(Column::Name) || role != Qt::CheckStateRole) {
+        return false;
+    }
+    changeCheckState(node(index), static_cast<Qt::CheckState>(value.toInt()));
+    return true;
+}
+
+Qt::ItemFlags SelectiveSyncModel::flags(const QModelIndex &index) const
+{
+    auto out = QAbstractItemModel::flags(index);
+    if (index.column() == static_cast<int>(Column::Name)) {
+        out |= Qt::ItemIsUserCheckable;
+    }
+    return out;
+}
+
+QVariant SelectiveSyncModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (static_cast<Column>(section)) {
+        case Column::Name:
+            return tr("Name");
+        case Column::Size:
+            return tr("Size");
+        case Column::ColumnCount:
+            Q_UNREACHABLE();
+        }
+    }
+    return {};
+}
+
+bool SelectiveSyncModel::canFetchMore(const QModelIndex &parent) const
+{
+    return parent.isValid() && node(parent)->state == Node::State::NotListed;
+}
+
+void SelectiveSyncModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    Node *n = node(parent);
+    n->state = Node::State::Listing;
+    Q_EMIT listingRequested(n->path, n->etag);
+}
+
+void SelectiveSyncModel::sort(int column, Qt::SortOrder order)
+{
+    _sortColumn = column;
+    _sortOrder = order;
+    if (!_root) {
+        return;
+    }
+    Q_EMIT layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    const auto oldIndexes = persistentIndexList();
+    const auto sortTree = [this](Node *node, const auto &sortTree) -> void {
+        sortChildren(node);
+        for (int i = 0; i < node->shown; ++i) {
+            sortTree(node->children[i].get(), sortTree);
+        }
+    };
+    sortTree(_root, sortTree);
+    QModelIndexList newIndexes;
+    newIndexes.reserve(oldIndexes.size());
+    for (const auto &index : oldIndexes) {
+        newIndexes.append(indexOf(node(index), index.column()));
+    }
+    changePersistentIndexList(oldIndexes, newIndexes);
+    Q_EMIT layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "gui/owncloudguilib.h"
+
+#include "libsync/remotelistingcache.h"
+
+#include <QAbstractItemModel>
+#include <QSet>
+
+#include <memory>
+#include <vector>
+
+namespace OCC {
+
+/**
+ * @brief The remote folder tree of the SelectiveSyncWidget
+ * @ingroup gui
+ *
+ * A folder is listed when the view first fetches its rows, see listingRequested().
+ * Its subfolders are then shown in pages of PageSize rows, so a folder with tens
+ * of thousands of subfolders doesn't create all of its rows at once. The check
+ * states cover all subfolders of a listing, shown or not.
+ *
+ * QTreeView calls fetchMore() on every layout of an expanded folder, so the
+ * further pages are shown by showMore() once the view is scrolled to its end.
+ */
+class OWNCLOUDGUI_EXPORT SelectiveSyncModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum class Column {
+        Name,
+        Size,
+
+        ColumnCount
+    };
+    Q_ENUM(Column)
+
+    /// The rows shown at once by setListing() and showMore()
+    static constexpr int PageSize = 500;
+
+    explicit SelectiveSyncModel(QObject *parent = nullptr);
+    ~SelectiveSyncModel() override;
+
+    /**
+     * Starts over with a root item named \a rootName of \a size bytes, -1 if unknown.
+     * \a oldBlackList is a list of excluded paths, each including a trailing /
+     */
+    void setRoot(const QString &rootName, qint64 size, const QSet<QString> &oldBlackList);
+    void clear();
+    bool hasRoot() const { return _root != nullptr; }
+
+    /// Set the subfolders of the folder at \a path, the root is the empty path
+    void setListing(const QString &path, const QVector<RemoteListingCache::Folder> &folders);
+
+    /// Shows the next page of the subfolders of \a parent, returns false if all are shown
+    bool showMore(const QModelIndex &parent);
+
+    /// The path of the folder at \a index, without a trailing /
+    QString path(const QModelIndex &index) const;
+    QModelIndex rootIndex() const;
+
+    /// Returns a list of blacklisted paths, each including the trailing /
+    QSet<QString> createBlackList() const;
+
+    /// Estimates the total size of the checked folders, -1 if it is not known
+    qint64 estimatedSize() const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+    bool hasChildren(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    void sort(int column, Qt::SortOrder order) override;
+
+Q_SIGNALS:
+    /**
+     * The folder at \a path was expanded for the first time and needs to be listed,
+     * \a etag is the one of its entry in the listing of its parent
+     */
+    void listingRequested(const QString &path, const QString &etag);
+
+private:
+    struct Node;
+
+    Node *node(const QModelIndex &index) const;
+    QModelIndex indexOf(Node *node, int column = 0) const;
+    Node *find(const QString &path) const;
+    void insertPage(Node *node);
+    void sortChildren(Node *node);
+    // sets the state of \a node and updates its parent and children like a user would expect
+    void changeCheckState(Node *node, Qt::CheckState state);
+    void setCheckState(Node *node, Qt::CheckState state);
+    QSet<QString> createBlackList(const Node *node) const;
+    qint64 estimatedSize(const Node *node) const;
+
+    // the invisible parent of the root item
+    std::unique_ptr<Node> _top;
+    Node *_root = nullptr;
+    QSet<QString> _oldBlackList;
+    int _sortColumn = 0;
+    Qt::SortOrder _sortOrder = Qt::AscendingOrder;
+};
+}
@@ -123,6 +123,14 @@ ownCloudGui::ownCloudGui(Application *parent)
     setupActions();
     setupContextMenu();
 
+    _overallSyncStatusTimer.setInterval(500ms);
+    _overallSyncStatusTimer.setSingleShot(true);
+    connect(&_overallSyncStatusTimer, &QTimer::timeout, this, [this] {
+        if (_overallSyncStatusPending) {
+            slotComputeOverallSyncStatus();
+        }
+    });
+
     // init systry
     slotComputeOverallSyncStatus();
     _tray->show();
@@ -191,7 +199,7 @@ void ownCloudGui::slotTrayClicked(QSystemTrayIcon::ActivationReason reason)
 
 void ownCloudGui::slotSyncStateChange(Folder *folder)
 {
-    slotComputeOverallSyncStatus();
+    scheduleOverallSyncStatus();
     updateContextMenuNeeded();
 
     if (!folder) {
@@ -205,7 +213,7 @@ void ownCloudGui::slotSyncStateChange(Folder *folder)
 
 void ownCloudGui::slotFoldersChanged()
 {
-    slotComputeOverallSyncStatus();
+    scheduleOverallSyncStatus();
     updateContextMenuNeeded();
 }
 
@@ -217,7 +225,7 @@ void ownCloudGui::slotOpenPath(const QString &path)
 void ownCloudGui::slotAccountStateChanged()
 {
     updateContextMenuNeeded();
-    slotComputeOverallSyncStatus();
+    scheduleOverallSyncStatus();
 }
 
 void ownCloudGui::slotTrayMessageIfServerUnsupported(Account *account)
@@ -231,8 +239,21 @@ void ownCloudGui::slotTrayMessageIfServerUnsupported(Account *account)
     }
 }
 
+void ownCloudGui::scheduleOverallSyncStatus()
+{
+    // the first change is shown right away, the ones following it within the interval are collected into one update
+    if (_overallSyncStatusTimer.isActive()) {
+        _overallSyncStatusPending = true;
+        return;
+    }
+    slotComputeOverallSyncStatus();
+}
+
 void ownCloudGui::slotComputeOverallSyncStatus()
 {
+    _overallSyncStatusPending = false;
+    _overallSyncStatusTimer.start();
+
     auto getIcon = [this](const SyncResult &result) { return Theme::instance()->themeTrayIcon(result, contextMenuVisible()); };
     auto getIconFromStatus = [getIcon](const SyncResult::Status &status) { return getIcon(SyncResult{status}); };
     bool allSignedOut = true;
@@ -82,6 +82,8 @@ public Q_SLOTS:
     void slotContextMenuAboutToShow();
     void slotContextMenuAboutToHide();
     void slotComputeOverallSyncStatus();
+    /// Computes the overall status now, or once the rate limit allows it
+    void scheduleOverallSyncStatus();
     void slotShowTrayMessage(const QString &title, const QString &msg, const QIcon &icon = {});
     void slotShowOptionalTrayMessage(const QString &title, const QString &msg, const QIcon &icon = {});
     void slotFolderOpenAction(Folder *f);
@@ -133,6 +135,9 @@ private:
     bool _workaroundFakeDoubleClick = false;
     bool _workaroundManualVisibility = false;
     QTimer _delayedTrayUpdateTimer;
+    // limits the rate of the tray icon and tooltip updates while syncing
+    QTimer _overallSyncStatusTimer;
+    bool _overallSyncStatusPending = false;
     QPointer<ShareDialog> _shareDialog;
 
     QAction *_actionStatus;
@@ -37,8 +37,8 @@ ProtocolWidget::ProtocolWidget(QWidget *parent)
 {
     _ui->setupUi(this);
 
-    connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemCompleted,
-        this, &ProtocolWidget::slotItemCompleted);
+    connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemsCompleted,
+        this, &ProtocolWidget::slotItemsCompleted);
 
     connect(_ui->_tableView, &QTreeWidget::customContextMenuRequested, this, &ProtocolWidget::slotItemContextMenu);
 
@@ -201,11 +201,13 @@ void ProtocolWidget::slotItemContextMenu(const QPoint &pos)
     showContextMenu(this, _ui->_tableView, _sortModel, _model, rows, pos);
 }
 
-void ProtocolWidget::slotItemCompleted(Folder *folder, const SyncFileItemPtr &item)
+void ProtocolWidget::slotItemsCompleted(Folder *folder, const QVector<SyncFileItemPtr> &items)
 {
-    if (!item->showInProtocolTab())
-        return;
-    _model->addProtocolItem(ProtocolItem { folder, item });
+    for (const auto &item : items) {
+        if (item->showInProtocolTab()) {
+            _model->addProtocolItem(ProtocolItem { folder, item });
+        }
+    }
 }
 
 void ProtocolWidget::filterDidChange()
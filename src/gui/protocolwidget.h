@@ -55,7 +55,7 @@ public:
     static QMenu *showFilterMenu(QWidget *parent, Models::SignalledQSortFilterProxyModel *model, int role, const QString &columnName);
 
 public Q_SLOTS:
-    void slotItemCompleted(Folder *folder, const SyncFileItemPtr &item);
+    void slotItemsCompleted(Folder *folder, const QVector<SyncFileItemPtr> &items);
     void filterDidChange();
 
 private Q_SLOTS:
@@ -19,7 +19,9 @@
 #include "creds/abstractcredentials.h"
 #include <theme.h>
 
-#include <QTimer>
+#include <QDir>
+
+#include <algorithm>
 
 using namespace std::chrono_literals;
 
@@ -38,10 +40,20 @@ QuotaInfo::QuotaInfo(AccountState *parent)
     , _active(false)
 {
     connect(parent, &AccountState::stateChanged, this, &QuotaInfo::slotAccountStateChanged);
-    connect(&_jobRestartTimer, &QTimer::timeout, this, &QuotaInfo::slotCheckQuota);
+    connect(&_jobRestartTimer, &CoalescedTimer::timeout, this, &QuotaInfo::slotCheckQuota);
     _jobRestartTimer.setSingleShot(true);
 }
 
+qint64 QuotaInfo::freshQuotaAvailableBytes() const
+{
+    // a total of 0 means that no quota was received
+    if (_lastQuotaTotalBytes <= 0 || _lastQuotaRecieved.isNull()
+        || std::chrono::seconds(_lastQuotaRecieved.secsTo(QDateTime::currentDateTime())) >= 2 * defaultIntervalT) {
+        return -1;
+    }
+    return std::max<qint64>(0, _lastQuotaTotalBytes - _lastQuotaUsedBytes);
+}
+
 void QuotaInfo::setActive(bool active)
 {
     _active = active;
@@ -105,12 +117,28 @@ void QuotaInfo::slotCheckQuota()
     _job->start();
 }
 
+void QuotaInfo::updateFromListing(const QString &remotePath, const RemoteQuota &quota)
+{
+    if (QDir::cleanPath(remotePath) != QDir::cleanPath(quotaBaseFolder())) {
+        return;
+    }
+    if (_job) {
+        // the running request will be as fresh
+        return;
+    }
+    setQuota(quota.availableBytes, quota.usedBytes);
+}
+
 void QuotaInfo::slotUpdateLastQuota(const QString &, const QMap<QString, QString> &result)
 {
     // The server can return fractional bytes (#1374)
     // <d:quota-available-bytes>1374532061.2</d:quota-available-bytes>
-    qint64 avail = result[QStringLiteral("quota-available-bytes")].toDouble();
-    _lastQuotaUsedBytes = result[QStringLiteral("quota-used-bytes")].toDouble();
+    setQuota(result[QStringLiteral("quota-available-bytes")].toDouble(), result[QStringLiteral("quota-used-bytes")].toDouble());
+}
+
+void QuotaInfo::setQuota(qint64 avail, qint64 used)
+{
+    _lastQuotaUsedBytes = used;
     // negative value of the available quota have special meaning (#3940)
     _lastQuotaTotalBytes = avail >= 0 ? _lastQuotaUsedBytes + avail : avail;
     Q_EMIT quotaUpdated(_lastQuotaTotalBytes, _lastQuotaUsedBytes);
@@ -18,13 +18,14 @@
 #include <QObject>
 #include <QPointer>
 #include <QVariant>
-#include <QTimer>
 #include <QDateTime>
 
 #include "libsync/accountfwd.h"
+#include "libsync/coalescedtimer.h"
 
 namespace OCC {
 class PropfindJob;
+struct RemoteQuota;
 
 /**
  * @brief handles getting the quota to display in the UI
@@ -42,6 +43,9 @@ class PropfindJob;
  *
  * If the quota job is not finished within 30 seconds, it is cancelled and another one is started
  *
+ * A sync of the quota base folder lists the quota of its root, that replaces the next request,
+ * see updateFromListing().
+ *
  * @ingroup gui
  */
 
@@ -55,6 +59,13 @@ public:
     qint64 lastQuotaTotalBytes() const { return _lastQuotaTotalBytes; }
     qint64 lastQuotaUsedBytes() const { return _lastQuotaUsedBytes; }
 
+    /**
+     * The bytes that can still be uploaded, negative if that is unknown or unlimited
+     *
+     * The quota is only requested while the quota info is active, an older quota is unknown.
+     */
+    qint64 freshQuotaAvailableBytes() const;
+
     /**
      * When the quotainfo is active, it requests the quota at regular interval.
      * When setting it to active it will request the quota immediately if the last time
@@ -62,6 +73,12 @@ public:
      */
     void setActive(bool active);
 
+    /**
+     * Takes the \a quota of \a remotePath listed by a sync, it is used like a
+     * requested one if \a remotePath is the quota base folder
+     */
+    void updateFromListing(const QString &remotePath, const RemoteQuota &quota);
+
 public Q_SLOTS:
     void slotCheckQuota();
 
@@ -75,6 +92,7 @@ Q_SIGNALS:
 
 private:
     bool canGetQuota() const;
+    void setQuota(qint64 avail, qint64 used);
 
     /// Returns the folder that quota shall be retrieved for
     QString quotaBaseFolder() const;
@@ -82,7 +100,7 @@ private:
     AccountState *_accountState;
     qint64 _lastQuotaTotalBytes;
     qint64 _lastQuotaUsedBytes;
-    QTimer _jobRestartTimer;
+    CoalescedTimer _jobRestartTimer;
     QDateTime _lastQuotaRecieved; // the time at which the quota was received last
     bool _active; // if we should check at regular interval (when the UI is visible)
     QPointer<PropfindJob> _job; // the currently running job
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "gui/scheduling/bandwidthschedule.h"
+
+#include "gui/networkinformation.h"
+
+#include <QLoggingCategory>
+
+using namespace std::chrono_literals;
+
+using namespace OCC;
+
+Q_LOGGING_CATEGORY(lcBandwidthSchedule, "gui.scheduler.bandwidth", QtInfoMsg)
+
+namespace {
+bool inWindow(const ConfigFile::BandwidthScheduleEntry &entry, const QDateTime &now)
+{
+    const QTime time = now.time();
+    const QDate date = now.date();
+    auto dayMatches = [&entry](const QDate &day) { return entry.days.isEmpty() || entry.days.contains(static_cast<Qt::DayOfWeek>(day.dayOfWeek())); };
+
+    if (entry.start == entry.end) {
+        // the whole day
+        return dayMatches(date);
+    }
+    if (entry.start < entry.end) {
+        return dayMatches(date) && time >= entry.start && time < entry.end;
+    }
+    // the window spans midnight, the days refer to the day the window starts on
+    return (dayMatches(date) && time >= entry.start) || (dayMatches(date.addDays(-1)) && time < entry.end);
+}
+}
+
+BandwidthSchedule::BandwidthSchedule(QObject *parent)
+    : QObject(parent)
+    , _profile(currentProfile())
+{
+    _timer.setInterval(1min);
+    connect(&_timer, &QTimer::timeout, this, &BandwidthSchedule::update);
+    _timer.start();
+    connect(NetworkInformation::instance(), &NetworkInformation::isMeteredChanged, this, &BandwidthSchedule::update);
+}
+
+BandwidthSchedule::Limits BandwidthSchedule::currentLimits() const
+{
+    return limits(currentProfile());
+}
+
+ConfigFile::BandwidthProfile BandwidthSchedule::currentProfile() const
+{
+    ConfigFile cfg;
+    return activeProfile(cfg.bandwidthProfile(), cfg.bandwidthSchedule(), QDateTime::currentDateTime(), NetworkInformation::instance()->isMetered());
+}
+
+ConfigFile::BandwidthProfile BandwidthSchedule::activeProfile(const ConfigFile::BandwidthProfile &defaultProfile,
+    const QVector<ConfigFile::BandwidthScheduleEntry> &schedule, const QDateTime &now, bool metered)
+{
+    for (const auto &entry : schedule) {
+        if ((entry.network == ConfigFile::BandwidthScheduleEntry::Network::Metered && !metered)
+            || (entry.network == ConfigFile::BandwidthScheduleEntry::Network::Unmetered && metered)) {
+            continue;
+        }
+        if (inWindow(entry, now)) {
+            return entry.profile;
+        }
+    }
+    return defaultProfile;
+}
+
+BandwidthSchedule::Limits BandwidthSchedule::limits(const ConfigFile::BandwidthProfile &profile)
+{
+    // a positive value is an absolute limit in bytes per second, a negative one a percentage
+    auto limit = [](int use, int kbytes) {
+        if (use >= 1) {
+            return kbytes * 1000;
+        } else if (use == 0) {
+            return 0;
+        }
+        return -75; // 75%
+    };
+    return {limit(profile.useUploadLimit, profile.uploadLimit), limit(profile.useDownloadLimit, profile.downloadLimit)};
+}
+
+void BandwidthSchedule::update()
+{
+    const auto profile = currentProfile();
+    if (!(profile == _profile)) {
+        _profile = profile;
+        const auto l = limits(profile);
+        qCInfo(lcBandwidthSchedule) << "Bandwidth limits changed, upload:" << l.upload << "download:" << l.download;
+        Q_EMIT limitsChanged();
+    }
+}
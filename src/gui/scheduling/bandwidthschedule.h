@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "gui/owncloudguilib.h"
+#include "libsync/configfile.h"
+
+#include <QDateTime>
+#include <QObject>
+#include <QTimer>
+
+namespace OCC {
+
+/**
+ * @brief Picks the bandwidth limits for the current time and network
+ * @ingroup gui
+ *
+ * The entries of ConfigFile::bandwidthSchedule() are checked in order, the
+ * first one whose time window and network condition match is used, otherwise
+ * the limits from the network settings apply.
+ *
+ * The schedule is reevaluated every minute and when the network changes,
+ * changed limits are announced with limitsChanged() so they can be applied
+ * to the running syncs.
+ */
+class OWNCLOUDGUI_EXPORT BandwidthSchedule : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BandwidthSchedule(QObject *parent);
+
+    /// The limits in the form expected by SyncEngine::setNetworkLimits()
+    struct Limits
+    {
+        int upload = 0;
+        int download = 0;
+    };
+
+    Limits currentLimits() const;
+
+    static ConfigFile::BandwidthProfile activeProfile(const ConfigFile::BandwidthProfile &defaultProfile,
+        const QVector<ConfigFile::BandwidthScheduleEntry> &schedule, const QDateTime &now, bool metered);
+    static Limits limits(const ConfigFile::BandwidthProfile &profile);
+
+Q_SIGNALS:
+    void limitsChanged();
+
+private:
+    ConfigFile::BandwidthProfile currentProfile() const;
+    void update();
+
+    QTimer _timer;
+    ConfigFile::BandwidthProfile _profile;
+};
+
+}
@@ -16,10 +16,17 @@
 
 #include "accountstate.h"
 #include "gui/folderman.h"
+#include "libsync/coalescedtimer.h"
 #include "libsync/configfile.h"
 #include "libsync/graphapi/spacesmanager.h"
+#include "libsync/serverevents.h"
 #include "libsync/syncengine.h"
 
+#include <QPointer>
+
+#include <map>
+#include <memory>
+
 
 using namespace std::chrono_literals;
 
@@ -50,16 +57,27 @@ ETagWatcher::ETagWatcher(FolderMan *folderMan, QObject *parent)
                         info.lastUpdate.reset();
                         f->accountState()->tagLastSuccessfullETagRequest(time);
                     });
+                    if (auto *events = f->accountState()->account()->serverEvents()) {
+                        // the folder is the context, it might go away before the account
+                        connect(events, &ServerEvents::itemChanged, f, [f, this](const QString &spaceId) {
+                            if (f->canSync() && f->space() && ServerEvents::normalizedSpaceId(f->space()->id()) == spaceId) {
+                                qCDebug(lcEtagWatcher) << "Scheduling sync of" << f->displayName() << f->path() << "due to a change notification";
+                                _folderMan->scheduler()->enqueueFolder(f);
+                            }
+                        });
+                    }
                 }
             }
         }
         _lastEtagJob = std::move(intersection);
     });
 
-    auto *pollTimer = new QTimer(this);
+    auto *pollTimer = new CoalescedTimer(this);
     pollTimer->setInterval(pollTimeoutC);
     // check wheter we need to query the etag for oc10 servers
-    connect(pollTimer, &QTimer::timeout, this, [this] {
+    connect(pollTimer, &CoalescedTimer::timeout, this, [this] {
+        // the oc10 folders that can be listed with one request
+        std::map<std::pair<Account *, QString>, std::vector<Folder *>> oc10Folders;
         for (auto &info : _lastEtagJob) {
             // for spaces we use the etag provided by the SpaceManager
             if (info.first->accountState()->supportsSpaces()) {
@@ -68,8 +86,15 @@ ETagWatcher::ETagWatcher(FolderMan *folderMan, QObject *parent)
                 if (auto *space = info.first->space()) {
                     updateEtag(info.first, space->drive().getRoot().getETag());
                 }
+            } else if (needsOC10EtagJob(info.first)) {
+                oc10Folders[{info.first->accountState()->account().data(), parentPath(info.first->remotePath())}].push_back(info.first);
+            }
+        }
+        for (const auto &[key, folders] : oc10Folders) {
+            if (folders.size() == 1) {
+                startOC10EtagJob(folders.front());
             } else {
-                startOC10EtagJob(info.first);
+                startBatchedOC10EtagJob(key.second, folders);
             }
         }
     });
@@ -93,32 +118,80 @@ void ETagWatcher::updateEtag(Folder *f, const QString &etag)
     }
 }
 
+bool ETagWatcher::needsOC10EtagJob(Folder *f)
+{
+    if (f->accountState()->state() != AccountState::State::Connected) {
+        return false;
+    }
+    ConfigFile cfg;
+    const auto polltime = cfg.remotePollInterval(f->accountState()->account()->capabilities().remotePollInterval());
+    return _lastEtagJob[f].lastUpdate.duration() > polltime;
+}
+
+QString ETagWatcher::parentPath(const QString &remotePath)
+{
+    // the root lists itself
+    const QString path = Utility::stripTrailingSlash(remotePath);
+    const int slash = path.lastIndexOf(QLatin1Char('/'));
+    return slash <= 0 ? QStringLiteral("/") : path.left(slash);
+}
+
+void ETagWatcher::etagReceived(Folder *f, AbstractNetworkJob *job, const QString &etag)
+{
+    auto lastResponse = job->responseQTimeStamp();
+    if (!lastResponse.isValid()) {
+        // If the responose had no valid "Date" header, use "now", as the job just finished.
+        lastResponse = QDateTime::currentDateTimeUtc();
+    }
+    f->accountState()->tagLastSuccessfullETagRequest(lastResponse);
+    updateEtag(f, etag);
+}
+
 void ETagWatcher::startOC10EtagJob(Folder *f)
 {
-    if (f->accountState()->state() == AccountState::State::Connected) {
-        ConfigFile cfg;
-        const auto account = f->accountState()->account();
-        const auto polltime = cfg.remotePollInterval(account->capabilities().remotePollInterval());
-        if (_lastEtagJob[f].lastUpdate.duration() > polltime) {
-            auto *requestEtagJob = new RequestEtagJob(account, f->webDavUrl(), f->remotePath(), f);
-            requestEtagJob->setTimeout(pollTimeoutC);
-            connect(requestEtagJob, &RequestEtagJob::finishedSignal, this, [requestEtagJob, f, this] {
-                if (requestEtagJob->httpStatusCode() == 207) {
-                    if (OC_ENSURE_NOT(requestEtagJob->etag().isEmpty())) {
-                        auto lastResponse = requestEtagJob->responseQTimeStamp();
-                        if (!lastResponse.isValid()) {
-                            // If the responose had no valid "Date" header, use "now", as the job just finished.
-                            lastResponse = QDateTime::currentDateTimeUtc();
-                        }
-                        f->accountState()->tagLastSuccessfullETagRequest(lastResponse);
-                        updateEtag(f, requestEtagJob->etag());
-                    } else {
-                        qCWarning(lcEtagWatcher) << "Invalid empty etag received for" << f->displayName() << f->path() << requestEtagJob;
-                    }
-                }
-            });
-            qCDebug(lcEtagWatcher) << "Starting etag check for folder" << f->displayName() << f->path();
-            requestEtagJob->start();
+    const auto account = f->accountState()->account();
+    auto *requestEtagJob = new RequestEtagJob(account, f->webDavUrl(), f->remotePath(), f);
+    requestEtagJob->setTimeout(pollTimeoutC);
+    connect(requestEtagJob, &RequestEtagJob::finishedSignal, this, [requestEtagJob, f, this] {
+        if (requestEtagJob->httpStatusCode() == 207) {
+            if (OC_ENSURE_NOT(requestEtagJob->etag().isEmpty())) {
+                etagReceived(f, requestEtagJob, requestEtagJob->etag());
+            } else {
+                qCWarning(lcEtagWatcher) << "Invalid empty etag received for" << f->displayName() << f->path() << requestEtagJob;
+            }
         }
-    }
+    });
+    qCDebug(lcEtagWatcher) << "Starting etag check for folder" << f->displayName() << f->path();
+    requestEtagJob->start();
+}
+
+void ETagWatcher::startBatchedOC10EtagJob(const QString &parentPath, const std::vector<Folder *> &folders)
+{
+    // all folders share the account and thus the dav url
+    auto *first = folders.front();
+    auto *job = new PropfindJob(first->accountState()->account(), first->webDavUrl(), parentPath, PropfindJob::Depth::One, this);
+    job->setProperties({QByteArrayLiteral("getetag")});
+    job->setTimeout(pollTimeoutC);
+    auto etags = std::make_shared<QHash<QString, QString>>();
+    connect(job, &PropfindJob::directoryListingIterated, this, [etags](const QString &href, const QMap<QString, QString> &properties) {
+        etags->insert(href, Utility::normalizeEtag(properties.value(QStringLiteral("getetag"))));
+    });
+    std::vector<QPointer<Folder>> targets(folders.cbegin(), folders.cend());
+    connect(job, &PropfindJob::finishedSignal, this, [job, etags, targets, this] {
+        for (const auto &f : targets) {
+            if (!f) {
+                continue;
+            }
+            const QString href = Utility::stripTrailingSlash(Utility::concatUrlPath(f->webDavUrl(), f->remotePath()).path());
+            const QString etag = etags->value(href);
+            if (job->httpStatusCode() == 207 && !etag.isEmpty()) {
+                etagReceived(f, job, etag);
+            } else {
+                // the single request reports the errors of this folder
+                startOC10EtagJob(f);
+            }
+        }
+    });
+    qCDebug(lcEtagWatcher) << "Starting etag check of" << folders.size() << "folders in" << parentPath;
+    job->start();
 }
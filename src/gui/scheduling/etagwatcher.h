@@ -19,9 +19,13 @@
 #include <QObject>
 
 #include <unordered_map>
+#include <vector>
+
+class TestEtagWatcher;
 
 namespace OCC {
 
+class AbstractNetworkJob;
 class FolderMan;
 class Folder;
 
@@ -35,7 +39,14 @@ private:
     void updateEtag(Folder *f, const QString &etag);
 
     // oc10 relies on etag polling, with ocis we use the spaces endpoint
+    bool needsOC10EtagJob(Folder *f);
     void startOC10EtagJob(Folder *f);
+    // folders with the same parent are polled with a single Depth:1 PROPFIND
+    void startBatchedOC10EtagJob(const QString &parentPath, const std::vector<Folder *> &folders);
+    void etagReceived(Folder *f, AbstractNetworkJob *job, const QString &etag);
+
+    /// The path whose Depth:1 listing contains \a remotePath
+    static QString parentPath(const QString &remotePath);
 
 
     FolderMan *_folderMan;
@@ -48,6 +59,8 @@ private:
     };
 
     std::unordered_map<Folder *, ETagInfo> _lastEtagJob;
+
+    friend class ::TestEtagWatcher;
 };
 
 }
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) by Hannah von Reth <hannah.vonreth@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "gui/scheduling/syncscheduler.h"
+
+#include <QPointer>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+
+namespace OCC {
+
+/**
+ * The folders waiting for a sync, used by the SyncScheduler
+ *
+ * Folders are popped by priority, in the order in which they got it.
+ */
+class FolderPriorityQueue
+{
+private:
+    struct Element
+    {
+        // We don't own the folder, so it might get deleted
+        QPointer<Folder> folder;
+        // raw pointer for lookup in _scheduledFolders
+        Folder *rawFolder;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+    using Bucket = std::list<Element>;
+
+    struct Position
+    {
+        SyncScheduler::Priority priority;
+        Bucket::iterator element;
+    };
+
+    // a folder waiting this long is synced before the ones with a higher priority, except High
+    static constexpr auto agingC = std::chrono::minutes(5);
+
+public:
+    FolderPriorityQueue() = default;
+
+    /**
+     * Schedules \a folder with \a priority, a folder that is already scheduled keeps its place
+     * unless the priority is higher.
+     * A folder that was popped but has to wait is enqueued again with its original \a enqueued time,
+     * so it keeps its place among the folders of its priority and still ages.
+     */
+    void enqueueFolder(Folder *folder, SyncScheduler::Priority priority,
+        std::chrono::steady_clock::time_point enqueued = std::chrono::steady_clock::now())
+    {
+        const auto it = _scheduledFolders.find(folder);
+        if (it == _scheduledFolders.end()) {
+            // the folder is not yet scheduled, the bucket stays ordered by the time of enqueueing
+            auto &bucket = bucketFor(priority);
+            const auto before = std::find_if(bucket.rbegin(), bucket.rend(), [enqueued](const Element &e) { return e.enqueued <= enqueued; }).base();
+            const auto element = bucket.insert(before, {folder, folder, enqueued});
+            _scheduledFolders.emplace(folder, Position{priority, element});
+        } else if (priority > it->second.priority) {
+            // move it to the end of the bucket of the new priority, the iterator stays valid
+            auto &to = bucketFor(priority);
+            to.splice(to.end(), bucketFor(it->second.priority), it->second.element);
+            it->second.priority = priority;
+        }
+    }
+
+    auto empty() { return _scheduledFolders.empty(); }
+    auto size() { return _scheduledFolders.size(); }
+
+    /// Removes the next folder, \a enqueued is set to the time it was enqueued
+    std::pair<Folder *, SyncScheduler::Priority> pop(std::chrono::steady_clock::time_point *enqueued = nullptr)
+    {
+        while (!_scheduledFolders.empty()) {
+            const auto priority = nextPriority();
+            auto &bucket = bucketFor(priority);
+            const Element out = bucket.front();
+            bucket.pop_front();
+            [[maybe_unused]] auto removed = _scheduledFolders.erase(out.rawFolder);
+            Q_ASSERT(removed == 1);
+            // could be a nullptr by now
+            if (out.folder) {
+                if (enqueued) {
+                    *enqueued = out.enqueued;
+                }
+                return std::make_pair(out.folder.data(), priority);
+            }
+        }
+        return std::make_pair(nullptr, SyncScheduler::Priority::Low);
+    }
+
+private:
+    Bucket &bucketFor(SyncScheduler::Priority priority) { return _buckets[static_cast<size_t>(priority)]; }
+
+    // the highest priority with a waiting folder, unless a folder waited too long
+    SyncScheduler::Priority nextPriority()
+    {
+        if (!bucketFor(SyncScheduler::Priority::High).empty()) {
+            return SyncScheduler::Priority::High;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        const auto &low = bucketFor(SyncScheduler::Priority::Low);
+        const auto &medium = bucketFor(SyncScheduler::Priority::Medium);
+        if (!low.empty() && (medium.empty() || now - low.front().enqueued > agingC)) {
+            return SyncScheduler::Priority::Low;
+        }
+        return SyncScheduler::Priority::Medium;
+    }
+
+    // the folders by priority, in the order in which they got the priority
+    std::array<Bucket, 3> _buckets;
+    // helper container to ensure we don't enqueue a Folder multiple times
+    std::unordered_map<Folder *, Position> _scheduledFolders;
+};
+}
@@ -14,98 +14,31 @@
 
 #include "gui/scheduling/syncscheduler.h"
 
+#include "gui/scheduling/folderpriorityqueue.h"
+
 #include "gui/folderman.h"
 #include "gui/networkinformation.h"
 #include "gui/scheduling/etagwatcher.h"
 #include "libsync/configfile.h"
 #include "libsync/syncengine.h"
 
+#include <algorithm>
+
 using namespace std::chrono_literals;
 
 using namespace OCC;
 
 Q_LOGGING_CATEGORY(lcSyncScheduler, "gui.scheduler.syncscheduler", QtInfoMsg)
 
-class FolderPriorityQueue
-{
-private:
-    struct Element
-    {
-        Element() { }
-
-        Element(Folder *f, SyncScheduler::Priority p)
-            : folder(f)
-            , rawFolder(f)
-            , priority(p)
-        {
-        }
-
-        // We don't own the folder, so it might get deleted
-        QPointer<Folder> folder = nullptr;
-        // raw pointer for lookup in _scheduledFolders
-        Folder *rawFolder = nullptr;
-        SyncScheduler::Priority priority = SyncScheduler::Priority::Low;
-
-        friend bool operator<(const Element &lhs, const Element &rhs) { return lhs.priority < rhs.priority; }
-    };
-
-
-public:
-    FolderPriorityQueue() = default;
-
-    void enqueueFolder(Folder *folder, SyncScheduler::Priority priority)
-    {
-        const auto [it, inserted] = _scheduledFolders.emplace(folder, priority);
-        if (inserted) {
-            // the folder is not yet scheduled
-            _queue.emplace(folder, priority);
-        } else {
-            // if the new priority is higher we need to rebuild the queue
-            if (priority > it->second) {
-                // we need to reorder the queue
-                // this is expensive
-                decltype(_queue) out;
-                for (; !_queue.empty(); _queue.pop()) {
-                    const auto &tmp = _queue.top();
-                    if (tmp.folder != folder) {
-                        out.push(std::move(tmp));
-                    } else {
-                        out.emplace(folder, priority);
-                    }
-                }
-                _queue = std::move(out);
-                // replace the the old priority
-                _scheduledFolders[folder] = priority;
-            }
-        }
-    }
-
-    auto empty() { return _queue.empty(); }
-    auto size() { return _queue.size(); }
-
-    std::pair<Folder *, SyncScheduler::Priority> pop()
-    {
-        Element out;
-        while (!_queue.empty() && !out.folder) {
-            // could be a nullptr by now
-            out = _queue.top();
-            [[maybe_unused]] auto removed = _scheduledFolders.erase(_queue.top().rawFolder);
-            Q_ASSERT(removed = 1);
-            _queue.pop();
-        }
-        return std::make_pair(out.folder, out.priority);
-    }
-
-private:
-    // the actual queue
-    std::priority_queue<Element> _queue;
-    // helper container to ensure we don't enqueue a Folder multiple times
-    std::unordered_map<Folder *, SyncScheduler::Priority> _scheduledFolders;
-};
+namespace {
+// the syncs of one account share its connections
+constexpr size_t maximumRunningSyncsPerAccountC = 2;
+}
 
 SyncScheduler::SyncScheduler(FolderMan *parent)
     : QObject(parent)
     , _pauseSyncWhenMetered(ConfigFile().pauseSyncWhenMetered())
+    , _maxConcurrentSyncs(ConfigFile().maxConcurrentSyncs())
     , _queue(new FolderPriorityQueue)
 {
     new ETagWatcher(parent, this);
@@ -140,9 +73,7 @@ void SyncScheduler::enqueueFolder(Folder *folder, Priority priority)
 
     qCInfo(lcSyncScheduler) << "Enqueue" << folder->path() << priority << "QueueSize:" << _queue->size();
     _queue->enqueueFolder(folder, priority);
-    if (!_currentSync) {
-        startNext();
-    }
+    startNext();
 }
 
 void SyncScheduler::startNext()
@@ -152,43 +83,81 @@ void SyncScheduler::startNext()
         return;
     }
 
-    if (!_currentSync.isNull()) {
-        qCInfo(lcSyncScheduler) << "Another sync is already running, waiting for that to finish before starting a new sync";
-        return;
-    }
+    // the folders of syncs that were destroyed while running
+    _runningSyncs.erase(
+        std::remove_if(_runningSyncs.begin(), _runningSyncs.end(), [](const QPointer<Folder> &f) { return f.isNull(); }), _runningSyncs.end());
 
-    auto nextSync = _queue->pop();
-    while (nextSync.first && !nextSync.first->canSync()) {
-        nextSync = _queue->pop();
-    }
-    _currentSync = nextSync.first;
-    auto syncPriority = nextSync.second;
-
-    if (!_currentSync.isNull()) {
+    // folders that have to wait, they are enqueued again
+    struct Waiting
+    {
+        Folder *folder;
+        Priority priority;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+    std::vector<Waiting> waiting;
+    while (!_queue->empty()) {
+        if (_runningSyncs.size() >= _maxConcurrentSyncs) {
+            break;
+        }
+        std::chrono::steady_clock::time_point enqueued;
+        const auto [folder, priority] = _queue->pop(&enqueued);
+        if (!folder) {
+            break;
+        }
+        if (!folder->canSync()) {
+            continue;
+        }
+        if (std::find(_runningSyncs.cbegin(), _runningSyncs.cend(), folder) != _runningSyncs.cend()) {
+            // synced again once the running sync finished
+            waiting.push_back({folder, priority, enqueued});
+            continue;
+        }
+        const auto accountSyncs = std::count_if(_runningSyncs.cbegin(), _runningSyncs.cend(),
+            [account = folder->accountState()](const QPointer<Folder> &f) { return f->accountState() == account; });
+        if (static_cast<size_t>(accountSyncs) >= maximumRunningSyncsPerAccountC && priority != Priority::High) {
+            qCInfo(lcSyncScheduler) << "Another sync of the account is already running, waiting for that to finish before syncing" << folder->path();
+            waiting.push_back({folder, priority, enqueued});
+            continue;
+        }
         if (_pauseSyncWhenMetered && NetworkInformation::instance()->isMetered()) {
-            if (syncPriority == Priority::High) {
+            if (priority == Priority::High) {
                 qCInfo(lcSyncScheduler) << "Scheduler is paused due to metered internet connection, BUT next sync is HIGH priority, so allow sync to start";
             } else {
-                enqueueFolder(_currentSync, syncPriority);
                 qCInfo(lcSyncScheduler) << "Scheduler is paused due to metered internet connection, next sync is not started";
-                return;
+                waiting.push_back({folder, priority, enqueued});
+                continue;
             }
         }
+        startSync(folder);
+    }
+    for (const auto &w : waiting) {
+        _queue->enqueueFolder(w.folder, w.priority, w.enqueued);
+    }
 
-        connect(
-            _currentSync, &Folder::syncFinished, this,
-            [this](const SyncResult &result) {
-                qCInfo(lcSyncScheduler) << "Sync finished for" << _currentSync->path() << "with status" << result.status();
-                _currentSync = nullptr;
-                startNext();
-            },
-            Qt::SingleShotConnection);
-        connect(_currentSync, &Folder::destroyed, this, &SyncScheduler::startNext, Qt::SingleShotConnection);
-        qCInfo(lcSyncScheduler) << "Starting sync for" << _currentSync->path();
-        _currentSync->startSync();
+    if (_runningSyncs.empty() && _queue->empty()) {
+        // nothing to sync, a good time to clean up the journals
+        for (auto *f : static_cast<FolderMan *>(parent())->folders()) {
+            f->runJournalMaintenance();
+        }
     }
 }
 
+void SyncScheduler::startSync(Folder *folder)
+{
+    _runningSyncs.emplace_back(folder);
+    connect(
+        folder, &Folder::syncFinished, this,
+        [folder = QPointer<Folder>(folder), this](const SyncResult &result) {
+            qCInfo(lcSyncScheduler) << "Sync finished for" << folder->path() << "with status" << result.status();
+            _runningSyncs.erase(std::remove(_runningSyncs.begin(), _runningSyncs.end(), folder), _runningSyncs.end());
+            startNext();
+        },
+        Qt::SingleShotConnection);
+    connect(folder, &Folder::destroyed, this, &SyncScheduler::startNext, Qt::SingleShotConnection);
+    qCInfo(lcSyncScheduler) << "Starting sync for" << folder->path() << "running syncs:" << _runningSyncs.size();
+    folder->startSync();
+}
+
 void SyncScheduler::start()
 {
     _running = true;
@@ -202,7 +171,7 @@ void SyncScheduler::stop()
 
 bool SyncScheduler::hasCurrentRunningSyncRunning() const
 {
-    return _currentSync;
+    return std::any_of(_runningSyncs.cbegin(), _runningSyncs.cend(), [](const QPointer<Folder> &f) { return !f.isNull(); });
 }
 
 void SyncScheduler::setPauseSyncWhenMetered(bool pauseSyncWhenMetered)
@@ -21,14 +21,23 @@
 
 #include <queue>
 #include <unordered_map>
+#include <vector>
 
-
-class FolderPriorityQueue;
+class TestSyncScheduler;
 
 namespace OCC {
 
 class FolderMan;
+class FolderPriorityQueue;
 
+/**
+ * @brief Starts the syncs of the folders by priority
+ * @ingroup gui
+ *
+ * Up to ConfigFile::maxConcurrentSyncs() folders are synced at once, at most
+ * two of each account. A sync with Priority::High, usually requested by the
+ * user, is started first and may exceed the limit of its account.
+ */
 class SyncScheduler : public QObject
 {
     Q_OBJECT
@@ -60,11 +69,16 @@ public:
 
 
 private:
+    /** Starts queued syncs until the limits are reached */
     void startNext();
+    void startSync(Folder *folder);
 
     bool _running = false;
     bool _pauseSyncWhenMetered;
-    QPointer<Folder> _currentSync;
+    size_t _maxConcurrentSyncs;
+    std::vector<QPointer<Folder>> _runningSyncs;
     FolderPriorityQueue *_queue;
+
+    friend class ::TestSyncScheduler;
 };
 }
@@ -15,18 +15,16 @@
 #pragma once
 #include "accountfwd.h"
 #include <QDialog>
-#include <QTreeWidget>
 #include <QUrl>
 
 #include "csync_exclude.h"
 
-class QTreeWidgetItem;
-class QTreeWidget;
-class QNetworkReply;
+class QTreeView;
 class QLabel;
 namespace OCC {
 
 class Folder;
+class SelectiveSyncModel;
 
 /**
  * @brief The SelectiveSyncWidget contains a folder tree with labels
@@ -39,10 +37,10 @@ public:
     explicit SelectiveSyncWidget(AccountPtr account, QWidget *parent = nullptr);
 
     /// Returns a list of blacklisted paths, each including the trailing /
-    QSet<QString> createBlackList(QTreeWidgetItem *root = nullptr) const;
+    QSet<QString> createBlackList() const;
 
     // Estimates the total size of checked items (recursively)
-    qint64 estimatedSize(QTreeWidgetItem *root = nullptr);
+    qint64 estimatedSize() const;
 
     // oldBlackList is a list of excluded paths, each including a trailing /
     void setFolderInfo(const QString &folderPath, const QString &rootName, const QSet<QString> &oldBlackList = {});
@@ -51,14 +49,13 @@ public:
 
     void setDavUrl(const QUrl &davUrl);
 
-private Q_SLOTS:
-    void slotUpdateDirectories(QStringList);
-    void slotItemExpanded(QTreeWidgetItem *);
-    void slotItemChanged(QTreeWidgetItem *, int);
-
 private:
     void refreshFolders();
-    void recursiveInsert(QTreeWidgetItem *parent, QStringList pathTrail, QString path, qint64 size, bool showChildIndicator);
+    // lists the folder at \a dir, the root is the empty path
+    void listFolder(const QString &dir, const QString &etag);
+    void slotUpdateDirectories(const QString &dir, QStringList list, const QHash<QString, qint64> &sizes, const QHash<QString, QString> &etags);
+    // shows the next page of a folder once its last shown subfolder is visible
+    void showMoreRows();
     QUrl davUrl() const;
 
 private:
@@ -70,10 +67,10 @@ private:
 
     QUrl _davUrl;
 
-    bool _inserting; // set to true when we are inserting new items on the list
     QLabel *_loading;
 
-    QTreeWidget *_folderTree;
+    SelectiveSyncModel *_model;
+    QTreeView *_folderTree;
 
     // During account setup we want to filter out excluded folders from the
     // view without having a Folder.SyncEngine.ExcludedFiles instance.
@@ -30,7 +30,7 @@ ServerNotificationHandler::ServerNotificationHandler(QObject *parent)
 {
 }
 
-void ServerNotificationHandler::slotFetchNotifications(AccountStatePtr ptr)
+void ServerNotificationHandler::slotFetchNotifications(AccountStatePtr ptr, const QByteArray &etag)
 {
     // check connectivity and credentials
     if (!(ptr && ptr->isConnected() && ptr->account() && ptr->account()->credentials() && ptr->account()->credentials()->ready())) {
@@ -52,6 +52,7 @@ void ServerNotificationHandler::slotFetchNotifications(AccountStatePtr ptr)
 
     // if the previous notification job has finished, start next.
     auto *job = new JsonApiJob(ptr->account(), notificationsPath, {}, {}, this);
+    job->setIfNoneMatch(etag);
     QObject::connect(job, &JsonApiJob::finishedSignal,
         this, [job, ptr, this] {
             slotNotificationsReceived(job, ptr);
@@ -63,6 +64,10 @@ void ServerNotificationHandler::slotFetchNotifications(AccountStatePtr ptr)
 
 void ServerNotificationHandler::slotNotificationsReceived(JsonApiJob *job, const AccountStatePtr &accountState)
 {
+    if (job->notModified()) {
+        qCDebug(lcServerNotification) << "Notifications of" << accountState->account()->displayNameWithHost() << "did not change";
+        return;
+    }
     if (job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
         qCWarning(lcServerNotification) << "Notifications failed with status code " << job->ocsStatus();
         return;
@@ -109,6 +114,6 @@ void ServerNotificationHandler::slotNotificationsReceived(JsonApiJob *job, const
             QDateTime::fromString(json.value(QStringLiteral("datetime")).toString(), Qt::ISODate),
             std::move(linkList) });
     }
-    Q_EMIT newNotificationList(list);
+    Q_EMIT newNotificationList(list, job->etag());
 }
 }
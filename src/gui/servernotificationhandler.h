@@ -30,10 +30,11 @@ public:
     explicit ServerNotificationHandler(QObject *parent = nullptr);
 
 Q_SIGNALS:
-    void newNotificationList(ActivityList);
+    /// Not emitted if the notifications didn't change since the ones of the ETag passed to slotFetchNotifications()
+    void newNotificationList(ActivityList, const QByteArray &etag);
 
 public Q_SLOTS:
-    void slotFetchNotifications(AccountStatePtr ptr);
+    void slotFetchNotifications(AccountStatePtr ptr, const QByteArray &etag);
 
 private:
     void slotNotificationsReceived(JsonApiJob *job, const AccountStatePtr &accountState);
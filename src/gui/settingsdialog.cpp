@@ -22,6 +22,7 @@
 #include "configfile.h"
 #include "generalsettings.h"
 #include "gui/qmlutils.h"
+#include "gui/startuptrace.h"
 #include "owncloudgui.h"
 #include "resources/qmlresources.h"
 #include "resources/resources.h"
@@ -97,8 +98,11 @@ SettingsDialog::SettingsDialog(ownCloudGui *gui, QWidget *parent)
 
     // TODO: fix sizing
     _ui->quickWidget->setFixedHeight(minimumHeight() * 0.13);
-    _ui->quickWidget->engine()->addImageProvider(QStringLiteral("avatar"), new AvatarImageProvider);
-    _ui->quickWidget->setOCContext(QUrl(QStringLiteral("qrc:/qt/qml/org/ownCloud/gui/qml/AccountBar.qml")), this);
+    {
+        const StartupTrace::Span span(QStringLiteral("Load AccountBar.qml"));
+        _ui->quickWidget->engine()->addImageProvider(QStringLiteral("avatar"), new AvatarImageProvider);
+        _ui->quickWidget->setOCContext(QUrl(QStringLiteral("qrc:/qt/qml/org/ownCloud/gui/qml/AccountBar.qml")), this);
+    }
     connect(
         _ui->quickWidget->engine(), &QQmlEngine::quit, QApplication::instance(),
         [this] {
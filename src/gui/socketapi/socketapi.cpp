@@ -17,6 +17,7 @@
 #include "socketapi.h"
 #include "scheduling/syncscheduler.h"
 #include "socketapi_p.h"
+#include "socketapistatustable.h"
 
 #include "gui/commonstrings.h"
 
@@ -45,6 +46,8 @@
 #include <QScopedPointer>
 #include <QUrl>
 #include <array>
+#include <chrono>
+#include <utility>
 
 
 #include <QJsonArray>
@@ -63,10 +66,13 @@
 // This is the version that is returned when the client asks for the VERSION.
 // The first number should be changed if there is an incompatible change that breaks old clients.
 // The second number should be changed when there are new features.
-#define MIRALL_SOCKET_API_VERSION "1.1"
+#define MIRALL_SOCKET_API_VERSION "1.4"
 
 namespace {
 
+// how long status changes are collected before they are pushed to the listeners
+constexpr auto StatusPushInterval = std::chrono::milliseconds(100);
+
 const QString unregisterpathMessageC()
 {
     return QStringLiteral("UNREGISTER_PATH");
@@ -104,6 +110,49 @@ Q_LOGGING_CATEGORY(lcSocketApi, "gui.socketapi", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPublicLink, "gui.socketapi.publiclink", QtInfoMsg)
 
 void SocketListener::sendMessage(const QString &message, bool doWait) const
+{
+    if (!_heldBackStatuses.isEmpty()) {
+        writeStatusPushes(std::exchange(_heldBackStatuses, {}));
+    }
+    writeMessage(message, doWait);
+}
+
+void SocketListener::sendStatusPushes(const QHash<QString, QString> &statuses) const
+{
+    if (!_heldBackStatuses.isEmpty() || isBacklogged()) {
+        _heldBackStatuses.insert(statuses);
+        if (!isBacklogged()) {
+            sendHeldBackStatuses();
+        }
+        return;
+    }
+    writeStatusPushes(statuses);
+}
+
+void SocketListener::sendHeldBackStatuses() const
+{
+    if (!_heldBackStatuses.isEmpty() && !isBacklogged()) {
+        writeStatusPushes(std::exchange(_heldBackStatuses, {}));
+    }
+}
+
+void SocketListener::writeStatusPushes(const QHash<QString, QString> &statuses) const
+{
+    if (batchedStatusPushes) {
+        QJsonObject batch;
+        for (auto it = statuses.cbegin(); it != statuses.cend(); ++it) {
+            batch.insert(it.key(), it.value());
+        }
+        const QJsonObject data{{QStringLiteral("arguments"), QJsonObject{{QStringLiteral("statuses"), batch}}}};
+        writeMessage(QStringLiteral("V2/STATUS:") + QString::fromUtf8(QJsonDocument(data).toJson(QJsonDocument::Compact)), false);
+    } else {
+        for (auto it = statuses.cbegin(); it != statuses.cend(); ++it) {
+            writeMessage(QStringLiteral("STATUS:") + it.value() + QLatin1Char(':') + it.key(), false);
+        }
+    }
+}
+
+void SocketListener::writeMessage(const QString &message, bool doWait) const
 {
     if (!socket) {
         qCInfo(lcSocketApi) << "Not sending message to dead socket:" << message;
@@ -155,6 +204,15 @@ SocketApi::SocketApi(QObject *parent)
     // Wire up the server instance to us, so we can accept new connections:
     connect(&_localServer, &SocketApiServer::newConnection, this, &SocketApi::slotNewConnection);
 
+    const QString statusTablePath = Utility::socketApiStatusTablePath();
+    if (!statusTablePath.isEmpty()) {
+        _statusTable.reset(new SocketApiStatusTable(statusTablePath));
+    }
+
+    _statusPushTimer.setSingleShot(true);
+    _statusPushTimer.setInterval(StatusPushInterval);
+    connect(&_statusPushTimer, &QTimer::timeout, this, &SocketApi::flushStatusPushMessages);
+
     connect(AccountManager::instance(), &AccountManager::accountRemoved, this, [this](const auto &accountState) {
         if (_registeredAccounts.contains(accountState->account())) {
             unregisterAccount(accountState->account());
@@ -207,6 +265,7 @@ void SocketApi::slotNewConnection()
     OC_ASSERT(socket->readAll().isEmpty());
 
     auto listener = QSharedPointer<SocketListener>::create(socket);
+    connect(socket, &SocketApiSocket::bytesWritten, this, [listener = listener.data()] { listener->sendHeldBackStatuses(); });
     _listeners.insert(socket, listener);
     for (const auto &a : std::as_const(_registeredAccounts)) {
         if (a->hasDefaultSyncRoot()) {
@@ -353,6 +412,9 @@ void SocketApi::slotUnregisterPath(Folder *folder)
 
     broadcastMessage(buildMessage(unregisterpathMessageC(), Utility::stripTrailingSlash(folder->path()), QString()), true);
     _registeredFolders.remove(folder);
+    if (_statusTable) {
+        _statusTable->removeDescendants(QDir::toNativeSeparators(Utility::stripTrailingSlash(folder->path())));
+    }
 }
 
 void SocketApi::slotUpdateFolderView(Folder *f)
@@ -385,6 +447,8 @@ void SocketApi::slotUpdateFolderView(Folder *f)
             Q_FALLTHROUGH();
         case OCC::SyncResult::NotYetStarted:
             Q_FALLTHROUGH();
+        case OCC::SyncResult::Upgrading:
+            Q_FALLTHROUGH();
         case OCC::SyncResult::SyncRunning:
             Q_FALLTHROUGH();
         case OCC::SyncResult::SyncAbortRequested:
@@ -397,6 +461,8 @@ void SocketApi::slotUpdateFolderView(Folder *f)
 
 void SocketApi::broadcastMessage(const QString &msg, bool doWait)
 {
+    // keep the order of the messages, e.g. the statuses have to arrive before an UPDATE_VIEW
+    flushStatusPushMessages();
     for (const auto &listener : std::as_const(_listeners)) {
         listener->sendMessage(msg, doWait);
     }
@@ -445,11 +511,44 @@ void SocketApi::processShareRequest(const QString &localFile, SocketListener *li
 
 void SocketApi::broadcastStatusPushMessage(const QString &systemPath, SyncFileStatus fileStatus)
 {
-    QString msg = buildMessage(QStringLiteral("STATUS"), systemPath, fileStatus.toSocketAPIString());
     Q_ASSERT(!systemPath.endsWith(QLatin1Char('/')));
-    auto directoryHash = qHash(systemPath.left(systemPath.lastIndexOf(QLatin1Char('/'))));
-    for (const auto &listener : std::as_const(_listeners)) {
-        listener->sendMessageIfDirectoryMonitored(msg, directoryHash);
+    if (_listeners.isEmpty() && !_statusTable) {
+        return;
+    }
+    _pendingStatusPushes.insert(systemPath, fileStatus);
+    if (!_statusPushTimer.isActive()) {
+        _statusPushTimer.start();
+    }
+}
+
+void SocketApi::flushStatusPushMessages()
+{
+    _statusPushTimer.stop();
+    if (_pendingStatusPushes.isEmpty()) {
+        return;
+    }
+    const auto pending = std::move(_pendingStatusPushes);
+    _pendingStatusPushes.clear();
+
+    QHash<SocketListener *, QHash<QString, QString>> batches;
+    for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+        const QString &systemPath = it.key();
+        const QString nativePath = QDir::toNativeSeparators(QFileInfo(systemPath).absoluteFilePath());
+        // the shell might have read the status from the table, keep it informed like for a status it asked for
+        bool published = false;
+        if (_statusTable) {
+            // a path without a status is gone, don't keep a slot for it
+            published = it.value().tag() == SyncFileStatus::StatusNone ? _statusTable->remove(nativePath) : _statusTable->update(nativePath, it.value());
+        }
+        const auto directoryHash = qHash(systemPath.left(systemPath.lastIndexOf(QLatin1Char('/'))));
+        for (const auto &listener : std::as_const(_listeners)) {
+            if (published || listener->isDirectoryMonitored(directoryHash)) {
+                batches[listener.data()].insert(nativePath, it.value().toSocketAPIString());
+            }
+        }
+    }
+    for (auto it = batches.cbegin(); it != batches.cend(); ++it) {
+        it.key()->sendStatusPushes(it.value());
     }
 }
 
@@ -473,7 +572,11 @@ void SocketApi::command_RETRIEVE_FILE_STATUS(const QString &argument, SocketList
         QString directory = fileData.localPath.left(fileData.localPath.lastIndexOf(QLatin1Char('/')));
         listener->registerMonitoredDirectory(qHash(directory));
 
-        statusString = fileData.syncFileStatus().toSocketAPIString();
+        const auto status = fileData.syncFileStatus();
+        if (_statusTable) {
+            _statusTable->insert(QDir::toNativeSeparators(argument), status);
+        }
+        statusString = status.toSocketAPIString();
     }
 
     const QString message = QStringLiteral("STATUS:") % statusString % QLatin1Char(':') % QDir::toNativeSeparators(argument);
@@ -618,18 +721,18 @@ void SocketApi::fetchPrivateLinkUrlHelper(const QString &localFile, const std::f
         return;
     }
 
-    if (!fileData.isSyncFolder()) {
-        auto record = fileData.journalRecord();
-        if (!record.isValid())
-            return;
+    auto fetch = [this, fileData, targetFun](const QByteArray &fileId) {
+        fetchPrivateLinkUrl(fileData.folder->accountState()->account(), fileData.folder->webDavUrl(), fileData.serverRelativePath, this, targetFun, fileId);
+    };
+    if (fileData.isSyncFolder()) {
+        fetch({});
+        return;
     }
-
-    fetchPrivateLinkUrl(
-        fileData.folder->accountState()->account(),
-        fileData.folder->webDavUrl(),
-        fileData.serverRelativePath,
-        this,
-        targetFun);
+    fileData.fetchJournalRecord(fileData.folder, [fetch](const SyncJournalFileRecord &record) {
+        if (record.isValid()) {
+            fetch(record._fileId);
+        }
+    });
 }
 
 void SocketApi::command_COPY_PRIVATE_LINK(const QString &localFile, SocketListener *)
@@ -681,6 +784,7 @@ void SocketApi::command_MAKE_AVAILABLE_LOCALLY(const QString &filesArg, SocketLi
 
         // Trigger sync
         data.folder->schedulePathForLocalDiscovery(data.folderRelativePath);
+        data.folder->prioritizePath(data.folderRelativePath);
         FolderMan::instance()->scheduler()->enqueueFolder(data.folder, SyncScheduler::Priority::Medium);
     }
 }
@@ -773,11 +877,11 @@ Q_INVOKABLE void OCC::SocketApi::command_OPEN_APP_LINK(const QString &localFile,
 {
     const auto data = FileData::get(localFile);
     if (OC_ENSURE(data.folder)) {
-        const auto &provider = data.folder->accountState()->account()->appProvider();
-        const auto record = data.journalRecord();
-        if (record.isValid()) {
-            provider.open(data.folder->accountState()->account(), localFile, record._fileId);
-        }
+        data.fetchJournalRecord(data.folder, [account = data.folder->accountState()->account(), localFile](const SyncJournalFileRecord &record) {
+            if (record.isValid()) {
+                account->appProvider().open(account, localFile, record._fileId);
+            }
+        });
     }
 }
 
@@ -793,6 +897,61 @@ void SocketApi::command_V2_LIST_ACCOUNTS(const QSharedPointer<SocketApiJobV2> &j
     job->success({ { QStringLiteral("accounts"), out } });
 }
 
+void SocketApi::command_V2_GET_SYNC_METRICS(const QSharedPointer<SocketApiJobV2> &job) const
+{
+    QJsonArray out;
+    for (auto *folder : FolderMan::instance()->folders()) {
+        if (!folder->isReady() || !folder->syncEngine().lastSyncMetrics().isValid()) {
+            continue;
+        }
+        out << QJsonObject({{QStringLiteral("path"), folder->path()}, {QStringLiteral("displayName"), folder->displayName()},
+            {QStringLiteral("metrics"), folder->syncEngine().lastSyncMetrics().toJson()}});
+    }
+    job->success({{QStringLiteral("folders"), out}});
+}
+
+void SocketApi::command_V2_RETRIEVE_FILE_STATUS(const QSharedPointer<SocketApiJobV2> &job)
+{
+    const auto paths = job->arguments().value(QStringLiteral("paths")).toArray();
+    const auto directories = job->arguments().value(QStringLiteral("directories")).toArray();
+    const auto &listener = job->socketListener();
+    listener->batchedStatusPushes = true;
+
+    QJsonObject statuses;
+    auto addStatus = [&](const QString &path) {
+        auto fileData = FileData::get(path);
+        SyncFileStatus status(SyncFileStatus::StatusNone);
+        if (fileData.folder) {
+            // see command_RETRIEVE_FILE_STATUS
+            const QString directory = fileData.localPath.left(fileData.localPath.lastIndexOf(QLatin1Char('/')));
+            listener->registerMonitoredDirectory(qHash(directory));
+            status = fileData.syncFileStatus();
+            if (_statusTable) {
+                _statusTable->insert(QDir::toNativeSeparators(path), status);
+            }
+        }
+        statuses.insert(QDir::toNativeSeparators(path), status.toSocketAPIString());
+    };
+    for (const auto &value : paths) {
+        const QString path = value.toString();
+        if (!path.isEmpty()) {
+            addStatus(path);
+        }
+    }
+    for (const auto &value : directories) {
+        const QString path = value.toString();
+        if (path.isEmpty() || !FileData::get(path).folder) {
+            continue;
+        }
+        const QDir directory(path);
+        const auto entries = directory.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+        for (const auto &entry : entries) {
+            addStatus(directory.filePath(entry));
+        }
+    }
+    job->success({{QStringLiteral("statuses"), statuses}});
+}
+
 void SocketApi::command_V2_GET_CLIENT_ICON(const QSharedPointer<SocketApiJobV2> &job) const
 {
     OC_ASSERT(job);
@@ -958,6 +1117,22 @@ SyncJournalFileRecord SocketApi::FileData::journalRecord() const
     return record;
 }
 
+void SocketApi::FileData::fetchJournalRecord(QObject *context, const std::function<void(const SyncJournalFileRecord &)> &callback) const
+{
+    if (!folder) {
+        callback({});
+        return;
+    }
+    folder->journalDb()->runAsync(
+        context,
+        [path = folderRelativePath](SyncJournalDb *journal) {
+            SyncJournalFileRecord record;
+            journal->getFileRecord(path, &record);
+            return record;
+        },
+        callback);
+}
+
 SocketApi::FileData SocketApi::FileData::parentFolder() const
 {
     return FileData::get(QFileInfo(localPath).dir().path());
@@ -29,8 +29,13 @@ using SocketApiServer = QLocalServer;
 using SocketApiSocket = QLocalSocket;
 #endif
 
+#include <QTimer>
+
+#include <memory>
+
 class QUrl;
 class QLocalSocket;
+class TestSocketApi;
 
 namespace OCC {
 
@@ -39,6 +44,7 @@ class Folder;
 class SocketListener;
 class SocketApiJob;
 class SocketApiJobV2;
+class SocketApiStatusTable;
 
 Q_DECLARE_LOGGING_CATEGORY(lcSocketApi)
 
@@ -76,6 +82,8 @@ private Q_SLOTS:
     static void openPrivateLink(const QUrl &link);
 
 private:
+    friend class ::TestSocketApi;
+
     // Helper structure for getting information on a file
     // based on its local path - used for nearly all remote
     // actions.
@@ -84,6 +92,8 @@ private:
         static FileData get(const QString &localFile);
         SyncFileStatus syncFileStatus() const;
         SyncJournalFileRecord journalRecord() const;
+        // Like journalRecord() but looked up on the journal thread, \a callback is invoked in the thread of \a context
+        void fetchJournalRecord(QObject *context, const std::function<void(const SyncJournalFileRecord &)> &callback) const;
         FileData parentFolder() const;
 
         // Relative path of the file locally, without any vfs suffix
@@ -104,6 +114,9 @@ private:
 
     void broadcastMessage(const QString &msg, bool doWait = false);
 
+    // sends the status changes collected by broadcastStatusPushMessage
+    void flushStatusPushMessages();
+
     // opens share dialog, sends reply
     void processShareRequest(const QString &localFile, SocketListener *listener, ShareDialogStartPage startPage);
 
@@ -138,6 +151,25 @@ private:
     // e.g. { "id" : "1", "arguments" : { "size" : 16 } }
     Q_INVOKABLE void command_V2_GET_CLIENT_ICON(const QSharedPointer<SocketApiJobV2> &job) const;
 
+    /** Batched version of RETRIEVE_FILE_STATUS (added in version 1.2)
+     * e.g. { "id" : "1", "arguments" : { "paths" : [ "/a/b", "/a/c" ] } }
+     * Replies with the statuses keyed by native path
+     * e.g. { "id" : "1", "arguments" : { "statuses" : { "/a/b" : "OK", "/a/c" : "SYNC" } } }
+     *
+     * From then on the listener receives the status pushes batched as well, with one
+     * V2/STATUS:{ "arguments" : { "statuses" : { ... } } } message per batch.
+     *
+     * Since version 1.4 the optional "directories" argument adds the statuses of all entries
+     * of these directories to the reply, e.g. { "id" : "1", "arguments" : { "directories" : [ "/a" ] } }
+     */
+    Q_INVOKABLE void command_V2_RETRIEVE_FILE_STATUS(const QSharedPointer<SocketApiJobV2> &job);
+
+    /** The metrics of the last sync run of every folder (added in version 1.3)
+     * e.g. { "id" : "1", "arguments" : { "folders" : [ { "path" : "/a/", "displayName" : "a", "metrics" : { ... } } ] } }
+     * see SyncMetrics::toJson()
+     */
+    Q_INVOKABLE void command_V2_GET_SYNC_METRICS(const QSharedPointer<SocketApiJobV2> &job) const;
+
     // Fetch the private link and call targetFun
     void fetchPrivateLinkUrlHelper(const QString &localFile, const std::function<void(const QUrl &url)> &targetFun);
 
@@ -163,5 +195,12 @@ private:
     QSet<AccountPtr> _registeredAccounts;
     QMap<SocketApiSocket *, QSharedPointer<SocketListener>> _listeners;
     SocketApiServer _localServer;
+
+    // status changes are collected for a short while, only the last status of a path is sent
+    QHash<QString, SyncFileStatus> _pendingStatusPushes;
+    QTimer _statusPushTimer;
+
+    // lets the shell integration look up statuses without asking us
+    std::unique_ptr<SocketApiStatusTable> _statusTable;
 };
 }
@@ -17,8 +17,12 @@
 #ifndef SOCKETAPI_P_H
 #define SOCKETAPI_P_H
 
+#include "gui/owncloudguilib.h"
+
 #include <functional>
 #include <QBitArray>
+#include <QHash>
+#include <QIODevice>
 #include <QPointer>
 
 #include <QJsonDocument>
@@ -53,7 +57,7 @@ private:
     QBitArray hashBits;
 };
 
-class SocketListener
+class OWNCLOUDGUI_EXPORT SocketListener
 {
 public:
     QPointer<QIODevice> socket;
@@ -64,6 +68,16 @@ public:
     }
 
     void sendMessage(const QString &message, bool doWait = false) const;
+    /**
+     * Sends the statuses, keyed by native path, as one V2/STATUS or as STATUS messages
+     *
+     * While the shell doesn't keep up with reading, the statuses are held back and a newer
+     * status of the same path replaces the older one. They are sent once the socket drained,
+     * or before any other message so that e.g. an UPDATE_VIEW still arrives after them.
+     */
+    void sendStatusPushes(const QHash<QString, QString> &statuses) const;
+    // Sends the held back statuses if the socket drained
+    void sendHeldBackStatuses() const;
     void sendWarning(const QString &message, bool doWait = false) const
     {
         sendMessage(QStringLiteral("WARNING:") + message, doWait);
@@ -75,14 +89,26 @@ public:
 
     void sendMessageIfDirectoryMonitored(const QString &message, size_t systemDirectoryHash) const
     {
-        if (_monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash))
+        if (isDirectoryMonitored(systemDirectoryHash))
             sendMessage(message, false);
     }
 
+    bool isDirectoryMonitored(size_t systemDirectoryHash) const { return _monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash); }
     void registerMonitoredDirectory(size_t systemDirectoryHash) { _monitoredDirectoriesBloomFilter.storeHash(systemDirectoryHash); }
 
+    // Whether the listener asked with V2/RETRIEVE_FILE_STATUS and thus understands batched status pushes
+    bool batchedStatusPushes = false;
+
 private:
+    // status pushes are held back while more than this is waiting to be written to the socket
+    static constexpr qint64 MaxBacklog = 256 * 1024;
+
+    bool isBacklogged() const { return socket && socket->bytesToWrite() > MaxBacklog; }
+    void writeStatusPushes(const QHash<QString, QString> &statuses) const;
+    void writeMessage(const QString &message, bool doWait) const;
+
     BloomFilter _monitoredDirectoriesBloomFilter;
+    mutable QHash<QString, QString> _heldBackStatuses;
 };
 
 class ListenerClosure : public QObject
@@ -142,6 +168,7 @@ public:
 
     const QJsonObject &arguments() const { return _arguments; }
     QString command() const { return _command; }
+    const QSharedPointer<SocketListener> &socketListener() const { return _socketListener; }
 
     QString warning() const;
     void setWarning(const QString &warning);
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "socketapistatustable.h"
+
+#include "common/utility.h"
+
+#include <QFileInfo>
+#include <QDir>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include "common/utility_win.h"
+
+#include <qt_windows.h>
+#endif
+
+namespace {
+// The order is part of the shared layout
+const std::array<QLatin1String, 9> StatusStrings = {QLatin1String("NOP"), QLatin1String("SYNC"), QLatin1String("SYNC+SWM"), QLatin1String("IGNORE"),
+    QLatin1String("IGNORE+SWM"), QLatin1String("OK"), QLatin1String("OK+SWM"), QLatin1String("ERROR"), QLatin1String("ERROR+SWM")};
+
+constexpr qint64 TableSize = sizeof(OCC::SocketApiStatusTable::Header) + qint64(OCC::SocketApiStatusTable::SlotCount) * sizeof(OCC::SocketApiStatusTable::Slot);
+
+// Stop inserting once the table is that full, the probe sequences would get too long
+constexpr uint32_t MaximumUsedSlots = OCC::SocketApiStatusTable::SlotCount / 4 * 3;
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcSocketApiStatusTable, "gui.socketapi.statustable", QtInfoMsg)
+
+SocketApiStatusTable::SocketApiStatusTable(const QString &name)
+{
+    void *data = nullptr;
+#ifdef Q_OS_WIN
+    // a mapping backed by the paging file, it lives as long as a client or an extension has it open
+    _mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(TableSize), reinterpret_cast<const wchar_t *>(name.utf16()));
+    if (!_mapping) {
+        qCWarning(lcSocketApiStatusTable) << "Failed to create the status table" << name << Utility::formatWinError(GetLastError());
+        return;
+    }
+    data = MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, TableSize);
+    if (!data) {
+        qCWarning(lcSocketApiStatusTable) << "Failed to map the status table" << name << Utility::formatWinError(GetLastError());
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+        return;
+    }
+#else
+    QDir().mkpath(QFileInfo(name).path());
+    _file.setFileName(name);
+    // don't truncate, a reader might still have the file of the previous run mapped
+    if (!_file.open(QIODevice::ReadWrite) || !_file.resize(TableSize)) {
+        qCWarning(lcSocketApiStatusTable) << "Failed to create the status table" << name << _file.errorString();
+        return;
+    }
+    data = _file.map(0, TableSize);
+    if (!data) {
+        qCWarning(lcSocketApiStatusTable) << "Failed to map the status table" << name << _file.errorString();
+        return;
+    }
+#endif
+    _header = static_cast<Header *>(data);
+    _slots = reinterpret_cast<Slot *>(static_cast<char *>(data) + sizeof(Header));
+
+    // the mapping might be left over from a previous run that is still open in a reader
+    reset();
+    _header->version = Version;
+    _header->slotCount = SlotCount;
+    _header->magic.store(Magic, std::memory_order_release);
+    qCInfo(lcSocketApiStatusTable) << "Publishing file statuses in" << name;
+}
+
+SocketApiStatusTable::~SocketApiStatusTable()
+{
+    if (!_header) {
+        return;
+    }
+    // readers that still have the table open must not use stale entries
+    _header->magic.store(0, std::memory_order_release);
+    reset();
+#ifdef Q_OS_WIN
+    UnmapViewOfFile(_header);
+    CloseHandle(_mapping);
+#else
+    _file.unmap(reinterpret_cast<uchar *>(_header));
+#endif
+}
+
+void SocketApiStatusTable::insert(const QString &nativePath, const SyncFileStatus &status)
+{
+    if (!_header) {
+        return;
+    }
+    const auto h = hash(nativePath);
+    if (_used >= MaximumUsedSlots && _removed > 0) {
+        compact();
+    }
+    if (auto *slot = find(h, _used < MaximumUsedSlots)) {
+        const auto previous = slot->status.load(std::memory_order_relaxed);
+        if (previous == 0) {
+            ++_used;
+        } else if (previous == Removed) {
+            --_removed;
+        }
+        write(slot, h, statusCode(status));
+        _paths.insert(nativePath);
+    }
+}
+
+bool SocketApiStatusTable::update(const QString &nativePath, const SyncFileStatus &status)
+{
+    if (!_header) {
+        return false;
+    }
+    const auto h = hash(nativePath);
+    auto *slot = find(h, false);
+    if (!slot) {
+        return false;
+    }
+    const auto code = statusCode(status);
+    if (slot->status.load(std::memory_order_relaxed) != code) {
+        write(slot, h, code);
+    }
+    return true;
+}
+
+bool SocketApiStatusTable::remove(const QString &nativePath)
+{
+    if (!_header || _paths.erase(nativePath) == 0) {
+        return false;
+    }
+    const auto h = hash(nativePath);
+    if (auto *slot = find(h, false)) {
+        // the slot can't become empty, the probe sequences of other paths might lead over it
+        write(slot, 0, Removed);
+        ++_removed;
+    }
+    return true;
+}
+
+void SocketApiStatusTable::removeDescendants(const QString &nativeDirectory)
+{
+    const QString prefix = nativeDirectory.endsWith(QDir::separator()) ? nativeDirectory : nativeDirectory + QDir::separator();
+    remove(nativeDirectory);
+    for (auto it = _paths.lower_bound(prefix); it != _paths.end() && it->startsWith(prefix);) {
+        // remove() erases the entry
+        remove(*it++);
+    }
+}
+
+uint64_t SocketApiStatusTable::hash(const QString &nativePath)
+{
+#ifdef Q_OS_MAC
+    // Finder hands out decomposed paths
+    const QString path = nativePath.normalized(QString::NormalizationForm_D);
+#else
+    const QString &path = nativePath;
+#endif
+    uint64_t h = 14695981039346656037ull;
+    for (const QChar c : path) {
+        h ^= c.unicode();
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint32_t SocketApiStatusTable::statusCode(const SyncFileStatus &status)
+{
+    const QString str = status.toSocketAPIString();
+    const auto it = std::find(StatusStrings.cbegin(), StatusStrings.cend(), str);
+    Q_ASSERT(it != StatusStrings.cend());
+    return static_cast<uint32_t>(std::distance(StatusStrings.cbegin(), it) + 1);
+}
+
+SocketApiStatusTable::Slot *SocketApiStatusTable::find(uint64_t hash, bool insert)
+{
+    Slot *firstRemoved = nullptr;
+    for (uint32_t i = 0; i < MaximumProbes; ++i) {
+        auto *slot = &_slots[(hash + i) % SlotCount];
+        const auto status = slot->status.load(std::memory_order_relaxed);
+        if (status == 0) {
+            if (!insert) {
+                return nullptr;
+            }
+            return firstRemoved ? firstRemoved : slot;
+        }
+        if (status == Removed) {
+            if (!firstRemoved) {
+                firstRemoved = slot;
+            }
+            continue;
+        }
+        if (slot->hash.load(std::memory_order_relaxed) == hash) {
+            return slot;
+        }
+    }
+    return insert ? firstRemoved : nullptr;
+}
+
+void SocketApiStatusTable::write(Slot *slot, uint64_t hash, uint32_t status)
+{
+    const auto sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->hash.store(hash, std::memory_order_relaxed);
+    slot->status.store(status, std::memory_order_relaxed);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void SocketApiStatusTable::reset()
+{
+    const auto sequence = _header->sequence.load(std::memory_order_relaxed) | 1;
+    _header->sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memset(static_cast<void *>(_slots), 0, sizeof(Slot) * SlotCount);
+    _header->sequence.store(sequence + 1, std::memory_order_release);
+    _used = 0;
+    _removed = 0;
+    _paths.clear();
+}
+
+void SocketApiStatusTable::compact()
+{
+    std::vector<std::pair<uint64_t, uint32_t>> entries;
+    entries.reserve(_used - _removed);
+    for (uint32_t i = 0; i < SlotCount; ++i) {
+        const auto status = _slots[i].status.load(std::memory_order_relaxed);
+        if (status != 0 && status != Removed) {
+            entries.emplace_back(_slots[i].hash.load(std::memory_order_relaxed), status);
+        }
+    }
+
+    // the readers miss while the header sequence is odd
+    const auto sequence = _header->sequence.load(std::memory_order_relaxed) | 1;
+    _header->sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memset(static_cast<void *>(_slots), 0, sizeof(Slot) * SlotCount);
+    for (const auto &[hash, status] : entries) {
+        auto *slot = find(hash, true);
+        slot->hash.store(hash, std::memory_order_relaxed);
+        slot->status.store(status, std::memory_order_relaxed);
+    }
+    _header->sequence.store(sequence + 1, std::memory_order_release);
+    _used = static_cast<uint32_t>(entries.size());
+    _removed = 0;
+    qCDebug(lcSocketApiStatusTable) << "Compacted the status table to" << _used << "entries";
+}
+}
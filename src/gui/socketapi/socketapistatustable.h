@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "gui/owncloudguilib.h"
+
+#include "common/syncfilestatus.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+
+namespace OCC {
+
+Q_DECLARE_LOGGING_CATEGORY(lcSocketApiStatusTable)
+
+/**
+ * @brief A file status table in shared memory, read by the shell integrations
+ * @ingroup gui
+ *
+ * The table lets the shell extensions look up the status of a file without a
+ * round trip through the socket api while Explorer or Finder paint a folder.
+ * Only the client writes to it, the readers never block the writer:
+ *
+ *  - the table is an open addressing hash table keyed by a 64 bit FNV-1a hash of
+ *    the UTF-16 code units of the native path, see hash(),
+ *  - every slot is guarded by a sequence counter, which is odd while the slot is
+ *    written; a reader that sees an odd or changed counter treats the lookup as a miss,
+ *  - a removed slot keeps the status Removed, a reader continues probing over it
+ *    and stops at the first empty slot or after MaximumProbes slots,
+ *  - the header sequence is odd while the table is reset or compacted.
+ *
+ * Entries are only inserted for paths the shell asked for. The socket api keeps
+ * pushing the status changes of those paths, so the readers may keep them cached.
+ *
+ * The layout is duplicated in shell_integration/windows/OCUtil/StatusTable.h and
+ * in the Finder extension, keep them in sync and bump Version on changes.
+ */
+class OWNCLOUDGUI_EXPORT SocketApiStatusTable
+{
+public:
+    static constexpr uint32_t Magic = 0x5453434f; // "OCST"
+    static constexpr uint32_t Version = 2;
+    static constexpr uint32_t SlotCount = 1 << 18;
+    static constexpr uint32_t MaximumProbes = 32;
+    // the status of a removed slot
+    static constexpr uint32_t Removed = 0xffffffff;
+
+    struct Header
+    {
+        std::atomic<uint32_t> magic;
+        uint32_t version;
+        uint32_t slotCount;
+        std::atomic<uint32_t> sequence;
+    };
+
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;
+        // 0 for an empty slot, otherwise the 1 based index into the list of status strings
+        std::atomic<uint32_t> status;
+        std::atomic<uint64_t> hash;
+    };
+    static_assert(sizeof(Header) == 16 && sizeof(Slot) == 16, "The layout is shared with the shell integrations");
+    static_assert(offsetof(Header, sequence) == 12 && offsetof(Slot, status) == 4 && offsetof(Slot, hash) == 8,
+        "The layout is shared with the shell integrations");
+
+    /** Creates the table, \a name is a shared memory name on Windows and a file path elsewhere */
+    explicit SocketApiStatusTable(const QString &name);
+    ~SocketApiStatusTable();
+
+    bool isValid() const { return _header != nullptr; }
+
+    /** Sets the status of \a nativePath, adding it to the table if there is room */
+    void insert(const QString &nativePath, const SyncFileStatus &status);
+
+    /** Sets the status of \a nativePath if it is in the table, returns whether it was */
+    bool update(const QString &nativePath, const SyncFileStatus &status);
+
+    /** Removes \a nativePath from the table, returns whether it was in it */
+    bool remove(const QString &nativePath);
+
+    /** Removes \a nativeDirectory and everything below it from the table */
+    void removeDescendants(const QString &nativeDirectory);
+
+    /** The number of paths in the table */
+    qsizetype size() const { return static_cast<qsizetype>(_paths.size()); }
+
+    static uint64_t hash(const QString &nativePath);
+
+    /** The value stored in a slot for \a status, an index into the list of socket api status strings plus one */
+    static uint32_t statusCode(const SyncFileStatus &status);
+
+private:
+    Slot *find(uint64_t hash, bool insert);
+    void write(Slot *slot, uint64_t hash, uint32_t status);
+    void reset();
+    // rewrites the table without the removed slots
+    void compact();
+
+    Header *_header = nullptr;
+    Slot *_slots = nullptr;
+    // the slots that are not empty, including the removed ones
+    uint32_t _used = 0;
+    uint32_t _removed = 0;
+    // the published paths, sorted so a directory is followed by its descendants
+    std::set<QString> _paths;
+
+#ifdef Q_OS_WIN
+    void *_mapping = nullptr;
+#else
+    QFile _file;
+#endif
+};
+}
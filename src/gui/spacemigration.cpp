@@ -38,13 +38,18 @@ SpaceMigration::SpaceMigration(const AccountStatePtr &account, const QString &pa
 
 void SpaceMigration::start()
 {
-    FolderMan::instance()->setSyncEnabled(false);
+    // Only the folders of this account have to wait for the migration
+    _accountState->_spaceMigrationRunning = true;
 
     QJsonArray folders;
     for (auto *f : FolderMan::instance()->folders()) {
         // same account and uses the legacy dav url
-        // already migrated folders are ignored
+        // already migrated folders are ignored, an interrupted migration continues with the remaining ones
         if (f->accountState()->account() == _accountState->account() && f->webDavUrl() == _accountState->account()->davUrl()) {
+            if (f->isSyncRunning()) {
+                qCInfo(lcMigration) << "Migrating" << f->path() << "on the next connection, it is syncing";
+                continue;
+            }
             folders.append(f->remotePath());
             _migrationFolders.append(f);
         }
@@ -61,7 +66,7 @@ void SpaceMigration::start()
             if (job->parseError().error != QJsonParseError::NoError) {
                 qCInfo(lcMigration) << job->parseError().errorString();
             }
-            Q_EMIT finished();
+            finish();
         }
     });
     job->start();
@@ -69,7 +74,7 @@ void SpaceMigration::start()
 
 void SpaceMigration::migrate(const QJsonObject &folders)
 {
-    auto drivesJob = new GraphApi::Drives(_accountState->account(), this);
+    auto drivesJob = new GraphApi::Drives(_accountState->account(), {}, this);
     connect(drivesJob, &GraphApi::Drives::finishedSignal, [drivesJob, folders, this] {
         const auto drives = drivesJob->drives();
         for (auto &folder : _migrationFolders) {
@@ -96,8 +101,19 @@ void SpaceMigration::migrate(const QJsonObject &folders)
         }
         _accountState->_supportsSpaces = true;
         AccountManager::instance()->save();
-        FolderMan::instance()->setSyncEnabled(true);
-        Q_EMIT finished();
+        finish();
     });
     drivesJob->start();
 }
+
+void SpaceMigration::finish()
+{
+    _accountState->_spaceMigrationRunning = false;
+    // Requests to sync the folders were dropped while they could not sync
+    for (const auto &folder : std::as_const(_migrationFolders)) {
+        if (folder && folder->canSync()) {
+            FolderMan::instance()->scheduler()->enqueueFolder(folder);
+        }
+    }
+    Q_EMIT finished();
+}
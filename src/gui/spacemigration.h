@@ -40,6 +40,7 @@ Q_SIGNALS:
 
 private:
     void migrate(const QJsonObject &folders);
+    void finish();
 
     AccountStatePtr _accountState;
     const QString _path;
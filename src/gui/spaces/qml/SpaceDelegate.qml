@@ -46,6 +46,7 @@ Item {
                     id: image
                     anchors.fill: parent
                     fillMode: Image.PreserveAspectFit
+                    asynchronous: true
                     sourceSize.width: width
                     sourceSize.height: height
                 }
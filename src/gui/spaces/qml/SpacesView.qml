@@ -55,6 +55,8 @@ Pane {
             spacing: 20
             focus: true
             boundsBehavior: Flickable.StopAtBounds
+            // accounts can have hundreds of spaces, only create the visible delegates once
+            reuseItems: true
 
             model: spacesBrowser.model
 
@@ -16,27 +16,72 @@
 #include "resources/qmlresources.h"
 #include "resources/resources.h"
 
+#include <QCoreApplication>
+#include <QImageReader>
+#include <QLoggingCategory>
+#include <QThread>
+#include <QThreadPool>
+
 using namespace OCC;
 using namespace Spaces;
 
+namespace {
+Q_LOGGING_CATEGORY(lcSpaceImageProvider, "gui.spaces.imageprovider", QtInfoMsg)
+
+class SpaceImageResponse : public QQuickImageResponse
+{
+public:
+    QQuickTextureFactory *textureFactory() const override { return QQuickTextureFactory::textureFactoryForImage(_image); }
+
+    /// Renders an icon, only on the gui thread
+    void finishWithIcon(const QIcon &icon, const QSize &requestedSize)
+    {
+        Q_ASSERT(QThread::currentThread() == qApp->thread());
+        _image = Resources::pixmap(requestedSize, icon, QIcon::Normal, nullptr).toImage();
+        Q_EMIT finished();
+    }
+
+    /// Decodes the file scaled to fit into \a requestedSize, on any thread
+    void finishWithFile(const QString &path, const QSize &requestedSize)
+    {
+        QImageReader reader(path);
+        if (requestedSize.isValid() && reader.size().isValid()) {
+            reader.setScaledSize(reader.size().scaled(requestedSize, Qt::KeepAspectRatio));
+        }
+        if (!reader.read(&_image)) {
+            qCWarning(lcSpaceImageProvider) << "Failed to read" << path << reader.errorString();
+        }
+        Q_EMIT finished();
+    }
+
+private:
+    QImage _image;
+};
+}
+
 SpaceImageProvider::SpaceImageProvider(const AccountPtr &account)
-    : QQuickImageProvider(QQuickImageProvider::Pixmap, QQuickImageProvider::ForceAsynchronousImageLoading)
-    , _account(account.data())
+    : _account(account)
 {
 }
 
-QPixmap SpaceImageProvider::requestPixmap(const QString &id, QSize *size, const QSize &requestedSize)
+QQuickImageResponse *SpaceImageProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
 {
-    QIcon icon;
-    if (id == QLatin1String("placeholder")) {
-        icon = Resources::getCoreIcon(QStringLiteral("space"));
-    } else {
-        const auto ids = id.split(QLatin1Char('/'));
-        const auto *space = _account->spacesManager()->space(ids.last());
-        if (space) {
-            icon = space->image()->image();
+    // the engine deletes the response once it emitted finished()
+    auto *response = new SpaceImageResponse;
+    QMetaObject::invokeMethod(qApp, [weakAccount = _account, response, id, requestedSize] {
+        const auto account = weakAccount.toStrongRef();
+        if (id == QLatin1String("placeholder") || !account) {
+            response->finishWithIcon(Resources::getCoreIcon(QStringLiteral("space")), requestedSize);
+            return;
         }
-    }
-    Q_ASSERT(!icon.isNull());
-    return Resources::pixmap(requestedSize, icon, QIcon::Normal, size);
+        const auto *space = account->spacesManager()->space(id.split(QLatin1Char('/')).last());
+        const QString path = space ? space->image()->cachePath() : QString();
+        if (path.isEmpty()) {
+            // the image was not downloaded (yet), the icon falls back to the placeholder
+            response->finishWithIcon(space ? space->image()->image() : Resources::getCoreIcon(QStringLiteral("space")), requestedSize);
+            return;
+        }
+        QThreadPool::globalInstance()->start([response, path, requestedSize] { response->finishWithFile(path, requestedSize); });
+    });
+    return response;
 }
@@ -16,19 +16,25 @@
 
 #include "libsync/account.h"
 
-#include <QQuickImageProvider>
+#include <QQuickAsyncImageProvider>
+#include <QWeakPointer>
 
 namespace OCC::Spaces {
-class SpaceImageProvider : public QQuickImageProvider
+/**
+ * Provides the images of the spaces of an account
+ *
+ * The space is looked up on the gui thread, its image is decoded from the resources cache
+ * in the global thread pool, so scrolling through many spaces does not block the gui.
+ */
+class SpaceImageProvider : public QQuickAsyncImageProvider
 {
-    Q_OBJECT
 public:
     SpaceImageProvider(const AccountPtr &account);
-    QPixmap requestPixmap(const QString &id, QSize *size, const QSize &requestedSize) override;
-
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) override;
 
 private:
-    Account *_account;
+    // requestImageResponse() is called on the thread of the image loader
+    QWeakPointer<Account> _account;
 };
 
 }
@@ -71,11 +71,21 @@ void SpacesModel::setSpacesManager(GraphApi::SpacesManager *spacesManager)
     _spacesList = _spacesManager->spaces();
     endResetModel();
     connect(_spacesManager, &GraphApi::SpacesManager::updated, this, [this] {
+        // both lists are sorted by id, so only rows need to be removed and inserted
         const auto newSpaces = _spacesManager->spaces();
-        if (_spacesList != newSpaces) {
-            beginResetModel();
-            _spacesList = newSpaces;
-            endResetModel();
+        for (auto row = _spacesList.size() - 1; row >= 0; --row) {
+            if (!newSpaces.contains(_spacesList[row])) {
+                beginRemoveRows({}, row, row);
+                _spacesList.removeAt(row);
+                endRemoveRows();
+            }
+        }
+        for (qsizetype row = 0; row < newSpaces.size(); ++row) {
+            if (row >= _spacesList.size() || _spacesList[row] != newSpaces[row]) {
+                beginInsertRows({}, row, row);
+                _spacesList.insert(row, newSpaces[row]);
+                endInsertRows();
+            }
         }
     });
 
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "gui/startuptrace.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QSaveFile>
+
+using namespace std::chrono;
+
+using namespace OCC;
+
+Q_LOGGING_CATEGORY(lcStartupTrace, "gui.startuptrace", QtInfoMsg)
+
+StartupTrace::Span::Span(const QString &name, const QVariantMap &args)
+    : _name(name)
+    , _args(args)
+    , _start(StartupTrace::instance().elapsed())
+{
+}
+
+StartupTrace::Span::~Span()
+{
+    end();
+}
+
+void StartupTrace::Span::end()
+{
+    if (_ended) {
+        return;
+    }
+    _ended = true;
+    auto &trace = StartupTrace::instance();
+    if (trace.isEnabled()) {
+        trace.addEvent(_name, _args, _start, trace.elapsed() - _start);
+    }
+}
+
+StartupTrace::StartupTrace()
+{
+    _timer.start();
+}
+
+StartupTrace &StartupTrace::instance()
+{
+    static StartupTrace trace;
+    return trace;
+}
+
+void StartupTrace::setOutputFile(const QString &path)
+{
+    _outputFile = path;
+    if (path.isEmpty()) {
+        _enabled = false;
+        _events = {};
+    }
+}
+
+microseconds StartupTrace::elapsed() const
+{
+    return duration_cast<microseconds>(nanoseconds(_timer.nsecsElapsed()));
+}
+
+void StartupTrace::addEvent(const QString &name, const QVariantMap &args, microseconds start, microseconds duration)
+{
+    // a complete event of the Trace Event Format
+    QJsonObject event{{QStringLiteral("name"), name}, {QStringLiteral("cat"), QStringLiteral("startup")}, {QStringLiteral("ph"), QStringLiteral("X")},
+        {QStringLiteral("ts"), static_cast<qint64>(start.count())}, {QStringLiteral("dur"), static_cast<qint64>(duration.count())},
+        {QStringLiteral("pid"), QCoreApplication::applicationPid()}, {QStringLiteral("tid"), 0}};
+    if (!args.isEmpty()) {
+        event.insert(QStringLiteral("args"), QJsonObject::fromVariantMap(args));
+    }
+    _events.append(event);
+}
+
+void StartupTrace::finish()
+{
+    if (!_enabled) {
+        return;
+    }
+    _enabled = false;
+    addEvent(QStringLiteral("startup"), {}, {}, elapsed());
+
+    QSaveFile file(_outputFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcStartupTrace) << "Failed to write the startup trace to" << _outputFile << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(QJsonObject{{QStringLiteral("traceEvents"), _events}, {QStringLiteral("displayTimeUnit"), QStringLiteral("ms")}}).toJson());
+    if (file.commit()) {
+        qCInfo(lcStartupTrace) << "Wrote the startup trace to" << _outputFile << "after" << duration_cast<milliseconds>(elapsed());
+    }
+    _events = {};
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "gui/owncloudguilib.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QString>
+#include <QVariantMap>
+
+#include <chrono>
+
+namespace OCC {
+
+/**
+ * @brief Records the phases of the startup in the Chrome trace event format
+ *
+ * The spans are recorded from the start of main() until the options are
+ * parsed, with --trace-startup they are written to a file once the folders
+ * were started. The file can be opened with chrome://tracing or
+ * https://ui.perfetto.dev, nested spans are shown below each other.
+ *
+ * Only used from the main thread.
+ */
+class OWNCLOUDGUI_EXPORT StartupTrace
+{
+public:
+    /** Records the time from its construction to its destruction, or to end() */
+    class OWNCLOUDGUI_EXPORT Span
+    {
+    public:
+        explicit Span(const QString &name, const QVariantMap &args = {});
+        ~Span();
+
+        Q_DISABLE_COPY_MOVE(Span)
+
+        /// For spans that end before their scope does
+        void end();
+
+    private:
+        QString _name;
+        QVariantMap _args;
+        std::chrono::microseconds _start;
+        bool _ended = false;
+    };
+
+    static StartupTrace &instance();
+
+    /** Writes the trace to \a path once the startup finished, without a path nothing is recorded any more */
+    void setOutputFile(const QString &path);
+
+    bool isEnabled() const { return _enabled; }
+
+    /** The startup is complete, writes the trace, only the first call has an effect */
+    void finish();
+
+private:
+    StartupTrace();
+
+    std::chrono::microseconds elapsed() const;
+    void addEvent(const QString &name, const QVariantMap &args, std::chrono::microseconds start, std::chrono::microseconds duration);
+
+    QElapsedTimer _timer;
+    QJsonArray _events;
+    QString _outputFile;
+    bool _enabled = true;
+};
+}
@@ -20,101 +20,140 @@
 #include <qfileinfo.h>
 
 namespace {
+constexpr qint64 LogfileMaxSize = 10 * 1024 * 1024; // 10MiB
+// the buffered characters that are handed to the writer at once
+constexpr qsizetype FlushSize = 64 * 1024;
+
 auto dateTimeStr(const QDateTime &dt = QDateTime::currentDateTimeUtc())
 {
     return dt.toString(Qt::ISODate);
 }
 
-}
-namespace OCC {
-
-SyncRunFileLog::SyncRunFileLog()
-{
-}
-
-
-void SyncRunFileLog::start(const QString &folderPath)
+// Runs on the writer thread: opens the log, when it is too big it is renamed to an old name first
+bool openLog(QFile *file, const QString &folderPath)
 {
-    const qint64 logfileMaxSize = 10 * 1024 * 1024; // 10MiB
-
-    // Note; this name is ignored in csync_exclude.c
-    const QString filename = folderPath + QStringLiteral(".owncloudsync.log");
-
-    // When the file is too big, just rename it to an old name.
+    if (file->isOpen()) {
+        if (file->size() <= LogfileMaxSize) {
+            return true;
+        }
+        file->close();
+    }
+    const QString filename = file->fileName();
     QFileInfo info(filename);
     bool exists = info.exists();
-    if (exists && info.size() > logfileMaxSize) {
+    if (exists && info.size() > LogfileMaxSize) {
         exists = false;
         QString newFilename = filename + QStringLiteral(".1");
         QFile::remove(newFilename);
         QFile::rename(filename, newFilename);
     }
-    _file.reset(new QFile(filename));
-    _file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
-
-
-    // we use a text stream to ensure the encoding is ok
-    // when outputting info, we use QDebug to ensure we can use the debug operators
-    _out.reset(new QTextStream(_file.data()));
-    _out->setEncoding(QStringConverter::Utf8);
-
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        return false;
+    }
 
     if (!exists) {
         // We are creating a new file, add the note.
-        *_out << "Log for:" << folderPath << Qt::endl
-              << "# timestamp | duration | file | instruction | dir | modtime | etag | "
-                 "size | fileId | status | errorString | http result code | "
-                 "other size | other modtime | X-Request-ID"
-              << Qt::endl;
-
-        FileSystem::setFileHidden(filename, true);
+        file->write(QStringLiteral("Log for:%1\n"
+                                   "# timestamp | duration | file | instruction | dir | modtime | etag | "
+                                   "size | fileId | status | errorString | http result code | "
+                                   "other size | other modtime | X-Request-ID\n")
+                        .arg(folderPath)
+                        .toUtf8());
+
+        OCC::FileSystem::setFileHidden(filename, true);
     }
+    return true;
+}
+
+}
+namespace OCC {
+
+SyncRunFileLog::SyncRunFileLog()
+{
+    _writer.setMaxThreadCount(1);
+}
+
+SyncRunFileLog::~SyncRunFileLog()
+{
+    close();
+    _writer.waitForDone();
+}
 
+void SyncRunFileLog::start(const QString &folderPath)
+{
+    close();
+    _folderPath = folderPath;
+    // Note; this name is ignored in csync_exclude.c
+    _file = std::make_shared<QFile>(folderPath + QStringLiteral(".owncloudsync.log"));
 
     _totalDuration.start();
     _lapDuration.start();
-    *_out << "#=#=#=# Syncrun started " << dateTimeStr() << Qt::endl;
+    _buffer = QStringLiteral("#=#=#=# Syncrun started %1\n").arg(dateTimeStr());
+    flush();
 }
 
 void SyncRunFileLog::logItem(const SyncFileItem &item)
 {
     // don't log the directory items that are in the list
-    if (item._direction == SyncFileItem::None || item.instruction() == CSYNC_INSTRUCTION_IGNORE) {
+    if (!_file || item._direction == SyncFileItem::None || item.instruction() == CSYNC_INSTRUCTION_IGNORE) {
         return;
     }
     const QChar L = QLatin1Char('|');
-    QString tmp;
     {
-        QDebug(&tmp).noquote() << dateTimeStr(Utility::parseRFC1123Date(QString::fromUtf8(item._responseTimeStamp))) << L
-                               << ((item.instruction() != CSYNC_INSTRUCTION_RENAME) ? item.destination()
-                                                                                    : item._file + QStringLiteral(" -> ") + item._renameTarget)
-                               << L << item.instruction() << L << item._direction << L << L << item._modtime << L << item._etag << L << item._size << L
-                               << item._fileId << L << item._status << L << item._errorString << L << item._httpErrorCode << L << item._previousSize << L
-                               << item._previousModtime << L << item._requestId << L << Qt::endl;
+        QDebug(&_buffer).noquote() << dateTimeStr(Utility::parseRFC1123Date(QString::fromUtf8(item._responseTimeStamp))) << L
+                                   << ((item.instruction() != CSYNC_INSTRUCTION_RENAME) ? item.destination()
+                                                                                        : item._file + QStringLiteral(" -> ") + item._renameTarget)
+                                   << L << item.instruction() << L << item._direction << L << L << item._modtime << L << item._etag << L << item._size << L
+                                   << item._fileId << L << item._status << L << item._errorString << L << item._httpErrorCode << L << item._previousSize
+                                   << L << item._previousModtime << L << item._requestId << L << Qt::endl;
+    }
+    if (_buffer.size() >= FlushSize) {
+        flush();
     }
-    *_out << tmp;
 }
 
 void SyncRunFileLog::logLap(const QString &name)
 {
-    QString tmp;
+    if (!_file) {
+        return;
+    }
     {
-        QDebug(&tmp).noquote() << "#=#=#=#=#" << name << dateTimeStr() << "(last step:" << _lapDuration.restart() << "msec"
-                               << ", total:" << _totalDuration.elapsed() << "msec)" << Qt::endl;
+        QDebug(&_buffer).noquote() << "#=#=#=#=#" << name << dateTimeStr() << "(last step:" << _lapDuration.restart() << "msec"
+                                   << ", total:" << _totalDuration.elapsed() << "msec)" << Qt::endl;
     }
-    *_out << tmp;
+    flush();
 }
 
 void SyncRunFileLog::finish()
 {
-    QString tmp;
+    if (!_file) {
+        return;
+    }
     {
-        QDebug(&tmp).noquote() << "#=#=#=# Syncrun finished" << dateTimeStr() << "(last step:" << _lapDuration.elapsed() << "msec"
-                               << ", total:" << _totalDuration.elapsed() << "msec)" << Qt::endl;
+        QDebug(&_buffer).noquote() << "#=#=#=# Syncrun finished" << dateTimeStr() << "(last step:" << _lapDuration.elapsed() << "msec"
+                                   << ", total:" << _totalDuration.elapsed() << "msec)" << Qt::endl;
+    }
+    close();
+}
+
+void SyncRunFileLog::close()
+{
+    if (!_file) {
+        return;
+    }
+    flush();
+    _writer.start([file = std::move(_file)] { file->close(); });
+}
+
+void SyncRunFileLog::flush()
+{
+    if (_buffer.isEmpty()) {
+        return;
     }
-    *_out << tmp;
-    _out->flush();
-    _out->reset();
-    _file->close();
+    _writer.start([file = _file, folderPath = _folderPath, lines = std::exchange(_buffer, {})] {
+        if (openLog(file.get(), folderPath)) {
+            file->write(lines.toUtf8());
+        }
+    });
 }
 }
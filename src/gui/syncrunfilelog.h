@@ -15,35 +15,49 @@
 #ifndef SYNCRUNFILELOG_H
 #define SYNCRUNFILELOG_H
 
-#include <QFile>
-#include <QTextStream>
-#include <QScopedPointer>
 #include <QElapsedTimer>
+#include <QFile>
+#include <QThreadPool>
 
 #include "syncfileitem.h"
 
+#include <memory>
+
 namespace OCC {
 class SyncFileItem;
 
 /**
  * @brief The SyncRunFileLog class
  * @ingroup gui
+ *
+ * The lines are collected in a buffer and written in batches by a thread of
+ * its own, so a sync of many items doesn't write to the log from the main
+ * thread for every item. The log is renamed to an old name once it grows
+ * beyond 10MiB, also in the middle of a sync run.
  */
 class SyncRunFileLog
 {
 public:
     SyncRunFileLog();
+    ~SyncRunFileLog();
     void start(const QString &folderPath);
     void logItem(const SyncFileItem &item);
     void logLap(const QString &name);
     void finish();
 
-protected:
 private:
-    QScopedPointer<QFile> _file;
+    // hands the buffered lines to the writer thread
+    void flush();
+    void close();
+
+    QString _folderPath;
     QElapsedTimer _totalDuration;
     QElapsedTimer _lapDuration;
-    QScopedPointer<QTextStream> _out;
+    QString _buffer;
+    // only used by the writer thread once it was created
+    std::shared_ptr<QFile> _file;
+    // a single thread, so the batches are written in order
+    QThreadPool _writer;
 };
 }
 
@@ -12,11 +12,16 @@
  * for more details.
  */
 
+#include <QCryptographicHash>
 #include <QMessageBox>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSaveFile>
 #include <QSettings>
 #include <QTimer>
 #include <appimage/update.h>
 #include <chrono>
+#include <memory>
 
 #include "appimageupdater.h"
 #include "common/version.h"
@@ -116,6 +121,37 @@ private:
     appimage::update::Updater _updater;
 };
 
+/**
+ * The fields of the header of a zsync control file that are needed for a full download
+ */
+struct ZsyncHeader
+{
+    QUrl url;
+    QByteArray sha1;
+
+    static ZsyncHeader parse(const QUrl &zsyncUrl, const QByteArray &data)
+    {
+        ZsyncHeader out;
+        // the header ends with an empty line, the block checksums follow
+        const auto headerEnd = data.indexOf("\n\n");
+        for (const auto &line : data.left(headerEnd == -1 ? data.size() : headerEnd).split('\n')) {
+            const auto separator = line.indexOf(": ");
+            if (separator == -1) {
+                continue;
+            }
+            const auto key = line.left(separator);
+            const auto value = line.mid(separator + 2).trimmed();
+            if (key == "URL") {
+                // relative to the control file
+                out.url = zsyncUrl.resolved(QUrl(QString::fromUtf8(value)));
+            } else if (key == "SHA-1") {
+                out.sha1 = QByteArray::fromHex(value);
+            }
+        }
+        return out;
+    }
+};
+
 } // namespace
 
 AppImageUpdater::AppImageUpdater(const QUrl &url)
@@ -164,15 +200,16 @@ void AppImageUpdater::versionInfoArrived(const UpdateInfo &info)
 
     connect(widget, &AppImageUpdateAvailableWidget::rejected, this, &QObject::deleteLater);
 
-    connect(widget, &AppImageUpdateAvailableWidget::accepted, this, [this, widget, appImageUpdaterShim]() {
+    connect(widget, &AppImageUpdateAvailableWidget::accepted, this, [this, widget, appImageUpdaterShim, zsyncUrl = QUrl(info.downloadUrl())]() {
         // binding AppImageUpdaterShim shared pointer to finished callback makes sure the updater is cleaned up when it's done
-        connect(appImageUpdaterShim, &AppImageUpdaterShim::finished, this, [this](bool succeeded) {
+        connect(appImageUpdaterShim, &AppImageUpdaterShim::finished, this, [this, zsyncUrl](bool succeeded) {
             if (succeeded) {
                 qCInfo(lcUpdater) << "AppImage update complete";
                 setDownloadState(DownloadComplete);
             } else {
-                qCInfo(lcUpdater) << "AppImage update failed";
-                setDownloadState(DownloadFailed);
+                // e.g. the blocks of the installed AppImage did not add up to the new one
+                qCWarning(lcUpdater) << "AppImage delta update failed, downloading the full AppImage";
+                downloadFullAppImage(zsyncUrl);
             }
         });
 
@@ -185,6 +222,61 @@ void AppImageUpdater::versionInfoArrived(const UpdateInfo &info)
     ocApp()->gui()->settingsDialog()->addModalWidget(widget);
 }
 
+void AppImageUpdater::downloadFullAppImage(const QUrl &zsyncUrl)
+{
+    QNetworkRequest request(zsyncUrl);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    auto *zsyncReply = qnam()->get(request);
+    connect(zsyncReply, &QNetworkReply::finished, this, [this, zsyncReply, zsyncUrl] {
+        zsyncReply->deleteLater();
+        const auto header = ZsyncHeader::parse(zsyncUrl, zsyncReply->readAll());
+        if (zsyncReply->error() != QNetworkReply::NoError || !header.url.isValid() || header.sha1.isEmpty()) {
+            qCWarning(lcUpdater) << "Failed to read the zsync control file" << zsyncUrl << zsyncReply->errorString();
+            setDownloadState(DownloadFailed);
+            return;
+        }
+
+        // the AppImage is only replaced once the download is complete and verified
+        auto file = std::make_shared<QSaveFile>(Utility::appImageLocation());
+        if (!file->open(QIODevice::WriteOnly)) {
+            qCWarning(lcUpdater) << "Failed to write the AppImage" << file->fileName() << file->errorString();
+            setDownloadState(DownloadFailed);
+            return;
+        }
+        const auto permissions = QFile(file->fileName()).permissions();
+        auto hash = std::make_shared<QCryptographicHash>(QCryptographicHash::Sha1);
+
+        QNetworkRequest request(header.url);
+        request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+        auto *reply = qnam()->get(request);
+        connect(reply, &QIODevice::readyRead, this, [reply, file, hash] {
+            const auto data = reply->readAll();
+            hash->addData(data);
+            file->write(data);
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, reply, file, hash, permissions, expectedSha1 = header.sha1] {
+            reply->deleteLater();
+            const auto data = reply->readAll();
+            hash->addData(data);
+            file->write(data);
+            if (reply->error() != QNetworkReply::NoError || hash->result() != expectedSha1) {
+                qCWarning(lcUpdater) << "Full AppImage download failed" << reply->url() << reply->errorString();
+                file->cancelWriting();
+                setDownloadState(DownloadFailed);
+                return;
+            }
+            if (!file->commit()) {
+                qCWarning(lcUpdater) << "Failed to replace the AppImage" << file->fileName() << file->errorString();
+                setDownloadState(DownloadFailed);
+                return;
+            }
+            QFile::setPermissions(file->fileName(), permissions);
+            qCInfo(lcUpdater) << "AppImage update complete, downloaded the full AppImage";
+            setDownloadState(DownloadComplete);
+        });
+    });
+}
+
 void AppImageUpdater::backgroundCheckForUpdate()
 {
     OCUpdater::backgroundCheckForUpdate();
@@ -35,6 +35,9 @@ public:
 
 private:
     void versionInfoArrived(const UpdateInfo &succeeded) override;
+
+    /** Replaces the AppImage with the full file named in the zsync control file, if the delta update failed */
+    void downloadFullAppImage(const QUrl &zsyncUrl);
 };
 
 } // namespace OCC
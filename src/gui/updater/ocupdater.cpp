@@ -304,12 +304,14 @@ void WindowsUpdater::slotDownloadFinished()
     const QUrl url(reply->url());
     reply->deleteLater();
     _file->close();
-    if (reply->error() != QNetworkReply::NoError) {
-        setDownloadState(DownloadFailed);
-        return;
-    }
     const auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
-    if (status != 200) {
+    if (reply->error() != QNetworkReply::NoError || status != 200) {
+        // the patch might not be published for every release, the full installer always is
+        if (_targetFile.endsWith(QLatin1String(".msp")) && !updateInfo().downloadUrl().isEmpty()) {
+            qCWarning(lcUpdater) << "Failed to download the patch" << url.toString() << reply->errorString() << ", downloading the full installer";
+            startDownload(updateInfo().downloadUrl());
+            return;
+        }
         setDownloadState(DownloadFailed);
         return;
     }
@@ -342,7 +344,8 @@ void WindowsUpdater::versionInfoArrived(const UpdateInfo &info)
                       << "Available version:" << infoVersion << info.version()
                       << "Available version string:" << info.versionString()
                       << "Web url:" << info.web()
-                      << "Download url:" << info.downloadUrl();
+                      << "Download url:" << info.downloadUrl()
+                      << "Patch url:" << info.patchUrl();
     if (info.version().isEmpty())
     {
         qCInfo(lcUpdater) << "No version information available at the moment";
@@ -352,28 +355,35 @@ void WindowsUpdater::versionInfoArrived(const UpdateInfo &info)
         qCInfo(lcUpdater) << "Client is on latest version!";
         setDownloadState(UpToDate);
     } else {
-        const QString url = info.downloadUrl();
+        // prefer the patch, unless it could not be applied to this installation before
+        const bool usePatch = !info.patchUrl().isEmpty() && settings.value(patchFailedVersionC).toString() != info.version();
+        const QString url = usePatch ? info.patchUrl() : info.downloadUrl();
         if (url.isEmpty()) {
             showNewVersionAvailableWidget(info);
         } else {
-            _targetFile = ConfigFile::configPath() + url.mid(url.lastIndexOf(QLatin1Char('/')) + 1);
-            if (QFile::exists(_targetFile)) {
-                setDownloadState(DownloadComplete);
-            } else {
-                auto request = QNetworkRequest(QUrl(url));
-                request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
-                QNetworkReply *reply = qnam()->get(request);
-                connect(reply, &QIODevice::readyRead, this, &WindowsUpdater::slotWriteFile);
-                connect(reply, &QNetworkReply::finished, this, &WindowsUpdater::slotDownloadFinished);
-                setDownloadState(Downloading);
-                _file.reset(new QTemporaryFile);
-                _file->setAutoRemove(true);
-                _file->open();
-            }
+            startDownload(url);
         }
     }
 }
 
+void WindowsUpdater::startDownload(const QString &url)
+{
+    _targetFile = ConfigFile::configPath() + url.mid(url.lastIndexOf(QLatin1Char('/')) + 1);
+    if (QFile::exists(_targetFile)) {
+        setDownloadState(DownloadComplete);
+        return;
+    }
+    auto request = QNetworkRequest(QUrl(url));
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    QNetworkReply *reply = qnam()->get(request);
+    connect(reply, &QIODevice::readyRead, this, &WindowsUpdater::slotWriteFile);
+    connect(reply, &QNetworkReply::finished, this, &WindowsUpdater::slotDownloadFinished);
+    setDownloadState(Downloading);
+    _file.reset(new QTemporaryFile);
+    _file->setAutoRemove(true);
+    _file->open();
+}
+
 void WindowsUpdater::showNewVersionAvailableWidget(const UpdateInfo &info)
 {
     // if the version tag is set, there is a newer version.
@@ -465,6 +475,12 @@ void WindowsUpdater::validateUpdate()
                 qCInfo(lcUpdater) << "The requested update attempt has succeeded"
                                   << Version::versionWithBuildNumber();
                 wipeUpdateData();
+            } else if (updateFileName.endsWith(QLatin1String(".msp"))) {
+                // the patch did not match the installation, the next check downloads the full installer
+                qCInfo(lcUpdater) << "The requested patch attempt has failed" << settings.value(updateTargetVersionC).toString();
+                const auto targetVersion = settings.value(updateTargetVersionC).toString();
+                wipeUpdateData();
+                ConfigFile::makeQSettings().setValue(patchFailedVersionC, targetVersion);
             } else {
                 // auto update failed. Ask user what to do
                 qCInfo(lcUpdater) << "The requested update attempt has failed"
@@ -490,7 +506,8 @@ void WindowsUpdater::applyUpdateAndRestart()
     settings.sync();
     qCInfo(lcUpdater) << "Running updater" << updateFile;
 
-    Q_ASSERT(updateFile.endsWith(QLatin1String(".msi")));
+    const bool isPatch = updateFile.endsWith(QLatin1String(".msp"));
+    Q_ASSERT(isPatch || updateFile.endsWith(QLatin1String(".msi")));
     // When MSIs are installed without gui they cannot launch applications
     // as they lack the user context. That is why we need to run the client
     // manually here. We wrap the msiexec and client invocation in a powershell
@@ -504,8 +521,8 @@ void WindowsUpdater::applyUpdateAndRestart()
 
     QString msiLogFile = ConfigFile::configPath() + QStringLiteral("msi.log");
     const QString command =
-        QStringLiteral("&{msiexec /norestart /passive /i '%1' /L*V '%2'| Out-Null ; &'%3'}")
-            .arg(preparePathForPowershell(updateFile), preparePathForPowershell(msiLogFile), preparePathForPowershell(QCoreApplication::applicationFilePath()));
+        QStringLiteral("&{msiexec /norestart /passive %1 '%2' /L*V '%3'| Out-Null ; &'%4'}")
+            .arg(isPatch ? QStringLiteral("/update") : QStringLiteral("/i"), preparePathForPowershell(updateFile), preparePathForPowershell(msiLogFile), preparePathForPowershell(QCoreApplication::applicationFilePath()));
 
     QProcess::startDetached(QStringLiteral("powershell.exe"), QStringList{QStringLiteral("-Command"), command});
     QTimer::singleShot(0, QApplication::instance(), &QApplication::quit);
@@ -186,6 +186,7 @@ private Q_SLOTS:
 
 private:
     void wipeUpdateData();
+    void startDownload(const QString &url);
     void showNewVersionAvailableWidget(const UpdateInfo &info);
     void showUpdateErrorDialog(const QString &targetVersion);
     void versionInfoArrived(const UpdateInfo &info) override;
@@ -51,6 +51,16 @@ QString UpdateInfo::downloadUrl() const
     return mDownloadUrl;
 }
 
+void UpdateInfo::setPatchUrl(const QString &v)
+{
+    mPatchUrl = v;
+}
+
+QString UpdateInfo::patchUrl() const
+{
+    return mPatchUrl;
+}
+
 UpdateInfo UpdateInfo::parseElement(const QDomElement &element, bool *ok)
 {
     if (element.tagName() != QLatin1String("owncloudclient")) {
@@ -73,6 +83,8 @@ UpdateInfo UpdateInfo::parseElement(const QDomElement &element, bool *ok)
             result.setWeb(e.text());
         } else if (e.tagName() == QLatin1String("downloadurl")) {
             result.setDownloadUrl(e.text());
+        } else if (e.tagName() == QLatin1String("patchurl")) {
+            result.setPatchUrl(e.text());
         }
     }
 
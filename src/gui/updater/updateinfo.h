@@ -21,6 +21,11 @@ public:
     QString web() const;
     void setDownloadUrl(const QString &v);
     QString downloadUrl() const;
+    /**
+      An optional msp patch from the previous release, smaller than the msi of downloadUrl()
+     */
+    void setPatchUrl(const QString &v);
+    QString patchUrl() const;
     /**
       Parse XML object from DOM element.
      */
@@ -32,6 +37,7 @@ private:
     QString mVersionString;
     QString mWeb;
     QString mDownloadUrl;
+    QString mPatchUrl;
 };
 
 } // namespace OCC
@@ -21,4 +21,6 @@ static const QString updateTargetVersionStringC = QStringLiteral("Updater/update
 // the config file key's name is preserved for legacy reasons
 static const QString previouslySkippedVersionC = QStringLiteral("Updater/seenVersion");
 static const QString autoUpdateAttemptedC = QStringLiteral("Updater/autoUpdateAttempted");
+// the version whose patch could not be applied, the full installer is used for it
+static const QString patchFailedVersionC = QStringLiteral("Updater/patchFailedVersion");
 }
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "gui/vfscachemanager.h"
+
+#include "common/filesystembase.h"
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+#include "common/vfs.h"
+#include "filesystem.h"
+#include "folder.h"
+#include "folderman.h"
+#include "scheduling/syncscheduler.h"
+#include "syncengine.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace {
+// files used more recently are never dehydrated
+constexpr std::chrono::milliseconds MinimumAge = 10min;
+constexpr std::chrono::milliseconds CheckInterval = 5min;
+// the candidates checked in one run of the event loop
+constexpr int BatchSize = 50;
+
+qint64 quotaFromEnvironment()
+{
+    return std::max<qint64>(qEnvironmentVariableIntValue("OWNCLOUD_VFS_CACHE_QUOTA"), 0) * 1024 * 1024;
+}
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcVfsCacheManager, "gui.vfscachemanager", QtInfoMsg)
+
+VfsCacheManager::VfsCacheManager(Folder *folder)
+    : QObject(folder)
+    , _folder(folder)
+    , _quota(quotaFromEnvironment())
+{
+    connect(&_folder->syncEngine(), &SyncEngine::itemCompleted, this, &VfsCacheManager::slotItemCompleted);
+    if (_quota > 0) {
+        connect(_folder, &Folder::syncFinished, this, &VfsCacheManager::start);
+        _timer.setInterval(CheckInterval);
+        connect(&_timer, &QTimer::timeout, this, &VfsCacheManager::start);
+        _timer.start();
+        _folder->journalDb()->deleteStaleAccessTimes();
+    }
+}
+
+void VfsCacheManager::fileUsed(const QString &relativePath)
+{
+    _folder->journalDb()->setAccessTime(relativePath.toUtf8(), QDateTime::currentMSecsSinceEpoch());
+}
+
+void VfsCacheManager::slotItemCompleted(const SyncFileItemPtr &item)
+{
+    if (item->_status != SyncFileItem::Success || (item->_type != ItemTypeFile && item->_type != ItemTypeVirtualFileDownload)) {
+        return;
+    }
+    if (item->instruction() & (CSYNC_INSTRUCTION_NEW | CSYNC_INSTRUCTION_SYNC | CSYNC_INSTRUCTION_CONFLICT | CSYNC_INSTRUCTION_RENAME | CSYNC_INSTRUCTION_TYPE_CHANGE)) {
+        fileUsed(item->destination());
+    }
+}
+
+void VfsCacheManager::start()
+{
+    if (_quota <= 0 || _running || _folder->isSyncRunning() || !_folder->virtualFilesEnabled()) {
+        return;
+    }
+    const qint64 size = _folder->journalDb()->hydratedFilesSize();
+    if (size <= _quota) {
+        return;
+    }
+    // free a bit more than needed, so we don't run for every new file
+    _toFree = size - _quota / 10 * 9;
+    _offset = 0;
+    _marked = 0;
+    _running = true;
+    qCInfo(lcVfsCacheManager) << "The hydrated files of" << _folder->path() << "use" << size << "bytes, the quota is" << _quota;
+    QTimer::singleShot(0, this, &VfsCacheManager::step);
+}
+
+void VfsCacheManager::step()
+{
+    if (_folder->isSyncRunning()) {
+        // continued once the sync is done
+        finish();
+        return;
+    }
+    auto *journal = _folder->journalDb();
+    const auto files = journal->leastRecentlyUsedFiles(BatchSize, _offset);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const auto &file : files) {
+        if (_toFree <= 0) {
+            break;
+        }
+        const QString relativePath = QString::fromUtf8(file.path);
+        const QString fullPath = _folder->path() + relativePath;
+        const QFileInfo info(fullPath);
+
+        qint64 accessTime = file.accessTime;
+        const QDateTime lastRead = info.lastRead();
+        if (lastRead.isValid() && lastRead.toMSecsSinceEpoch() > accessTime) {
+            accessTime = lastRead.toMSecsSinceEpoch();
+            journal->setAccessTime(file.path, accessTime);
+        }
+
+        SyncJournalFileRecord record;
+        const auto pin = _folder->vfs().pinState(relativePath);
+        const bool keep = now - accessTime < MinimumAge.count() || !pin || *pin != PinState::Unspecified || !journal->getFileRecord(file.path, &record)
+            || !record.isValid() || FileSystem::fileChanged(info, record._fileSize, record._modtime)
+            || FileSystem::isFileLocked(fullPath, FileSystem::LockMode::Exclusive);
+        if (keep) {
+            ++_offset;
+            continue;
+        }
+
+        // the marked files drop out of leastRecentlyUsedFiles(), the offset stays
+        record._type = ItemTypeVirtualFileDehydration;
+        if (!journal->setFileRecord(record)) {
+            ++_offset;
+            continue;
+        }
+        journal->schedulePathForRemoteDiscovery(file.path);
+        _folder->schedulePathForLocalDiscovery(relativePath);
+        _toFree -= file.size;
+        ++_marked;
+    }
+
+    if (_toFree > 0 && files.size() == BatchSize) {
+        QTimer::singleShot(0, this, &VfsCacheManager::step);
+    } else {
+        finish();
+    }
+}
+
+void VfsCacheManager::finish()
+{
+    _running = false;
+    if (_marked > 0) {
+        qCInfo(lcVfsCacheManager) << "Dehydrating" << _marked << "files in" << _folder->path();
+        FolderMan::instance()->scheduler()->enqueueFolder(_folder, SyncScheduler::Priority::Low);
+    }
+    Q_EMIT finished(_marked);
+}
+}
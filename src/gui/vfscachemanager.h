@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "gui/owncloudguilib.h"
+
+#include "syncfileitem.h"
+
+#include <QLoggingCategory>
+#include <QObject>
+#include <QTimer>
+
+namespace OCC {
+
+Q_DECLARE_LOGGING_CATEGORY(lcVfsCacheManager)
+
+class Folder;
+
+/**
+ * @brief Keeps the hydrated files of a virtual files folder below a quota
+ * @ingroup gui
+ *
+ * The journal keeps the time each hydrated file was last used: downloaded,
+ * uploaded or implicitly hydrated. The last read time of the file system is
+ * taken into account as well where it is maintained.
+ *
+ * When the hydrated files exceed the quota, OWNCLOUD_VFS_CACHE_QUOTA in MiB,
+ * the least recently used ones are marked for dehydration until the total is
+ * below 90% of the quota, and the folder is scheduled with low priority. Files
+ * that are pinned, in use, changed locally or used within the last ten minutes
+ * are kept.
+ *
+ * The candidates are checked in small batches from the event loop and the
+ * manager pauses while the folder syncs, so it never delays a sync.
+ */
+class OWNCLOUDGUI_EXPORT VfsCacheManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VfsCacheManager(Folder *folder);
+
+    /** The quota in bytes, 0 if the cache size is not limited */
+    qint64 quota() const { return _quota; }
+    void setQuota(qint64 quota) { _quota = quota; }
+
+    /** Checks the cache size and dehydrates files if needed */
+    void start();
+
+    /** Records that \a relativePath of a hydrated file was used now */
+    void fileUsed(const QString &relativePath);
+
+    bool isRunning() const { return _running; }
+
+Q_SIGNALS:
+    /** A run is done, \a count files were marked for dehydration */
+    void finished(int count);
+
+private:
+    void slotItemCompleted(const SyncFileItemPtr &item);
+    void step();
+    void finish();
+
+    Folder *_folder;
+    qint64 _quota;
+    QTimer _timer;
+
+    // state of the current run
+    bool _running = false;
+    qint64 _toFree = 0;
+    int _offset = 0;
+    int _marked = 0;
+};
+}
@@ -31,6 +31,30 @@ using namespace std::chrono_literals;
 
 namespace {
 constexpr int MaxRetryCount = 5;
+
+// The errors of a request whose connection went away, the server might be reachable again later
+bool isConnectionLost(QNetworkReply::NetworkError error)
+{
+    switch (error) {
+    case QNetworkReply::RemoteHostClosedError:
+        [[fallthrough]];
+    case QNetworkReply::HostNotFoundError:
+        [[fallthrough]];
+    case QNetworkReply::TemporaryNetworkFailureError:
+        [[fallthrough]];
+    case QNetworkReply::NetworkSessionFailedError:
+        [[fallthrough]];
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isConnectionValidation(const QNetworkReply &reply)
+{
+    return reply.request().hasRawHeader(QByteArrayLiteral("OC-Connection-Validator"));
+}
 }
 
 
@@ -135,6 +159,11 @@ bool AbstractNetworkJob::needsRetry() const
             }
             [[fallthrough]];
         default:
+            if (isConnectionLost(reply->error())) {
+                // wait for the connection to be validated again, a reply that already
+                // delivered data must be continued where it stopped
+                return _account->jobQueue()->isBlocked() && (httpStatusCode() == 0 || canResumeReply());
+            }
             break;
         }
     }
@@ -189,7 +218,14 @@ void AbstractNetworkJob::adoptRequest(QPointer<QNetworkReply> reply)
     }
 
     _request = _reply->request();
+    _durationTimer.start();
+    _timeToFirstByte.reset();
 
+    connect(_reply, &QNetworkReply::metaDataChanged, this, [this] {
+        if (!_timeToFirstByte) {
+            _timeToFirstByte = milliseconds(_durationTimer.elapsed());
+        }
+    });
     connect(_reply, &QNetworkReply::finished, this, &AbstractNetworkJob::slotFinished);
 
     newReplyHook(_reply);
@@ -198,12 +234,29 @@ void AbstractNetworkJob::adoptRequest(QPointer<QNetworkReply> reply)
 void AbstractNetworkJob::slotFinished()
 {
     _finished = true;
+    _duration = milliseconds(_durationTimer.elapsed());
 
     if (!_account->credentials()->stillValid(_reply) && !ignoreCredentialFailure()) {
         _account->invalidCredentialsEncountered();
     }
 
+    switch (const int httpStatus = httpStatusCode()) {
+    case 429:
+        [[fallthrough]];
+    case 503:
+        _account->jobQueue()->backOff(JobQueue::parseRetryAfter(_reply->rawHeader(QByteArrayLiteral("Retry-After"))));
+        break;
+    default:
+        if (httpStatus != 0) {
+            _account->jobQueue()->serverResponded();
+        }
+    }
+
     if (_reply->error() != QNetworkReply::NoError) {
+        if (isConnectionLost(_reply->error()) && !isAuthenticationJob() && !isConnectionValidation(*_reply)) {
+            // blocks the queue until the connection was validated again, the job waits in there
+            Q_EMIT _account->unknownConnectionState();
+        }
         if (_account->jobQueue()->retry(this)) {
             qCDebug(lcNetworkJob) << "Queued:" << this << "for retry";
             return;
@@ -218,7 +271,7 @@ void AbstractNetworkJob::slotFinished()
     // get the Date timestamp from reply
     _responseTimestamp = _reply->rawHeader("Date");
 
-    if (!reply()->attribute(QNetworkRequest::RedirectionTargetAttribute).isNull() && !(isAuthenticationJob() || reply()->request().hasRawHeader(QByteArrayLiteral("OC-Connection-Validator")))) {
+    if (!reply()->attribute(QNetworkRequest::RedirectionTargetAttribute).isNull() && !(isAuthenticationJob() || isConnectionValidation(*reply()))) {
         Q_EMIT _account->unknownConnectionState();
         qCWarning(lcNetworkJob) << this << "Unsupported redirect on" << _reply->url().toString() << "to" << reply()->attribute(QNetworkRequest::RedirectionTargetAttribute).toString();
         Q_EMIT networkError(_reply);
@@ -236,6 +289,14 @@ void AbstractNetworkJob::slotFinished()
     deleteLater();
 }
 
+std::chrono::milliseconds AbstractNetworkJob::duration() const
+{
+    if (_finished || !_durationTimer.isValid()) {
+        return _duration;
+    }
+    return milliseconds(_durationTimer.elapsed());
+}
+
 QByteArray AbstractNetworkJob::responseTimestamp() const
 {
     return _responseTimestamp;
@@ -375,6 +436,7 @@ void AbstractNetworkJob::retry()
             return;
         }
     }
+    prepareRetry(_request);
     sendRequest(_verb, _request, _requestBody);
 }
 
@@ -402,6 +464,16 @@ QNetworkRequest::Priority AbstractNetworkJob::priority() const
     return _priority;
 }
 
+void AbstractNetworkJob::setRequestClass(JobQueue::RequestClass requestClass)
+{
+    _requestClass = requestClass;
+}
+
+JobQueue::RequestClass AbstractNetworkJob::requestClass() const
+{
+    return isAuthenticationJob() ? JobQueue::RequestClass::Authentication : _requestClass;
+}
+
 int AbstractNetworkJob::httpStatusCode() const
 {
     return reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
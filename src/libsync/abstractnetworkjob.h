@@ -31,6 +31,7 @@
 #include <QTimer>
 #include <QUrlQuery>
 
+#include <algorithm>
 #include <chrono>
 #include <optional>
 
@@ -100,6 +101,10 @@ public:
     void setPriority(QNetworkRequest::Priority priority);
     QNetworkRequest::Priority priority() const;
 
+    /** The order in which the job is retried after the JobQueue was blocked, Interactive by default */
+    void setRequestClass(JobQueue::RequestClass requestClass);
+    JobQueue::RequestClass requestClass() const;
+
     /** Returns an error message, if any. */
     QString errorString() const;
 
@@ -138,7 +143,22 @@ public:
     /** How many times was that job retried */
     int retryCount() const { return _retryCount; }
 
+    /** The time since the current request was sent, or the time it took once the job finished */
+    std::chrono::milliseconds duration() const;
+
+    /** The time from sending the current request until its reply headers arrived, if they did */
+    std::optional<std::chrono::milliseconds> timeToFirstByte() const { return _timeToFirstByte; }
+
+    /** The most reply data that waited to be read, for the jobs that read their reply while it arrives */
+    qint64 maximumBufferedBytes() const { return _maximumBufferedBytes; }
 
+
+    /**
+     * Whether the job is sent again instead of failing
+     *
+     * Besides redirects and expired credentials this covers a lost connection
+     * while the JobQueue is blocked to validate the connection again.
+     */
     virtual bool needsRetry() const;
 
     void setTimeout(const std::chrono::seconds sec);
@@ -192,10 +212,19 @@ protected:
      */
     virtual void newReplyHook(QNetworkReply *) {}
 
+    /** Whether the job can continue a reply that lost its connection after data arrived */
+    virtual bool canResumeReply() const { return false; }
+
+    /** Lets the job adjust the request before it is sent again, e.g. to continue where the last reply stopped */
+    virtual void prepareRetry(QNetworkRequest &) {}
+
     /** Called at the end of QNetworkReply::finished processing.
      */
     virtual void finished() = 0;
 
+    /** Called by the streaming jobs with the bytes available before they read from the reply */
+    void addBufferedBytes(qint64 bytes) { _maximumBufferedBytes = std::max(_maximumBufferedBytes, bytes); }
+
     QByteArray _responseTimestamp;
 
     QString replyStatusString();
@@ -243,12 +272,18 @@ private:
     bool _isAuthenticationJob = false;
     int _retryCount = 0;
 
+    QElapsedTimer _durationTimer;
+    std::chrono::milliseconds _duration = {};
+    std::optional<std::chrono::milliseconds> _timeToFirstByte;
+    qint64 _maximumBufferedBytes = 0;
+
     // by default, we don't intend to store responses in the cache (if one is set in the account's access manager)
     bool _storeInCache = false;
     // we use Qt's default cache load behavior unless the user explicitly requests a different behavior
     std::optional<QNetworkRequest::CacheLoadControl> _cacheLoadControl = std::nullopt;
 
     QNetworkRequest::Priority _priority = QNetworkRequest::NormalPriority;
+    JobQueue::RequestClass _requestClass = JobQueue::RequestClass::Interactive;
 
     friend QDebug(::operator<<)(QDebug debug, const AbstractNetworkJob *job);
 };
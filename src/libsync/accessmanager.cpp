@@ -13,7 +13,12 @@
  */
 
 #include <QAuthenticator>
+#include <QDataStream>
+#include <QFile>
 #include <QNetworkCookie>
+#include <QNetworkCookieJar>
+#include <QNetworkReply>
+#include <QSaveFile>
 #include <QUuid>
 
 #include "accessmanager.h"
@@ -22,16 +27,95 @@
 #include "httplogger.h"
 
 #include <algorithm>
+#include <iterator>
+
+namespace {
+constexpr int DefaultTransferConnections = 1;
+constexpr int MaximumTransferConnections = 8;
+// the largest flow control window of HTTP/2, 2^31 - 1
+constexpr unsigned MaximumHttp2WindowSize = 0x7fffffff;
+constexpr unsigned TransferHttp2StreamWindowSize = 32 * 1024 * 1024;
+constexpr unsigned TransferHttp2FrameSize = 1024 * 1024;
+
+bool http2Enabled()
+{
+    // http2 seems to cause issues, as with our recommended server setup we don't support http2, disable it by default for now
+    static const bool http2EnabledEnv = qEnvironmentVariableIntValue("OWNCLOUD_HTTP2_ENABLED") == 1;
+    return http2EnabledEnv;
+}
+
+int transferConnections()
+{
+    if (!http2Enabled()) {
+        // with HTTP/1.1 Qt already uses several connections per host, and schedules by priority
+        return 0;
+    }
+    bool ok;
+    const int count = qEnvironmentVariableIntValue("OWNCLOUD_HTTP2_TRANSFER_CONNECTIONS", &ok);
+    return ok ? std::clamp(count, 0, MaximumTransferConnections) : DefaultTransferConnections;
+}
+
+QString sessionTicketKey(const QUrl &url)
+{
+    return QStringLiteral("%1:%2").arg(url.host(), QString::number(url.port(443)));
+}
+
+/**
+ * The transfer connections use the cookies of the AccessManager,
+ * even after its cookie jar was replaced
+ */
+class SharedCookieJar : public QNetworkCookieJar
+{
+public:
+    SharedCookieJar(QNetworkAccessManager *source, QObject *parent)
+        : QNetworkCookieJar(parent)
+        , _source(source)
+    {
+    }
+
+    QList<QNetworkCookie> cookiesForUrl(const QUrl &url) const override { return _source->cookieJar()->cookiesForUrl(url); }
+    bool setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const QUrl &url) override
+    {
+        return _source->cookieJar()->setCookiesFromUrl(cookieList, url);
+    }
+
+private:
+    QNetworkAccessManager *_source;
+};
+}
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcAccessManager, "sync.accessmanager", QtInfoMsg)
 
+/**
+ * A network access manager of the transfer pool, each one has its own connections.
+ * The requests are prepared by the AccessManager.
+ */
+class PooledAccessManager : public QNetworkAccessManager
+{
+public:
+    using QNetworkAccessManager::createRequest;
+    using QNetworkAccessManager::QNetworkAccessManager;
+};
+
 AccessManager::AccessManager(QObject *parent)
     : QNetworkAccessManager(parent)
 {
     setCookieJar(new CookieJar);
 
+    const int transferCount = transferConnections();
+    _connectionStats.resize(1 + transferCount);
+    for (int i = 0; i < transferCount; ++i) {
+        auto *manager = new PooledAccessManager(this);
+        manager->setCookieJar(new SharedCookieJar(this, manager));
+        // the handlers are connected to this manager
+        connect(manager, &QNetworkAccessManager::sslErrors, this, &QNetworkAccessManager::sslErrors);
+        connect(manager, &QNetworkAccessManager::authenticationRequired, this, &QNetworkAccessManager::authenticationRequired);
+        connect(manager, &QNetworkAccessManager::proxyAuthenticationRequired, this, &QNetworkAccessManager::proxyAuthenticationRequired);
+        _transferManagers.push_back(manager);
+    }
+
     connect(this, &AccessManager::sslErrors, this, [this](QNetworkReply *reply, const QList<QSslError> &errors) {
         auto filtered = errors;
         filtered.erase(std::remove_if(
@@ -43,6 +127,14 @@ AccessManager::AccessManager(QObject *parent)
     });
 }
 
+AccessManager::~AccessManager()
+{
+    // QNetworkAccessManager deletes the replies after our members are gone
+    for (auto it = _activeReplies.cbegin(); it != _activeReplies.cend(); ++it) {
+        disconnect(it.key(), nullptr, this, nullptr);
+    }
+}
+
 QByteArray AccessManager::generateRequestId()
 {
     return QUuid::createUuid().toByteArray(QUuid::WithoutBraces);
@@ -54,7 +146,9 @@ QNetworkReply *AccessManager::createRequest(QNetworkAccessManager::Operation op,
     newRequest.setRawHeader(QByteArrayLiteral("User-Agent"), Utility::userAgentString());
 
     // Some firewalls reject requests that have a "User-Agent" but no "Accept" header
-    newRequest.setRawHeader(QByteArrayLiteral("Accept"), QByteArrayLiteral("*/*"));
+    if (!newRequest.hasRawHeader(QByteArrayLiteral("Accept"))) {
+        newRequest.setRawHeader(QByteArrayLiteral("Accept"), QByteArrayLiteral("*/*"));
+    }
 
     // Set the language, so messages from the server are localised correctly.
     newRequest.setRawHeader("Accept-Language", QLocale().name().toUtf8());
@@ -68,6 +162,8 @@ QNetworkReply *AccessManager::createRequest(QNetworkAccessManager::Operation op,
     QByteArray verb = newRequest.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray();
     // For PROPFIND (assumed to be a WebDAV op), set xml/utf8 as content type/encoding
     // This needs extension
+    // Accept-Encoding is left to Qt: it offers every encoding it can decode, including
+    // br and zstd when built with them, and decodes the large PROPFIND replies on the fly.
     if (verb == QByteArrayLiteral("PROPFIND")) {
         newRequest.setHeader(QNetworkRequest::ContentTypeHeader, QByteArrayLiteral("text/xml; charset=utf-8"));
     }
@@ -80,31 +176,167 @@ QNetworkReply *AccessManager::createRequest(QNetworkAccessManager::Operation op,
         newRequest.setRawHeader(originalIdKey, requestId);
     }
 
-    if (newRequest.url().scheme() == QLatin1String("https")) { // Not for "http": QTBUG-61397
-        // http2 seems to cause issues, as with our recommended server setup we don't support http2, disable it by default for now
-        static const bool http2EnabledEnv = qEnvironmentVariableIntValue("OWNCLOUD_HTTP2_ENABLED") == 1;
-
-        newRequest.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2EnabledEnv);
+    const bool https = newRequest.url().scheme() == QLatin1String("https");
+    if (https) { // Not for "http": QTBUG-61397
+        newRequest.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2Enabled());
     }
 
     // allow http pipelining
     newRequest.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
 
     auto sslConfiguration = newRequest.sslConfiguration();
+    applySslConfiguration(sslConfiguration, newRequest.url());
+    newRequest.setSslConfiguration(sslConfiguration);
 
-    sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
-    sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionSharing, false);
-    sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    QNetworkReply *reply;
+    if (https && !_transferManagers.empty() && newRequest.attribute(TransferAttribute).toBool()) {
+        const auto it = std::min_element(_connectionStats.cbegin() + 1, _connectionStats.cend(),
+            [](const ConnectionStats &a, const ConnectionStats &b) { return a.activeRequests < b.activeRequests; });
+        const int connection = static_cast<int>(std::distance(_connectionStats.cbegin(), it));
+        auto *manager = _transferManagers[connection - 1];
+        if (manager->proxy() != proxy()) {
+            manager->setProxy(proxy());
+        }
+        // the settings are sent when the connection is opened, all requests of the pool carry them
+        newRequest.setHttp2Configuration(transferHttp2Configuration());
+        reply = manager->createRequest(op, newRequest, outgoingData);
+        trackReply(connection, reply);
+    } else {
+        reply = QNetworkAccessManager::createRequest(op, newRequest, outgoingData);
+        trackReply(0, reply);
+    }
+    HttpLogger::logRequest(reply, op, outgoingData);
+    return reply;
+}
+
+void AccessManager::applySslConfiguration(QSslConfiguration &configuration, const QUrl &url) const
+{
+    configuration.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+    configuration.setSslOption(QSsl::SslOptionDisableSessionSharing, false);
+    configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    if (configuration.sessionTicket().isEmpty()) {
+        configuration.setSessionTicket(_sessionTickets.value(sessionTicketKey(url)));
+    }
     if (!_customTrustedCaCertificates.isEmpty()) {
         // for some reason, passing an empty list causes the default chain to be removed
         // this behavior does not match the documentation
-        sslConfiguration.addCaCertificates({ _customTrustedCaCertificates.begin(), _customTrustedCaCertificates.end() });
+        configuration.addCaCertificates({ _customTrustedCaCertificates.begin(), _customTrustedCaCertificates.end() });
     }
-    newRequest.setSslConfiguration(sslConfiguration);
+}
 
-    const auto reply = QNetworkAccessManager::createRequest(op, newRequest, outgoingData);
-    HttpLogger::logRequest(reply, op, outgoingData);
-    return reply;
+QHttp2Configuration AccessManager::transferHttp2Configuration()
+{
+    QHttp2Configuration configuration;
+    configuration.setServerPushEnabled(false);
+    configuration.setSessionReceiveWindowSize(MaximumHttp2WindowSize);
+    configuration.setStreamReceiveWindowSize(TransferHttp2StreamWindowSize);
+    configuration.setMaxFrameSize(TransferHttp2FrameSize);
+    return configuration;
+}
+
+void AccessManager::storeSessionTicket(QNetworkReply *reply)
+{
+    const QByteArray ticket = reply->sslConfiguration().sessionTicket();
+    if (ticket.isEmpty()) {
+        return;
+    }
+    const QString key = sessionTicketKey(reply->url());
+    auto &stored = _sessionTickets[key];
+    if (stored == ticket) {
+        return;
+    }
+    stored = ticket;
+    if (_sessionTicketFile.isEmpty()) {
+        return;
+    }
+    QSaveFile file(_sessionTicketFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcAccessManager) << "Failed to save the TLS session tickets to" << _sessionTicketFile << file.errorString();
+        return;
+    }
+    // the tickets allow to resume the sessions, as sensitive as the cookies
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    QDataStream stream(&file);
+    stream << _sessionTickets;
+    file.commit();
+}
+
+void AccessManager::setSessionTicketFile(const QString &path)
+{
+    _sessionTicketFile = path;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    QHash<QString, QByteArray> tickets;
+    stream >> tickets;
+    if (stream.status() == QDataStream::Ok) {
+        // don't replace tickets of this session
+        tickets.insert(_sessionTickets);
+        _sessionTickets = std::move(tickets);
+    } else {
+        qCWarning(lcAccessManager) << "Ignoring the invalid TLS session tickets in" << path;
+    }
+}
+
+void AccessManager::warmUp(const QUrl &url)
+{
+    if (url.scheme() != QLatin1String("https") || _warmedUp) {
+        return;
+    }
+    _warmedUp = true;
+    auto sslConfiguration = QSslConfiguration::defaultConfiguration();
+    applySslConfiguration(sslConfiguration, url);
+    // the protocol of a connection is negotiated with the handshake, it must match the one of the requests
+    if (http2Enabled()) {
+        sslConfiguration.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::ALPNProtocolHTTP1_1});
+    } else {
+        sslConfiguration.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP1_1});
+    }
+    const quint16 port = static_cast<quint16>(url.port(443));
+    qCDebug(lcAccessManager) << "Opening the connections to" << url.host() << port;
+    connectToHostEncrypted(url.host(), port, sslConfiguration);
+    for (auto *manager : _transferManagers) {
+        if (manager->proxy() != proxy()) {
+            manager->setProxy(proxy());
+        }
+        manager->connectToHostEncrypted(url.host(), port, sslConfiguration);
+    }
+}
+
+void AccessManager::trackReply(int connection, QNetworkReply *reply)
+{
+    auto &stats = _connectionStats[connection];
+    ++stats.requests;
+    ++stats.activeRequests;
+    stats.maximumActiveRequests = std::max(stats.maximumActiveRequests, stats.activeRequests);
+    _activeReplies.insert(reply, connection);
+    // replies might get deleted without finishing
+    connect(reply, &QNetworkReply::finished, this, [reply, this] {
+        storeSessionTicket(reply);
+        untrackReply(reply);
+    });
+    connect(reply, &QObject::destroyed, this, [reply, this] { untrackReply(reply); });
+}
+
+void AccessManager::untrackReply(QNetworkReply *reply)
+{
+    const auto it = _activeReplies.constFind(reply);
+    if (it != _activeReplies.cend()) {
+        --_connectionStats[it.value()].activeRequests;
+        _activeReplies.erase(it);
+        disconnect(reply, nullptr, this, nullptr);
+    }
+}
+
+void AccessManager::clearConnections()
+{
+    _warmedUp = false;
+    clearAccessCache();
+    for (auto *manager : _transferManagers) {
+        manager->clearAccessCache();
+    }
 }
 
 QSet<QSslCertificate> AccessManager::customTrustedCaCertificates()
@@ -117,6 +349,9 @@ void AccessManager::setCustomTrustedCaCertificates(const QSet<QSslCertificate> &
     _customTrustedCaCertificates = certificates;
     // we have to terminate the existing (cached) connection to make the access manager re-evaluate the certificate sent by the server
     clearConnectionCache();
+    for (auto *manager : _transferManagers) {
+        manager->clearConnectionCache();
+    }
 }
 
 void AccessManager::addCustomTrustedCaCertificates(const QList<QSslCertificate> &certificates)
@@ -125,6 +360,9 @@ void AccessManager::addCustomTrustedCaCertificates(const QList<QSslCertificate>
 
     // we have to terminate the existing (cached) connection to make the access manager re-evaluate the certificate sent by the server
     clearConnectionCache();
+    for (auto *manager : _transferManagers) {
+        manager->clearConnectionCache();
+    }
 }
 
 CookieJar *AccessManager::ownCloudCookieJar() const
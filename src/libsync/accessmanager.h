@@ -16,17 +16,38 @@
 #define MIRALL_ACCESS_MANAGER_H
 
 #include "owncloudlib.h"
+#include <QHash>
+#include <QHttp2Configuration>
 #include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QSslConfiguration>
+#include <QVector>
+
+#include <vector>
 
 class QByteArray;
 class QUrl;
+class TestAccessManager;
 
 namespace OCC {
 class CookieJar;
+class PooledAccessManager;
 
 /**
  * @brief The AccessManager class
  * @ingroup libsync
+ *
+ * With HTTP/2 all requests to a host share a single connection, so a PROPFIND
+ * would wait behind the frames of large uploads and downloads. Therefore
+ * requests with TransferAttribute are sent over a pool of separate
+ * connections, OWNCLOUD_HTTP2_TRANSFER_CONNECTIONS (default 1, 0 disables the
+ * separation), while the metadata requests keep the connection of this manager.
+ * A transfer goes to the pool connection with the fewest running requests.
+ * The pool connections are set up for bulk data, see transferHttp2Configuration().
+ *
+ * The TLS session tickets of the servers are kept, and persisted with
+ * setSessionTicketFile(), so new connections resume the previous sessions
+ * with an abbreviated handshake, also after a restart.
  */
 class OWNCLOUDSYNC_EXPORT AccessManager : public QNetworkAccessManager
 {
@@ -35,7 +56,36 @@ class OWNCLOUDSYNC_EXPORT AccessManager : public QNetworkAccessManager
 public:
     static QByteArray generateRequestId();
 
+    /// Set on requests that transfer file contents
+    static constexpr QNetworkRequest::Attribute TransferAttribute = static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 1);
+
+    struct ConnectionStats
+    {
+        int activeRequests = 0;
+        /// The most requests that ran at the same time, the HTTP/2 stream concurrency
+        int maximumActiveRequests = 0;
+        quint64 requests = 0;
+    };
+
     AccessManager(QObject *parent = nullptr);
+    ~AccessManager() override;
+
+    /// The stats of the metadata connection followed by the ones of the transfer connections
+    QVector<ConnectionStats> connectionStats() const { return _connectionStats; }
+
+    /// Closes the connections of this manager and of the transfer pool
+    void clearConnections();
+
+    /** Opens the connections to the host of \a url, of this manager and of the transfer pool
+     *
+     * The handshakes run while the first requests are prepared, e.g. during the
+     * checks of the ConnectionValidator. Does nothing for unencrypted urls, and
+     * until clearConnections() was called once the connections were opened.
+     */
+    void warmUp(const QUrl &url);
+
+    /// Loads the TLS session tickets from \a path and saves new ones there
+    void setSessionTicketFile(const QString &path);
 
     QSet<QSslCertificate> customTrustedCaCertificates();
 
@@ -59,7 +109,27 @@ protected:
     QNetworkReply *createRequest(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData = nullptr) override;
 
 private:
+    friend class ::TestAccessManager;
+
+    void trackReply(int connection, QNetworkReply *reply);
+    void untrackReply(QNetworkReply *reply);
+    void applySslConfiguration(QSslConfiguration &configuration, const QUrl &url) const;
+    /// The HTTP/2 settings of the transfer connections: the widest flow control windows
+    /// and larger frames, so a download needs fewer frames and window updates
+    static QHttp2Configuration transferHttp2Configuration();
+    void storeSessionTicket(QNetworkReply *reply);
+
     QSet<QSslCertificate> _customTrustedCaCertificates;
+
+    // owned as children
+    std::vector<PooledAccessManager *> _transferManagers;
+    QVector<ConnectionStats> _connectionStats;
+    // the running replies and the index of their connection
+    QHash<QNetworkReply *, int> _activeReplies;
+    // the session tickets by host and port
+    QHash<QString, QByteArray> _sessionTickets;
+    QString _sessionTicketFile;
+    bool _warmedUp = false;
 };
 
 } // namespace OCC
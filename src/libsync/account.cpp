@@ -22,6 +22,7 @@
 #include "graphapi/spacesmanager.h"
 #include "networkjobs.h"
 #include "networkjobs/resources.h"
+#include "serverevents.h"
 #include "theme.h"
 
 #include <QAuthenticator>
@@ -60,6 +61,7 @@ Account::Account(const QUuid &uuid, QObject *parent)
     , _jobQueue(this)
     , _queueGuard(&_jobQueue)
     , _credentialManager(new CredentialManager(this))
+    , _initiatorId(QUuid::createUuid().toByteArray(QUuid::WithoutBraces))
 {
     qRegisterMetaType<AccountPtr>("AccountPtr");
 
@@ -212,6 +214,7 @@ void Account::setCredentials(AbstractCredentials *cred)
     qCDebug(lcAccount) << "Cache location for account" << this << "set to" << networkCacheLocation;
     _networkCache->setCacheDirectory(networkCacheLocation);
     _am->setCache(_networkCache);
+    _am->setSessionTicketFile(QStringLiteral("%1/tls-sessions").arg(_cacheDirectory));
 
     if (jar) {
         _am->setCookieJar(jar);
@@ -250,6 +253,7 @@ QNetworkReply *Account::sendRawRequest(const QByteArray &verb, const QUrl &url,
 {
     Q_ASSERT(verb.isUpper());
     req.setUrl(url);
+    req.setRawHeader(QByteArrayLiteral("Initiator-ID"), _initiatorId);
     if (verb == "HEAD" && !data) {
         return _am->head(req);
     } else if (verb == "GET" && !data) {
@@ -323,7 +327,7 @@ JobQueue *Account::jobQueue()
 
 void Account::clearAMCache()
 {
-    _am->clearAccessCache();
+    _am->clearConnections();
 }
 
 const Capabilities &Account::capabilities() const
@@ -344,6 +348,10 @@ void Account::setCapabilities(const Capabilities &caps)
     if (versionChanged) {
         Q_EMIT serverVersionChanged();
     }
+    // before the spaces manager, which relies on the notifications
+    if (!_serverEvents && _capabilities.serverSentEvents() && !qEnvironmentVariableIsSet("OWNCLOUD_DISABLE_SERVER_EVENTS")) {
+        _serverEvents = new ServerEvents(this);
+    }
     if (!_spacesManager && _capabilities.spacesSupport().enabled) {
         _spacesManager = new GraphApi::SpacesManager(this);
     }
@@ -409,6 +417,16 @@ ResourcesCache *Account::resourcesCache() const
     return _resourcesCache;
 }
 
+QUrl Account::privateLink(const QByteArray &fileId) const
+{
+    return _privateLinks.value(fileId);
+}
+
+void Account::setPrivateLink(const QByteArray &fileId, const QUrl &url)
+{
+    _privateLinks.insert(fileId, url);
+}
+
 } // namespace OCC
 
 
@@ -20,11 +20,15 @@
 
 #include "appprovider.h"
 #include "capabilities.h"
+#include "chunksizecontroller.h"
 #include "jobqueue.h"
+#include "remotelistingcache.h"
 #include "resources/resources.h"
+#include "transferconcurrency.h"
 
 #include <QByteArray>
 #include <QGradient>
+#include <QHash>
 #include <QNetworkAccessManager>
 #include <QNetworkCookie>
 #include <QNetworkDiskCache>
@@ -59,6 +63,7 @@ namespace GraphApi {
 }
 
 class ResourcesCache;
+class ServerEvents;
 
 /**
  * @brief The Account class represents an account on an ownCloud Server
@@ -210,12 +215,27 @@ public:
 
     JobQueue *jobQueue();
 
+    /** The adaptive transfer limit shared by all folders of this account */
+    TransferConcurrency *transferConcurrency() { return &_transferConcurrency; }
+
+    /** The size of upload chunks, learned by all syncs of the account */
+    ChunkSizeController *chunkSizeController() { return &_chunkSizeController; }
+
+    /** The subfolders of remote folders, shared by the discovery and the folder browsers of the UI */
+    RemoteListingCache *remoteListingCache() { return &_remoteListingCache; }
+
     QUuid uuid() const;
 
     CredentialManager *credentialManager() const;
 
     GraphApi::SpacesManager *spacesManager() const { return _spacesManager; }
 
+    /// The change notifications of the server, nullptr if it does not send any
+    ServerEvents *serverEvents() const { return _serverEvents; }
+
+    /// Sent as Initiator-ID with every request, so we can ignore the notifications about our own changes
+    QByteArray initiatorId() const { return _initiatorId; }
+
     /**
      * We encountered an authentication error.
      */
@@ -223,6 +243,10 @@ public:
 
     ResourcesCache *resourcesCache() const;
 
+    /** The private link of the file \a fileId if it was fetched before, they don't change for the lifetime of the file */
+    QUrl privateLink(const QByteArray &fileId) const;
+    void setPrivateLink(const QByteArray &fileId, const QUrl &url);
+
 public Q_SLOTS:
     /// Used when forgetting credentials
     void clearAMCache();
@@ -275,15 +299,21 @@ private:
     QPointer<AccessManager> _am;
     QPointer<QNetworkDiskCache> _networkCache = nullptr;
     QPointer<ResourcesCache> _resourcesCache;
+    QHash<QByteArray, QUrl> _privateLinks;
     QScopedPointer<AbstractCredentials> _credentials;
     bool _http2Supported = false;
 
     JobQueue _jobQueue;
     JobQueueGuard _queueGuard;
+    TransferConcurrency _transferConcurrency;
+    ChunkSizeController _chunkSizeController;
+    RemoteListingCache _remoteListingCache;
     CredentialManager *_credentialManager;
     AppProvider _appProvider;
 
     GraphApi::SpacesManager *_spacesManager = nullptr;
+    ServerEvents *_serverEvents = nullptr;
+    QByteArray _initiatorId;
     friend class AccountManager;
 };
 }
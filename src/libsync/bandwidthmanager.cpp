@@ -16,10 +16,92 @@
 #include "propagatedownload.h"
 #include "propagateupload.h"
 
+#include <QCoreApplication>
 #include <QLoggingCategory>
+#include <QPointer>
 #include <QTimer>
 #include <QObject>
 
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace {
+// The token buckets of the absolute limits are refilled this often, short enough
+// to not produce noticeable bursts but long enough to not keep the event loop busy
+constexpr int ShapingIntervalMsec = 50;
+
+// A bucket holds at most the tokens of this time span, this is also the most
+// quota a single device can have at once
+constexpr qint64 MaximumBurstMsec = 200;
+constexpr qint64 MinimumBurst = 4 * 1024;
+
+qint64 burstSize(qint64 bytesPerSecond)
+{
+    return std::max(bytesPerSecond * MaximumBurstMsec / 1000, MinimumBurst);
+}
+
+/**
+ * Hand out the tokens of a bucket to the devices with a deficit round robin
+ *
+ * Returns the tokens that were not used.
+ */
+template <typename Device>
+double distributeTokens(std::list<Device *> &devices, double tokens, qint64 burst)
+{
+    tokens = std::min<double>(tokens, burst);
+    if (devices.empty()) {
+        return tokens;
+    }
+
+    struct Backlog
+    {
+        Device *device;
+        qint64 room;
+        qint64 granted;
+    };
+    std::vector<Backlog> backlog;
+    backlog.reserve(devices.size());
+    for (auto *device : devices) {
+        const qint64 room = std::min(device->bandwidthDemand(), burst - device->bandwidthQuota());
+        if (room > 0) {
+            backlog.push_back({device, room, 0});
+        }
+    }
+
+    // every pass gives an equal quantum to all devices that can still take
+    // more, until the tokens are used up or no device wants more
+    auto available = static_cast<qint64>(tokens);
+    std::vector<size_t> pending(backlog.size());
+    std::iota(pending.begin(), pending.end(), 0);
+    while (available > 0 && !pending.empty()) {
+        const qint64 quantum = std::max<qint64>(1, available / static_cast<qint64>(pending.size()));
+        for (auto it = pending.begin(); it != pending.end() && available > 0;) {
+            auto &entry = backlog[*it];
+            const qint64 grant = std::min({quantum, entry.room, available});
+            entry.room -= grant;
+            entry.granted += grant;
+            available -= grant;
+            if (entry.room == 0) {
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const auto &b : backlog) {
+        if (b.granted > 0) {
+            b.device->giveBandwidthQuota(b.device->bandwidthQuota() + b.granted);
+        }
+    }
+
+    // the next round starts with the next device, so the remainder of the
+    // integer division is not always given to the same one
+    devices.splice(devices.end(), devices, devices.begin());
+    return tokens - (static_cast<qint64>(tokens) - available);
+}
+}
+
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcBandwidthManager, "sync.bandwidthmanager", QtInfoMsg)
@@ -37,19 +119,18 @@ static qint64 relativeLimitMeasuringTimerIntervalMsec = 1000 * 2;
 //  * For relative limiting, do less measuring and more delaying+giving quota
 //  * For relative limiting, smoothen measurements
 
-BandwidthManager::BandwidthManager(OwncloudPropagator *p)
-    : QObject(p)
-    , _propagator(p)
+BandwidthManager::BandwidthManager(QObject *parent)
+    : QObject(parent)
     , _relativeLimitCurrentMeasuredDevice(nullptr)
     , _relativeUploadLimitProgressAtMeasuringRestart(0)
     , _currentUploadLimit(0)
     , _relativeLimitCurrentMeasuredJob(nullptr)
     , _currentDownloadLimit(0)
 {
-    // absolute uploads/downloads
-    QObject::connect(&_absoluteLimitTimer, &QTimer::timeout, this, &BandwidthManager::absoluteLimitTimerExpired);
-    _absoluteLimitTimer.setInterval(1000);
-    _absoluteLimitTimer.start();
+    // absolute uploads/downloads, the timer only runs while an absolute limit is set
+    QObject::connect(&_shapingTimer, &QTimer::timeout, this, &BandwidthManager::shapingTimerExpired);
+    _shapingTimer.setInterval(ShapingIntervalMsec);
+    _shapingTimer.setTimerType(Qt::PreciseTimer);
 
     // Relative uploads
     QObject::connect(&_relativeUploadMeasuringTimer, &QTimer::timeout,
@@ -76,6 +157,16 @@ BandwidthManager::~BandwidthManager()
 {
 }
 
+BandwidthManager *BandwidthManager::instance()
+{
+    // owned by the application so the timers are gone before the event loop
+    static QPointer<BandwidthManager> instance;
+    if (!instance) {
+        instance = new BandwidthManager(QCoreApplication::instance());
+    }
+    return instance;
+}
+
 void BandwidthManager::registerUploadDevice(UploadDevice *p)
 {
     _absoluteUploadDeviceList.push_back(p);
@@ -239,6 +330,8 @@ void BandwidthManager::setCurrentUploadLimit(qint64 newUploadLimit)
     if (newUploadLimit != _currentUploadLimit) {
         qCInfo(lcBandwidthManager) << "Upload Bandwidth limit changed" << _currentUploadLimit << newUploadLimit;
         _currentUploadLimit = newUploadLimit;
+        _uploadTokens = 0;
+        updateShapingTimer();
         for (auto *ud : _relativeUploadDeviceList) {
             if (newUploadLimit == 0) {
                 ud->setBandwidthLimited(false);
@@ -358,6 +451,8 @@ void BandwidthManager::setCurrentDownloadLimit(qint64 newDownloadLimit)
     if (newDownloadLimit != _currentDownloadLimit) {
         qCInfo(lcBandwidthManager) << "Download Bandwidth limit changed" << _currentDownloadLimit << newDownloadLimit;
         _currentDownloadLimit = newDownloadLimit;
+        _downloadTokens = 0;
+        updateShapingTimer();
         for (auto *j : _downloadJobList) {
             if (usingAbsoluteDownloadLimit()) {
                 j->setBandwidthLimited(true);
@@ -375,23 +470,60 @@ void BandwidthManager::setCurrentDownloadLimit(qint64 newDownloadLimit)
 
 // end downloads
 
-void BandwidthManager::absoluteLimitTimerExpired()
+void BandwidthManager::setActiveJobs(OwncloudPropagator *propagator, const Account *account, int activeJobs)
+{
+    auto it = _propagatorJobs.find(propagator);
+    if (it == _propagatorJobs.end()) {
+        it = _propagatorJobs.insert(propagator, {account, 0});
+        connect(propagator, &QObject::destroyed, this, [this, propagator, account] {
+            // the pointer is only used as a key, the propagator is already gone
+            if (_propagatorJobs.take(propagator).activeJobs > 0) {
+                Q_EMIT activeJobsDecreased(account);
+            }
+        });
+    }
+    const bool decreased = activeJobs < it->activeJobs;
+    it->activeJobs = activeJobs;
+    if (decreased) {
+        Q_EMIT activeJobsDecreased(account);
+    }
+}
+
+int BandwidthManager::activeJobs(const Account *account, const OwncloudPropagator *except) const
 {
-    if (usingAbsoluteUploadLimit() && !_absoluteUploadDeviceList.empty()) {
-        qint64 quotaPerDevice = _currentUploadLimit / _absoluteUploadDeviceList.size();
-        qCDebug(lcBandwidthManager) << quotaPerDevice << _absoluteUploadDeviceList.size() << _currentUploadLimit;
-        for (auto *device : std::as_const(_absoluteUploadDeviceList)) {
-            device->giveBandwidthQuota(quotaPerDevice);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerDevice / 1024.0 << " kB to" << device;
+    int jobs = 0;
+    for (auto it = _propagatorJobs.cbegin(); it != _propagatorJobs.cend(); ++it) {
+        if (it->account == account && it.key() != except) {
+            jobs += it->activeJobs;
         }
     }
-    if (usingAbsoluteDownloadLimit() && !_downloadJobList.empty()) {
-        qint64 quotaPerJob = _currentDownloadLimit / _downloadJobList.size();
-        qCDebug(lcBandwidthManager) << quotaPerJob << _downloadJobList.size() << _currentDownloadLimit;
-        for (auto *j : _downloadJobList) {
-            j->giveBandwidthQuota(quotaPerJob);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerJob / 1024.0 << " kB to" << j;
+    return jobs;
+}
+
+void BandwidthManager::updateShapingTimer()
+{
+    if (usingAbsoluteUploadLimit() || usingAbsoluteDownloadLimit()) {
+        if (!_shapingTimer.isActive()) {
+            _shapingClock.start();
+            _shapingTimer.start();
         }
+    } else {
+        _shapingTimer.stop();
+    }
+}
+
+void BandwidthManager::shapingTimerExpired()
+{
+    // the timer is not precise, refill the buckets with the time that actually passed
+    const double elapsedSec = _shapingClock.restart() / 1000.0;
+
+    if (usingAbsoluteUploadLimit()) {
+        _uploadTokens = distributeTokens(
+            _absoluteUploadDeviceList, _uploadTokens + _currentUploadLimit * elapsedSec, burstSize(_currentUploadLimit));
+    }
+    if (usingAbsoluteDownloadLimit()) {
+        _downloadTokens =
+            distributeTokens(_downloadJobList, _downloadTokens + _currentDownloadLimit * elapsedSec, burstSize(_currentDownloadLimit));
     }
 }
 }
@@ -15,14 +15,18 @@
 #ifndef BANDWIDTHMANAGER_H
 #define BANDWIDTHMANAGER_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QTimer>
 #include <QIODevice>
 
+#include <QHash>
+
 #include <list>
 
 namespace OCC {
 
+class Account;
 class UploadDevice;
 class GETFileJob;
 class OwncloudPropagator;
@@ -30,14 +34,30 @@ class OwncloudPropagator;
 /**
  * @brief The BandwidthManager class
  * @ingroup libsync
+ *
+ * Absolute limits are enforced with a token bucket per direction that is
+ * refilled every ShapingIntervalMsec. The tokens are handed out to the
+ * registered devices with a deficit round robin: every device that still
+ * has data to transfer gets an equal share, and what a small transfer does
+ * not need is passed on to the others in the same round.
+ *
+ * Relative limits measure the unlimited speed of one device at a time and
+ * derive the quota of all devices from it.
+ *
+ * There is one instance for the whole process, so the limits are a budget
+ * shared by the transfers of all sync engines. It also keeps track of the
+ * jobs the propagators of an account run, several syncs of one account
+ * share the connections to its server.
  */
 class BandwidthManager : public QObject
 {
     Q_OBJECT
 public:
-    BandwidthManager(OwncloudPropagator *p);
     ~BandwidthManager() override;
 
+    /** The bandwidth manager shared by all sync engines */
+    static BandwidthManager *instance();
+
     bool usingAbsoluteUploadLimit() { return _currentUploadLimit > 0; }
     bool usingRelativeUploadLimit() { return _currentUploadLimit < 0; }
     bool usingAbsoluteDownloadLimit() { return _currentDownloadLimit > 0; }
@@ -50,6 +70,16 @@ public:
     qint64 currentUploadLimit() const;
     void setCurrentUploadLimit(qint64 newCurrentUploadLimit);
 
+    /** Record that \a propagator, which syncs with \a account, runs \a activeJobs jobs */
+    void setActiveJobs(OwncloudPropagator *propagator, const Account *account, int activeJobs);
+
+    /** The jobs run by the propagators of \a account, without the ones of \a except */
+    int activeJobs(const Account *account, const OwncloudPropagator *except = nullptr) const;
+
+Q_SIGNALS:
+    /** A propagator of \a account finished some of its jobs, so others may start theirs */
+    void activeJobsDecreased(const Account *account);
+
 public Q_SLOTS:
     void registerUploadDevice(UploadDevice *);
     void unregisterUploadDevice(QObject *);
@@ -57,7 +87,7 @@ public Q_SLOTS:
     void registerDownloadJob(GETFileJob *);
     void unregisterDownloadJob(GETFileJob *);
 
-    void absoluteLimitTimerExpired();
+    void shapingTimerExpired();
 
     void relativeUploadMeasuringTimerExpired();
     void relativeUploadDelayTimerExpired();
@@ -66,12 +96,15 @@ public Q_SLOTS:
     void relativeDownloadDelayTimerExpired();
 
 private:
-    // FIXME this timer and this variable should be replaced
-    // by the propagator emitting the changed limit values to us as signal
-    OwncloudPropagator *_propagator;
+    explicit BandwidthManager(QObject *parent);
+
+    void updateShapingTimer();
 
     // for absolute up/down bw limiting
-    QTimer _absoluteLimitTimer;
+    QTimer _shapingTimer;
+    QElapsedTimer _shapingClock;
+    double _uploadTokens = 0;
+    double _downloadTokens = 0;
 
     // FIXME merge these two lists
     std::list<UploadDevice *> _absoluteUploadDeviceList;
@@ -102,6 +135,13 @@ private:
     qint64 _relativeDownloadLimitProgressAtMeasuringRestart;
 
     qint64 _currentDownloadLimit;
+
+    struct PropagatorJobs
+    {
+        const Account *account;
+        int activeJobs;
+    };
+    QHash<const OwncloudPropagator *, PropagatorJobs> _propagatorJobs;
 };
 }
 
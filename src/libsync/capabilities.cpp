@@ -127,6 +127,11 @@ bool Capabilities::notificationsAvailable() const
     return _capabilities.contains(QStringLiteral("notifications")) && _capabilities.value(QStringLiteral("notifications")).toMap().contains(QStringLiteral("ocs-endpoints"));
 }
 
+bool Capabilities::serverSentEvents() const
+{
+    return _capabilities.value(QStringLiteral("core")).toMap().value(QStringLiteral("support-sse")).toBool();
+}
+
 bool Capabilities::isValid() const
 {
     return !_capabilities.isEmpty();
@@ -178,6 +183,41 @@ bool Capabilities::chunkingNg() const
     return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("chunking")).toFloat() >= 1.0;
 }
 
+bool Capabilities::bulkUpload() const
+{
+    static const auto bulkUpload = qgetenv("OWNCLOUD_BULK_UPLOAD");
+    if (bulkUpload == "0")
+        return false;
+    if (bulkUpload == "1")
+        return true;
+    return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("bulkupload")).toFloat() >= 1.0;
+}
+
+QUrl Capabilities::archiverUrl() const
+{
+    static const auto archiveDownload = qgetenv("OWNCLOUD_ARCHIVE_DOWNLOAD");
+    if (archiveDownload == "0")
+        return {};
+    const auto archivers = _capabilities.value(QStringLiteral("files")).toMap().value(QStringLiteral("archivers")).toList();
+    for (const auto &archiver : archivers) {
+        const auto map = archiver.toMap();
+        if (map.value(QStringLiteral("enabled")).toBool() && map.value(QStringLiteral("formats")).toStringList().contains(QStringLiteral("tar"))) {
+            return QUrl(map.value(QStringLiteral("archiver_url")).toString());
+        }
+    }
+    return {};
+}
+
+bool Capabilities::propfindDepthInfinity() const
+{
+    return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("propfind")).toMap().value(QStringLiteral("depth_infinity")).toBool();
+}
+
+bool Capabilities::syncCollectionReport() const
+{
+    return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("reports")).toStringList().contains(QStringLiteral("sync-collection"));
+}
+
 bool Capabilities::bigfilechunkingEnabled() const
 {
     bool ok;
@@ -21,6 +21,7 @@
 #include "common/checksumalgorithms.h"
 
 #include <QStringList>
+#include <QUrl>
 #include <QVariantMap>
 #include <QVersionNumber>
 
@@ -191,6 +192,23 @@ public:
 
     bool chunkingNg() const;
 
+    /// Whether the server accepts several small files in one bulk upload request
+    bool bulkUpload() const;
+
+    /**
+     * The url of the archiver that streams several files as one tar archive
+     *
+     * Relative to the server url, empty if the server has no such archiver.
+     * Path: files/archivers
+     */
+    QUrl archiverUrl() const;
+
+    /// Whether the server allows PROPFIND requests with Depth: infinity
+    bool propfindDepthInfinity() const;
+
+    /// Whether the server reports the changes since a sync token with a sync-collection REPORT, RFC 6578
+    bool syncCollectionReport() const;
+
     /// Wheter to use chunking
     bool bigfilechunkingEnabled() const;
 
@@ -210,6 +228,9 @@ public:
     /// returns true if the capabilities report notifications
     bool notificationsAvailable() const;
 
+    /// Whether the server sends change notifications as server-sent events, see ServerEvents
+    bool serverSentEvents() const;
+
     /// returns true if the capabilities are loaded already.
     bool isValid() const;
 
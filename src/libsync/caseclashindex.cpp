@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "caseclashindex.h"
+
+using namespace OCC;
+
+QString CaseClashIndex::foldedName(const QString &name)
+{
+#ifdef Q_OS_MAC
+    // the file system also doesn't distinguish the normalization forms, ASCII is normalized already
+    if (QtPrivate::isAscii(name)) {
+        return name.toCaseFolded();
+    }
+    return name.normalized(QString::NormalizationForm_C).toCaseFolded();
+#else
+    return name.toCaseFolded();
+#endif
+}
+
+void CaseClashIndex::addFolder(const QString &folder, const QStringList &names)
+{
+    QHash<QString, QString> spellings;
+    spellings.reserve(names.size());
+    QSet<QString> clashing;
+    for (const auto &name : names) {
+        const auto folded = foldedName(name);
+        const auto it = spellings.constFind(folded);
+        if (it == spellings.cend()) {
+            spellings.insert(folded, name);
+        } else if (it.value() != name) {
+            clashing.insert(folded);
+        }
+    }
+    _clashingNames.insert(folder, clashing);
+}
+
+bool CaseClashIndex::mayClash(const QString &relFile) const
+{
+    qsizetype start = 0;
+    while (true) {
+        const auto slash = relFile.indexOf(QLatin1Char('/'), start);
+        const auto it = _clashingNames.constFind(start == 0 ? QString() : relFile.left(start - 1));
+        if (it == _clashingNames.cend()) {
+            return true;
+        }
+        if (it->contains(foldedName(relFile.mid(start, slash == -1 ? -1 : slash - start)))) {
+            return true;
+        }
+        if (slash == -1) {
+            return false;
+        }
+        start = slash + 1;
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+namespace OCC {
+
+/**
+ * @brief The names of the listed folders that differ only in their case
+ * @ingroup libsync
+ *
+ * On a case preserving file system two names that differ only in their case
+ * refer to the same file. The discovery adds the local and remote names of each
+ * folder it lists, the propagator then only needs to ask the file system about a
+ * clash for the paths that may have one.
+ *
+ * Only the case folded names with more than one spelling are kept, so the memory
+ * stays proportional to the number of listed folders.
+ */
+class OWNCLOUDSYNC_EXPORT CaseClashIndex
+{
+public:
+    /// Adds all local and remote \a names of the folder at \a folder, the root is the empty path
+    void addFolder(const QString &folder, const QStringList &names);
+
+    /**
+     * Whether \a relFile or one of its parent folders may clash with an other name
+     *
+     * True if one of its folders was not listed.
+     */
+    bool mayClash(const QString &relFile) const;
+
+private:
+    static QString foldedName(const QString &name);
+
+    // the case folded names with more than one spelling, by folder
+    QHash<QString, QSet<QString>> _clashingNames;
+};
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "chunksizecontroller.h"
+#include "syncoptions.h"
+
+#include <QLoggingCategory>
+
+using namespace std::chrono;
+
+namespace {
+// the first samples are averaged, later ones are weighted with 1 / MaximumWeight
+constexpr int MaximumWeight = 4;
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcChunkSize, "sync.propagator.chunksize", QtInfoMsg)
+
+qint64 ChunkSizeController::chunkSize(const SyncOptions &options) const
+{
+    if (options._targetChunkUploadDuration.count() <= 0 || _samples == 0) {
+        return options._initialChunkSize;
+    }
+    const auto target = static_cast<qint64>(_throughput * static_cast<double>(options._targetChunkUploadDuration.count()));
+    return qBound(options._minChunkSize, target, options._maxChunkSize);
+}
+
+void ChunkSizeController::addSample(qint64 bytes, milliseconds duration, const SyncOptions &options)
+{
+    if (bytes < options._minChunkSize || bytes <= 0) {
+        return;
+    }
+    // add one to avoid div-by-zero
+    const double throughput = static_cast<double>(bytes) / static_cast<double>(duration.count() + 1);
+    _samples = qMin(_samples + 1, MaximumWeight);
+    _throughput += (throughput - _throughput) / _samples;
+    qCDebug(lcChunkSize) << "Chunk of" << bytes << "bytes took" << duration.count() << "ms, the chunk size is now" << chunkSize(options) << "bytes";
+}
+
+void ChunkSizeController::reset()
+{
+    _throughput = 0;
+    _samples = 0;
+}
+
+}
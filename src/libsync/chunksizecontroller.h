@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QtGlobal>
+
+#include <chrono>
+
+namespace OCC {
+
+class SyncOptions;
+
+/**
+ * @brief The size of upload chunks of an account
+ * @ingroup libsync
+ *
+ * Models the throughput of a single connection from the finished chunk
+ * uploads, the chunk size is the amount that connection transfers within
+ * SyncOptions::_targetChunkUploadDuration. As every chunk measures the
+ * throughput it got while sharing the link with the other transfers, the
+ * parallel uploads converge on the same size instead of nudging a shared
+ * value back and forth.
+ *
+ * Chunks smaller than SyncOptions::_minChunkSize, usually the last chunk of
+ * a file, are dominated by the request latency and are not sampled.
+ *
+ * Used by the chunked NG and TUS uploads. The state lives on the Account, so
+ * a new sync starts with the chunk size learned by the previous ones.
+ */
+class OWNCLOUDSYNC_EXPORT ChunkSizeController
+{
+public:
+    /** The size of the next chunk, the initial chunk size without a target duration or samples */
+    qint64 chunkSize(const SyncOptions &options) const;
+
+    /** Report an uploaded chunk of \a bytes whose request took \a duration */
+    void addSample(qint64 bytes, std::chrono::milliseconds duration, const SyncOptions &options);
+
+    /** The modelled throughput of a single connection in bytes per millisecond, 0 without samples */
+    double throughput() const { return _throughput; }
+
+    /** Forget all observations and start over with the initial chunk size */
+    void reset();
+
+private:
+    double _throughput = 0;
+    int _samples = 0;
+};
+
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "libsync/coalescedtimer.h"
+
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QPointer>
+#include <QTimer>
+
+#include <algorithm>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcCoalescedTimer, "sync.coalescedtimer", QtInfoMsg)
+
+class WakeupScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static WakeupScheduler *instance()
+    {
+        if (!_instance) {
+            _instance = new WakeupScheduler(QCoreApplication::instance());
+        }
+        return _instance;
+    }
+
+    /// The scheduler if it exists, it goes away with the application
+    static WakeupScheduler *existingInstance() { return _instance; }
+
+    static quint64 wakeups() { return _wakeups; }
+
+    void add(CoalescedTimer *timer)
+    {
+        if (std::find(_timers.cbegin(), _timers.cend(), timer) == _timers.cend()) {
+            _timers.push_back(timer);
+        }
+        reschedule();
+    }
+
+    void remove(CoalescedTimer *timer)
+    {
+        _timers.erase(std::remove(_timers.begin(), _timers.end(), timer), _timers.end());
+        reschedule();
+    }
+
+private:
+    explicit WakeupScheduler(QObject *parent)
+        : QObject(parent)
+    {
+        _timer.setSingleShot(true);
+        _timer.setTimerType(Qt::CoarseTimer);
+        connect(&_timer, &QTimer::timeout, this, &WakeupScheduler::wakeUp);
+    }
+
+    void reschedule()
+    {
+        if (_timers.empty()) {
+            _timer.stop();
+            return;
+        }
+        auto due = steady_clock::time_point::max();
+        for (const auto *timer : _timers) {
+            due = std::min(due, timer->_due);
+        }
+        _timer.start(std::max(duration_cast<milliseconds>(due - steady_clock::now()), milliseconds(0)));
+    }
+
+    void wakeUp()
+    {
+        ++_wakeups;
+        const auto now = steady_clock::now();
+        std::vector<QPointer<CoalescedTimer>> fired;
+        for (auto *timer : _timers) {
+            // fire the timers that would wake us up again soon
+            if (timer->_due - timer->_interval / 4 <= now) {
+                fired.emplace_back(timer);
+            }
+        }
+        for (const auto &timer : fired) {
+            if (timer->_singleShot) {
+                timer->_active = false;
+                _timers.erase(std::remove(_timers.begin(), _timers.end(), timer.data()), _timers.end());
+            } else {
+                timer->_due = now + timer->_interval;
+            }
+        }
+        qCDebug(lcCoalescedTimer) << "Wakeup" << _wakeups << "fired" << fired.size() << "of" << fired.size() + _timers.size() << "timers";
+        for (const auto &timer : fired) {
+            // a slot might have deleted the timer
+            if (timer) {
+                Q_EMIT timer->timeout();
+            }
+        }
+        reschedule();
+    }
+
+    QTimer _timer;
+    std::vector<CoalescedTimer *> _timers;
+    static QPointer<WakeupScheduler> _instance;
+    static quint64 _wakeups;
+};
+
+QPointer<WakeupScheduler> WakeupScheduler::_instance;
+quint64 WakeupScheduler::_wakeups = 0;
+
+CoalescedTimer::CoalescedTimer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+CoalescedTimer::~CoalescedTimer()
+{
+    stop();
+}
+
+void CoalescedTimer::setInterval(milliseconds interval)
+{
+    _interval = interval;
+    if (_active) {
+        start();
+    }
+}
+
+void CoalescedTimer::start()
+{
+    _due = steady_clock::now() + _interval;
+    _active = true;
+    WakeupScheduler::instance()->add(this);
+}
+
+void CoalescedTimer::start(milliseconds interval)
+{
+    _interval = interval;
+    start();
+}
+
+void CoalescedTimer::stop()
+{
+    if (_active) {
+        _active = false;
+        if (auto *scheduler = WakeupScheduler::existingInstance()) {
+            scheduler->remove(this);
+        }
+    }
+}
+
+quint64 CoalescedTimer::wakeups()
+{
+    return WakeupScheduler::wakeups();
+}
+}
+
+#include "coalescedtimer.moc"
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QObject>
+
+#include <chrono>
+
+namespace OCC {
+
+/**
+ * @brief A timer for the periodic background tasks of the client
+ * @ingroup libsync
+ *
+ * All coalesced timers of the process share one QTimer. When it wakes up, every
+ * timer that is due within a quarter of its interval fires as well, so the polls
+ * of an idle client run in shared wake windows instead of each waking the process
+ * on its own.
+ *
+ * A timer might fire up to a quarter of its interval early, it is meant for polls
+ * and refreshes and not for timeouts. It must be used in the main thread.
+ */
+class OWNCLOUDSYNC_EXPORT CoalescedTimer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CoalescedTimer(QObject *parent = nullptr);
+    ~CoalescedTimer() override;
+
+    void setInterval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds interval() const { return _interval; }
+
+    void setSingleShot(bool singleShot) { _singleShot = singleShot; }
+    bool isSingleShot() const { return _singleShot; }
+
+    bool isActive() const { return _active; }
+
+    /// (Re)starts the timer, it is due in interval()
+    void start();
+    void start(std::chrono::milliseconds interval);
+    void stop();
+
+    /// The number of times the coalesced timers woke up the process
+    static quint64 wakeups();
+
+Q_SIGNALS:
+    void timeout();
+
+private:
+    friend class WakeupScheduler;
+
+    std::chrono::milliseconds _interval = {};
+    std::chrono::steady_clock::time_point _due;
+    bool _singleShot = false;
+    bool _active = false;
+};
+}
@@ -31,12 +31,15 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QLoggingCategory>
+#include <QMutex>
 #include <QSettings>
 #include <QNetworkProxy>
 #include <QOperatingSystemVersion>
 #include <QStandardPaths>
 
+#include <algorithm>
 #include <chrono>
 using namespace std::chrono_literals;
 
@@ -69,6 +72,9 @@ const QString chunkSizeC() { return QStringLiteral("chunkSize"); }
 const QString minChunkSizeC() { return QStringLiteral("minChunkSize"); }
 const QString maxChunkSizeC() { return QStringLiteral("maxChunkSize"); }
 const QString targetChunkUploadDurationC() { return QStringLiteral("targetChunkUploadDuration"); }
+const QString adaptiveTransferConcurrencyC() { return QStringLiteral("adaptiveTransferConcurrency"); }
+const QString propagationOrderC() { return QStringLiteral("propagationOrder"); }
+const QString maxConcurrentSyncsC() { return QStringLiteral("maxConcurrentSyncs"); }
 const QString automaticLogDirC() { return QStringLiteral("logToTemporaryLogDir"); }
 const QString numberOfLogsToKeepC()
 {
@@ -92,6 +98,7 @@ const QString useUploadLimitC() { return QStringLiteral("BWLimit/useUploadLimit"
 const QString useDownloadLimitC() { return QStringLiteral("BWLimit/useDownloadLimit"); }
 const QString uploadLimitC() { return QStringLiteral("BWLimit/uploadLimit"); }
 const QString downloadLimitC() { return QStringLiteral("BWLimit/downloadLimit"); }
+const QString bandwidthScheduleC() { return QStringLiteral("BWSchedule"); }
 
 const QString pauseSyncWhenMeteredC()
 {
@@ -115,10 +122,222 @@ QString excludeFileNameC()
 QString ConfigFile::_confDir = QString();
 const std::chrono::seconds DefaultRemotePollInterval { 30 };
 
-static chrono::milliseconds millisecondsValue(const QSettings &setting, const QString &key,
-    chrono::milliseconds defaultValue)
+/**
+ * The parsed user config file, shared by all ConfigFile instances
+ *
+ * Reading a value is a lookup instead of a stat and possibly a parse of the file.
+ * The values are written through to the file, changes of the file by other processes
+ * are picked up by the ConfigFileNotifier.
+ */
+class ConfigFileCache
 {
-    return chrono::milliseconds(setting.value(key, qlonglong(defaultValue.count())).toLongLong());
+public:
+    static ConfigFileCache &instance()
+    {
+        static ConfigFileCache cache;
+        return cache;
+    }
+
+    QVariant value(const QString &key, const QVariant &defaultValue)
+    {
+        QMutexLocker lock(&_mutex);
+        load();
+        return _values.value(key, defaultValue);
+    }
+
+    bool contains(const QString &key)
+    {
+        QMutexLocker lock(&_mutex);
+        load();
+        return _values.contains(key);
+    }
+
+    /// Writes \a value to the file, returns whether the value changed
+    bool setValue(const QString &key, const QVariant &value)
+    {
+        QMutexLocker lock(&_mutex);
+        load();
+        auto settings = ConfigFile::makeQSettings();
+        settings.setValue(key, value);
+        settings.sync();
+        const auto it = _values.find(key);
+        if (it != _values.end() && it.value() == value) {
+            return false;
+        }
+        _values.insert(key, value);
+        return true;
+    }
+
+    /// Removes \a key and its children from the file, returns the removed keys
+    QStringList remove(const QString &key)
+    {
+        QMutexLocker lock(&_mutex);
+        load();
+        auto settings = ConfigFile::makeQSettings();
+        settings.remove(key);
+        settings.sync();
+        QStringList removed;
+        const QString prefix = key + QLatin1Char('/');
+        for (auto it = _values.begin(); it != _values.end();) {
+            if (it.key() == key || it.key().startsWith(prefix)) {
+                removed.append(it.key());
+                it = _values.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return removed;
+    }
+
+    /// Reads the file again, returns the keys whose values changed
+    QStringList reload()
+    {
+        QMutexLocker lock(&_mutex);
+        if (!_loaded) {
+            return {};
+        }
+        const auto values = read();
+        QStringList changed;
+        for (auto it = values.cbegin(); it != values.cend(); ++it) {
+            const auto old = _values.constFind(it.key());
+            if (old == _values.cend() || old.value() != it.value()) {
+                changed.append(it.key());
+            }
+        }
+        for (auto it = _values.cbegin(); it != _values.cend(); ++it) {
+            if (!values.contains(it.key())) {
+                changed.append(it.key());
+            }
+        }
+        _values = values;
+        return changed;
+    }
+
+    /// Drops the values, they are read again from the current config file on the next access
+    void reset()
+    {
+        QMutexLocker lock(&_mutex);
+        _loaded = false;
+        _values.clear();
+    }
+
+private:
+    static QHash<QString, QVariant> read()
+    {
+        const auto settings = ConfigFile::makeQSettings();
+        QHash<QString, QVariant> values;
+        for (const auto &key : settings.allKeys()) {
+            values.insert(key, settings.value(key));
+        }
+        return values;
+    }
+
+    void load()
+    {
+        if (!_loaded) {
+            _values = read();
+            _loaded = true;
+            QMetaObject::invokeMethod(ConfigFileNotifier::instance(), &ConfigFileNotifier::watch, Qt::QueuedConnection);
+        }
+    }
+
+    QMutex _mutex;
+    bool _loaded = false;
+    QHash<QString, QVariant> _values;
+};
+
+namespace {
+
+QVariant cachedValue(const QString &key, const QVariant &defaultValue = {})
+{
+    return ConfigFileCache::instance().value(key, defaultValue);
+}
+
+QString groupKey(const QString &group, const QString &key)
+{
+    return group.isEmpty() ? key : group + QLatin1Char('/') + key;
+}
+
+chrono::milliseconds millisecondsValue(const QString &key, chrono::milliseconds defaultValue)
+{
+    return chrono::milliseconds(cachedValue(key, qlonglong(defaultValue.count())).toLongLong());
+}
+
+/// The settings of the administrator, they are read once
+QVariant systemValue(const QString &key, const QVariant &defaultValue)
+{
+    static const auto values = [] {
+        std::unique_ptr<QSettings> systemSettings;
+        if (Utility::isMac()) {
+            systemSettings = std::make_unique<QSettings>(
+                QStringLiteral("/Library/Preferences/%1.plist").arg(Theme::instance()->orgDomainName()), QSettings::NativeFormat);
+        } else if (Utility::isUnix()) {
+            systemSettings = std::make_unique<QSettings>(QStringLiteral(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->piappName()), QSettings::NativeFormat);
+        } else { // Windows
+            systemSettings = std::make_unique<QSettings>(
+                QStringLiteral("HKEY_LOCAL_MACHINE\\Software\\%1\\%2").arg(Theme::instance()->pivendor(), Theme::instance()->piappNameGUI()),
+                QSettings::NativeFormat);
+        }
+        QHash<QString, QVariant> out;
+        for (const auto &key : systemSettings->allKeys()) {
+            out.insert(key, systemSettings->value(key));
+        }
+        return out;
+    }();
+    return values.value(key, defaultValue);
+}
+
+} // anonymous namespace
+
+ConfigFileNotifier::ConfigFileNotifier()
+{
+    if (auto *app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+    }
+}
+
+ConfigFileNotifier *ConfigFileNotifier::instance()
+{
+    static auto *notifier = [] {
+        // the watcher must not outlive the application
+        qAddPostRoutine([] {
+            auto *notifier = ConfigFileNotifier::instance();
+            delete notifier->_watcher;
+            notifier->_watcher = nullptr;
+        });
+        return new ConfigFileNotifier;
+    }();
+    return notifier;
+}
+
+void ConfigFileNotifier::watch()
+{
+    if (!_watcher) {
+        _watcher = new QFileSystemWatcher(this);
+        connect(_watcher, &QFileSystemWatcher::fileChanged, this, &ConfigFileNotifier::reload);
+        connect(_watcher, &QFileSystemWatcher::directoryChanged, this, &ConfigFileNotifier::reload);
+    }
+    // QSettings replaces the file when it writes it, the directory is watched for that
+    const QStringList paths = {ConfigFile::configPath(), ConfigFile::configFile()};
+    const auto watched = _watcher->files() + _watcher->directories();
+    for (const auto &path : watched) {
+        if (!paths.contains(path)) {
+            _watcher->removePath(path);
+        }
+    }
+    for (const auto &path : paths) {
+        if (!watched.contains(path) && QFileInfo::exists(path)) {
+            _watcher->addPath(path);
+        }
+    }
+}
+
+void ConfigFileNotifier::reload()
+{
+    watch();
+    for (const auto &key : ConfigFileCache::instance().reload()) {
+        Q_EMIT valueChanged(key);
+    }
 }
 
 ConfigFile::ConfigFile()
@@ -141,6 +360,7 @@ bool ConfigFile::setConfDir(const QString &value)
         dirPath = fi.absoluteFilePath();
         qCInfo(lcConfigFile) << "Using custom config dir " << dirPath;
         _confDir = dirPath;
+        ConfigFileCache::instance().reset();
         return true;
     }
     return false;
@@ -148,15 +368,13 @@ bool ConfigFile::setConfDir(const QString &value)
 
 bool ConfigFile::optionalDesktopNotifications() const
 {
-    auto settings = makeQSettings();
-    return settings.value(optionalDesktopNoficationsC(), true).toBool();
+    return cachedValue(optionalDesktopNoficationsC(), true).toBool();
 }
 
 std::optional<QStringList> ConfigFile::issuesWidgetFilter() const
 {
-    auto settings = makeQSettings();
-    if (settings.contains(issuesWidgetFilterC())) {
-        return settings.value(issuesWidgetFilterC()).toStringList();
+    if (ConfigFileCache::instance().contains(issuesWidgetFilterC())) {
+        return cachedValue(issuesWidgetFilterC()).toStringList();
     }
 
     return {};
@@ -164,56 +382,59 @@ std::optional<QStringList> ConfigFile::issuesWidgetFilter() const
 
 void ConfigFile::setIssuesWidgetFilter(const QStringList &checked)
 {
-    auto settings = makeQSettings();
-    settings.setValue(issuesWidgetFilterC(), checked);
-    settings.sync();
+    setValue(issuesWidgetFilterC(), checked);
 }
 
 std::chrono::seconds ConfigFile::timeout() const
 {
-    auto settings = makeQSettings();
-    const auto val = settings.value(timeoutC()).toInt(); // default to 5 min
+    const auto val = cachedValue(timeoutC()).toInt(); // default to 5 min
     return val ? std::chrono::seconds(val) : 5min;
 }
 
 qint64 ConfigFile::chunkSize() const
 {
-    auto settings = makeQSettings();
-    return settings.value(chunkSizeC(), 10 * 1000 * 1000).toLongLong(); // default to 10 MB
+    return cachedValue(chunkSizeC(), 10 * 1000 * 1000).toLongLong(); // default to 10 MB
 }
 
 qint64 ConfigFile::maxChunkSize() const
 {
-    auto settings = makeQSettings();
-    return settings.value(maxChunkSizeC(), 100 * 1000 * 1000).toLongLong(); // default to 100 MB
+    return cachedValue(maxChunkSizeC(), 100 * 1000 * 1000).toLongLong(); // default to 100 MB
 }
 
 qint64 ConfigFile::minChunkSize() const
 {
-    auto settings = makeQSettings();
-    return settings.value(minChunkSizeC(), 1000 * 1000).toLongLong(); // default to 1 MB
+    return cachedValue(minChunkSizeC(), 1000 * 1000).toLongLong(); // default to 1 MB
 }
 
 chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
 {
-    auto settings = makeQSettings();
-    return millisecondsValue(settings, targetChunkUploadDurationC(), chrono::minutes(1));
+    return millisecondsValue(targetChunkUploadDurationC(), chrono::minutes(1));
+}
+
+bool ConfigFile::adaptiveTransferConcurrency() const
+{
+    return cachedValue(adaptiveTransferConcurrencyC(), false).toBool();
+}
+
+QString ConfigFile::propagationOrder() const
+{
+    return cachedValue(propagationOrderC(), QStringLiteral("path")).toString();
+}
+
+int ConfigFile::maxConcurrentSyncs() const
+{
+    return std::max(1, cachedValue(maxConcurrentSyncsC(), 1).toInt());
 }
 
 void ConfigFile::setOptionalDesktopNotifications(bool show)
 {
-    auto settings = makeQSettings();
-    settings.setValue(optionalDesktopNoficationsC(), show);
-    settings.sync();
+    setValue(optionalDesktopNoficationsC(), show);
 }
 
 void ConfigFile::saveGeometry(QWidget *w)
 {
     OC_ASSERT(!w->objectName().isNull());
-    auto settings = makeQSettings();
-    settings.beginGroup(w->objectName());
-    settings.setValue(geometryC(), w->saveGeometry());
-    settings.sync();
+    setValue(groupKey(w->objectName(), geometryC()), w->saveGeometry());
 }
 
 void ConfigFile::restoreGeometry(QWidget *w)
@@ -227,20 +448,16 @@ void ConfigFile::saveGeometryHeader(QHeaderView *header)
         return;
     OC_ASSERT(!header->objectName().isEmpty());
 
-    auto settings = makeQSettings();
-    settings.beginGroup(header->objectName());
-    settings.setValue(geometryC(), header->saveState());
-    settings.sync();
+    setValue(groupKey(header->objectName(), geometryC()), header->saveState());
 }
 
 bool ConfigFile::restoreGeometryHeader(QHeaderView *header)
 {
     Q_ASSERT(header && !header->objectName().isNull());
 
-    auto settings = makeQSettings();
-    settings.beginGroup(header->objectName());
-    if (settings.contains(geometryC())) {
-        header->restoreState(settings.value(geometryC()).toByteArray());
+    const QString key = groupKey(header->objectName(), geometryC());
+    if (ConfigFileCache::instance().contains(key)) {
+        header->restoreState(cachedValue(key).toByteArray());
         return true;
     }
     return false;
@@ -385,29 +602,21 @@ QString ConfigFile::defaultConnection() const
 void ConfigFile::storeData(const QString &group, const QString &key, const QVariant &value)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    auto settings = makeQSettings();
-
-    settings.beginGroup(con);
-    settings.setValue(key, value);
-    settings.sync();
+    setValue(groupKey(con, key), value);
 }
 
 void ConfigFile::removeData(const QString &group, const QString &key)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    auto settings = makeQSettings();
-
-    settings.beginGroup(con);
-    settings.remove(key);
+    for (const auto &removed : ConfigFileCache::instance().remove(groupKey(con, key))) {
+        Q_EMIT ConfigFileNotifier::instance()->valueChanged(removed);
+    }
 }
 
 bool ConfigFile::dataExists(const QString &group, const QString &key) const
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    auto settings = makeQSettings();
-
-    settings.beginGroup(con);
-    return settings.contains(key);
+    return ConfigFileCache::instance().contains(groupKey(con, key));
 }
 
 chrono::milliseconds ConfigFile::remotePollInterval(std::chrono::seconds defaultVal, const QString &connection) const
@@ -416,9 +625,6 @@ chrono::milliseconds ConfigFile::remotePollInterval(std::chrono::seconds default
     if (connection.isEmpty())
         con = defaultConnection();
 
-    auto settings = makeQSettings();
-    settings.beginGroup(con);
-
     auto defaultPollInterval { DefaultRemotePollInterval };
 
     // The server default-capabilities was set to 60 in some server releases,
@@ -429,7 +635,7 @@ chrono::milliseconds ConfigFile::remotePollInterval(std::chrono::seconds default
     if (defaultVal > chrono::seconds(5)) {
         defaultPollInterval = defaultVal;
     }
-    auto remoteInterval = millisecondsValue(settings, remotePollIntervalC(), defaultPollInterval);
+    auto remoteInterval = millisecondsValue(groupKey(con, remotePollIntervalC()), defaultPollInterval);
     if (remoteInterval < chrono::seconds(5)) {
         remoteInterval = defaultPollInterval;
         qCWarning(lcConfigFile) << "Remote Interval is less than 5 seconds, reverting to" << remoteInterval.count();
@@ -447,10 +653,7 @@ void ConfigFile::setRemotePollInterval(chrono::milliseconds interval, const QStr
         qCWarning(lcConfigFile) << "Remote Poll interval of " << interval.count() << " is below five seconds.";
         return;
     }
-    auto settings = makeQSettings();
-    settings.beginGroup(con);
-    settings.setValue(remotePollIntervalC(), qlonglong(interval.count()));
-    settings.sync();
+    setValue(groupKey(con, remotePollIntervalC()), qlonglong(interval.count()));
 }
 
 chrono::milliseconds ConfigFile::forceSyncInterval(std::chrono::seconds remoteFromCapabilities, const QString &connection) const
@@ -460,11 +663,9 @@ chrono::milliseconds ConfigFile::forceSyncInterval(std::chrono::seconds remoteFr
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    auto settings = makeQSettings();
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::hours(2);
-    auto interval = millisecondsValue(settings, forceSyncIntervalC(), defaultInterval);
+    auto interval = millisecondsValue(groupKey(con, forceSyncIntervalC()), defaultInterval);
     if (interval < pollInterval) {
         qCWarning(lcConfigFile) << "Force sync interval is less than the remote poll inteval, reverting to" << pollInterval.count();
         interval = pollInterval;
@@ -474,9 +675,7 @@ chrono::milliseconds ConfigFile::forceSyncInterval(std::chrono::seconds remoteFr
 
 chrono::milliseconds OCC::ConfigFile::fullLocalDiscoveryInterval() const
 {
-    auto settings = makeQSettings();
-    settings.beginGroup(defaultConnection());
-    return millisecondsValue(settings, fullLocalDiscoveryIntervalC(), 1h);
+    return millisecondsValue(groupKey(defaultConnection(), fullLocalDiscoveryIntervalC()), 1h);
 }
 
 chrono::milliseconds ConfigFile::notificationRefreshInterval(const QString &connection) const
@@ -484,11 +683,9 @@ chrono::milliseconds ConfigFile::notificationRefreshInterval(const QString &conn
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    auto settings = makeQSettings();
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::minutes(5);
-    auto interval = millisecondsValue(settings, notificationRefreshIntervalC(), defaultInterval);
+    auto interval = millisecondsValue(groupKey(con, notificationRefreshIntervalC()), defaultInterval);
     if (interval < chrono::minutes(1)) {
         qCWarning(lcConfigFile) << "Notification refresh interval smaller than one minute, setting to one minute";
         interval = chrono::minutes(1);
@@ -501,11 +698,9 @@ chrono::milliseconds ConfigFile::updateCheckInterval(const QString &connection)
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    auto settings = makeQSettings();
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::hours(10);
-    auto interval = millisecondsValue(settings, updateCheckIntervalC(), defaultInterval);
+    auto interval = millisecondsValue(groupKey(con, updateCheckIntervalC()), defaultInterval);
 
     auto minInterval = chrono::minutes(5);
     if (interval < minInterval) {
@@ -534,11 +729,7 @@ void ConfigFile::setSkipUpdateCheck(bool skip, const QString &connection)
     if (connection.isEmpty())
         con = defaultConnection();
 
-    auto settings = makeQSettings();
-    settings.beginGroup(con);
-
-    settings.setValue(skipUpdateCheckC(), QVariant(skip));
-    settings.sync();
+    setValue(groupKey(con, skipUpdateCheckC()), QVariant(skip));
 }
 
 QString ConfigFile::updateChannel() const
@@ -553,80 +744,48 @@ QString ConfigFile::updateChannel() const
         defaultUpdateChannel = QStringLiteral("beta");
     }
 
-    auto settings = makeQSettings();
-    return settings.value(updateChannelC(), defaultUpdateChannel).toString();
+    return cachedValue(updateChannelC(), defaultUpdateChannel).toString();
 }
 
 void ConfigFile::setUpdateChannel(const QString &channel)
 {
-    auto settings = makeQSettings();
-    settings.setValue(updateChannelC(), channel);
+    setValue(updateChannelC(), channel);
 }
 
 QString ConfigFile::uiLanguage() const
 {
-    auto settings = makeQSettings();
-    return settings.value(uiLanguageC(), QString()).toString();
+    return cachedValue(uiLanguageC(), QString()).toString();
 }
 
 void ConfigFile::setUiLanguage(const QString &uiLanguage)
 {
-    auto settings = makeQSettings();
-    settings.setValue(uiLanguageC(), uiLanguage);
+    setValue(uiLanguageC(), uiLanguage);
 }
 
 void ConfigFile::setProxyType(QNetworkProxy::ProxyType proxyType, const QString &host, int port, bool needsAuth, const QString &user)
 {
-    auto settings = makeQSettings();
-
-    settings.setValue(proxyTypeC(), proxyType);
+    setValue(proxyTypeC(), proxyType);
 
     if (proxyType == QNetworkProxy::HttpProxy || proxyType == QNetworkProxy::Socks5Proxy) {
-        settings.setValue(proxyHostC(), host);
-        settings.setValue(proxyPortC(), port);
-        settings.setValue(proxyNeedsAuthC(), needsAuth);
-        settings.setValue(proxyUserC(), user);
+        setValue(proxyHostC(), host);
+        setValue(proxyPortC(), port);
+        setValue(proxyNeedsAuthC(), needsAuth);
+        setValue(proxyUserC(), user);
     }
-    settings.sync();
 }
 
 QVariant ConfigFile::getValue(const QString &param, const QString &group,
     const QVariant &defaultValue) const
 {
-    QVariant systemSetting;
-    if (Utility::isMac()) {
-        QSettings systemSettings(QStringLiteral("/Library/Preferences/%1.plist").arg(Theme::instance()->orgDomainName()), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    } else if (Utility::isUnix()) {
-        QSettings systemSettings(QStringLiteral(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->piappName()), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    } else { // Windows
-        QSettings systemSettings(
-            QStringLiteral("HKEY_LOCAL_MACHINE\\Software\\%1\\%2").arg(Theme::instance()->pivendor(), Theme::instance()->piappNameGUI()), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    }
-
-    auto settings = makeQSettings();
-    if (!group.isEmpty())
-        settings.beginGroup(group);
-
-    return settings.value(param, systemSetting);
+    const QString key = groupKey(group, param);
+    return cachedValue(key, systemValue(key, defaultValue));
 }
 
 void ConfigFile::setValue(const QString &key, const QVariant &value)
 {
-    auto settings = makeQSettings();
-
-    settings.setValue(key, value);
+    if (ConfigFileCache::instance().setValue(key, value)) {
+        Q_EMIT ConfigFileNotifier::instance()->valueChanged(key);
+    }
 }
 
 int ConfigFile::proxyType() const
@@ -697,6 +856,49 @@ void ConfigFile::setDownloadLimit(int kbytes)
     setValue(downloadLimitC(), kbytes);
 }
 
+ConfigFile::BandwidthProfile ConfigFile::bandwidthProfile() const
+{
+    return {useUploadLimit(), uploadLimit(), useDownloadLimit(), downloadLimit()};
+}
+
+QVector<ConfigFile::BandwidthScheduleEntry> ConfigFile::bandwidthSchedule() const
+{
+    QVector<BandwidthScheduleEntry> out;
+    // the keys of the array written by QSettings, the entries are numbered from 1
+    const int size = cachedValue(bandwidthScheduleC() + QStringLiteral("/size"), 0).toInt();
+    for (int i = 0; i < size; ++i) {
+        const auto entryValue = [i](const QString &name, const QVariant &defaultValue = {}) {
+            return cachedValue(QStringLiteral("%1/%2/%3").arg(bandwidthScheduleC(), QString::number(i + 1), name), defaultValue);
+        };
+        BandwidthScheduleEntry entry;
+        const auto days = entryValue(QStringLiteral("days")).toString().split(QLatin1Char(','), Qt::SkipEmptyParts);
+        for (const auto &day : days) {
+            const int d = day.trimmed().toInt();
+            if (d >= Qt::Monday && d <= Qt::Sunday) {
+                entry.days.append(static_cast<Qt::DayOfWeek>(d));
+            }
+        }
+        entry.start = QTime::fromString(entryValue(QStringLiteral("start"), QStringLiteral("00:00")).toString(), QStringLiteral("HH:mm"));
+        entry.end = QTime::fromString(entryValue(QStringLiteral("end"), QStringLiteral("00:00")).toString(), QStringLiteral("HH:mm"));
+        if (!entry.start.isValid() || !entry.end.isValid()) {
+            qCWarning(lcConfigFile) << "Ignoring bandwidth schedule entry" << i << "with an invalid time";
+            continue;
+        }
+        const auto network = entryValue(QStringLiteral("network")).toString();
+        if (network == QLatin1String("metered")) {
+            entry.network = BandwidthScheduleEntry::Network::Metered;
+        } else if (network == QLatin1String("unmetered")) {
+            entry.network = BandwidthScheduleEntry::Network::Unmetered;
+        }
+        entry.profile.useUploadLimit = entryValue(QStringLiteral("useUploadLimit"), 0).toInt();
+        entry.profile.uploadLimit = entryValue(QStringLiteral("uploadLimit"), 10).toInt();
+        entry.profile.useDownloadLimit = entryValue(QStringLiteral("useDownloadLimit"), 0).toInt();
+        entry.profile.downloadLimit = entryValue(QStringLiteral("downloadLimit"), 80).toInt();
+        out.append(entry);
+    }
+    return out;
+}
+
 bool ConfigFile::pauseSyncWhenMetered() const
 {
     return getValue(pauseSyncWhenMeteredC(), {}, false).toBool();
@@ -723,67 +925,57 @@ void ConfigFile::setMoveToTrash(bool isChecked)
 
 bool ConfigFile::promptDeleteFiles() const
 {
-    auto settings = makeQSettings();
-    return settings.value(promptDeleteC(), true).toBool();
+    return cachedValue(promptDeleteC(), true).toBool();
 }
 
 void ConfigFile::setPromptDeleteFiles(bool promptDeleteFiles)
 {
-    auto settings = makeQSettings();
-    settings.setValue(promptDeleteC(), promptDeleteFiles);
+    setValue(promptDeleteC(), promptDeleteFiles);
 }
 
 bool ConfigFile::monoIcons() const
 {
-    auto settings = makeQSettings();
     bool monoDefault = false; // On Mac we want bw by default
 #ifdef Q_OS_MAC
     // OEM themes are not obliged to ship mono icons
     monoDefault = Theme::instance()->piappNameGUI() == QStringLiteral("ownCloud");
 #endif
-    return settings.value(monoIconsC(), monoDefault).toBool();
+    return cachedValue(monoIconsC(), monoDefault).toBool();
 }
 
 void ConfigFile::setMonoIcons(bool useMonoIcons)
 {
-    auto settings = makeQSettings();
-    settings.setValue(monoIconsC(), useMonoIcons);
+    setValue(monoIconsC(), useMonoIcons);
 }
 
 bool ConfigFile::crashReporter() const
 {
-    auto settings = makeQSettings();
-    return settings.value(crashReporterC(), true).toBool();
+    return cachedValue(crashReporterC(), true).toBool();
 }
 
 void ConfigFile::setCrashReporter(bool enabled)
 {
-    auto settings = makeQSettings();
-    settings.setValue(crashReporterC(), enabled);
+    setValue(crashReporterC(), enabled);
 }
 
 bool ConfigFile::automaticLogDir() const
 {
-    auto settings = makeQSettings();
-    return settings.value(automaticLogDirC(), false).toBool();
+    return cachedValue(automaticLogDirC(), false).toBool();
 }
 
 void ConfigFile::setAutomaticLogDir(bool enabled)
 {
-    auto settings = makeQSettings();
-    settings.setValue(automaticLogDirC(), enabled);
+    setValue(automaticLogDirC(), enabled);
 }
 
 int ConfigFile::automaticDeleteOldLogs() const
 {
-    auto settings = makeQSettings();
-    return settings.value(numberOfLogsToKeepC()).toInt();
+    return cachedValue(numberOfLogsToKeepC()).toInt();
 }
 
 void ConfigFile::setAutomaticDeleteOldLogs(int number)
 {
-    auto settings = makeQSettings();
-    settings.setValue(numberOfLogsToKeepC(), number);
+    setValue(numberOfLogsToKeepC(), number);
 }
 
 void ConfigFile::configureHttpLogging(std::optional<bool> enable)
@@ -792,8 +984,7 @@ void ConfigFile::configureHttpLogging(std::optional<bool> enable)
         enable = logHttp();
     }
 
-    auto settings = makeQSettings();
-    settings.setValue(logHttpC(), enable.value());
+    setValue(logHttpC(), enable.value());
 
     static const QSet<QString> rule = { QStringLiteral("sync.httplogger=true") };
 
@@ -806,20 +997,17 @@ void ConfigFile::configureHttpLogging(std::optional<bool> enable)
 
 bool ConfigFile::logHttp() const
 {
-    auto settings = makeQSettings();
-    return settings.value(logHttpC(), false).toBool();
+    return cachedValue(logHttpC(), false).toBool();
 }
 
 QString ConfigFile::clientVersionWithBuildNumberString() const
 {
-    auto settings = makeQSettings();
-    return settings.value(clientVersionC(), QString()).toString();
+    return cachedValue(clientVersionC(), QString()).toString();
 }
 
 void ConfigFile::setClientVersionWithBuildNumberString(const QString &version)
 {
-    auto settings = makeQSettings();
-    settings.setValue(clientVersionC(), version);
+    setValue(clientVersionC(), version);
 }
 
 std::unique_ptr<QSettings> ConfigFile::settingsWithGroup(const QString &group)
@@ -19,15 +19,19 @@
 #include "owncloudlib.h"
 
 #include <QNetworkProxy>
+#include <QObject>
 #include <QSettings>
 #include <QSharedPointer>
 #include <QString>
+#include <QTime>
 #include <QVariant>
+#include <QVector>
 
 #include <chrono>
 #include <memory>
 #include <optional>
 
+class QFileSystemWatcher;
 class QWidget;
 class QHeaderView;
 class ExcludedFiles;
@@ -35,10 +39,42 @@ class ExcludedFiles;
 namespace OCC {
 
 class AbstractCredentials;
+class ConfigFileCache;
+
+/**
+ * @brief Announces changes of the values of the ConfigFile
+ * @ingroup libsync
+ *
+ * The values are read once and then kept in memory for the whole process. They
+ * change through the setters of ConfigFile or when an other process writes the
+ * config file.
+ */
+class OWNCLOUDSYNC_EXPORT ConfigFileNotifier : public QObject
+{
+    Q_OBJECT
+public:
+    static ConfigFileNotifier *instance();
+
+Q_SIGNALS:
+    /// The value of \a key changed, the key of a group setting is prefixed with the group and a /
+    void valueChanged(const QString &key);
+
+private:
+    ConfigFileNotifier();
+
+    void watch();
+    void reload();
+
+    QFileSystemWatcher *_watcher = nullptr;
+
+    friend class ConfigFileCache;
+};
 
 /**
  * @brief The ConfigFile class
  * @ingroup libsync
+ *
+ * The getters read from a copy of the config file in memory, see ConfigFileNotifier.
  */
 class OWNCLOUDSYNC_EXPORT ConfigFile
 {
@@ -138,6 +174,50 @@ public:
     void setUploadLimit(int kbytes);
     void setDownloadLimit(int kbytes);
 
+    /** A set of limits with the semantics of useUploadLimit() and uploadLimit() */
+    struct BandwidthProfile
+    {
+        int useUploadLimit = 0;
+        int uploadLimit = 10;
+        int useDownloadLimit = 0;
+        int downloadLimit = 80;
+
+        bool operator==(const BandwidthProfile &other) const
+        {
+            return useUploadLimit == other.useUploadLimit && uploadLimit == other.uploadLimit && useDownloadLimit == other.useDownloadLimit
+                && downloadLimit == other.downloadLimit;
+        }
+    };
+
+    /**
+     * A time window in which other limits than the configured ones are used
+     *
+     * Stored in the BWSchedule array of the config file, for example:
+     *   BWSchedule\1\days=1,2,3,4,5
+     *   BWSchedule\1\start=08:00
+     *   BWSchedule\1\end=18:00
+     *   BWSchedule\1\network=metered
+     *   BWSchedule\1\useUploadLimit=1
+     *   BWSchedule\1\uploadLimit=100
+     */
+    struct BandwidthScheduleEntry
+    {
+        enum class Network { Any, Metered, Unmetered };
+
+        /// the days of the week the window starts on, empty for every day
+        QList<Qt::DayOfWeek> days;
+        QTime start;
+        /// an end before the start spans midnight
+        QTime end;
+        Network network = Network::Any;
+        BandwidthProfile profile;
+    };
+
+    /** The limits configured with setUseUploadLimit() and the like */
+    BandwidthProfile bandwidthProfile() const;
+    /** The first matching entry overrides bandwidthProfile() */
+    QVector<BandwidthScheduleEntry> bandwidthSchedule() const;
+
     bool pauseSyncWhenMetered() const;
     void setPauseSyncWhenMetered(bool isChecked);
 
@@ -159,6 +239,12 @@ public:
     qint64 maxChunkSize() const;
     qint64 minChunkSize() const;
     std::chrono::milliseconds targetChunkUploadDuration() const;
+    /** Whether the number of parallel transfers adapts to the connection, see SyncOptions::TransferConcurrencyMode */
+    bool adaptiveTransferConcurrency() const;
+    /** The name of the SyncOptions::PropagationOrder, see SyncOptions::propagationOrderFromName() */
+    QString propagationOrder() const;
+    /** The number of folders that are synced at the same time, see SyncScheduler */
+    int maxConcurrentSyncs() const;
 
     void saveGeometry(QWidget *w);
     void restoreGeometry(QWidget *w);
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "conflictchecksumprepass.h"
+#include "common/checksums.h"
+#include "common/syncjournaldb.h"
+#include "filesystem.h"
+#include "propagatedownload.h"
+
+#include <QLoggingCategory>
+#include <QtConcurrentMap>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcConflictChecksumPrepass, "sync.engine.conflictchecksumprepass", QtInfoMsg)
+
+ConflictChecksumPrepass::ConflictChecksumPrepass(const QString &localPath, SyncJournalDb *journal, QObject *parent)
+    : QObject(parent)
+    , _localPath(localPath)
+    , _journal(journal)
+{
+    connect(&_watcher, &QFutureWatcherBase::finished, this, &ConflictChecksumPrepass::slotFinished);
+}
+
+ConflictChecksumPrepass::~ConflictChecksumPrepass()
+{
+    // the running computations write into _candidates
+    _watcher.cancel();
+    _watcher.waitForFinished();
+}
+
+bool ConflictChecksumPrepass::isCandidate(const SyncFileItem &item)
+{
+    // virtual files are never compared, see PropagateDownloadFile::start()
+    return item._type == ItemTypeFile && PropagateDownloadFile::mayResolveConflictByChecksum(item);
+}
+
+bool ConflictChecksumPrepass::hasCandidates(const SyncFileItemSet &items)
+{
+    return std::any_of(items.cbegin(), items.cend(), [](const SyncFileItemPtr &item) { return isCandidate(*item); });
+}
+
+void ConflictChecksumPrepass::start(const SyncFileItemSet &items)
+{
+    for (const auto &item : items) {
+        if (isCandidate(*item)) {
+            const auto type = ChecksumHeader::parseChecksumHeader(item->_checksumHeader).type();
+            const auto cachedChecksum = _journal->cachedChecksum(item->_inode, item->_previousModtime, item->_previousSize, type);
+            _candidates.append({item, _localPath + item->_file, type, cachedChecksum, !cachedChecksum.isEmpty()});
+        }
+    }
+    qCInfo(lcConflictChecksumPrepass) << "Comparing the checksums of" << _candidates.size() << "conflicts";
+    _watcher.setFuture(QtConcurrent::map(_candidates, [](Candidate &candidate) {
+        if (!candidate.cached) {
+            candidate.checksum = ComputeChecksum::computeNowOnFile(candidate.path, candidate.type);
+        }
+    }));
+}
+
+void ConflictChecksumPrepass::slotFinished()
+{
+    if (_watcher.isCanceled()) {
+        return;
+    }
+    for (const auto &candidate : std::as_const(_candidates)) {
+        if (candidate.checksum.isEmpty()) {
+            // the file couldn't be read, leave it to the download
+            continue;
+        }
+        auto &item = *candidate.item;
+        if (!candidate.cached) {
+            _journal->setCachedChecksum(item._inode, item._previousModtime, item._previousSize, candidate.type, candidate.checksum);
+        }
+        if (ChecksumHeader::parseChecksumHeader(item._checksumHeader) != ChecksumHeader(candidate.type, candidate.checksum)) {
+            item._conflictChecksumCompared = true;
+            continue;
+        }
+        qCDebug(lcConflictChecksumPrepass) << item._file << "remote and local checksum match";
+        // Apply the server mtime locally if necessary, see PropagateDownloadFile::conflictChecksumComputed()
+        if (item._modtime != item._previousModtime) {
+            FileSystem::setModTime(candidate.path, item._modtime);
+        }
+        item._modtime = FileSystem::getModTime(candidate.path);
+        item.setInstruction(CSYNC_INSTRUCTION_UPDATE_METADATA);
+        item._direction = SyncFileItem::Down;
+        ++_resolved;
+    }
+    qCInfo(lcConflictChecksumPrepass) << _resolved << "of" << _candidates.size() << "conflicts are identical files";
+    _candidates.clear();
+    Q_EMIT finished();
+}
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "common/checksumalgorithms.h"
+#include "syncfileitem.h"
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QVector>
+
+namespace OCC {
+
+class SyncJournalDb;
+
+/**
+ * @brief Compares the local checksums of conflicting files before the propagation
+ * @ingroup libsync
+ *
+ * A conflict where the local file has the content of the remote one is resolved
+ * by PropagateDownloadFile by computing the local checksum, one file at a time
+ * as the jobs get scheduled. After restoring a backup these can be thousands.
+ *
+ * The prepass computes the checksums of all candidates in parallel on the
+ * global thread pool, unless the checksum of the unchanged local file is in
+ * the journal's cache. Identical files are turned into metadata updates, the
+ * others are marked as compared so the download doesn't compute them again.
+ */
+class OWNCLOUDSYNC_EXPORT ConflictChecksumPrepass : public QObject
+{
+    Q_OBJECT
+public:
+    ConflictChecksumPrepass(const QString &localPath, SyncJournalDb *journal, QObject *parent = nullptr);
+    ~ConflictChecksumPrepass() override;
+
+    /// Whether \a items contain a conflict the prepass might resolve
+    static bool hasCandidates(const SyncFileItemSet &items);
+
+    /// Computes the checksums of the candidates in \a items, finished() is emitted when done
+    void start(const SyncFileItemSet &items);
+
+    /// The number of conflicts that turned out to be identical files
+    qsizetype resolvedCount() const { return _resolved; }
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    static bool isCandidate(const SyncFileItem &item);
+    void slotFinished();
+
+    struct Candidate
+    {
+        SyncFileItemPtr item;
+        QString path;
+        CheckSums::Algorithm type;
+        QByteArray checksum;
+        bool cached;
+    };
+
+    QString _localPath;
+    SyncJournalDb *_journal;
+    QVector<Candidate> _candidates;
+    QFutureWatcher<void> _watcher;
+    qsizetype _resolved = 0;
+};
+}
@@ -57,12 +57,45 @@ CredentialManager::CredentialManager(QObject *parent)
 
 CredentialJob *CredentialManager::get(const QString &key)
 {
-    qCInfo(lcCredentialsManager) << "get" << scopedKey(this, key);
+    if (const auto pending = _pendingReads.value(key)) {
+        qCDebug(lcCredentialsManager) << "get" << scopedKey(this, key) << "is already being read";
+        return pending;
+    }
     auto out = new CredentialJob(this, key);
+    const auto cached = _cache.constFind(key);
+    if (cached != _cache.cend()) {
+        qCDebug(lcCredentialsManager) << "get" << scopedKey(this, key) << "from memory";
+        out->_data = cached.value();
+        // Q_EMIT the signal delayed to make sure we are connected
+        QTimer::singleShot(0, out, &CredentialJob::finished);
+        return out;
+    }
+    qCInfo(lcCredentialsManager) << "get" << scopedKey(this, key);
+    _pendingReads.insert(key, out);
+    connect(out, &CredentialJob::finished, this, [out, key, this] {
+        // a remove() while the read was running drops it
+        const auto it = _pendingReads.constFind(key);
+        if (it != _pendingReads.cend() && it.value() == out) {
+            _pendingReads.erase(it);
+            if (out->error() == QKeychain::NoError) {
+                _cache.insert(key, out->data());
+            }
+        }
+    });
     out->start();
     return out;
 }
 
+void CredentialManager::prefetch()
+{
+    const auto keys = knownKeys();
+    for (const auto &key : keys) {
+        if (!_cache.contains(key)) {
+            get(key);
+        }
+    }
+}
+
 QKeychain::Job *CredentialManager::set(const QString &key, const QVariant &data)
 {
     OC_ASSERT(!data.isNull());
@@ -76,11 +109,12 @@ QKeychain::Job *CredentialManager::set(const QString &key, const QVariant &data)
     Utility::ChronoElapsedTimer elapsedTimer;
     connect(timer, &QTimer::timeout, writeJob,
         [writeJob, elapsedTimer] { qCWarning(lcCredentialsManager) << "set" << writeJob->key() << "has not yet finished." << elapsedTimer.duration(); });
-    connect(writeJob, &QKeychain::WritePasswordJob::finished, this, [writeJob, key, elapsedTimer, this] {
+    connect(writeJob, &QKeychain::WritePasswordJob::finished, this, [writeJob, key, data, elapsedTimer, this] {
         if (writeJob->error() == QKeychain::NoError) {
             qCInfo(lcCredentialsManager) << "added" << writeJob->key() << "after" << elapsedTimer.duration();
             // just a list, the values don't matter
             credentialsList().setValue(key, true);
+            _cache.insert(key, data);
         } else {
             qCWarning(lcCredentialsManager) << "Failed to set:" << writeJob->key() << writeJob->errorString() << "after" << elapsedTimer.duration();
         }
@@ -98,6 +132,8 @@ QKeychain::Job *CredentialManager::remove(const QString &key)
     OC_ASSERT(contains(key));
     // remove immediately to prevent double invocation by clear()
     credentialsList().remove(key);
+    _cache.remove(key);
+    _pendingReads.remove(key);
     qCInfo(lcCredentialsManager) << "del" << scopedKey(this, key);
     auto keychainJob = new QKeychain::DeletePasswordJob(Theme::instance()->piappName());
     keychainJob->setKey(scopedKey(this, key));
@@ -219,6 +255,7 @@ void CredentialJob::start()
             if (error.error != QCborError::NoError) {
                 _error = QKeychain::OtherError;
                 _errorString = tr("Failed to parse credentials %1").arg(error.errorString());
+                Q_EMIT finished();
                 return;
             }
             _data = obj.toVariant();
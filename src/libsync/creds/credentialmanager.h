@@ -22,7 +22,18 @@ public:
     // account related credentials
     explicit CredentialManager(Account *acc);
 
+    /**
+     * Reads \a key from the keychain, unless it was read or written before in this session
+     *
+     * A get() of a key that is still being read shares the running job.
+     */
     CredentialJob *get(const QString &key);
+    /**
+     * Starts reading all known credentials of the scope at once
+     *
+     * Called at startup, the later get() calls are answered from memory then.
+     */
+    void prefetch();
     QKeychain::Job *set(const QString &key, const QVariant &data);
     QKeychain::Job *remove(const QString &key);
     /**
@@ -42,6 +53,10 @@ private:
     const Account *const _account = nullptr;
     mutable std::unique_ptr<QSettings> _credentialsList;
 
+    // the credentials read or written in this session, they are never written to disk
+    QHash<QString, QVariant> _cache;
+    QHash<QString, QPointer<CredentialJob>> _pendingReads;
+
     friend class TestCredentialManager;
 };
 
@@ -69,7 +84,7 @@ private:
     QKeychain::Error _error = QKeychain::NoError;
     QString _errorString;
     bool _retryOnKeyChainError = true;
-    QKeychain::ReadPasswordJob *_job;
+    QKeychain::ReadPasswordJob *_job = nullptr;
 
     CredentialManager *const _parent;
 
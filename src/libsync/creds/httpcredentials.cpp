@@ -128,6 +128,8 @@ void HttpCredentials::setAccount(Account *account)
     if (isOauth.isValid()) {
         _authType = isOauth.toBool() ? DetermineAuthTypeJob::AuthType::OAuth : DetermineAuthTypeJob::AuthType::Basic;
     }
+    _tokenRefreshTimer.setSingleShot(true);
+    connect(&_tokenRefreshTimer, &QTimer::timeout, this, &HttpCredentials::refreshAccessTokenAhead);
 }
 
 AccessManager *HttpCredentials::createAM() const
@@ -251,6 +253,10 @@ void HttpCredentials::slotAuthentication(QNetworkReply *reply, QAuthenticator *a
     if (!_oAuthJob && isUsingOAuth()) {
         qCInfo(lcHttpCredentials) << "Refreshing token";
         refreshAccessToken();
+    } else if (_isRefreshingAhead) {
+        // the token expired before the refresh finished, hold back the jobs until it did
+        _isRefreshingAhead = false;
+        Q_EMIT authenticationStarted();
     }
 }
 
@@ -275,6 +281,13 @@ bool HttpCredentials::refreshAccessTokenInternal(int tokenRefreshRetriesCount)
     connect(_oAuthJob, &AccountBasedOAuth::refreshError, this, [tokenRefreshRetriesCount, this](QNetworkReply::NetworkError error, const QString &) {
         _oAuthJob->deleteLater();
 
+        if (std::exchange(_isRefreshingAhead, false)) {
+            // the current token is still valid, once it expired the next request starts a regular refresh
+            qCWarning(lcHttpCredentials) << "Failed to refresh the token ahead of its expiry:" << error;
+            _tokenRefreshTimer.start(TokenRefreshDefaultTimeout);
+            return;
+        }
+
         auto networkUnavailable = []() {
             if (auto qni = QNetworkInformation::instance()) {
                 if (qni->reachability() == QNetworkInformation::Reachability::Disconnected) {
@@ -328,8 +341,9 @@ bool HttpCredentials::refreshAccessTokenInternal(int tokenRefreshRetriesCount)
         Q_EMIT authenticationFailed();
     });
 
-    connect(_oAuthJob, &AccountBasedOAuth::refreshFinished, this, [this](const QString &accessToken, const QString &refreshToken) {
+    connect(_oAuthJob, &AccountBasedOAuth::refreshFinished, this, [this](const QString &accessToken, const QString &refreshToken, std::chrono::seconds expiresIn) {
         _oAuthJob->deleteLater();
+        const bool refreshedAhead = std::exchange(_isRefreshingAhead, false);
         if (refreshToken.isEmpty()) {
             // an error occured, log out
             forgetSensitiveData();
@@ -342,15 +356,43 @@ bool HttpCredentials::refreshAccessTokenInternal(int tokenRefreshRetriesCount)
             _ready = true;
             _password = accessToken;
             persist();
+            scheduleTokenRefresh(expiresIn);
+        }
+        if (!refreshedAhead) {
+            Q_EMIT fetched();
         }
-        Q_EMIT fetched();
     });
-    Q_EMIT authenticationStarted();
+    if (!_isRefreshingAhead) {
+        Q_EMIT authenticationStarted();
+    }
     _oAuthJob->refreshAuthentication(_refreshToken);
 
     return true;
 }
 
+void HttpCredentials::refreshAccessTokenAhead()
+{
+    if (!_ready || _oAuthJob || _refreshToken.isEmpty()) {
+        return;
+    }
+    qCInfo(lcHttpCredentials) << "Refreshing the token ahead of its expiry";
+    _isRefreshingAhead = true;
+    refreshAccessTokenInternal(0);
+}
+
+void HttpCredentials::scheduleTokenRefresh(std::chrono::seconds expiresIn)
+{
+    if (expiresIn <= 0s) {
+        // without a known lifetime the token is refreshed once a request was rejected
+        _tokenRefreshTimer.stop();
+        return;
+    }
+    // leave a quarter of the lifetime for the refresh and its retries
+    const auto refreshIn = expiresIn * 3 / 4;
+    qCDebug(lcHttpCredentials) << "The token expires in" << expiresIn << "refreshing it in" << refreshIn;
+    _tokenRefreshTimer.start(refreshIn);
+}
+
 void HttpCredentials::invalidateToken()
 {
     qCWarning(lcHttpCredentials) << "Invalidating the credentials";
@@ -360,6 +402,7 @@ void HttpCredentials::invalidateToken()
     }
     _password = QString();
     _ready = false;
+    _tokenRefreshTimer.stop();
 
     // User must be fetched from config file to generate a valid key
     fetchUser();
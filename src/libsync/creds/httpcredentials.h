@@ -24,6 +24,9 @@
 #include <QSslCertificate>
 #include <QSslKey>
 #include <QNetworkRequest>
+#include <QTimer>
+
+#include <chrono>
 
 class QNetworkReply;
 class QAuthenticator;
@@ -93,6 +96,14 @@ protected:
 
 private:
     bool refreshAccessTokenInternal(int tokenRefreshRetriesCount);
+
+    /** Refresh the OAuth token before it expires, requests keep using the current token meanwhile */
+    void refreshAccessTokenAhead();
+    void scheduleTokenRefresh(std::chrono::seconds expiresIn);
+
+    QTimer _tokenRefreshTimer;
+    // the running _oAuthJob was started by refreshAccessTokenAhead(), the job queue is not blocked
+    bool _isRefreshingAhead = false;
 };
 
 
@@ -706,6 +706,7 @@ void AccountBasedOAuth::refreshAuthentication(const QString &refreshToken)
                 const auto data = QJsonDocument::fromJson(jsonData, &jsonParseError).object().toVariantMap();
                 QString accessToken;
                 QString newRefreshToken = refreshToken;
+                std::chrono::seconds expiresIn = {};
                 // https://developer.okta.com/docs/reference/api/oidc/#response-properties-2
                 const QString errorString = data.value(QStringLiteral("error")).toString();
                 if (!errorString.isEmpty()) {
@@ -733,9 +734,11 @@ void AccountBasedOAuth::refreshAuthentication(const QString &refreshToken)
                         if (refresh_token != data.constEnd()) {
                             newRefreshToken = refresh_token.value().toString();
                         }
+                        // optional, https://www.rfc-editor.org/rfc/rfc6749#section-5.1
+                        expiresIn = std::chrono::seconds(data.value(QStringLiteral("expires_in")).toLongLong());
                     }
                 }
-                Q_EMIT refreshFinished(accessToken, newRefreshToken);
+                Q_EMIT refreshFinished(accessToken, newRefreshToken, expiresIn);
             });
         };
 
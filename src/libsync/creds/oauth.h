@@ -21,6 +21,8 @@
 #include <QTcpServer>
 #include <QUrl>
 
+#include <chrono>
+
 
 namespace OCC {
 class JsonJob;
@@ -142,7 +144,8 @@ public:
 
 Q_SIGNALS:
     void refreshError(QNetworkReply::NetworkError error, const QString &errorString);
-    void refreshFinished(const QString &accessToken, const QString &refreshToken);
+    /** \a expiresIn is the lifetime of the new access token, 0 if the server didn't announce it */
+    void refreshFinished(const QString &accessToken, const QString &refreshToken, std::chrono::seconds expiresIn);
 
 protected:
     void fetchWellKnown() override;
@@ -15,7 +15,9 @@
 #include "discovery.h"
 #include "csync.h"
 #include "owncloudpropagator.h"
+#include "stallwatchdog.h"
 #include "syncfileitem.h"
+#include "syncmetrics.h"
 
 #include "csync/csync_exclude.h"
 #include "csync/vio/csync_vio_local.h"
@@ -26,10 +28,17 @@
 #include "libsync/theme.h"
 
 #include <algorithm>
+#include <memory>
 
 #include <QFile>
 #include <QFileInfo>
-#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentMap>
+
+namespace {
+// the entries of a directory from which on they are prepared on all cores, see ProcessDirectoryJob::process()
+constexpr size_t ParallelPreparationThreshold = 1000;
+}
 
 namespace OCC {
 
@@ -37,10 +46,45 @@ Q_LOGGING_CATEGORY(lcDisco, "sync.discovery", QtInfoMsg)
 
 void ProcessDirectoryJob::start()
 {
+    if (!_dirItem && _discoveryData->_syncOptions._syncDirection != SyncOptions::SyncDirection::Bidirectional && !isColdRemoteTree()) {
+        // the side that is not synced is read from the journal, the subdirectories inherit that
+        if (_discoveryData->_syncOptions._syncDirection == SyncOptions::SyncDirection::UploadOnly) {
+            qCInfo(lcDisco) << "Upload only, not listing the remote folders";
+            _queryServer = ParentNotChanged;
+        } else {
+            qCInfo(lcDisco) << "Download only, not listing the local folders";
+            _queryLocal = ParentNotChanged;
+        }
+    }
+
     qCInfo(lcDisco) << "STARTING" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
 
     if (_queryServer == NormalQuery) {
-        _serverJob = startAsyncServerQuery();
+        auto prefetched = _discoveryData->_prefetchedRemoteEntries.find(_currentFolder._server);
+        if (prefetched != _discoveryData->_prefetchedRemoteEntries.end()) {
+            // a listing of the remote changes is only valid for the etag it was reported with
+            const QString etag = _discoveryData->_prefetchedRemoteEtags.take(_currentFolder._server);
+            if (!etag.isNull() && (!_dirItem || _dirItem->_etag != etag)) {
+                qCInfo(lcDisco) << _currentFolder._server << "changed again since its changes were listed";
+                _discoveryData->_prefetchedRemoteEntries.erase(prefetched);
+                prefetched = _discoveryData->_prefetchedRemoteEntries.end();
+            }
+        }
+        if (prefetched != _discoveryData->_prefetchedRemoteEntries.end()) {
+            // listed by the Depth: infinity query of a parent, or with the remote changes
+            _serverNormalQueryEntries = std::move(*prefetched);
+            _discoveryData->_prefetchedRemoteEntries.erase(prefetched);
+            _serverQueryDone = true;
+        } else if (!_dirItem && _discoveryData->useDeltaDiscovery() && !isColdRemoteTree()) {
+            const QByteArray syncToken = _discoveryData->_statedb->syncToken();
+            if (!syncToken.isEmpty()) {
+                startRemoteChangesQuery(syncToken);
+            } else {
+                _serverJob = startAsyncServerQuery();
+            }
+        } else {
+            _serverJob = startAsyncServerQuery();
+        }
     } else {
         _serverQueryDone = true;
     }
@@ -52,10 +96,17 @@ void ProcessDirectoryJob::start()
             _queryLocal = ParentNotChanged;
         }
     }
+    if (_queryLocal == NormalQuery && isLocalFolderUnchanged()) {
+        qCDebug(lcDisco) << "Reading the unchanged local folder from the db" << _currentFolder._local;
+        _queryLocal = ParentNotChanged;
+        _localFolderUnchanged = true;
+    }
 
     if (_queryLocal == NormalQuery) {
         startAsyncLocalQuery();
     } else {
+        // a prefetched listing isn't needed
+        _discoveryData->_localListings.remove(_discoveryData->_localDir + _currentFolder._local);
         _localQueryDone = true;
     }
 
@@ -67,6 +118,11 @@ void ProcessDirectoryJob::start()
 void ProcessDirectoryJob::process()
 {
     OC_ASSERT(_localQueryDone && _serverQueryDone);
+    const StallWatchdog::Activity activity("discovery", _currentFolder._original);
+
+    // The permissions of this directory are the same for all its entries, determine them once.
+    // The server reports them with the listing, without a listing they are the ones from the db.
+    _directoryPermissions = !_rootPermissions.isNull() ? _rootPermissions : _dirItem ? _dirItem->_remotePerm : RemotePermissions{};
 
     // Build lookup tables for local, remote and db entries.
     // For suffix-virtual files, the key will normally be the base file name
@@ -84,7 +140,8 @@ void ProcessDirectoryJob::process()
     for (auto &e : _serverNormalQueryEntries) {
         entries[e.name].serverEntry = std::move(e);
     }
-    _serverNormalQueryEntries.clear();
+    // clear() would keep the capacity for the lifetime of the job
+    _serverNormalQueryEntries = {};
 
     // fetch all the name from the DB
     auto pathU8 = _currentFolder._original.toUtf8();
@@ -132,20 +189,53 @@ void ProcessDirectoryJob::process()
             }
         }
     }
-    _localNormalQueryEntries.clear();
+    if (_discoveryData->_caseClashIndex && (_queryLocal == NormalQuery || _queryLocal == ParentDontExist)) {
+        // all the names the folder may have during the propagation
+        QStringList names;
+        names.reserve(entries.size() + _localNormalQueryEntries.size());
+        for (const auto &f : entries) {
+            names.append(f.first);
+            if (isVfsWithSuffix()) {
+                names.append(f.first);
+                addVirtualFileSuffix(names.last());
+            }
+        }
+        for (const auto &e : _localNormalQueryEntries) {
+            names.append(e.name);
+        }
+        _discoveryData->_caseClashIndex->addFolder(_currentFolder._target, names);
+    }
+    _localNormalQueryEntries = {};
 
     //
-    // Iterate over entries and process them
+    // Prepare the entries: their paths and whether they are excluded don't depend on the other
+    // entries, so large directories prepare them on all cores. Processing them stays in order on
+    // this thread, the items and the move detection depend on what was processed before.
     //
+    struct PreparedEntry
+    {
+        const QString *name;
+        const Entries *entries;
+        PathTuple path;
+        bool isHidden = false;
+        Exclusion exclusion;
+    };
+    std::vector<PreparedEntry> prepared;
+    prepared.reserve(entries.size());
     for (const auto &f : entries) {
-        const auto &e = f.second;
+        prepared.push_back({&f.first, &f.second});
+    }
+    const bool cernBranding = Theme::instance()->enableCernBranding();
+    const auto prepare = [this, cernBranding](PreparedEntry &entry) {
+        const auto &e = *entry.entries;
+        const QString &name = *entry.name;
 
-        PathTuple path;
-        path = _currentFolder.addName(e.nameOverride.isEmpty() ? f.first : e.nameOverride);
+        PathTuple &path = entry.path;
+        path = _currentFolder.addName(e.nameOverride.isEmpty() ? name : e.nameOverride);
 
         if (isVfsWithSuffix()) {
             // Without suffix vfs the paths would be good. But since the dbEntry and localEntry
-            // can have different names from f.first when suffix vfs is on, make sure the
+            // can have different names from the entry name when suffix vfs is on, make sure the
             // corresponding _original and _local paths are right.
 
             if (e.dbEntry.isValid()) {
@@ -166,18 +256,27 @@ void ProcessDirectoryJob::process()
         // For windows, the hidden state is also discovered within the vio
         // local stat function.
         // Recall file shall not be ignored (#4420)
-        const bool isHidden = [&] {
-            if (Q_UNLIKELY(Theme::instance()->enableCernBranding())) {
-                return e.localEntry.isHidden || (f.first[0] == QLatin1Char('.') && f.first != QLatin1String(".sys.admin#recall#"));
-            } else {
-                return e.localEntry.isHidden || f.first[0] == QLatin1Char('.');
-            }
-        }();
-        if (handleExcluded(path._target,
-                e.localEntry.name,
-                e.localEntry.isDirectory || e.serverEntry.isDirectory,
-                isHidden,
-                e.localEntry.isSymLink)) {
+        if (Q_UNLIKELY(cernBranding)) {
+            entry.isHidden = e.localEntry.isHidden || (name[0] == QLatin1Char('.') && name != QLatin1String(".sys.admin#recall#"));
+        } else {
+            entry.isHidden = e.localEntry.isHidden || name[0] == QLatin1Char('.');
+        }
+        entry.exclusion = checkExcluded(path._target, e.localEntry.name, e.localEntry.isDirectory || e.serverEntry.isDirectory, entry.isHidden);
+    };
+    if (prepared.size() >= ParallelPreparationThreshold) {
+        QtConcurrent::blockingMap(prepared, prepare);
+    } else {
+        std::for_each(prepared.begin(), prepared.end(), prepare);
+    }
+
+    //
+    // Iterate over entries and process them
+    //
+    for (auto &entry : prepared) {
+        const auto &e = *entry.entries;
+        auto &path = entry.path;
+
+        if (handleExcluded(path._target, e.localEntry.name, e.localEntry.isSymLink, entry.exclusion)) {
             // the file only exists in the db
             if (!e.localEntry.isValid() && e.dbEntry.isValid()) {
                 qCWarning(lcDisco) << "Removing db entry for non exisitng ignored file:" << path._original;
@@ -192,30 +291,53 @@ void ProcessDirectoryJob::process()
         }
         processFile(std::move(path), e.localEntry, e.serverEntry, e.dbEntry);
     }
+
+    // The subdirectories that are not listed locally by a job don't need their prefetched listings
+    QSet<QString> listedSubdirectories;
+    const auto keepListing = [&](const ProcessDirectoryJob *job) {
+        if (job->_queryLocal == NormalQuery) {
+            listedSubdirectories.insert(_discoveryData->_localDir + job->_currentFolder._local);
+        }
+    };
+    for (const auto *job : _queuedJobs) {
+        keepListing(job);
+    }
+    // the removed directories might still be processed, if they weren't moved
+    const QString originalPrefix = _currentFolder._original.isEmpty() ? QString() : _currentFolder._original + QLatin1Char('/');
+    for (auto it = _discoveryData->_queuedDeletedDirectories.lowerBound(originalPrefix);
+         it != _discoveryData->_queuedDeletedDirectories.cend() && it.key().startsWith(originalPrefix); ++it) {
+        keepListing(it.value());
+    }
+    _discoveryData->dropLocalListings(_discoveryData->_localDir + _currentFolder._local, listedSubdirectories);
+
     QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
 }
 
-bool ProcessDirectoryJob::handleExcluded(const QString &path, const QString &localName, bool isDirectory, bool isHidden, bool isSymlink)
+auto ProcessDirectoryJob::checkExcluded(const QString &path, const QString &localName, bool isDirectory, bool isHidden) const -> Exclusion
 {
-    auto excluded = _discoveryData->_excludes->traversalPatternMatch(path, isDirectory ? ItemTypeDirectory : ItemTypeFile);
+    Exclusion exclusion;
+    exclusion.type = _discoveryData->_excludes->traversalPatternMatch(path, isDirectory ? ItemTypeDirectory : ItemTypeFile);
 
     // FIXME: move to ExcludedFiles 's regexp ?
-    bool isInvalidPattern = false;
-    if (excluded == CSYNC_NOT_EXCLUDED && !_discoveryData->_invalidFilenameRx.pattern().isEmpty()) {
+    if (exclusion.type == CSYNC_NOT_EXCLUDED && !_discoveryData->_invalidFilenameRx.pattern().isEmpty()) {
         if (path.contains(_discoveryData->_invalidFilenameRx)) {
-            excluded = CSYNC_FILE_EXCLUDE_INVALID_CHAR;
-            isInvalidPattern = true;
+            exclusion.type = CSYNC_FILE_EXCLUDE_INVALID_CHAR;
+            exclusion.isInvalidPattern = true;
         }
     }
-    if (excluded == CSYNC_NOT_EXCLUDED && _discoveryData->_ignoreHiddenFiles && isHidden) {
-        excluded = CSYNC_FILE_EXCLUDE_HIDDEN;
+    if (exclusion.type == CSYNC_NOT_EXCLUDED && _discoveryData->_ignoreHiddenFiles && isHidden) {
+        exclusion.type = CSYNC_FILE_EXCLUDE_HIDDEN;
     }
-    if (excluded == CSYNC_NOT_EXCLUDED && !localName.isEmpty()
-            && _discoveryData->_serverBlacklistedFiles.contains(localName)) {
-        excluded = CSYNC_FILE_EXCLUDE_SERVER_BLACKLISTED;
-        isInvalidPattern = true;
+    if (exclusion.type == CSYNC_NOT_EXCLUDED && !localName.isEmpty() && _discoveryData->_serverBlacklistedFiles.contains(localName)) {
+        exclusion.type = CSYNC_FILE_EXCLUDE_SERVER_BLACKLISTED;
+        exclusion.isInvalidPattern = true;
     }
+    return exclusion;
+}
 
+bool ProcessDirectoryJob::handleExcluded(const QString &path, const QString &localName, bool isSymlink, const Exclusion &exclusion)
+{
+    const auto excluded = exclusion.type;
     if (excluded == CSYNC_NOT_EXCLUDED && !isSymlink) {
         return false;
     } else if (excluded == CSYNC_FILE_SILENTLY_EXCLUDED || excluded == CSYNC_FILE_EXCLUDE_AND_REMOVE) {
@@ -262,7 +384,7 @@ bool ProcessDirectoryJob::handleExcluded(const QString &path, const QString &loc
                 if (!unsupportedCharacter.isNull()) {
                     item->_errorString = tr("File names containing the character '%1' are not supported on this file system.")
                                              .arg(unsupportedCharacter);
-                } else if (isInvalidPattern) {
+                } else if (exclusion.isInvalidPattern) {
                     item->_errorString = tr("File name contains at least one invalid character");
                 } else {
                     item->_errorString = tr("The file name is a reserved name on this file system.");
@@ -461,6 +583,11 @@ void ProcessDirectoryJob::processFileAnalyzeRemoteInfo(
             } else if (!localEntry.isValid() && _queryLocal != ParentNotChanged) {
                 // Deleted locally, changed on server
                 item->setInstruction(CSYNC_INSTRUCTION_NEW);
+            } else if (serverEntry.size == dbEntry._fileSize && serverEntry.modtime == dbEntry._modtime && !serverEntry.checksumHeader.isEmpty()
+                && serverEntry.checksumHeader == dbEntry._checksumHeader) {
+                // Only the etag changed, like after a migration of the server storage.
+                // The content is the one we have, the local changes are still checked below.
+                item->setInstruction(CSYNC_INSTRUCTION_UPDATE_METADATA);
             } else {
                 item->setInstruction(CSYNC_INSTRUCTION_SYNC);
             }
@@ -686,10 +813,12 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
         // conflict we don't need to recurse into it. (local c1.owncloud, c1/ ; remote: c1)
         if (item->instruction() == CSYNC_INSTRUCTION_CONFLICT && !item->isDirectory())
             recurse = false;
-        if (_queryLocal != NormalQuery && _queryServer != NormalQuery)
+        if (_queryLocal != NormalQuery && _queryServer != NormalQuery && !_localFolderUnchanged)
             recurse = false;
 
-        auto recurseQueryLocal = _queryLocal == ParentNotChanged                        ? ParentNotChanged
+        // the fingerprint of a folder doesn't tell whether its subdirectories changed, they check their own
+        auto recurseQueryLocal = _localFolderUnchanged                                  ? NormalQuery
+            : _queryLocal == ParentNotChanged                                           ? ParentNotChanged
             : localEntry.isDirectory || item->instruction() == CSYNC_INSTRUCTION_RENAME ? NormalQuery
                                                                                         : ParentDontExist;
         processFileFinalize(item, path, recurse, recurseQueryLocal, recurseQueryServer);
@@ -1207,8 +1336,7 @@ bool ProcessDirectoryJob::checkPermissions(const OCC::SyncFileItemPtr &item)
     switch (item->instruction()) {
     case CSYNC_INSTRUCTION_TYPE_CHANGE:
     case CSYNC_INSTRUCTION_NEW: {
-        const auto perms = !_rootPermissions.isNull() ? _rootPermissions
-                                                      : _dirItem ? _dirItem->_remotePerm : _rootPermissions;
+        const auto &perms = _directoryPermissions;
         if (perms.isNull()) {
             // No permissions set
             return true;
@@ -1286,8 +1414,7 @@ auto ProcessDirectoryJob::checkMovePermissions(RemotePermissions srcPerm, const
                                                bool isDirectory)
     -> MovePermissionResult
 {
-    auto destPerms = !_rootPermissions.isNull() ? _rootPermissions
-                                                : _dirItem ? _dirItem->_remotePerm : _rootPermissions;
+    const auto &destPerms = _directoryPermissions;
     auto filePerms = srcPerm;
     //true when it is just a rename in the same directory. (not a move)
     bool isRename = srcPath.startsWith(_currentFolder._original)
@@ -1325,8 +1452,16 @@ void ProcessDirectoryJob::subJobFinished()
     _childIgnored |= job->_childIgnored;
     _childModified |= job->_childModified;
 
-    if (job->_dirItem)
+    // whatever is left below the directory belongs to skipped or failed subdirectories
+    _discoveryData->dropPrefetchedRemoteEntries(job->_currentFolder._server);
+
+    if (job->_dirItem) {
         Q_EMIT _discoveryData->itemDiscovered(job->_dirItem);
+        if (!_dirItem) {
+            // we are the root job
+            Q_EMIT _discoveryData->subtreeDiscovered(job->_dirItem->_file);
+        }
+    }
 
     int count = _runningJobs.removeAll(job);
     OC_ASSERT(count == 1);
@@ -1334,6 +1469,17 @@ void ProcessDirectoryJob::subJobFinished()
     QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
 }
 
+int ProcessDirectoryJob::expectedListingCost()
+{
+    if (_expectedListingCost < 0) {
+        _expectedListingCost = 0;
+        if (_queryServer == NormalQuery && _dirItem && _dirItem->instruction() != CSYNC_INSTRUCTION_NEW) {
+            _expectedListingCost = qMax(0, _discoveryData->_statedb->countFilesInPath(_currentFolder._original.toUtf8()));
+        }
+    }
+    return _expectedListingCost;
+}
+
 int ProcessDirectoryJob::processSubJobs(int nbJobs)
 {
     if (_queuedJobs.empty() && _runningJobs.empty() && _pendingAsyncJobs == 0) {
@@ -1368,8 +1514,12 @@ int ProcessDirectoryJob::processSubJobs(int nbJobs)
     }
 
     while (started < nbJobs && !_queuedJobs.empty()) {
-        auto f = _queuedJobs.front();
-        _queuedJobs.pop_front();
+        // The largest listings are on the critical path of the discovery, start them first.
+        // Of the same cost, the first queued one is taken so the order is kept without a journal.
+        const auto it = std::max_element(_queuedJobs.begin(), _queuedJobs.end(),
+            [](ProcessDirectoryJob *a, ProcessDirectoryJob *b) { return a->expectedListingCost() < b->expectedListingCost(); });
+        auto f = *it;
+        _queuedJobs.erase(it);
         _runningJobs.push_back(f);
         f->start();
         started++;
@@ -1403,28 +1553,92 @@ QString ProcessDirectoryJob::chopVirtualFileSuffix(const QString &str) const
     return _discoveryData->_syncOptions._vfs->underlyingFileName(str);
 }
 
+bool ProcessDirectoryJob::isColdRemoteTree() const
+{
+    if (_dirItem) {
+        // a new directory on the server has no journal entries below it
+        return _dirItem->instruction() == CSYNC_INSTRUCTION_NEW && _dirItem->_direction == SyncFileItem::Down;
+    }
+    bool hasRecords = false;
+    _discoveryData->_statedb->listFilesInPath({}, [&hasRecords](const SyncJournalFileRecord &) { hasRecords = true; });
+    return !hasRecords;
+}
+
+void ProcessDirectoryJob::startRemoteChangesQuery(const QByteArray &syncToken)
+{
+    auto changesJob = new DiscoveryRemoteChangesJob(_discoveryData, syncToken, this);
+    _discoveryData->_currentlyActiveJobs++;
+    _pendingAsyncJobs++;
+    connect(changesJob, &DiscoveryRemoteChangesJob::finished, this, [this, changesJob](const auto &results) {
+        _discoveryData->_currentlyActiveJobs--;
+        _pendingAsyncJobs--;
+        if (_discoveryData->_metrics) {
+            _discoveryData->_metrics->addRequest(QByteArrayLiteral("REPORT"), changesJob->duration(), 0, 0);
+        }
+        if (results) {
+            qCInfo(lcDisco) << "Listed" << results->size() << "changed directories with a single request";
+            for (auto it = results->cbegin(); it != results->cend(); ++it) {
+                _discoveryData->_prefetchedRemoteEntries.insert(it.key(), it->entries);
+                _discoveryData->_prefetchedRemoteEtags.insert(it.key(), it->etag);
+            }
+            _discoveryData->_syncToken = changesJob->syncToken();
+        } else {
+            // e.g. the token expired, the changed directories are found by their etags
+            qCWarning(lcDisco) << "Listing the remote changes failed, falling back to listing each changed directory" << results.error().code
+                               << results.error().message;
+        }
+        _serverJob = startAsyncServerQuery();
+    });
+    changesJob->start();
+}
+
 DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
 {
     auto serverJob = new DiscoverySingleDirectoryJob(_discoveryData->_account, _discoveryData->_baseUrl,
         _discoveryData->_remoteFolder + _currentFolder._server, this);
     if (!_dirItem)
         serverJob->setIsRootPath(); // query the fingerprint on the root
+    if (_discoveryData->useDepthInfinity() && isColdRemoteTree())
+        serverJob->setDepthInfinity();
     connect(serverJob, &DiscoverySingleDirectoryJob::etag, this, &ProcessDirectoryJob::etag);
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
     connect(serverJob, &DiscoverySingleDirectoryJob::finished, this, [this, serverJob](const auto &results) {
         _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
+        if (_discoveryData->_metrics) {
+            _discoveryData->_metrics->addRequest(QByteArrayLiteral("PROPFIND"), serverJob->duration(), 0, 0);
+            _discoveryData->_metrics->addBufferedBytes(serverJob->maximumBufferedBytes());
+        }
         if (results) {
             _serverNormalQueryEntries = *results;
             _serverQueryDone = true;
+            if (serverJob->isDepthInfinity()) {
+                auto &subtree = serverJob->subtreeResults();
+                qCInfo(lcDisco) << "Listed" << subtree.size() << "subdirectories of" << _currentFolder._server << "with a single request";
+                for (auto it = subtree.begin(); it != subtree.end(); ++it) {
+                    _discoveryData->_prefetchedRemoteEntries.insert(PathTuple::pathAppend(_currentFolder._server, it.key()), std::move(it.value()));
+                }
+            }
             if (!serverJob->_dataFingerprint.isEmpty() && _discoveryData->_dataFingerprint.isEmpty())
                 _discoveryData->_dataFingerprint = serverJob->_dataFingerprint;
+            // the token of a listing of the changes stays, the changes after it are listed next time
+            if (!serverJob->_syncToken.isEmpty() && _discoveryData->_syncToken.isEmpty())
+                _discoveryData->_syncToken = serverJob->_syncToken;
+            if (serverJob->_quota && !_discoveryData->_rootQuota)
+                _discoveryData->_rootQuota = serverJob->_quota;
             if (_localQueryDone)
                 this->process();
         } else {
             auto code = results.error().code;
             qCWarning(lcDisco) << "Server error in directory" << _currentFolder._server << code;
+            if (serverJob->isDepthInfinity()) {
+                // Servers may refuse or time out on large deep listings, list the folders one by one instead
+                qCWarning(lcDisco) << "Depth: infinity PROPFIND failed, falling back to listing each directory";
+                _discoveryData->_depthInfinityFailed = true;
+                _serverJob = startAsyncServerQuery();
+                return;
+            }
             if (serverJob->isRootPath()) {
                 if (code == 404 && _discoveryData->isSpace()) {
                     Q_EMIT _discoveryData->fatalError(tr("This Space is currently unavailable"));
@@ -1460,57 +1674,82 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
 
 void ProcessDirectoryJob::startAsyncLocalQuery()
 {
-    QString localPath = _discoveryData->_localDir + _currentFolder._local;
-    auto localJob = new DiscoverySingleLocalDirectoryJob(_discoveryData->_account, localPath, _discoveryData->_syncOptions._vfs.data());
+    const QString localPath = _discoveryData->_localDir + _currentFolder._local;
 
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
 
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::itemDiscovered, _discoveryData, &DiscoveryPhase::itemDiscovered);
-
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::childIgnored, this, [this](bool b) {
-        _childIgnored = b;
+    // The listing might have been prefetched already, it is still delivered asynchronously
+    _discoveryData->startLocalListing(localPath);
+    if (_discoveryData->_localListings.value(localPath).state != DiscoveryPhase::LocalListing::State::Running) {
+        QTimer::singleShot(0, this, [this, localPath] { localQueryFinished(localPath); });
+        return;
+    }
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    *connection = connect(_discoveryData, &DiscoveryPhase::localListingFinished, this, [this, localPath, connection](const QString &path) {
+        if (path == localPath) {
+            disconnect(*connection);
+            localQueryFinished(localPath);
+        }
     });
+}
 
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedFatalError, this, [this](const QString &msg) {
-        _discoveryData->_currentlyActiveJobs--;
-        _pendingAsyncJobs--;
+void ProcessDirectoryJob::localQueryFinished(const QString &localPath)
+{
+    const auto listing = _discoveryData->_localListings.take(localPath);
+    _discoveryData->_currentlyActiveJobs--;
+    _pendingAsyncJobs--;
+
+    switch (listing.state) {
+    case DiscoveryPhase::LocalListing::State::FatalError:
         if (_serverJob)
             _serverJob->abort();
 
-        Q_EMIT _discoveryData->fatalError(msg);
-    });
-
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedNonFatalError, this, [this](const QString &msg) {
-        _discoveryData->_currentlyActiveJobs--;
-        _pendingAsyncJobs--;
-
+        Q_EMIT _discoveryData->fatalError(listing.errorString);
+        break;
+    case DiscoveryPhase::LocalListing::State::NonFatalError:
         if (_dirItem) {
             _dirItem->setInstruction(CSYNC_INSTRUCTION_IGNORE);
-            _dirItem->_errorString = msg;
+            _dirItem->_errorString = listing.errorString;
             Q_EMIT this->finished();
         } else {
             // Fatal for the root job since it has no SyncFileItem
-            Q_EMIT _discoveryData->fatalError(msg);
+            Q_EMIT _discoveryData->fatalError(listing.errorString);
         }
-    });
-
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this](const auto &results) {
-        _discoveryData->_currentlyActiveJobs--;
-        _pendingAsyncJobs--;
-
-        _localNormalQueryEntries = results;
+        break;
+    case DiscoveryPhase::LocalListing::State::Finished:
+        _localNormalQueryEntries = listing.entries;
         _localQueryDone = true;
+        if (_discoveryData->_syncOptions._skipUnchangedLocalFolders && listing.fingerprint && _currentFolder._local == _currentFolder._original) {
+            _discoveryData->_listedLocalFolderFingerprints.insert(_currentFolder._original, *listing.fingerprint);
+        }
 
         if (_serverQueryDone)
             this->process();
-    });
-
-    QThreadPool *pool = QThreadPool::globalInstance();
-    pool->start(localJob); // QThreadPool takes ownership
+        break;
+    case DiscoveryPhase::LocalListing::State::Running:
+        Q_UNREACHABLE();
+    }
 }
 
 
+bool ProcessDirectoryJob::isLocalFolderUnchanged() const
+{
+    if (!_dirItem || _queryServer != ParentNotChanged || _currentFolder._local != _currentFolder._original) {
+        return false;
+    }
+    const auto it = _discoveryData->_unchangedLocalFolderFingerprints.constFind(_currentFolder._original);
+    if (it == _discoveryData->_unchangedLocalFolderFingerprints.cend()) {
+        return false;
+    }
+    // one stat instead of a listing
+    csync_file_stat_t dirStat;
+    if (csync_vio_local_stat(_discoveryData->_localDir + _currentFolder._local, &dirStat) != 0) {
+        return false;
+    }
+    return SyncJournalDb::LocalFolderFingerprint{dirStat.modtime, dirStat.inode} == *it;
+}
+
 bool ProcessDirectoryJob::isVfsWithSuffix() const
 {
     return _discoveryData->_syncOptions._vfs->mode() == Vfs::WithSuffix;
@@ -19,6 +19,7 @@
 #include "syncfileitem.h"
 #include "common/asserts.h"
 #include "common/syncjournaldb.h"
+#include "csync/csync_exclude.h"
 
 class ExcludedFiles;
 
@@ -138,10 +139,28 @@ private:
      */
     void process();
 
-    // return true if the file is excluded.
-    // path is the full relative path of the file. localName is the base name of the local entry.
-    bool handleExcluded(const QString &path, const QString &localName, bool isDirectory,
-        bool isHidden, bool isSymlink);
+    /** The number of entries the server listing of this directory is expected to have
+     *
+     * Estimated from the children in the journal, 0 when the server is not queried.
+     * Used by processSubJobs() to start the largest listings first.
+     */
+    int expectedListingCost();
+
+    struct Exclusion
+    {
+        CSYNC_EXCLUDE_TYPE type = CSYNC_NOT_EXCLUDED;
+        bool isInvalidPattern = false;
+    };
+
+    /** Whether an entry is excluded
+     *
+     * path is the full relative path of the file. localName is the base name of the local entry.
+     * Only reads the options of the discovery, so it can be called from several threads at once.
+     */
+    Exclusion checkExcluded(const QString &path, const QString &localName, bool isDirectory, bool isHidden) const;
+
+    // return true if the file is excluded, reports it unless it is silently excluded.
+    bool handleExcluded(const QString &path, const QString &localName, bool isSymlink, const Exclusion &exclusion);
 
     /** Reconcile local/remote/db information for a single item.
      *
@@ -200,17 +219,35 @@ private:
     /** Convenience to detect suffix-vfs modes */
     bool isVfsWithSuffix() const;
 
+    /** Whether the local directory can be read from the db
+     *
+     * That is the case if it is unchanged on the server and its local fingerprint
+     * matches the one of its last listing, see LocalDiscoveryStyle::FilesystemUnlessUnchanged.
+     */
+    bool isLocalFolderUnchanged() const;
+
     /** Start a remote discovery network job
      *
      * It fills _serverNormalQueryEntries and sets _serverQueryDone when done.
      */
     DiscoverySingleDirectoryJob *startAsyncServerQuery();
 
+    /** List the remote directories that changed since \a syncToken
+     *
+     * Their listings are added to DiscoveryPhase::_prefetchedRemoteEntries, the
+     * root directory is listed with startAsyncServerQuery() once that is done.
+     */
+    void startRemoteChangesQuery(const QByteArray &syncToken);
+
+    /** Whether there are no journal entries for this directory and below */
+    bool isColdRemoteTree() const;
+
     /** Discover the local directory
       *
       * Fills _localNormalQueryEntries.
       */
     void startAsyncLocalQuery();
+    void localQueryFinished(const QString &localPath);
 
 
     /** Sets _pinState, the directory's pin state
@@ -234,6 +271,8 @@ private:
 
     QueryMode _queryServer = QueryMode::NormalQuery;
     QueryMode _queryLocal = QueryMode::NormalQuery;
+    // _queryLocal is ParentNotChanged because of isLocalFolderUnchanged(), the subdirectories are still listed
+    bool _localFolderUnchanged = false;
 
     // Holds entries that resulted from a NormalQuery
     QVector<RemoteInfo> _serverNormalQueryEntries;
@@ -245,6 +284,8 @@ private:
     bool _localQueryDone = false;
 
     RemotePermissions _rootPermissions;
+    // The permissions new entries of this directory are checked against, set in process()
+    RemotePermissions _directoryPermissions;
     QPointer<DiscoverySingleDirectoryJob> _serverJob;
 
 
@@ -273,6 +314,7 @@ private:
     bool _childModified = false; // the directory contains modified item what would prevent deletion
     bool _childIgnored = false; // The directory contains ignored item that would prevent deletion
     PinState _pinState = PinState::Unspecified; // The directory's pin-state, see computePinState()
+    int _expectedListingCost = -1; // Cache of expectedListingCost()
 
 Q_SIGNALS:
     void finished();
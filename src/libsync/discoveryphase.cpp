@@ -18,6 +18,9 @@
 #include "account.h"
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "common/syncjournaldb.h"
+#include "common/vfs.h"
+#include "syncmetrics.h"
 
 #include "vio/csync_vio_local.h"
 
@@ -25,6 +28,7 @@
 #include <QFile>
 #include <QLoggingCategory>
 #include <QUrl>
+#include <algorithm>
 #include <cstring>
 
 
@@ -32,25 +36,21 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcDiscovery, "sync.discovery", QtInfoMsg)
 
-/* Given a sorted list of paths ending with '/', return whether or not the given path is within one of the paths of the list*/
-static bool findPathInList(const std::set<QString> &list, const QString &path)
+/* Given a sorted list of paths ending with '/' without nested paths, return whether or not the given path is within one of the paths of the list*/
+static bool findPathInList(const std::vector<QString> &list, const QString &path)
 {
-    if (list.size() == 1 && *list.cbegin() == QLatin1String("/")) {
+    if (list.size() == 1 && list.front() == QLatin1String("/")) {
         // Special case for the case "/" is there, it matches everything
         return true;
     }
 
-    QString pathSlash = path + QLatin1Char('/');
+    const QString pathSlash = path + QLatin1Char('/');
 
     // Since the list is sorted, we can do a binary search.
-    // If the path is a prefix of another item or right after in the lexical order.
-    auto it = std::lower_bound(list.begin(), list.end(), pathSlash);
-
-    if (it != list.end() && *it == pathSlash) {
-        return true;
-    }
-
-    if (it == list.begin()) {
+    // An item that is a prefix of the path is the last item that is not after it,
+    // there is no other item in between as the list has no nested paths.
+    auto it = std::upper_bound(list.cbegin(), list.cend(), pathSlash);
+    if (it == list.cbegin()) {
         return false;
     }
     --it;
@@ -58,6 +58,25 @@ static bool findPathInList(const std::set<QString> &list, const QString &path)
     return pathSlash.startsWith(*it);
 }
 
+/* Sorts the paths of \a list and drops the ones that are within an other path of the list */
+static std::vector<QString> prefixFreeList(const QSet<QString> &list)
+{
+    if (list.contains(QStringLiteral("/"))) {
+        return {QStringLiteral("/")};
+    }
+    std::vector<QString> sorted(list.cbegin(), list.cend());
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<QString> out;
+    out.reserve(sorted.size());
+    for (auto &path : sorted) {
+        // a path within an other path of the list is sorted right after it or after other paths within it
+        if (out.empty() || !path.startsWith(out.back())) {
+            out.push_back(std::move(path));
+        }
+    }
+    return out;
+}
+
 bool DiscoveryPhase::isInSelectiveSyncBlackList(const QString &path) const
 {
     if (_selectiveSyncBlackList.empty()) {
@@ -142,6 +161,23 @@ QPair<bool, QString> DiscoveryPhase::findAndCancelDeletedJob(const QString &orig
     return { result, oldEtag };
 }
 
+DiscoveryPhase::DiscoveryPhase(const AccountPtr &account, const SyncOptions &options, const QUrl &baseUrl, QObject *parent)
+    : QObject(parent)
+    , _account(account)
+    , _syncOptions(options)
+    , _baseUrl(baseUrl)
+{
+    _localDiscoveryPool.setObjectName(QStringLiteral("Local discovery"));
+    _localDiscoveryPool.setMaxThreadCount(_syncOptions.localDiscoveryThreads());
+}
+
+DiscoveryPhase::~DiscoveryPhase()
+{
+    // the running listings don't access this object, but they must not outlive the options
+    _localDiscoveryPool.clear();
+    _localDiscoveryPool.waitForDone();
+}
+
 void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
 {
     OC_ENFORCE(!_currentRootJob);
@@ -158,6 +194,9 @@ void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
             auto nextJob = _queuedDeletedDirectories.take(_queuedDeletedDirectories.firstKey());
             startJob(nextJob);
         } else {
+            // the listings of skipped directories are not needed anymore
+            _prefetchedRemoteEntries.clear();
+            _prefetchedRemoteEtags.clear();
             Q_EMIT finished();
         }
     });
@@ -167,22 +206,128 @@ void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
 
 void DiscoveryPhase::setSelectiveSyncBlackList(const QSet<QString> &list)
 {
-    _selectiveSyncBlackList = {list.cbegin(), list.cend()};
+    _selectiveSyncBlackList = prefixFreeList(list);
 }
 
 void DiscoveryPhase::setSelectiveSyncWhiteList(const QSet<QString> &list)
 {
-    _selectiveSyncWhiteList = {list.cbegin(), list.cend()};
+    _selectiveSyncWhiteList = prefixFreeList(list);
+}
+
+void DiscoveryPhase::dropPrefetchedRemoteEntries(const QString &path)
+{
+    if (path.isEmpty()) {
+        _prefetchedRemoteEntries.clear();
+        _prefetchedRemoteEtags.clear();
+        return;
+    }
+    const auto dropSubtree = [&path](auto &map) {
+        map.remove(path);
+        const QString prefix = path + QLatin1Char('/');
+        auto it = map.lowerBound(prefix);
+        while (it != map.end() && it.key().startsWith(prefix)) {
+            it = map.erase(it);
+        }
+    };
+    dropSubtree(_prefetchedRemoteEntries);
+    dropSubtree(_prefetchedRemoteEtags);
 }
 
 void DiscoveryPhase::scheduleMoreJobs()
 {
-    auto limit = qMax(1, _syncOptions._parallelNetworkJobs);
+    auto limit = qMax(1, _syncOptions._parallelDiscoveryJobs);
     if (_currentRootJob && _currentlyActiveJobs < limit) {
         _currentRootJob->processSubJobs(limit - _currentlyActiveJobs);
     }
 }
 
+void DiscoveryPhase::startLocalListing(const QString &localPath)
+{
+    if (_localListings.contains(localPath)) {
+        return;
+    }
+    _localListings.insert(localPath, {});
+
+    auto job = new DiscoverySingleLocalDirectoryJob(_account, localPath, _syncOptions._vfs.data());
+    auto finish = [this, localPath, timer = Utility::ChronoElapsedTimer()](LocalListing::State state, QVector<LocalInfo> entries, const QString &errorString,
+                      std::optional<SyncJournalDb::LocalFolderFingerprint> fingerprint = {}) {
+        auto it = _localListings.find(localPath);
+        if (it == _localListings.end()) {
+            return;
+        }
+        if (_metrics) {
+            _metrics->addLocalListing(timer.duration());
+        }
+        it->state = state;
+        it->entries = std::move(entries);
+        it->errorString = errorString;
+        it->fingerprint = fingerprint;
+        if (state == LocalListing::State::Finished) {
+            prefetchLocalSubdirectories(localPath, it->entries);
+        }
+        Q_EMIT localListingFinished(localPath);
+    };
+    connect(job, &DiscoverySingleLocalDirectoryJob::finished, this,
+        [finish](const QVector<LocalInfo> &entries, const std::optional<SyncJournalDb::LocalFolderFingerprint> &fingerprint) {
+            finish(LocalListing::State::Finished, entries, {}, fingerprint);
+        });
+    connect(job, &DiscoverySingleLocalDirectoryJob::finishedNonFatalError, this,
+        [finish](const QString &errorString) { finish(LocalListing::State::NonFatalError, {}, errorString); });
+    connect(job, &DiscoverySingleLocalDirectoryJob::finishedFatalError, this,
+        [finish](const QString &errorString) { finish(LocalListing::State::FatalError, {}, errorString); });
+    _localDiscoveryPool.start(job); // QThreadPool takes ownership
+}
+
+void DiscoveryPhase::dropLocalListings(const QString &localPath, const QSet<QString> &kept)
+{
+    const QString prefix = localPath.endsWith(QLatin1Char('/')) ? localPath : localPath + QLatin1Char('/');
+    for (auto it = _localListings.begin(); it != _localListings.end();) {
+        const QString &path = it.key();
+        // the listings below a dropped subdirectory are never taken either
+        if (path.startsWith(prefix) && !kept.contains(path.left(path.indexOf(QLatin1Char('/'), prefix.size())))) {
+            it = _localListings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DiscoveryPhase::prefetchLocalSubdirectories(const QString &localPath, const QVector<LocalInfo> &entries)
+{
+    // Enough to keep the pool busy, without holding many listings nobody asked for yet
+    const int maximumListings = 4 * _localDiscoveryPool.maxThreadCount();
+    const QString relativePath = localPath.mid(_localDir.size());
+    for (const auto &entry : entries) {
+        if (_localListings.size() >= maximumListings) {
+            return;
+        }
+        if (!entry.isDirectory || entry.isSymLink) {
+            continue;
+        }
+        const QString childRelativePath = relativePath.isEmpty() ? entry.name : relativePath + QLatin1Char('/') + entry.name;
+        if (!_shouldDiscoverLocaly(childRelativePath) || _excludes->isExcluded(_localDir + childRelativePath, _localDir, _ignoreHiddenFiles)) {
+            continue;
+        }
+        if (_unchangedLocalFolderFingerprints.contains(childRelativePath)) {
+            // likely read from the db, see ProcessDirectoryJob::isLocalFolderUnchanged()
+            continue;
+        }
+        startLocalListing(_localDir + childRelativePath);
+    }
+}
+
+bool DiscoveryPhase::useDepthInfinity() const
+{
+    // the listing of the whole subtree stays in memory until its directories are processed
+    return _syncOptions._deepRemoteDiscovery && !_syncOptions._boundedMemoryDiscovery && !_depthInfinityFailed
+        && _account->capabilities().propfindDepthInfinity();
+}
+
+bool DiscoveryPhase::useDeltaDiscovery() const
+{
+    return _syncOptions._deltaRemoteDiscovery && _account->capabilities().syncCollectionReport();
+}
+
 bool DiscoveryPhase::isSpace() const
 {
     return !(Utility::urlEqual(_account->davUrl(), _baseUrl) || _account->davUrl().isParentOf(_baseUrl));
@@ -196,6 +341,7 @@ DiscoverySingleLocalDirectoryJob::DiscoverySingleLocalDirectoryJob(const Account
     , _vfs(vfs)
 {
     qRegisterMetaType<QVector<LocalInfo> >("QVector<LocalInfo>");
+    qRegisterMetaType<std::optional<SyncJournalDb::LocalFolderFingerprint>>();
 }
 
 // Use as QRunnable
@@ -204,6 +350,14 @@ void DiscoverySingleLocalDirectoryJob::run() {
     if (localPath.endsWith(QLatin1Char('/'))) // Happens if _currentFolder._local.isEmpty()
         localPath.chop(1);
 
+    // Taken before the listing, so a change during the listing shows up as a changed fingerprint.
+    // The modification time has a resolution of seconds, a recent one might hide a later change.
+    std::optional<SyncJournalDb::LocalFolderFingerprint> fingerprint;
+    csync_file_stat_t dirStat;
+    if (csync_vio_local_stat(localPath, &dirStat) == 0 && QDateTime::currentSecsSinceEpoch() - dirStat.modtime > 1) {
+        fingerprint = SyncJournalDb::LocalFolderFingerprint{dirStat.modtime, dirStat.inode};
+    }
+
     auto dh = csync_vio_local_opendir(localPath);
     if (!dh) {
         qCCritical(lcDiscovery) << "Error while opening directory" << (localPath) << errno;
@@ -223,27 +377,26 @@ void DiscoverySingleLocalDirectoryJob::run() {
         return;
     }
 
+    std::vector<csync_file_stat_t> dirents;
+    const bool readOk = csync_vio_local_readdir_all(dh, _vfs, &dirents);
     QVector<LocalInfo> results;
-    while (true) {
-        errno = 0;
-        auto dirent = csync_vio_local_readdir(dh, _vfs);
-        if (!dirent)
-            break;
-        if (dirent->type == ItemTypeSkip)
+    results.reserve(static_cast<int>(dirents.size()));
+    for (auto &dirent : dirents) {
+        if (dirent.type == ItemTypeSkip)
             continue;
         LocalInfo i;
-        i.name = dirent->path;
-        i.modtime = dirent->modtime;
-        i.size = dirent->size;
-        i.inode = dirent->inode;
-        i.isDirectory = dirent->type == ItemTypeDirectory;
-        i.isHidden = dirent->is_hidden;
-        i.isSymLink = dirent->type == ItemTypeSoftLink;
-        i.isVirtualFile = dirent->type == ItemTypeVirtualFile || dirent->type == ItemTypeVirtualFileDownload;
-        i.type = dirent->type;
-        results.push_back(i);
+        i.name = std::move(dirent.path);
+        i.modtime = dirent.modtime;
+        i.size = dirent.size;
+        i.inode = dirent.inode;
+        i.isDirectory = dirent.type == ItemTypeDirectory;
+        i.isHidden = dirent.is_hidden;
+        i.isSymLink = dirent.type == ItemTypeSoftLink;
+        i.isVirtualFile = dirent.type == ItemTypeVirtualFile || dirent.type == ItemTypeVirtualFileDownload;
+        i.type = dirent.type;
+        results.push_back(std::move(i));
     }
-    if (errno != 0) {
+    if (!readOk) {
         csync_vio_local_closedir(dh);
 
         // Note: Windows vio converts any error into EACCES
@@ -258,7 +411,23 @@ void DiscoverySingleLocalDirectoryJob::run() {
         qCWarning(lcDiscovery) << "closedir failed for file in " << localPath << " - errno: " << errno;
     }
 
-    Q_EMIT finished(results);
+    Q_EMIT finished(results, fingerprint);
+}
+
+static QList<QByteArray> listingProperties()
+{
+    return {
+        "resourcetype",
+        "getlastmodified",
+        "getcontentlength",
+        "getetag",
+        "http://owncloud.org/ns:id",
+        "http://owncloud.org/ns:downloadURL",
+        "http://owncloud.org/ns:dDC",
+        "http://owncloud.org/ns:permissions",
+        "http://owncloud.org/ns:checksums",
+        "http://owncloud.org/ns:share-types"
+    };
 }
 
 DiscoverySingleDirectoryJob::DiscoverySingleDirectoryJob(const AccountPtr &account, const QUrl &baseUrl, const QString &path, QObject *parent)
@@ -275,29 +444,31 @@ DiscoverySingleDirectoryJob::DiscoverySingleDirectoryJob(const AccountPtr &accou
 void DiscoverySingleDirectoryJob::start()
 {
     // Start the actual HTTP job
-    _proFindJob = new PropfindJob(_account, _baseUrl, _subPath, PropfindJob::Depth::One, this);
+    _proFindJob = new PropfindJob(_account, _baseUrl, _subPath, _depthInfinity ? PropfindJob::Depth::Infinity : PropfindJob::Depth::One, this);
+    _proFindJob->setRequestClass(JobQueue::RequestClass::Discovery);
 
-    QList<QByteArray> props {
-        "resourcetype",
-        "getlastmodified",
-        "getcontentlength",
-        "getetag",
-        "http://owncloud.org/ns:id",
-        "http://owncloud.org/ns:downloadURL",
-        "http://owncloud.org/ns:dDC",
-        "http://owncloud.org/ns:permissions",
-        "http://owncloud.org/ns:checksums",
-        "http://owncloud.org/ns:share-types"
-    };
+    QList<QByteArray> props = listingProperties();
+    if (!_depthInfinity) {
+        // for the folder sizes of the account's RemoteListingCache
+        props << "http://owncloud.org/ns:size";
+    }
     if (_isRootPath) {
         props << "http://owncloud.org/ns:data-fingerprint";
+        if (_account->capabilities().syncCollectionReport()) {
+            props << "sync-token";
+        }
+        // the quota of the spaces is part of their drive
+        if (!_account->capabilities().spacesSupport().enabled) {
+            props << "quota-available-bytes"
+                  << "quota-used-bytes";
+        }
     }
 
 
     _proFindJob->setProperties(props);
 
-    QObject::connect(_proFindJob, &PropfindJob::directoryListingIterated,
-        this, &DiscoverySingleDirectoryJob::directoryListingIteratedSlot);
+    _proFindJob->setDecodeEntries(true);
+    QObject::connect(_proFindJob, &PropfindJob::directoryListingEntry, this, &DiscoverySingleDirectoryJob::directoryListingEntrySlot);
     QObject::connect(_proFindJob, &PropfindJob::finishedWithError, this, [this] {
         QString msg = _proFindJob->errorString();
         if (_proFindJob->reply()->error() == QNetworkReply::NoError
@@ -364,55 +535,116 @@ static void propertyMapToRemoteInfo(const QMap<QString, QString> &map, RemoteInf
     }
 }
 
-void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &file, const QMap<QString, QString> &map)
+static void listingEntryToRemoteInfo(const ListingEntry &entry, RemoteInfo &result)
+{
+    result.directDownloadUrl = entry.directDownloadUrl;
+    result.directDownloadCookies = entry.directDownloadCookies;
+    result.isDirectory = entry.isDirectory;
+    result.modtime = entry.modtime;
+    if (entry.size >= 0) {
+        result.size = entry.size;
+    }
+    result.etag = entry.etag;
+    result.fileId = entry.fileId;
+    result.checksumHeader = entry.checksumHeader;
+    result.remotePerm = entry.remotePerm;
+    if (entry.isShared) {
+        if (!entry.hasPermissions) {
+            qWarning() << "Server returned a share type, but no permissions?";
+            // Empty permissions will cause a sync failure
+        } else {
+            // S means shared with me.
+            // But for our purpose, we want to know if the file is shared. It does not matter
+            // if we are the owner or not.
+            // Piggy back on the persmission field
+            result.remotePerm.setPermission(RemotePermissions::IsShared);
+        }
+    }
+}
+
+void DiscoverySingleDirectoryJob::directoryListingEntrySlot(const QString &file, const ListingEntry &entry)
 {
     if (!_ignoredFirst) {
         // The first entry is for the folder itself, we should process it differently.
         _ignoredFirst = true;
-        if (auto it = Utility::optionalFind(map, QStringLiteral("permissions"))) {
-            auto perm = RemotePermissions::fromServerString(it->value());
-            Q_EMIT firstDirectoryPermissions(perm);
-            _isExternalStorage = perm.hasPermission(RemotePermissions::IsMounted);
+        _firstHref = file;
+        if (entry.hasPermissions) {
+            Q_EMIT firstDirectoryPermissions(entry.remotePerm);
+            _isExternalStorage = entry.remotePerm.hasPermission(RemotePermissions::IsMounted);
         }
-        if (auto it = Utility::optionalFind(map, QStringLiteral("data-fingerprint"))) {
-            _dataFingerprint = it->value().toUtf8();
+        if (entry.hasDataFingerprint) {
+            _dataFingerprint = entry.dataFingerprint;
             if (_dataFingerprint.isEmpty()) {
                 // Placeholder that means that the server supports the feature even if it did not set one.
                 _dataFingerprint = "[empty]";
             }
         }
+        _syncToken = entry.syncToken;
+        _quota = entry.quota;
+        _folderListing.size = entry.folderSize;
     } else {
 
         RemoteInfo result;
         int slash = file.lastIndexOf(QLatin1Char('/'));
         result.name = file.mid(slash + 1);
         result.size = -1;
-        propertyMapToRemoteInfo(map, result);
+        listingEntryToRemoteInfo(entry, result);
         if (result.isDirectory)
             result.size = 0;
 
-        if (_isExternalStorage && result.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
+        // In a deep listing the entry might belong to a subdirectory
+        QString parentPath;
+        bool parentIsExternalStorage = _isExternalStorage;
+        if (_depthInfinity && slash > _firstHref.size()) {
+            parentPath = file.mid(_firstHref.size() + 1, slash - _firstHref.size() - 1);
+            parentIsExternalStorage = _mountedSubdirectories.contains(parentPath);
+        }
+        if (_depthInfinity && result.isDirectory) {
+            const QString path = parentPath.isEmpty() ? result.name : parentPath + QLatin1Char('/') + result.name;
+            if (result.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
+                _mountedSubdirectories.insert(path);
+            }
+            // make sure empty directories are known as well
+            _subtreeResults[path];
+        }
+
+        if (parentIsExternalStorage && result.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
             /* All the entries in a external storage have 'M' in their permission. However, for all
                purposes in the desktop client, we only need to know about the mount points.
                So replace the 'M' by a 'm' for every sub entries in an external storage */
             result.remotePerm.unsetPermission(RemotePermissions::IsMounted);
             result.remotePerm.setPermission(RemotePermissions::IsMountedSub);
         }
-        _results.push_back(std::move(result));
+        if (parentPath.isEmpty()) {
+            if (result.isDirectory && !_depthInfinity) {
+                _folderListing.folders.append({result.name, result.etag, entry.folderSize});
+            }
+            _results.push_back(std::move(result));
+        } else {
+            _subtreeResults[parentPath].push_back(std::move(result));
+        }
     }
 
     //This works in concerto with the RequestEtagJob and the Folder object to check if the remote folder changed.
     if (_firstEtag.isEmpty()) {
-        if (auto it = Utility::optionalFind(map, QStringLiteral("getetag"))) {
-            _firstEtag = Utility::normalizeEtag(it->value()); // for directory itself
-        }
+        _firstEtag = entry.etag; // for directory itself
     }
 }
 
+std::chrono::milliseconds DiscoverySingleDirectoryJob::duration() const
+{
+    return _proFindJob ? _proFindJob->duration() : std::chrono::milliseconds{};
+}
+
+qint64 DiscoverySingleDirectoryJob::maximumBufferedBytes() const
+{
+    return _proFindJob ? _proFindJob->maximumBufferedBytes() : 0;
+}
+
 void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
 {
     if (!_ignoredFirst) {
-        // This is a sanity check, if we haven't _ignoredFirst then it means we never received any directoryListingIteratedSlot
+        // This is a sanity check, if we haven't _ignoredFirst then it means we never received any directoryListingEntrySlot
         // which means somehow the server XML was bogus
         Q_EMIT finished(HttpError{0, tr("Server error: PROPFIND reply is not XML formatted!")});
         deleteLater();
@@ -429,8 +661,156 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
         lastResponse = QDateTime::currentDateTimeUtc();
     }
 
+    if (!_depthInfinity) {
+        _folderListing.etag = _firstEtag;
+        _account->remoteListingCache()->insert(Utility::concatUrlPath(_baseUrl, _subPath), std::move(_folderListing));
+    }
+
     Q_EMIT etag(_firstEtag, lastResponse);
     Q_EMIT finished(_results);
     deleteLater();
 }
+
+DiscoveryRemoteChangesJob::DiscoveryRemoteChangesJob(DiscoveryPhase *discovery, const QByteArray &syncToken, QObject *parent)
+    : QObject(parent)
+    , _discovery(discovery)
+    , _previousSyncToken(syncToken)
+{
+}
+
+void DiscoveryRemoteChangesJob::start()
+{
+    _job = new SyncCollectionJob(_discovery->_account, _discovery->_baseUrl, _discovery->_remoteFolder, _previousSyncToken, this);
+    _job->setProperties(listingProperties());
+    _job->setRequestClass(JobQueue::RequestClass::Discovery);
+    connect(_job, &SyncCollectionJob::finishedWithError, this, [this] {
+        Q_EMIT finished(HttpError{_job->httpStatusCode(), _job->errorString()});
+        deleteLater();
+    });
+    connect(_job, &SyncCollectionJob::finishedWithoutError, this, [this] {
+        Q_EMIT finished(listChangedDirectories());
+        deleteLater();
+    });
+    _job->start();
+}
+
+QByteArray DiscoveryRemoteChangesJob::syncToken() const
+{
+    return _job ? _job->newSyncToken() : QByteArray();
+}
+
+std::chrono::milliseconds DiscoveryRemoteChangesJob::duration() const
+{
+    return _job ? _job->duration() : std::chrono::milliseconds{};
+}
+
+QHash<QString, DiscoveryRemoteChangesJob::Listing> DiscoveryRemoteChangesJob::listChangedDirectories()
+{
+    auto parentPath = [](const QString &path) {
+        const auto slash = path.lastIndexOf(QLatin1Char('/'));
+        return slash < 0 ? QString() : path.left(slash);
+    };
+
+    QString rootHref = _job->reply()->request().url().path();
+    if (rootHref.endsWith(QLatin1Char('/'))) {
+        rootHref.chop(1);
+    }
+    QHash<QString, RemoteInfo> reported;
+    QSet<QString> removed;
+    // the changed entries and the subdirectories containing changes, by the path of their parent
+    QHash<QString, QSet<QString>> changedChildren;
+    for (const auto &change : _job->changes()) {
+        if (change.href.size() <= rootHref.size()) {
+            // the root itself
+            continue;
+        }
+        const QString path = change.href.mid(rootHref.size() + 1);
+        if (change.removed) {
+            removed.insert(path);
+        } else {
+            RemoteInfo info;
+            info.name = path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+            info.size = -1;
+            propertyMapToRemoteInfo(change.properties, info);
+            if (info.isDirectory)
+                info.size = 0;
+            reported.insert(path, std::move(info));
+        }
+        for (QString child = path; !child.isEmpty(); child = parentPath(child)) {
+            changedChildren[parentPath(child)].insert(child);
+        }
+    }
+
+    SyncJournalDb *journal = _discovery->_statedb;
+    const auto &vfs = _discovery->_syncOptions._vfs;
+    QHash<QString, Listing> listings;
+    for (auto it = changedChildren.cbegin(); it != changedChildren.cend(); ++it) {
+        const QString &path = it.key();
+        if (path.isEmpty()) {
+            // the root is always listed, it provides the data-fingerprint and its permissions
+            continue;
+        }
+        const auto directory = reported.constFind(path);
+        if (directory == reported.cend() || !directory->isDirectory) {
+            continue;
+        }
+        // a new directory or one that moved here has no journal entries to start from
+        const QByteArray pathU8 = path.toUtf8();
+        SyncJournalFileRecord record;
+        if (!journal->getFileRecord(pathU8, &record) || !record.isValid() || !record.isDirectory() || record._fileId != directory->fileId
+            || record._etag == "_invalid_") {
+            continue;
+        }
+
+        const bool isExternalStorage =
+            record._remotePerm.hasPermission(RemotePermissions::IsMounted) || record._remotePerm.hasPermission(RemotePermissions::IsMountedSub);
+        bool complete = true;
+        QHash<QString, RemoteInfo> entries;
+        const bool listed = journal->listFilesInPath(pathU8, [&](const SyncJournalFileRecord &child) {
+            if (child.isDirectory() && child._etag == "_invalid_") {
+                // scheduled for a remote discovery, see SyncJournalDb::schedulePathForRemoteDiscovery()
+                complete = false;
+            }
+            RemoteInfo info;
+            info.name = QString::fromUtf8(child._path.constData() + pathU8.size() + 1);
+            if (child.isVirtualFile() && vfs->mode() == Vfs::WithSuffix) {
+                info.name = vfs->underlyingFileName(info.name);
+            }
+            info.etag = QString::fromUtf8(child._etag);
+            info.fileId = child._fileId;
+            info.checksumHeader = child._checksumHeader;
+            info.remotePerm = child._remotePerm;
+            info.modtime = child._modtime;
+            info.isDirectory = child.isDirectory();
+            info.size = info.isDirectory ? 0 : child._fileSize;
+            entries.insert(info.name, std::move(info));
+        });
+        if (!listed) {
+            continue;
+        }
+        for (const auto &childPath : it.value()) {
+            const QString name = childPath.mid(path.size() + 1);
+            if (removed.contains(childPath)) {
+                entries.remove(name);
+            } else if (const auto change = reported.constFind(childPath); change != reported.cend()) {
+                RemoteInfo info = *change;
+                if (isExternalStorage && info.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
+                    // see DiscoverySingleDirectoryJob::directoryListingEntrySlot()
+                    info.remotePerm.unsetPermission(RemotePermissions::IsMounted);
+                    info.remotePerm.setPermission(RemotePermissions::IsMountedSub);
+                }
+                entries.insert(name, std::move(info));
+            } else {
+                // a subdirectory containing changes wasn't reported itself, its new etag is unknown
+                complete = false;
+            }
+        }
+        if (!complete) {
+            qCDebug(lcDiscovery) << "Can't list" << path << "from the reported changes";
+            continue;
+        }
+        listings.insert(path, {directory->etag, entries.values()});
+    }
+    return listings;
+}
 }
@@ -21,25 +21,39 @@
 #include <QMap>
 #include <QSet>
 #include "networkjobs.h"
+#include "caseclashindex.h"
+#include "remotelistingcache.h"
 #include <QMutex>
 #include <QWaitCondition>
 #include <QRunnable>
+#include <QThreadPool>
 #include <deque>
 #include "syncoptions.h"
 #include "syncfileitem.h"
+#include "common/syncjournaldb.h"
+
+#include <memory>
+#include <optional>
+#include <vector>
 
 class ExcludedFiles;
 
+class TestLocalDiscovery;
+class TestRemoteDiscovery;
+
 namespace OCC {
 
 enum class LocalDiscoveryStyle {
     FilesystemOnly, //< read all local data from the filesystem
     DatabaseAndFilesystem, //< read from the db, except for listed paths
+    FilesystemUnlessUnchanged, //< read from the filesystem, except for folders whose fingerprint and etag are unchanged
 };
 
 
 class Account;
+class DiscoveryPhase;
 class SyncJournalDb;
+class SyncMetrics;
 class ProcessDirectoryJob;
 
 /**
@@ -90,7 +104,8 @@ public:
 
     void run() override;
 Q_SIGNALS:
-    void finished(QVector<LocalInfo> result);
+    /** \a fingerprint is the state of the directory before it was listed, it is null if it might be outdated */
+    void finished(QVector<LocalInfo> result, std::optional<OCC::SyncJournalDb::LocalFolderFingerprint> fingerprint);
     void finishedFatalError(QString errorString);
     void finishedNonFatalError(QString errorString);
 
@@ -118,9 +133,30 @@ public:
     // Specify that this is the root and we need to check the data-fingerprint
     void setIsRootPath() { _isRootPath = true; }
     bool isRootPath() const { return _isRootPath; }
+
+    /** List the whole subtree with a single Depth: infinity PROPFIND
+     *
+     * The entries of the directory itself are reported in finished(),
+     * the ones of its subdirectories are available via subtreeResults().
+     */
+    void setDepthInfinity() { _depthInfinity = true; }
+    bool isDepthInfinity() const { return _depthInfinity; }
+
+    /** Entries of the subdirectories when isDepthInfinity() is set
+     *
+     * The keys are the paths of the subdirectories relative to the listed directory.
+     * Every subdirectory has an entry, even if it is empty.
+     */
+    QHash<QString, QVector<RemoteInfo>> &subtreeResults() { return _subtreeResults; }
+
     void start();
     void abort();
 
+    /** The duration of the PROPFIND, valid once finished() was emitted */
+    std::chrono::milliseconds duration() const;
+    /** See AbstractNetworkJob::maximumBufferedBytes() */
+    qint64 maximumBufferedBytes() const;
+
     // This is not actually a network job, it is just a job
 Q_SIGNALS:
     void firstDirectoryPermissions(RemotePermissions);
@@ -128,11 +164,18 @@ Q_SIGNALS:
     void finished(const HttpResult<QVector<RemoteInfo>> &result);
 
 private Q_SLOTS:
-    void directoryListingIteratedSlot(const QString &, const QMap<QString, QString> &);
+    void directoryListingEntrySlot(const QString &, const ListingEntry &);
     void lsJobFinishedWithoutErrorSlot();
 
 private:
     QVector<RemoteInfo> _results;
+    QHash<QString, QVector<RemoteInfo>> _subtreeResults;
+    // The subfolders for the account's RemoteListingCache, not filled for a deep listing
+    RemoteListingCache::Listing _folderListing;
+    // The subdirectories that have 'M' in their permissions, relative to _subPath
+    QSet<QString> _mountedSubdirectories;
+    // The href of the directory itself, used to make the paths of a deep listing relative
+    QString _firstHref;
     QString _subPath;
     QString _firstEtag;
     AccountPtr _account;
@@ -144,12 +187,63 @@ private:
     bool _isRootPath;
     // If this directory is an external storage (The first item has 'M' in its permission)
     bool _isExternalStorage;
+    bool _depthInfinity = false;
     // If set, the discovery will finish with an error
     QString _error;
     QPointer<PropfindJob> _proFindJob;
 
 public:
     QByteArray _dataFingerprint;
+    // The DAV:sync-token of the root, if the server supports sync-collection REPORTs
+    QByteArray _syncToken;
+    // The quota of the root, if it was requested
+    std::optional<RemoteQuota> _quota;
+};
+
+/**
+ * @brief Lists the directories that changed since a sync token with a single request
+ *
+ * Sends a sync-collection REPORT for the sync root. The listing of a changed
+ * directory is made of its journal entries with the reported changes applied,
+ * so it doesn't need a PROPFIND.
+ *
+ * Directories that can't be listed this way, for example because they are new
+ * or were moved, are left out and will be listed with a PROPFIND.
+ *
+ * @ingroup libsync
+ */
+class DiscoveryRemoteChangesJob : public QObject
+{
+    Q_OBJECT
+public:
+    /** The listing of a changed directory */
+    struct Listing
+    {
+        /// The reported etag of the directory, the entries belong to this state
+        QString etag;
+        QVector<RemoteInfo> entries;
+    };
+
+    explicit DiscoveryRemoteChangesJob(DiscoveryPhase *discovery, const QByteArray &syncToken, QObject *parent = nullptr);
+
+    void start();
+
+    /** The token for the next request, valid once finished() was emitted */
+    QByteArray syncToken() const;
+
+    /** The duration of the REPORT, valid once finished() was emitted */
+    std::chrono::milliseconds duration() const;
+
+Q_SIGNALS:
+    /** The listings of the changed directories, keyed by their path relative to the sync root */
+    void finished(const HttpResult<QHash<QString, DiscoveryRemoteChangesJob::Listing>> &result);
+
+private:
+    QHash<QString, Listing> listChangedDirectories();
+
+    DiscoveryPhase *_discovery;
+    const QByteArray _previousSyncToken;
+    QPointer<SyncCollectionJob> _job;
 };
 
 class DiscoveryPhase : public QObject
@@ -157,6 +251,8 @@ class DiscoveryPhase : public QObject
     Q_OBJECT
 
     friend class ProcessDirectoryJob;
+    friend class ::TestLocalDiscovery;
+    friend class ::TestRemoteDiscovery;
 
     QPointer<ProcessDirectoryJob> _currentRootJob;
 
@@ -204,9 +300,76 @@ class DiscoveryPhase : public QObject
 
     int _currentlyActiveJobs = 0;
 
-    // both must contain a sorted list
-    std::set<QString> _selectiveSyncBlackList;
-    std::set<QString> _selectiveSyncWhiteList;
+    /** Remote entries of directories that were listed by a Depth: infinity PROPFIND
+     * of one of their parents, keyed by the server path of the directory.
+     *
+     * Entries are removed once the directory is processed, the ones of skipped
+     * directories once their parent is done. Sorted so that a subtree can be
+     * dropped at once, see dropPrefetchedRemoteEntries().
+     */
+    QMap<QString, QVector<RemoteInfo>> _prefetchedRemoteEntries;
+
+    /** The etags of the directories in _prefetchedRemoteEntries that were listed
+     * by a DiscoveryRemoteChangesJob.
+     *
+     * Such a listing is only used if the parent listing has the same etag for the
+     * directory, one that changed again since then is listed with a PROPFIND.
+     */
+    QMap<QString, QString> _prefetchedRemoteEtags;
+
+    /** Drops the prefetched listings of \a path and of all directories below it */
+    void dropPrefetchedRemoteEntries(const QString &path);
+
+    // Set if a Depth: infinity PROPFIND failed, don't try it again during this sync
+    bool _depthInfinityFailed = false;
+
+    /** Whether the remote changes since the last sync should be listed with DiscoveryRemoteChangesJob */
+    bool useDeltaDiscovery() const;
+
+    /** The result of listing a local directory on _localDiscoveryPool */
+    struct LocalListing
+    {
+        enum class State { Running, Finished, NonFatalError, FatalError };
+        State state = State::Running;
+        QVector<LocalInfo> entries;
+        QString errorString;
+        std::optional<SyncJournalDb::LocalFolderFingerprint> fingerprint;
+    };
+
+    /** Listings of local directories, keyed by their absolute path
+     *
+     * Besides the listings requested by the ProcessDirectoryJobs this contains
+     * the subdirectories of finished listings, which are prefetched so the
+     * pool is kept busy while the jobs are processing.
+     * Entries are removed once they are taken by their job.
+     */
+    QHash<QString, LocalListing> _localListings;
+    QThreadPool _localDiscoveryPool;
+
+    /** Start listing \a localPath unless that already happened
+     *
+     * localListingFinished() is emitted once the listing is done.
+     */
+    void startLocalListing(const QString &localPath);
+    void prefetchLocalSubdirectories(const QString &localPath, const QVector<LocalInfo> &entries);
+
+    /** Drop the listings below \a localPath, except for the subdirectories in \a kept and their contents
+     *
+     * Prefetched listings of directories that no job lists, for example because
+     * they were removed on the server, would otherwise take up prefetch slots
+     * until the end of the discovery.
+     */
+    void dropLocalListings(const QString &localPath, const QSet<QString> &kept);
+
+    /** Whether the subtree of a directory should be listed with a single request
+     *
+     * Only done for trees without journal entries, where every directory would need to be listed anyway.
+     */
+    bool useDepthInfinity() const;
+
+    // both contain a sorted list without nested paths, for a binary search
+    std::vector<QString> _selectiveSyncBlackList;
+    std::vector<QString> _selectiveSyncWhiteList;
 
     void scheduleMoreJobs();
 
@@ -234,13 +397,8 @@ class DiscoveryPhase : public QObject
 
 public:
     // input
-    DiscoveryPhase(const AccountPtr &account, const SyncOptions &options, const QUrl &baseUrl, QObject *parent = nullptr)
-        : QObject(parent)
-        , _account(account)
-        , _syncOptions(options)
-        , _baseUrl(baseUrl)
-    {
-    }
+    DiscoveryPhase(const AccountPtr &account, const SyncOptions &options, const QUrl &baseUrl, QObject *parent = nullptr);
+    ~DiscoveryPhase() override;
     AccountPtr _account;
     const SyncOptions _syncOptions;
     const QUrl _baseUrl;
@@ -252,6 +410,9 @@ public:
     QStringList _serverBlacklistedFiles; // The blacklist from the capabilities
     bool _ignoreHiddenFiles = false;
     std::function<bool(const QString &)> _shouldDiscoverLocaly;
+    SyncMetrics *_metrics = nullptr; // optional
+    // the journal's fingerprints of the folders that may be read from the db, see LocalDiscoveryStyle::FilesystemUnlessUnchanged
+    QHash<QString, SyncJournalDb::LocalFolderFingerprint> _unchangedLocalFolderFingerprints;
 
     void startJob(ProcessDirectoryJob *);
 
@@ -260,6 +421,14 @@ public:
 
     // output
     QByteArray _dataFingerprint;
+    // the remote state the discovery is based on, see SyncJournalDb::syncToken()
+    QByteArray _syncToken;
+    // the quota of the sync root, unset if the root was not listed
+    std::optional<RemoteQuota> _rootQuota;
+    // the fingerprints of the local folders that were listed, stored if the sync succeeds
+    QHash<QString, SyncJournalDb::LocalFolderFingerprint> _listedLocalFolderFingerprints;
+    // the names of the listed folders, set on case preserving file systems only
+    std::shared_ptr<CaseClashIndex> _caseClashIndex;
     bool _anotherSyncNeeded = false;
 
     /**
@@ -272,12 +441,22 @@ Q_SIGNALS:
     void itemDiscovered(const SyncFileItemPtr &item);
     void finished();
 
+    /** The top level directory \a path and everything below it was discovered
+     *
+     * Emitted after itemDiscovered() was emitted for the directory itself, which
+     * comes after its contents.
+     */
+    void subtreeDiscovered(const QString &path);
+
     /** For excluded items that don't show up in itemDiscovered()
       *
       * The path is relative to the sync folder, similar to item->_file
       */
     void silentlyExcluded(const QString &folderPath);
     void excluded(const QString &folderPath);
+
+    /** A listing in _localListings is no longer running */
+    void localListingFinished(const QString &localPath);
 };
 
 /// Implementation of DiscoveryPhase::adjustRenamedPath
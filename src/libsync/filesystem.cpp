@@ -20,18 +20,38 @@
 #include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
+#include <QScopeGuard>
 
 #include "csync.h"
 #include "vio/csync_vio_local.h"
 #include "std/c_time.h"
 
+#include <algorithm>
+
 #if defined(Q_OS_MAC) || defined(Q_OS_LINUX)
 #include <sys/xattr.h>
 #endif
 
+#if defined(Q_OS_LINUX)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(Q_OS_MAC)
+#include <sys/clonefile.h>
+#endif
+
 #ifdef Q_OS_WIN32
 #include "common/utility_win.h"
 #include <winsock2.h>
+
+#include <io.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+
+#include <cerrno>
+#include <cstring>
 #endif
 
 namespace {
@@ -100,32 +120,57 @@ bool FileSystem::setModTime(const QString &filename, time_t modTime)
 
 bool FileSystem::fileChanged(const QFileInfo &info, qint64 previousSize, time_t previousMtime, std::optional<quint64> previousInode)
 {
-    // previousMtime == -1 indicates the file does not exist
-    if (!info.exists() && previousMtime != -1) {
-        qCDebug(lcFileSystem) << info.filePath() << "was removed";
+    if (fileChanged(fileState(info.filePath()), previousSize, previousMtime, previousInode)) {
+        qCDebug(lcFileSystem) << "File" << info.filePath() << "has changed";
         return true;
     }
-    const qint64 actualSize = getSize(info);
-    if (actualSize != previousSize) {
-        qCDebug(lcFileSystem) << "File" << info.filePath() << "has changed: size: " << previousSize << "<->" << actualSize;
-        return true;
-    } else {
-        const time_t actualMtime = getModTime(info.filePath());
-        if (actualMtime != previousMtime) {
-            qCDebug(lcFileSystem) << "File" << info.filePath() << "has changed: mtime: " << previousMtime << "<->" << actualMtime;
+    return false;
+}
+
+bool FileSystem::fileChanged(const FileState &state, qint64 previousSize, time_t previousMtime, std::optional<quint64> previousInode)
+{
+    // previousMtime == -1 indicates the file does not exist
+    if (!state.exists) {
+        if (previousMtime != -1) {
+            qCDebug(lcFileSystem) << "The file was removed";
             return true;
-        } else if (previousInode.has_value()) {
-            quint64 actualIndoe;
-            FileSystem::getInode(info.filePath(), &actualIndoe);
-            if (previousInode.value() != actualIndoe) {
-                qCDebug(lcFileSystem) << "File" << info.filePath() << "has changed: inode" << previousInode.value() << "<-->" << actualIndoe;
-                return true;
-            }
         }
+        return false;
+    }
+    if (state.size != previousSize) {
+        qCDebug(lcFileSystem) << "size:" << previousSize << "<->" << state.size;
+        return true;
+    }
+    if (state.modtime != previousMtime) {
+        qCDebug(lcFileSystem) << "mtime:" << previousMtime << "<->" << state.modtime;
+        return true;
+    }
+    if (previousInode.has_value() && previousInode.value() != state.inode) {
+        qCDebug(lcFileSystem) << "inode:" << previousInode.value() << "<->" << state.inode;
+        return true;
     }
     return false;
 }
 
+FileSystem::FileState FileSystem::fileState(const QString &filename)
+{
+    csync_file_stat_t stat;
+    if (csync_vio_local_stat(filename, &stat) == -1) {
+        return {};
+    }
+    return {true, stat.size, stat.modtime, stat.inode};
+}
+
+FileSystem::FileState FileSystem::fileState(const QFile &file)
+{
+    csync_file_stat_t stat;
+    if (csync_vio_local_fstat(file.handle(), &stat) == -1) {
+        qCWarning(lcFileSystem) << "Could not stat the open file" << file.fileName();
+        return {};
+    }
+    return {true, stat.size, stat.modtime, stat.inode};
+}
+
 #ifdef Q_OS_WIN
 static qint64 getSizeWithCsync(const QString &filename)
 {
@@ -196,6 +241,22 @@ bool FileSystem::removeRecursively(const QString &path,
     return allRemoved;
 }
 
+QStringList FileSystem::lockedFiles(const QString &path, LockMode mode)
+{
+    QStringList out;
+    if (!Utility::isWindows()) {
+        return out;
+    }
+    QDirIterator di(path, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while (di.hasNext()) {
+        const QString filePath = di.next();
+        if (FileSystem::isFileLocked(filePath, mode)) {
+            out.append(filePath);
+        }
+    }
+    return out;
+}
+
 bool FileSystem::getInode(const QString &filename, quint64 *inode)
 {
     csync_file_stat_t fs;
@@ -206,8 +267,129 @@ bool FileSystem::getInode(const QString &filename, quint64 *inode)
     return false;
 }
 
+bool FileSystem::preallocate(QFile &file, qint64 size)
+{
+    const qint64 missing = size - file.size();
+    if (!file.isOpen() || missing <= 0) {
+        return false;
+    }
+#if defined(Q_OS_LINUX)
+    // keep the size, we resume downloads based on it
+    if (fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, size) == 0) {
+        return true;
+    }
+    qCDebug(lcFileSystem) << "fallocate failed for" << file.fileName() << strerror(errno);
+    return false;
+#elif defined(Q_OS_MAC)
+    // try to get a contiguous area first
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, missing, 0};
+    if (fcntl(file.handle(), F_PREALLOCATE, &store) == 0) {
+        return true;
+    }
+    store.fst_flags = F_ALLOCATEALL;
+    if (fcntl(file.handle(), F_PREALLOCATE, &store) == 0) {
+        return true;
+    }
+    qCDebug(lcFileSystem) << "F_PREALLOCATE failed for" << file.fileName() << strerror(errno);
+    return false;
+#elif defined(Q_OS_WIN)
+    // SetFileValidData would move the end of the file and requires a privilege,
+    // setting the allocation size only reserves the clusters
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = size;
+    const auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()));
+    if (handle != INVALID_HANDLE_VALUE && SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info))) {
+        return true;
+    }
+    qCDebug(lcFileSystem) << "Setting the allocation size failed for" << file.fileName() << Utility::formatWinError(GetLastError());
+    return false;
+#else
+    Q_UNUSED(missing);
+    return false;
+#endif
+}
+
 namespace {
 
+    /// Clones \a source to the new file \a target, returns false if the file system can't
+    bool clone(const QString &source, const QString &target)
+    {
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+        const int in = ::open(FileSystem::encodeFileName(source).constData(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) {
+            return false;
+        }
+        struct stat st;
+        const int out = fstat(in, &st) == 0
+            ? ::open(FileSystem::encodeFileName(target).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777)
+            : -1;
+        const bool cloned = out >= 0 && ioctl(out, FICLONE, in) == 0;
+        if (out >= 0) {
+            ::close(out);
+            if (!cloned) {
+                ::unlink(FileSystem::encodeFileName(target).constData());
+            }
+        }
+        ::close(in);
+        return cloned;
+#elif defined(Q_OS_MAC)
+        return clonefile(FileSystem::encodeFileName(source).constData(), FileSystem::encodeFileName(target).constData(), 0) == 0;
+#elif defined(Q_OS_WIN) && defined(FSCTL_DUPLICATE_EXTENTS_TO_FILE)
+        const HANDLE in = CreateFileW(reinterpret_cast<const wchar_t *>(FileSystem::longWinPath(source).utf16()), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (in == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        const auto closeIn = qScopeGuard([in] { CloseHandle(in); });
+        // only ReFS reports the integrity information, it also provides the cluster size the ranges must be aligned to
+        FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrity;
+        DWORD bytes = 0;
+        BY_HANDLE_FILE_INFORMATION info;
+        LARGE_INTEGER size;
+        if (!DeviceIoControl(in, FSCTL_GET_INTEGRITY_INFORMATION, nullptr, 0, &integrity, sizeof(integrity), &bytes, nullptr)
+            || !GetFileInformationByHandle(in, &info) || !GetFileSizeEx(in, &size)) {
+            return false;
+        }
+        const HANDLE out = CreateFileW(reinterpret_cast<const wchar_t *>(FileSystem::longWinPath(target).utf16()), GENERIC_READ | GENERIC_WRITE | DELETE, 0,
+            nullptr, CREATE_NEW, info.dwFileAttributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_NORMAL), nullptr);
+        if (out == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        bool cloned = true;
+        if (info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) {
+            cloned = DeviceIoControl(out, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytes, nullptr);
+        }
+        // the integrity settings of both files must match
+        FSCTL_SET_INTEGRITY_INFORMATION_BUFFER setIntegrity = {integrity.ChecksumAlgorithm, 0, integrity.Flags};
+        cloned = cloned && DeviceIoControl(out, FSCTL_SET_INTEGRITY_INFORMATION, &setIntegrity, sizeof(setIntegrity), nullptr, 0, &bytes, nullptr);
+        FILE_END_OF_FILE_INFO endOfFile;
+        endOfFile.EndOfFile = size;
+        cloned = cloned && SetFileInformationByHandle(out, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+        // a single request must stay below 4 GiB
+        const qint64 clusterSize = integrity.ClusterSizeInBytes;
+        const qint64 maximumRange = (Q_INT64_C(0xffffffff) / clusterSize) * clusterSize;
+        const qint64 alignedSize = (size.QuadPart + clusterSize - 1) / clusterSize * clusterSize;
+        for (qint64 offset = 0; cloned && offset < alignedSize; offset += maximumRange) {
+            DUPLICATE_EXTENTS_DATA extents;
+            extents.FileHandle = in;
+            extents.SourceFileOffset.QuadPart = offset;
+            extents.TargetFileOffset.QuadPart = offset;
+            extents.ByteCount.QuadPart = std::min(maximumRange, alignedSize - offset);
+            cloned = DeviceIoControl(out, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &extents, sizeof(extents), nullptr, 0, &bytes, nullptr);
+        }
+        if (!cloned) {
+            FILE_DISPOSITION_INFO disposition = {TRUE};
+            SetFileInformationByHandle(out, FileDispositionInfo, &disposition, sizeof(disposition));
+        }
+        CloseHandle(out);
+        return cloned;
+#else
+        Q_UNUSED(source);
+        Q_UNUSED(target);
+        return false;
+#endif
+    }
+
 #ifdef Q_OS_LINUX
     Q_ALWAYS_INLINE ssize_t getxattr(const char *path, const char *name, void *value, size_t size, u_int32_t, int)
     {
@@ -227,6 +409,27 @@ namespace {
 
 } // anonymous namespace
 
+bool FileSystem::cloneFile(const QString &source, const QString &target)
+{
+    return clone(source, target);
+}
+
+bool FileSystem::copyFile(const QString &source, const QString &target, QString *errorString)
+{
+    if (clone(source, target)) {
+        qCDebug(lcFileSystem) << "Cloned" << source << "to" << target;
+        return true;
+    }
+    QFile file(source);
+    if (!file.copy(target)) {
+        if (errorString) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
 std::optional<QByteArray> FileSystem::Tags::get(const QString &path, const QString &key)
 {
 #if defined(Q_OS_MAC) || defined(Q_OS_LINUX)
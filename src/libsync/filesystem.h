@@ -76,6 +76,60 @@ namespace FileSystem {
      */
     bool OWNCLOUDSYNC_EXPORT fileChanged(const QFileInfo &info, qint64 previousSize, time_t previousMtime, std::optional<quint64> previousInode = {});
 
+    /**
+     * @brief The size, mtime and inode of a file, read with a single stat
+     */
+    struct FileState
+    {
+        bool exists = false;
+        qint64 size = 0;
+        time_t modtime = -1;
+        quint64 inode = 0;
+    };
+
+    /**
+     * @brief Stat \a filename once, instead of a stat for each of getSize(), getModTime() and getInode()
+     */
+    FileState OWNCLOUDSYNC_EXPORT fileState(const QString &filename);
+
+    /**
+     * @brief Stat the open \a file through its handle
+     *
+     * The state is the one of the data that is read from \a file, even if its path
+     * was replaced in the meantime.
+     */
+    FileState OWNCLOUDSYNC_EXPORT fileState(const QFile &file);
+
+    /**
+     * @brief Same as fileChanged() with the \a state of the file
+     */
+    bool OWNCLOUDSYNC_EXPORT fileChanged(const FileState &state, qint64 previousSize, time_t previousMtime, std::optional<quint64> previousInode = {});
+
+
+    /**
+     * @brief Reserve the disk space for an open \a file that will grow to \a size bytes
+     *
+     * The size of the file is not changed, it just avoids fragmentation of files
+     * that are written by appending. Returns false if the file system does not
+     * support it, that is not an error.
+     */
+    bool OWNCLOUDSYNC_EXPORT preallocate(QFile &file, qint64 size);
+
+    /**
+     * @brief Copies \a source to the new file \a target
+     *
+     * On copy-on-write file systems the copy is a clone that shares the data
+     * with the source: FICLONE on Btrfs and XFS, clonefile() on APFS and block
+     * cloning on ReFS. Elsewhere the data is copied. Fails if \a target exists.
+     */
+    bool OWNCLOUDSYNC_EXPORT copyFile(const QString &source, const QString &target, QString *errorString = nullptr);
+
+    /**
+     * @brief Clones \a source to the new file \a target, like copyFile() but never copies the data
+     *
+     * Returns false if the file system doesn't support copy-on-write clones.
+     */
+    bool OWNCLOUDSYNC_EXPORT cloneFile(const QString &source, const QString &target);
 
     struct RemoveEntry
     {
@@ -101,6 +155,14 @@ namespace FileSystem {
         RemoveEntryList *locked,
         RemoveErrorList *errors);
 
+    /**
+     * Returns the files in the directory \a path and below that are locked with \a mode
+     *
+     * Probes all files in a single walk of the tree, e.g. after a directory
+     * couldn't be renamed. Always empty where isFileLocked() is.
+     */
+    QStringList OWNCLOUDSYNC_EXPORT lockedFiles(const QString &path, LockMode mode);
+
     namespace Tags {
         std::optional<QByteArray> OWNCLOUDSYNC_EXPORT get(const QString &path, const QString &key);
         OCC::Result<void, QString> OWNCLOUDSYNC_EXPORT set(const QString &path, const QString &key, const QByteArray &value);
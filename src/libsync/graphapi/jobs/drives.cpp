@@ -19,6 +19,8 @@
 #include <OAICollection_of_drives.h>
 #include <OAIDrive.h>
 
+#include <QCryptographicHash>
+
 
 using namespace OCC;
 using namespace GraphApi;
@@ -28,16 +30,36 @@ namespace {
 const auto mountpointC = QLatin1String("mountpoint");
 }
 
-Drives::Drives(const AccountPtr &account, QObject *parent)
+Drives::Drives(const AccountPtr &account, const Revision &knownRevision, QObject *parent)
     : JsonJob(account, account->url(), QStringLiteral("/graph/v1.0/me/drives"), "GET", {}, {}, parent)
+    , _knownRevision(knownRevision)
 {
+    if (!_knownRevision.etag.isEmpty()) {
+        _request.setRawHeader(QByteArrayLiteral("If-None-Match"), _knownRevision.etag);
+    }
 }
 
 Drives::~Drives() { }
 
+void Drives::parse(const QByteArray &data)
+{
+    if (httpStatusCode() == 304) {
+        _revision = _knownRevision;
+        _unchanged = true;
+        return;
+    }
+    _revision.etag = reply()->rawHeader(QByteArrayLiteral("ETag"));
+    _revision.bodyHash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    if (!_knownRevision.bodyHash.isEmpty() && _revision.bodyHash == _knownRevision.bodyHash) {
+        _unchanged = true;
+        return;
+    }
+    JsonJob::parse(data);
+}
+
 const QList<OpenAPI::OAIDrive> &Drives::drives() const
 {
-    if (_drives.isEmpty() && parseError().error == QJsonParseError::NoError) {
+    if (_drives.isEmpty() && !_unchanged && parseError().error == QJsonParseError::NoError) {
         OpenAPI::OAICollection_of_drives drives;
         drives.fromJsonObject(data());
         _drives = drives.getValue();
@@ -22,16 +22,43 @@ namespace OCC {
 namespace GraphApi {
 
 
+    /**
+     * Lists the drives of the user
+     *
+     * Graph provides no delta for the drives, therefore the job is given the
+     * revision of the previous listing: the server can answer with a 304 to the
+     * If-None-Match of its etag, otherwise a body identical to the previous one
+     * is detected by its hash. In both cases the response is not parsed and
+     * isUnchanged() is true.
+     */
     class OWNCLOUDSYNC_EXPORT Drives : public JsonJob
     {
         Q_OBJECT
     public:
-        Drives(const AccountPtr &account, QObject *parent = nullptr);
+        struct Revision
+        {
+            QByteArray etag;
+            QByteArray bodyHash;
+        };
+
+        Drives(const AccountPtr &account, const Revision &knownRevision = {}, QObject *parent = nullptr);
         ~Drives();
         const QList<OpenAPI::OAIDrive> &drives() const;
 
+        /// The revision of this listing, to be passed to the next job
+        const Revision &revision() const { return _revision; }
+
+        /// Whether the drives are the same as the ones of the known revision
+        bool isUnchanged() const { return _unchanged; }
+
+    protected:
+        void parse(const QByteArray &data) override;
+
     private:
         mutable QList<OpenAPI::OAIDrive> _drives;
+        Revision _knownRevision;
+        Revision _revision;
+        bool _unchanged = false;
     };
 }
 }
@@ -50,7 +50,7 @@ OpenAPI::OAIDrive Space::drive() const
     return _drive;
 }
 
-void Space::setDrive(const OpenAPI::OAIDrive &drive)
+bool Space::setDrive(const OpenAPI::OAIDrive &drive)
 {
 
     // first config naturally has an empty drive - reality check that updated drives are always valid
@@ -63,10 +63,11 @@ void Space::setDrive(const OpenAPI::OAIDrive &drive)
     // as on changing the space image so we may have further wrinkles if there is an error in logic server side, but for now
     // we want to reduce updates to "only when something changed" else everything is auto-refreshed periodically (eg every 30s)
     if (curTag == newTag)
-        return;
+        return false;
 
     _drive = drive;
     _image->update();
+    return true;
 }
 
 QString Space::displayName() const
@@ -168,6 +169,7 @@ void SpaceImage::update()
         QObject::connect(job, &SimpleNetworkJob::finishedSignal, _space, [job, this] {
             if (job->httpStatusCode() == 200) {
                 _image = job->asIcon();
+                _cachePath = job->cachePath();
                 Q_EMIT imageChanged();
             }
         });
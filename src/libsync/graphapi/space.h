@@ -40,6 +40,8 @@ namespace GraphApi {
         [[nodiscard]] QUrl url() const { return _url; }
         [[nodiscard]] QString etag() const { return _etag; }
         [[nodiscard]] QIcon image() const;
+        /** The image file in the resources cache, empty if there is no image */
+        [[nodiscard]] QString cachePath() const { return _cachePath; }
 
         [[nodiscard]] QUrl qmlImageUrl() const;
 
@@ -52,6 +54,7 @@ namespace GraphApi {
         QUrl _url;
         QString _etag;
         QIcon _image;
+        QString _cachePath;
         Space *_space = nullptr;
 
         friend class Space;
@@ -95,7 +98,8 @@ namespace GraphApi {
 
     private:
         Space(SpacesManager *spaceManager, const OpenAPI::OAIDrive &drive, bool hasManyPersonalSpaces);
-        void setDrive(const OpenAPI::OAIDrive &drive);
+        /// Returns whether the drive changed
+        bool setDrive(const OpenAPI::OAIDrive &drive);
 
         SpacesManager *_spaceManager;
         OpenAPI::OAIDrive _drive;
@@ -15,11 +15,12 @@
 #include "spacesmanager.h"
 
 #include "libsync/account.h"
+#include "libsync/coalescedtimer.h"
 #include "libsync/creds/abstractcredentials.h"
 #include "libsync/graphapi/jobs/drives.h"
+#include "libsync/serverevents.h"
 
 
-#include <QTimer>
 
 #include <chrono>
 
@@ -30,21 +31,34 @@ using namespace GraphApi;
 
 namespace {
 constexpr auto refreshTimeoutC = 30s;
+// the fallback while the server pushes change notifications
+constexpr auto notifiedRefreshTimeoutC = 5min;
 }
 
 SpacesManager::SpacesManager(Account *parent)
     : QObject(parent)
     , _account(parent)
-    , _refreshTimer(new QTimer(this))
+    , _refreshTimer(new CoalescedTimer(this))
 {
     _refreshTimer->setInterval(refreshTimeoutC);
     // the timer will be restarted once we received drives data
     _refreshTimer->setSingleShot(true);
 
-    connect(_refreshTimer, &QTimer::timeout, this, &SpacesManager::refresh);
+    connect(_refreshTimer, &CoalescedTimer::timeout, this, &SpacesManager::refresh);
     connect(_account, &Account::credentialsFetched, this, &SpacesManager::refresh);
     // legacy signal which is going to be removed in 5.0
     connect(_account, &Account::credentialsAsked, this, &SpacesManager::refresh);
+
+    if (auto *events = _account->serverEvents()) {
+        connect(events, &ServerEvents::spacesChanged, this, &SpacesManager::refresh);
+        connect(events, &ServerEvents::connectedChanged, this, [this](bool connected) {
+            _refreshTimer->setInterval(connected ? notifiedRefreshTimeoutC : refreshTimeoutC);
+            if (connected) {
+                // catch up with the changes we missed while not connected
+                refresh();
+            }
+        });
+    }
 }
 
 void SpacesManager::refresh()
@@ -57,14 +71,20 @@ void SpacesManager::refresh()
     }
 
     // TODO: leak the job until we fixed the ownership https://github.com/owncloud/client/issues/11203
-    auto drivesJob = new Drives(_account->sharedFromThis(), nullptr);
+    auto drivesJob = new Drives(_account->sharedFromThis(), _revision, nullptr);
     drivesJob->setTimeout(refreshTimeoutC);
     connect(drivesJob, &Drives::finishedSignal, this, [drivesJob, this] {
         // a system which provides multiple personal spaces the name of the drive is always used as display name
         auto hasManyPersonalSpaces = this->account()->capabilities().spacesSupport().hasMultiplePersonalSpaces;
 
         drivesJob->deleteLater();
+        if (drivesJob->isUnchanged()) {
+            // nothing to parse, nothing to update
+            _refreshTimer->start();
+            return;
+        }
         if (drivesJob->httpStatusCode() == 200) {
+            _revision = drivesJob->revision();
             auto oldKeys = _spacesMap.keys();
             for (const auto &dr : drivesJob->drives()) {
                 auto *space = this->space(dr.getId());
@@ -72,10 +92,10 @@ void SpacesManager::refresh()
                 if (!space) {
                     space = new Space(this, dr, hasManyPersonalSpaces);
                     _spacesMap.insert(dr.getId(), space);
-                } else {
-                    space->setDrive(dr);
+                    Q_EMIT spaceChanged(space);
+                } else if (space->setDrive(dr)) {
+                    Q_EMIT spaceChanged(space);
                 }
-                Q_EMIT spaceChanged(space);
             }
             for (const QString &id : oldKeys) {
                 auto *oldSpace = _spacesMap.take(id);
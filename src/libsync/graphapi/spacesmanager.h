@@ -17,6 +17,7 @@
 #include "owncloudlib.h"
 
 #include "libsync/accountfwd.h"
+#include "libsync/graphapi/jobs/drives.h"
 #include "libsync/graphapi/space.h"
 
 #include <OAIDrive.h>
@@ -25,9 +26,9 @@
 
 #include <QFuture>
 
-class QTimer;
-
 namespace OCC {
+class CoalescedTimer;
+
 namespace GraphApi {
 
     class OWNCLOUDSYNC_EXPORT SpacesManager : public QObject
@@ -52,7 +53,9 @@ namespace GraphApi {
         void checkReady();
 
     Q_SIGNALS:
+        /// A space was added or its drive changed
         void spaceChanged(Space *space) const;
+        /// The list of spaces might have changed, not emitted when the drives are unchanged
         void updated();
         void ready() const;
 
@@ -60,8 +63,10 @@ namespace GraphApi {
         void refresh();
 
         Account *_account;
-        QTimer *_refreshTimer;
+        CoalescedTimer *_refreshTimer;
         QMap<QString, Space *> _spacesMap;
+        // of the last drives listing
+        Drives::Revision _revision;
         bool _ready = false;
     };
 
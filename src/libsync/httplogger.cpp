@@ -15,15 +15,21 @@
 #include "httplogger.h"
 
 #include "common/chronoelapsedtimer.h"
+#include "httprecording.h"
 
 #include <QBuffer>
+#include <QDateTime>
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLoggingCategory>
+#include <QMutex>
 #include <QPointer>
 #include <QRegularExpression>
+#include <QUuid>
 
+#include <cstring>
 #include <memory>
 
 using namespace std::chrono;
@@ -33,6 +39,9 @@ Q_LOGGING_CATEGORY(lcNetworkHttp, "sync.httplogger", QtWarningMsg)
 
 const qint64 PeekSize = 1024 * 1024;
 
+// once the trace file is larger it is moved to <name>.1 and a new one is started
+const qint64 MaximumTraceSize = 64 * 1024 * 1024;
+
 bool isTextBody(const QString &s)
 {
     static const QRegularExpression regexp(QStringLiteral("^(text/.*?|(application/(xml|.*?json|x-www-form-urlencoded)(;|$)))"));
@@ -45,6 +54,7 @@ struct HttpContext
         : originalUrl(QString::fromUtf8(request.url().toEncoded())) // Encoded URL as it is passed "over the wire"
         , lastUrl(request.url())
         , id(QString::fromUtf8(request.rawHeader(QByteArrayLiteral("X-Request-ID"))))
+        , startTime(QDateTime::currentMSecsSinceEpoch())
     {
     }
 
@@ -58,11 +68,107 @@ struct HttpContext
     QUrl lastUrl;
     QStringList redirectUrls;
     const QString id;
+    const qint64 startTime;
 
     OCC::Utility::ChronoElapsedTimer timer;
+    std::chrono::nanoseconds queuedDuration = {};
+    qint64 bytesSent = 0;
+    qint64 bytesReceived = 0;
     bool send = false;
+    bool cached = false;
+};
+
+/**
+ * Appends the TraceRecords to the file named by OWNCLOUD_HTTP_TRACE_FILE
+ *
+ * The file is written through the buffer of QFile, so a record usually costs a memcpy.
+ */
+class TraceWriter
+{
+public:
+    /// Returns nullptr if the trace is disabled
+    static TraceWriter *instance()
+    {
+        static TraceWriter writer(qEnvironmentVariable("OWNCLOUD_HTTP_TRACE_FILE"));
+        return writer._file.isOpen() ? &writer : nullptr;
+    }
+
+    void write(const OCC::HttpLogger::TraceRecord &record)
+    {
+        QMutexLocker lock(&_mutex);
+        if (_file.pos() >= MaximumTraceSize) {
+            _file.close();
+            const QString previous = _file.fileName() + QStringLiteral(".1");
+            QFile::remove(previous);
+            QFile::rename(_file.fileName(), previous);
+            if (!open()) {
+                return;
+            }
+        }
+        _file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+
+    void flush()
+    {
+        QMutexLocker lock(&_mutex);
+        _file.flush();
+    }
+
+private:
+    explicit TraceWriter(const QString &path)
+        : _file(path)
+    {
+        if (!path.isEmpty() && !open()) {
+            qCWarning(lcNetworkHttp) << "Failed to open the http trace" << path << _file.errorString();
+        }
+    }
+
+    bool open()
+    {
+        if (!_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            return false;
+        }
+        if (_file.size() == 0) {
+            const OCC::HttpLogger::TraceHeader header = {OCC::HttpLogger::TraceHeader::Magic, OCC::HttpLogger::TraceHeader::Version,
+                sizeof(OCC::HttpLogger::TraceRecord), 0};
+            _file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        }
+        return true;
+    }
+
+    QMutex _mutex;
+    QFile _file;
 };
 
+void traceHttp(TraceWriter *writer, const QByteArray &verb, const HttpContext *ctx, QNetworkReply *reply)
+{
+    OCC::HttpLogger::TraceRecord record = {};
+    record.startTime = ctx->startTime;
+    record.urlHash = OCC::HttpLogger::traceUrlHash(reply->request().url());
+    const QByteArray id = QUuid::fromString(ctx->id).toRfc4122();
+    std::memcpy(record.requestId, id.constData(), qMin<size_t>(id.size(), sizeof(record.requestId)));
+    record.requestSize = ctx->bytesSent;
+    record.replySize = ctx->bytesReceived;
+    record.queuedDuration = static_cast<uint32_t>(duration_cast<milliseconds>(ctx->queuedDuration).count());
+    record.duration = static_cast<uint32_t>(duration_cast<milliseconds>(ctx->timer.duration()).count());
+    record.httpStatus = static_cast<uint16_t>(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt());
+    record.networkError = static_cast<uint16_t>(reply->error());
+    record.verb = static_cast<uint8_t>(OCC::HttpLogger::traceVerbs().indexOf(verb) + 1);
+    if (reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool()) {
+        record.flags |= OCC::HttpLogger::TraceRecord::Http2;
+    }
+    if (ctx->cached || reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+        record.flags |= OCC::HttpLogger::TraceRecord::Cached;
+    }
+    if (!ctx->redirectUrls.isEmpty()) {
+        record.flags |= OCC::HttpLogger::TraceRecord::Redirected;
+    }
+    if (reply->error() != QNetworkReply::NoError) {
+        record.flags |= OCC::HttpLogger::TraceRecord::Error;
+    }
+    writer->write(record);
+}
+
 void logHttp(const QByteArray &verb, HttpContext *ctx, QJsonObject &&header, QIODevice *device, bool cached = false)
 {
     static const bool redact = !qEnvironmentVariableIsSet("OWNCLOUD_HTTPLOGGER_NO_REDACT");
@@ -91,7 +197,7 @@ void logHttp(const QByteArray &verb, HttpContext *ctx, QJsonObject &&header, QIO
             {QStringLiteral("durationString"), QDebug::toString(ctx->timer.duration())},
             {QStringLiteral("version"),
                 QStringLiteral("HTTP %1").arg(
-                    reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool() ? QStringLiteral("1.1") : QStringLiteral("2"))}};
+                    reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool() ? QStringLiteral("2") : QStringLiteral("1.1"))}};
         if (reply->error() != QNetworkReply::NoError) {
             replyInfo.insert(QStringLiteral("error"), reply->errorString());
         }
@@ -138,23 +244,35 @@ namespace OCC {
 
 void HttpLogger::logRequest(QNetworkReply *reply, QNetworkAccessManager::Operation operation, QIODevice *device)
 {
-    if (!lcNetworkHttp().isInfoEnabled()) {
+    if (HttpRecording::isRecording()) {
+        HttpRecording::record(reply, operation);
+    }
+
+    const bool logEnabled = lcNetworkHttp().isInfoEnabled();
+    auto *traceWriter = TraceWriter::instance();
+    if (!logEnabled && !traceWriter) {
         return;
     }
 
     auto ctx = std::make_unique<HttpContext>(reply->request());
 
-    const auto logError = [reply, operation, id = ctx->id]() {
+    const auto logError = [reply, operation, id = ctx->id, logEnabled]() {
+        if (!logEnabled) {
+            return;
+        }
         auto url = reply->request().url();
         qCInfo(lcNetworkHttp).noquote().nospace() << "An error occurred for " << url.toDisplayString() << ": " << reply->errorString() << " (" << reply->error()
                                                   << ", " << operation << "), request-id: " << id;
     };
 
     // device should still exist, lets still use a qpointer to ensure we have valid data
-    const auto logSend = [ctx = ctx.get(), operation, reply, device = QPointer<QIODevice>(device), deviceRaw = device, logError](bool cached = false) {
+    const auto logSend = [ctx = ctx.get(), operation, reply, device = QPointer<QIODevice>(device), deviceRaw = device, logError, logEnabled](
+                             bool cached = false) {
         Q_ASSERT(!deviceRaw || device);
         if (!ctx->send) {
             ctx->send = true;
+            ctx->cached = cached;
+            ctx->queuedDuration = ctx->timer.duration();
             ctx->timer.reset();
         } else if (ctx->lastUrl != reply->url()) {
             // this is a redirect
@@ -164,6 +282,12 @@ void HttpLogger::logRequest(QNetworkReply *reply, QNetworkAccessManager::Operati
             logError();
         }
 
+        if (device) {
+            ctx->bytesSent = qMax(ctx->bytesSent, device->size());
+        }
+        if (!logEnabled) {
+            return;
+        }
         const auto request = reply->request();
         QJsonObject header;
         for (const auto &key : request.rawHeaderList()) {
@@ -173,20 +297,33 @@ void HttpLogger::logRequest(QNetworkReply *reply, QNetworkAccessManager::Operati
     };
     QObject::connect(reply, &QNetworkReply::requestSent, reply, logSend, Qt::DirectConnection);
     QObject::connect(reply, &QNetworkReply::errorOccurred, reply, logError, Qt::DirectConnection);
+    if (traceWriter) {
+        QObject::connect(
+            reply, &QNetworkReply::uploadProgress, reply, [ctx = ctx.get()](qint64 bytesSent, qint64) { ctx->bytesSent = qMax(ctx->bytesSent, bytesSent); },
+            Qt::DirectConnection);
+        QObject::connect(
+            reply, &QNetworkReply::downloadProgress, reply, [ctx = ctx.get()](qint64 bytesReceived, qint64) { ctx->bytesReceived = bytesReceived; },
+            Qt::DirectConnection);
+    }
 
 
     QObject::connect(
         reply, &QNetworkReply::finished, reply,
-        [reply, ctx = std::move(ctx), logSend] {
+        [reply, ctx = std::move(ctx), logSend, logEnabled, traceWriter] {
             ctx->timer.stop();
             if (!ctx->send) {
                 logSend(true);
             }
-            QJsonObject header;
-            for (const auto &[key, value] : reply->rawHeaderPairs()) {
-                header[QString::fromUtf8(key)] = QString::fromUtf8(value);
+            if (logEnabled) {
+                QJsonObject header;
+                for (const auto &[key, value] : reply->rawHeaderPairs()) {
+                    header[QString::fromUtf8(key)] = QString::fromUtf8(value);
+                }
+                logHttp(requestVerb(*reply), ctx.get(), std::move(header), reply);
+            }
+            if (traceWriter) {
+                traceHttp(traceWriter, requestVerb(*reply), ctx.get(), reply);
             }
-            logHttp(requestVerb(*reply), ctx.get(), std::move(header), reply);
         },
         Qt::DirectConnection);
 }
@@ -212,4 +349,29 @@ QByteArray HttpLogger::requestVerb(QNetworkAccessManager::Operation operation, c
     Q_UNREACHABLE();
 }
 
+const QList<QByteArray> &HttpLogger::traceVerbs()
+{
+    static const QList<QByteArray> verbs = {QByteArrayLiteral("HEAD"), QByteArrayLiteral("GET"), QByteArrayLiteral("PUT"), QByteArrayLiteral("POST"),
+        QByteArrayLiteral("DELETE"), QByteArrayLiteral("PROPFIND"), QByteArrayLiteral("PROPPATCH"), QByteArrayLiteral("MKCOL"), QByteArrayLiteral("MOVE"),
+        QByteArrayLiteral("COPY"), QByteArrayLiteral("PATCH"), QByteArrayLiteral("OPTIONS"), QByteArrayLiteral("REPORT")};
+    return verbs;
+}
+
+uint64_t HttpLogger::traceUrlHash(const QUrl &url)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : url.toEncoded(QUrl::RemoveUserInfo | QUrl::RemoveQuery | QUrl::RemoveFragment)) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void HttpLogger::flushTrace()
+{
+    if (auto *writer = TraceWriter::instance()) {
+        writer->flush();
+    }
+}
+
 }
@@ -18,10 +18,80 @@
 #include <QNetworkReply>
 #include <QUrl>
 
+#include <cstdint>
+
 namespace OCC {
 namespace HttpLogger {
     void OWNCLOUDSYNC_EXPORT logRequest(QNetworkReply *reply, QNetworkAccessManager::Operation operation, QIODevice *device);
 
+    /**
+     * Compact binary trace of the http requests
+     *
+     * If OWNCLOUD_HTTP_TRACE_FILE is set, one TraceRecord is appended to that file for every
+     * finished request, independent of whether the sync.httplogger category is enabled.
+     * This is cheap enough to keep the trace running in production, the records can be
+     * decoded with the httptracedump tool.
+     *
+     * The file starts with a TraceHeader, all values are stored in host byte order.
+     */
+    struct TraceHeader
+    {
+        static constexpr uint32_t Magic = 0x5448434f; // "OCHT"
+        static constexpr uint32_t Version = 1;
+
+        uint32_t magic;
+        uint32_t version;
+        // the size of a TraceRecord, to detect files written on a different platform
+        uint32_t recordSize;
+        uint32_t reserved;
+    };
+
+    struct TraceRecord
+    {
+        enum Flag : uint8_t {
+            Http2 = 1 << 0,
+            Cached = 1 << 1,
+            Redirected = 1 << 2,
+            Error = 1 << 3,
+        };
+
+        // ms since epoch when the request was created
+        int64_t startTime;
+        // see traceUrlHash()
+        uint64_t urlHash;
+        // the X-Request-ID in RFC 4122 format
+        uint8_t requestId[16];
+        int64_t requestSize;
+        int64_t replySize;
+        // the time the request was waiting to be sent and the time until it finished, in ms
+        uint32_t queuedDuration;
+        uint32_t duration;
+        uint16_t httpStatus;
+        // QNetworkReply::NetworkError
+        uint16_t networkError;
+        // the index of the verb in traceVerbs() plus one, 0 for other verbs
+        uint8_t verb;
+        uint8_t flags;
+        uint16_t reserved;
+    };
+    static_assert(sizeof(TraceHeader) == 16 && sizeof(TraceRecord) == 64, "TraceRecord is part of the trace file format");
+
+    /**
+     * The verbs that can be stored in a TraceRecord, only ever append to this list
+     */
+    OWNCLOUDSYNC_EXPORT const QList<QByteArray> &traceVerbs();
+
+    /**
+     * A 64 bit FNV-1a hash of the encoded url without user info and query,
+     * used to group the requests to a resource without storing its name.
+     */
+    uint64_t OWNCLOUDSYNC_EXPORT traceUrlHash(const QUrl &url);
+
+    /**
+     * Write the buffered trace records to the file, e.g. before reading it
+     */
+    void OWNCLOUDSYNC_EXPORT flushTrace();
+
     /**
     * Helper to construct the HTTP verb used in the request
     */
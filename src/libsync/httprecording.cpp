@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "httprecording.h"
+
+#include "common/chronoelapsedtimer.h"
+#include "common/pathhash.h"
+#include "httplogger.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <memory>
+
+using namespace std::chrono;
+
+namespace {
+Q_LOGGING_CATEGORY(lcHttpRecording, "sync.httprecording", QtInfoMsg)
+
+// a larger text body is recorded with its size only
+const qsizetype MaximumBodySize = 16 * 1024 * 1024;
+
+// the reply headers the client needs, the others might identify the server or the user
+bool isRecordedHeader(const QByteArray &name)
+{
+    static const QList<QByteArray> headers = {QByteArrayLiteral("content-type"), QByteArrayLiteral("etag"), QByteArrayLiteral("oc-etag"),
+        QByteArrayLiteral("oc-fileid"), QByteArrayLiteral("x-oc-mtime"), QByteArrayLiteral("last-modified")};
+    return headers.contains(name.toLower());
+}
+
+bool isTextBody(const QString &contentType)
+{
+    return contentType.startsWith(QLatin1String("text/")) || contentType.contains(QLatin1String("xml")) || contentType.contains(QLatin1String("json"));
+}
+
+/**
+ * Collects the body of a reply while it is read by its job
+ *
+ * The job might consume the body in readyRead(), the capture is connected before the job
+ * and takes the bytes that were added to the buffer of the reply since its last call.
+ */
+struct Capture
+{
+    void read(QNetworkReply *reply)
+    {
+        if (!typeKnown) {
+            typeKnown = true;
+            text = isTextBody(reply->header(QNetworkRequest::ContentTypeHeader).toString());
+        }
+        if (!text) {
+            return;
+        }
+        const QByteArray buffered = reply->peek(reply->bytesAvailable());
+        // the reader of the reply might have consumed a part of what was buffered at the last call
+        qsizetype consumed = 0;
+        while (consumed < unread.size() && !buffered.startsWith(QByteArrayView(unread).mid(consumed))) {
+            ++consumed;
+        }
+        body.append(QByteArrayView(buffered).mid(unread.size() - consumed));
+        unread = buffered;
+        if (body.size() > MaximumBodySize) {
+            text = false;
+            size = body.size();
+            body.clear();
+            unread.clear();
+        }
+    }
+
+    OCC::Utility::ChronoElapsedTimer timer;
+    bool typeKnown = false;
+    bool text = false;
+    QByteArray body;
+    // the size of a body that was too large to keep
+    qsizetype size = 0;
+    // what was buffered in the reply at the last read
+    QByteArray unread;
+};
+
+/**
+ * Appends the exchanges to the file named by OWNCLOUD_HTTP_RECORD_FILE
+ */
+class RecordWriter
+{
+public:
+    /// Returns nullptr if the recording is disabled
+    static RecordWriter *instance()
+    {
+        static RecordWriter writer(qEnvironmentVariable("OWNCLOUD_HTTP_RECORD_FILE"));
+        return writer._file.isOpen() ? &writer : nullptr;
+    }
+
+    void write(const OCC::HttpRecording::Exchange &exchange)
+    {
+        const QByteArray line = QJsonDocument(exchange.toJson()).toJson(QJsonDocument::Compact) + '\n';
+        QMutexLocker lock(&_mutex);
+        _file.write(line);
+    }
+
+    void flush()
+    {
+        QMutexLocker lock(&_mutex);
+        _file.flush();
+    }
+
+    const OCC::HttpRecording::Anonymizer anonymizer{QRandomGenerator::system()->generate64()};
+
+private:
+    explicit RecordWriter(const QString &path)
+        : _file(path)
+    {
+        if (path.isEmpty()) {
+            return;
+        }
+        if (!_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qCWarning(lcHttpRecording) << "Failed to open the http recording" << path << _file.errorString();
+            return;
+        }
+        qCInfo(lcHttpRecording) << "Recording the WebDAV requests to" << path;
+    }
+
+    QMutex _mutex;
+    QFile _file;
+};
+}
+
+namespace OCC {
+
+QJsonObject HttpRecording::Exchange::toJson() const
+{
+    QJsonArray headersJson;
+    for (const auto &[name, value] : headers) {
+        headersJson.append(QJsonArray{QString::fromUtf8(name), QString::fromUtf8(value)});
+    }
+    QJsonObject out{{QStringLiteral("verb"), QString::fromUtf8(verb)}, {QStringLiteral("path"), path}, {QStringLiteral("status"), status},
+        {QStringLiteral("headers"), headersJson}, {QStringLiteral("bodySize"), bodySize},
+        {QStringLiteral("duration"), static_cast<qint64>(duration.count())}};
+    if (!body.isEmpty()) {
+        out.insert(QStringLiteral("body"), QString::fromUtf8(body));
+    }
+    return out;
+}
+
+HttpRecording::Exchange HttpRecording::Exchange::fromJson(const QJsonObject &json)
+{
+    Exchange out;
+    out.verb = json.value(QLatin1String("verb")).toString().toUtf8();
+    out.path = json.value(QLatin1String("path")).toString();
+    out.status = json.value(QLatin1String("status")).toInt();
+    for (const auto &header : json.value(QLatin1String("headers")).toArray()) {
+        const auto pair = header.toArray();
+        out.headers.append({pair.at(0).toString().toUtf8(), pair.at(1).toString().toUtf8()});
+    }
+    out.body = json.value(QLatin1String("body")).toString().toUtf8();
+    out.bodySize = json.value(QLatin1String("bodySize")).toInteger();
+    out.duration = milliseconds(json.value(QLatin1String("duration")).toInteger());
+    return out;
+}
+
+std::optional<QPair<QString, QString>> HttpRecording::splitDavPath(const QString &path)
+{
+    static const QRegularExpression davRoot(QStringLiteral("^(.*?/remote\\.php/(?:webdav|dav/(?:files|spaces|uploads)/[^/]+))(?:/(.*))?$"));
+    const auto match = davRoot.match(path);
+    if (!match.hasMatch()) {
+        return {};
+    }
+    return QPair<QString, QString>{match.captured(1), match.captured(2)};
+}
+
+HttpRecording::Anonymizer::Anonymizer(quint64 seed)
+    : _seed(seed)
+{
+}
+
+QString HttpRecording::Anonymizer::name(const QString &name) const
+{
+    if (name.isEmpty()) {
+        return name;
+    }
+    const QByteArray utf8 = name.toUtf8();
+    QString out = QStringLiteral("n%1").arg(static_cast<qulonglong>(PathHash::hash(utf8.constData(), utf8.size(), _seed) & 0xffffffffffffULL), 12, 16, QLatin1Char('0'));
+    if (name.startsWith(QLatin1Char('.'))) {
+        out.prepend(QLatin1Char('.'));
+    }
+    const qsizetype dot = name.lastIndexOf(QLatin1Char('.'));
+    if (dot > 0) {
+        const auto extension = QStringView(name).mid(dot + 1);
+        if (!extension.isEmpty() && extension.size() <= 5
+            && std::all_of(extension.cbegin(), extension.cend(), [](QChar c) { return c.isDigit() || (c.isLetter() && c.unicode() < 0x80); })) {
+            out += QLatin1Char('.') + extension;
+        }
+    }
+    return out;
+}
+
+QString HttpRecording::Anonymizer::path(const QString &path) const
+{
+    QStringList segments = path.split(QLatin1Char('/'));
+    for (auto &segment : segments) {
+        segment = name(segment);
+    }
+    return segments.join(QLatin1Char('/'));
+}
+
+QByteArray HttpRecording::Anonymizer::body(const QByteArray &body) const
+{
+    static const QRegularExpression href(QStringLiteral("(<(?:\\w+:)?href>)([^<]*)(</(?:\\w+:)?href>)"));
+    const QString in = QString::fromUtf8(body);
+    QString out;
+    qsizetype last = 0;
+    for (const auto &match : href.globalMatch(in)) {
+        const auto split = splitDavPath(QString::fromUtf8(QByteArray::fromPercentEncoding(match.captured(2).toUtf8())));
+        if (!split) {
+            continue;
+        }
+        out += QStringView(in).mid(last, match.capturedStart(2) - last);
+        out += davRootPlaceholder() + QLatin1Char('/') + QString::fromUtf8(path(split->second).toUtf8().toPercentEncoding("/"));
+        last = match.capturedEnd(2);
+    }
+    out += QStringView(in).mid(last);
+    return out.toUtf8();
+}
+
+bool HttpRecording::isRecording()
+{
+    return RecordWriter::instance() != nullptr;
+}
+
+void HttpRecording::record(QNetworkReply *reply, QNetworkAccessManager::Operation operation)
+{
+    auto *writer = RecordWriter::instance();
+    if (!writer) {
+        return;
+    }
+    auto capture = std::make_shared<Capture>();
+    QObject::connect(reply, &QNetworkReply::readyRead, reply, [reply, capture] { capture->read(reply); }, Qt::DirectConnection);
+    QObject::connect(
+        reply, &QNetworkReply::finished, reply,
+        [reply, operation, capture, writer] {
+            capture->timer.stop();
+            const auto split = splitDavPath(reply->request().url().path());
+            if (!split) {
+                return;
+            }
+            capture->read(reply);
+
+            Exchange exchange;
+            exchange.verb = HttpLogger::requestVerb(operation, reply->request());
+            exchange.path = writer->anonymizer.path(split->second);
+            exchange.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            for (const auto &[name, value] : reply->rawHeaderPairs()) {
+                if (isRecordedHeader(name)) {
+                    exchange.headers.append({name, value});
+                }
+            }
+            exchange.body = writer->anonymizer.body(capture->body);
+            exchange.bodySize = std::max({qint64(capture->body.size()), qint64(capture->size), reply->header(QNetworkRequest::ContentLengthHeader).toLongLong()});
+            exchange.duration = duration_cast<milliseconds>(capture->timer.duration());
+            writer->write(exchange);
+        },
+        Qt::DirectConnection);
+}
+
+void HttpRecording::flush()
+{
+    if (auto *writer = RecordWriter::instance()) {
+        writer->flush();
+    }
+}
+
+QVector<HttpRecording::Exchange> HttpRecording::load(const QString &path)
+{
+    QVector<Exchange> out;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcHttpRecording) << "Failed to open the http recording" << path << file.errorString();
+        return out;
+    }
+    while (!file.atEnd()) {
+        const auto json = QJsonDocument::fromJson(file.readLine());
+        if (json.isObject()) {
+            out.append(Exchange::fromJson(json.object()));
+        }
+    }
+    return out;
+}
+}
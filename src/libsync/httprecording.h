@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QJsonObject>
+#include <QList>
+#include <QNetworkReply>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include <chrono>
+#include <optional>
+
+namespace OCC {
+
+/**
+ * @brief Records the WebDAV exchanges of real syncs, to replay them in the tests
+ * @ingroup libsync
+ *
+ * If OWNCLOUD_HTTP_RECORD_FILE is set, every finished WebDAV request is appended to
+ * that file as one line of json, see Exchange. The names of the files and folders
+ * are replaced by pseudonyms, in the urls as well as in the hrefs of the listings.
+ * The pseudonyms are salted per run of the client, so they can't be looked up.
+ * Only the bodies of the text replies are kept, of the other replies just the size.
+ *
+ * The test utils replay a recording through the fake access manager, see HttpReplay.
+ */
+namespace HttpRecording {
+    /** Stands in for the dav root of the recorded account, e.g. /remote.php/dav/files/admin, in the hrefs of a body */
+    inline QString davRootPlaceholder()
+    {
+        return QStringLiteral("{dav}");
+    }
+
+    struct OWNCLOUDSYNC_EXPORT Exchange
+    {
+        QByteArray verb;
+        /** The anonymized path below the dav root, without a leading slash */
+        QString path;
+        int status = 0;
+        QList<QPair<QByteArray, QByteArray>> headers;
+        /** The body of a text reply, with the hrefs anonymized */
+        QByteArray body;
+        qint64 bodySize = 0;
+        std::chrono::milliseconds duration = {};
+
+        QJsonObject toJson() const;
+        static Exchange fromJson(const QJsonObject &json);
+    };
+
+    /**
+     * Splits an url path into the dav root and the path below it
+     *
+     * For example /owncloud/remote.php/dav/files/admin/A/b into /owncloud/remote.php/dav/files/admin and A/b.
+     * Returns nothing for the paths that are not below a dav root.
+     */
+    OWNCLOUDSYNC_EXPORT std::optional<QPair<QString, QString>> splitDavPath(const QString &path);
+
+    /** Replaces the names with pseudonyms that are stable for a seed */
+    class OWNCLOUDSYNC_EXPORT Anonymizer
+    {
+    public:
+        explicit Anonymizer(quint64 seed);
+
+        /** The pseudonym keeps a short extension of the name, the client treats some of them differently */
+        QString name(const QString &name) const;
+        QString path(const QString &path) const;
+        /** Anonymizes the hrefs below a dav root in a multistatus body and replaces the root with davRootPlaceholder() */
+        QByteArray body(const QByteArray &body) const;
+
+    private:
+        quint64 _seed;
+    };
+
+    /** Whether OWNCLOUD_HTTP_RECORD_FILE is set and could be opened */
+    OWNCLOUDSYNC_EXPORT bool isRecording();
+
+    /** Records \a reply once it finished, called for all requests by HttpLogger::logRequest() */
+    void OWNCLOUDSYNC_EXPORT record(QNetworkReply *reply, QNetworkAccessManager::Operation operation);
+
+    /** Writes the buffered exchanges to the file, e.g. before reading it */
+    void OWNCLOUDSYNC_EXPORT flush();
+
+    /** Reads a recording, the lines that can't be parsed are skipped */
+    OWNCLOUDSYNC_EXPORT QVector<Exchange> load(const QString &path);
+}
+}
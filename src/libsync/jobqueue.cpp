@@ -17,7 +17,11 @@
 #include "abstractnetworkjob.h"
 #include "account.h"
 
+#include <QDateTime>
 #include <QLoggingCategory>
+#include <QRandomGenerator>
+
+#include <algorithm>
 
 namespace OCC {
 
@@ -26,6 +30,34 @@ Q_LOGGING_CATEGORY(lcJobQUeue, "sync.networkjob.jobqueue", QtDebugMsg)
 JobQueue::JobQueue(Account *account)
     : _account(account)
 {
+    _releaseTimer.setSingleShot(true);
+    _releaseTimer.setInterval(ReleaseInterval);
+    QObject::connect(&_releaseTimer, &QTimer::timeout, [this] {
+        if (!isBlocked()) {
+            releaseJobs();
+        }
+    });
+    _backOffTimer.setSingleShot(true);
+    QObject::connect(&_backOffTimer, &QTimer::timeout, [this] {
+        qCInfo(lcJobQUeue) << "End of the back off" << _account->displayNameWithHost();
+        unblock();
+    });
+}
+
+std::chrono::milliseconds JobQueue::maximumDelay(RequestClass requestClass)
+{
+    using namespace std::chrono_literals;
+    switch (requestClass) {
+    case RequestClass::Authentication:
+        [[fallthrough]];
+    case RequestClass::Interactive:
+        return 0ms;
+    case RequestClass::Discovery:
+        return 2s;
+    case RequestClass::Transfer:
+        return 10s;
+    }
+    Q_UNREACHABLE();
 }
 
 void JobQueue::block()
@@ -42,12 +74,54 @@ void JobQueue::unblock()
     _blocked--;
     qCDebug(lcJobQUeue) << "unblock:" << _blocked << _account->displayNameWithHost();
     if (_blocked == 0) {
-        auto tmp = std::move(_jobs);
-        for (auto job : tmp) {
-            if (job) {
-                qCDebug(lcJobQUeue) << "Retry" << job;
-                job->retry();
+        releaseJobs();
+    }
+}
+
+void JobQueue::push(AbstractNetworkJob *job)
+{
+    const auto requestClass = job->requestClass();
+    _jobs.push_back({job, requestClass, std::chrono::steady_clock::now() + maximumDelay(requestClass)});
+}
+
+void JobQueue::releaseJobs()
+{
+    const auto now = std::chrono::steady_clock::now();
+    // overdue jobs first, by their deadline, then the others by class and deadline
+    std::stable_sort(_jobs.begin(), _jobs.end(), [now](const Entry &a, const Entry &b) {
+        const bool aOverdue = a.deadline <= now;
+        const bool bOverdue = b.deadline <= now;
+        if (aOverdue != bOverdue) {
+            return aOverdue;
+        }
+        if (!aOverdue && a.requestClass != b.requestClass) {
+            return a.requestClass < b.requestClass;
+        }
+        return a.deadline < b.deadline;
+    });
+
+    std::vector<QPointer<AbstractNetworkJob>> due;
+    size_t batch = 0;
+    auto it = _jobs.begin();
+    for (; it != _jobs.end(); ++it) {
+        if (it->requestClass > RequestClass::Interactive) {
+            if (batch == ReleaseBatchSize) {
+                break;
             }
+            ++batch;
+        }
+        due.push_back(it->job);
+    }
+    _jobs.erase(_jobs.begin(), it);
+    // the released jobs might block the queue again, the timer only continues while unblocked
+    if (!_jobs.empty()) {
+        _releaseTimer.start();
+    }
+
+    for (const auto &job : due) {
+        if (job) {
+            qCDebug(lcJobQUeue) << "Retry" << job;
+            job->retry();
         }
     }
 }
@@ -64,7 +138,7 @@ bool JobQueue::retry(AbstractNetworkJob *job)
     }
     if (_blocked) {
         qCDebug(lcJobQUeue) << "Retry queued" << job;
-        _jobs.push_back(job);
+        push(job);
     } else {
         qCDebug(lcJobQUeue) << "Direct retry" << job;
         job->retry();
@@ -78,16 +152,74 @@ bool JobQueue::enqueue(AbstractNetworkJob *job)
         return false;
     }
     qCDebug(lcJobQUeue) << "Queue" << job;
-    _jobs.push_back(job);
+    push(job);
     return true;
 }
 
+void JobQueue::backOff(std::optional<std::chrono::seconds> retryAfter)
+{
+    using namespace std::chrono;
+    milliseconds delay;
+    if (retryAfter.has_value()) {
+        delay = std::clamp<milliseconds>(*retryAfter, 0s, MaximumBackOff);
+    } else if (isBackingOff()) {
+        // the replies to the requests that were sent before we backed off
+        return;
+    } else {
+        delay = std::min<milliseconds>(InitialBackOff * (1 << std::min(_backOffCount, 8)), MaximumBackOff);
+    }
+    // spread the requests of all clients that were told the same
+    delay += milliseconds(QRandomGenerator::global()->bounded(delay.count() / 4 + 1));
+
+    if (isBackingOff()) {
+        if (delay <= _backOffTimer.remainingTimeAsDuration()) {
+            return;
+        }
+    } else {
+        ++_backOffCount;
+        block();
+    }
+    qCWarning(lcJobQUeue) << "The server is overloaded, holding back the requests of" << _account->displayNameWithHost() << "for" << delay.count() << "ms";
+    _backOffTimer.start(delay);
+}
+
+void JobQueue::serverResponded()
+{
+    if (!isBackingOff()) {
+        _backOffCount = 0;
+    }
+}
+
+bool JobQueue::isBackingOff() const
+{
+    return _backOffTimer.isActive();
+}
+
+std::optional<std::chrono::seconds> JobQueue::parseRetryAfter(const QByteArray &value)
+{
+    if (value.isEmpty()) {
+        return {};
+    }
+    bool ok;
+    const auto seconds = value.trimmed().toLongLong(&ok);
+    if (ok) {
+        return std::chrono::seconds(std::max<qint64>(seconds, 0));
+    }
+    const auto date = QDateTime::fromString(QString::fromLatin1(value.trimmed()), Qt::RFC2822Date);
+    if (!date.isValid()) {
+        return {};
+    }
+    return std::chrono::seconds(std::max<qint64>(QDateTime::currentDateTimeUtc().secsTo(date), 0));
+}
+
 void JobQueue::clear()
 {
     _blocked = 0;
+    _releaseTimer.stop();
+    _backOffTimer.stop();
     auto tmp = std::move(_jobs);
-    for (auto job : tmp) {
-        if (job) {
+    for (const auto &entry : tmp) {
+        if (auto job = entry.job) {
             qCDebug(lcJobQUeue) << "Abort" << job;
             job->abort();
         }
@@ -16,6 +16,10 @@
 #include "owncloudlib.h"
 
 #include <QPointer>
+#include <QTimer>
+
+#include <chrono>
+#include <optional>
 #include <vector>
 
 namespace OCC {
@@ -23,11 +27,44 @@ namespace OCC {
 class AbstractNetworkJob;
 class Account;
 
+/**
+ * @brief Holds back the network jobs of an account while it is blocked
+ *
+ * Once unblocked, e.g. after the credentials were refreshed, the jobs are
+ * retried by their RequestClass: authentication and interactive jobs at once,
+ * discovery and transfer jobs ReleaseBatchSize at a time every ReleaseInterval,
+ * so they don't crowd out the requests started by the user in the meantime.
+ * A job that waited longer than the maximum delay of its class is released
+ * before the jobs of more important classes.
+ *
+ * The queue is also blocked while the server is overloaded: a 429 or 503 reply
+ * holds back all new requests of the account for the time given by its
+ * Retry-After header, or with a jittered exponential back off if there is none.
+ * The number of parallel transfers is reduced by TransferConcurrency meanwhile.
+ */
 class OWNCLOUDSYNC_EXPORT JobQueue
 {
 public:
+    /** The classes of requests, in the order they are released */
+    enum class RequestClass {
+        Authentication,
+        /// Started by the user or shown in the UI, the default
+        Interactive,
+        Discovery,
+        Transfer
+    };
+
+    static constexpr size_t ReleaseBatchSize = 10;
+    static constexpr std::chrono::milliseconds ReleaseInterval{100};
+    /** The back off after the first overload reply, it doubles with each further one */
+    static constexpr std::chrono::seconds InitialBackOff{2};
+    static constexpr std::chrono::seconds MaximumBackOff{300};
+
     JobQueue(Account *account);
 
+    /** The time a queued job of \a requestClass may wait for more important ones */
+    static std::chrono::milliseconds maximumDelay(RequestClass requestClass);
+
     /**
      * whether jobs need to be enqued
      */
@@ -47,18 +84,45 @@ public:
 
     size_t size() const;
 
+    /**
+     * The server replied with 429 or 503, hold back the jobs for \a retryAfter
+     * or, if the server didn't tell, for the next step of the back off
+     */
+    void backOff(std::optional<std::chrono::seconds> retryAfter);
+    /** The server answered a request normally, the next back off starts over */
+    void serverResponded();
+    bool isBackingOff() const;
+
+    /** The value of a Retry-After header, either in seconds or as a http date */
+    static std::optional<std::chrono::seconds> parseRetryAfter(const QByteArray &value);
+
     /**
      * Clear the queue and abort all jobs
      */
     void clear();
 
 private:
+    struct Entry
+    {
+        QPointer<AbstractNetworkJob> job;
+        RequestClass requestClass;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
     void block();
     void unblock();
+    void push(AbstractNetworkJob *job);
+
+    /** Retry the jobs that are due, schedules the release of the others */
+    void releaseJobs();
 
     Account *_account;
     uint _blocked = 0;
-    std::vector<QPointer<AbstractNetworkJob>> _jobs;
+    std::vector<Entry> _jobs;
+    QTimer _releaseTimer;
+    QTimer _backOffTimer;
+    // the back offs since the server last answered normally
+    int _backOffCount = 0;
 
     friend class JobQueueGuard;
 };
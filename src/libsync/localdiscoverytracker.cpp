@@ -29,12 +29,51 @@ LocalDiscoveryTracker::LocalDiscoveryTracker()
 void LocalDiscoveryTracker::addTouchedPath(const QString &relativePath)
 {
     qCDebug(lcLocalDiscoveryTracker) << "inserted touched" << relativePath;
-    _localDiscoveryPaths.insert(relativePath);
+    insertPath(relativePath);
+}
+
+void LocalDiscoveryTracker::insertPath(const QString &path)
+{
+    if (path.isEmpty()) {
+        return;
+    }
+    // a listed folder is rediscovered completely
+    for (auto slash = path.indexOf(QLatin1Char('/')); slash != -1; slash = path.indexOf(QLatin1Char('/'), slash + 1)) {
+        if (_localDiscoveryPaths.count(path.left(slash))) {
+            return;
+        }
+    }
+    if (!_localDiscoveryPaths.insert(path).second) {
+        return;
+    }
+
+    // for the same reason, the paths below a listed folder are obsolete
+    const QString prefix = path + QLatin1Char('/');
+    for (auto it = _localDiscoveryPaths.lower_bound(prefix); it != _localDiscoveryPaths.end() && it->startsWith(prefix);) {
+        it = _localDiscoveryPaths.erase(it);
+    }
+    for (auto it = _entriesPerFolder.lower_bound(prefix); it != _entriesPerFolder.end() && it->first.startsWith(prefix);) {
+        it = _entriesPerFolder.erase(it);
+    }
+    _entriesPerFolder.erase(path);
+
+    const auto slash = path.lastIndexOf(QLatin1Char('/'));
+    const QString parent = slash == -1 ? QString() : path.left(slash);
+    if (++_entriesPerFolder[parent] >= collapseThreshold && !parent.isEmpty()) {
+        qCDebug(lcLocalDiscoveryTracker) << "collapsed the entries of" << parent;
+        insertPath(parent);
+    }
+}
+
+bool LocalDiscoveryTracker::preferFullDiscovery() const
+{
+    return static_cast<qsizetype>(_localDiscoveryPaths.size()) > fullDiscoveryThreshold;
 }
 
 void LocalDiscoveryTracker::startSyncFullDiscovery()
 {
     _localDiscoveryPaths.clear();
+    _entriesPerFolder.clear();
     _previousLocalDiscoveryPaths.clear();
     qCDebug(lcLocalDiscoveryTracker) << "full discovery";
 }
@@ -50,6 +89,7 @@ void LocalDiscoveryTracker::startSyncPartialDiscovery()
 
     _previousLocalDiscoveryPaths = std::move(_localDiscoveryPaths);
     _localDiscoveryPaths.clear();
+    _entriesPerFolder.clear();
 }
 
 const std::set<QString> &LocalDiscoveryTracker::localDiscoveryPaths() const
@@ -106,7 +146,7 @@ void LocalDiscoveryTracker::slotItemCompleted(const SyncFileItemPtr &item)
         Q_UNREACHABLE();
     }
 
-    _localDiscoveryPaths.insert(item->_file);
+    insertPath(item->_file);
     qCDebug(lcLocalDiscoveryTracker) << "inserted error item" << item->_file;
 }
 
@@ -117,9 +157,9 @@ void LocalDiscoveryTracker::slotSyncFinished(bool success)
     } else {
         // On overall-failure we can't forget about last sync's local discovery
         // paths yet, reuse them for the next sync again.
-        // C++17: Could use std::set::merge().
-        _localDiscoveryPaths.insert(
-            _previousLocalDiscoveryPaths.begin(), _previousLocalDiscoveryPaths.end());
+        for (const auto &path : std::as_const(_previousLocalDiscoveryPaths)) {
+            insertPath(path);
+        }
         qCDebug(lcLocalDiscoveryTracker) << "sync failed, keeping last sync's local discovery path list";
     }
     _previousLocalDiscoveryPaths.clear();
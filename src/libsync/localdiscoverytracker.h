@@ -16,6 +16,7 @@
 #define LOCALDISCOVERYTRACKER_H
 
 #include "owncloudlib.h"
+#include <map>
 #include <set>
 #include <QObject>
 #include <QByteArray>
@@ -44,6 +45,11 @@ typedef QSharedPointer<SyncFileItem> SyncFileItemPtr;
  * All paths used in this class are expected to be utf8 encoded byte arrays,
  * relative to the folder that is being synced, without a starting slash.
  *
+ * A listed path is rediscovered with everything below it. After a burst of changes,
+ * e.g. a checkout of another branch, a folder with many listed entries is listed
+ * itself instead, listing it costs less than looking up each entry in the database.
+ * If the list still grows too long, preferFullDiscovery() asks for a full local discovery.
+ *
  * @ingroup libsync
  */
 class OWNCLOUDSYNC_EXPORT LocalDiscoveryTracker : public QObject
@@ -68,6 +74,15 @@ public:
     /** Access list of files that shall be locally rediscovered. */
     const std::set<QString> &localDiscoveryPaths() const;
 
+    /** Whether so many paths are listed that a full local discovery is cheaper */
+    bool preferFullDiscovery() const;
+
+    /** A folder with this many listed entries directly in it is listed instead of them */
+    static constexpr qsizetype collapseThreshold = 64;
+
+    /** With more listed paths a full local discovery is preferred */
+    static constexpr qsizetype fullDiscoveryThreshold = 10000;
+
 public Q_SLOTS:
     /**
      * Success and failure of sync items adjust what the next sync is
@@ -81,6 +96,9 @@ public Q_SLOTS:
     void slotSyncFinished(bool success);
 
 private:
+    /// Lists \a path unless it or a parent folder is listed already
+    void insertPath(const QString &path);
+
     /**
      * The paths that should be checked by the next local discovery.
      *
@@ -89,6 +107,9 @@ private:
      */
     std::set<QString> _localDiscoveryPaths;
 
+    /// The number of listed paths directly in a folder, "" for the root
+    std::map<QString, qsizetype> _entriesPerFolder;
+
     /**
      * The paths that the current sync run used for local discovery.
      *
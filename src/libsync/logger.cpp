@@ -20,6 +20,7 @@
 #include <QtConcurrent>
 #include <QtGlobal>
 
+#include <chrono>
 #include <iostream>
 
 #include <zlib.h>
@@ -35,6 +36,13 @@ constexpr int crashLogSizeC = 20;
 constexpr int maxLogSizeC = 1024 * 1024 * 100; // 100 MiB
 constexpr int minLogsToKeepC = 5;
 
+// the number of messages the queue can hold, a power of two
+constexpr size_t queueSizeC = 1 << 14;
+// the writer collects up to that many messages into one write
+constexpr int maxBatchSizeC = 1024;
+// how long the writer sleeps if it is not woken up
+constexpr auto writerIdleTimeoutC = std::chrono::milliseconds(100);
+
 #ifdef Q_OS_WIN
 bool isDebuggerPresent()
 {
@@ -49,6 +57,79 @@ bool isDebuggerPresent()
 }
 namespace OCC {
 
+/**
+ * A bounded multi producer, single consumer queue
+ *
+ * Every cell carries a sequence number which tells whether it is free for the
+ * producer claiming that position or holds a message for the consumer, so
+ * neither side needs a lock.
+ */
+class LogQueue
+{
+public:
+    LogQueue()
+        : _cells(new Cell[queueSizeC])
+    {
+        for (size_t i = 0; i < queueSizeC; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /// Returns false if the queue is full
+    bool push(QString &&message)
+    {
+        auto pos = _enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            auto &cell = _cells[pos & (queueSizeC - 1)];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.message = std::move(message);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Must only be called by one consumer at a time
+    bool pop(QString &message)
+    {
+        const auto pos = _dequeuePos.load(std::memory_order_relaxed);
+        auto &cell = _cells[pos & (queueSizeC - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        message = std::move(cell.message);
+        cell.message = QString();
+        cell.sequence.store(pos + queueSizeC, std::memory_order_release);
+        _dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// Whether there is a message for the consumer, this is only a hint if called by somebody else
+    bool isEmpty() const
+    {
+        const auto pos = _dequeuePos.load(std::memory_order_relaxed);
+        return _cells[pos & (queueSizeC - 1)].sequence.load(std::memory_order_seq_cst) != pos + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        QString message;
+    };
+    std::unique_ptr<Cell[]> _cells;
+    alignas(64) std::atomic<size_t> _enqueuePos = 0;
+    alignas(64) std::atomic<size_t> _dequeuePos = 0;
+};
+
 Logger *Logger::instance()
 {
     static auto *log = [] {
@@ -64,10 +145,13 @@ Logger *Logger::instance()
 
 Logger::Logger(QObject *parent)
     : QObject(parent)
+    , _queue(new LogQueue)
     , _maxLogFiles(std::max(ConfigFile().automaticDeleteOldLogs(), minLogsToKeepC))
 {
     qSetMessagePattern(loggerPattern());
     _crashLog.resize(crashLogSizeC);
+    _writerRunning = true;
+    _writerThread = std::thread([this] { writerLoop(); });
 #ifndef NO_MSG_HANDLER
     qInstallMessageHandler([](QtMsgType type, const QMessageLogContext &ctx, const QString &message) {
             Logger::instance()->doLog(type, ctx, message);
@@ -80,6 +164,7 @@ Logger::~Logger()
 #ifndef NO_MSG_HANDLER
     qInstallMessageHandler(nullptr);
 #endif
+    stopWriter();
 }
 
 QString Logger::loggerPattern()
@@ -89,43 +174,148 @@ QString Logger::loggerPattern()
 
 bool Logger::isLoggingToFile() const
 {
-    QMutexLocker lock(&_mutex);
-    return !_logstream.isNull();
+    MutexLocker lock(&_mutex);
+    return _logFile.isOpen();
+}
+
+int &Logger::heldLocks()
+{
+    static thread_local int locks = 0;
+    return locks;
 }
 
 void Logger::doLog(QtMsgType type, const QMessageLogContext &ctx, const QString &message)
 {
-    const QString msg = qFormatLogMessage(type, ctx, message) + QLatin1Char('\n');
-    {
-        QMutexLocker lock(&_mutex);
-        _crashLogIndex = (_crashLogIndex + 1) % crashLogSizeC;
-        _crashLog[_crashLogIndex] = msg;
-        if (_logstream) {
-            (*_logstream) << msg;
-            if (_doFileFlush)
-                _logstream->flush();
-        }
+    QString msg = qFormatLogMessage(type, ctx, message) + QLatin1Char('\n');
 #if defined(Q_OS_WIN)
-        if (isDebuggerPresent()) {
-            OutputDebugStringW(reinterpret_cast<const wchar_t *>(msg.utf16()));
-        }
+    if (isDebuggerPresent()) {
+        OutputDebugStringW(reinterpret_cast<const wchar_t *>(msg.utf16()));
+    }
 #endif
-        if (type == QtFatalMsg) {
-            dumpCrashLog();
-            close();
+    if (heldLocks() > 0) {
+        // Logged by the writer thread or while a setting is changed, the writer
+        // would wait for us. Holding the mutex makes us the consumer, so write directly.
+        MutexLocker lock(&_mutex);
+        while (!_queue->push(std::move(msg))) {
+            writePending();
+        }
+        writePending();
+    } else {
+        while (!_queue->push(std::move(msg))) {
+            if (!_writerRunning) {
+                MutexLocker lock(&_mutex);
+                writePending();
+                continue;
+            }
+            // the writer can't keep up, give it some time
+            wakeWriter();
+            std::this_thread::yield();
+        }
+        if (_writerRunning) {
+            wakeWriter();
+        } else {
+            // the writer is gone, we are the consumer now
+            MutexLocker lock(&_mutex);
+            writePending();
+        }
+    }
+
+    if (type == QtFatalMsg) {
+        // make sure everything up to this message is written, with the mutex held that happened above
+        if (heldLocks() == 0) {
+            stopWriter();
+        }
+        MutexLocker lock(&_mutex);
+        dumpCrashLog();
+        close();
 #if defined(Q_OS_WIN)
-            // Make application terminate in a way that can be caught by the crash reporter
-            Utility::crash();
+        // Make application terminate in a way that can be caught by the crash reporter
+        Utility::crash();
 #endif
+    }
+}
+
+void Logger::writerLoop()
+{
+    while (true) {
+        {
+            MutexLocker lock(&_mutex);
+            writePending();
+        }
+        std::unique_lock<std::mutex> lock(_wakeMutex);
+        if (_stopWriter) {
+            // stopWriter() writes what is left
+            return;
         }
-        if (!_logDirectory.isEmpty()) {
-            if (_logFile.size() > maxLogSizeC) {
+        _writerSleeping = true;
+        if (_queue->isEmpty()) {
+            _wakeCondition.wait_for(lock, writerIdleTimeoutC);
+        }
+        _writerSleeping = false;
+    }
+}
+
+void Logger::writePending()
+{
+    QByteArray batch;
+    QString msg;
+    while (true) {
+        int count = 0;
+        while (count < maxBatchSizeC && _queue->pop(msg)) {
+            ++count;
+            _crashLogIndex = (_crashLogIndex + 1) % crashLogSizeC;
+            if (_logFile.isOpen()) {
+                batch.append(msg.toUtf8());
+            }
+            _crashLog[_crashLogIndex] = std::move(msg);
+        }
+        if (count == 0) {
+            return;
+        }
+        if (!batch.isEmpty()) {
+            _logFile.write(batch);
+            batch.clear();
+            if (_doFileFlush) {
+                _logFile.flush();
+            }
+            if (!_logDirectory.isEmpty() && _logFile.size() > maxLogSizeC) {
                 rotateLog();
             }
         }
     }
 }
 
+void Logger::wakeWriter()
+{
+    // Only take the lock if the writer is waiting, see writerLoop().
+    // The fence orders the push before the check, the writer does the opposite.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_writerSleeping.load(std::memory_order_relaxed) && _writerSleeping.exchange(false)) {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _wakeCondition.notify_one();
+    }
+}
+
+void Logger::stopWriter()
+{
+    if (!_writerRunning.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _stopWriter = true;
+        _wakeCondition.notify_one();
+    }
+    if (_writerThread.get_id() == std::this_thread::get_id()) {
+        _writerThread.detach();
+        return;
+    }
+    _writerThread.join();
+    // messages that arrived while the writer was stopping
+    MutexLocker lock(&_mutex);
+    writePending();
+}
+
 void Logger::open(const QString &name)
 {
     bool openSucceeded = false;
@@ -142,26 +332,25 @@ void Logger::open(const QString &name)
         std::cerr << "Failed to open the log file" << std::endl;
         return;
     }
-    _logstream.reset(new QTextStream(&_logFile));
-    _logstream->setEncoding(QStringConverter::Utf8);
-    (*_logstream) << Theme::instance()->aboutVersions(Theme::VersionFormat::OneLiner) << " " << qApp->applicationName() << Qt::endl;
+    _logFile.write(QStringLiteral("%1 %2\n").arg(Theme::instance()->aboutVersions(Theme::VersionFormat::OneLiner), qApp->applicationName()).toUtf8());
+    _logFile.flush();
 }
 
 void Logger::close()
 {
-    if (_logstream)
-    {
-        _logstream->flush();
+    // holding the mutex makes us the consumer, the writer keeps running for the messages after the close
+    MutexLocker locker(&_mutex);
+    writePending();
+    if (_logFile.isOpen()) {
+        _logFile.flush();
         _logFile.close();
-        _logstream.reset();
     }
 }
 
 void Logger::setLogFile(const QString &name)
 {
-    QMutexLocker locker(&_mutex);
-    if (_logstream) {
-        _logstream.reset(nullptr);
+    MutexLocker locker(&_mutex);
+    if (_logFile.isOpen()) {
         _logFile.close();
     }
 
@@ -179,10 +368,17 @@ void Logger::setMaxLogFiles(int i)
 
 void Logger::setLogDir(const QString &dir)
 {
+    MutexLocker locker(&_mutex);
     _logDirectory = dir;
     rotateLog();
 }
 
+QString Logger::logDir() const
+{
+    MutexLocker locker(&_mutex);
+    return _logDirectory;
+}
+
 void Logger::setLogFlush(bool flush)
 {
     _doFileFlush = flush;
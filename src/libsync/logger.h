@@ -25,11 +25,26 @@
 
 #include "owncloudlib.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class TestLogger;
+
 namespace OCC {
 
+class LogQueue;
+
 /**
  * @brief The Logger class
  * @ingroup libsync
+ *
+ * doLog() only formats the message and puts it into a lock free queue, a
+ * writer thread collects the messages and writes them in batches. That way
+ * debug logging does not serialize the threads that log. Messages logged by
+ * the writer thread itself or while _mutex is held are written directly.
  */
 class OWNCLOUDSYNC_EXPORT Logger : public QObject
 {
@@ -47,6 +62,8 @@ public:
 
     void setLogFile(const QString &name);
     void setLogDir(const QString &dir);
+    /** The directory the logs are written to, empty if there is none */
+    QString logDir() const;
     void setLogFlush(bool flush);
 
     /**
@@ -83,6 +100,25 @@ public:
     void setLogRules(const QSet<QString> &rules);
 
 private:
+    friend class ::TestLogger;
+
+    /// Locks _mutex and counts that the current thread holds it
+    class MutexLocker
+    {
+    public:
+        explicit MutexLocker(QRecursiveMutex *mutex)
+            : _locker(mutex)
+        {
+            ++heldLocks();
+        }
+        ~MutexLocker() { --heldLocks(); }
+
+    private:
+        QMutexLocker<QRecursiveMutex> _locker;
+    };
+    // how often the current thread holds _mutex, a message logged meanwhile can't wait for the writer
+    static int &heldLocks();
+
     Logger(QObject *parent = nullptr);
     ~Logger() override;
 
@@ -92,14 +128,31 @@ private:
     void close();
     void dumpCrashLog();
 
+    void writerLoop();
+    // writes the queued messages, the caller must hold _mutex which makes it the consumer of the queue
+    void writePending();
+    void wakeWriter();
+    // waits until the writer thread wrote all queued messages and stops it
+    void stopWriter();
+
     QFile _logFile;
-    bool _doFileFlush = false;
+    std::atomic<bool> _doFileFlush = false;
     bool _logDebug = false;
-    QScopedPointer<QTextStream> _logstream;
+    // guards the log file, the consumer side of the queue and the settings used by the writer thread
     mutable QRecursiveMutex _mutex;
+
+    std::unique_ptr<LogQueue> _queue;
+    std::thread _writerThread;
+    std::atomic<bool> _writerRunning = false;
+    std::atomic<bool> _stopWriter = false;
+    std::atomic<bool> _writerSleeping = false;
+    std::mutex _wakeMutex;
+    std::condition_variable _wakeCondition;
+
     QString _logDirectory;
     bool _temporaryFolderLogDir = false;
     QSet<QString> _logRules;
+    // only accessed by the consumer of the queue
     QVector<QString> _crashLog;
     int _crashLogIndex = 0;
     bool _consoleIsAttached = false;
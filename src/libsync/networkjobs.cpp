@@ -15,13 +15,20 @@
 
 #include <QBuffer>
 #include <QCoreApplication>
+#include <QDate>
 #include <QNetworkRequest>
 #include <QPainter>
 #include <QPainterPath>
+#include <QTime>
+#include <QTimer>
+
+#include <optional>
 
 #include "creds/httpcredentials.h"
 
 #include "account.h"
+#include "common/checksums.h"
+#include "common/utility.h"
 #include "networkjobs.h"
 
 
@@ -35,6 +42,17 @@ Q_LOGGING_CATEGORY(lcAvatarJob, "sync.networkjob.avatar", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcMkColJob, "sync.networkjob.mkcol", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcDetermineAuthTypeJob, "sync.networkjob.determineauthtype", QtInfoMsg)
 
+namespace {
+// the hrefs of a listing, the ones of most names are not percent encoded
+QString percentDecoded(const QString &href)
+{
+    if (!href.contains(QLatin1Char('%'))) {
+        return href;
+    }
+    return QString::fromUtf8(QByteArray::fromPercentEncoding(href.toUtf8()));
+}
+}
+
 RequestEtagJob::RequestEtagJob(AccountPtr account, const QUrl &rootUrl, const QString &path, QObject *parent)
     : PropfindJob(account, rootUrl, path, PropfindJob::Depth::Zero, parent)
 {
@@ -88,137 +106,330 @@ void MkColJob::finished()
 }
 
 /*********************************************************************************************/
-// supposed to read <D:collection> when pointing to <D:resourcetype><D:collection></D:resourcetype>..
-static QString readContentsAsString(QXmlStreamReader &reader)
-{
-    QString result;
-    int level = 0;
-    do {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        if (type == QXmlStreamReader::StartElement) {
-            level++;
-            result += QLatin1Char('<') + reader.name().toString() + QLatin1Char('>');
-        } else if (type == QXmlStreamReader::Characters) {
-            result += reader.text();
-        } else if (type == QXmlStreamReader::EndElement) {
-            level--;
-            if (level < 0) {
-                break;
-            }
-            result += QStringLiteral("</") + reader.name().toString() + QLatin1Char('>');
+LsColXMLParser::LsColXMLParser()
+{
+}
+
+bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath)
+{
+    begin(sizes, expectedPath);
+    if (!addData(xml)) {
+        return false;
+    }
+    return finish();
+}
+
+void LsColXMLParser::begin(QHash<QString, qint64> *sizes, const QString &expectedPath)
+{
+    _reader.clear();
+    _reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration(QStringLiteral("d"), QStringLiteral("DAV:")));
+    _sizes = sizes;
+    _expectedPath = expectedPath;
+    _failed = false;
+
+    _folders.clear();
+    _currentHref.clear();
+    _currentTmpProperties.clear();
+    _currentHttp200Properties.clear();
+    _currentTmpEntry = {};
+    _currentHttp200Entry = {};
+    _currentPropsAreValid = false;
+    _insidePropstat = false;
+    _insideProp = false;
+    _insideMultiStatus = false;
+    _textElement = TextElement::None;
+    _text.clear();
+    _textDepth = 0;
+}
+
+bool LsColXMLParser::addData(const QByteArray &data)
+{
+    if (_failed) {
+        return false;
+    }
+    _reader.addData(data);
+    _failed = !parseAvailableTokens();
+    return !_failed;
+}
+
+bool LsColXMLParser::finish()
+{
+    if (_failed) {
+        return false;
+    }
+    if (_reader.hasError()) {
+        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
+        qCWarning(lcPropfindJob) << "ERROR" << _reader.errorString();
+        return false;
+    } else if (!_insideMultiStatus) {
+        qCWarning(lcPropfindJob) << "ERROR no WebDAV response?";
+        return false;
+    }
+    Q_EMIT directoryListingSubfolders(_folders);
+    Q_EMIT finishedWithoutError();
+    return true;
+}
+
+const QString &LsColXMLParser::propertyName(QStringView name)
+{
+    // a listing has only a handful of distinct properties, the linear search avoids allocating a key per entry
+    for (const auto &known : _propertyNames) {
+        if (known == name) {
+            return known;
         }
+    }
+    _propertyNames.push_back(name.toString());
+    return _propertyNames.back();
+}
 
-    } while (!reader.atEnd());
-    return result;
+bool LsColXMLParser::isRepetitiveProperty(const QString &name)
+{
+    return name == QLatin1String("permissions") || name == QLatin1String("resourcetype") || name == QLatin1String("share-types")
+        || name == QLatin1String("getcontenttype") || name == QLatin1String("downloadURL") || name == QLatin1String("dDC");
 }
 
+QString LsColXMLParser::internedValue(const QString &value)
+{
+    auto it = _internedValues.constFind(value);
+    if (it == _internedValues.cend()) {
+        it = _internedValues.insert(value);
+    }
+    return *it;
+}
 
-LsColXMLParser::LsColXMLParser()
+namespace {
+// "Fri, 06 Feb 2015 13:49:55 GMT", without the allocations of QDateTime::fromString()
+std::optional<time_t> parseRFC1123Date(QStringView date)
 {
+    static const QLatin1String months[] = {QLatin1String("Jan"), QLatin1String("Feb"), QLatin1String("Mar"), QLatin1String("Apr"), QLatin1String("May"),
+        QLatin1String("Jun"), QLatin1String("Jul"), QLatin1String("Aug"), QLatin1String("Sep"), QLatin1String("Oct"), QLatin1String("Nov"),
+        QLatin1String("Dec")};
+    const auto comma = date.indexOf(QLatin1Char(','));
+    if (comma == -1) {
+        return {};
+    }
+    date = date.mid(comma + 1).trimmed();
+    if (date.size() != 24 || !date.endsWith(QLatin1String(" GMT"))) {
+        return {};
+    }
+    const auto month = std::find(std::begin(months), std::end(months), date.mid(3, 3));
+    const QDate day(date.mid(7, 4).toInt(), static_cast<int>(std::distance(std::begin(months), month)) + 1, date.mid(0, 2).toInt());
+    const QTime time(date.mid(12, 2).toInt(), date.mid(15, 2).toInt(), date.mid(18, 2).toInt());
+    if (month == std::end(months) || !day.isValid() || !time.isValid()) {
+        return {};
+    }
+    return (day.toJulianDay() - QDate(1970, 1, 1).toJulianDay()) * 24 * 3600 + time.msecsSinceStartOfDay() / 1000;
+}
 }
 
-bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath)
+void LsColXMLParser::decodeProperty(QStringView name, const QString &value, ListingEntry &entry)
+{
+    if (name == QLatin1String("resourcetype")) {
+        entry.isDirectory = value.contains(QLatin1String("collection"));
+    } else if (name == QLatin1String("getlastmodified")) {
+        if (const auto modtime = parseRFC1123Date(value)) {
+            entry.modtime = *modtime;
+        } else {
+            const auto date = Utility::parseRFC1123Date(value);
+            Q_ASSERT(date.isValid());
+            entry.modtime = date.toSecsSinceEpoch();
+        }
+    } else if (name == QLatin1String("getcontentlength")) {
+        // See #4573, sometimes negative size values are returned
+        entry.size = std::max<qint64>(0, value.toLongLong());
+    } else if (name == QLatin1String("getetag")) {
+        entry.etag = Utility::normalizeEtag(value);
+    } else if (name == QLatin1String("id")) {
+        entry.fileId = value.toUtf8();
+    } else if (name == QLatin1String("checksums")) {
+        entry.checksumHeader = findBestChecksum(value.toUtf8());
+    } else if (name == QLatin1String("permissions")) {
+        entry.remotePerm = RemotePermissions::fromServerString(value);
+        entry.hasPermissions = true;
+    } else if (name == QLatin1String("share-types")) {
+        entry.isShared = !value.isEmpty();
+    } else if (name == QLatin1String("size")) {
+        entry.folderSize = value.toLongLong();
+    } else if (name == QLatin1String("downloadURL")) {
+        entry.directDownloadUrl = value;
+    } else if (name == QLatin1String("dDC")) {
+        entry.directDownloadCookies = value;
+    } else if (name == QLatin1String("data-fingerprint")) {
+        entry.dataFingerprint = value.toUtf8();
+        entry.hasDataFingerprint = true;
+    } else if (name == QLatin1String("sync-token")) {
+        entry.syncToken = value.toUtf8();
+    } else if (name == QLatin1String("quota-available-bytes")) {
+        if (!entry.quota) {
+            entry.quota.emplace();
+        }
+        // The server can return fractional bytes (#1374)
+        entry.quota->availableBytes = value.toDouble();
+    } else if (name == QLatin1String("quota-used-bytes")) {
+        if (!entry.quota) {
+            entry.quota.emplace();
+        }
+        entry.quota->usedBytes = value.toDouble();
+    }
+}
+
+bool LsColXMLParser::parseAvailableTokens()
 {
-    // Parse DAV response
-    QXmlStreamReader reader(xml);
-    reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration(QStringLiteral("d"), QStringLiteral("DAV:")));
+    // Text is collected token by token instead of using readElementText(),
+    // an element might not be complete yet when the available data ends.
+    while (!_reader.atEnd()) {
+        const QXmlStreamReader::TokenType type = _reader.readNext();
+        if (type == QXmlStreamReader::Invalid) {
+            if (_reader.error() == QXmlStreamReader::PrematureEndOfDocumentError) {
+                // wait for more data
+                return true;
+            }
+            qCWarning(lcPropfindJob) << "ERROR" << _reader.errorString();
+            return false;
+        }
 
-    QStringList folders;
-    QString currentHref;
-    QMap<QString, QString> currentTmpProperties;
-    QMap<QString, QString> currentHttp200Properties;
-    bool currentPropsAreValid = false;
-    bool insidePropstat = false;
-    bool insideProp = false;
-    bool insideMultiStatus = false;
+        if (_textElement == TextElement::Property) {
+            // supposed to read <D:collection> when pointing to <D:resourcetype><D:collection></D:resourcetype>..
+            if (type == QXmlStreamReader::StartElement) {
+                _textDepth++;
+                _text += QLatin1Char('<');
+                _text += _reader.name();
+                _text += QLatin1Char('>');
+            } else if (type == QXmlStreamReader::Characters) {
+                _text += _reader.text();
+            } else if (type == QXmlStreamReader::EndElement) {
+                if (_textDepth > 0) {
+                    _textDepth--;
+                    _text += QLatin1String("</");
+                    _text += _reader.name();
+                    _text += QLatin1Char('>');
+                    continue;
+                }
+                // All those elements are properties
+                const QString &name = propertyName(_reader.name());
+                if (name == QLatin1String("resourcetype") && _text.contains(QLatin1String("collection"))) {
+                    _folders.append(_currentHref);
+                } else if (name == QLatin1String("size")) {
+                    bool ok = false;
+                    auto s = _text.toLongLong(&ok);
+                    if (ok && _sizes) {
+                        _sizes->insert(_currentHref, s);
+                    }
+                }
+                if (_decodeEntries) {
+                    decodeProperty(name, _text, _currentTmpEntry);
+                    // keep the capacity for the next property
+                    _text.resize(0);
+                } else {
+                    if (isRepetitiveProperty(name)) {
+                        // share the value with the other entries and keep the buffer of _text
+                        _currentTmpProperties.insert(name, internedValue(_text));
+                    } else {
+                        _currentTmpProperties.insert(name, std::move(_text));
+                    }
+                    _text.clear();
+                }
+                _textElement = TextElement::None;
+            }
+            continue;
+        }
+
+        if (_textElement != TextElement::None) {
+            if (type == QXmlStreamReader::Characters) {
+                _text += _reader.text();
+            } else if (type == QXmlStreamReader::EndElement) {
+                if (_textElement == TextElement::Href) {
+                    // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
+                    // but the result will have URL encoding..
+                    QString hrefString = percentDecoded(_text);
+                    if (!hrefString.startsWith(_expectedPath)) {
+                        qCWarning(lcPropfindJob) << "Invalid href" << hrefString << "expected starting with" << _expectedPath;
+                        return false;
+                    }
+                    _currentHref = hrefString;
+                } else {
+                    _currentPropsAreValid = _text.startsWith(QLatin1String("HTTP/1.1 200")) || _text.startsWith(QLatin1String("HTTP/1.1 425"));
+                }
+                // keep the capacity for the next element
+                _text.resize(0);
+                _textElement = TextElement::None;
+            }
+            continue;
+        }
 
-    while (!reader.atEnd()) {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        QString name = reader.name().toString();
         // Start elements with DAV:
-        if (type == QXmlStreamReader::StartElement && reader.namespaceUri() == QLatin1String("DAV:")) {
+        if (type == QXmlStreamReader::StartElement && _reader.namespaceUri() == QLatin1String("DAV:")) {
+            const auto name = _reader.name();
             if (name == QLatin1String("href")) {
-                // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
-                // but the result will have URL encoding..
-                QString hrefString = QString::fromUtf8(QByteArray::fromPercentEncoding(reader.readElementText().toUtf8()));
-                if (!hrefString.startsWith(expectedPath)) {
-                    qCWarning(lcPropfindJob) << "Invalid href" << hrefString << "expected starting with" << expectedPath;
-                    return false;
-                }
-                currentHref = hrefString;
-            } else if (name == QLatin1String("response")) {
+                _textElement = TextElement::Href;
+                continue;
             } else if (name == QLatin1String("propstat")) {
-                insidePropstat = true;
-            } else if (name == QLatin1String("status") && insidePropstat) {
-                QString httpStatus = reader.readElementText();
-                if (httpStatus.startsWith(QLatin1String("HTTP/1.1 200")) || httpStatus.startsWith(QLatin1String("HTTP/1.1 425"))) {
-                    currentPropsAreValid = true;
-                } else {
-                    currentPropsAreValid = false;
-                }
+                _insidePropstat = true;
+            } else if (name == QLatin1String("status") && _insidePropstat) {
+                _textElement = TextElement::Status;
+                continue;
             } else if (name == QLatin1String("prop")) {
-                insideProp = true;
+                _insideProp = true;
                 continue;
             } else if (name == QLatin1String("multistatus")) {
-                insideMultiStatus = true;
+                _insideMultiStatus = true;
                 continue;
             }
         }
 
-        if (type == QXmlStreamReader::StartElement && insidePropstat && insideProp) {
-            // All those elements are properties
-            QString propertyContent = readContentsAsString(reader);
-            if (name == QLatin1String("resourcetype") && propertyContent.contains(QLatin1String("collection"))) {
-                folders.append(currentHref);
-            } else if (name == QLatin1String("size")) {
-                bool ok = false;
-                auto s = propertyContent.toLongLong(&ok);
-                if (ok && sizes) {
-                    sizes->insert(currentHref, s);
-                }
-            }
-            currentTmpProperties.insert(reader.name().toString(), propertyContent);
+        if (type == QXmlStreamReader::StartElement && _insidePropstat && _insideProp) {
+            _textElement = TextElement::Property;
+            _textDepth = 0;
+            continue;
         }
 
         // End elements with DAV:
-        if (type == QXmlStreamReader::EndElement) {
-            if (reader.namespaceUri() == QLatin1String("DAV:")) {
-                if (reader.name() == QLatin1String("response")) {
-                    if (currentHref.endsWith(QLatin1Char('/'))) {
-                        currentHref.chop(1);
-                    }
-                    Q_EMIT directoryListingIterated(currentHref, currentHttp200Properties);
-                    currentHref.clear();
-                    currentHttp200Properties.clear();
-                } else if (reader.name() == QLatin1String("propstat")) {
-                    insidePropstat = false;
-                    if (currentPropsAreValid) {
-                        currentHttp200Properties = std::move(currentTmpProperties);
-                    }
-                    currentPropsAreValid = false;
-                } else if (reader.name() == QLatin1String("prop")) {
-                    insideProp = false;
+        if (type == QXmlStreamReader::EndElement && _reader.namespaceUri() == QLatin1String("DAV:")) {
+            if (_reader.name() == QLatin1String("response")) {
+                if (_currentHref.endsWith(QLatin1Char('/'))) {
+                    _currentHref.chop(1);
+                }
+                if (_decodeEntries) {
+                    Q_EMIT directoryListingEntry(_currentHref, _currentHttp200Entry);
+                    _currentHttp200Entry = {};
+                } else {
+                    Q_EMIT directoryListingIterated(_currentHref, _currentHttp200Properties);
+                    _currentHttp200Properties.clear();
+                }
+                _currentHref.clear();
+            } else if (_reader.name() == QLatin1String("propstat")) {
+                _insidePropstat = false;
+                if (_currentPropsAreValid) {
+                    _currentHttp200Properties = std::move(_currentTmpProperties);
+                    _currentHttp200Entry = std::move(_currentTmpEntry);
                 }
+                _currentTmpProperties.clear();
+                _currentTmpEntry = {};
+                _currentPropsAreValid = false;
+            } else if (_reader.name() == QLatin1String("prop")) {
+                _insideProp = false;
             }
         }
     }
-
-    if (reader.hasError()) {
-        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
-        qCWarning(lcPropfindJob) << "ERROR" << reader.errorString() << xml;
-        return false;
-    } else if (!insideMultiStatus) {
-        qCWarning(lcPropfindJob) << "ERROR no WebDAV response?" << xml;
-        return false;
-    } else {
-        Q_EMIT directoryListingSubfolders(folders);
-        Q_EMIT finishedWithoutError();
-    }
     return true;
 }
 
 /*********************************************************************************************/
 
+namespace {
+void writeProperties(QTextStream &stream, const QList<QByteArray> &properties)
+{
+    for (const QByteArray &prop : properties) {
+        const int colIdx = prop.lastIndexOf(':');
+        if (colIdx >= 0) {
+            stream << QByteArrayLiteral("<") << prop.mid(colIdx + 1) << QByteArrayLiteral(" xmlns=\"") << prop.left(colIdx) << QByteArrayLiteral("\"/>");
+        } else {
+            stream << QByteArrayLiteral("<d:") << prop << QByteArrayLiteral("/>");
+        }
+    }
+}
+}
+
 PropfindJob::PropfindJob(AccountPtr account, const QUrl &url, const QString &path, Depth depth, QObject *parent)
     : AbstractNetworkJob(account, url, path, parent)
     , _depth(depth)
@@ -242,7 +453,7 @@ QList<QByteArray> PropfindJob::properties() const
 void PropfindJob::start()
 {
     QNetworkRequest req;
-    req.setRawHeader(QByteArrayLiteral("Depth"), QByteArray::number(static_cast<int>(_depth)));
+    req.setRawHeader(QByteArrayLiteral("Depth"), _depth == Depth::Infinity ? QByteArrayLiteral("infinity") : QByteArray::number(static_cast<int>(_depth)));
     req.setRawHeader(QByteArrayLiteral("Prefer"), QByteArrayLiteral("return=minimal"));
 
     if (_properties.isEmpty()) {
@@ -256,14 +467,7 @@ void PropfindJob::start()
                                     "<d:propfind xmlns:d=\"DAV:\">"
                                     "<d:prop>");
 
-        for (const QByteArray &prop : std::as_const(_properties)) {
-            const int colIdx = prop.lastIndexOf(':');
-            if (colIdx >= 0) {
-                stream << QByteArrayLiteral("<") << prop.mid(colIdx + 1) << QByteArrayLiteral(" xmlns=\"") << prop.left(colIdx) << QByteArrayLiteral("\"/>");
-            } else {
-                stream << QByteArrayLiteral("<d:") << prop << QByteArrayLiteral("/>");
-            }
-        }
+        writeProperties(stream, _properties);
         stream << QByteArrayLiteral("</d:prop>"
                                     "</d:propfind>\n");
     }
@@ -275,9 +479,55 @@ void PropfindJob::start()
     AbstractNetworkJob::start();
 }
 
-// TODO: Instead of doing all in this slot, we should iteratively parse in readyRead(). This
-// would allow us to be more asynchronous in processing while data is coming from the network,
-// not all in one big blob at the end.
+void PropfindJob::newReplyHook(QNetworkReply *reply)
+{
+    // a new reply, e.g. after a redirect, starts a new response
+    _parser.reset();
+    _parseFailed = false;
+    reply->setReadBufferSize(ReadBufferSize);
+    connect(reply, &QNetworkReply::readyRead, this, [reply, this] {
+        if (reply == this->reply()) {
+            readAvailableData();
+        }
+    });
+}
+
+void PropfindJob::readAvailableData()
+{
+    if (!_parser) {
+        if (httpStatusCode() != 207 || !reply()->header(QNetworkRequest::ContentTypeHeader).toString().contains(QLatin1String("application/xml; charset=utf-8"))) {
+            // not a listing, the body is handled in finished() and the reply must be able to buffer all of it
+            reply()->setReadBufferSize(0);
+            return;
+        }
+        _parser = std::make_unique<LsColXMLParser>();
+        _parser->setDecodeEntries(_decodeEntries);
+        connect(_parser.get(), &LsColXMLParser::directoryListingSubfolders, this, &PropfindJob::directoryListingSubfolders);
+        connect(_parser.get(), &LsColXMLParser::directoryListingIterated, this, &PropfindJob::directoryListingIterated);
+        connect(_parser.get(), &LsColXMLParser::directoryListingEntry, this, &PropfindJob::directoryListingEntry);
+        connect(_parser.get(), &LsColXMLParser::finishedWithoutError, this, &PropfindJob::finishedWithoutError);
+        if (_depth == Depth::Zero) {
+            connect(_parser.get(), &LsColXMLParser::directoryListingIterated,
+                [parser = _parser.get(), counter = 0, this](const QString &name, const QMap<QString, QString> &) mutable {
+                    counter++;
+                    // With a depths of 0 we must receive only one listing
+                    if (OC_ENSURE(counter == 1)) {
+                        disconnect(parser, &LsColXMLParser::directoryListingIterated, this, &PropfindJob::directoryListingIterated);
+                    } else {
+                        qCCritical(lcPropfindJob) << "Received superfluous directory listing for depth 0 propfind" << counter << "Path:" << name;
+                    }
+                });
+        }
+        const QString expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/webdav/folder"
+        _parser->begin(&_sizes, expectedPath);
+    }
+    // entries are emitted as soon as they are complete, the reply doesn't need to buffer the whole listing
+    if (!_parseFailed) {
+        addBufferedBytes(reply()->bytesAvailable());
+        _parseFailed = !_parser->addData(reply()->readAll());
+    }
+}
+
 void PropfindJob::finished()
 {
     qCInfo(lcPropfindJob) << "LSCOL of" << reply()->request().url() << "FINISHED WITH STATUS"
@@ -286,25 +536,8 @@ void PropfindJob::finished()
     const QString contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
     if (httpStatusCode() == 207) {
         if (contentType.contains(QLatin1String("application/xml; charset=utf-8"))) {
-            LsColXMLParser parser;
-            connect(&parser, &LsColXMLParser::directoryListingSubfolders, this, &PropfindJob::directoryListingSubfolders);
-            connect(&parser, &LsColXMLParser::directoryListingIterated, this, &PropfindJob::directoryListingIterated);
-            connect(&parser, &LsColXMLParser::finishedWithoutError, this, &PropfindJob::finishedWithoutError);
-            if (_depth == Depth::Zero) {
-                connect(&parser, &LsColXMLParser::directoryListingIterated,
-                    [&parser, counter = 0, this](const QString &name, const QMap<QString, QString> &) mutable {
-                        counter++;
-                        // With a depths of 0 we must receive only one listing
-                        if (OC_ENSURE(counter == 1)) {
-                            disconnect(&parser, &LsColXMLParser::directoryListingIterated, this, &PropfindJob::directoryListingIterated);
-                        } else {
-                            qCCritical(lcPropfindJob) << "Received superfluous directory listing for depth 0 propfind" << counter << "Path:" << name;
-                        }
-                    });
-            }
-
-            const QString expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/webdav/folder"
-            if (!parser.parse(reply()->readAll(), &_sizes, expectedPath)) {
+            readAvailableData();
+            if (_parseFailed || !_parser->finish()) {
                 // XML parse error
                 Q_EMIT finishedWithError();
             }
@@ -326,6 +559,170 @@ const QHash<QString, qint64> &PropfindJob::sizes() const
 
 /*********************************************************************************************/
 
+SyncCollectionJob::SyncCollectionJob(AccountPtr account, const QUrl &url, const QString &path, const QByteArray &syncToken, QObject *parent)
+    : AbstractNetworkJob(account, url, path, parent)
+    , _syncToken(syncToken)
+{
+    // part of the discovery, like the PROPFIND
+    setPriority(QNetworkRequest::HighPriority);
+}
+
+void SyncCollectionJob::setProperties(const QList<QByteArray> &properties)
+{
+    _properties = properties;
+}
+
+void SyncCollectionJob::start()
+{
+    QNetworkRequest req;
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QByteArrayLiteral("application/xml; charset=utf-8"));
+
+    QByteArray data;
+    {
+        QTextStream stream(&data, QIODevice::WriteOnly);
+        stream.setEncoding(QStringConverter::Utf8);
+        stream << QByteArrayLiteral("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                                    "<d:sync-collection xmlns:d=\"DAV:\">"
+                                    "<d:sync-token>")
+               << QString::fromUtf8(_syncToken).toHtmlEscaped()
+               << QByteArrayLiteral("</d:sync-token>"
+                                    "<d:sync-level>infinite</d:sync-level>"
+                                    "<d:prop>");
+        writeProperties(stream, _properties);
+        stream << QByteArrayLiteral("</d:prop>"
+                                    "</d:sync-collection>\n");
+    }
+
+    QBuffer *buf = new QBuffer(this);
+    buf->setData(data);
+    buf->open(QIODevice::ReadOnly);
+    sendRequest(QByteArrayLiteral("REPORT"), req, buf);
+    AbstractNetworkJob::start();
+}
+
+void SyncCollectionJob::finished()
+{
+    qCInfo(lcPropfindJob) << "REPORT of" << reply()->request().url() << "FINISHED WITH STATUS" << replyStatusString();
+
+    if (httpStatusCode() == 207 && reply()->header(QNetworkRequest::ContentTypeHeader).toString().contains(QLatin1String("application/xml"))
+        && parse(reply()->readAll())) {
+        Q_EMIT finishedWithoutError();
+    } else {
+        // an invalid token is rejected with 403 and a valid-sync-token precondition
+        Q_EMIT finishedWithError();
+    }
+}
+
+bool SyncCollectionJob::parse(const QByteArray &data)
+{
+    auto decodedHref = [](const QString &href) {
+        QString path = percentDecoded(href);
+        if (path.endsWith(QLatin1Char('/'))) {
+            path.chop(1);
+        }
+        return path;
+    };
+    QString expectedPath = reply()->request().url().path();
+    if (expectedPath.endsWith(QLatin1Char('/'))) {
+        expectedPath.chop(1);
+    }
+
+    QXmlStreamReader reader(data);
+    Change current;
+    QString responseStatus;
+    QString propstatStatus;
+    QMap<QString, QString> propstatProperties;
+    bool insideResponse = false;
+    bool insidePropstat = false;
+    bool insideProp = false;
+    bool insideMultiStatus = false;
+    while (!reader.atEnd()) {
+        const auto type = reader.readNext();
+        if (type == QXmlStreamReader::StartElement && insideProp) {
+            // the value of a property, nested elements are kept like LsColXMLParser does
+            const QString name = reader.name().toString();
+            QString value;
+            int depth = 0;
+            while (!reader.atEnd()) {
+                const auto valueType = reader.readNext();
+                if (valueType == QXmlStreamReader::StartElement) {
+                    depth++;
+                    value += QLatin1Char('<');
+                    value += reader.name();
+                    value += QLatin1Char('>');
+                } else if (valueType == QXmlStreamReader::Characters) {
+                    value += reader.text();
+                } else if (valueType == QXmlStreamReader::EndElement) {
+                    if (depth == 0) {
+                        break;
+                    }
+                    depth--;
+                    value += QLatin1String("</");
+                    value += reader.name();
+                    value += QLatin1Char('>');
+                }
+            }
+            propstatProperties.insert(name, value);
+        } else if (type == QXmlStreamReader::StartElement && reader.namespaceUri() == QLatin1String("DAV:")) {
+            const auto name = reader.name();
+            if (name == QLatin1String("multistatus")) {
+                insideMultiStatus = true;
+            } else if (name == QLatin1String("response")) {
+                insideResponse = true;
+                current = {};
+                responseStatus.clear();
+            } else if (name == QLatin1String("href") && insideResponse) {
+                current.href = decodedHref(reader.readElementText());
+                if (!current.href.startsWith(expectedPath)) {
+                    qCWarning(lcPropfindJob) << "Invalid href" << current.href << "expected starting with" << expectedPath;
+                    return false;
+                }
+            } else if (name == QLatin1String("status") && insidePropstat) {
+                propstatStatus = reader.readElementText();
+            } else if (name == QLatin1String("status") && insideResponse) {
+                responseStatus = reader.readElementText();
+            } else if (name == QLatin1String("propstat")) {
+                insidePropstat = true;
+                propstatStatus.clear();
+                propstatProperties.clear();
+            } else if (name == QLatin1String("prop") && insidePropstat) {
+                insideProp = true;
+            } else if (name == QLatin1String("sync-token") && !insideResponse) {
+                _newSyncToken = reader.readElementText().toUtf8();
+            }
+        } else if (type == QXmlStreamReader::EndElement && reader.namespaceUri() == QLatin1String("DAV:")) {
+            const auto name = reader.name();
+            if (name == QLatin1String("prop")) {
+                insideProp = false;
+            } else if (name == QLatin1String("propstat")) {
+                insidePropstat = false;
+                if (propstatStatus.startsWith(QLatin1String("HTTP/1.1 200"))) {
+                    current.properties = std::move(propstatProperties);
+                }
+            } else if (name == QLatin1String("response")) {
+                insideResponse = false;
+                if (responseStatus.startsWith(QLatin1String("HTTP/1.1 507"))) {
+                    qCWarning(lcPropfindJob) << "The server truncated the changes of" << expectedPath;
+                    return false;
+                }
+                current.removed = responseStatus.startsWith(QLatin1String("HTTP/1.1 404"));
+                _changes.append(std::move(current));
+            }
+        }
+    }
+    if (reader.hasError()) {
+        qCWarning(lcPropfindJob) << "ERROR" << reader.errorString();
+        return false;
+    }
+    if (!insideMultiStatus || _newSyncToken.isEmpty()) {
+        qCWarning(lcPropfindJob) << "ERROR no sync-collection response?";
+        return false;
+    }
+    return true;
+}
+
+/*********************************************************************************************/
+
 AvatarJob::AvatarJob(AccountPtr account, const QString &userId, int size, QObject *parent)
     : AbstractNetworkJob(account, account->url(), QStringLiteral("remote.php/dav/avatars/%1/%2.png").arg(userId, QString::number(size)), parent)
 {
@@ -508,8 +905,15 @@ void SimpleNetworkJob::newReplyHook(QNetworkReply *reply)
 }
 
 void fetchPrivateLinkUrl(AccountPtr account, const QUrl &baseUrl, const QString &remotePath, QObject *target,
-    const std::function<void(const QUrl &url)> &targetFun)
+    const std::function<void(const QUrl &url)> &targetFun, const QByteArray &fileId)
 {
+    if (!fileId.isEmpty()) {
+        const QUrl cached = account->privateLink(fileId);
+        if (!cached.isEmpty()) {
+            QTimer::singleShot(0, target, [cached, targetFun] { targetFun(cached); });
+            return;
+        }
+    }
     if (account->capabilities().privateLinkPropertyAvailable()) {
         // Retrieve the new link by PROPFIND
         auto *job = new PropfindJob(account, baseUrl, remotePath, PropfindJob::Depth::Zero, target);
@@ -518,6 +922,9 @@ void fetchPrivateLinkUrl(AccountPtr account, const QUrl &baseUrl, const QString
         QObject::connect(job, &PropfindJob::directoryListingIterated, target, [=](const QString &, const QMap<QString, QString> &result) {
             auto privateLinkUrl = result[QStringLiteral("privatelink")];
             if (!privateLinkUrl.isEmpty()) {
+                if (!fileId.isEmpty()) {
+                    account->setPrivateLink(fileId, QUrl(privateLinkUrl));
+                }
                 targetFun(QUrl(privateLinkUrl));
             }
         });
@@ -17,10 +17,16 @@
 #define NETWORKJOBS_H
 
 #include "abstractnetworkjob.h"
+#include "common/remotepermissions.h"
 #include "common/result.h"
 #include <QJsonObject>
+#include <QSet>
 #include <QUrlQuery>
+#include <QXmlStreamReader>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <optional>
 
 class QUrl;
 
@@ -53,6 +59,49 @@ private Q_SLOTS:
     void finished() override;
 };
 
+/**
+ * @brief The quota properties of a folder, see RFC 4331
+ * @ingroup libsync
+ */
+struct OWNCLOUDSYNC_EXPORT RemoteQuota
+{
+    /// quota-available-bytes, negative values have a special meaning, like -3 for an unlimited quota
+    qint64 availableBytes = 0;
+    /// quota-used-bytes
+    qint64 usedBytes = 0;
+};
+
+/**
+ * @brief The properties of a listing entry that the discovery uses
+ * @ingroup libsync
+ *
+ * Decoded by LsColXMLParser while the entry is parsed, only the values
+ * that differ between entries allocate.
+ */
+struct OWNCLOUDSYNC_EXPORT ListingEntry
+{
+    QString etag;
+    QByteArray fileId;
+    QByteArray checksumHeader;
+    RemotePermissions remotePerm;
+    bool hasPermissions = false;
+    bool isShared = false;
+    bool isDirectory = false;
+    time_t modtime = 0;
+    /// getcontentlength, -1 if it is missing
+    qint64 size = -1;
+    /// oc:size, -1 if it is missing
+    qint64 folderSize = -1;
+    QString directDownloadUrl;
+    QString directDownloadCookies;
+    /// Empty if missing, see hasDataFingerprint
+    QByteArray dataFingerprint;
+    bool hasDataFingerprint = false;
+    QByteArray syncToken;
+    /// Only set if one of the quota properties was requested and returned
+    std::optional<RemoteQuota> quota;
+};
+
 /**
  * @brief The PropfindJob class parser
  * @ingroup libsync
@@ -63,12 +112,70 @@ class OWNCLOUDSYNC_EXPORT LsColXMLParser : public QObject
 public:
     explicit LsColXMLParser();
 
+    /** Emit directoryListingEntry() instead of directoryListingIterated()
+     *
+     * No property map is built, the properties are decoded into a ListingEntry.
+     */
+    void setDecodeEntries(bool decode) { _decodeEntries = decode; }
+
+    /** Parse a complete response, same as begin(), addData() and finish() */
     bool parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath);
 
+    /** Start parsing a new response
+     *
+     * The parser can be fed incrementally with addData(), directoryListingIterated()
+     * is emitted as soon as an entry is complete.
+     */
+    void begin(QHash<QString, qint64> *sizes, const QString &expectedPath);
+
+    /** Parse the next part of the response, returns false if it is invalid */
+    bool addData(const QByteArray &data);
+
+    /** The whole response was added, returns false if it was incomplete or invalid */
+    bool finish();
+
 Q_SIGNALS:
     void directoryListingSubfolders(const QStringList &items);
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
+    void directoryListingEntry(const QString &name, const OCC::ListingEntry &entry);
     void finishedWithoutError();
+
+private:
+    bool parseAvailableTokens();
+    static void decodeProperty(QStringView name, const QString &value, ListingEntry &entry);
+
+    /** Property names and values that are the same for many entries are shared
+     * between the entries instead of being allocated for each of them.
+     */
+    const QString &propertyName(QStringView name);
+    static bool isRepetitiveProperty(const QString &name);
+    QString internedValue(const QString &value);
+
+    QXmlStreamReader _reader;
+    QHash<QString, qint64> *_sizes = nullptr;
+    QString _expectedPath;
+    bool _failed = false;
+
+    QStringList _folders;
+    QString _currentHref;
+    QMap<QString, QString> _currentTmpProperties;
+    QMap<QString, QString> _currentHttp200Properties;
+    bool _decodeEntries = false;
+    ListingEntry _currentTmpEntry;
+    ListingEntry _currentHttp200Entry;
+    bool _currentPropsAreValid = false;
+    bool _insidePropstat = false;
+    bool _insideProp = false;
+    bool _insideMultiStatus = false;
+
+    // The element whose text is currently read, its content may span several addData() calls
+    enum class TextElement { None, Href, Status, Property };
+    TextElement _textElement = TextElement::None;
+    QString _text;
+    int _textDepth = 0;
+
+    std::deque<QString> _propertyNames;
+    QSet<QString> _internedValues;
 };
 
 class OWNCLOUDSYNC_EXPORT PropfindJob : public AbstractNetworkJob
@@ -77,7 +184,8 @@ class OWNCLOUDSYNC_EXPORT PropfindJob : public AbstractNetworkJob
 public:
     enum class Depth {
         Zero,
-        One
+        One,
+        Infinity
     } Q_ENUMS(Depth);
     explicit PropfindJob(AccountPtr account, const QUrl &url, const QString &path, Depth depth, QObject *parent = nullptr);
     void start() override;
@@ -93,22 +201,89 @@ public:
     void setProperties(const QList<QByteArray> &properties);
     QList<QByteArray> properties() const;
 
+    /// See LsColXMLParser::setDecodeEntries()
+    void setDecodeEntries(bool decode) { _decodeEntries = decode; }
+
     // TODO: document...
     const QHash<QString, qint64> &sizes() const;
 
+    /// The listing data the reply may buffer until the parser reads it
+    static constexpr qint64 ReadBufferSize = 1024 * 1024;
+
 Q_SIGNALS:
     void directoryListingSubfolders(const QStringList &items);
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
+    void directoryListingEntry(const QString &name, const OCC::ListingEntry &entry);
     void finishedWithError();
     void finishedWithoutError();
 
 private Q_SLOTS:
     void finished() override;
 
+protected:
+    void newReplyHook(QNetworkReply *reply) override;
+
 private:
+    /// Feed the data received so far to the parser, once the reply is known to be a listing
+    void readAvailableData();
+
     QList<QByteArray> _properties;
     QHash<QString, qint64> _sizes;
     Depth _depth;
+    bool _decodeEntries = false;
+    std::unique_ptr<LsColXMLParser> _parser;
+    bool _parseFailed = false;
+};
+
+/**
+ * @brief The changes of a collection since a sync token, see RFC 6578
+ *
+ * Sends a sync-collection REPORT with sync-level infinite, the members that
+ * changed anywhere below the collection are reported with the requested
+ * properties, removed members only with their href.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT SyncCollectionJob : public AbstractNetworkJob
+{
+    Q_OBJECT
+public:
+    struct Change
+    {
+        /// The percent decoded path, without a trailing slash
+        QString href;
+        /// The properties of a changed member, empty for a removed one
+        QMap<QString, QString> properties;
+        bool removed = false;
+    };
+
+    explicit SyncCollectionJob(AccountPtr account, const QUrl &url, const QString &path, const QByteArray &syncToken, QObject *parent = nullptr);
+    void start() override;
+
+    /// Same as PropfindJob::setProperties()
+    void setProperties(const QList<QByteArray> &properties);
+
+    /** The reported changes, valid once finishedWithoutError() was emitted */
+    const QVector<Change> &changes() const { return _changes; }
+
+    /** The token of the reported state, used for the next request */
+    const QByteArray &newSyncToken() const { return _newSyncToken; }
+
+Q_SIGNALS:
+    /** Also emitted for incomplete results, the server limits the number of reported changes */
+    void finishedWithError();
+    void finishedWithoutError();
+
+private Q_SLOTS:
+    void finished() override;
+
+private:
+    bool parse(const QByteArray &data);
+
+    QByteArray _syncToken;
+    QList<QByteArray> _properties;
+    QVector<Change> _changes;
+    QByteArray _newSyncToken;
 };
 
 
@@ -254,11 +429,14 @@ private:
  *
  * The job and signal connections are parented to the target QObject.
  *
+ * If the \a fileId is known, the link is remembered by the account and
+ * the next request for the same file is answered without a PROPFIND.
+ *
  * Note: targetFun is guaranteed to be called only through the event
  * loop and never directly.
  */
 void OWNCLOUDSYNC_EXPORT fetchPrivateLinkUrl(AccountPtr account, const QUrl &baseUrl, const QString &remotePath, QObject *target,
-    const std::function<void(const QUrl &url)> &targetFun);
+    const std::function<void(const QUrl &url)> &targetFun, const QByteArray &fileId = {});
 
 } // namespace OCC
 
@@ -32,7 +32,14 @@ void JsonJob::finished()
 {
     if (reply()->error() != QNetworkReply::NoError) {
         qCWarning(lcJsonApiJob) << "Network error: " << this << errorString();
+    } else if (httpStatusCode() == 304) {
+        _notModified = true;
+        const auto etag = reply()->rawHeader(QByteArrayLiteral("ETag"));
+        if (!etag.isEmpty()) {
+            _etag = etag;
+        }
     } else {
+        _etag = reply()->rawHeader(QByteArrayLiteral("ETag"));
         parse(reply()->readAll());
     }
     SimpleNetworkJob::finished();
@@ -59,6 +66,24 @@ const QJsonObject &JsonJob::data() const
     return _data;
 }
 
+void JsonJob::setIfNoneMatch(const QByteArray &etag)
+{
+    _etag = etag;
+    if (!etag.isEmpty()) {
+        _request.setRawHeader(QByteArrayLiteral("If-None-Match"), etag);
+    }
+}
+
+const QByteArray &JsonJob::etag() const
+{
+    return _etag;
+}
+
+bool JsonJob::notModified() const
+{
+    return _notModified;
+}
+
 
 JsonApiJob::JsonApiJob(AccountPtr account, const QString &path, const QByteArray &verb, const UrlQuery &arguments, const QNetworkRequest &req, QObject *parent)
     : JsonJob(account, account->url(), path, verb, arguments, req, parent)
@@ -32,6 +32,19 @@ public:
     const QJsonObject &data() const;
     const QJsonParseError &parseError() const;
 
+    /**
+     * Sends \a etag in If-None-Match, an unchanged resource is then answered
+     * with a 304 without a body, see notModified().
+     * Must be called before start().
+     */
+    void setIfNoneMatch(const QByteArray &etag);
+
+    /// The ETag of the response, the one passed to setIfNoneMatch() if it was not modified
+    const QByteArray &etag() const;
+
+    /// Whether the server answered with a 304, nothing was parsed then
+    bool notModified() const;
+
 protected:
     void finished() override;
 
@@ -41,6 +54,8 @@ protected:
 private:
     QJsonParseError _parseError;
     QJsonObject _data;
+    QByteArray _etag;
+    bool _notModified = false;
 };
 
 
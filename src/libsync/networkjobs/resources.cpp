@@ -1,5 +1,7 @@
 #include "resources.h"
 
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
 #include <QIcon>
 #include <QMimeDatabase>
@@ -9,6 +11,8 @@ namespace OCC {
 Q_LOGGING_CATEGORY(lcResources, "sync.networkjob.resource")
 
 namespace {
+    constexpr qint64 maximumSizeC = 20 * 1024 * 1024;
+
     QString hashMd5(const QString &data)
     {
         QCryptographicHash hash(QCryptographicHash::Algorithm::Md5);
@@ -53,6 +57,11 @@ void ResourceJob::finished()
         // furthermore, we can skip writing the file if the cache key has not changed (i.e., a file exists) and the file has come from the network cache
         if (QFileInfo::exists(path) && reply()->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
             qCDebug(lcResources) << "file has come from network cache, skipping writing";
+            // mark the file as recently used
+            QFile cacheFile(path);
+            if (cacheFile.open(QIODevice::ReadWrite)) {
+                cacheFile.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+            }
         } else {
             QFile cacheFile(path);
 
@@ -60,8 +69,12 @@ void ResourceJob::finished()
             if (!cacheFile.open(QIODevice::WriteOnly)) {
                 qCCritical(lcResources) << "failed to open cache file for writing:" << cacheFile.fileName();
             } else {
-                if (!cacheFile.write(reply()->readAll())) {
+                const qint64 written = cacheFile.write(reply()->readAll());
+                if (written <= 0) {
                     qCCritical(lcResources) << "failed to write to cache file:" << cacheFile.fileName();
+                } else {
+                    cacheFile.close();
+                    _cache->fileUpdated(_cacheKey, written);
                 }
             }
         }
@@ -78,10 +91,18 @@ QIcon ResourceJob::asIcon() const
     }
 
     // storing the file on disk enables Qt to apply some optimizations (e.g., caching of rendered pixmaps)
-    return QIcon(_cache->path(_cacheKey));
+    return _cache->icon(_cacheKey);
+}
+
+QString ResourceJob::cachePath() const
+{
+    if (_cacheKey.isEmpty()) {
+        return {};
+    }
+    return _cache->path(_cacheKey);
 }
 
-ResourceJob::ResourceJob(const ResourcesCache *cache, const QUrl &rootUrl, const QString &path, QObject *parent)
+ResourceJob::ResourceJob(ResourcesCache *cache, const QUrl &rootUrl, const QString &path, QObject *parent)
     : SimpleNetworkJob(cache->account()->sharedFromThis(), rootUrl, path, "GET", {}, {}, parent)
     , _cache(cache)
 {
@@ -91,17 +112,23 @@ ResourceJob::ResourceJob(const ResourcesCache *cache, const QUrl &rootUrl, const
 ResourcesCache::ResourcesCache(const QString &cacheDirectory, Account *account)
     : QObject(account)
     , _account(account)
-    , _cacheDirectory(QStringLiteral("%1/tmp.XXXXXX").arg(cacheDirectory))
+    , _cacheDirectory(cacheDirectory)
 {
-    Q_ASSERT(_cacheDirectory.isValid());
+    QDir dir(_cacheDirectory);
+    Q_ASSERT(dir.exists());
+    // older versions used a temporary directory per run, which is left behind after a crash
+    for (const auto &leftover : dir.entryList({QStringLiteral("tmp.*")}, QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QDir(dir.filePath(leftover)).removeRecursively();
+    }
+    expire();
 }
 
-ResourceJob *ResourcesCache::makeGetJob(const QUrl &rootUrl, const QString &path, QObject *parent) const
+ResourceJob *ResourcesCache::makeGetJob(const QUrl &rootUrl, const QString &path, QObject *parent)
 {
     return new ResourceJob(this, rootUrl, path, parent);
 }
 
-ResourceJob *ResourcesCache::makeGetJob(const QString &path, QObject *parent) const
+ResourceJob *ResourcesCache::makeGetJob(const QString &path, QObject *parent)
 {
     return makeGetJob(_account->url(), path, parent);
 }
@@ -114,8 +141,49 @@ Account *ResourcesCache::account() const
 QString ResourcesCache::path(const QString &cacheKey) const
 {
     Q_ASSERT(!cacheKey.isEmpty());
-    Q_ASSERT(_cacheDirectory.isValid());
-    return _cacheDirectory.filePath(cacheKey);
+    return QDir(_cacheDirectory).filePath(cacheKey);
+}
+
+QIcon ResourcesCache::icon(const QString &cacheKey)
+{
+    auto it = _icons.find(cacheKey);
+    if (it == _icons.end()) {
+        it = _icons.insert(cacheKey, QIcon(path(cacheKey)));
+    }
+    return it.value();
+}
+
+qint64 ResourcesCache::maximumSize()
+{
+    return maximumSizeC;
+}
+
+void ResourcesCache::fileUpdated(const QString &cacheKey, qint64 size)
+{
+    // the file might have been replaced
+    _icons.remove(cacheKey);
+    _currentSize += size;
+    if (_currentSize > maximumSizeC) {
+        expire();
+    }
+}
+
+void ResourcesCache::expire()
+{
+    // newest first
+    const auto files = QDir(_cacheDirectory).entryInfoList(QDir::Files, QDir::Time);
+    qint64 size = 0;
+    for (const auto &info : files) {
+        size += info.size();
+    }
+    for (auto it = files.crbegin(); it != files.crend() && size > maximumSizeC; ++it) {
+        qCDebug(lcResources) << "Removing least recently used" << it->fileName();
+        if (QFile::remove(it->filePath())) {
+            size -= it->size();
+            _icons.remove(it->fileName());
+        }
+    }
+    _currentSize = size;
 }
 
 }
@@ -3,16 +3,16 @@
 #include "account.h"
 #include "networkjobs.h"
 
+#include <QHash>
 #include <QIcon>
 #include <QLoggingCategory>
-#include <QTemporaryDir>
 
 namespace OCC {
 
 class ResourcesCache;
 
 /**
- * This job automatically downloads all available data from the server and stores it in a temporary cache directory on the disk.
+ * This job automatically downloads all available data from the server and stores it in the cache directory on the disk.
  * For convenience, a couple of conversion functions are available to convert the binary data to common Qt classes such as QIcon.
  */
 class OWNCLOUDSYNC_EXPORT ResourceJob : public SimpleNetworkJob
@@ -22,17 +22,27 @@ public:
 
     QIcon asIcon() const;
 
+    /** The path of the downloaded file in the cache, empty if the download failed */
+    QString cachePath() const;
+
 protected:
-    explicit ResourceJob(const ResourcesCache *cache, const QUrl &rootUrl, const QString &path, QObject *parent);
+    explicit ResourceJob(ResourcesCache *cache, const QUrl &rootUrl, const QString &path, QObject *parent);
 
 private:
-    const ResourcesCache *_cache;
+    ResourcesCache *_cache;
     QString _cacheKey;
 
     friend class ResourcesCache;
 };
 
 
+/**
+ * The downloaded resources are kept across restarts, the requests are revalidated with
+ * the ETag stored in the network cache, so an unchanged resource is not downloaded again.
+ *
+ * The directory is limited to maximumSize(), the least recently used files are removed first.
+ * The icons created from the files are kept in memory to share their rendered pixmaps.
+ */
 class OWNCLOUDSYNC_EXPORT ResourcesCache : public QObject
 {
     Q_OBJECT
@@ -40,22 +50,37 @@ class OWNCLOUDSYNC_EXPORT ResourcesCache : public QObject
 public:
     /**
      *
-     * @param cacheDirectory path to temporary cache parent directory (note: this directory must exist)
+     * @param cacheDirectory path to the cache directory (note: this directory must exist)
      * @param account
      */
     explicit ResourcesCache(const QString &cacheDirectory, Account *account);
 
-    ResourceJob *makeGetJob(const QUrl &rootUrl, const QString &path, QObject *parent) const;
+    ResourceJob *makeGetJob(const QUrl &rootUrl, const QString &path, QObject *parent);
 
-    ResourceJob *makeGetJob(const QString &path, QObject *parent) const;
+    ResourceJob *makeGetJob(const QString &path, QObject *parent);
 
     Account *account() const;
 
     QString path(const QString &cacheKey) const;
 
+    /** The icon of a cached file, shared between all users of the file */
+    QIcon icon(const QString &cacheKey);
+
+    static qint64 maximumSize();
+
 private:
+    /// A file of \a size was written or used
+    void fileUpdated(const QString &cacheKey, qint64 size);
+
+    /// Removes the least recently used files until the cache fits into maximumSize()
+    void expire();
+
     Account *_account;
-    QTemporaryDir _cacheDirectory;
+    QString _cacheDirectory;
+    qint64 _currentSize = 0;
+    QHash<QString, QIcon> _icons;
+
+    friend class ResourceJob;
 };
 
 } // namespace OCC
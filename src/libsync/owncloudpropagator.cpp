@@ -15,19 +15,27 @@
 
 #include "owncloudpropagator.h"
 #include "account.h"
+#include "caseclashindex.h"
 #include "common/asserts.h"
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
 #include "common/utility.h"
 #include "discoveryphase.h"
 #include "filesystem.h"
+#include "httplogger.h"
 #include "propagatedownload.h"
+#include "propagatedownloadarchive.h"
 #include "propagateremotedelete.h"
 #include "propagateremotemkdir.h"
 #include "propagateremotemove.h"
 #include "propagateupload.h"
+#include "propagateuploadbundle.h"
 #include "propagateuploadtus.h"
 #include "propagatorjobs.h"
+#include "stallwatchdog.h"
+#include "syncmetrics.h"
+#include "synctimeline.h"
+#include "uploadchunklisting.h"
 
 #ifdef Q_OS_WIN
 #include "common/utility_win.h"
@@ -42,6 +50,9 @@
 #include <QTimer>
 #include <qmath.h>
 
+#include <algorithm>
+#include <limits>
+
 using namespace std::chrono_literals;
 
 namespace OCC {
@@ -86,9 +97,69 @@ int OwncloudPropagator::maximumActiveTransferJob()
         // disable parallelism when there is a network limit.
         return 1;
     }
+    if (_syncOptions._transferConcurrencyMode == SyncOptions::TransferConcurrencyMode::Adaptive) {
+        return qBound(1, _account->transferConcurrency()->limit(), hardMaximumActiveJob());
+    }
     return qMin(3, qCeil(_syncOptions._parallelNetworkJobs / 2.));
 }
 
+void OwncloudPropagator::reportTransferSample(const AbstractNetworkJob *job, qint64 bytes)
+{
+    if (job->aborted()) {
+        return;
+    }
+    const int httpStatus = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const auto duration = job->duration();
+
+    if (_metrics) {
+        const QByteArray verb = HttpLogger::requestVerb(*job->reply());
+        const bool download = verb == QByteArrayLiteral("GET");
+        _metrics->addRequest(verb, duration, download ? 0 : bytes, download ? bytes : 0);
+        _metrics->addActiveJobs(_activeJobList.size());
+        _metrics->addBufferedBytes(job->maximumBufferedBytes());
+    }
+
+    if (httpStatus >= 200 && httpStatus < 300 && bytes > 0) {
+        // A small file should be done before its payload is a significant part of the request time.
+        // We estimate the request overhead from the small requests and the link speed from the large ones.
+        constexpr double weight = 1 / 8.;
+        auto ewma = [weight](double average, double value) { return average == 0 ? value : average + weight * (value - average); };
+        if (bytes < _smallFileSize) {
+            _smallTransferLatency = ewma(_smallTransferLatency, duration.count());
+        } else {
+            _largeTransferThroughput = ewma(_largeTransferThroughput, static_cast<double>(bytes) / qMax<qint64>(1, duration.count()));
+        }
+        if (_smallTransferLatency > 0 && _largeTransferThroughput > 0) {
+            _smallFileSize = qBound<qint64>(100 * 1024, static_cast<qint64>(_largeTransferThroughput * _smallTransferLatency), 10 * 1024 * 1024);
+        }
+    }
+
+    if (_syncOptions._transferConcurrencyMode == SyncOptions::TransferConcurrencyMode::Adaptive && !_bandwidthManager) {
+        _account->transferConcurrency()->addSample(bytes, duration, httpStatus);
+    }
+}
+
+void OwncloudPropagator::recordRequest(const QString &file, const AbstractNetworkJob *job, qint64 bytes)
+{
+    if (_timeline && !job->aborted()) {
+        _timeline->addRequest(file, job, bytes);
+    }
+}
+
+qint64 OwncloudPropagator::chunkSize() const
+{
+    return _account->chunkSizeController()->chunkSize(_syncOptions);
+}
+
+void OwncloudPropagator::reportChunkSample(qint64 bytes, std::chrono::milliseconds duration)
+{
+    auto *controller = _account->chunkSizeController();
+    controller->addSample(bytes, duration, _syncOptions);
+    if (_metrics) {
+        _metrics->addChunk(controller->chunkSize(_syncOptions));
+    }
+}
+
 /* The maximum number of active jobs in parallel  */
 int OwncloudPropagator::hardMaximumActiveJob()
 {
@@ -107,6 +178,36 @@ PropagateItemJob::~PropagateItemJob()
     }
 }
 
+void PropagateItemJob::abort(PropagatorJob::AbortType abortType)
+{
+    if (!deferAbort(abortType)) {
+        PropagatorJob::abort(abortType);
+    }
+}
+
+bool PropagateItemJob::deferAbort(PropagatorJob::AbortType abortType)
+{
+    if (abortType == AbortType::Asynchronous && _localIoPending) {
+        _abortFinishedPending = true;
+        return true;
+    }
+    return false;
+}
+
+void PropagateItemJob::beginStep(const char *name)
+{
+    if (propagator()->_timeline) {
+        propagator()->_timeline->begin(_item->_file, name);
+    }
+}
+
+void PropagateItemJob::endStep(const char *name)
+{
+    if (propagator()->_timeline) {
+        propagator()->_timeline->end(_item->_file, name);
+    }
+}
+
 bool PropagateItemJob::scheduleSelfOrChild()
 {
     if (state() != NotYetStarted) {
@@ -118,11 +219,19 @@ bool PropagateItemJob::scheduleSelfOrChild()
     if (thread() != QApplication::instance()->thread()) {
         QMetaObject::invokeMethod(this, &PropagateItemJob::start); // We could be in a different thread (neon jobs)
     } else {
+        const StallWatchdog::Activity activity("start", _item->_file);
+        endStep("queued");
+        beginStep("propagation");
         start();
     }
     return true;
 }
 
+qint64 PropagateItemJob::schedulingRank() const
+{
+    return propagator()->schedulingRank(*_item);
+}
+
 static qint64 getMinBlacklistTime()
 {
     return qMax(qEnvironmentVariableIntValue("OWNCLOUD_BLACKLIST_TIME_MIN"),
@@ -228,6 +337,11 @@ void PropagateItemJob::done(SyncFileItem::Status statusArg, const QString &error
     // Duplicate calls to done() are a logic error
     OC_ENFORCE(state() != Finished);
     setState(Finished);
+    const StallWatchdog::Activity activity("completion", _item->_file);
+    if (propagator()->_timeline) {
+        propagator()->_timeline->instant(_item->_file, "done", {{QStringLiteral("status"), Utility::enumToString(statusArg)}});
+        propagator()->_timeline->endAll(_item->_file);
+    }
 
     _item->_status = statusArg;
 
@@ -348,10 +462,25 @@ PropagateItemJob *OwncloudPropagator::createJob(const SyncFileItemPtr &item)
         if (item->_direction != SyncFileItem::Up) {
             auto job = new PropagateDownloadFile(this, item);
             job->setDeleteExistingFolder(deleteExisting);
+            if (!deleteExisting && item->_type == ItemTypeFile && item->_size < smallFileSize() && !item->_fileId.isEmpty()
+                && item->_directDownloadUrl.isEmpty() && !_archiveDownloadUnavailable && !_bandwidthManager
+                && !account()->capabilities().archiverUrl().isEmpty()) {
+                if (!_openArchive || !_openArchive->accepts(*item)) {
+                    _openArchive = new DownloadArchive(this);
+                }
+                job->setArchive(_openArchive);
+            }
             return job;
         } else {
             PropagateUploadFileCommon *job = nullptr;
-            if (account()->capabilities().tusSupport().isValid()) {
+            if (item->instruction() == CSYNC_INSTRUCTION_NEW && item->_size < smallFileSize() && account()->capabilities().bulkUpload()
+                && !_bulkUploadUnavailable && !_bandwidthManager && webDavUrl() == account()->davUrl()) {
+                // The bulk endpoint works on the user's files, so only use it for folders not backed by a space
+                if (!_openBundle || !_openBundle->accepts(*item)) {
+                    _openBundle = new UploadBundle(this);
+                }
+                job = new PropagateUploadFileBundled(this, item, _openBundle);
+            } else if (account()->capabilities().tusSupport().isValid()) {
                 job = new PropagateUploadFileTUS(this, item);
             } else {
                 if (item->_size > syncOptions()._initialChunkSize && account()->capabilities().chunkingNg()) {
@@ -388,8 +517,42 @@ PropagateItemJob *OwncloudPropagator::createJob(const SyncFileItemPtr &item)
 
 qint64 OwncloudPropagator::smallFileSize()
 {
-    const qint64 smallFileSize = 100 * 1024; //default to 1 MB. Not dynamic right now.
-    return smallFileSize;
+    return _smallFileSize;
+}
+
+bool OwncloudPropagator::isLargeTransfer(const SyncFileItem &item)
+{
+    if (item.isDirectory() || item._size < smallFileSize()) {
+        return false;
+    }
+    switch (item.instruction()) {
+    case CSYNC_INSTRUCTION_NEW:
+        [[fallthrough]];
+    case CSYNC_INSTRUCTION_SYNC:
+        [[fallthrough]];
+    case CSYNC_INSTRUCTION_CONFLICT:
+        [[fallthrough]];
+    case CSYNC_INSTRUCTION_TYPE_CHANGE:
+        // virtual files are just placeholders
+        return item._type != ItemTypeVirtualFile && item._type != ItemTypeVirtualFileDehydration;
+    default:
+        return false;
+    }
+}
+
+bool OwncloudPropagator::fitsSchedulingLane(PropagatorJob *job)
+{
+    if (_schedulingLane == SchedulingLane::Any) {
+        return true;
+    }
+    // directories contain jobs for both lanes
+    if (qobject_cast<PropagateDirectory *>(job)) {
+        return true;
+    }
+    if (auto itemJob = qobject_cast<PropagateItemJob *>(job)) {
+        return isLargeTransfer(itemJob->item()) == (_schedulingLane == SchedulingLane::LargeTransfers);
+    }
+    return true;
 }
 
 /**
@@ -397,6 +560,96 @@ qint64 OwncloudPropagator::smallFileSize()
  * Each directory is a PropagateDirectory job, which contains the files in it.
  */
 void OwncloudPropagator::start(SyncFileItemSet &&items)
+{
+    createRootJob();
+    findResumableTransfers(items);
+    addItems(items);
+
+    _jobScheduled = false;
+    scheduleNextJob();
+}
+
+void OwncloudPropagator::startPipelined()
+{
+    createRootJob();
+    _rootJob->_subJobs.setExpectingMoreJobs(true);
+
+    _jobScheduled = false;
+    scheduleNextJob();
+}
+
+void OwncloudPropagator::appendItems(SyncFileItemSet &&items)
+{
+    addItems(items);
+    scheduleNextJob();
+}
+
+void OwncloudPropagator::finishAppendingItems()
+{
+    _rootJob->_subJobs.setExpectingMoreJobs(false);
+    // finishes the root job if everything was propagated already
+    scheduleNextJob();
+}
+
+void OwncloudPropagator::createRootJob()
+{
+    _rootJob.reset(new PropagateRootDirectory(this));
+    connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
+
+    if (_syncOptions._transferConcurrencyMode == SyncOptions::TransferConcurrencyMode::Adaptive) {
+        _account->transferConcurrency()->setMaximum(hardMaximumActiveJob());
+    }
+}
+
+void OwncloudPropagator::findResumableTransfers(const SyncFileItemSet &items)
+{
+    QHash<QString, SyncJournalDb::UploadInfo> uploads;
+    for (auto &info : _journal->getUploadInfos()) {
+        // the small uploads are recorded as well, to detect a lost reply
+        if (info.isChunked()) {
+            uploads.insert(info._path, std::move(info));
+        }
+    }
+    const auto downloads = _journal->getDownloadInfos();
+    if (uploads.isEmpty() && downloads.isEmpty()) {
+        return;
+    }
+
+    int chunkedNgUploads = 0;
+    for (const auto &item : items) {
+        if (item->_type != ItemTypeFile
+            || !(item->instruction() & (CSYNC_INSTRUCTION_NEW | CSYNC_INSTRUCTION_SYNC | CSYNC_INSTRUCTION_CONFLICT | CSYNC_INSTRUCTION_TYPE_CHANGE))) {
+            continue;
+        }
+        if (item->_direction == SyncFileItem::Up) {
+            // the checksum is compared when the upload starts
+            const auto it = uploads.constFind(item->_file);
+            if (it != uploads.cend() && it->_size == item->_size && it->_modtime == item->_modtime) {
+                _resumablePaths.insert(item->_file);
+                if (it->_url.isEmpty()) {
+                    ++chunkedNgUploads;
+                }
+            }
+        } else if (item->_direction == SyncFileItem::Down) {
+            const auto it = downloads.constFind(item->_file);
+            if (it != downloads.cend() && it->_etag == item->_etag) {
+                _resumablePaths.insert(item->_file);
+            }
+        }
+    }
+    if (_resumablePaths.isEmpty()) {
+        return;
+    }
+    qCInfo(lcPropagator) << "Resuming" << _resumablePaths.size() << "interrupted transfers first";
+
+    // one listing for all uploads instead of one per upload
+    if (chunkedNgUploads > 1 && account()->capabilities().chunkingNg() && account()->capabilities().propfindDepthInfinity()) {
+        _uploadChunkListing = new UploadChunkListing(account(), this);
+        _uploadChunkListing->start();
+    }
+}
+
+void OwncloudPropagator::addItems(const SyncFileItemSet &items)
 {
     // The items list is sorted in such a way that an item for a directory come before any items
     // inside that directory. For example:
@@ -408,8 +661,6 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
     // are grouped together, and that an action on the directory itself preceeds the actions for
     // its child items.
 
-    _rootJob.reset(new PropagateRootDirectory(this));
-
     // The algorithm could be done recursively, but the implementation is done iteratively in order
     // to prevent us running out of stack space. So the next 3 variables are used to maintain the
     // state.
@@ -441,6 +692,13 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
     // See the `else` statment in the second step.
     QString maybeConflictDirectory;
 
+    // The open PropagateItemsBulk of each directory, a directory is continued
+    // after the items of its subdirectories.
+    QHash<PropagateDirectory *, PropagateItemsBulk *> itemsBulks;
+
+    // A directory is ranked by its best ranked file, see SyncOptions::_propagationOrder
+    const bool ordered = hasSchedulingOrder();
+
     for (const auto &item : std::as_const(items)) {
         // First check if this is an item in a directory which is going to be removed.
         if (currentRemoveDirectoryJob && FileSystem::isChildPathOf(item->_file, currentRemoveDirectoryJob->path())) {
@@ -496,6 +754,10 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
             directories.pop();
         }
 
+        if (_timeline) {
+            _timeline->begin(item->_file, "queued");
+        }
+
         // The last step is to add a subtask for the item. There are 4 cases covered here:
         // a type change vs. a removal, and a file vs. a directory.
         if (item->isDirectory()) {
@@ -542,9 +804,22 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
                 // will delete directories, so defer execution
                 currentRemoveDirectoryJob = createJob(item);
                 _rootJob->addDeleteJob(currentRemoveDirectoryJob);
+            } else if (PropagateItemsBulk::accepts(this, *item)) {
+                auto &bulk = itemsBulks[directories.top().second];
+                if (!bulk || bulk->isFull()) {
+                    bulk = new PropagateItemsBulk(this, directories.top().first);
+                    directories.top().second->appendJob(bulk);
+                }
+                bulk->addItem(item);
             } else {
                 directories.top().second->appendTask(item);
             }
+            if (ordered) {
+                const qint64 rank = schedulingRank(*item);
+                for (const auto &dir : std::as_const(directories)) {
+                    dir.second->lowerRank(rank);
+                }
+            }
 
             if (item->instruction() == CSYNC_INSTRUCTION_CONFLICT) {
                 // This might be a file or a directory on the local side. If it's a
@@ -554,10 +829,6 @@ void OwncloudPropagator::start(SyncFileItemSet &&items)
         }
     }
 
-    connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
-
-    _jobScheduled = false;
-    scheduleNextJob();
 }
 
 const SyncOptions &OwncloudPropagator::syncOptions() const
@@ -565,10 +836,36 @@ const SyncOptions &OwncloudPropagator::syncOptions() const
     return _syncOptions;
 }
 
+qint64 OwncloudPropagator::schedulingRank(const SyncFileItem &item) const
+{
+    if (!_priorityPaths.isEmpty()) {
+        // the requested paths and everything below them
+        QStringView path = item.destination();
+        while (!path.isEmpty()) {
+            if (_priorityPaths.contains(path.toString())) {
+                return std::numeric_limits<qint64>::min();
+            }
+            path = path.left(std::max<qsizetype>(0, path.lastIndexOf(QLatin1Char('/'))));
+        }
+    }
+    if (_resumablePaths.contains(item._file)) {
+        return std::numeric_limits<qint64>::min() + 1;
+    }
+    switch (_syncOptions._propagationOrder) {
+    case SyncOptions::PropagationOrder::Path:
+        return 0;
+    case SyncOptions::PropagationOrder::RecentlyModifiedFirst:
+        return -static_cast<qint64>(item._modtime);
+    case SyncOptions::PropagationOrder::SmallestFirst:
+        return item.isDirectory() ? 0 : item._size;
+    }
+    Q_UNREACHABLE();
+}
+
 Result<QString, bool> OwncloudPropagator::localFileNameClash(const QString &relFile)
 {
     OC_ASSERT(!relFile.isEmpty());
-    if (!relFile.isEmpty() && Utility::fsCasePreserving()) {
+    if (!relFile.isEmpty() && Utility::fsCasePreserving() && (!_caseClashIndex || _caseClashIndex->mayClash(relFile))) {
         const QFileInfo fileInfo(_localDir + relFile);
 #ifdef Q_OS_MAC
         if (!fileInfo.exists()) {
@@ -610,6 +907,9 @@ Result<QString, bool> OwncloudPropagator::localFileNameClash(const QString &relF
 bool OwncloudPropagator::hasCaseClashAccessibilityProblem(const QString &relfile)
 {
 #ifdef Q_OS_WIN
+    if (_caseClashIndex && !_caseClashIndex->mayClash(relfile)) {
+        return false;
+    }
     bool result = false;
     const QString file(_localDir + relfile);
     WIN32_FIND_DATA FindFileData;
@@ -663,27 +963,55 @@ void OwncloudPropagator::scheduleNextJobImpl()
 
     _jobScheduled = false;
 
-    if (_activeJobList.count() < maximumActiveTransferJob()) {
-        if (_rootJob->scheduleSelfOrChild()) {
-            scheduleNextJob();
-        }
-    } else if (_activeJobList.count() < hardMaximumActiveJob()) {
-        int likelyFinishedQuicklyCount = 0;
-        // NOTE: Only counts the first 3 jobs! Then for each
-        // one that is likely finished quickly, we can launch another one.
-        // When a job finishes another one will "move up" to be one of the first 3 and then
-        // be counted too.
-        for (int i = 0; i < maximumActiveTransferJob() && i < _activeJobList.count(); i++) {
-            if (_activeJobList.at(i)->isLikelyFinishedQuickly()) {
-                likelyFinishedQuicklyCount++;
-            }
-        }
-        if (_activeJobList.count() < maximumActiveTransferJob() + likelyFinishedQuicklyCount) {
-            qCDebug(lcPropagator) << "Can pump in another request! activeJobs =" << _activeJobList.count();
+    // the other syncs of the account use the same connections to the server
+    auto *bandwidthManager = BandwidthManager::instance();
+    bandwidthManager->setActiveJobs(this, _account.data(), _activeJobList.count());
+    const int connectionBudget = hardMaximumActiveJob() - bandwidthManager->activeJobs(_account.data(), this);
+    if (connectionBudget <= 0 || !_rootJob) {
+        // scheduled again once the other syncs finished jobs
+        return;
+    }
+
+    const int largeTransferBudget = qMin(maximumActiveTransferJob(), connectionBudget);
+    const int smallTransferBudget = connectionBudget - largeTransferBudget;
+
+    if (smallTransferBudget <= 0) {
+        // no room for a separate lane, schedule strictly in order
+        if (_activeJobList.count() < largeTransferBudget) {
             if (_rootJob->scheduleSelfOrChild()) {
                 scheduleNextJob();
             }
         }
+        return;
+    }
+
+    // Small files are dominated by the request latency, large ones by the bandwidth.
+    // Each gets its own budget so that neither can starve the other.
+    int largeTransfers = 0;
+    for (auto *job : std::as_const(_activeJobList)) {
+        if (isLargeTransfer(job->item())) {
+            largeTransfers++;
+        }
+    }
+    const int smallTransfers = _activeJobList.count() - largeTransfers;
+
+    const bool largeLaneFree = largeTransfers < largeTransferBudget;
+    const bool smallLaneFree = smallTransfers < smallTransferBudget;
+    if (largeLaneFree && smallLaneFree) {
+        _schedulingLane = SchedulingLane::Any;
+    } else if (largeLaneFree) {
+        _schedulingLane = SchedulingLane::LargeTransfers;
+    } else if (smallLaneFree) {
+        qCDebug(lcPropagator) << "Can pump in another small request! activeJobs =" << _activeJobList.count();
+        _schedulingLane = SchedulingLane::SmallTransfers;
+    } else {
+        return;
+    }
+
+    const bool scheduled = _rootJob->scheduleSelfOrChild();
+    _schedulingLane = SchedulingLane::Any;
+    if (scheduled) {
+        scheduleNextJob();
     }
 }
 
@@ -696,6 +1024,7 @@ void OwncloudPropagator::abort()
 {
     if (_abortRequested)
         return;
+    _abortRequested = true;
     if (_rootJob) {
         // Connect to abortFinished  which signals that abort has been asynchronously finished
         connect(_rootJob.data(), &PropagateDirectory::abortFinished, this, &OwncloudPropagator::emitFinished);
@@ -757,16 +1086,13 @@ bool OwncloudPropagator::createConflict(const SyncFileItemPtr &item,
         item->_file, Utility::qDateTimeFromTime_t(conflictModTime), conflictUserName);
     QString conflictFilePath = fullLocalPath(conflictFileName);
 
-    // If the file is locked, we want to retry this sync when it
-    // becomes available again.
-    if (FileSystem::isFileLocked(fn, FileSystem::LockMode::Exclusive)) {
-        Q_EMIT seenLockedFile(fn, FileSystem::LockMode::Exclusive);
-        if (error)
-            *error = tr("File %1 is currently in use").arg(fn);
-        return false;
-    }
-
     if (!FileSystem::rename(fn, conflictFilePath, &renameError)) {
+        // If the file is locked, we want to retry this sync when it
+        // becomes available again. Only probed after a failure, as that is slow.
+        if (FileSystem::isFileLocked(fn, FileSystem::LockMode::Exclusive)) {
+            Q_EMIT seenLockedFile(fn, FileSystem::LockMode::Exclusive);
+            renameError = tr("File %1 is currently in use").arg(fn);
+        }
         // If the rename fails, don't replace it.
         if (error)
             *error = renameError;
@@ -849,6 +1175,9 @@ Result<Vfs::ConvertToPlaceholderResult, QString> OwncloudPropagator::updateMetad
     if (!dBresult) {
         return dBresult.error();
     }
+    if (_timeline) {
+        _timeline->instant(item._file, "journal");
+    }
     return Vfs::ConvertToPlaceholderResult::Ok;
 }
 
@@ -898,9 +1227,34 @@ void PropagatorCompositeJob::slotSubJobAbortFinished()
 void PropagatorCompositeJob::appendJob(PropagatorJob *job)
 {
     job->setAssociatedComposite(this);
+    // appending in order doesn't need to sort again
+    if (!_jobsToDo.isEmpty() && propagator()->hasSchedulingOrder() && job->schedulingRank() < _jobsToDo.last()->schedulingRank()) {
+        _jobsOrdered = false;
+    }
     _jobsToDo.append(job);
 }
 
+void PropagatorCompositeJob::appendTask(const SyncFileItemPtr &item)
+{
+    _tasksToDo.emplace(propagator()->schedulingRank(*item), item);
+}
+
+void PropagatorCompositeJob::sortJobsToDo()
+{
+    _jobsOrdered = true;
+    if (!propagator()->hasSchedulingOrder()) {
+        return;
+    }
+    // The jobs after a job that doesn't allow parallelism must wait for it,
+    // so only the jobs between those are reordered.
+    auto begin = _jobsToDo.begin();
+    while (begin != _jobsToDo.end()) {
+        const auto end = std::find_if(begin, _jobsToDo.end(), [](PropagatorJob *job) { return job->parallelism() != FullParallelism; });
+        std::stable_sort(begin, end, [](PropagatorJob *a, PropagatorJob *b) { return a->schedulingRank() < b->schedulingRank(); });
+        begin = end == _jobsToDo.end() ? end : std::next(end);
+    }
+}
+
 bool PropagatorCompositeJob::scheduleSelfOrChild()
 {
     if (state() == Finished) {
@@ -929,29 +1283,70 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
     }
 
     // Now it's our turn, check if we have something left to do.
-    // First, convert a task to a job if necessary
-    while (_jobsToDo.empty() && !_tasksToDo.empty()) {
-        const SyncFileItemPtr nextTask = *_tasksToDo.begin();
-        _tasksToDo.erase(_tasksToDo.begin());
-        PropagatorJob *job = propagator()->createJob(nextTask);
-        if (!job) {
-            qCWarning(lcDirectory) << "Useless task found for file" << nextTask->destination() << "instruction" << nextTask->instruction();
-            continue;
+    if (!_jobsOrdered) {
+        sortJobsToDo();
+    }
+    // Prefer the jobs that were already created, a job that doesn't allow parallelism
+    // is never passed even if it doesn't fit into the current lane
+    auto nextJobIt = _jobsToDo.end();
+    bool blocked = false;
+    for (auto it = _jobsToDo.begin(); it != _jobsToDo.end(); ++it) {
+        if (propagator()->fitsSchedulingLane(*it)) {
+            nextJobIt = it;
+            break;
+        }
+        if ((*it)->parallelism() != FullParallelism) {
+            blocked = true;
+            break;
+        }
+    }
+    // unless a task is ranked better and no job must run before it, see OwncloudPropagator::schedulingRank()
+    qint64 jobRank = std::numeric_limits<qint64>::max();
+    if (nextJobIt != _jobsToDo.end()) {
+        jobRank = (*nextJobIt)->schedulingRank();
+        if (!_tasksToDo.empty() && _tasksToDo.begin()->first < jobRank
+            && std::any_of(_jobsToDo.begin(), _jobsToDo.end(), [](PropagatorJob *job) { return job->parallelism() != FullParallelism; })) {
+            jobRank = std::numeric_limits<qint64>::min();
+        }
+    }
+    if (!blocked && (nextJobIt == _jobsToDo.end() || (!_tasksToDo.empty() && _tasksToDo.begin()->first < jobRank))) {
+        // Then convert a task to a job if necessary.
+        // If only one lane has room we look ahead for a task fitting into it,
+        // the look ahead is limited to keep the scheduling cheap for huge directories.
+        constexpr int laneLookAhead = 64;
+        int lookedAhead = 0;
+        for (auto it = _tasksToDo.begin(); it != _tasksToDo.end() && it->first < jobRank && lookedAhead < laneLookAhead;) {
+            const SyncFileItemPtr nextTask = it->second;
+            if (propagator()->schedulingLane() != OwncloudPropagator::SchedulingLane::Any
+                && propagator()->isLargeTransfer(*nextTask) != (propagator()->schedulingLane() == OwncloudPropagator::SchedulingLane::LargeTransfers)) {
+                ++it;
+                ++lookedAhead;
+                continue;
+            }
+            it = _tasksToDo.erase(it);
+            PropagatorJob *job = propagator()->createJob(nextTask);
+            if (!job) {
+                qCWarning(lcDirectory) << "Useless task found for file" << nextTask->destination() << "instruction" << nextTask->instruction();
+                continue;
+            }
+            // it is started right away, the order of the other jobs doesn't change
+            job->setAssociatedComposite(this);
+            _jobsToDo.append(job);
+            nextJobIt = std::prev(_jobsToDo.end());
+            break;
         }
-        appendJob(job);
-        break;
     }
     // Then run the next job
-    if (!_jobsToDo.isEmpty()) {
-        PropagatorJob *nextJob = _jobsToDo.first();
-        _jobsToDo.remove(0);
+    if (nextJobIt != _jobsToDo.end()) {
+        PropagatorJob *nextJob = *nextJobIt;
+        _jobsToDo.erase(nextJobIt);
         _runningJobs.append(nextJob);
         return possiblyRunNextJob(nextJob);
     }
 
     // If neither us or our children had stuff left to do we could hang. Make sure
     // we mark this job as finished so that the propagator can schedule a new one.
-    if (_jobsToDo.isEmpty() && _tasksToDo.empty() && _runningJobs.isEmpty()) {
+    if (_jobsToDo.isEmpty() && _tasksToDo.empty() && _runningJobs.isEmpty() && !_expectingMoreJobs) {
         // Our parent jobs are already iterating over their running jobs, post to the event loop
         // to avoid removing ourself from that list while they iterate.
         QMetaObject::invokeMethod(this, &PropagatorCompositeJob::finalize, Qt::QueuedConnection);
@@ -986,7 +1381,7 @@ void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
         break;
     }
 
-    if (_jobsToDo.isEmpty() && _tasksToDo.empty() && _runningJobs.isEmpty()) {
+    if (_jobsToDo.isEmpty() && _tasksToDo.empty() && _runningJobs.isEmpty() && !_expectingMoreJobs) {
         finalize();
     } else {
         propagator()->scheduleNextJob();
@@ -1024,6 +1419,7 @@ PropagateDirectory::PropagateDirectory(OwncloudPropagator *propagator, const Syn
     : PropagateItemJob(propagator, item)
     , _firstJob(propagator->createJob(item))
     , _subJobs(propagator, path())
+    , _rank(propagator->schedulingRank(*item))
 {
     if (_firstJob) {
         connect(_firstJob.get(), &PropagatorJob::finished, this, &PropagateDirectory::slotFirstJobFinished);
@@ -1045,6 +1441,16 @@ PropagatorJob::JobParallelism PropagateDirectory::parallelism()
 }
 
 
+void PropagateDirectory::lowerRank(qint64 rank)
+{
+    if (rank < _rank) {
+        _rank = rank;
+        if (_associatedComposite) {
+            _associatedComposite->invalidateOrder();
+        }
+    }
+}
+
 bool PropagateDirectory::scheduleSelfOrChild()
 {
     if (state() == Finished) {
@@ -18,11 +18,17 @@
 #include <QHash>
 #include <QObject>
 #include <QMap>
+#include <QSet>
 #include <QElapsedTimer>
 #include <QTimer>
 #include <QPointer>
 #include <QIODevice>
 #include <QMutex>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+#include <memory>
+#include <type_traits>
 
 #include "csync.h"
 #include "syncfileitem.h"
@@ -44,11 +50,18 @@ qint64 criticalFreeSpaceLimit();
  *
  * Uploads will still run and downloads that are small enough will continue too.
  */
-qint64 freeSpaceLimit();
+OWNCLOUDSYNC_EXPORT qint64 freeSpaceLimit();
 
+class AbstractNetworkJob;
+class CaseClashIndex;
+class DownloadArchive;
 class SyncJournalDb;
+class SyncMetrics;
+class SyncTimeline;
 class OwncloudPropagator;
 class PropagatorCompositeJob;
+class UploadBundle;
+class UploadChunkListing;
 
 /**
  * @brief the base class of propagator jobs
@@ -107,6 +120,12 @@ public:
      */
     virtual qint64 committedDiskSpace() const { return 0; }
 
+    /** The position of the job in the propagation order, lower ranks are scheduled first
+     *
+     * See OwncloudPropagator::schedulingRank().
+     */
+    virtual qint64 schedulingRank() const { return 0; }
+
     /** Set the associated composite job
      *
      * Used only from PropagatorCompositeJob itself, when a job is added
@@ -179,10 +198,38 @@ public:
     }
     ~PropagateItemJob() override;
     bool scheduleSelfOrChild() override;
+    qint64 schedulingRank() const override;
 
     const SyncFileItem &item() const { return *_item.data(); }
+
+    /** An asynchronous abort waits for a local operation started with runLocalIo() */
+    void abort(PropagatorJob::AbortType abortType) override;
+
 public Q_SLOTS:
     virtual void start() = 0;
+
+protected:
+    /** Runs \a operation with OwncloudPropagator::runLocalIo() and passes its result to \a continuation
+     *
+     * The job counts as an active job while the operation runs. If the sync is aborted meanwhile,
+     * the job is done once the operation returned, instead of calling \a continuation.
+     */
+    template <typename Operation, typename Continuation>
+    void runLocalIo(Operation &&operation, Continuation &&continuation);
+
+    /** Returns true if an asynchronous abort has to wait for a local operation
+     *
+     * For jobs that override abort(), abortFinished() is emitted once the operation returned.
+     */
+    bool deferAbort(PropagatorJob::AbortType abortType);
+
+    /** Begins and ends a step of the item in OwncloudPropagator::_timeline, if there is one */
+    void beginStep(const char *name);
+    void endStep(const char *name);
+
+private:
+    bool _localIoPending = false;
+    bool _abortFinishedPending = false;
 };
 
 /**
@@ -203,10 +250,13 @@ public:
     }
 
     void appendJob(PropagatorJob *job);
-    void appendTask(const SyncFileItemPtr &item)
-    {
-        _tasksToDo.insert(item);
-    }
+    void appendTask(const SyncFileItemPtr &item);
+
+    /** The rank of a job in _jobsToDo was lowered, they are sorted again before the next scheduling */
+    void invalidateOrder() { _jobsOrdered = false; }
+
+    /** While set the job doesn't finish when it runs out of work, more is appended later */
+    void setExpectingMoreJobs(bool expecting) { _expectingMoreJobs = expecting; }
 
     bool scheduleSelfOrChild() override;
     JobParallelism parallelism() override;
@@ -253,11 +303,16 @@ private Q_SLOTS:
     void finalize();
 
 private:
+    void sortJobsToDo();
+
     QVector<PropagatorJob *> _jobsToDo;
-    SyncFileItemSet _tasksToDo;
+    // the tasks by their OwncloudPropagator::schedulingRank(), then by path
+    std::set<std::pair<qint64, SyncFileItemPtr>> _tasksToDo;
     QVector<PropagatorJob *> _runningJobs;
     QMap<QString, SyncFileItem::Status> _errorPaths; // NoStatus,  or NormalError / SoftError if there was an error
     quint64 _abortsCount = 0;
+    bool _expectingMoreJobs = false;
+    bool _jobsOrdered = true;
 };
 
 /**
@@ -310,6 +365,12 @@ public:
         return _subJobs.committedDiskSpace();
     }
 
+    /// The best rank of the directory and its content
+    qint64 schedulingRank() const override { return _rank; }
+
+    /** Called for each item added below the directory, see OwncloudPropagator::addItems() */
+    void lowerRank(qint64 rank);
+
     SyncFileItemPtr &item()
     {
         return _item;
@@ -319,6 +380,9 @@ private Q_SLOTS:
     void start() override {};
     void slotFirstJobFinished(SyncFileItem::Status status);
     virtual void slotSubJobsFinished(const SyncFileItem::Status status);
+
+private:
+    qint64 _rank;
 };
 
 /**
@@ -391,7 +455,6 @@ public:
         : _journal(progressDb)
         , _finishedEmited(false)
         , _anotherSyncNeeded(false)
-        , _chunkSize(options._initialChunkSize)
         , _account(account)
         , _syncOptions(options)
         , _localDir((localDir.endsWith(QLatin1Char('/'))) ? localDir : localDir + QLatin1Char('/'))
@@ -399,16 +462,69 @@ public:
         , _webDavUrl(baseUrl)
     {
         qRegisterMetaType<PropagatorJob::AbortType>("PropagatorJob::AbortType");
+        _localIoPool.setMaxThreadCount(1);
+        connect(BandwidthManager::instance(), &BandwidthManager::activeJobsDecreased, this, [this](const Account *account) {
+            if (account == _account.data() && _rootJob && !_finishedEmited) {
+                scheduleNextJob();
+            }
+        });
     }
 
     ~OwncloudPropagator() override;
 
     void start(SyncFileItemSet &&_syncedItems);
 
+    /** Starts a propagation whose items are added with appendItems()
+     *
+     * Used to propagate parts of the tree while the discovery continues, the
+     * propagation doesn't finish before finishAppendingItems() was called.
+     */
+    void startPipelined();
+
+    /** Adds items to a propagation started with startPipelined()
+     *
+     * The items must form complete subtrees of the root directory, that are
+     * not affected by any other items.
+     */
+    void appendItems(SyncFileItemSet &&items);
+
+    /** No more items will be appended, see startPipelined() */
+    void finishAppendingItems();
+
     const SyncOptions &syncOptions() const;
 
+    /** The files and directories the user waits for, propagated before everything else
+     *
+     * Must be set before the propagation starts.
+     */
+    void setPriorityPaths(const QSet<QString> &paths) { _priorityPaths = paths; }
+
+    /** The position of \a item in the propagation order, see SyncOptions::_propagationOrder
+     *
+     * The priority paths come first, then the interrupted transfers that can be resumed.
+     */
+    qint64 schedulingRank(const SyncFileItem &item) const;
+
+    /** Whether the jobs are scheduled in a different order than their paths */
+    bool hasSchedulingOrder() const
+    {
+        return _syncOptions._propagationOrder != SyncOptions::PropagationOrder::Path || !_priorityPaths.isEmpty() || !_resumablePaths.isEmpty();
+    }
+
+    /** The listing of the unfinished chunked uploads, if several of them are resumed */
+    UploadChunkListing *uploadChunkListing() const { return _uploadChunkListing; }
+
     QPointer<BandwidthManager> _bandwidthManager;
 
+    /** Collects the metrics of the sync run, optional */
+    SyncMetrics *_metrics = nullptr;
+
+    /** Records the lifecycle of the items, optional */
+    SyncTimeline *_timeline = nullptr;
+
+    /** The names of the discovered folders, see localFileNameClash(), optional */
+    std::shared_ptr<const CaseClashIndex> _caseClashIndex;
+
     bool _abortRequested = false;
 
     /** The list of currently active jobs.
@@ -422,6 +538,12 @@ public:
     /** We detected that another sync is required after this one */
     bool _anotherSyncNeeded;
 
+    /** The server advertised bulk uploads but rejected the request, use single uploads */
+    bool _bulkUploadUnavailable = false;
+
+    /** The server advertised an archiver but rejected the request, use single downloads */
+    bool _archiveDownloadUnavailable = false;
+
     /** Per-folder quota guesses.
      *
      * This starts out empty. When an upload in a folder fails due to insufficent
@@ -438,15 +560,56 @@ public:
     /* the maximum number of jobs using bandwidth (uploads or downloads, in parallel) */
     int maximumActiveTransferJob();
 
+    /** Report a finished upload or download request.
+     *
+     * Used to adjust maximumActiveTransferJob() when
+     * SyncOptions::TransferConcurrencyMode::Adaptive is used and
+     * recorded in _metrics.
+     * \a bytes is the payload size of the request.
+     */
+    void reportTransferSample(const AbstractNetworkJob *job, qint64 bytes);
+
+    /** Records a finished request of \a file in _timeline, if there is one */
+    void recordRequest(const QString &file, const AbstractNetworkJob *job, qint64 bytes);
+
+    /** Report an uploaded chunk, to adjust chunkSize() */
+    void reportChunkSample(qint64 bytes, std::chrono::milliseconds duration);
+
     /** The size to use for upload chunks.
      *
-     * Will be dynamically adjusted after each chunk upload finishes
-     * if Capabilities::desiredChunkUploadDuration has a target
-     * chunk-upload duration set.
+     * Adjusted after each chunk upload finishes if
+     * SyncOptions::_targetChunkUploadDuration is set, see ChunkSizeController.
+     */
+    qint64 chunkSize() const;
+
+    /** Files below this size are transferred in the small file lane.
+     *
+     * Derived from the recent requests: a file is small if transferring its
+     * payload takes less time than the request overhead.
      */
-    qint64 _chunkSize;
     qint64 smallFileSize();
 
+    /** The lanes jobs are scheduled in, each with its own budget.
+     *
+     * Large transfers may use maximumActiveTransferJob() slots, small transfers
+     * and all other jobs the remaining slots up to hardMaximumActiveJob().
+     */
+    enum class SchedulingLane {
+        Any,
+        LargeTransfers,
+        SmallTransfers
+    };
+    Q_ENUM(SchedulingLane)
+
+    /** The lane that is allowed to start a job during the ongoing scheduling step */
+    SchedulingLane schedulingLane() const { return _schedulingLane; }
+
+    /** Whether \a item is a transfer that belongs into the large transfer lane */
+    bool isLargeTransfer(const SyncFileItem &item);
+
+    /** Whether \a job may be started in the current scheduling lane */
+    bool fitsSchedulingLane(PropagatorJob *job);
+
     /* The maximum number of active jobs in parallel  */
     int hardMaximumActiveJob();
 
@@ -518,6 +681,20 @@ public:
     bool createConflict(const SyncFileItemPtr &item,
         PropagatorCompositeJob *composite, QString *error);
 
+    /** Runs a local file system operation away from the main thread
+     *
+     * Network shares or virus scanners can make each call take a long time,
+     * the event loop keeps handling the network meanwhile. The operations run
+     * one after the other, in the order they were submitted.
+     * The operation must not use the journal or the jobs, the caller handles
+     * the result with QFuture::then() and its job as context.
+     */
+    template <typename Operation>
+    auto runLocalIo(Operation &&operation)
+    {
+        return QtConcurrent::run(&_localIoPool, std::forward<Operation>(operation));
+    }
+
     // Map original path (as in the DB) to target final path
     // TODO: no public members...
     QHash<QString, QString> _renamedDirectories;
@@ -553,6 +730,8 @@ private Q_SLOTS:
         if (!_finishedEmited)
             Q_EMIT finished(status == SyncFileItem::Success);
         _finishedEmited = true;
+        // hand the connections to the other syncs of the account
+        BandwidthManager::instance()->setActiveJobs(this, _account.data(), 0);
     }
 
     void scheduleNextJobImpl();
@@ -571,16 +750,63 @@ Q_SIGNALS:
     void insufficientRemoteStorage();
 
 private:
+    void createRootJob();
+    /// Builds the jobs of \a items below the root job, see start()
+    void addItems(const SyncFileItemSet &items);
+    /// Collects the transfers of \a items that were interrupted and can be resumed
+    void findResumableTransfers(const SyncFileItemSet &items);
+
     AccountPtr _account;
     QScopedPointer<PropagateRootDirectory> _rootJob;
     SyncOptions _syncOptions;
+    QSet<QString> _priorityPaths;
+    QSet<QString> _resumablePaths;
+    QPointer<UploadChunkListing> _uploadChunkListing;
     bool _jobScheduled = false;
+    SchedulingLane _schedulingLane = SchedulingLane::Any;
 
     const QString _localDir; // absolute path to the local directory. ends with '/'
     const QString _remoteFolder; // remote folder, ends with '/'
     const QUrl _webDavUrl; // full WebDAV URL, might be the same as in the account
+
+    // Exponential moving averages of recent requests, used for smallFileSize()
+    qint64 _smallFileSize = 100 * 1024;
+    double _largeTransferThroughput = 0; // bytes per millisecond
+    double _smallTransferLatency = 0; // milliseconds
+
+    // the bundle new small uploads are added to, see createJob()
+    QPointer<UploadBundle> _openBundle;
+
+    // the archive new small downloads are added to, see createJob()
+    QPointer<DownloadArchive> _openArchive;
+
+    // a single thread for runLocalIo()
+    QThreadPool _localIoPool;
 };
 
+template <typename Operation, typename Continuation>
+void PropagateItemJob::runLocalIo(Operation &&operation, Continuation &&continuation)
+{
+    using Result = std::invoke_result_t<std::decay_t<Operation>>;
+    propagator()->_activeJobList.append(this);
+    _localIoPending = true;
+    propagator()
+        ->runLocalIo(std::forward<Operation>(operation))
+        .then(this, [this, continuation = std::forward<Continuation>(continuation)](const Result &result) {
+            propagator()->_activeJobList.removeOne(this);
+            _localIoPending = false;
+            if (propagator()->_abortRequested) {
+                done(SyncFileItem::NormalError, tr("Operation was canceled"));
+                if (_abortFinishedPending) {
+                    _abortFinishedPending = false;
+                    Q_EMIT abortFinished();
+                }
+                return;
+            }
+            continuation(result);
+        });
+}
+
 /**
  * @brief Update MetaData (Permissions and etag) of files
  */
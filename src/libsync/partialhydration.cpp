@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "partialhydration.h"
+
+#include "account.h"
+#include "propagatedownload.h"
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <utility>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcPartialHydration, "sync.partialhydration", QtInfoMsg)
+
+PartialHydration::PartialHydration(AccountPtr account, const QUrl &baseUrl, const QString &remotePath, const QString &localPath, SyncJournalDb *journal,
+    const QString &relativePath, const QByteArray &etag, qint64 size, QObject *parent)
+    : QObject(parent)
+    , _account(account)
+    , _baseUrl(baseUrl)
+    , _remotePath(remotePath)
+    , _localPath(localPath)
+    , _journal(journal)
+    , _relativePath(relativePath.toUtf8())
+    , _etag(etag)
+    , _size(size)
+    , _ranges(journal->hydratedRanges(_relativePath, etag))
+{
+}
+
+PartialHydration::~PartialHydration()
+{
+    // the job writes to _device, it must go first
+    delete _job;
+}
+
+void PartialHydration::hydrate(qint64 offset, qint64 length, Priority priority)
+{
+    const Request request = {{offset, offset + length}, priority};
+    if (priority == Priority::Foreground) {
+        const auto it = std::find_if(_requests.begin(), _requests.end(), [](const Request &r) { return r.priority == Priority::Background; });
+        const bool preempt = _job && it == _requests.begin();
+        _requests.insert(it, request);
+        if (preempt) {
+            // what the download got so far is kept, the rest is requested again later
+            qCInfo(lcPartialHydration) << "Interrupting the background hydration of" << _remotePath;
+            _preempted = true;
+            _job->abort();
+            return;
+        }
+    } else {
+        _requests.enqueue(request);
+    }
+    if (!_job) {
+        startNext();
+    }
+}
+
+bool PartialHydration::isHydrated(qint64 offset, qint64 length) const
+{
+    return missing(_ranges, {offset, std::min(offset + length, _size)}).isEmpty();
+}
+
+bool PartialHydration::isComplete() const
+{
+    return isHydrated(0, _size);
+}
+
+QVector<PartialHydration::ByteRange> PartialHydration::merged(const QVector<ByteRange> &ranges, ByteRange range)
+{
+    QVector<ByteRange> out;
+    out.reserve(ranges.size() + 1);
+    for (const auto &r : ranges) {
+        if (r.end < range.start || r.start > range.end) {
+            out.append(r);
+        } else {
+            // overlapping or adjacent
+            range = {std::min(r.start, range.start), std::max(r.end, range.end)};
+        }
+    }
+    if (range.size() > 0) {
+        out.insert(std::lower_bound(out.begin(), out.end(), range, [](const ByteRange &a, const ByteRange &b) { return a.start < b.start; }), range);
+    }
+    return out;
+}
+
+QVector<PartialHydration::ByteRange> PartialHydration::missing(const QVector<ByteRange> &ranges, ByteRange range)
+{
+    QVector<ByteRange> out;
+    qint64 position = range.start;
+    for (const auto &r : ranges) {
+        if (r.end <= position) {
+            continue;
+        }
+        if (r.start >= range.end) {
+            break;
+        }
+        if (r.start > position) {
+            out.append({position, r.start});
+        }
+        position = r.end;
+    }
+    if (position < range.end) {
+        out.append({position, range.end});
+    }
+    return out;
+}
+
+PartialHydration::ByteRange PartialHydration::aligned(ByteRange range, qint64 size)
+{
+    const qint64 start = range.start / BlockSize * BlockSize;
+    const qint64 end = (range.end + BlockSize - 1) / BlockSize * BlockSize;
+    return {std::max<qint64>(start, 0), std::min(end, size)};
+}
+
+void PartialHydration::startNext()
+{
+    while (!_requests.isEmpty()) {
+        const auto request = _requests.head().range;
+        const auto priority = _requests.head().priority;
+        const auto gaps = missing(_ranges, aligned(request, _size));
+        if (gaps.isEmpty()) {
+            _requests.dequeue();
+            Q_EMIT finished(request.start, request.size(), {});
+            continue;
+        }
+
+        const ByteRange gap = {gaps.first().start, std::min(gaps.first().end, gaps.first().start + MaximumRequestSize)};
+        _device = std::make_unique<QFile>(_localPath);
+        if (!_device->open(QIODevice::ReadWrite | QIODevice::Unbuffered) || (_device->size() < _size && !_device->resize(_size))
+            || !_device->seek(gap.start)) {
+            const QString error = _device->errorString();
+            qCWarning(lcPartialHydration) << "Could not open" << _localPath << error;
+            _device.reset();
+            _requests.dequeue();
+            Q_EMIT finished(request.start, request.size(), error);
+            continue;
+        }
+
+        qCInfo(lcPartialHydration) << "Hydrating" << gap.start << "-" << gap.end << "of" << _remotePath;
+        _downloading = gap;
+        _job = new GETFileJob(_account, _baseUrl, _remotePath, _device.get(), {}, QString::fromUtf8(_etag), gap.start, this);
+        _job->setRangeEnd(gap.end - 1);
+        _job->setExpectedContentLength(gap.size());
+        if (priority == Priority::Foreground) {
+            _job->setPriority(QNetworkRequest::HighPriority);
+            _job->setRequestClass(JobQueue::RequestClass::Interactive);
+        }
+        connect(_job, &GETFileJob::finishedSignal, this, &PartialHydration::slotJobFinished);
+        _job->start();
+        return;
+    }
+}
+
+void PartialHydration::slotJobFinished()
+{
+    auto job = _job;
+    _job.clear();
+    job->deleteLater();
+
+    // what arrived is usable even if the request failed later on
+    const qint64 received = _device->pos();
+    _device.reset();
+    if (received > _downloading.start) {
+        _ranges = merged(_ranges, {_downloading.start, received});
+        _journal->setHydratedRanges(_relativePath, _etag, _ranges);
+    }
+
+    if (std::exchange(_preempted, false)) {
+        // the background request stays queued behind the foreground one
+        startNext();
+        return;
+    }
+
+    QString error;
+    if (job->reply()->error() != QNetworkReply::NoError) {
+        error = job->errorString();
+    } else if (received != _downloading.end) {
+        error = tr("The server did not send the requested range");
+    }
+    if (!error.isEmpty()) {
+        qCWarning(lcPartialHydration) << "Hydrating" << _downloading.start << "-" << _downloading.end << "of" << _remotePath << "failed:" << error;
+        const auto request = _requests.dequeue().range;
+        Q_EMIT finished(request.start, request.size(), error);
+    }
+    startNext();
+}
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include "accountfwd.h"
+#include "common/syncjournaldb.h"
+
+#include <QFile>
+#include <QPointer>
+#include <QQueue>
+#include <QUrl>
+
+#include <memory>
+
+namespace OCC {
+
+class GETFileJob;
+
+/**
+ * @brief Hydrates the parts of a virtual file that are read
+ * @ingroup libsync
+ *
+ * For vfs plugins with Vfs::supportsPartialHydration(). Instead of downloading
+ * the whole file when an application reads it, only the blocks of BlockSize
+ * that contain the requested bytes are downloaded with range requests and
+ * written to the local file at their offset.
+ *
+ * The present ranges are stored in the journal for the etag of the file, they
+ * are dropped when the file changes on the server. Requests are served one
+ * after the other, a request whose bytes are present already finishes
+ * right away.
+ *
+ * A Foreground request, an application waiting for the data, is served before
+ * the queued Background ones and interrupts a running background download. Its
+ * download is an interactive request that isn't queued behind the transfers of
+ * a sync run.
+ */
+class OWNCLOUDSYNC_EXPORT PartialHydration : public QObject
+{
+    Q_OBJECT
+public:
+    using ByteRange = SyncJournalDb::ByteRange;
+
+    static constexpr qint64 BlockSize = 4 * 1024 * 1024;
+    // larger reads are split into several requests
+    static constexpr qint64 MaximumRequestSize = 16 * BlockSize;
+
+    enum class Priority {
+        /// An application waits for the data
+        Foreground,
+        /// The data is fetched ahead of time, e.g. for a file that is pinned
+        Background
+    };
+    Q_ENUM(Priority)
+
+    /**
+     * \a baseUrl and \a remotePath locate the file on the server, \a localPath is
+     * the file the data is written to and \a relativePath the path in the journal.
+     */
+    PartialHydration(AccountPtr account, const QUrl &baseUrl, const QString &remotePath, const QString &localPath, SyncJournalDb *journal,
+        const QString &relativePath, const QByteArray &etag, qint64 size, QObject *parent = nullptr);
+    ~PartialHydration() override;
+
+    /** Requests the \a length bytes at \a offset, finished() is emitted once they are present */
+    void hydrate(qint64 offset, qint64 length, Priority priority = Priority::Foreground);
+
+    bool isHydrated(qint64 offset, qint64 length) const;
+
+    /** Whether the whole file is present */
+    bool isComplete() const;
+
+    const QVector<ByteRange> &ranges() const { return _ranges; }
+
+    /** \a ranges with \a range added, sorted and not overlapping */
+    static QVector<ByteRange> merged(const QVector<ByteRange> &ranges, ByteRange range);
+
+    /** The parts of \a range that are not in \a ranges */
+    static QVector<ByteRange> missing(const QVector<ByteRange> &ranges, ByteRange range);
+
+    /** \a range extended to whole blocks, limited to \a size */
+    static ByteRange aligned(ByteRange range, qint64 size);
+
+Q_SIGNALS:
+    /** The request for \a offset and \a length is done, \a error is empty on success */
+    void finished(qint64 offset, qint64 length, const QString &error);
+
+private:
+    struct Request
+    {
+        ByteRange range;
+        Priority priority;
+    };
+
+    void startNext();
+    void slotJobFinished();
+
+    AccountPtr _account;
+    QUrl _baseUrl;
+    QString _remotePath;
+    QString _localPath;
+    SyncJournalDb *_journal;
+    QByteArray _relativePath;
+    QByteArray _etag;
+    qint64 _size;
+
+    QVector<ByteRange> _ranges;
+    // the foreground requests before the background ones, each in the order they arrived
+    QQueue<Request> _requests;
+
+    QPointer<GETFileJob> _job;
+    // kept alive as long as the job might write to it
+    std::unique_ptr<QFile> _device;
+    ByteRange _downloading;
+    // the running download was aborted for a foreground request
+    bool _preempted = false;
+};
+}
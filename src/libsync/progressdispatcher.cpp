@@ -130,6 +130,7 @@ void ProgressInfo::reset()
     _sizeProgress = Progress();
     _fileProgress = Progress();
     _totalSizeOfCompletedJobs = 0;
+    _completedSizeOfRunningJobs = 0;
 
     // Historically, these starting estimates were way lower, but that lead
     // to gross overestimation of ETA when a good estimate wasn't available.
@@ -138,6 +139,7 @@ void ProgressInfo::reset()
 
     _updateEstimatesTimer.stop();
     _lastCompletedItem = SyncFileItem();
+    _generation.fetch_add(1, std::memory_order_release);
 }
 
 ProgressInfo::Status ProgressInfo::status() const
@@ -177,6 +179,7 @@ void ProgressInfo::adjustTotalsForFile(const SyncFileItem &item)
     if (isSizeDependent(item)) {
         _sizeProgress._total += item._size;
     }
+    _generation.fetch_add(1, std::memory_order_release);
 }
 
 void ProgressInfo::updateTotalsForFile(const SyncFileItem &item, qint64 newSize)
@@ -193,6 +196,7 @@ void ProgressInfo::updateTotalsForFile(const SyncFileItem &item, qint64 newSize)
 
     setProgressItem(item, 0);
     _currentItems[item._file]._progress._total = newSize;
+    _generation.fetch_add(1, std::memory_order_release);
 }
 
 qint64 ProgressInfo::totalFiles() const
@@ -227,12 +231,19 @@ void ProgressInfo::setProgressComplete(const SyncFileItem &item)
     }
 
     _fileProgress.setCompleted(_fileProgress._completed + item._affectedItems);
-    if (ProgressInfo::isSizeDependent(item)) {
-        _totalSizeOfCompletedJobs += _currentItems[item._file]._progress._total;
+    const auto it = _currentItems.constFind(item._file);
+    if (it != _currentItems.cend()) {
+        if (ProgressInfo::isSizeDependent(item)) {
+            _totalSizeOfCompletedJobs += it->_progress._total;
+        }
+        if (ProgressInfo::isSizeDependent(it->_item)) {
+            _completedSizeOfRunningJobs -= it->_progress._completed;
+        }
+        _currentItems.erase(it);
     }
-    _currentItems.remove(item._file);
     recomputeCompletedSize();
     _lastCompletedItem = item;
+    _generation.fetch_add(1, std::memory_order_release);
 }
 
 void ProgressInfo::setProgressItem(const SyncFileItem &item, qint64 completed)
@@ -241,15 +252,22 @@ void ProgressInfo::setProgressItem(const SyncFileItem &item, qint64 completed)
         return;
     }
 
-    if (!_currentItems.contains(item._file)) {
-        _currentItems[item._file]._item = item;
-        _currentItems[item._file]._progress._total = item._size;
+    auto it = _currentItems.find(item._file);
+    if (it == _currentItems.end()) {
+        it = _currentItems.insert(item._file, {});
+        it->_item = item;
+        it->_progress._total = item._size;
+    }
+    const qint64 previouslyCompleted = it->_progress._completed;
+    it->_progress.setCompleted(completed);
+    if (isSizeDependent(it->_item)) {
+        _completedSizeOfRunningJobs += it->_progress._completed - previouslyCompleted;
     }
-    _currentItems[item._file]._progress.setCompleted(completed);
     recomputeCompletedSize();
 
     // This seems dubious!
     _lastCompletedItem = SyncFileItem();
+    _generation.fetch_add(1, std::memory_order_release);
 }
 
 ProgressInfo::Estimates ProgressInfo::totalProgress() const
@@ -348,16 +366,12 @@ void ProgressInfo::updateEstimates()
         _maxFilesPerSecond);
     _maxBytesPerSecond = qMax(_sizeProgress._progressPerSec,
         _maxBytesPerSecond);
+    _generation.fetch_add(1, std::memory_order_release);
 }
 
 void ProgressInfo::recomputeCompletedSize()
 {
-    qint64 r = _totalSizeOfCompletedJobs;
-    for (const auto &i : std::as_const(_currentItems)) {
-        if (isSizeDependent(i._item))
-            r += i._progress._completed;
-    }
-    _sizeProgress.setCompleted(r);
+    _sizeProgress.setCompleted(_totalSizeOfCompletedJobs + _completedSizeOfRunningJobs);
 }
 
 ProgressInfo::Estimates ProgressInfo::Progress::estimates() const
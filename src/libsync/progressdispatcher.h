@@ -25,6 +25,8 @@
 
 #include "syncfileitem.h"
 
+#include <atomic>
+
 namespace OCC {
 class Folder;
 /**
@@ -114,6 +116,15 @@ public:
     /** Number of a file that is currently in progress. */
     qint64 currentFile() const;
 
+    /**
+     * Counts the changes of the totals and of the progress of the items.
+     *
+     * The progress of the transfers changes every few kilobytes, listeners poll
+     * this counter to only look at the progress when it changed. It can be read
+     * from any thread without a lock.
+     */
+    quint64 generation() const { return _generation.load(std::memory_order_acquire); }
+
     /** Return true if the size needs to be taken in account in the total amount of time */
     static inline bool isSizeDependent(const SyncFileItem &item)
     {
@@ -235,8 +246,8 @@ private Q_SLOTS:
     void updateEstimates();
 
 private:
-    // Sets the completed size by summing finished jobs with the progress
-    // of active ones.
+    // Sets the completed size from the finished jobs and the progress
+    // of the active ones.
     void recomputeCompletedSize();
 
     // Triggers the update() slot every second once propagation started.
@@ -247,10 +258,16 @@ private:
 
     // All size from completed jobs only.
     qint64 _totalSizeOfCompletedJobs;
+    // The completed size of the size dependent items in _currentItems,
+    // kept up to date instead of summing the items for every update.
+    qint64 _completedSizeOfRunningJobs = 0;
 
     // The fastest observed rate of files per second in this sync.
     double _maxFilesPerSecond;
     double _maxBytesPerSecond;
+
+    // see generation()
+    std::atomic<quint64> _generation = 0;
 };
 
 namespace Progress {
@@ -306,9 +323,9 @@ Q_SIGNALS:
      */
     void progressInfo(Folder *folder, const ProgressInfo &progress);
     /**
-     * @brief: the item was completed by a job
+     * @brief: the items were completed by jobs, batched per event loop iteration
      */
-    void itemCompleted(Folder *folder, const SyncFileItemPtr &item);
+    void itemsCompleted(Folder *folder, const QVector<OCC::SyncFileItemPtr> &items);
 
     /**
      * @brief A new folder-wide sync error was seen.
@@ -13,6 +13,8 @@
  */
 
 #include "propagatedownload.h"
+#include "propagatedownloadarchive.h"
+#include "accessmanager.h"
 #include "account.h"
 #include "filesystem.h"
 #include "networkjobs.h"
@@ -32,8 +34,13 @@
 #include <QFileInfo>
 #include <QLoggingCategory>
 #include <QRandomGenerator>
+#include <QtMath>
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
 
 #ifdef Q_OS_UNIX
 #include <unistd.h>
@@ -103,9 +110,9 @@ namespace CernRecallFeature {
             QString targetPath = makeRecallFileName(recalledFile);
 
             qCDebug(lcPropagateDownload) << "Copy recall file: " << recalledFile << " -> " << targetPath;
-            // Remove the target first, QFile::copy will not overwrite it.
+            // Remove the target first, the copy will not overwrite it.
             FileSystem::remove(targetPath);
-            QFile::copy(recalledFile, targetPath);
+            FileSystem::copyFile(recalledFile, targetPath);
         }
     }
 
@@ -113,6 +120,18 @@ namespace CernRecallFeature {
 }
 
 namespace {
+    // downloads of at least this size get their disk space reserved before they start
+    constexpr qint64 PreallocationThreshold = 4 * 1024 * 1024;
+
+    // downloads of at least this size are split into parallel range requests,
+    // SyncOptions::_downloadSegments limits their number
+    constexpr qint64 SegmentedDownloadThreshold = 64 * 1024 * 1024;
+    constexpr qint64 MinimumSegmentSize = 16 * 1024 * 1024;
+
+    // local files of at least this size are reused when the remote file grew,
+    // only the appended data is downloaded, see SyncOptions::_appendedDownloads
+    constexpr qint64 AppendedDownloadThreshold = 1024 * 1024;
+
     void preserveGroupOwnership(const QString &fileName, const QFileInfo &fi)
     {
 #ifdef Q_OS_UNIX
@@ -173,11 +192,16 @@ GETFileJob::GETFileJob(AccountPtr account, const QUrl &url, const QString &path,
 
     // Long downloads must not block non-propagation jobs.
     setPriority(QNetworkRequest::LowPriority);
+    setRequestClass(JobQueue::RequestClass::Transfer);
 }
 
 void GETFileJob::start()
 {
-    if (_resumeStart > 0) {
+    if (_rangeEnd >= 0) {
+        _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-' + QByteArray::number(_rangeEnd);
+        _headers["Accept-Ranges"] = "bytes";
+        qCDebug(lcGetJob) << "Download range" << _headers["Range"];
+    } else if (_resumeStart > 0) {
         _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-';
         _headers["Accept-Ranges"] = "bytes";
         qCDebug(lcGetJob) << "Retry with range " << _headers["Range"];
@@ -187,6 +211,8 @@ void GETFileJob::start()
     for (auto it = _headers.cbegin(); it != _headers.cend(); ++it) {
         req.setRawHeader(it.key(), it.value());
     }
+    // a download that doesn't belong to a sync run shouldn't wait for the frames of the transfers
+    req.setAttribute(AccessManager::TransferAttribute, requestClass() == JobQueue::RequestClass::Transfer);
 
     sendRequest("GET", req);
 
@@ -209,20 +235,62 @@ void GETFileJob::finished()
     }
 }
 
+qint64 GETFileJob::readBufferSize() const
+{
+    // keep low so we can easier limit the bandwidth
+    return _bandwidthLimited ? LimitedReadBufferSize : MaximumReadBufferSize;
+}
+
+qint64 GETFileJob::replyBufferSize() const
+{
+    return _bandwidthLimited ? LimitedReadBufferSize : MaximumReplyBufferSize;
+}
+
 void GETFileJob::newReplyHook(QNetworkReply *reply)
 {
-    reply->setReadBufferSize(16 * 1024); // keep low so we can easier limit the bandwidth
+    reply->setReadBufferSize(replyBufferSize());
 
     connect(reply, &QNetworkReply::metaDataChanged, this, &GETFileJob::slotMetaDataChanged);
     connect(reply, &QNetworkReply::finished, this, &GETFileJob::slotReadyRead);
-    connect(reply, &QNetworkReply::downloadProgress, this, &GETFileJob::downloadProgress);
+    connect(reply, &QNetworkReply::downloadProgress, this, [this](qint64 received, qint64 total) {
+        Q_EMIT downloadProgress(_resumedSize + received, total < 0 ? total : _resumedSize + total);
+    });
+}
+
+bool GETFileJob::canResumeReply() const
+{
+    // the data of a sequential device can't be continued with a range request
+    return _httpOk && !_device->isSequential();
+}
+
+void GETFileJob::prepareRetry(QNetworkRequest &request)
+{
+    const qint64 received = std::exchange(_receivedSize, 0);
+    if (!std::exchange(_httpOk, false) || received == 0) {
+        return;
+    }
+
+    // the connection was lost while the data arrived, request the rest of the same version
+    _resumeStart += received;
+    _resumedSize += received;
+    if (_expectedContentLength != -1) {
+        _expectedContentLength -= received;
+    }
+    if (_expectedEtagForResume.isEmpty()) {
+        _expectedEtagForResume = _etag;
+    }
+    _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-' + (_rangeEnd >= 0 ? QByteArray::number(_rangeEnd) : QByteArray());
+    _headers["Accept-Ranges"] = "bytes";
+    request.setRawHeader("Range", _headers["Range"]);
+    request.setRawHeader("Accept-Ranges", "bytes");
+    qCInfo(lcGetJob) << "Resuming" << this << "with range" << _headers["Range"];
 }
 
 void GETFileJob::slotMetaDataChanged()
 {
     // For some reason setting the read buffer in GETFileJob::start doesn't seem to go
     // through the HTTP layer thread(?)
-    reply()->setReadBufferSize(16 * 1024);
+    reply()->setReadBufferSize(replyBufferSize());
 
     int httpStatus = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
@@ -247,6 +315,14 @@ void GETFileJob::slotMetaDataChanged()
     if (reply()->error() != QNetworkReply::NoError) {
         return;
     }
+    if (_rangeEnd >= 0 && httpStatus != 206) {
+        // the full file would overwrite the ranges of the other requests
+        qCWarning(lcGetJob) << "Server did not reply with the requested range" << httpStatus;
+        _errorString = tr("Server returned wrong content-range");
+        _errorStatus = SyncFileItem::NormalError;
+        abort();
+        return;
+    }
     _etag = getEtagFromReply(reply());
 
     if (_etag.isEmpty()) {
@@ -296,6 +372,7 @@ void GETFileJob::slotMetaDataChanged()
                 return;
             }
             _resumeStart = 0;
+            _resumedSize = 0;
         } else {
             _errorString = tr("Server returned wrong content-range");
             _errorStatus = SyncFileItem::NormalError;
@@ -308,10 +385,39 @@ void GETFileJob::slotMetaDataChanged()
     if (!lastModified.isNull()) {
         _lastModified = Utility::qDateTimeToTime_t(lastModified.toDateTime());
     }
+
+    // Compute the checksum while receiving the data, a resumed download
+    // is validated by reading the complete file afterwards
+    _checksumCalculator.reset();
+    if (_resumeStart == 0 && _rangeEnd < 0) {
+        const auto expectedChecksum = ChecksumHeader::parseChecksumHeader(expectedChecksumHeader());
+        if (expectedChecksum.isValid()) {
+            _checksumCalculator.emplace(expectedChecksum.type());
+        }
+    }
+
     _httpOk = true;
     connect(reply(), &QIODevice::readyRead, this, &GETFileJob::slotReadyRead);
 }
 
+QByteArray GETFileJob::expectedChecksumHeader() const
+{
+    auto checksumHeader = findBestChecksum(reply()->rawHeader(checkSumHeaderC));
+    const auto contentMd5Header = reply()->rawHeader(contentMd5HeaderC);
+    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty()) {
+        checksumHeader = "MD5:" + contentMd5Header;
+    }
+    return checksumHeader;
+}
+
+QByteArray GETFileJob::computedChecksum() const
+{
+    if (_checksumCalculator) {
+        return _checksumCalculator->result();
+    }
+    return {};
+}
+
 void GETFileJob::setBandwidthManager(BandwidthManager *bwm)
 {
     _bandwidthManager = bwm;
@@ -329,6 +435,9 @@ void GETFileJob::setBandwidthLimited(bool b)
 {
     if (_bandwidthLimited != b) {
         _bandwidthLimited = b;
+        if (_httpOk && reply()) {
+            reply()->setReadBufferSize(replyBufferSize());
+        }
         QMetaObject::invokeMethod(this, &GETFileJob::slotReadyRead, Qt::QueuedConnection);
     }
 }
@@ -340,6 +449,17 @@ void GETFileJob::giveBandwidthQuota(qint64 q)
     QMetaObject::invokeMethod(this, &GETFileJob::slotReadyRead, Qt::QueuedConnection);
 }
 
+qint64 GETFileJob::bandwidthDemand() const
+{
+    if (!_httpOk) {
+        return 0;
+    }
+    if (_contentLength < 0) {
+        return std::numeric_limits<qint64>::max();
+    }
+    return std::max<qint64>(0, _contentLength - _receivedSize - _bandwidthQuota);
+}
+
 qint64 GETFileJob::currentDownloadPosition()
 {
     if (_device && _device->pos() > 0 && _device->pos() > qint64(_resumeStart)) {
@@ -355,8 +475,15 @@ void GETFileJob::slotReadyRead()
         return;
     }
 
-    const qint64 bufferSize = std::min<qint64>(1024 * 8, reply()->bytesAvailable());
-    QByteArray buffer(bufferSize, Qt::Uninitialized);
+    // All downloads of a thread share one buffer, it grows with the amount of
+    // data the reply buffers and is reused for all following reads
+    static thread_local QByteArray buffer;
+    addBufferedBytes(reply()->bytesAvailable());
+    const qint64 wanted = std::min<qint64>(readBufferSize(), reply()->bytesAvailable());
+    if (buffer.size() < wanted) {
+        buffer.resize(std::min<qint64>(MaximumReadBufferSize, qNextPowerOfTwo(quint64(wanted))));
+    }
+    const qint64 bufferSize = buffer.size();
 
     while (reply()->bytesAvailable() > 0) {
         if (_bandwidthChoked) {
@@ -367,7 +494,7 @@ void GETFileJob::slotReadyRead()
         if (_bandwidthLimited) {
             toRead = std::min<qint64>(bufferSize, _bandwidthQuota);
             if (toRead == 0) {
-                qCWarning(lcGetJob) << "Out of badnwidth quota";
+                qCDebug(lcGetJob) << "Out of bandwidth quota";
                 break;
             }
             _bandwidthQuota -= toRead;
@@ -381,6 +508,7 @@ void GETFileJob::slotReadyRead()
             abort();
             return;
         }
+        _receivedSize += read;
 
         const qint64 written = _device->write(buffer.constData(), read);
         if (written != read) {
@@ -390,6 +518,9 @@ void GETFileJob::slotReadyRead()
             abort();
             return;
         }
+        if (_checksumCalculator) {
+            _checksumCalculator->addData(QByteArrayView(buffer.constData(), read));
+        }
     }
 }
 
@@ -478,9 +609,35 @@ void PropagateDownloadFile::start()
     // If we have a conflict where size of the file is unchanged,
     // compare the remote checksum to the local one.
     // Maybe it's not a real conflict and no download is necessary!
+    if (mayResolveConflictByChecksum(*_item)) {
+        const auto checksumHeader = ChecksumHeader::parseChecksumHeader(_item->_checksumHeader);
+        propagator()->_activeJobList.append(this);
+        const auto cachedChecksum =
+            propagator()->_journal->cachedChecksum(_item->_inode, _item->_previousModtime, _item->_previousSize, checksumHeader.type());
+        if (!cachedChecksum.isEmpty()) {
+            qCDebug(lcPropagateDownload) << _item->_file << "may not need download, using the cached checksum";
+            conflictChecksumComputed(checksumHeader.type(), cachedChecksum);
+            return;
+        }
+        qCDebug(lcPropagateDownload) << _item->_file << "may not need download, computing checksum";
+        beginStep("checksum");
+        auto computeChecksum = new ComputeChecksum(this);
+        computeChecksum->setChecksumType(checksumHeader.type());
+        connect(computeChecksum, &ComputeChecksum::done, this, [this](CheckSums::Algorithm checksumType, const QByteArray &checksum) {
+            propagator()->_journal->setCachedChecksum(_item->_inode, _item->_previousModtime, _item->_previousSize, checksumType, checksum);
+            conflictChecksumComputed(checksumType, checksum);
+        });
+        computeChecksum->start(propagator()->fullLocalPath(_item->_file));
+        return;
+    }
+
+    startDownload();
+}
+
+bool PropagateDownloadFile::mayResolveConflictByChecksum(const SyncFileItem &item)
+{
     // If the hashes are collision safe and identical, we assume the content is too.
     // For weak checksums, we only do that if the mtimes are also identical.
-
     const auto csync_is_collision_safe_hash = [](const QByteArray &checksum_header) {
         const bool safe = std::any_of(CheckSums::SafeAlgorithms.begin(), CheckSums::SafeAlgorithms.end(), [checksum_header = checksum_header.toUpper()](auto &it) {
             return checksum_header.startsWith(it.second.data());
@@ -492,24 +649,13 @@ void PropagateDownloadFile::start()
         return true;
     };
 
-    if (_item->instruction() == CSYNC_INSTRUCTION_CONFLICT && _item->_size == _item->_previousSize && !_item->_checksumHeader.isEmpty()
-        && (csync_is_collision_safe_hash(_item->_checksumHeader) || _item->_modtime == _item->_previousModtime)) {
-        qCDebug(lcPropagateDownload) << _item->_file << "may not need download, computing checksum";
-        auto computeChecksum = new ComputeChecksum(this);
-        const auto checksumHeader = ChecksumHeader::parseChecksumHeader(_item->_checksumHeader);
-        computeChecksum->setChecksumType(checksumHeader.type());
-        connect(computeChecksum, &ComputeChecksum::done,
-            this, &PropagateDownloadFile::conflictChecksumComputed);
-        propagator()->_activeJobList.append(this);
-        computeChecksum->start(propagator()->fullLocalPath(_item->_file));
-        return;
-    }
-
-    startDownload();
+    return item.instruction() == CSYNC_INSTRUCTION_CONFLICT && !item._conflictChecksumCompared && item._size == item._previousSize && !item._checksumHeader.isEmpty()
+        && (csync_is_collision_safe_hash(item._checksumHeader) || item._modtime == item._previousModtime);
 }
 
 void PropagateDownloadFile::conflictChecksumComputed(CheckSums::Algorithm checksumType, const QByteArray &checksum)
 {
+    endStep("checksum");
     propagator()->_activeJobList.removeOne(this);
     const auto checksumHeader = ChecksumHeader::parseChecksumHeader(_item->_checksumHeader);
     if (checksumHeader == ChecksumHeader(checksumType, checksum)) {
@@ -564,6 +710,10 @@ void PropagateDownloadFile::startDownload()
 
     if (tmpFileName.isEmpty()) {
         tmpFileName = createDownloadTmpFileName(_item->_file);
+        if (canReuseLocalFile()) {
+            seedFromLocalFile(tmpFileName);
+            return;
+        }
     }
     _tmpFile.setFileName(propagator()->fullLocalPath(tmpFileName));
 
@@ -618,11 +768,77 @@ void PropagateDownloadFile::startDownload()
         propagator()->_journal->commit(QStringLiteral("download file start"));
     }
 
+    // Reserve the space for large files upfront, growing them by appends
+    // fragments them badly on some file systems
+    if (_item->_size - _resumeStart >= PreallocationThreshold) {
+        FileSystem::preallocate(_tmpFile, _item->_size);
+    }
+
     startFullDownload();
 }
 
+bool PropagateDownloadFile::canReuseLocalFile() const
+{
+    // without a checksum of the new version the reused data can't be verified
+    if (!propagator()->syncOptions()._appendedDownloads || _triedLocalFile || _item->instruction() != CSYNC_INSTRUCTION_SYNC || _item->_type != ItemTypeFile || !_item->_directDownloadUrl.isEmpty()
+        || !ChecksumHeader::parseChecksumHeader(_item->_checksumHeader).isValid() || _item->_previousSize < AppendedDownloadThreshold
+        || _item->_size <= _item->_previousSize) {
+        return false;
+    }
+    return !FileSystem::fileChanged(QFileInfo{propagator()->fullLocalPath(_item->_file)}, _item->_previousSize, _item->_previousModtime);
+}
+
+void PropagateDownloadFile::seedFromLocalFile(const QString &tmpFileName)
+{
+    _triedLocalFile = true;
+    qCInfo(lcPropagateDownload) << "Downloading only the data appended to" << _item->_file << "since" << _item->_previousSize << "bytes";
+    propagator()->_activeJobList.append(this);
+    propagator()
+        ->runLocalIo([localFile = propagator()->fullLocalPath(_item->_file), tmpFile = propagator()->fullLocalPath(tmpFileName)] {
+            if (FileSystem::copyFile(localFile, tmpFile)) {
+                return true;
+            }
+            FileSystem::remove(tmpFile);
+            return false;
+        })
+        .then(this, [this, tmpFileName](bool copied) {
+            propagator()->_activeJobList.removeOne(this);
+            if (propagator()->_abortRequested) {
+                FileSystem::remove(propagator()->fullLocalPath(tmpFileName));
+                done(SyncFileItem::NormalError, tr("Operation was canceled"));
+                return;
+            }
+            if (copied) {
+                // startDownload() resumes the download behind the copied data
+                SyncJournalDb::DownloadInfo downloadInfo;
+                downloadInfo._etag = _item->_etag.toUtf8();
+                downloadInfo._tmpfile = tmpFileName;
+                downloadInfo._valid = true;
+                propagator()->_journal->setDownloadInfo(_item->_file, downloadInfo);
+                _reusedLocalFile = true;
+            } else {
+                qCWarning(lcPropagateDownload) << "Could not copy" << _item->_file << "to" << tmpFileName << ", downloading all of it";
+            }
+            startDownload();
+        });
+}
+
 void PropagateDownloadFile::startFullDownload()
 {
+    if (_archive) {
+        if (_resumeStart == 0) {
+            _archive->memberReady(this);
+            return;
+        }
+        // the archive can't continue a partial download
+        _archive->removeMember(this);
+        _archive.clear();
+    }
+
+    if (startSegmentedDownload()) {
+        return;
+    }
+
     QMap<QByteArray, QByteArray> headers;
 
     if (_item->_directDownloadUrl.isEmpty()) {
@@ -654,6 +870,171 @@ void PropagateDownloadFile::startFullDownload()
     _job->start();
 }
 
+bool PropagateDownloadFile::startSegmentedDownload()
+{
+    const int maximumSegments = propagator()->syncOptions()._downloadSegments;
+    const qint64 remaining = _item->_size - _resumeStart;
+    if (maximumSegments < 2 || _segmentsUnsupported || !_item->_directDownloadUrl.isEmpty() || remaining < SegmentedDownloadThreshold) {
+        return false;
+    }
+
+    const int count = static_cast<int>(std::min<qint64>(maximumSegments, remaining / MinimumSegmentSize));
+    const qint64 segmentSize = remaining / count;
+    _segments.clear();
+    _segments.resize(count);
+    for (int i = 0; i < count; ++i) {
+        auto &segment = _segments[i];
+        segment.start = _resumeStart + i * segmentSize;
+        segment.end = i == count - 1 ? _item->_size - 1 : segment.start + segmentSize - 1;
+        segment.device = std::make_unique<QFile>(_tmpFile.fileName());
+        if (!segment.device->open(QIODevice::ReadWrite | QIODevice::Unbuffered) || !segment.device->seek(segment.start)) {
+            qCWarning(lcPropagateDownload) << "Could not open" << _tmpFile.fileName() << "for a segmented download" << segment.device->errorString();
+            _segments.clear();
+            return false;
+        }
+    }
+
+    // Until the download finishes the temporary file has gaps, it must not be
+    // resumed based on its size after a crash: without the etag the file gets
+    // removed. On errors slotSegmentFinished() records the gap free part again.
+    auto downloadInfo = propagator()->_journal->getDownloadInfo(_item->_file);
+    downloadInfo._etag.clear();
+    propagator()->_journal->setDownloadInfo(_item->_file, downloadInfo);
+    propagator()->_journal->commit(QStringLiteral("segmented download start"));
+
+    qCInfo(lcPropagateDownload) << "Downloading" << _item->_file << "with" << count << "range requests";
+    for (auto &segment : _segments) {
+        // all ranges must belong to the same version of the file
+        auto job = new GETFileJob(propagator()->account(), propagator()->webDavUrl(), propagator()->fullRemotePath(_item->_file), segment.device.get(),
+            {}, _item->_etag, segment.start, this);
+        job->setRangeEnd(segment.end);
+        job->setExpectedContentLength(segment.end - segment.start + 1);
+        job->setBandwidthManager(propagator()->_bandwidthManager);
+        connect(job, &GETFileJob::finishedSignal, this, &PropagateDownloadFile::slotSegmentFinished);
+        connect(job, &GETFileJob::downloadProgress, this, [this, job](qint64 received, qint64) {
+            for (auto &segment : _segments) {
+                if (segment.job == job) {
+                    segment.received = received;
+                }
+            }
+            _downloadProgress = std::accumulate(_segments.cbegin(), _segments.cend(), qint64(0), [](qint64 sum, const Segment &segment) {
+                return sum + segment.received;
+            });
+            propagator()->reportProgress(*_item, _resumeStart + _downloadProgress);
+        });
+        segment.job = job;
+    }
+    propagator()->_activeJobList.append(this);
+    for (const auto &segment : _segments) {
+        segment.job->start();
+    }
+    return true;
+}
+
+qint64 PropagateDownloadFile::contiguousDownloadedSize() const
+{
+    qint64 size = _resumeStart;
+    for (const auto &segment : _segments) {
+        size = segment.device->pos();
+        if (size <= segment.end) {
+            break;
+        }
+    }
+    return size;
+}
+
+void PropagateDownloadFile::abortSegments()
+{
+    for (auto &segment : _segments) {
+        if (segment.job) {
+            disconnect(segment.job, nullptr, this, nullptr);
+            if (!segment.finished) {
+                segment.job->abort();
+            }
+        }
+        segment.device->close();
+    }
+}
+
+void PropagateDownloadFile::slotSegmentFinished()
+{
+    auto job = qobject_cast<GETFileJob *>(sender());
+    OC_ASSERT(job);
+    auto segment = std::find_if(_segments.begin(), _segments.end(), [job](const Segment &segment) { return segment.job == job; });
+    OC_ASSERT(segment != _segments.end());
+    segment->finished = true;
+
+    const int httpStatus = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (job->reply()->error() != QNetworkReply::NoError) {
+        // keep what was downloaded without gaps, the rest is requested again
+        const qint64 contiguousSize = contiguousDownloadedSize();
+        abortSegments();
+        _tmpFile.close();
+        if (!_tmpFile.resize(contiguousSize)) {
+            qCWarning(lcPropagateDownload) << "Could not truncate" << _tmpFile.fileName() << _tmpFile.errorString();
+            FileSystem::remove(_tmpFile.fileName());
+            propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+        } else {
+            auto downloadInfo = propagator()->_journal->getDownloadInfo(_item->_file);
+            downloadInfo._etag = _item->_etag.toUtf8();
+            propagator()->_journal->setDownloadInfo(_item->_file, downloadInfo);
+        }
+
+        if (httpStatus == 200 && !propagator()->_abortRequested) {
+            qCInfo(lcPropagateDownload) << "Server does not support range requests, downloading" << _item->_file << "with a single request";
+            propagator()->_activeJobList.removeOne(this);
+            _segmentsUnsupported = true;
+            _resumeStart = _tmpFile.size();
+            _downloadProgress = 0;
+            _expectedEtagForResume = _item->_etag;
+            if (!_tmpFile.open(QIODevice::Append | QIODevice::Unbuffered)) {
+                done(SyncFileItem::NormalError, _tmpFile.errorString());
+                return;
+            }
+            startFullDownload();
+            return;
+        }
+
+        // handle the error like the one of a single request
+        _downloadProgress = 0;
+        _job = job;
+        slotGetFinished();
+        return;
+    }
+
+    propagator()->reportTransferSample(job, segment->received);
+    propagator()->recordRequest(_item->_file, job, segment->received);
+    if (!std::all_of(_segments.cbegin(), _segments.cend(), [](const Segment &segment) { return segment.finished; })) {
+        return;
+    }
+
+    propagator()->_activeJobList.removeOne(this);
+    for (auto &segment : _segments) {
+        segment.device->close();
+    }
+    _tmpFile.close();
+
+    const auto firstJob = _segments.front().job;
+    _item->_httpErrorCode = httpStatus;
+    _item->_responseTimeStamp = firstJob->responseTimestamp();
+    _item->_requestId = firstJob->requestId();
+    if (!firstJob->etag().isEmpty()) {
+        _item->_etag = firstJob->etag();
+    }
+    if (firstJob->lastModified()) {
+        _item->_modtime = firstJob->lastModified();
+    }
+
+    if (_tmpFile.size() != _item->_size) {
+        qCDebug(lcPropagateDownload) << _tmpFile.size() << "!=" << _item->_size;
+        propagator()->_anotherSyncNeeded = true;
+        done(SyncFileItem::SoftError, tr("The file could not be downloaded completely."));
+        return;
+    }
+
+    validateDownload(firstJob);
+}
+
 qint64 PropagateDownloadFile::committedDiskSpace() const
 {
     if (state() == Running) {
@@ -679,6 +1060,9 @@ void PropagateDownloadFile::slotGetFinished()
     _item->_responseTimeStamp = job->responseTimestamp();
     _item->_requestId = job->requestId();
 
+    propagator()->reportTransferSample(job, _downloadProgress);
+    propagator()->recordRequest(_item->_file, job, _downloadProgress);
+
     QNetworkReply::NetworkError err = job->reply()->error();
     if (err != QNetworkReply::NoError) {
 
@@ -772,8 +1156,10 @@ void PropagateDownloadFile::slotGetFinished()
     // Qt removes the content-length header for transparently decompressed HTTP1 replies
     // but not for HTTP2 or SPDY replies. For these it remains and contains the size
     // of the compressed data. See QTBUG-73364.
-    const auto contentEncoding = job->reply()->rawHeader("content-encoding").toLower();
-    if ((job->reply()->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool()) && (contentEncoding == "gzip" || contentEncoding == "deflate")) {
+    // Depending on how Qt was built it also negotiates br and zstd, so any encoding
+    // other than identity means the size can't be compared.
+    const auto contentEncoding = job->reply()->rawHeader("content-encoding").trimmed().toLower();
+    if ((job->reply()->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool()) && !contentEncoding.isEmpty() && contentEncoding != "identity") {
         bodySize = 0;
         hasSizeHeader = false;
     }
@@ -802,6 +1188,11 @@ void PropagateDownloadFile::slotGetFinished()
         return;
     }
 
+    validateDownload(job);
+}
+
+void PropagateDownloadFile::validateDownload(GETFileJob *job)
+{
     // Did the file come with conflict headers? If so, store them now!
     // If we download conflict files but the server doesn't send conflict
     // headers, the record will be established by SyncEngine::conflictRecordMaintenance.
@@ -826,21 +1217,121 @@ void PropagateDownloadFile::slotGetFinished()
     // Do checksum validation for the download. If there is no checksum header, the validator
     // will also Q_EMIT the validated() signal to continue the flow in slot transmissionChecksumValidated()
     // as this is (still) also correct.
+    beginStep("checksum");
     ValidateChecksumHeader *validator = new ValidateChecksumHeader(this);
     connect(validator, &ValidateChecksumHeader::validated,
         this, &PropagateDownloadFile::transmissionChecksumValidated);
     connect(validator, &ValidateChecksumHeader::validationFailed,
         this, &PropagateDownloadFile::slotChecksumFail);
-    auto checksumHeader = findBestChecksum(job->reply()->rawHeader(checkSumHeaderC));
-    auto contentMd5Header = job->reply()->rawHeader(contentMd5HeaderC);
-    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
-        checksumHeader = "MD5:" + contentMd5Header;
-    validator->start(_tmpFile.fileName(), checksumHeader);
+    const auto checksum = job->computedChecksum();
+    if (!checksum.isEmpty()) {
+        validator->validate(job->expectedChecksumHeader(), checksum);
+    } else if (_reusedLocalFile && job->expectedChecksumHeader().isEmpty()) {
+        // the data taken from the local file must be part of the new version as well
+        validator->start(_tmpFile.fileName(), _item->_checksumHeader);
+    } else {
+        validator->start(_tmpFile.fileName(), job->expectedChecksumHeader());
+    }
+}
+
+void PropagateDownloadFile::setArchive(DownloadArchive *archive)
+{
+    _archive = archive;
+    _archive->addMember(this);
+    // leave the archive if we fail before it was sent
+    connect(this, &PropagatorJob::finished, this, [this] {
+        if (_archive) {
+            _archive->removeMember(this);
+        }
+    });
+}
+
+void PropagateDownloadFile::archiveEntryStarted()
+{
+    _archiveChecksum.reset();
+    const auto expectedChecksum = ChecksumHeader::parseChecksumHeader(_item->_checksumHeader);
+    if (expectedChecksum.isValid()) {
+        _archiveChecksum.emplace(expectedChecksum.type());
+    }
+}
+
+void PropagateDownloadFile::archiveData(QByteArrayView data)
+{
+    if (_tmpFile.write(data.constData(), data.size()) != data.size()) {
+        return;
+    }
+    if (_archiveChecksum) {
+        _archiveChecksum->addData(data);
+    }
+    _downloadProgress += data.size();
+    propagator()->reportProgress(*_item, _downloadProgress);
+}
+
+void PropagateDownloadFile::archiveEntryFinished()
+{
+    _archive.clear();
+    const bool writeFailed = _tmpFile.error() != QFileDevice::NoError;
+    const QString writeError = _tmpFile.errorString();
+    _tmpFile.close();
+
+    if (writeFailed || _tmpFile.size() != _item->_size) {
+        FileSystem::remove(_tmpFile.fileName());
+        propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+        if (writeFailed) {
+            done(SyncFileItem::NormalError, writeError);
+            return;
+        }
+        // the file changed on the server since the discovery
+        qCWarning(lcPropagateDownload) << "The archive delivered" << _tmpFile.size() << "bytes of" << _item->_file << "instead of" << _item->_size;
+        propagator()->_anotherSyncNeeded = true;
+        done(SyncFileItem::SoftError, tr("The file could not be downloaded completely."));
+        return;
+    }
+
+    // there is no reply with headers for this file, validate against the checksum of the discovery
+    beginStep("checksum");
+    ValidateChecksumHeader *validator = new ValidateChecksumHeader(this);
+    connect(validator, &ValidateChecksumHeader::validated, this, &PropagateDownloadFile::transmissionChecksumValidated);
+    connect(validator, &ValidateChecksumHeader::validationFailed, this, &PropagateDownloadFile::slotChecksumFail);
+    if (_archiveChecksum) {
+        validator->validate(_item->_checksumHeader, _archiveChecksum->result());
+    } else {
+        validator->start(_tmpFile.fileName(), _item->_checksumHeader);
+    }
+}
+
+void PropagateDownloadFile::downloadWithoutArchive()
+{
+    _archive.clear();
+    _archiveChecksum.reset();
+    if (propagator()->_abortRequested) {
+        return;
+    }
+    // drop what a broken archive delivered
+    if (_tmpFile.size() > 0 && !_tmpFile.resize(0)) {
+        done(SyncFileItem::NormalError, _tmpFile.errorString());
+        return;
+    }
+    _downloadProgress = 0;
+    propagator()->reportProgress(*_item, 0);
+    startFullDownload();
 }
 
 void PropagateDownloadFile::slotChecksumFail(const QString &errMsg)
 {
+    endStep("checksum");
     FileSystem::remove(_tmpFile.fileName());
+    if (_reusedLocalFile) {
+        // the file was not just appended to, download all of it
+        qCInfo(lcPropagateDownload) << "The local data of" << _item->_file << "is not part of the new version:" << errMsg;
+        propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+        _reusedLocalFile = false;
+        _resumeStart = 0;
+        _downloadProgress = 0;
+        _expectedEtagForResume.clear();
+        startDownload();
+        return;
+    }
     propagator()->_anotherSyncNeeded = true;
     done(SyncFileItem::SoftError, errMsg); // tr("The file downloaded with a broken checksum, will be redownloaded."));
 }
@@ -891,6 +1382,7 @@ void PropagateDownloadFile::transmissionChecksumValidated(CheckSums::Algorithm c
 
 void PropagateDownloadFile::contentChecksumComputed(CheckSums::Algorithm checksumType, const QByteArray &checksum)
 {
+    endStep("checksum");
     _item->_checksumHeader = ChecksumHeader(checksumType, checksum).makeChecksumHeader();
 
     downloadFinished();
@@ -964,21 +1456,40 @@ void PropagateDownloadFile::downloadFinished()
         return;
     }
 
-    QString error;
-    // The fileChanged() check is done above to generate better error messages.
-    if (!FileSystem::uncheckedRenameReplace(_tmpFile.fileName(), fn, &error)) {
-        qCWarning(lcPropagateDownload) << "Rename failed:" << _tmpFile.fileName() << "=>" << fn << "with error:" << error;
-        propagator()->_anotherSyncNeeded = true;
-        done(SyncFileItem::SoftError, error);
-        return;
-    }
-
-    FileSystem::setFileHidden(fn, false);
-
-    // Maybe we downloaded a newer version of the file than we thought we would...
-    // Get up to date information for the journal.
-    _item->_size = FileSystem::getSize(QFileInfo{fn});
+    struct RenameResult
+    {
+        bool renamed = false;
+        QString error;
+        qint64 size = 0;
+    };
+    runLocalIo(
+        [tmpFileName = _tmpFile.fileName(), fn] {
+            RenameResult result;
+            // The fileChanged() check is done above to generate better error messages.
+            result.renamed = FileSystem::uncheckedRenameReplace(tmpFileName, fn, &result.error);
+            if (result.renamed) {
+                FileSystem::setFileHidden(fn, false);
+                // Maybe we downloaded a newer version of the file than we thought we would...
+                // Get up to date information for the journal.
+                result.size = FileSystem::getSize(QFileInfo{fn});
+            }
+            return result;
+        },
+        [this, fn, isConflict](const RenameResult &result) {
+            if (!result.renamed) {
+                qCWarning(lcPropagateDownload) << "Rename failed:" << _tmpFile.fileName() << "=>" << fn << "with error:" << result.error;
+                propagator()->_anotherSyncNeeded = true;
+                done(SyncFileItem::SoftError, result.error);
+                return;
+            }
+            _item->_size = result.size;
+            slotRenamed(isConflict);
+        });
+}
 
+void PropagateDownloadFile::slotRenamed(bool isConflict)
+{
+    QString error;
     // Maybe what we downloaded was a conflict file? If so, set a conflict record.
     // (the data was prepared in slotGetFinished above)
     if (_conflictRecord.isValid())
@@ -1060,10 +1571,19 @@ void PropagateDownloadFile::slotDownloadProgress(qint64 received, qint64)
 
 void PropagateDownloadFile::abort(PropagatorJob::AbortType abortType)
 {
+    if (_archive) {
+        _archive->removeMember(this);
+        _archive.clear();
+    }
     if (_job) {
         _job->abort();
     }
-    if (abortType == AbortType::Asynchronous) {
+    for (const auto &segment : _segments) {
+        if (segment.job && !segment.finished) {
+            segment.job->abort();
+        }
+    }
+    if (abortType == AbortType::Asynchronous && !deferAbort(abortType)) {
         Q_EMIT abortFinished();
     }
 }
@@ -13,14 +13,19 @@
  */
 #pragma once
 
-#include "common/checksumalgorithms.h"
+#include "common/checksums.h"
 #include "networkjobs.h"
 #include "owncloudpropagator.h"
 
 #include <QBuffer>
 #include <QFile>
 
+#include <memory>
+#include <optional>
+#include <vector>
+
 namespace OCC {
+class DownloadArchive;
 
 /**
  * @brief Downloads the remote file via GET
@@ -35,6 +40,7 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public AbstractNetworkJob
     qint64 _expectedContentLength;
     qint64 _contentLength;
     qint64 _resumeStart;
+    qint64 _rangeEnd = -1;
 
 public:
     // DOES NOT take ownership of the device.
@@ -50,12 +56,22 @@ public:
     void finished() override;
 
     void newReplyHook(QNetworkReply *reply) override;
+    bool canResumeReply() const override;
+    void prepareRetry(QNetworkRequest &request) override;
 
     qint64 resumeStart()
     {
         return _resumeStart;
     }
 
+    /**
+     * Only request the data up to and including the byte at \a end
+     *
+     * The download starts at resumeStart(), it fails if the server
+     * does not reply with the requested range.
+     */
+    void setRangeEnd(qint64 end) { _rangeEnd = end; }
+
     qint64 contentLength() const { return _contentLength; }
     qint64 expectedContentLength() const { return _expectedContentLength; }
     void setExpectedContentLength(qint64 size) { _expectedContentLength = size; }
@@ -63,11 +79,30 @@ public:
     void setChoked(bool c);
     void setBandwidthLimited(bool b);
     void giveBandwidthQuota(qint64 q);
+    qint64 bandwidthQuota() const { return _bandwidthQuota; }
+    /// The amount of data that could still be read with more quota
+    qint64 bandwidthDemand() const;
     void setBandwidthManager(BandwidthManager *bwm);
 
     QString &etag() { return _etag; }
     time_t lastModified() { return _lastModified; }
 
+    /**
+     * The checksum header the download has to be validated against
+     *
+     * The best of the OC-Checksum header, falls back to Content-MD5.
+     */
+    QByteArray expectedChecksumHeader() const;
+
+    /**
+     * The checksum of the received data, of the type of expectedChecksumHeader()
+     *
+     * It is computed while the data arrives, so the downloaded file doesn't need
+     * to be read again. Empty if the download was resumed or the header
+     * could not be parsed.
+     */
+    QByteArray computedChecksum() const;
+
     void setErrorString(const QString &s) { _errorString = s; }
     QString errorString() const;
     SyncFileItem::Status errorStatus() { return _errorStatus; }
@@ -83,6 +118,17 @@ Q_SIGNALS:
 protected:
     bool restartDevice();
 
+    /// the most data read from the reply at once, limited while the bandwidth is limited
+    qint64 readBufferSize() const;
+    /**
+     * The data the network thread of Qt may receive ahead of us. It is a multiple of
+     * the read buffer, so the transfer continues while the main thread is busy.
+     */
+    qint64 replyBufferSize() const;
+    static constexpr qint64 LimitedReadBufferSize = 16 * 1024;
+    static constexpr qint64 MaximumReadBufferSize = 1024 * 1024;
+    static constexpr qint64 MaximumReplyBufferSize = 8 * MaximumReadBufferSize;
+
     QString _etag;
     time_t _lastModified = 0;
     QString _errorString;
@@ -90,8 +136,11 @@ protected:
     bool _bandwidthLimited = false; // if _bandwidthQuota will be used
     bool _bandwidthChoked = false; // if download is paused (won't read on readyRead())
     qint64 _bandwidthQuota = 0;
+    qint64 _receivedSize = 0; // the data read from the reply
+    qint64 _resumedSize = 0; // the data of the earlier replies, when a lost connection was resumed
     bool _httpOk = false;
     QPointer<BandwidthManager> _bandwidthManager = nullptr;
+    std::optional<ChecksumCalculator> _checksumCalculator;
 };
 
 /**
@@ -117,11 +166,16 @@ protected:
     |            v                           |                       |
     +-> startFullDownload()                  |                       |
               +                              |                       |
-              +-> run a GETFileJob           |                       | checksum identical?
+              +-> run a GETFileJob, or       |                       | checksum identical?
+              |   several for the ranges     |                       |
+              |   of a large file            |                       |
                                              |                       |
           done?+> slotGetFinished() <--------+                       |
+              or slotSegmentFinished()                               |
+                    for the last range                               |
                     +                                                |
-                    +-> validate checksum header                     |
+                    +-> validate checksum header (computed while     |
+                    |   downloading, or by reading the file)         |
                                                                      |
           done?+> transmissionChecksumValidated()                    |
                     +                                                |
@@ -167,6 +221,32 @@ public:
      */
     void setDeleteExistingFolder(bool enabled);
 
+    /**
+     * Whether a conflict might be resolved by comparing the local checksum
+     * with the remote one, without downloading the file.
+     *
+     * That's the case if the size is unchanged and the server provides a
+     * collision safe checksum, or a weak one and the mtime is unchanged,
+     * unless the checksums were already compared before the propagation.
+     */
+    static bool mayResolveConflictByChecksum(const SyncFileItem &item);
+
+    /**
+     * Download the file as a member of \a archive instead of with its own request
+     *
+     * Files that are resumed or that the archive does not deliver are downloaded on their own.
+     */
+    void setArchive(DownloadArchive *archive);
+
+    /// The archive starts to deliver the content of the file
+    void archiveEntryStarted();
+    /// The next part of the content delivered by the archive
+    void archiveData(QByteArrayView data);
+    /// The archive delivered all of the content, it is validated like a downloaded file
+    void archiveEntryFinished();
+    /// The archive does not deliver the file, download it with its own request
+    void downloadWithoutArchive();
+
 private Q_SLOTS:
     /// Called when ComputeChecksum on the local file finishes,
     /// maybe the local and remote checksums are identical?
@@ -181,6 +261,8 @@ private Q_SLOTS:
     /// Called when the download's checksum computation is done
     void contentChecksumComputed(CheckSums::Algorithm checksumType, const QByteArray &checksum);
     void downloadFinished();
+    /// The rest of downloadFinished() once the file is in place
+    void slotRenamed(bool isConflict);
     /// Called when it's time to update the db metadata
     void updateMetadata(bool isConflict);
 
@@ -188,9 +270,57 @@ private Q_SLOTS:
     void slotDownloadProgress(qint64, qint64);
     void slotChecksumFail(const QString &errMsg);
 
+    /// Called when a range request of a segmented download finishes
+    void slotSegmentFinished();
+
 private:
     void deleteExistingFolder();
 
+    /**
+     * Whether the remote file only grew while the local file is unchanged
+     *
+     * Then the download can start with a copy of the local file and request
+     * only the appended data.
+     */
+    bool canReuseLocalFile() const;
+    /// Copies the local file to \a tmpFileName off the main thread and continues with startDownload()
+    void seedFromLocalFile(const QString &tmpFileName);
+
+    /// Checks the headers and the checksum of the complete temporary file
+    void validateDownload(GETFileJob *job);
+
+    /**
+     * Splits large downloads into several parallel range requests
+     *
+     * Returns false if the download should use a single request.
+     */
+    bool startSegmentedDownload();
+    /// The size of the data from the start that was downloaded without gaps
+    qint64 contiguousDownloadedSize() const;
+    void abortSegments();
+
+    struct Segment
+    {
+        QPointer<GETFileJob> job;
+        // kept alive as long as the job might write to it
+        std::unique_ptr<QFile> device;
+        qint64 start = 0;
+        qint64 end = 0; // inclusive
+        qint64 received = 0;
+        bool finished = false;
+    };
+    std::vector<Segment> _segments;
+    // the server ignored the range requests of a segmented download
+    bool _segmentsUnsupported = false;
+    // the local file was tried as the start of the download
+    bool _triedLocalFile = false;
+    // the temporary file started as a copy of the local file
+    bool _reusedLocalFile = false;
+
+    QPointer<DownloadArchive> _archive;
+    // the checksum of the content delivered by the archive
+    std::optional<ChecksumCalculator> _archiveChecksum;
+
     qint64 _resumeStart;
     qint64 _downloadProgress;
     QPointer<GETFileJob> _job;
@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "propagatedownloadarchive.h"
+#include "accessmanager.h"
+#include "account.h"
+#include "networkjobs.h"
+#include "propagatedownload.h"
+
+#include <QNetworkReply>
+#include <QTimer>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Limits of a single archive request, far below the ones of the archiver so a
+// failed request doesn't cost much
+constexpr int MaximumArchiveFiles = 100;
+constexpr qint64 MaximumArchiveSize = 20 * 1024 * 1024;
+
+constexpr qsizetype TarBlockSize = 512;
+// pax headers and long names are small, anything larger is not a sane archive
+constexpr qint64 MaximumMetadataSize = 64 * 1024;
+
+QString parentPath(const QString &path)
+{
+    const auto slash = path.lastIndexOf(QLatin1Char('/'));
+    return slash == -1 ? QString() : path.left(slash);
+}
+
+QString fileName(const QString &path)
+{
+    return path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+}
+
+// A numeric field of a tar header, octal or base-256 for large values
+qint64 tarNumber(QByteArrayView field)
+{
+    qint64 value = 0;
+    if (uchar(field.front()) & 0x80) {
+        value = uchar(field.front()) & 0x7f;
+        for (const char c : field.sliced(1)) {
+            value = (value << 8) | uchar(c);
+        }
+        return value;
+    }
+    for (const char c : field) {
+        if (c >= '0' && c <= '7') {
+            value = value * 8 + (c - '0');
+        } else if (c != ' ' || value != 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+// A string field of a tar header, terminated by a 0 if it is shorter than the field
+QString tarString(QByteArrayView field)
+{
+    const auto end = field.indexOf('\0');
+    return QString::fromUtf8(end == -1 ? field : field.first(end));
+}
+
+bool isTarHeaderValid(QByteArrayView header)
+{
+    // the checksum is the sum of the bytes of the header with the checksum field taken as spaces
+    qint64 sum = 8 * ' ';
+    for (qsizetype i = 0; i < TarBlockSize; ++i) {
+        if (i < 148 || i >= 156) {
+            sum += uchar(header.at(i));
+        }
+    }
+    return sum == tarNumber(header.sliced(148, 8));
+}
+
+// The path of the records of a pax header, "<length> <key>=<value>\n" each
+QString paxPath(const QByteArray &records)
+{
+    QString path;
+    qsizetype pos = 0;
+    while (pos < records.size()) {
+        const auto space = records.indexOf(' ', pos);
+        const qsizetype length = space == -1 ? 0 : records.mid(pos, space - pos).toLongLong();
+        if (length <= space - pos + 1 || pos + length > records.size()) {
+            break;
+        }
+        const auto record = QByteArrayView(records).sliced(space + 1, pos + length - space - 2);
+        if (record.startsWith("path=")) {
+            path = QString::fromUtf8(record.sliced(5));
+        }
+        pos += length;
+    }
+    return path;
+}
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcPropagateDownloadArchive, "sync.propagator.download.archive", QtInfoMsg)
+
+DownloadArchive::DownloadArchive(OwncloudPropagator *propagator)
+    : QObject(propagator)
+    , _propagator(propagator)
+{
+}
+
+bool DownloadArchive::accepts(const SyncFileItem &item) const
+{
+    // the archiver names the entries by the file names, they are only unique within a directory
+    return !_sent && _members.size() < MaximumArchiveFiles && _size + item._size <= MaximumArchiveSize
+        && (_members.isEmpty() || parentPath(item._file) == _directory);
+}
+
+void DownloadArchive::addMember(PropagateDownloadFile *member)
+{
+    Q_ASSERT(!_sent);
+    if (_members.isEmpty()) {
+        _directory = parentPath(member->item()->_file);
+    }
+    _members.append(member);
+    _size += member->item()->_size;
+}
+
+void DownloadArchive::memberReady(PropagateDownloadFile *member)
+{
+    Q_ASSERT(_members.contains(member));
+    _readyMembers.insert(member);
+    maybeSend();
+}
+
+void DownloadArchive::takeMember(PropagateDownloadFile *member)
+{
+    if (!_members.removeOne(member)) {
+        return;
+    }
+    _readyMembers.remove(member);
+    _size -= member->item()->_size;
+    if (member == _entryMember) {
+        _entryMember = nullptr;
+    }
+
+    if (member == _activeJobSlot) {
+        // the member might get deleted while the request is still running
+        _propagator->_activeJobList.removeOne(member);
+        _activeJobSlot.clear();
+        if (!_members.isEmpty()) {
+            _activeJobSlot = _members.first();
+            _propagator->_activeJobList.append(_activeJobSlot);
+        }
+    }
+}
+
+void DownloadArchive::removeMember(PropagateDownloadFile *member)
+{
+    if (!_members.contains(member)) {
+        return;
+    }
+    takeMember(member);
+
+    if (_sent) {
+        if (_members.isEmpty() && _job) {
+            _job->abort();
+        }
+    } else {
+        maybeSend();
+    }
+}
+
+void DownloadArchive::maybeSend()
+{
+    if (_sent || _sendScheduled || _members.isEmpty() || _readyMembers.size() != _members.size()) {
+        return;
+    }
+    if (_members.size() >= MaximumArchiveFiles) {
+        send();
+        return;
+    }
+    // give the scheduler the chance to add more members before sending
+    _sendScheduled = true;
+    QTimer::singleShot(0, this, [this] {
+        _sendScheduled = false;
+        if (!_sent && !_members.isEmpty() && _readyMembers.size() == _members.size()) {
+            send();
+        }
+    });
+}
+
+void DownloadArchive::send()
+{
+    _sent = true;
+
+    if (_members.size() == 1) {
+        // an archive of a single file is no better than a GET
+        auto *member = _members.takeFirst();
+        member->downloadWithoutArchive();
+        deleteLater();
+        return;
+    }
+
+    SimpleNetworkJob::UrlQuery arguments;
+    arguments.reserve(_members.size() + 1);
+    for (auto *member : std::as_const(_members)) {
+        arguments.append({QStringLiteral("id"), QString::fromUtf8(member->item()->_fileId)});
+    }
+    arguments.append({QStringLiteral("output-format"), QStringLiteral("tar")});
+
+    qCInfo(lcPropagateDownloadArchive) << "Downloading" << _members.size() << "files of" << _directory << "with a single request," << _size << "bytes";
+
+    QNetworkRequest req;
+    req.setAttribute(AccessManager::TransferAttribute, true);
+    const QUrl url = _propagator->account()->url().resolved(_propagator->account()->capabilities().archiverUrl());
+    _job = new SimpleNetworkJob(_propagator->account(), url, {}, "GET", arguments, req, this);
+    _job->setPriority(QNetworkRequest::LowPriority);
+    _job->setRequestClass(JobQueue::RequestClass::Transfer);
+    _job->addNewReplyHook([this](QNetworkReply *reply) { connect(reply, &QNetworkReply::readyRead, this, [this, reply] { readReply(reply); }); });
+    connect(_job, &SimpleNetworkJob::finishedSignal, this, &DownloadArchive::slotFinished);
+
+    _activeJobSlot = _members.first();
+    _propagator->_activeJobList.append(_activeJobSlot);
+    _job->start();
+}
+
+void DownloadArchive::readReply(QNetworkReply *reply)
+{
+    if (_ended || _corrupt || reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
+        // the body of an error is read when the job finished
+        return;
+    }
+    const QByteArray data = reply->readAll();
+    _received += data.size();
+    _buffer.append(data);
+
+    qsizetype pos = 0;
+    while (!_ended && !_corrupt) {
+        const qsizetype available = _buffer.size() - pos;
+        if (_entryRemaining > 0) {
+            if (available == 0) {
+                break;
+            }
+            const auto chunk = QByteArrayView(_buffer).sliced(pos, qMin<qint64>(_entryRemaining, available));
+            if (_entryType == EntryType::File && _entryMember) {
+                _entryMember->archiveData(chunk);
+            } else if (_entryType == EntryType::LongName || _entryType == EntryType::PaxHeader) {
+                _entryMetadata.append(chunk);
+            }
+            pos += chunk.size();
+            _entryRemaining -= chunk.size();
+            if (_entryRemaining == 0) {
+                finishEntry();
+            }
+        } else if (_entryPadding > 0) {
+            const auto skipped = qMin<qint64>(_entryPadding, available);
+            if (skipped == 0) {
+                break;
+            }
+            pos += skipped;
+            _entryPadding -= skipped;
+        } else if (available >= TarBlockSize) {
+            readHeader(QByteArrayView(_buffer).sliced(pos, TarBlockSize));
+            pos += TarBlockSize;
+        } else {
+            break;
+        }
+    }
+    _buffer.remove(0, pos);
+
+    if (_corrupt && _job) {
+        _job->abort();
+    }
+}
+
+void DownloadArchive::readHeader(QByteArrayView header)
+{
+    if (std::all_of(header.begin(), header.end(), [](char c) { return c == '\0'; })) {
+        // the archive ends with zero blocks
+        _ended = true;
+        return;
+    }
+    if (!isTarHeaderValid(header)) {
+        qCWarning(lcPropagateDownloadArchive) << "The archive of" << _directory << "is corrupt";
+        _corrupt = true;
+        return;
+    }
+
+    QString name = std::exchange(_nextName, {});
+    if (name.isEmpty()) {
+        name = tarString(header.sliced(0, 100));
+        const QString prefix = tarString(header.sliced(345, 155));
+        if (header.sliced(257, 6) == QByteArrayView("ustar\0", 6) && !prefix.isEmpty()) {
+            name = prefix + QLatin1Char('/') + name;
+        }
+    }
+    _entryRemaining = tarNumber(header.sliced(124, 12));
+    _entryPadding = (TarBlockSize - _entryRemaining % TarBlockSize) % TarBlockSize;
+    _entryMetadata.clear();
+    _entryMember = nullptr;
+
+    switch (header.at(156)) {
+    case '0':
+    case '\0': {
+        _entryType = EntryType::File;
+        const QString entryName = fileName(name);
+        const auto it = std::find_if(_members.cbegin(), _members.cend(), [&entryName](auto *member) { return fileName(member->item()->_file) == entryName; });
+        if (it != _members.cend()) {
+            _entryMember = *it;
+            _entryMember->archiveEntryStarted();
+        } else {
+            qCWarning(lcPropagateDownloadArchive) << "Skipping the unexpected entry" << name;
+        }
+        break;
+    }
+    case 'L':
+        _entryType = EntryType::LongName;
+        break;
+    case 'x':
+        _entryType = EntryType::PaxHeader;
+        break;
+    default:
+        // directories, links and global pax headers
+        _entryType = EntryType::Skipped;
+    }
+
+    if ((_entryType == EntryType::LongName || _entryType == EntryType::PaxHeader) && _entryRemaining > MaximumMetadataSize) {
+        qCWarning(lcPropagateDownloadArchive) << "The archive of" << _directory << "has a header of" << _entryRemaining << "bytes";
+        _corrupt = true;
+        return;
+    }
+    if (_entryRemaining == 0) {
+        finishEntry();
+    }
+}
+
+void DownloadArchive::finishEntry()
+{
+    switch (_entryType) {
+    case EntryType::File:
+        if (auto *member = std::exchange(_entryMember, nullptr)) {
+            takeMember(member);
+            _propagator->recordRequest(member->item()->_file, _job, member->item()->_size);
+            member->archiveEntryFinished();
+        }
+        break;
+    case EntryType::LongName:
+        _nextName = tarString(_entryMetadata);
+        break;
+    case EntryType::PaxHeader:
+        _nextName = paxPath(_entryMetadata);
+        break;
+    case EntryType::Skipped:
+        break;
+    }
+    _entryType = EntryType::Skipped;
+    _entryMetadata.clear();
+}
+
+void DownloadArchive::slotFinished()
+{
+    if (_activeJobSlot) {
+        _propagator->_activeJobList.removeOne(_activeJobSlot);
+        _activeJobSlot.clear();
+    }
+    auto *reply = _job->reply();
+    const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->error() == QNetworkReply::NoError) {
+        readReply(reply);
+    }
+    _propagator->reportTransferSample(_job, _received);
+
+    // the members that were not delivered download their files on their own
+    const auto members = _members;
+    _members.clear();
+    if (!members.isEmpty()) {
+        qCWarning(lcPropagateDownloadArchive) << "The archive of" << _directory << "lacks" << members.size() << "files, downloading them one by one:" << httpStatus
+                                              << reply->errorString();
+        if (httpStatus == 404 || httpStatus == 405 || httpStatus == 501) {
+            // the server advertised the archiver but does not provide it
+            _propagator->_archiveDownloadUnavailable = true;
+        }
+        for (auto *member : members) {
+            member->downloadWithoutArchive();
+        }
+    }
+    deleteLater();
+}
+
+}
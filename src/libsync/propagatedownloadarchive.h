@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudpropagator.h"
+
+#include <QPointer>
+
+class QNetworkReply;
+
+namespace OCC {
+Q_DECLARE_LOGGING_CATEGORY(lcPropagateDownloadArchive)
+
+class PropagateDownloadFile;
+class SimpleNetworkJob;
+
+/**
+ * @brief Downloads several small files of a directory with a single archive request
+ * @ingroup libsync
+ *
+ * Members join the archive when they are created and report when their
+ * temporary files are ready. Once all members are ready, or the archive is full,
+ * the server's archiver is asked for a tar stream of the files. The stream is
+ * unpacked while it arrives, the content of each entry goes straight into the
+ * temporary file of its member which then validates and commits it like a
+ * regular download.
+ *
+ * The members the archive does not deliver fall back to single GETs.
+ */
+class DownloadArchive : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DownloadArchive(OwncloudPropagator *propagator);
+
+    /** Whether \a item can still be added to this archive */
+    bool accepts(const SyncFileItem &item) const;
+
+    void addMember(PropagateDownloadFile *member);
+    void memberReady(PropagateDownloadFile *member);
+    void removeMember(PropagateDownloadFile *member);
+
+private:
+    enum class EntryType {
+        Skipped,
+        File,
+        // the entry holds the name of the next one
+        LongName,
+        PaxHeader
+    };
+
+    void maybeSend();
+    void send();
+    void readReply(QNetworkReply *reply);
+    void readHeader(QByteArrayView header);
+    void finishEntry();
+    void slotFinished();
+
+    /** Removes \a member without touching the request */
+    void takeMember(PropagateDownloadFile *member);
+
+    OwncloudPropagator *_propagator;
+    QString _directory;
+    QVector<PropagateDownloadFile *> _members;
+    QSet<PropagateDownloadFile *> _readyMembers;
+    qint64 _size = 0;
+    bool _sendScheduled = false;
+    bool _sent = false;
+    QPointer<SimpleNetworkJob> _job;
+
+    // While the request is running it takes one slot in _activeJobList
+    QPointer<PropagateDownloadFile> _activeJobSlot;
+
+    // The state of the tar stream
+    QByteArray _buffer;
+    qint64 _received = 0;
+    EntryType _entryType = EntryType::Skipped;
+    qint64 _entryRemaining = 0;
+    qint64 _entryPadding = 0;
+    QByteArray _entryMetadata;
+    PropagateDownloadFile *_entryMember = nullptr;
+    QString _nextName;
+    bool _ended = false;
+    bool _corrupt = false;
+};
+
+}
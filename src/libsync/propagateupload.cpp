@@ -13,6 +13,7 @@
  */
 
 #include "propagateupload.h"
+#include "accessmanager.h"
 #include "account.h"
 #include "filesystem.h"
 #include "networkjobs.h"
@@ -28,13 +29,20 @@
 
 #include "libsync/theme.h"
 
+#include <QBuffer>
 #include <QDir>
 #include <QFileInfo>
 #include <QJsonObject>
+#include <QXmlStreamReader>
+#include <QtConcurrentRun>
 
 #include <chrono>
 #include <cmath>
 
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS)
+#include <fcntl.h>
+#endif
+
 using namespace std::chrono_literals;
 
 namespace OCC {
@@ -44,6 +52,9 @@ Q_LOGGING_CATEGORY(lcPropagateUpload, "sync.propagator.upload", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateUploadV1, "sync.propagator.upload.v1", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateUploadNG, "sync.propagator.upload.ng", QtInfoMsg)
 
+// in propagatedownload.cpp
+QString OWNCLOUDSYNC_EXPORT createDownloadTmpFileName(const QString &previous);
+
 /**
  * We do not want to upload files that are currently being modified.
  * To avoid that, we don't upload files that have a modification time
@@ -72,6 +83,7 @@ PUTFileJob::PUTFileJob(AccountPtr account, const QUrl &url, const QString &path,
     _device->setParent(this);
     // Long uploads must not block non-propagation jobs.
     setPriority(QNetworkRequest::LowPriority);
+    setRequestClass(JobQueue::RequestClass::Transfer);
 }
 
 PUTFileJob::~PUTFileJob()
@@ -84,6 +96,7 @@ void PUTFileJob::start()
     for (auto it = _headers.cbegin(); it != _headers.cend(); ++it) {
         req.setRawHeader(it.key(), it.value());
     }
+    req.setAttribute(AccessManager::TransferAttribute, true);
     sendRequest("PUT", req, _device);
     _requestTimer.start();
     AbstractNetworkJob::start();
@@ -103,6 +116,75 @@ void PUTFileJob::newReplyHook(QNetworkReply *reply)
     connect(reply, &QNetworkReply::uploadProgress, this, &PUTFileJob::uploadProgress);
 }
 
+CopyJob::CopyJob(AccountPtr account, const QUrl &url, const QString &path, const QString &destination, const HeaderMap &extraHeaders,
+    QObject *parent)
+    : AbstractNetworkJob(account, url, path, parent)
+    , _destination(destination)
+    , _extraHeaders(extraHeaders)
+{
+}
+
+void CopyJob::start()
+{
+    QNetworkRequest req;
+    req.setRawHeader("Destination", QUrl::toPercentEncoding(_destination, "/"));
+    req.setRawHeader("Overwrite", "F");
+    for (auto it = _extraHeaders.constBegin(); it != _extraHeaders.constEnd(); ++it) {
+        req.setRawHeader(it.key(), it.value());
+    }
+    sendRequest("COPY", req);
+    AbstractNetworkJob::start();
+}
+
+void CopyJob::finished()
+{
+    qCInfo(lcPropagateUpload) << "COPY of" << reply()->request().url() << "FINISHED WITH STATUS" << replyStatusString();
+}
+
+ModTimeJob::ModTimeJob(AccountPtr account, const QUrl &url, const QString &path, time_t modtime, const HeaderMap &extraHeaders, QObject *parent)
+    : AbstractNetworkJob(account, url, path, parent)
+    , _modtime(modtime)
+    , _extraHeaders(extraHeaders)
+{
+}
+
+void ModTimeJob::start()
+{
+    QNetworkRequest req;
+    for (auto it = _extraHeaders.constBegin(); it != _extraHeaders.constEnd(); ++it) {
+        req.setRawHeader(it.key(), it.value());
+    }
+    // the server takes the unix time, like the X-OC-MTime header of an upload
+    const QByteArray data = QByteArrayLiteral("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                                              "<d:propertyupdate xmlns:d=\"DAV:\"><d:set><d:prop><d:lastmodified>")
+        + QByteArray::number(static_cast<qint64>(_modtime)) + QByteArrayLiteral("</d:lastmodified></d:prop></d:set></d:propertyupdate>\n");
+    auto *buf = new QBuffer(this);
+    buf->setData(data);
+    buf->open(QIODevice::ReadOnly);
+    sendRequest(QByteArrayLiteral("PROPPATCH"), req, buf);
+    AbstractNetworkJob::start();
+}
+
+void ModTimeJob::finished()
+{
+    qCInfo(lcPropagateUpload) << "PROPPATCH of" << reply()->request().url() << "FINISHED WITH STATUS" << replyStatusString();
+    if (reply()->error() != QNetworkReply::NoError || httpStatusCode() != 207) {
+        return;
+    }
+    // the multistatus response has a status for every property
+    QXmlStreamReader reader(reply());
+    bool hasStatus = false;
+    bool allOk = true;
+    while (!reader.atEnd()) {
+        if (reader.readNext() == QXmlStreamReader::StartElement && reader.namespaceUri() == QLatin1String("DAV:")
+            && reader.name() == QLatin1String("status")) {
+            hasStatus = true;
+            allOk &= reader.readElementText().contains(QLatin1String(" 200 "));
+        }
+    }
+    _modtimeSet = !reader.hasError() && hasStatus && allOk;
+}
+
 const QString PropagateUploadFileCommon::fileChangedMessage()
 {
     return tr("Local file changed during sync. It will be resumed.");
@@ -157,7 +239,10 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
         return;
     }
 
-    const QString filePath = propagator()->fullLocalPath(_item->_file);
+    if (propagator()->syncOptions()._snapshotUploads && _snapshotPath.isEmpty()) {
+        takeSnapshot();
+    }
+    const QString filePath = uploadSourcePath();
 
     // remember the modtime before checksumming to be able to detect a file
     // change during the checksum calculation
@@ -172,19 +257,49 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
         return;
     }
 
+    // Maybe an earlier attempt to upload the unchanged file computed it?
+    const auto cachedChecksum = propagator()->_journal->cachedChecksum(_item->_inode, _item->_modtime, _item->_size, checksumType);
+    if (!cachedChecksum.isEmpty()) {
+        qCDebug(lcPropagateUpload) << "Using the cached" << checksumType << "checksum of" << filePath;
+        slotComputeTransmissionChecksum(checksumType, cachedChecksum);
+        return;
+    }
+
     // we must be able to read the file
     if (FileSystem::isFileLocked(filePath, FileSystem::LockMode::SharedRead)) {
         Q_EMIT propagator()->seenLockedFile(filePath, FileSystem::LockMode::SharedRead);
         abortWithError(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(filePath));
         return;
     }
+    beginStep("checksum");
+
+    // If the content checksum can't be reused as the transmission checksum, compute
+    // both with a single read of the file instead of reading it twice.
+    const auto &capabilities = propagator()->account()->capabilities();
+    const auto transmissionChecksumType = capabilities.uploadChecksumType();
+    if (uploadChecksumEnabled() && transmissionChecksumType != checksumType && !capabilities.supportedChecksumTypes().contains(checksumType)) {
+        qCInfo(lcPropagateUpload) << "Computing" << checksumType << "and" << transmissionChecksumType << "checksums of" << filePath << "in a thread";
+        const QVector<CheckSums::Algorithm> algorithms{checksumType, transmissionChecksumType};
+        QtConcurrent::run([filePath, algorithms] { return ComputeChecksum::computeNowOnFile(filePath, algorithms); })
+            .then(this, [this, checksumType, transmissionChecksumType](const QVector<QByteArray> &checksums) {
+                if (propagator()->_abortRequested) {
+                    return;
+                }
+                propagator()->_journal->setCachedChecksum(_item->_inode, _item->_modtime, _item->_size, checksumType, checksums.at(0));
+                _item->_checksumHeader = ChecksumHeader(checksumType, checksums.at(0)).makeChecksumHeader();
+                slotStartUpload(transmissionChecksumType, checksums.at(1));
+            });
+        return;
+    }
 
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
     computeChecksum->setChecksumType(checksumType);
 
-    connect(computeChecksum, &ComputeChecksum::done,
-        this, &PropagateUploadFileCommon::slotComputeTransmissionChecksum);
+    connect(computeChecksum, &ComputeChecksum::done, this, [this](CheckSums::Algorithm contentChecksumType, const QByteArray &contentChecksum) {
+        propagator()->_journal->setCachedChecksum(_item->_inode, _item->_modtime, _item->_size, contentChecksumType, contentChecksum);
+        slotComputeTransmissionChecksum(contentChecksumType, contentChecksum);
+    });
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
     computeChecksum->start(filePath);
@@ -202,7 +317,7 @@ void PropagateUploadFileCommon::slotComputeTransmissionChecksum(CheckSums::Algor
         return;
     }
 
-    const QString filePath = propagator()->fullLocalPath(_item->_file);
+    const QString filePath = uploadSourcePath();
     // we must be able to read the file
     if (FileSystem::isFileLocked(filePath, FileSystem::LockMode::SharedRead)) {
         Q_EMIT propagator()->seenLockedFile(filePath, FileSystem::LockMode::SharedRead);
@@ -227,6 +342,8 @@ void PropagateUploadFileCommon::slotComputeTransmissionChecksum(CheckSums::Algor
 
 void PropagateUploadFileCommon::slotStartUpload(CheckSums::Algorithm transmissionChecksumType, const QByteArray &transmissionChecksum)
 {
+    endStep("checksum");
+
     // Remove ourselfs from the list of active job, before any posible call to done()
     // When we start chunks, we will add it again, once for every chunks.
     propagator()->_activeJobList.removeOne(this);
@@ -238,13 +355,14 @@ void PropagateUploadFileCommon::slotStartUpload(CheckSums::Algorithm transmissio
         _item->_checksumHeader = _transmissionChecksumHeader;
     }
 
-    const QString fullFilePath = propagator()->fullLocalPath(_item->_file);
+    const QString fullFilePath = uploadSourcePath();
 
-    if (!FileSystem::fileExists(fullFilePath)) {
+    const auto state = FileSystem::fileState(fullFilePath);
+    if (!state.exists) {
         done(SyncFileItem::SoftError, tr("File Removed"));
         return;
     }
-    _item->_size = FileSystem::getSize(QFileInfo{fullFilePath});
+    _item->_size = state.size;
 
     const time_t prevModtime = _item->_modtime; // the _item value was set in PropagateUploadFile::start()
     // but a potential checksum calculation could have taken some time during which the file could
@@ -253,16 +371,156 @@ void PropagateUploadFileCommon::slotStartUpload(CheckSums::Algorithm transmissio
     // But skip the file if the mtime is too close to 'now'!
     // That usually indicates a file that is still being changed
     // or not yet fully copied to the destination.
-    _item->_modtime = FileSystem::getModTime(fullFilePath);
-    if (prevModtime != _item->_modtime || fileIsStillChanging(*_item)) {
+    _item->_modtime = state.modtime;
+    // a snapshot doesn't change, however recently the file was modified
+    if (prevModtime != _item->_modtime || (_snapshotPath.isEmpty() && fileIsStillChanging(*_item))) {
         propagator()->_anotherSyncNeeded = true;
         done(SyncFileItem::Message, fileChangedMessage());
         return;
     }
 
+    if (skipUnchangedContent() || startServerSideCopy()) {
+        return;
+    }
     doStartUpload();
 }
 
+bool PropagateUploadFileCommon::skipUnchangedContent()
+{
+    if (!propagator()->syncOptions()._skipUnchangedContentUploads || _deleteExisting || _item->instruction() != CSYNC_INSTRUCTION_SYNC) {
+        return false;
+    }
+    SyncJournalFileRecord record;
+    if (!propagator()->_journal->getFileRecord(_item->_file, &record) || !record.isValid() || record._type != ItemTypeFile
+        || record._fileSize != _item->_size || record._checksumHeader.isEmpty() || record._checksumHeader != _item->_checksumHeader) {
+        return false;
+    }
+
+    qCInfo(lcPropagateUpload) << "The content of" << _item->_file << "did not change, only setting the modification time";
+    if (record._modtime == _item->_modtime) {
+        // the server still has the version of the journal, otherwise this would be a conflict
+        _quotaUpdated = true;
+        _item->_etag = QString::fromUtf8(record._etag);
+        _item->_fileId = record._fileId;
+        _item->_remotePerm = record._remotePerm;
+        finalize();
+        return true;
+    }
+    // if the file changed on the server meanwhile, the upload runs into the conflict instead
+    auto *job = new ModTimeJob(propagator()->account(), propagator()->webDavUrl(), propagator()->fullRemotePath(_item->_file), _item->_modtime,
+        {{QByteArrayLiteral("If-Match"), QByteArray('"' + record._etag + '"')}}, this);
+    addChildJob(job);
+    connect(job, &ModTimeJob::finishedSignal, this, &PropagateUploadFileCommon::slotModTimeFinished);
+    propagator()->_activeJobList.append(this);
+    job->start();
+    return true;
+}
+
+void PropagateUploadFileCommon::slotModTimeFinished()
+{
+    auto *job = qobject_cast<ModTimeJob *>(sender());
+    OC_ASSERT(job);
+    propagator()->_activeJobList.removeOne(this);
+    if (propagator()->_abortRequested) {
+        return;
+    }
+
+    if (!job->modtimeSet()) {
+        qCInfo(lcPropagateUpload) << "Setting the modification time of" << _item->_file << "failed, uploading the file instead";
+        doStartUpload();
+        return;
+    }
+
+    _item->_responseTimeStamp = job->responseTimestamp();
+    _item->_requestId = job->requestId();
+    _item->_httpErrorCode = job->httpStatusCode();
+    _quotaUpdated = true;
+    // the etag changed with the modification time
+    readRemoteMetadata();
+}
+
+bool PropagateUploadFileCommon::startServerSideCopy()
+{
+    if (!propagator()->syncOptions()._serverSideCopy || _deleteExisting || _item->instruction() != CSYNC_INSTRUCTION_NEW
+        || _item->_size < propagator()->smallFileSize()) {
+        return false;
+    }
+
+    SyncJournalFileRecord source;
+    const QByteArray path = _item->_file.toUtf8();
+    const bool ok = propagator()->_journal->getFileRecordsByContentChecksum(_item->_checksumHeader, _item->_size, [&](const SyncJournalFileRecord &record) {
+        // virtual files are skipped, their local name differs from the remote one
+        if (!source.isValid() && record._type == ItemTypeFile && !record._etag.isEmpty() && record._path != path) {
+            source = record;
+        }
+    });
+    if (!ok || !source.isValid()) {
+        return false;
+    }
+
+    qCInfo(lcPropagateUpload) << "Copying" << source._path << "on the server instead of uploading" << _item->_file;
+    const QString destination = QDir::cleanPath(propagator()->webDavUrl().path() + propagator()->fullRemotePath(_item->_file));
+    // the copy fails if the source changed since the journal entry was written
+    auto *job = new CopyJob(propagator()->account(), propagator()->webDavUrl(), propagator()->fullRemotePath(QString::fromUtf8(source._path)),
+        destination, {{QByteArrayLiteral("If-Match"), QByteArray('"' + source._etag + '"')}}, this);
+    addChildJob(job);
+    connect(job, &CopyJob::finishedSignal, this, &PropagateUploadFileCommon::slotCopyFinished);
+    propagator()->_activeJobList.append(this);
+    job->start();
+    return true;
+}
+
+void PropagateUploadFileCommon::slotCopyFinished()
+{
+    auto *job = qobject_cast<CopyJob *>(sender());
+    OC_ASSERT(job);
+    propagator()->_activeJobList.removeOne(this);
+    if (propagator()->_abortRequested) {
+        return;
+    }
+
+    const int httpCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (job->reply()->error() != QNetworkReply::NoError || httpCode != 201) {
+        qCInfo(lcPropagateUpload) << "Server side copy of" << _item->_file << "failed with" << httpCode << "uploading the file instead";
+        doStartUpload();
+        return;
+    }
+
+    _item->_responseTimeStamp = job->responseTimestamp();
+    _item->_requestId = job->requestId();
+    _item->_httpErrorCode = httpCode;
+
+    // the copy is a new file with its own etag and file id
+    readRemoteMetadata();
+}
+
+void PropagateUploadFileCommon::readRemoteMetadata()
+{
+    propagator()->_activeJobList.append(this);
+    auto *propfindJob = new PropfindJob(propagator()->account(), propagator()->webDavUrl(), propagator()->fullRemotePath(_item->_file),
+        PropfindJob::Depth::Zero, this);
+    addChildJob(propfindJob);
+    propfindJob->setProperties({"getetag", "http://owncloud.org/ns:id", "http://owncloud.org/ns:permissions"});
+    connect(propfindJob, &PropfindJob::directoryListingIterated, this, [this](const QString &, const QMap<QString, QString> &map) {
+        _item->_etag = Utility::normalizeEtag(map.value(QStringLiteral("getetag")));
+        _item->_fileId = map.value(QStringLiteral("id")).toUtf8();
+        _item->_remotePerm = RemotePermissions::fromServerString(map.value(QStringLiteral("permissions")));
+    });
+    connect(propfindJob, &PropfindJob::finishedWithoutError, this, [this] {
+        propagator()->_activeJobList.removeOne(this);
+        if (_item->_etag.isEmpty()) {
+            done(SyncFileItem::NormalError, tr("The server did not provide the etag of the file"));
+            return;
+        }
+        finalize();
+    });
+    connect(propfindJob, &PropfindJob::finishedWithError, this, [this] {
+        propagator()->_activeJobList.removeOne(this);
+        done(SyncFileItem::NormalError, tr("Could not read the metadata of the file"));
+    });
+    propfindJob->start();
+}
+
 UploadDevice::UploadDevice(const QString &fileName, qint64 start, qint64 size, BandwidthManager *bwm)
     : _file(fileName)
     , _start(start)
@@ -292,20 +550,26 @@ bool UploadDevice::open(QIODevice::OpenMode mode)
     if (mode & QIODevice::WriteOnly)
         return false;
 
-    // Get the file size now: _file.fileName() is no longer reliable
-    // on all platforms after openAndSeekFileSharedRead().
-    auto fileDiskSize = FileSystem::getSize(QFileInfo{_file.fileName()});
-
     QString openError;
     if (!FileSystem::openAndSeekFileSharedRead(&_file, &openError, _start)) {
         setErrorString(openError);
         return false;
     }
+    // The size of the opened file, _file.fileName() is no longer reliable
+    // on all platforms after openAndSeekFileSharedRead().
+    const qint64 fileDiskSize = FileSystem::fileState(_file).size;
 
     _size = qBound(0ll, _size, fileDiskSize - _start);
     _read = 0;
+    _readAhead = 0;
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS)
+    // Windows gets the same hint with FILE_FLAG_SEQUENTIAL_SCAN
+    posix_fadvise(_file.handle(), _start, _size, POSIX_FADV_SEQUENTIAL);
+#endif
+    readAhead();
 
-    return QIODevice::open(mode);
+    // The file is opened unbuffered, QIODevice would only add another copy
+    return QIODevice::open(mode | QIODevice::Unbuffered);
 }
 
 void UploadDevice::close()
@@ -350,9 +614,26 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
         return -1;
     }
     _read += c;
+    readAhead();
     return c;
 }
 
+void UploadDevice::readAhead()
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS)
+    // Keep a window of the chunk in the page cache, so reads don't wait for the disk
+    // while the upload runs. Issued again once half of the window was read.
+    constexpr qint64 windowC = 4 * 1024 * 1024;
+    if (_readAhead - _read > windowC / 2 || _readAhead >= _size) {
+        return;
+    }
+    const qint64 from = std::max(_read, _readAhead);
+    const qint64 to = std::min(_read + windowC, _size);
+    posix_fadvise(_file.handle(), _start + from, to - from, POSIX_FADV_WILLNEED);
+    _readAhead = to;
+#endif
+}
+
 void UploadDevice::slotJobUploadProgress(qint64 sent, qint64 t)
 {
     if (sent == 0 || t == 0) {
@@ -392,7 +673,9 @@ bool UploadDevice::seek(qint64 pos)
         return false;
     }
     _read = pos;
+    _readAhead = std::min(_readAhead, pos);
     _file.seek(_start + pos);
+    readAhead();
     return true;
 }
 
@@ -420,9 +703,49 @@ void UploadDevice::setChoked(bool b)
     }
 }
 
+PropagateUploadFileCommon::~PropagateUploadFileCommon()
+{
+    removeSnapshot();
+}
+
+QString PropagateUploadFileCommon::uploadSourcePath() const
+{
+    return _snapshotPath.isEmpty() ? propagator()->fullLocalPath(_item->_file) : _snapshotPath;
+}
+
+void PropagateUploadFileCommon::takeSnapshot()
+{
+    const QString filePath = propagator()->fullLocalPath(_item->_file);
+    // named like a download in progress, so the discovery ignores it
+    const QString snapshotPath = propagator()->fullLocalPath(createDownloadTmpFileName(_item->_file));
+    const auto before = FileSystem::fileState(filePath);
+    if (!before.exists || !FileSystem::cloneFile(filePath, snapshotPath)) {
+        qCDebug(lcPropagateUpload) << "Can't take a snapshot of" << filePath << ", uploading the file itself";
+        return;
+    }
+    // the clone doesn't keep the modification time, it's only known if the file didn't change meanwhile
+    const auto after = FileSystem::fileState(filePath);
+    if (after.modtime != before.modtime || after.size != before.size || !FileSystem::setModTime(snapshotPath, before.modtime)) {
+        qCInfo(lcPropagateUpload) << filePath << "changed while taking a snapshot, uploading the file itself";
+        FileSystem::remove(snapshotPath);
+        return;
+    }
+    qCInfo(lcPropagateUpload) << "Uploading" << filePath << "from the snapshot" << snapshotPath;
+    _snapshotPath = snapshotPath;
+}
+
+void PropagateUploadFileCommon::removeSnapshot()
+{
+    if (!_snapshotPath.isEmpty()) {
+        FileSystem::remove(_snapshotPath);
+        _snapshotPath.clear();
+    }
+}
+
 void PropagateUploadFileCommon::done(SyncFileItem::Status status, const QString &errorString)
 {
     _finished = true;
+    removeSnapshot();
     PropagateItemJob::done(status, errorString);
 }
 
@@ -508,6 +831,35 @@ void PropagateUploadFileCommon::abortWithError(SyncFileItem::Status status, cons
     }
 }
 
+void PropagateUploadFileCommon::abortWithOpenError(const UploadDevice &device)
+{
+    const QString fileName = uploadSourcePath();
+    if (FileSystem::isFileLocked(fileName, FileSystem::LockMode::SharedRead)) {
+        Q_EMIT propagator()->seenLockedFile(fileName, FileSystem::LockMode::SharedRead);
+        abortWithError(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(QDir::toNativeSeparators(fileName)));
+        return;
+    }
+    qCWarning(lcPropagateUpload) << "Could not prepare upload device: " << device.errorString();
+    // Soft error because this is likely caused by the user modifying his files while syncing
+    abortWithError(SyncFileItem::SoftError, device.errorString());
+}
+
+bool PropagateUploadFileCommon::parallelChunkUploadEnabled() const
+{
+    if (propagator()->account()->capabilities().chunkingParallelUploadDisabled()) {
+        // Server may also disable parallel chunked upload for any higher version
+        return false;
+    }
+    static bool envEnabled = [] {
+        const auto env = qEnvironmentVariable("OWNCLOUD_PARALLEL_CHUNK");
+        if (!env.isEmpty()) {
+            return env != QLatin1String("false") && env != QLatin1String("0");
+        }
+        return true;
+    }();
+    return envEnabled;
+}
+
 void PropagateUploadFileCommon::addChildJob(AbstractNetworkJob *job)
 {
     _childJobs.insert(job);
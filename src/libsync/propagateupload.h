@@ -20,6 +20,7 @@
 #include <QFile>
 #include <QElapsedTimer>
 
+#include <algorithm>
 #include <unordered_set>
 
 namespace OCC {
@@ -35,7 +36,7 @@ class BandwidthManager;
  * @brief The UploadDevice class
  * @ingroup libsync
  */
-class UploadDevice : public QIODevice
+class OWNCLOUDSYNC_EXPORT UploadDevice : public QIODevice
 {
     Q_OBJECT
 public:
@@ -58,6 +59,9 @@ public:
     void setChoked(bool);
     bool isChoked() { return _choked; }
     void giveBandwidthQuota(qint64 bwq);
+    qint64 bandwidthQuota() const { return _bandwidthQuota; }
+    /// The amount of data that could still be read with more quota
+    qint64 bandwidthDemand() const { return std::max<qint64>(0, _size - _read - _bandwidthQuota); }
 
 Q_SIGNALS:
 
@@ -71,6 +75,11 @@ private:
     qint64 _size = 0;
     /// Position between _start and _start+_size
     qint64 _read = 0;
+    /// Position up to which the kernel was asked to read ahead
+    qint64 _readAhead = 0;
+
+    /// Ask the kernel to prefetch the data after _read
+    void readAhead();
 
     // Bandwidth manager related
     QPointer<BandwidthManager> _bandwidthManager;
@@ -131,6 +140,49 @@ Q_SIGNALS:
 
 };
 
+/**
+ * @brief Duplicates a remote file with a WebDAV COPY
+ * @ingroup libsync
+ *
+ * Never overwrites an existing destination.
+ */
+class CopyJob : public AbstractNetworkJob
+{
+    Q_OBJECT
+    const QString _destination;
+    HeaderMap _extraHeaders;
+
+public:
+    explicit CopyJob(AccountPtr account, const QUrl &url, const QString &path, const QString &destination, const HeaderMap &extraHeaders,
+        QObject *parent = nullptr);
+
+    void start() override;
+    void finished() override;
+};
+
+/**
+ * @brief Sets the modification time of a remote file with a WebDAV PROPPATCH
+ * @ingroup libsync
+ *
+ * The server changes the etag of the file.
+ */
+class ModTimeJob : public AbstractNetworkJob
+{
+    Q_OBJECT
+    const time_t _modtime;
+    HeaderMap _extraHeaders;
+    bool _modtimeSet = false;
+
+public:
+    explicit ModTimeJob(AccountPtr account, const QUrl &url, const QString &path, time_t modtime, const HeaderMap &extraHeaders, QObject *parent = nullptr);
+
+    void start() override;
+    void finished() override;
+
+    /** Whether the server accepted the new modification time */
+    bool modtimeSet() const { return _modtimeSet; }
+};
+
 /**
  * @brief The PropagateUploadFileCommon class is the code common between all chunking algorithms
  * @ingroup libsync
@@ -140,12 +192,20 @@ Q_SIGNALS:
  *   +---> start()  --> (delete job) -------+
  *   |                                      |
  *   +--> slotComputeContentChecksum()  <---+
- *                   |
- *                   v
- *    slotComputeTransmissionChecksum()
- *         |
- *         v
- *    slotStartUpload()  -> doStartUpload()
+ *                   |           |
+ *                   v           | (both checksums in one pass, if the
+ *    slotComputeTransmissionChecksum()  content checksum can't be reused)
+ *         |                     |
+ *         v                     |
+ *    slotStartUpload()  <-------+
+ *         |            |
+ *         |            +--> (the content didn't change) --> slotModTimeFinished() --> finalize()
+ *         |            |                                           | (failed)
+ *         |            v (the content is already on the server)    |
+ *         |    startServerSideCopy() --> slotCopyFinished() --> finalize()
+ *         |                                    | (failed)          |
+ *         v                                    |                   |
+ *    doStartUpload()  <------------------------+-------------------+
  *                                  .
  *                                  .
  *                                  v
@@ -179,6 +239,7 @@ public:
         , _aborting(false)
     {
     }
+    ~PropagateUploadFileCommon() override;
 
     /**
      * Whether an existing entity with the same name may be deleted before
@@ -198,6 +259,15 @@ private Q_SLOTS:
     void slotComputeTransmissionChecksum(CheckSums::Algorithm contentChecksumType, const QByteArray &contentChecksum);
     // transmission checksum computed, prepare the upload
     void slotStartUpload(CheckSums::Algorithm transmissionChecksumType, const QByteArray &transmissionChecksum);
+    void slotCopyFinished();
+    void slotModTimeFinished();
+
+private:
+    /// Clones the local file, so it may keep changing while the clone is uploaded
+    void takeSnapshot();
+    void removeSnapshot();
+
+    QString _snapshotPath;
 
 public:
     virtual void doStartUpload() = 0;
@@ -205,6 +275,14 @@ public:
     void finalize();
     void abortWithError(SyncFileItem::Status status, const QString &error);
 
+    /**
+     * Aborts after \a device could not be opened
+     *
+     * Opening the device is the lock probe of the upload, only a failure is
+     * checked for a lock, to retry the sync once the file is unlocked.
+     */
+    void abortWithOpenError(const UploadDevice &device);
+
     /***
      * Add job to the list of children
      * The job is automatically removed from the children once its done.
@@ -221,6 +299,12 @@ public:
 protected:
     void done(SyncFileItem::Status status, const QString &errorString = QString()) override;
 
+    /// The file the upload reads, the snapshot of the local file if one was taken
+    QString uploadSourcePath() const;
+
+    /// Whether several chunks of a file may be uploaded at the same time, see OWNCLOUD_PARALLEL_CHUNK
+    bool parallelChunkUploadEnabled() const;
+
     /**
      * Aborts all running network jobs, except for the ones that mayAbortJob
      * returns false on and, for async aborts, emits abortFinished when done.
@@ -256,6 +340,22 @@ protected:
     QMap<QByteArray, QByteArray> headers();
 
 private:
+    /** Only set the modification time if the content of the file didn't change, see SyncOptions::_skipUnchangedContentUploads
+     *
+     * The content checksum is computed for every upload, comparing it to the
+     * journal costs nothing. Returns false if the content changed.
+     */
+    bool skipUnchangedContent();
+
+    /// Reads the etag, file id and permissions of the uploaded file from the server, then finalizes
+    void readRemoteMetadata();
+
+    /** Copy a remote file with the same content instead of uploading, see SyncOptions::_serverSideCopy
+     *
+     * Returns false if there is no such file.
+     */
+    bool startServerSideCopy();
+
     bool _quotaUpdated = false;
 
     std::unordered_set<AbstractNetworkJob *> _childJobs; /// network jobs that are currently in transit
@@ -336,8 +436,6 @@ private:
     qint64 _bytesToUpload;
 
     uint _transferId = 0; /// transfer id (part of the url)
-    qint64 _currentChunkOffset = 0; /// byte offset of the next chunk data that will be sent
-    qint64 _currentChunkSize = 0; /// current chunk size
     bool _removeJobError = false; /// if not null, there was an error removing the job
 
     // Map chunk number with its size  from the PROPFIND on resume.
@@ -358,6 +456,14 @@ private:
     };
     QVector<UploadRangeInfo> _rangesToUpload;
 
+    // The chunks that are currently uploaded, they were already removed from _rangesToUpload
+    struct RunningChunk
+    {
+        UploadRangeInfo range;
+        qint64 sent = 0;
+    };
+    QHash<PUTFileJob *, RunningChunk> _runningChunks;
+
     /**
      * Return the path of a chunk.
      * If chunkOffset == -1, returns the URL of the parent folder containing the chunks
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "propagateuploadbundle.h"
+#include "accessmanager.h"
+#include "account.h"
+#include "common/checksums.h"
+#include "common/utility.h"
+#include "filesystem.h"
+#include "networkjobs/jsonjob.h"
+#include "owncloudpropagator_p.h"
+#include "propagatorjobs.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTimer>
+
+#include <numeric>
+
+namespace {
+// Limits of a single bulk request, these match the ones used by the server
+constexpr int MaximumBundleFiles = 100;
+constexpr qint64 MaximumBundleSize = 20 * 1024 * 1024;
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcPropagateUploadBundle, "sync.propagator.upload.bundle", QtInfoMsg)
+
+UploadBundle::UploadBundle(OwncloudPropagator *propagator)
+    : QObject(propagator)
+    , _propagator(propagator)
+{
+}
+
+bool UploadBundle::accepts(const SyncFileItem &item) const
+{
+    return !_sent && _members.size() < MaximumBundleFiles && _size + item._size <= MaximumBundleSize;
+}
+
+void UploadBundle::addMember(PropagateUploadFileBundled *member)
+{
+    Q_ASSERT(!_sent);
+    _members.append(member);
+    _size += member->item()->_size;
+}
+
+void UploadBundle::memberReady(PropagateUploadFileBundled *member)
+{
+    Q_ASSERT(_members.contains(member));
+    _readyMembers.insert(member);
+    maybeSend();
+}
+
+void UploadBundle::removeMember(PropagateUploadFileBundled *member)
+{
+    if (!_members.removeOne(member)) {
+        return;
+    }
+    _readyMembers.remove(member);
+    _size -= member->item()->_size;
+
+    if (member == _activeJobSlot) {
+        // the member might get deleted while the request is still running
+        _propagator->_activeJobList.removeOne(member);
+        _activeJobSlot.clear();
+        if (!_members.isEmpty()) {
+            _activeJobSlot = _members.first();
+            _propagator->_activeJobList.append(_activeJobSlot);
+        }
+    }
+
+    if (_sent) {
+        if (_members.isEmpty() && _job) {
+            _job->abort();
+        }
+    } else {
+        maybeSend();
+    }
+}
+
+void UploadBundle::maybeSend()
+{
+    if (_sent || _sendScheduled || _members.isEmpty() || _readyMembers.size() != _members.size()) {
+        return;
+    }
+    if (_members.size() >= MaximumBundleFiles) {
+        send();
+        return;
+    }
+    // give the scheduler the chance to add more members before sending
+    _sendScheduled = true;
+    QTimer::singleShot(0, this, [this] {
+        _sendScheduled = false;
+        if (!_sent && !_members.isEmpty() && _readyMembers.size() == _members.size()) {
+            send();
+        }
+    });
+}
+
+void UploadBundle::send()
+{
+    _sent = true;
+
+    // Reading and hashing up to MaximumBundleSize bytes would block the event loop
+    QVector<QPointer<PropagateUploadFileBundled>> members;
+    QStringList localPaths;
+    members.reserve(_members.size());
+    localPaths.reserve(_members.size());
+    for (auto *member : std::as_const(_members)) {
+        members.append(member);
+        localPaths.append(_propagator->fullLocalPath(member->item()->_file));
+    }
+    // the bundle counts as one active job while its files are read
+    _activeJobSlot = _members.first();
+    _propagator->_activeJobList.append(_activeJobSlot);
+    _propagator
+        ->runLocalIo([localPaths] {
+            QVector<Part> parts;
+            parts.reserve(localPaths.size());
+            for (const auto &localPath : localPaths) {
+                Part part;
+                QFile file(localPath);
+                if (file.open(QIODevice::ReadOnly)) {
+                    part.data = file.readAll();
+                    part.md5 = QCryptographicHash::hash(part.data, QCryptographicHash::Md5).toHex();
+                } else {
+                    part.error = file.errorString();
+                }
+                parts.append(std::move(part));
+            }
+            return parts;
+        })
+        .then(this, [this, members](const QVector<Part> &parts) { sendParts(members, parts); });
+}
+
+void UploadBundle::sendParts(const QVector<QPointer<PropagateUploadFileBundled>> &members, const QVector<Part> &parts)
+{
+    if (_propagator->_abortRequested) {
+        // the members are aborted on their own
+        if (_activeJobSlot) {
+            _propagator->_activeJobList.removeOne(_activeJobSlot);
+            _activeJobSlot.clear();
+        }
+        deleteLater();
+        return;
+    }
+
+    const QByteArray boundary = QByteArrayLiteral("boundary_") + QByteArray::number(QRandomGenerator::global()->generate64(), 16);
+    QByteArray body;
+    body.reserve(_size + _members.size() * 512);
+
+    for (int i = 0; i < members.size(); ++i) {
+        auto *member = members.at(i).data();
+        // members that were aborted meanwhile already left the bundle
+        if (!member || !_members.contains(member)) {
+            continue;
+        }
+        const auto &item = member->item();
+        const auto &part = parts.at(i);
+        if (!part.error.isEmpty()) {
+            qCWarning(lcPropagateUploadBundle) << "Could not open" << item->_file << part.error;
+            // upload it on its own, this will report the error properly
+            removeMember(member);
+            member->bundleFailed();
+            continue;
+        }
+        if (part.data.size() != item->_size) {
+            qCWarning(lcPropagateUploadBundle) << item->_file << "changed after its checksum was computed, expected" << item->_size << "bytes, read"
+                                               << part.data.size();
+            removeMember(member);
+            member->bundleFileChanged();
+            continue;
+        }
+
+        body.append("--" + boundary + "\r\n");
+        body.append("X-File-Path: " + _propagator->fullRemotePath(item->_file).toUtf8() + "\r\n");
+        body.append("X-File-MD5: " + part.md5 + "\r\n");
+        body.append("X-File-Mtime: " + QByteArray::number(item->_modtime) + "\r\n");
+        if (!member->transmissionChecksumHeader().isEmpty()) {
+            body.append(QByteArray(checkSumHeaderC) + ": " + member->transmissionChecksumHeader() + "\r\n");
+        }
+        body.append("Content-Length: " + QByteArray::number(part.data.size()) + "\r\n\r\n");
+        body.append(part.data);
+        body.append("\r\n");
+    }
+    if (_members.isEmpty()) {
+        deleteLater();
+        return;
+    }
+    body.append("--" + boundary + "--\r\n");
+
+    qCInfo(lcPropagateUploadBundle) << "Uploading" << _members.size() << "files with a single request," << body.size() << "bytes";
+
+    QNetworkRequest req;
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("multipart/related; boundary=" + boundary));
+    req.setAttribute(AccessManager::TransferAttribute, true);
+    _job = new JsonJob(_propagator->account(), _propagator->account()->url(), QStringLiteral("remote.php/dav/bulk"), "POST", std::move(body), req, this);
+    connect(_job, &JsonJob::finishedSignal, this, &UploadBundle::slotFinished);
+    _job->start();
+}
+
+void UploadBundle::slotFinished()
+{
+    if (_activeJobSlot) {
+        _propagator->_activeJobList.removeOne(_activeJobSlot);
+    }
+    const auto payload = std::accumulate(_members.cbegin(), _members.cend(), qint64(0), [](qint64 sum, auto *member) { return sum + member->item()->_size; });
+    _propagator->reportTransferSample(_job, payload);
+    for (auto *member : std::as_const(_members)) {
+        _propagator->recordRequest(member->item()->_file, _job, member->item()->_size);
+    }
+
+    const int httpStatus = _job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const auto members = _members;
+    _members.clear();
+    if (_job->reply()->error() != QNetworkReply::NoError || httpStatus != 200 || _job->parseError().error != QJsonParseError::NoError) {
+        qCWarning(lcPropagateUploadBundle) << "Bulk upload failed, falling back to single uploads:" << httpStatus << _job->reply()->errorString()
+                                           << _job->parseError().errorString();
+        if (httpStatus == 404 || httpStatus == 405 || httpStatus == 501) {
+            // the server advertised the feature but does not provide the endpoint
+            _propagator->_bulkUploadUnavailable = true;
+        }
+        for (auto *member : members) {
+            member->bundleFailed();
+        }
+    } else {
+        const auto &data = _job->data();
+        for (auto *member : members) {
+            member->bundleFinished(data.value(_propagator->fullRemotePath(member->item()->_file)).toObject());
+        }
+    }
+    deleteLater();
+}
+
+PropagateUploadFileBundled::PropagateUploadFileBundled(OwncloudPropagator *propagator, const SyncFileItemPtr &item, UploadBundle *bundle)
+    : PropagateUploadFileV1(propagator, item)
+    , _bundle(bundle)
+{
+    _bundle->addMember(this);
+    // leave the bundle if we fail before it was sent
+    connect(this, &PropagatorJob::finished, this, [this] {
+        if (_bundle) {
+            _bundle->removeMember(this);
+        }
+    });
+}
+
+void PropagateUploadFileBundled::doStartUpload()
+{
+    if (!_bundle) {
+        PropagateUploadFileV1::doStartUpload();
+        return;
+    }
+    propagator()->reportProgress(*_item, 0);
+    _bundle->memberReady(this);
+}
+
+void PropagateUploadFileBundled::bundleFinished(const QJsonObject &result)
+{
+    _bundle.clear();
+    if (result.isEmpty() || result.value(QStringLiteral("error")).toBool()) {
+        const QString message = result.value(QStringLiteral("message")).toString();
+        done(SyncFileItem::NormalError, message.isEmpty() ? tr("The server did not accept the file") : message);
+        return;
+    }
+
+    // Check the file again post upload, it is on the server already so we only need another sync
+    const QString fullFilePath(propagator()->fullLocalPath(_item->_file));
+    if (!FileSystem::fileExists(fullFilePath) || FileSystem::fileChanged(QFileInfo{fullFilePath}, _item->_size, _item->_modtime)) {
+        propagator()->_anotherSyncNeeded = true;
+    }
+
+    const QByteArray fid = result.value(QStringLiteral("fileid")).toString().toUtf8();
+    if (!fid.isEmpty()) {
+        _item->_fileId = fid;
+    }
+    _item->_etag = Utility::normalizeEtag(result.value(QStringLiteral("etag")).toString());
+    const QString permissions = result.value(QStringLiteral("permissions")).toString();
+    if (!permissions.isEmpty()) {
+        _item->_remotePerm = RemotePermissions::fromServerString(permissions);
+    }
+    _finished = true;
+    propagator()->reportProgress(*_item, _item->_size);
+    finalize();
+}
+
+void PropagateUploadFileBundled::bundleFailed()
+{
+    _bundle.clear();
+    if (propagator()->_abortRequested) {
+        return;
+    }
+    PropagateUploadFileV1::doStartUpload();
+}
+
+void PropagateUploadFileBundled::bundleFileChanged()
+{
+    _bundle.clear();
+    propagator()->_anotherSyncNeeded = true;
+    done(SyncFileItem::Message, fileChangedMessage());
+}
+
+void PropagateUploadFileBundled::abort(PropagatorJob::AbortType abortType)
+{
+    if (_bundle) {
+        _bundle->removeMember(this);
+        _bundle.clear();
+    }
+    PropagateUploadFileV1::abort(abortType);
+}
+
+}
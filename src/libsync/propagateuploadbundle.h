@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "propagateupload.h"
+
+#include <QPointer>
+
+namespace OCC {
+Q_DECLARE_LOGGING_CATEGORY(lcPropagateUploadBundle)
+
+class JsonJob;
+class PropagateUploadFileBundled;
+
+/**
+ * @brief Uploads several small files with a single bulk request
+ * @ingroup libsync
+ *
+ * Members join the bundle when they are created and report when their
+ * checksums are computed. Once all members are ready, or the bundle is full,
+ * one multipart request is sent and the per file results are handed back
+ * to the members which then finalize like a regular upload.
+ *
+ * If the request as a whole fails, all members fall back to single PUTs.
+ */
+class UploadBundle : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UploadBundle(OwncloudPropagator *propagator);
+
+    /** Whether \a item can still be added to this bundle */
+    bool accepts(const SyncFileItem &item) const;
+
+    void addMember(PropagateUploadFileBundled *member);
+    void memberReady(PropagateUploadFileBundled *member);
+    void removeMember(PropagateUploadFileBundled *member);
+
+private:
+    /** The content of a member, read away from the main thread */
+    struct Part
+    {
+        QString error;
+        QByteArray data;
+        QByteArray md5;
+    };
+
+    void maybeSend();
+    void send();
+    void sendParts(const QVector<QPointer<PropagateUploadFileBundled>> &members, const QVector<Part> &parts);
+    void slotFinished();
+
+    OwncloudPropagator *_propagator;
+    QVector<PropagateUploadFileBundled *> _members;
+    QSet<PropagateUploadFileBundled *> _readyMembers;
+    qint64 _size = 0;
+    bool _sendScheduled = false;
+    bool _sent = false;
+    QPointer<JsonJob> _job;
+
+    // While the request is running it takes one slot in _activeJobList
+    QPointer<PropagateUploadFileBundled> _activeJobSlot;
+};
+
+/**
+ * @ingroup libsync
+ *
+ * Upload of a small file as part of an UploadBundle
+ */
+class PropagateUploadFileBundled : public PropagateUploadFileV1
+{
+    Q_OBJECT
+
+public:
+    PropagateUploadFileBundled(OwncloudPropagator *propagator, const SyncFileItemPtr &item, UploadBundle *bundle);
+
+    void doStartUpload() override;
+
+    const QByteArray &transmissionChecksumHeader() const { return _transmissionChecksumHeader; }
+
+    /** The bundle was sent successfully, \a result is this file's part of the reply */
+    void bundleFinished(const QJsonObject &result);
+
+    /** The bundle could not be sent, upload the file on its own */
+    void bundleFailed();
+
+    /** The file changed after its checksum was computed, it is not uploaded */
+    void bundleFileChanged();
+
+public Q_SLOTS:
+    void abort(PropagatorJob::AbortType abortType) override;
+
+private:
+    QPointer<UploadBundle> _bundle;
+};
+
+}
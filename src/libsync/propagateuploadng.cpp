@@ -23,20 +23,20 @@
 #include "propagateupload.h"
 #include "propagatorjobs.h"
 #include "syncengine.h"
+#include "uploadchunklisting.h"
 
 #include <QDir>
 #include <QFileInfo>
 #include <QRandomGenerator>
 
 #include <memory>
+#include <numeric>
 
 namespace OCC {
 
 QString PropagateUploadFileNG::chunkPath(qint64 chunkOffset)
 {
-    QString path = QLatin1String("remote.php/dav/uploads/")
-        + propagator()->account()->davUser()
-        + QLatin1Char('/') + QString::number(_transferId);
+    QString path = UploadChunkListing::uploadsPath(propagator()->account()) + QLatin1Char('/') + QString::number(_transferId);
     if (chunkOffset != -1) {
         // We need to do add leading 0 because the server orders the chunk alphabetically
         path += QLatin1Char('/') + QString::number(chunkOffset).rightJustified(16, QLatin1Char('0')); // 1e16 is 10 petabyte
@@ -84,15 +84,6 @@ PropagateUploadFileNG::PropagateUploadFileNG(OwncloudPropagator *propagator, con
 }
 void PropagateUploadFileNG::doStartUpload()
 {
-    const QString fileName = propagator()->fullLocalPath(_item->_file);
-    // If the file is currently locked, we want to retry the sync
-    // when it becomes available again.
-    if (FileSystem::isFileLocked(fileName, FileSystem::LockMode::SharedRead)) {
-        Q_EMIT propagator()->seenLockedFile(fileName, FileSystem::LockMode::SharedRead);
-        abortWithError(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(QDir::toNativeSeparators(fileName)));
-        return;
-    }
-
     propagator()->_activeJobList.append(this);
 
     UploadRangeInfo rangeinfo = { 0, _item->_size };
@@ -107,6 +98,36 @@ void PropagateUploadFileNG::doStartUploadNext()
     const SyncJournalDb::UploadInfo progressInfo = propagator()->_journal->getUploadInfo(_item->_file);
     if (progressInfo.isChunked() && progressInfo.validate(_item->_size, _item->_modtime, _item->_checksumHeader)) {
         _transferId = progressInfo._transferid;
+        if (auto listing = propagator()->uploadChunkListing()) {
+            if (!listing->isFinished()) {
+                connect(
+                    listing, &UploadChunkListing::finished, this,
+                    [this] {
+                        if (!propagator()->_abortRequested) {
+                            doStartUploadNext();
+                        }
+                    },
+                    Qt::SingleShotConnection);
+                return;
+            }
+            if (listing->isValid()) {
+                if (!listing->exists(_transferId)) {
+                    qCInfo(lcPropagateUploadNG) << "The transfer" << _transferId << "of" << _item->_file << "is gone, starting a new upload";
+                    startNewUpload();
+                    return;
+                }
+                const auto chunks = listing->chunks(_transferId);
+                for (auto it = chunks.cbegin(); it != chunks.cend(); ++it) {
+                    bool ok = false;
+                    const qint64 chunkOffset = it.key().toLongLong(&ok);
+                    if (ok) {
+                        _serverChunks[chunkOffset] = {it.value(), it.key()};
+                    }
+                }
+                slotPropfindFinished();
+                return;
+            }
+        }
         auto job = new PropfindJob(propagator()->account(), propagator()->account()->url(), chunkPath(), PropfindJob::Depth::One, this);
         addChildJob(job);
         job->setProperties({ QByteArrayLiteral("resourcetype"), QByteArrayLiteral("getcontentlength") });
@@ -166,7 +187,6 @@ void PropagateUploadFileNG::slotPropfindFinished()
 {
     propagator()->_activeJobList.removeOne(this);
 
-    _currentChunkOffset = 0;
     _sent = 0;
 
     // here is a copy because we might need to remove item(s) during iteration
@@ -322,7 +342,7 @@ void PropagateUploadFileNG::slotMkColFinished()
 void PropagateUploadFileNG::doFinalMove()
 {
     // Still not finished all ranges.
-    if (!_rangesToUpload.isEmpty())
+    if (!_rangesToUpload.isEmpty() || !_runningChunks.isEmpty())
         return;
     Q_ASSERT_X(childJobs().empty(), Q_FUNC_INFO, "MOVE for upload even though jobs are still running");
 
@@ -368,30 +388,37 @@ void PropagateUploadFileNG::startNextChunk()
         return;
     }
 
-    _currentChunkOffset = _rangesToUpload.first().start;
-    _currentChunkSize = qMin(propagator()->_chunkSize, _rangesToUpload.first().size);
+    const UploadRangeInfo chunk = {_rangesToUpload.first().start, qMin(propagator()->chunkSize(), _rangesToUpload.first().size)};
 
-    const QString fileName = propagator()->fullLocalPath(_item->_file);
-    auto device = std::make_unique<UploadDevice>(fileName, _currentChunkOffset, _currentChunkSize,
-        propagator()->_bandwidthManager);
+    const QString fileName = uploadSourcePath();
+    auto device = std::make_unique<UploadDevice>(fileName, chunk.start, chunk.size, propagator()->_bandwidthManager);
     if (!device->open(QIODevice::ReadOnly)) {
-        qCWarning(lcPropagateUploadNG) << "Could not prepare upload device: " << device->errorString();
-        // Soft error because this is likely caused by the user modifying his files while syncing
-        abortWithError(SyncFileItem::SoftError, device->errorString());
+        abortWithOpenError(*device);
         return;
     }
 
     // job takes ownership of device via a QScopedPointer. Job deletes itself when finishing
     auto devicePtr = device.get(); // for connections later
-    PUTFileJob *job = new PUTFileJob(propagator()->account(), propagator()->account()->url(), chunkPath(_currentChunkOffset), std::move(device), {}, 0, this);
+    PUTFileJob *job = new PUTFileJob(propagator()->account(), propagator()->account()->url(), chunkPath(chunk.start), std::move(device), {}, 0, this);
     addChildJob(job);
     connect(job, &PUTFileJob::finishedSignal, this, &PropagateUploadFileNG::slotPutFinished);
     connect(job, &PUTFileJob::uploadProgress,
         this, &PropagateUploadFileNG::slotUploadProgress);
     connect(job, &PUTFileJob::uploadProgress,
         devicePtr, &UploadDevice::slotJobUploadProgress);
+
+    // the next chunk starts after this one, even before this one is done
+    markRangeAsDone(chunk.start, chunk.size);
+    _runningChunks.insert(job, {chunk});
     job->start();
     propagator()->_activeJobList.append(this);
+
+    // The chunks are independent requests, an interrupted upload resumes
+    // with the chunks the server has from the start of the file.
+    if (parallelChunkUploadEnabled() && !_rangesToUpload.isEmpty() && _runningChunks.size() < propagator()->syncOptions()._parallelChunkUploads
+        && propagator()->_activeJobList.count() < propagator()->maximumActiveTransferJob()) {
+        startNextChunk();
+    }
 }
 
 void PropagateUploadFileNG::slotPutFinished()
@@ -404,6 +431,9 @@ void PropagateUploadFileNG::slotPutFinished()
     _item->_requestId = job->requestId();
 
     propagator()->_activeJobList.removeOne(this);
+    propagator()->reportTransferSample(job, job->device()->size());
+    propagator()->recordRequest(_item->_file, job, job->device()->size());
+    const auto chunk = _runningChunks.take(job).range;
 
     if (_finished) {
         // We have sent the finished signal already. We don't need to handle any remaining jobs
@@ -417,45 +447,21 @@ void PropagateUploadFileNG::slotPutFinished()
         return;
     }
 
-    // Mark the range as uploaded
-    markRangeAsDone(_currentChunkOffset, _currentChunkSize);
-    _sent += _currentChunkSize;
+    // The range was already marked as uploaded when the chunk was started
+    _sent += chunk.size;
 
     OC_ENFORCE_X(_sent <= _bytesToUpload, "can't send more than size");
 
     // Adjust the chunk size for the time taken.
     //
-    // Dynamic chunk sizing is enabled if the server configured a
-    // target duration for each chunk upload.
-    auto targetDuration = propagator()->syncOptions()._targetChunkUploadDuration;
-    if (targetDuration.count() > 0) {
-        auto uploadTime = ++job->msSinceStart(); // add one to avoid div-by-zero
-        qint64 predictedGoodSize = (_currentChunkSize * targetDuration) / uploadTime;
-
-        // The whole targeting is heuristic. The predictedGoodSize will fluctuate
-        // quite a bit because of external factors (like available bandwidth)
-        // and internal factors (like number of parallel uploads).
-        //
-        // We use an exponential moving average here as a cheap way of smoothing
-        // the chunk sizes a bit.
-        qint64 targetSize = propagator()->_chunkSize / 2 + predictedGoodSize / 2;
-
-        // Adjust the dynamic chunk size _chunkSize used for sizing of the item's chunks to be send
-        propagator()->_chunkSize = qBound(
-            propagator()->syncOptions()._minChunkSize,
-            targetSize,
-            propagator()->syncOptions()._maxChunkSize);
-
-        qCInfo(lcPropagateUploadNG) << "Chunked upload of" << _currentChunkSize << "bytes took" << uploadTime.count()
-                                  << "ms, desired is" << targetDuration.count() << "ms, expected good chunk size is"
-                                  << predictedGoodSize << "bytes and nudged next chunk size to "
-                                  << propagator()->_chunkSize << "bytes";
-    }
+    // Dynamic chunk sizing is enabled if a target duration for each
+    // chunk upload is configured.
+    propagator()->reportChunkSample(chunk.size, job->msSinceStart());
 
     _finished = _sent == _bytesToUpload;
 
     // Check if the file still exists
-    const QString fullFilePath(propagator()->fullLocalPath(_item->_file));
+    const QString fullFilePath(uploadSourcePath());
     if (!FileSystem::fileExists(fullFilePath)) {
         if (!_finished) {
             abortWithError(SyncFileItem::SoftError, tr("The local file was removed during sync."));
@@ -545,7 +551,15 @@ void PropagateUploadFileNG::slotUploadProgress(qint64 sent, qint64 total)
     if (sent == 0 && total == 0) {
         return;
     }
-    propagator()->reportProgress(*_item, _sent + sent);
+    auto it = _runningChunks.find(qobject_cast<PUTFileJob *>(sender()));
+    if (it == _runningChunks.end()) {
+        return;
+    }
+    it->sent = sent;
+    const qint64 running = std::accumulate(_runningChunks.cbegin(), _runningChunks.cend(), qint64(0), [](qint64 sum, const RunningChunk &chunk) {
+        return sum + chunk.sent;
+    });
+    propagator()->reportProgress(*_item, _sent + running);
 }
 
 void PropagateUploadFileNG::abort(PropagatorJob::AbortType abortType)
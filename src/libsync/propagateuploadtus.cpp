@@ -13,6 +13,7 @@
  */
 
 #include "propagateuploadtus.h"
+#include "accessmanager.h"
 #include "account.h"
 #include "capabilities.h"
 #include "common/asserts.h"
@@ -52,20 +53,9 @@ Q_LOGGING_CATEGORY(lcPropagateUploadTUS, "sync.propagator.upload.tus", QtDebugMs
 
 UploadDevice *PropagateUploadFileTUS::prepareDevice(const quint64 &chunkSize)
 {
-    const QString localFileName = propagator()->fullLocalPath(_item->_file);
-    // If the file is currently locked, we want to retry the sync
-    // when it becomes available again.
-    if (FileSystem::isFileLocked(localFileName, FileSystem::LockMode::SharedRead)) {
-        Q_EMIT propagator()->seenLockedFile(localFileName, FileSystem::LockMode::SharedRead);
-        abortWithError(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(localFileName));
-        return nullptr;
-    }
-    auto device = std::make_unique<UploadDevice>(localFileName, _currentOffset, chunkSize, propagator()->_bandwidthManager);
+    auto device = std::make_unique<UploadDevice>(uploadSourcePath(), _currentOffset, chunkSize, propagator()->_bandwidthManager);
     if (!device->open(QIODevice::ReadOnly)) {
-        qCWarning(lcPropagateUploadTUS) << "Could not prepare upload device: " << device->errorString();
-
-        // Soft error because this is likely caused by the user modifying his files while syncing
-        abortWithError(SyncFileItem::SoftError, device->errorString());
+        abortWithOpenError(*device);
         return nullptr;
     }
     return device.release();
@@ -102,6 +92,7 @@ QNetworkRequest PropagateUploadFileTUS::prepareRequest(const quint64 &chunkSize)
     request.setHeader(QNetworkRequest::ContentLengthHeader, QByteArray::number(chunkSize));
     request.setRawHeader(uploadOffset(), QByteArray::number(_currentOffset));
     setTusVersionHeader(request);
+    request.setAttribute(AccessManager::TransferAttribute, true);
     return request;
 }
 
@@ -138,6 +129,10 @@ void PropagateUploadFileTUS::startNextChunk()
 
     const quint64 chunkSize = [&] {
         auto chunkSize = _item->_size - _currentOffset;
+        // without a target duration the whole file is sent in one request
+        if (propagator()->syncOptions()._targetChunkUploadDuration.count() > 0) {
+            chunkSize = std::min<qint64>(chunkSize, propagator()->chunkSize());
+        }
         if (propagator()->account()->capabilities().tusSupport().max_chunk_size) {
             chunkSize = std::min<qint64>(chunkSize, propagator()->account()->capabilities().tusSupport().max_chunk_size);
         }
@@ -161,6 +156,7 @@ void PropagateUploadFileTUS::startNextChunk()
     }
 
     job->setPriority(QNetworkRequest::LowPriority);
+    job->setRequestClass(JobQueue::RequestClass::Transfer);
     qCDebug(lcPropagateUploadTUS) << "Offset:" << _currentOffset << _currentOffset  / (_item->_size + 1) * 100
                                   << "Chunk:" << chunkSize << chunkSize / (_item->_size + 1) * 100;
 
@@ -186,7 +182,12 @@ void PropagateUploadFileTUS::slotChunkFinished()
     _item->_requestId = job->requestId();
 
     QNetworkReply::NetworkError err = job->reply()->error();
+    const bool isTransfer = HttpLogger::requestVerb(*job->reply()) != "HEAD";
     if (err != QNetworkReply::NoError) {
+        if (isTransfer) {
+            propagator()->reportTransferSample(job, 0);
+            propagator()->recordRequest(_item->_file, job, 0);
+        }
         // try to get the offset if possible, only try once
         if (err == QNetworkReply::TimeoutError && !_location.isEmpty() && HttpLogger::requestVerb(*job->reply())  != "HEAD")
         {
@@ -205,6 +206,11 @@ void PropagateUploadFileTUS::slotChunkFinished()
     }
 
     const qint64 offset = job->reply()->rawHeader(uploadOffset()).toLongLong();
+    if (isTransfer) {
+        propagator()->reportTransferSample(job, offset - static_cast<qint64>(_currentOffset));
+        propagator()->recordRequest(_item->_file, job, offset - static_cast<qint64>(_currentOffset));
+        propagator()->reportChunkSample(offset - static_cast<qint64>(_currentOffset), job->duration());
+    }
     propagator()->reportProgress(*_item, offset);
     _currentOffset = offset;
     // first response after a POST request
@@ -216,7 +222,7 @@ void PropagateUploadFileTUS::slotChunkFinished()
     _finished = offset == _item->_size;
 
     // Check if the file still exists
-    const QString fullFilePath(propagator()->fullLocalPath(_item->_file));
+    const QString fullFilePath(uploadSourcePath());
     if (!FileSystem::fileExists(fullFilePath)) {
         if (!_finished) {
             abortWithError(SyncFileItem::SoftError, tr("The local file was removed during sync."));
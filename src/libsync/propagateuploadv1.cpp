@@ -34,15 +34,6 @@ namespace OCC {
 
 void PropagateUploadFileV1::doStartUpload()
 {
-    const QString fileName = propagator()->fullLocalPath(_item->_file);
-    // If the file is currently locked, we want to retry the sync
-    // when it becomes available again.
-    if (FileSystem::isFileLocked(fileName, FileSystem::LockMode::SharedRead)) {
-        Q_EMIT propagator()->seenLockedFile(fileName, FileSystem::LockMode::SharedRead);
-        abortWithError(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(QDir::toNativeSeparators(fileName)));
-        return;
-    }
-
     if (!propagator()->account()->capabilities().bigfilechunkingEnabled()) {
         _chunkCount = 1;
     } else {
@@ -127,13 +118,11 @@ void PropagateUploadFileV1::startNextChunk()
         headers[checkSumHeaderC] = _transmissionChecksumHeader;
     }
 
-    const QString fileName = propagator()->fullLocalPath(_item->_file);
+    const QString fileName = uploadSourcePath();
     auto device = std::make_unique<UploadDevice>(fileName, chunkStart, currentChunkSize,
         propagator()->_bandwidthManager);
     if (!device->open(QIODevice::ReadOnly)) {
-        qCWarning(lcPropagateUploadV1) << "Could not prepare upload device: " << device->errorString();
-        // Soft error because this is likely caused by the user modifying his files while syncing
-        abortWithError(SyncFileItem::SoftError, device->errorString());
+        abortWithOpenError(*device);
         return;
     }
 
@@ -150,21 +139,7 @@ void PropagateUploadFileV1::startNextChunk()
     propagator()->_activeJobList.append(this);
     _currentChunk++;
 
-    bool parallelChunkUpload = true;
-
-    if (propagator()->account()->capabilities().chunkingParallelUploadDisabled()) {
-        // Server may also disable parallel chunked upload for any higher version
-        parallelChunkUpload = false;
-    } else {
-        static bool envEnabled = [] {
-            const auto env = qEnvironmentVariable("OWNCLOUD_PARALLEL_CHUNK");
-            if (!env.isEmpty()) {
-                return env != QLatin1String("false") && env != QLatin1String("0");
-            }
-            return true;
-        }();
-        parallelChunkUpload = envEnabled;
-    }
+    bool parallelChunkUpload = parallelChunkUploadEnabled();
 
 
     if (_currentChunk + _startChunk >= _chunkCount - 1) {
@@ -188,6 +163,8 @@ void PropagateUploadFileV1::slotPutFinished()
     Q_ASSERT(job);
 
     propagator()->_activeJobList.removeOne(this);
+    propagator()->reportTransferSample(job, job->device()->size());
+    propagator()->recordRequest(_item->_file, job, job->device()->size());
 
     if (_finished) {
         // We have sent the finished signal already. We don't need to handle any remaining jobs
@@ -221,7 +198,7 @@ void PropagateUploadFileV1::slotPutFinished()
     _finished = etag.length() > 0;
 
     // Check if the file still exists
-    const QString fullFilePath(propagator()->fullLocalPath(_item->_file));
+    const QString fullFilePath(uploadSourcePath());
     if (!FileSystem::fileExists(fullFilePath)) {
         if (!_finished) {
             abortWithError(SyncFileItem::SoftError, tr("The local file was removed during sync."));
@@ -20,6 +20,7 @@
 #include "owncloudpropagator.h"
 #include "owncloudpropagator_p.h"
 #include "propagateremotemove.h"
+#include "theme.h"
 #include <QCoreApplication>
 #include <QDateTime>
 #include <qdir.h>
@@ -36,6 +37,7 @@ namespace OCC {
 Q_LOGGING_CATEGORY(lcPropagateLocalRemove, "sync.propagator.localremove", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateLocalMkdir, "sync.propagator.localmkdir", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateLocalRename, "sync.propagator.localrename", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcPropagateItemsBulk, "sync.propagator.itemsbulk", QtInfoMsg)
 
 /**
  * The code will update the database in case of error.
@@ -45,22 +47,67 @@ Q_LOGGING_CATEGORY(lcPropagateLocalRename, "sync.propagator.localrename", QtInfo
  *
  * \a path is relative to propagator()->_localDir + _item->_file and should start with a slash
  */
-bool PropagateLocalRemove::removeRecursively(const QString &absolute)
+void PropagateLocalRemove::start()
 {
-    FileSystem::RemoveEntryList removed;
-    FileSystem::RemoveEntryList locked;
-    FileSystem::RemoveErrorList errors;
-    const bool success = FileSystem::removeRecursively(
-        absolute,
-        &removed,
-        &locked,
-        &errors);
-
-    if (!success) {
+    _moveToTrash = propagator()->syncOptions()._moveFilesToTrash;
+
+    if (propagator()->_abortRequested)
+        return;
+
+    const QString filename = propagator()->fullLocalPath(_item->_file);
+    qCDebug(lcPropagateLocalRemove) << filename;
+
+    if (auto clash = propagator()->localFileNameClash(_item->_file)) {
+        done(SyncFileItem::NormalError, tr("Could not remove %1 because of a local file name clash with %2!").arg(QDir::toNativeSeparators(filename), QDir::toNativeSeparators(clash.get())));
+        return;
+    }
+
+    if (!FileSystem::fileExists(filename)) {
+        slotRemoved({true});
+        return;
+    }
+    if (FileSystem::isFileLocked(filename, FileSystem::LockMode::Exclusive)) {
+        Q_EMIT propagator()->seenLockedFile(filename, FileSystem::LockMode::Exclusive);
+        done(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(QDir::toNativeSeparators(filename)));
+        return;
+    }
+
+    if (!_moveToTrash && !_item->isDirectory()) {
+        QString removeError;
+        if (!FileSystem::remove(filename, &removeError)) {
+            done(SyncFileItem::NormalError, removeError);
+            return;
+        }
+        slotRemoved({true});
+        return;
+    }
+
+    // Removing a tree or moving it to the trash can take a while, don't block the event loop
+    runLocalIo(
+        [filename, moveToTrash = _moveToTrash, isDirectory = _item->isDirectory()] {
+            RemoveResult result;
+            if (moveToTrash) {
+                result.success = QFile(filename).moveToTrash();
+            } else if (isDirectory) {
+                result.success = FileSystem::removeRecursively(filename, &result.removed, &result.locked, &result.errors);
+            }
+            return result;
+        },
+        [this](const RemoveResult &result) { slotRemoved(result); });
+}
+
+void PropagateLocalRemove::slotRemoved(const RemoveResult &result)
+{
+    const QString filename = propagator()->fullLocalPath(_item->_file);
+    if (!result.success) {
+        if (_moveToTrash) {
+            done(SyncFileItem::NormalError, tr("Could not move '%1' to the trash bin").arg(filename));
+            return;
+        }
         // We need to delete the entries from the database now from the deleted vector.
         // Do it while avoiding redundant delete calls to the journal.
         QString deletedDir;
-        for (const auto &it : std::as_const(removed)) {
+        for (const auto &it : result.removed) {
             if (!it.path.startsWith(propagator()->localPath()))
                 continue;
             if (!deletedDir.isEmpty() && it.path.startsWith(deletedDir))
@@ -70,72 +117,24 @@ bool PropagateLocalRemove::removeRecursively(const QString &absolute)
             }
             propagator()->_journal->deleteFileRecord(it.path.mid(propagator()->localPath().size()), it.isDir);
         }
-        if (!errors.empty()) {
+        if (!result.errors.empty()) {
             QStringList errorList;
-            errorList.reserve(errors.size());
-            for (const auto &err : errors) {
+            errorList.reserve(result.errors.size());
+            for (const auto &err : result.errors) {
                 errorList.append(tr("%1 failed with: %2").arg(QDir::toNativeSeparators(err.entry.path), err.error));
             }
             done(SyncFileItem::NormalError, errorList.join(QStringLiteral(", ")));
-            return false;
-        } else if (!locked.empty()) {
+        } else {
             QStringList errorList;
-            errorList.reserve(errors.size());
-            for (const auto &l : locked) {
+            errorList.reserve(result.locked.size());
+            for (const auto &l : result.locked) {
                 // unlock is handled in hack in `void Folder::slotWatchedPathChanged`
                 Q_EMIT propagator()->seenLockedFile(l.path, FileSystem::LockMode::Exclusive);
                 errorList.append(tr("%1 the file is currently in use").arg(QDir::toNativeSeparators(l.path)));
             }
             done(SyncFileItem::SoftError, errorList.join(QStringLiteral(", ")));
-            return false;
         }
-    }
-    return success;
-}
-
-void PropagateLocalRemove::start()
-{
-    _moveToTrash = propagator()->syncOptions()._moveFilesToTrash;
-
-    if (propagator()->_abortRequested)
         return;
-
-    const QString filename = propagator()->fullLocalPath(_item->_file);
-    qCDebug(lcPropagateLocalRemove) << filename;
-
-    if (auto clash = propagator()->localFileNameClash(_item->_file)) {
-        done(SyncFileItem::NormalError, tr("Could not remove %1 because of a local file name clash with %2!").arg(QDir::toNativeSeparators(filename), QDir::toNativeSeparators(clash.get())));
-        return;
-    }
-
-    if (FileSystem::fileExists(filename)) {
-        if (FileSystem::isFileLocked(filename, FileSystem::LockMode::Exclusive)) {
-            Q_EMIT propagator()->seenLockedFile(filename, FileSystem::LockMode::Exclusive);
-            done(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(QDir::toNativeSeparators(filename)));
-            return;
-        }
-
-        bool ok = false;
-        QString removeError;
-        if (_moveToTrash) {
-            ok = QFile(filename).moveToTrash();
-            if (!ok) {
-                removeError = tr("Could not move '%1' to the trash bin").arg(filename);
-            }
-        } else {
-            if (_item->isDirectory()) {
-                // removeRecursively will call done on error
-                if (!(ok = removeRecursively(filename))) {
-                    return;
-                }
-            } else {
-                ok = FileSystem::remove(filename, &removeError);
-            }
-        }
-        if (!ok) {
-            done(SyncFileItem::NormalError, removeError);
-            return;
-        }
     }
     propagator()->reportProgress(*_item, 0);
     propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
@@ -179,11 +178,18 @@ void PropagateLocalMkdir::start()
         return;
     }
 
-    if (!FileSystem::mkpath(propagator()->localPath(), _item->_file)) {
-        done(SyncFileItem::NormalError, tr("could not create folder %1").arg(newDirStr));
-        return;
-    }
+    runLocalIo([localPath = propagator()->localPath(), file = _item->_file] { return FileSystem::mkpath(localPath, file); },
+        [this, newDirStr](bool created) {
+            if (!created) {
+                done(SyncFileItem::NormalError, tr("could not create folder %1").arg(newDirStr));
+                return;
+            }
+            slotCreated();
+        });
+}
 
+void PropagateLocalMkdir::slotCreated()
+{
     // Insert the directory into the database. The correct etag will be set later,
     // once all contents have been propagated, because should_update_metadata is true.
     // Adding an entry with a dummy etag to the database still makes sense here
@@ -237,18 +243,42 @@ void PropagateLocalRename::start()
                         QDir::toNativeSeparators(_item->_renameTarget)));
             return;
         }
-        if (FileSystem::isFileLocked(existingFile, FileSystem::LockMode::Exclusive)) {
-            Q_EMIT propagator()->seenLockedFile(existingFile, FileSystem::LockMode::Exclusive);
-            done(SyncFileItem::SoftError, tr("Could not rename %1 to %2, the file is currently in use").arg(existingFile, targetFile));
-            return;
-        }
-        QString renameError;
-        if (!FileSystem::rename(existingFile, targetFile, &renameError)) {
-            done(SyncFileItem::NormalError, renameError);
-            return;
-        }
+        runLocalIo(
+            [existingFile, targetFile, isDirectory = _item->isDirectory()] {
+                RenameResult result;
+                result.success = FileSystem::rename(existingFile, targetFile, &result.error);
+                // Only look for locks once the rename failed, probing each rename up front is slow.
+                // A folder can't be renamed while a file in it is in use, probe them all at once.
+                if (!result.success) {
+                    if (isDirectory) {
+                        result.locked = FileSystem::lockedFiles(existingFile, FileSystem::LockMode::Exclusive);
+                    } else if (FileSystem::isFileLocked(existingFile, FileSystem::LockMode::Exclusive)) {
+                        result.locked.append(existingFile);
+                    }
+                }
+                return result;
+            },
+            [this, existingFile, targetFile](const RenameResult &result) {
+                if (!result.locked.isEmpty()) {
+                    for (const auto &path : result.locked) {
+                        Q_EMIT propagator()->seenLockedFile(path, FileSystem::LockMode::Exclusive);
+                    }
+                    done(SyncFileItem::SoftError, tr("Could not rename %1 to %2, the file is currently in use").arg(existingFile, targetFile));
+                    return;
+                }
+                if (!result.success) {
+                    done(SyncFileItem::NormalError, result.error);
+                    return;
+                }
+                slotRenamed();
+            });
+        return;
     }
+    slotRenamed();
+}
 
+void PropagateLocalRename::slotRenamed()
+{
     SyncJournalFileRecord oldRecord;
     propagator()->_journal->getFileRecord(_item->_originalFile, &oldRecord);
     propagator()->_journal->deleteFileRecord(_item->_originalFile);
@@ -289,4 +319,99 @@ void PropagateLocalRename::start()
 
     done(SyncFileItem::Success);
 }
+
+void PropagateNewPlaceholder::start()
+{
+    // do a klaas' case clash check.
+    if (auto clash = propagator()->localFileNameClash(_item->_file)) {
+        done(SyncFileItem::NormalError,
+            tr("File %1 can not be downloaded because of a local file name clash with %2!")
+                .arg(QDir::toNativeSeparators(_item->_file), QDir::toNativeSeparators(clash.get())));
+        return;
+    }
+    const auto placeholder = propagator()->syncOptions()._vfs->createPlaceholder(*_item);
+    if (!placeholder) {
+        done(SyncFileItem::NormalError, placeholder.error());
+        return;
+    }
+    const auto result = propagator()->updateMetadata(*_item);
+    if (!result) {
+        done(SyncFileItem::FatalError, tr("Error updating metadata: %1").arg(result.error()));
+        return;
+    } else if (result.get() == Vfs::ConvertToPlaceholderResult::Locked) {
+        done(SyncFileItem::SoftError, tr("The file %1 is currently in use").arg(_item->_file));
+        return;
+    }
+    propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+    done(SyncFileItem::Success);
+}
+
+namespace {
+// Limits the time a bulk blocks the event loop
+constexpr int MaximumBulkItems = 500;
+}
+
+PropagateItemsBulk::PropagateItemsBulk(OwncloudPropagator *propagator, const QString &path)
+    : PropagatorJob(propagator, path)
+{
+}
+
+bool PropagateItemsBulk::accepts(OwncloudPropagator *propagator, const SyncFileItem &item)
+{
+    if (item.instruction() == CSYNC_INSTRUCTION_UPDATE_METADATA) {
+        // the directories are PropagateDirectory jobs
+        return !item.isDirectory();
+    }
+    // conflicts and type changes need the handling of PropagateDownloadFile
+    return item.instruction() == CSYNC_INSTRUCTION_NEW && item._type == ItemTypeVirtualFile && item._direction == SyncFileItem::Down
+        && propagator->syncOptions()._vfs->mode() == Vfs::WithSuffix
+        // the recall files are handled in PropagateDownloadFile
+        && !Theme::instance()->enableCernBranding();
+}
+
+bool PropagateItemsBulk::isFull() const
+{
+    return _items.size() >= MaximumBulkItems;
+}
+
+void PropagateItemsBulk::addItem(const SyncFileItemPtr &item)
+{
+    Q_ASSERT(!isFull() && state() == NotYetStarted);
+    _items.append(item);
+}
+
+bool PropagateItemsBulk::scheduleSelfOrChild()
+{
+    if (state() != NotYetStarted) {
+        return false;
+    }
+    setState(Running);
+    qCInfo(lcPropagateItemsBulk) << "Propagating" << _items.size() << "items in" << path();
+
+    SyncFileItem::Status status = SyncFileItem::Success;
+    for (const auto &item : std::as_const(_items)) {
+        if (propagator()->_abortRequested) {
+            status = SyncFileItem::SoftError;
+            break;
+        }
+        if (item->instruction() == CSYNC_INSTRUCTION_UPDATE_METADATA) {
+            PropagateUpdateMetaDataJob job(propagator(), item);
+            job.setState(Running);
+            job.start();
+        } else {
+            PropagateNewPlaceholder job(propagator(), item);
+            job.setState(Running);
+            job.start();
+        }
+        // the items are reported individually, the composite only needs to know about errors
+        if (item->_status != SyncFileItem::Success) {
+            status = item->_status;
+        }
+    }
+    propagator()->_journal->commit(QStringLiteral("items bulk"));
+
+    setState(Finished);
+    Q_EMIT finished(status);
+    return true;
+}
 }
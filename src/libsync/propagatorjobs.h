@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include "filesystem.h"
 #include "owncloudpropagator.h"
 #include <QFile>
 
@@ -41,8 +42,19 @@ public:
     }
     void start() override;
 
+    /** The outcome of the removal, computed on a worker thread */
+    struct RemoveResult
+    {
+        bool success = false;
+        FileSystem::RemoveEntryList removed;
+        FileSystem::RemoveEntryList locked;
+        FileSystem::RemoveErrorList errors;
+    };
+
 private:
-    bool removeRecursively(const QString &absolute);
+    /// Called on the main thread once the worker is done
+    void slotRemoved(const RemoveResult &result);
+
     bool _moveToTrash;
 };
 
@@ -70,6 +82,9 @@ public:
     void setDeleteExistingFile(bool enabled);
 
 private:
+    /// Updates the journal once the directory exists
+    void slotCreated();
+
     bool _deleteExistingFile;
 };
 
@@ -87,5 +102,65 @@ public:
     }
     void start() override;
     JobParallelism parallelism() override { return _item->isDirectory() ? WaitForFinished : FullParallelism; }
+
+    /** The outcome of the rename, computed on a worker thread */
+    struct RenameResult
+    {
+        bool success = false;
+        QString error;
+        /// The locked files that made the rename fail
+        QStringList locked;
+    };
+
+private:
+    /// Updates the journal and the pin states once the file was moved
+    void slotRenamed();
+};
+
+/**
+ * @brief Create the placeholder of a new virtual file
+ * @ingroup libsync
+ *
+ * Only run by PropagateItemsBulk, the journal commit is left to it.
+ */
+class PropagateNewPlaceholder : public PropagateItemJob
+{
+    Q_OBJECT
+public:
+    PropagateNewPlaceholder(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
+        : PropagateItemJob(propagator, item)
+    {
+    }
+    void start() override;
+};
+
+/**
+ * @brief Propagate the items of a directory that only need local work in one go
+ * @ingroup libsync
+ *
+ * On the first sync of a folder with suffix vfs every remote file becomes a new
+ * placeholder. Instead of scheduling a PropagateDownloadFile for each of them, which
+ * also commits the journal for each of them, the propagator collects them in bulks.
+ * The same goes for the metadata only updates of files, after a server migration
+ * changed all etags there is one for every file.
+ * A bulk runs the jobs of its items in one go and commits the journal once.
+ */
+class PropagateItemsBulk : public PropagatorJob
+{
+    Q_OBJECT
+public:
+    explicit PropagateItemsBulk(OwncloudPropagator *propagator, const QString &path);
+
+    /** Whether \a item can be propagated by a bulk */
+    static bool accepts(OwncloudPropagator *propagator, const SyncFileItem &item);
+
+    bool isFull() const;
+    void addItem(const SyncFileItemPtr &item);
+
+    bool scheduleSelfOrChild() override;
+    bool isLikelyFinishedQuickly() override { return true; }
+
+private:
+    QVector<SyncFileItemPtr> _items;
 };
 }
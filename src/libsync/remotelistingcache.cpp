@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "remotelistingcache.h"
+#include "account.h"
+#include "common/utility.h"
+#include "networkjobs.h"
+
+#include <QLoggingCategory>
+#include <QTimer>
+
+#include <memory>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcRemoteListingCache, "sync.remotelistingcache", QtInfoMsg)
+
+QString RemoteListingCache::key(const QUrl &url)
+{
+    return url.adjusted(QUrl::StripTrailingSlash | QUrl::NormalizePathSegments).toString();
+}
+
+std::optional<RemoteListingCache::Listing> RemoteListingCache::listing(const QUrl &url) const
+{
+    const auto it = _listings.constFind(key(url));
+    if (it == _listings.cend()) {
+        return {};
+    }
+    return *it;
+}
+
+void RemoteListingCache::insert(const QUrl &url, Listing listing)
+{
+    if (listing.etag.isEmpty()) {
+        // can't be revalidated
+        return;
+    }
+    if (_listings.size() >= MaxListings) {
+        qCInfo(lcRemoteListingCache) << "Dropping" << _listings.size() << "cached listings";
+        _listings.clear();
+    }
+    _listings.insert(key(url), std::move(listing));
+}
+
+SubfolderListingJob::SubfolderListingJob(AccountPtr account, const QUrl &baseUrl, const QString &path, QObject *parent)
+    : QObject(parent)
+    , _account(std::move(account))
+    , _baseUrl(baseUrl)
+    , _path(path)
+{
+}
+
+void SubfolderListingJob::start()
+{
+    const auto cached = _account->remoteListingCache()->listing(Utility::concatUrlPath(_baseUrl, _path));
+    if (!cached) {
+        listFolder();
+    } else if (_expectedEtag.isEmpty()) {
+        revalidate(*cached);
+    } else if (cached->etag == _expectedEtag) {
+        qCDebug(lcRemoteListingCache) << "Using the cached listing of" << _path;
+        // keep the signal asynchronous, like with a request
+        QTimer::singleShot(0, this, [this, listing = *cached] { emitListing(listing); });
+    } else {
+        listFolder();
+    }
+}
+
+void SubfolderListingJob::revalidate(const RemoteListingCache::Listing &cached)
+{
+    auto job = new PropfindJob(_account, _baseUrl, _path, PropfindJob::Depth::Zero, this);
+    job->setProperties({QByteArrayLiteral("getetag")});
+    auto etag = std::make_shared<QString>();
+    connect(job, &PropfindJob::directoryListingIterated, this, [etag](const QString &, const QMap<QString, QString> &properties) {
+        *etag = Utility::normalizeEtag(properties.value(QStringLiteral("getetag")));
+    });
+    connect(job, &PropfindJob::finishedWithError, this, [job, this] {
+        Q_EMIT finishedWithError(job);
+        deleteLater();
+    });
+    connect(job, &PropfindJob::finishedWithoutError, this, [etag, cached, this] {
+        if (*etag == cached.etag) {
+            qCDebug(lcRemoteListingCache) << "The cached listing of" << _path << "is still valid";
+            emitListing(cached);
+        } else {
+            listFolder();
+        }
+    });
+    job->start();
+}
+
+void SubfolderListingJob::listFolder()
+{
+    auto job = new PropfindJob(_account, _baseUrl, _path, PropfindJob::Depth::One, this);
+    job->setProperties({QByteArrayLiteral("resourcetype"), QByteArrayLiteral("getetag"), QByteArrayLiteral("http://owncloud.org/ns:size")});
+    auto listing = std::make_shared<RemoteListingCache::Listing>();
+    auto first = std::make_shared<bool>(true);
+    connect(job, &PropfindJob::directoryListingIterated, this, [listing, first](const QString &href, const QMap<QString, QString> &properties) {
+        const auto etag = Utility::normalizeEtag(properties.value(QStringLiteral("getetag")));
+        bool ok = false;
+        qint64 size = properties.value(QStringLiteral("size")).toLongLong(&ok);
+        if (!ok) {
+            size = -1;
+        }
+        if (std::exchange(*first, false)) {
+            // the folder itself
+            listing->etag = etag;
+            listing->size = size;
+        } else if (properties.value(QStringLiteral("resourcetype")).contains(QLatin1String("collection"))) {
+            const auto path = Utility::stripTrailingSlash(href);
+            listing->folders.append({path.mid(path.lastIndexOf(QLatin1Char('/')) + 1), etag, size});
+        }
+    });
+    connect(job, &PropfindJob::finishedWithError, this, [job, this] {
+        Q_EMIT finishedWithError(job);
+        deleteLater();
+    });
+    connect(job, &PropfindJob::finishedWithoutError, this, [listing, this] {
+        _account->remoteListingCache()->insert(Utility::concatUrlPath(_baseUrl, _path), *listing);
+        emitListing(*listing);
+    });
+    job->start();
+}
+
+void SubfolderListingJob::emitListing(const RemoteListingCache::Listing &listing)
+{
+    const QString folderHref = Utility::ensureTrailingSlash(Utility::concatUrlPath(_baseUrl, _path).path());
+    QStringList hrefs{folderHref};
+    QHash<QString, qint64> sizes;
+    QHash<QString, QString> etags;
+    if (listing.size >= 0) {
+        sizes.insert(folderHref, listing.size);
+    }
+    etags.insert(folderHref, listing.etag);
+    for (const auto &folder : listing.folders) {
+        const QString href = folderHref + folder.name + QLatin1Char('/');
+        hrefs.append(href);
+        if (folder.size >= 0) {
+            sizes.insert(href, folder.size);
+        }
+        etags.insert(href, folder.etag);
+    }
+    Q_EMIT subfoldersListed(hrefs, sizes, etags);
+    deleteLater();
+}
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "accountfwd.h"
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QObject>
+#include <QUrl>
+#include <QVector>
+
+#include <optional>
+
+namespace OCC {
+
+class PropfindJob;
+
+/**
+ * @brief The subfolders of remote folders, as last listed by the sync or the UI
+ * @ingroup libsync
+ *
+ * The selective sync widget and the folder wizard list the same remote folders
+ * the discovery of the last sync already listed. The cache lives on the Account
+ * and is keyed by the url of the folder. A listing stays valid as long as the
+ * etag of its folder doesn't change, see SubfolderListingJob.
+ *
+ * Only folders are kept, not files, so the memory stays proportional to the
+ * number of remote folders.
+ */
+class OWNCLOUDSYNC_EXPORT RemoteListingCache
+{
+public:
+    struct Folder
+    {
+        QString name;
+        QString etag;
+        /// -1 if unknown
+        qint64 size = -1;
+    };
+
+    struct Listing
+    {
+        /// the etag of the listed folder
+        QString etag;
+        qint64 size = -1;
+        QVector<Folder> folders;
+    };
+
+    /// The cached listing of the folder at \a url, if any
+    std::optional<Listing> listing(const QUrl &url) const;
+
+    /// Remember the listing of the folder at \a url, replacing an older one
+    void insert(const QUrl &url, Listing listing);
+
+    void clear() { _listings.clear(); }
+    qsizetype size() const { return _listings.size(); }
+
+    /// When the cache is full it starts over, the listings are fetched again when needed
+    static constexpr qsizetype MaxListings = 20000;
+
+private:
+    static QString key(const QUrl &url);
+
+    QHash<QString, Listing> _listings;
+};
+
+/**
+ * @brief Lists the subfolders of a remote folder, reusing the account's RemoteListingCache
+ * @ingroup libsync
+ *
+ * With an expected etag, usually the one of the entry in a fresh listing of the
+ * parent folder, a matching cached listing is used without any request. Without
+ * one a cached listing is revalidated with a depth zero PROPFIND of the folder's
+ * etag. Otherwise, or if the etag changed, the folder is listed and the cache
+ * updated.
+ *
+ * The job deletes itself once it finished.
+ */
+class OWNCLOUDSYNC_EXPORT SubfolderListingJob : public QObject
+{
+    Q_OBJECT
+public:
+    SubfolderListingJob(AccountPtr account, const QUrl &baseUrl, const QString &path, QObject *parent = nullptr);
+
+    void setExpectedEtag(const QString &etag) { _expectedEtag = etag; }
+
+    void start();
+
+Q_SIGNALS:
+    /**
+     * The hrefs of the folder and of its subfolders, like PropfindJob::directoryListingSubfolders,
+     * with the sizes and etags of the ones the server or the cache know them for.
+     */
+    void subfoldersListed(const QStringList &hrefs, const QHash<QString, qint64> &sizes, const QHash<QString, QString> &etags);
+    void finishedWithError(PropfindJob *job);
+
+private:
+    void revalidate(const RemoteListingCache::Listing &cached);
+    void listFolder();
+    void emitListing(const RemoteListingCache::Listing &listing);
+
+    AccountPtr _account;
+    QUrl _baseUrl;
+    QString _path;
+    QString _expectedEtag;
+};
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "serverevents.h"
+
+#include "account.h"
+#include "common/utility.h"
+#include "creds/abstractcredentials.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+
+using namespace std::chrono_literals;
+
+namespace {
+constexpr auto MinimumBackoff = 5s;
+constexpr auto MaximumBackoff = 5min;
+// the stream is reopened when nothing arrived for this long
+constexpr auto IdleTimeout = 10min;
+
+const auto endpointC = QStringLiteral("ocs/v2.php/apps/notifications/api/v1/notifications/sse");
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcServerEvents, "sync.serverevents", QtInfoMsg)
+
+QVector<ServerEvents::Event> ServerEvents::Parser::feed(const QByteArray &data)
+{
+    QVector<Event> events;
+    _buffer.append(data);
+    qsizetype start = 0;
+    while (true) {
+        const qsizetype end = _buffer.indexOf('\n', start);
+        if (end < 0) {
+            break;
+        }
+        QByteArray line = _buffer.mid(start, end - start);
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        parseLine(line, &events);
+        start = end + 1;
+    }
+    _buffer.remove(0, start);
+    return events;
+}
+
+void ServerEvents::Parser::parseLine(const QByteArray &line, QVector<Event> *events)
+{
+    if (line.isEmpty()) {
+        // an empty line dispatches the event
+        if (_hasData) {
+            if (_current.type.isEmpty()) {
+                _current.type = QByteArrayLiteral("message");
+            }
+            events->append(std::move(_current));
+        }
+        _current = {};
+        _hasData = false;
+        return;
+    }
+    if (line.startsWith(':')) {
+        // a comment, used as keep alive
+        return;
+    }
+    const qsizetype colon = line.indexOf(':');
+    const QByteArray field = colon < 0 ? line : line.left(colon);
+    QByteArray value = colon < 0 ? QByteArray() : line.mid(colon + 1);
+    if (value.startsWith(' ')) {
+        value.remove(0, 1);
+    }
+    if (field == "event") {
+        _current.type = value;
+    } else if (field == "data") {
+        if (_hasData) {
+            _current.data.append('\n');
+        }
+        _current.data.append(value);
+        _hasData = true;
+    } else if (field == "id") {
+        _current.id = value;
+    } else if (field == "retry") {
+        bool ok;
+        const int retry = value.toInt(&ok);
+        if (ok) {
+            _retry = std::chrono::milliseconds(retry);
+        }
+    }
+}
+
+ServerEvents::ServerEvents(Account *account)
+    : QObject(account)
+    , _account(account)
+    , _backoff(MinimumBackoff)
+{
+    _reconnectTimer.setSingleShot(true);
+    connect(&_reconnectTimer, &QTimer::timeout, this, &ServerEvents::connectToServer);
+    connect(_account, &Account::credentialsFetched, this, &ServerEvents::start);
+    if (_account->credentials() && _account->credentials()->ready()) {
+        start();
+    }
+}
+
+void ServerEvents::start()
+{
+    _running = true;
+    _backoff = MinimumBackoff;
+    if (!_reply) {
+        _reconnectTimer.stop();
+        connectToServer();
+    }
+}
+
+void ServerEvents::stop()
+{
+    _running = false;
+    _reconnectTimer.stop();
+    if (_reply) {
+        disconnect(_reply, nullptr, this, nullptr);
+        _reply->abort();
+        _reply->deleteLater();
+        _reply.clear();
+    }
+    setConnected(false);
+}
+
+QString ServerEvents::normalizedSpaceId(const QString &id)
+{
+    // item ids are <storage id>$<space id>!<opaque id>
+    return id.section(QLatin1Char('!'), 0, 0);
+}
+
+void ServerEvents::connectToServer()
+{
+    if (!_running || _reply) {
+        return;
+    }
+    if (!_account->credentials() || !_account->credentials()->ready()) {
+        // restarted by credentialsFetched
+        return;
+    }
+
+    QNetworkRequest request;
+    request.setRawHeader(QByteArrayLiteral("Accept"), QByteArrayLiteral("text/event-stream"));
+    if (!_lastEventId.isEmpty()) {
+        request.setRawHeader(QByteArrayLiteral("Last-Event-ID"), _lastEventId);
+    }
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    // the stream is open for hours, only limit the time without any data
+    request.setTransferTimeout(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(IdleTimeout).count()));
+
+    _parser = {};
+    _reply = _account->sendRawRequest("GET", Utility::concatUrlPath(_account->url(), endpointC), request);
+    connect(_reply, &QNetworkReply::readyRead, this, &ServerEvents::slotReadyRead);
+    connect(_reply, &QNetworkReply::finished, this, &ServerEvents::slotFinished);
+    qCDebug(lcServerEvents) << "Connecting to" << _reply->url();
+}
+
+void ServerEvents::slotReadyRead()
+{
+    if (_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
+        // the body of an error reply
+        return;
+    }
+    if (!_connected) {
+        qCInfo(lcServerEvents) << "Receiving change notifications from" << _account->url();
+        _backoff = MinimumBackoff;
+        setConnected(true);
+    }
+    for (const auto &event : _parser.feed(_reply->readAll())) {
+        handleEvent(event);
+    }
+}
+
+void ServerEvents::slotFinished()
+{
+    const auto reply = _reply;
+    _reply.clear();
+    reply->deleteLater();
+    setConnected(false);
+
+    const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (httpStatus == 401) {
+        // restarted with the new credentials
+        qCInfo(lcServerEvents) << "Change notifications need new credentials";
+        return;
+    }
+    if (!_running) {
+        return;
+    }
+    const auto delay = std::max(_backoff, _parser.retry());
+    qCInfo(lcServerEvents) << "Change notification stream closed:" << httpStatus << reply->errorString() << "reconnecting in" << delay;
+    _reconnectTimer.start(delay);
+    _backoff = std::min<std::chrono::milliseconds>(_backoff * 2, MaximumBackoff);
+}
+
+void ServerEvents::handleEvent(const Event &event)
+{
+    if (!event.id.isEmpty()) {
+        _lastEventId = event.id;
+    }
+    const auto data = QJsonDocument::fromJson(event.data).object();
+    if (data.value(QStringLiteral("initiatorid")).toString().toUtf8() == _account->initiatorId()) {
+        return;
+    }
+    qCDebug(lcServerEvents) << "Received" << event.type << event.data;
+
+    if (event.type.startsWith("space-") || event.type.startsWith("share-")) {
+        Q_EMIT spacesChanged();
+    }
+    const QString spaceId = data.value(QStringLiteral("spaceid")).toString();
+    if (!spaceId.isEmpty()) {
+        Q_EMIT itemChanged(normalizedSpaceId(spaceId));
+    }
+}
+
+void ServerEvents::setConnected(bool connected)
+{
+    if (_connected != connected) {
+        _connected = connected;
+        Q_EMIT connectedChanged(connected);
+    }
+}
+}
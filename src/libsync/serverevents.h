@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QNetworkReply>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+#include <chrono>
+
+namespace OCC {
+
+class Account;
+
+/**
+ * @brief The change notifications of an oCIS server
+ * @ingroup libsync
+ *
+ * Keeps a server-sent events stream open to the notifications endpoint, when
+ * the server announces support with core/support-sse. File events are reported
+ * with the id of the affected space, so the folder can be synced right away
+ * instead of waiting for the next poll. Changes of the space list or of shares
+ * are reported with spacesChanged().
+ *
+ * Events caused by this client are ignored, the server tags them with the
+ * Initiator-ID header of the request.
+ *
+ * The stream is reopened with an exponential backoff when it breaks, while it
+ * is not connected the polling remains the only source of changes.
+ */
+class OWNCLOUDSYNC_EXPORT ServerEvents : public QObject
+{
+    Q_OBJECT
+public:
+    struct Event
+    {
+        QByteArray type;
+        QByteArray data;
+        QByteArray id;
+    };
+
+    /** Splits a text/event-stream into events */
+    class OWNCLOUDSYNC_EXPORT Parser
+    {
+    public:
+        /** Returns the events completed by \a data */
+        QVector<Event> feed(const QByteArray &data);
+
+        /// The reconnection time requested by the server, 0 if none
+        std::chrono::milliseconds retry() const { return _retry; }
+
+    private:
+        void parseLine(const QByteArray &line, QVector<Event> *events);
+
+        QByteArray _buffer;
+        Event _current;
+        bool _hasData = false;
+        std::chrono::milliseconds _retry = {};
+    };
+
+    explicit ServerEvents(Account *account);
+
+    bool isConnected() const { return _connected; }
+
+    void start();
+    void stop();
+
+    /** The part of a space or item id that identifies the space */
+    static QString normalizedSpaceId(const QString &id);
+
+Q_SIGNALS:
+    void connectedChanged(bool connected);
+
+    /** Files in the space \a spaceId changed, as returned by normalizedSpaceId() */
+    void itemChanged(const QString &spaceId);
+
+    /** Spaces or shares were added, removed or changed */
+    void spacesChanged();
+
+private:
+    void connectToServer();
+    void slotReadyRead();
+    void slotFinished();
+    void handleEvent(const Event &event);
+    void setConnected(bool connected);
+
+    Account *_account;
+    QPointer<QNetworkReply> _reply;
+    Parser _parser;
+    QByteArray _lastEventId;
+    QTimer _reconnectTimer;
+    std::chrono::milliseconds _backoff;
+    bool _connected = false;
+    bool _running = false;
+};
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "libsync/stallwatchdog.h"
+
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QStringList>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+
+using namespace std::chrono;
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcStallWatchdog, "sync.stallwatchdog", QtInfoMsg)
+
+namespace {
+    // checked by the activities before they lock anything
+    std::atomic<bool> watchdogRunning = false;
+
+    // the activities shown in a report
+    constexpr size_t MaximumReportedActivities = 8;
+}
+
+StallWatchdog::Activity::Activity(const char *what, const QString &path)
+    : _what(what)
+{
+    if (!watchdogRunning.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
+    _path = path;
+    _registered = true;
+    auto *watchdog = StallWatchdog::instance();
+    std::lock_guard lock(watchdog->_mutex);
+    watchdog->_activities.push_back(this);
+}
+
+StallWatchdog::Activity::~Activity()
+{
+    if (!_registered) {
+        return;
+    }
+    auto *watchdog = StallWatchdog::instance();
+    std::lock_guard lock(watchdog->_mutex);
+    auto &activities = watchdog->_activities;
+    activities.erase(std::remove(activities.begin(), activities.end(), this), activities.end());
+}
+
+StallWatchdog::StallWatchdog() = default;
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+}
+
+StallWatchdog *StallWatchdog::instance()
+{
+    static StallWatchdog watchdog;
+    return &watchdog;
+}
+
+void StallWatchdog::startFromEnvironment()
+{
+    bool ok;
+    const int threshold = qEnvironmentVariableIntValue("OWNCLOUD_STALL_THRESHOLD", &ok);
+    if (ok && threshold > 0) {
+        start(milliseconds(threshold));
+    }
+}
+
+void StallWatchdog::start(milliseconds threshold)
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+    stop();
+    _threshold = threshold;
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = false;
+        _pingPending = false;
+        _stallReported = false;
+    }
+    qCInfo(lcStallWatchdog) << "Reporting the stalls of the main thread longer than" << threshold.count() << "ms";
+    watchdogRunning = true;
+    _thread = std::thread([this] { run(); });
+    // the thread posts to this object, it has to end with the event loop
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &StallWatchdog::stop, Qt::UniqueConnection);
+}
+
+void StallWatchdog::stop()
+{
+    if (!_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_one();
+    _thread.join();
+    watchdogRunning = false;
+}
+
+void StallWatchdog::run()
+{
+    // a stall is noticed within a quarter of the threshold
+    const auto interval = std::max(_threshold / 4, milliseconds(10));
+    std::unique_lock lock(_mutex);
+    while (!_stopping) {
+        const auto now = steady_clock::now();
+        if (!_pingPending) {
+            _pingPending = true;
+            _pingSent = now;
+            QMetaObject::invokeMethod(this, &StallWatchdog::pong, Qt::QueuedConnection);
+        } else if (!_stallReported && now - _pingSent > _threshold) {
+            _stallReported = true;
+            _stallActivities = activities();
+            qCWarning(lcStallWatchdog) << "The main thread is stalled for" << duration_cast<milliseconds>(now - _pingSent).count() << "ms in"
+                                       << (_stallActivities.isEmpty() ? QStringLiteral("no known activity") : _stallActivities);
+        }
+        _wakeUp.wait_for(lock, interval);
+    }
+}
+
+void StallWatchdog::pong()
+{
+    milliseconds duration;
+    QString stallActivities;
+    {
+        std::lock_guard lock(_mutex);
+        duration = duration_cast<milliseconds>(steady_clock::now() - _pingSent);
+        _pingPending = false;
+        if (!_stallReported && duration <= _threshold) {
+            return;
+        }
+        _stallReported = false;
+        stallActivities = std::move(_stallActivities);
+    }
+    qCWarning(lcStallWatchdog) << "The main thread was stalled for" << duration.count() << "ms";
+    Q_EMIT stalled(duration, stallActivities);
+}
+
+QString StallWatchdog::activities() const
+{
+    QStringList out;
+    for (auto it = _activities.crbegin(); it != _activities.crend() && static_cast<size_t>(out.size()) < MaximumReportedActivities; ++it) {
+        out.append(QStringLiteral("%1 of %2").arg(QString::fromLatin1((*it)->_what), (*it)->_path));
+    }
+    return out.join(QLatin1String(", "));
+}
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QObject>
+#include <QString>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace OCC {
+
+/**
+ * @brief Reports the stalls of the main event loop
+ * @ingroup libsync
+ *
+ * Once started, a thread of its own posts a ping to the main thread and waits
+ * for it to be answered. A ping that takes longer than the threshold is logged
+ * right away, together with the activities the main thread is in. Once the main
+ * thread answers, the duration of the stall is logged and stalled() is emitted.
+ *
+ * The activities are marked with Activity scopes in the code that can run long
+ * on the main thread, like the discovery of a directory or the start of a
+ * propagator job. A native stack of the main thread can't be taken portably
+ * without crashing, so the innermost activities stand in for it.
+ */
+class OWNCLOUDSYNC_EXPORT StallWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * Marks the main thread as busy with \a what on \a path while it is in scope
+     *
+     * Does nothing unless the watchdog runs. Must be used in the main thread.
+     */
+    class OWNCLOUDSYNC_EXPORT Activity
+    {
+    public:
+        Activity(const char *what, const QString &path);
+        ~Activity();
+
+        Q_DISABLE_COPY_MOVE(Activity)
+
+    private:
+        friend class StallWatchdog;
+
+        const char *_what;
+        QString _path;
+        bool _registered = false;
+    };
+
+    static StallWatchdog *instance();
+    ~StallWatchdog() override;
+
+    /// Starts the watchdog with the threshold in ms from OWNCLOUD_STALL_THRESHOLD, if that is set
+    void startFromEnvironment();
+
+    /// Reports the stalls longer than \a threshold
+    void start(std::chrono::milliseconds threshold);
+    void stop();
+    bool isRunning() const { return _thread.joinable(); }
+
+Q_SIGNALS:
+    /// Emitted in the main thread once a stall is over, with the activities it was in
+    void stalled(std::chrono::milliseconds duration, const QString &activities);
+
+private:
+    StallWatchdog();
+
+    void run();
+    void pong();
+    // the activities of the main thread, innermost first, must be called with _mutex locked
+    QString activities() const;
+
+    std::chrono::milliseconds _threshold = {};
+    std::thread _thread;
+
+    // guards the members below
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    bool _stopping = false;
+    bool _pingPending = false;
+    bool _stallReported = false;
+    std::chrono::steady_clock::time_point _pingSent;
+    QString _stallActivities;
+    std::vector<const Activity *> _activities;
+};
+}
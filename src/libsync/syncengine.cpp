@@ -14,6 +14,7 @@
  */
 
 #include "syncengine.h"
+#include "accessmanager.h"
 #include "account.h"
 #include "common/asserts.h"
 #include "common/syncfilestatus.h"
@@ -21,6 +22,7 @@
 #include "common/syncjournalfilerecord.h"
 #include "common/vfs.h"
 #include "configfile.h"
+#include "conflictchecksumprepass.h"
 #include "creds/abstractcredentials.h"
 #include "csync_exclude.h"
 #include "discovery.h"
@@ -29,15 +31,19 @@
 #include "owncloudpropagator.h"
 #include "propagatedownload.h"
 #include "propagateremotedelete.h"
+#include "stallwatchdog.h"
+#include "syncplan.h"
 
 #include <chrono>
 
 #include <QDir>
+#include <QSaveFile>
 #include <QLoggingCategory>
 #include <QSslSocket>
 #include <QStringList>
 #include <QTextStream>
 #include <QTime>
+#include <QTimer>
 #include <QUrl>
 
 using namespace std::chrono_literals;
@@ -74,6 +80,12 @@ SyncEngine::SyncEngine(AccountPtr account, const QUrl &baseUrl, const QString &l
     _excludedFiles.reset(new ExcludedFiles);
 
     _syncFileStatusTracker.reset(new SyncFileStatusTracker(this));
+
+    connect(StallWatchdog::instance(), &StallWatchdog::stalled, this, [this](std::chrono::milliseconds duration) {
+        if (_syncRunning) {
+            _metrics.addStall(duration);
+        }
+    });
 }
 
 SyncEngine::~SyncEngine()
@@ -96,18 +108,21 @@ bool SyncEngine::checkErrorBlacklisting(SyncFileItem &item)
         return false;
     }
 
-    SyncJournalErrorBlacklistRecord entry = _journal->errorBlacklistEntry(item._file);
     item._hasBlacklistEntry = false;
-
-    if (!entry.isValid()) {
+    const auto it = _errorBlacklist.constFind(errorBlacklistKey(item._file));
+    if (it == _errorBlacklist.cend() || !it->isValid()) {
         return false;
     }
+    const SyncJournalErrorBlacklistRecord &entry = *it;
 
     item._hasBlacklistEntry = true;
 
-    // If duration has expired, it's not blacklisted anymore
-    time_t now = Utility::qDateTimeToTime_t(QDateTime::currentDateTimeUtc());
-    if (now >= entry._lastTryTime + entry._ignoreDuration) {
+    // If duration has expired, it's not blacklisted anymore.
+    // The entries that expire within a tenth of their duration are retried as well, so the
+    // entries that failed in the same sync are retried together instead of over several syncs.
+    const qint64 now = _errorBlacklistTime;
+    const qint64 retryWindow = entry._ignoreDuration / 10;
+    if (now + retryWindow >= entry._lastTryTime + entry._ignoreDuration) {
         qCInfo(lcEngine) << "blacklist entry for " << item._file << " has expired!";
         return false;
     }
@@ -160,6 +175,11 @@ bool SyncEngine::checkErrorBlacklisting(SyncFileItem &item)
     return true;
 }
 
+QString SyncEngine::errorBlacklistKey(const QString &path)
+{
+    return Utility::fsCasePreserving() ? path.toCaseFolded() : path;
+}
+
 static bool isFileTransferInstruction(SyncInstructions instruction)
 {
     return instruction == CSYNC_INSTRUCTION_CONFLICT
@@ -171,10 +191,10 @@ static bool isFileTransferInstruction(SyncInstructions instruction)
 void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemSet &syncItems)
 {
     // Find all downloadinfo paths that we want to preserve.
-    QSet<QString> download_file_paths;
+    QStringList download_file_paths;
     for (const auto &it : syncItems) {
         if (it->_direction == SyncFileItem::Down && it->_type == ItemTypeFile && isFileTransferInstruction(it->instruction())) {
-            download_file_paths.insert(it->_file);
+            download_file_paths.append(it->_file);
         }
     }
 
@@ -191,10 +211,10 @@ void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemSet &syncItems)
 void SyncEngine::deleteStaleUploadInfos(const SyncFileItemSet &syncItems)
 {
     // Find all blacklisted paths that we want to preserve.
-    QSet<QString> upload_file_paths;
+    QStringList upload_file_paths;
     for (const auto &it : syncItems) {
         if (it->_direction == SyncFileItem::Up && it->_type == ItemTypeFile && isFileTransferInstruction(it->instruction())) {
-            upload_file_paths.insert(it->_file);
+            upload_file_paths.append(it->_file);
         }
     }
 
@@ -214,25 +234,41 @@ void SyncEngine::deleteStaleUploadInfos(const SyncFileItemSet &syncItems)
 void SyncEngine::deleteStaleErrorBlacklistEntries(const SyncFileItemSet &syncItems)
 {
     // Find all blacklisted paths that we want to preserve.
-    QSet<QString> blacklist_file_paths;
+    QStringList blacklist_file_paths;
     for (const auto &it : syncItems) {
         if (it->_hasBlacklistEntry)
-            blacklist_file_paths.insert(it->_file);
+            blacklist_file_paths.append(it->_file);
     }
 
     // Delete from journal.
     _journal->deleteStaleErrorBlacklistEntries(blacklist_file_paths);
 }
 
+void SyncEngine::deleteStaleCachedChecksums(const SyncFileItemSet &syncItems)
+{
+    // The files that are uploaded or compared for a conflict
+    QSet<quint64> inodes;
+    for (const auto &it : syncItems) {
+        if (it->_type == ItemTypeFile && (it->_direction == SyncFileItem::Up || it->instruction() == CSYNC_INSTRUCTION_CONFLICT)) {
+            inodes.insert(it->_inode);
+        }
+    }
+
+    _journal->deleteStaleCachedChecksums(inodes);
+}
+
 void SyncEngine::conflictRecordMaintenance()
 {
-    // Remove stale conflict entries from the database
-    // by checking which files still exist and removing the
-    // missing ones.
+    // Remove stale conflict entries from the database.
+    // The conflict files the discovery saw still exist, only the
+    // other ones need to be checked in the file system.
     const auto &conflictRecordPaths = _journal->conflictRecordPaths();
+    QSet<QByteArray> recordedPaths;
+    recordedPaths.reserve(conflictRecordPaths.size());
     for (const auto &path : conflictRecordPaths) {
-        auto fsPath = _propagator->fullLocalPath(QString::fromUtf8(path));
-        if (!QFileInfo::exists(fsPath)) {
+        recordedPaths.insert(path);
+        const QString file = QString::fromUtf8(path);
+        if (!_seenConflictFiles.contains(file) && !QFileInfo::exists(_propagator->fullLocalPath(file))) {
             _journal->deleteConflictRecord(path);
         }
     }
@@ -246,7 +282,7 @@ void SyncEngine::conflictRecordMaintenance()
         OC_ASSERT(Utility::isConflictFile(path));
 
         auto bapath = path.toUtf8();
-        if (!conflictRecordPaths.contains(bapath)) {
+        if (!recordedPaths.contains(bapath)) {
             ConflictRecord record;
             record.path = bapath;
             auto basePath = Utility::conflictFileBaseNameFromPattern(bapath);
@@ -266,7 +302,7 @@ void SyncEngine::conflictRecordMaintenance()
 
 void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
 {
-    if (Utility::isConflictFile(item->_file))
+    if (Utility::isConflictFile(item->_file) && item->instruction() != CSYNC_INSTRUCTION_REMOVE && item->instruction() != CSYNC_INSTRUCTION_RENAME)
         _seenConflictFiles.insert(item->_file);
     if (item->instruction() == CSYNC_INSTRUCTION_NONE) {
         if (_account->capabilities().uploadConflictFiles() && Utility::isConflictFile(item->_file)) {
@@ -284,18 +320,14 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
     // if the item is on blacklist, the instruction was set to ERROR
     checkErrorBlacklisting(*item);
     _needsUpdate = true;
+    if (!_timelinePath.isEmpty()) {
+        _timeline.instant(item->_file, "discovered", {{QStringLiteral("instruction"), Utility::enumToString(item->instruction())}});
+    }
 
-    Q_ASSERT([&] {
-        const auto it = _syncItems.find(item);
-        if (it != _syncItems.cend()) {
-            const auto &item2 = it->get();
-            qCWarning(lcEngine) << "We already have an item for " << item2->_file << ":" << item2->instruction() << item2->_direction << "|"
-                                << item->instruction() << item->_direction;
-            return false;
-        }
-        return true;
-    }());
     _syncItems.insert(item);
+    if (_pipelined) {
+        _pendingItems[item->_file.section(QLatin1Char('/'), 0, 0)].insert(item);
+    }
 
     slotNewItem(item);
 
@@ -311,6 +343,15 @@ void SyncEngine::startSync()
         return;
     }
     _duration.reset();
+    _metrics.start();
+    if (!_timelinePath.isEmpty()) {
+        _timeline.start();
+    }
+    {
+        const auto commitStatistics = _journal->commitStatistics();
+        _journalCommitsAtStart = commitStatistics.commits;
+        _journalCommitDurationAtStart = commitStatistics.duration;
+    }
 
     _syncRunning = true;
     _anotherSyncNeeded = false;
@@ -348,6 +389,7 @@ void SyncEngine::startSync()
     }
 
     _syncItems.clear();
+    _pendingItems.clear();
     _needsUpdate = false;
 
     if (!_journal->exists()) {
@@ -394,6 +436,22 @@ void SyncEngine::startSync()
         return;
     }
 
+    _errorBlacklist.clear();
+    for (auto &entry : _journal->errorBlacklistEntries()) {
+        const QString key = errorBlacklistKey(entry._file);
+        _errorBlacklist.insert(key, std::move(entry));
+    }
+    _errorBlacklistTime = Utility::qDateTimeToTime_t(QDateTime::currentDateTimeUtc());
+    qCInfo(lcEngine) << "Error blacklist entries:" << _errorBlacklist.size();
+
+    // Without a previous state nothing can be moved or deleted, so a completely
+    // discovered directory doesn't depend on the rest of the tree.
+    _pipelined = syncOptions()._pipelinedPropagation && _journal->isMetadataTableEmpty() && _journal->dataFingerprint().isEmpty()
+        && !syncOptions().fileRegex().isValid() && !syncOptions()._dryRun;
+    if (_pipelined) {
+        qCInfo(lcEngine) << "Propagating the discovered directories while the discovery continues";
+    }
+
     qCInfo(lcEngine) << "#### Discovery start ####################################################" << _duration.duration();
     qCInfo(lcEngine) << "Server" << account()->capabilities().status().versionString()
                      << (account()->isHttp2Supported() ? "Using HTTP/2" : "");
@@ -412,6 +470,13 @@ void SyncEngine::startSync()
     if (!_discoveryPhase->_remoteFolder.endsWith(QLatin1Char('/')))
         _discoveryPhase->_remoteFolder+=QLatin1Char('/');
     _discoveryPhase->_shouldDiscoverLocaly = [this](const QString &s) { return shouldDiscoverLocally(s); };
+    if (_localDiscoveryStyle == LocalDiscoveryStyle::FilesystemUnlessUnchanged) {
+        _discoveryPhase->_unchangedLocalFolderFingerprints = _journal->localFolderFingerprints();
+    }
+    _discoveryPhase->_metrics = &_metrics;
+    if (Utility::fsCasePreserving()) {
+        _discoveryPhase->_caseClashIndex = std::make_shared<CaseClashIndex>();
+    }
     _discoveryPhase->setSelectiveSyncBlackList(selectiveSyncBlackList);
     _discoveryPhase->setSelectiveSyncWhiteList(_journal->getSelectiveSyncList(SyncJournalDb::SelectiveSyncWhiteList, &ok));
     if (!ok) {
@@ -431,16 +496,42 @@ void SyncEngine::startSync()
     connect(_discoveryPhase.get(), &DiscoveryPhase::itemDiscovered, this, &SyncEngine::slotItemDiscovered);
     connect(_discoveryPhase.get(), &DiscoveryPhase::fatalError, this, [this](const QString &errorString) {
         Q_EMIT syncError(errorString);
+        if (_propagator) {
+            // started by the pipelined propagation
+            _propagator->abort();
+        }
         finalize(false);
     });
     connect(_discoveryPhase.get(), &DiscoveryPhase::finished, this, &SyncEngine::slotDiscoveryFinished);
+    if (_pipelined) {
+        connect(_discoveryPhase.get(), &DiscoveryPhase::subtreeDiscovered, this, &SyncEngine::slotSubtreeDiscovered);
+    }
     connect(_discoveryPhase.get(), &DiscoveryPhase::silentlyExcluded, _syncFileStatusTracker.data(), &SyncFileStatusTracker::slotAddSilentlyExcluded);
     connect(_discoveryPhase.get(), &DiscoveryPhase::excluded, _syncFileStatusTracker.data(), &SyncFileStatusTracker::slotAddSilentlyExcluded);
     connect(_discoveryPhase.get(), &DiscoveryPhase::excluded, this, &SyncEngine::excluded);
 
-    auto discoveryJob = new ProcessDirectoryJob(_discoveryPhase.get(), PinState::AlwaysLocal, _discoveryPhase.get());
-    _discoveryPhase->startJob(discoveryJob);
-    connect(discoveryJob, &ProcessDirectoryJob::etag, this, &SyncEngine::slotRootEtagReceived);
+    auto startDiscovery = [this] {
+        auto discoveryJob = new ProcessDirectoryJob(_discoveryPhase.get(), PinState::AlwaysLocal, _discoveryPhase.get());
+        _discoveryPhase->startJob(discoveryJob);
+        connect(discoveryJob, &ProcessDirectoryJob::etag, this, &SyncEngine::slotRootEtagReceived);
+    };
+    if (syncOptions()._journalSnapshotDiscovery && syncOptions()._boundedMemoryDiscovery) {
+        qCInfo(lcEngine) << "Not using the journal snapshot to bound the memory use of the discovery";
+    }
+    if (syncOptions()._journalSnapshotDiscovery && !syncOptions()._boundedMemoryDiscovery) {
+        // Loading the snapshot reads the whole journal, do it on the journal thread.
+        // The callback is dropped if the sync gets aborted in the mean time.
+        _journal->runAsync(
+            _discoveryPhase.get(), [](SyncJournalDb *journal) { return journal->loadMetadataSnapshot(); },
+            [startDiscovery](bool loaded) {
+                if (!loaded) {
+                    qCWarning(lcEngine) << "Could not load the journal snapshot, reading from the database instead";
+                }
+                startDiscovery();
+            });
+    } else {
+        startDiscovery();
+    }
 }
 
 void SyncEngine::slotFolderDiscovered(bool local, const QString &folder)
@@ -478,6 +569,36 @@ void SyncEngine::slotNewItem(const SyncFileItemPtr &item)
     _progressInfo->adjustTotalsForFile(*item);
 }
 
+void SyncEngine::slotSubtreeDiscovered(const QString &path)
+{
+    auto items = _pendingItems.take(path);
+    if (items.empty()) {
+        return;
+    }
+
+    if (!_propagator) {
+        qCInfo(lcEngine) << "#### Pipelined propagation start ####################################################" << _duration.duration();
+        Q_EMIT aboutToPropagate(items);
+
+        _progressInfo->_status = ProgressInfo::Propagation;
+        Q_EMIT transmissionProgress(*_progressInfo);
+        _progressInfo->startEstimateUpdates();
+
+        _journal->commit(QStringLiteral("pipelined propagation start"));
+        createPropagator();
+        Q_EMIT started();
+
+        if (syncOptions()._batchedJournalCommits) {
+            _journal->setCommitMode(SyncJournalDb::CommitMode::Batched);
+        }
+        _propagator->startPipelined();
+    } else {
+        Q_EMIT moreItemsAboutToPropagate(items);
+    }
+    qCDebug(lcEngine) << "Propagating" << items.size() << "items of" << path;
+    _propagator->appendItems(std::move(items));
+}
+
 void SyncEngine::slotDiscoveryFinished()
 {
     if (!_discoveryPhase) {
@@ -486,6 +607,8 @@ void SyncEngine::slotDiscoveryFinished()
     }
 
     qCInfo(lcEngine) << "#### Discovery end ####################################################" << _duration.duration();
+    _metrics.setPhase(SyncMetrics::Phase::Reconcile);
+    _journal->dropMetadataSnapshot();
 
     // Sanity check
     if (!_journal->open()) {
@@ -500,11 +623,80 @@ void SyncEngine::slotDiscoveryFinished()
 
     _progressInfo->_currentDiscoveredRemoteFolder.clear();
     _progressInfo->_currentDiscoveredLocalFolder.clear();
-    _progressInfo->_status = ProgressInfo::Reconcile;
+    if (!_propagator) {
+        _progressInfo->_status = ProgressInfo::Reconcile;
+    }
     Q_EMIT transmissionProgress(*_progressInfo);
 
+    auto propagate = [this](bool propagating) {
+        SyncFileItemSet remainingItems;
+        if (propagating) {
+            for (const auto &items : std::as_const(_pendingItems)) {
+                for (const auto &item : items) {
+                    remainingItems.insert(item);
+                }
+            }
+            _pendingItems.clear();
+            Q_EMIT moreItemsAboutToPropagate(remainingItems);
+        } else {
+            planDiskSpace();
+            // To announce the beginning of the sync
+            Q_EMIT aboutToPropagate(_syncItems);
+        }
+
+        qCInfo(lcEngine) << "#### Reconcile (aboutToPropagate OK) ####################################################" << _duration.duration();
+
+        if (syncOptions()._dryRun) {
+            qCInfo(lcEngine) << "Dry run, not propagating" << _syncItems.size() << "items";
+            _journal->commit(QStringLiteral("dry run"));
+            _metrics.setPhase(SyncMetrics::Phase::Finalize);
+            _syncItems.clear();
+            finalize(true);
+            return;
+        }
+
+        if (!propagating) {
+            // it's important to do this before ProgressInfo::start(), to announce start of new sync
+            _progressInfo->_status = ProgressInfo::Propagation;
+            Q_EMIT transmissionProgress(*_progressInfo);
+            _progressInfo->startEstimateUpdates();
+        }
+
+        // do a database commit
+        _journal->commit(QStringLiteral("post treewalk"));
+
+        if (!propagating) {
+            createPropagator();
+        }
+
+        deleteStaleDownloadInfos(_syncItems);
+        deleteStaleUploadInfos(_syncItems);
+        deleteStaleErrorBlacklistEntries(_syncItems);
+        deleteStaleCachedChecksums(_syncItems);
+        _journal->commit(QStringLiteral("post stale entry removal"));
+
+        // Emit the started signal only after the propagator has been set up.
+        if (_needsUpdate && !propagating)
+            Q_EMIT started();
+
+        if (syncOptions()._batchedJournalCommits) {
+            _journal->setCommitMode(SyncJournalDb::CommitMode::Batched);
+        }
+        _metrics.setPhase(SyncMetrics::Phase::Propagation);
+        if (propagating) {
+            _syncItems.clear();
+            _propagator->appendItems(std::move(remainingItems));
+            _propagator->finishAppendingItems();
+        } else {
+            _propagator->start(std::move(_syncItems));
+        }
+
+
+        qCInfo(lcEngine) << "#### Post-Reconcile end ####################################################" << _duration.duration();
+    };
+
     //    qCInfo(lcEngine) << "Permissions of the root folder: " << _csync_ctx->remote.root_perms.toString();
-    auto finish = [this]{
+    auto finish = [this, propagate] {
 
 
         auto databaseFingerprint = _journal->dataFingerprint();
@@ -520,7 +712,9 @@ void SyncEngine::slotDiscoveryFinished()
             _anotherSyncNeeded = true;
         }
 
-        Q_ASSERT(std::is_sorted(_syncItems.begin(), _syncItems.end()));
+        if (_discoveryPhase->_rootQuota) {
+            Q_EMIT rootQuota(*_discoveryPhase->_rootQuota);
+        }
 
         const auto regex = syncOptions().fileRegex();
         if (regex.isValid()) {
@@ -536,73 +730,55 @@ void SyncEngine::slotDiscoveryFinished()
                     } while (index > 0);
                 }
             }
-            //std::erase_if c++20
-            // https://en.cppreference.com/w/cpp/container/set/erase_if
-            const auto erase_if = [](auto &c, const auto &pred) {
-                auto old_size = c.size();
-                for (auto i = c.begin(), last = c.end(); i != last;) {
-                    if (pred(*i)) {
-                        i = c.erase(i);
-                    } else {
-                        ++i;
-                    }
-                }
-                return old_size - c.size();
-            };
-            erase_if(_syncItems, [&names](const SyncFileItemPtr &i) { return !names.contains(QStringView{i->_file}); });
+            _syncItems.removeIf([&names](const SyncFileItemPtr &i) { return !names.contains(QStringView{i->_file}); });
         }
 
         qCInfo(lcEngine) << "#### Reconcile (aboutToPropagate) ####################################################" << _duration.duration();
 
         _localDiscoveryPaths.clear();
 
-        // To announce the beginning of the sync
-        Q_EMIT aboutToPropagate(_syncItems);
-
-        qCInfo(lcEngine) << "#### Reconcile (aboutToPropagate OK) ####################################################" << _duration.duration();
-
-        // it's important to do this before ProgressInfo::start(), to announce start of new sync
-        _progressInfo->_status = ProgressInfo::Propagation;
-        Q_EMIT transmissionProgress(*_progressInfo);
-        _progressInfo->startEstimateUpdates();
-
-        // do a database commit
-        _journal->commit(QStringLiteral("post treewalk"));
-
-        _propagator = QSharedPointer<OwncloudPropagator>::create(_account, syncOptions(), _baseUrl, _localPath, _remotePath, _journal);
-        connect(_propagator.data(), &OwncloudPropagator::itemCompleted,
-            this, &SyncEngine::slotItemCompleted);
-        connect(_propagator.data(), &OwncloudPropagator::progress,
-            this, &SyncEngine::slotProgress);
-        connect(_propagator.data(), &OwncloudPropagator::updateFileTotal,
-            this, &SyncEngine::updateFileTotal);
-        connect(_propagator.data(), &OwncloudPropagator::finished, this, &SyncEngine::slotPropagationFinished, Qt::QueuedConnection);
-        connect(_propagator.data(), &OwncloudPropagator::seenLockedFile, this, &SyncEngine::seenLockedFile);
-        connect(_propagator.data(), &OwncloudPropagator::insufficientLocalStorage, this, &SyncEngine::slotInsufficientLocalStorage);
-        connect(_propagator.data(), &OwncloudPropagator::insufficientRemoteStorage, this, &SyncEngine::slotInsufficientRemoteStorage);
-        connect(_propagator.data(), &OwncloudPropagator::newItem, this, &SyncEngine::slotNewItem);
-
-        // apply the network limits to the propagator
-        setNetworkLimits(_uploadLimit, _downloadLimit);
-
-        deleteStaleDownloadInfos(_syncItems);
-        deleteStaleUploadInfos(_syncItems);
-        deleteStaleErrorBlacklistEntries(_syncItems);
-        _journal->commit(QStringLiteral("post stale entry removal"));
-
-        // Emit the started signal only after the propagator has been set up.
-        if (_needsUpdate)
-            Q_EMIT started();
-
-        _propagator->start(std::move(_syncItems));
-
-
-        qCInfo(lcEngine) << "#### Post-Reconcile end ####################################################" << _duration.duration();
+        // With the pipelined propagation the propagator might run already,
+        // it gets the items that are not part of a discovered top level directory
+        const bool propagating = !_propagator.isNull();
+        if (!propagating && !syncOptions()._dryRun && ConflictChecksumPrepass::hasCandidates(_syncItems)) {
+            // Resolve the conflicts of identical files before planning and announcing the propagation
+            _conflictChecksumPrepass = new ConflictChecksumPrepass(_localPath, _journal, this);
+            connect(_conflictChecksumPrepass, &ConflictChecksumPrepass::finished, this, [this, propagate] {
+                std::exchange(_conflictChecksumPrepass, nullptr)->deleteLater();
+                propagate(false);
+            });
+            _conflictChecksumPrepass->start(_syncItems);
+            return;
+        }
+        propagate(propagating);
     };
 
     finish();
 }
 
+void SyncEngine::createPropagator()
+{
+    _propagator = QSharedPointer<OwncloudPropagator>::create(_account, syncOptions(), _baseUrl, _localPath, _remotePath, _journal);
+    connect(_propagator.data(), &OwncloudPropagator::itemCompleted,
+        this, &SyncEngine::slotItemCompleted);
+    connect(_propagator.data(), &OwncloudPropagator::progress,
+        this, &SyncEngine::slotProgress);
+    connect(_propagator.data(), &OwncloudPropagator::updateFileTotal,
+        this, &SyncEngine::updateFileTotal);
+    connect(_propagator.data(), &OwncloudPropagator::finished, this, &SyncEngine::slotPropagationFinished, Qt::QueuedConnection);
+    connect(_propagator.data(), &OwncloudPropagator::seenLockedFile, this, &SyncEngine::seenLockedFile);
+    connect(_propagator.data(), &OwncloudPropagator::insufficientLocalStorage, this, &SyncEngine::slotInsufficientLocalStorage);
+    connect(_propagator.data(), &OwncloudPropagator::insufficientRemoteStorage, this, &SyncEngine::slotInsufficientRemoteStorage);
+    connect(_propagator.data(), &OwncloudPropagator::newItem, this, &SyncEngine::slotNewItem);
+    _propagator->_metrics = &_metrics;
+    _propagator->_timeline = _timelinePath.isEmpty() ? nullptr : &_timeline;
+    _propagator->_caseClashIndex = _discoveryPhase->_caseClashIndex;
+    _propagator->setPriorityPaths(std::exchange(_priorityPaths, {}));
+
+    // apply the network limits to the propagator
+    setNetworkLimits(_uploadLimit, _downloadLimit);
+}
+
 void SyncEngine::setNetworkLimits(int upload, int download)
 {
     _uploadLimit = upload;
@@ -611,11 +787,10 @@ void SyncEngine::setNetworkLimits(int upload, int download)
     if (_propagator) {
         if (upload != 0 || download != 0) {
             qCInfo(lcEngine) << "Network Limits (down/up) " << upload << download;
-            if (!_propagator->_bandwidthManager) {
-                _propagator->_bandwidthManager = new BandwidthManager(_propagator.data());
-            }
+            _propagator->_bandwidthManager = BandwidthManager::instance();
         }
-        // this might set the limit to 0 but only the next sync will have no bandwithd manager set
+        // The limits are shared by all engines. This might set them to 0 but
+        // only the next sync will have no bandwidth manager set
         if (_propagator->_bandwidthManager) {
             _propagator->_bandwidthManager->setCurrentDownloadLimit(download);
             _propagator->_bandwidthManager->setCurrentUploadLimit(upload);
@@ -636,16 +811,36 @@ void SyncEngine::slotItemCompleted(const SyncFileItemPtr &item)
 
     Q_EMIT transmissionProgress(*_progressInfo);
     Q_EMIT itemCompleted(item);
+
+    if (_completedItems.isEmpty()) {
+        QTimer::singleShot(0, this, &SyncEngine::flushCompletedItems);
+    }
+    _completedItems.append(item);
+}
+
+void SyncEngine::flushCompletedItems()
+{
+    if (_completedItems.isEmpty()) {
+        return;
+    }
+    Q_EMIT itemsCompleted(std::exchange(_completedItems, {}));
 }
 
 void SyncEngine::slotPropagationFinished(bool success)
 {
+    _metrics.setPhase(SyncMetrics::Phase::Finalize);
     if (_propagator->_anotherSyncNeeded) {
         _anotherSyncNeeded = true;
     }
 
     if (success && _discoveryPhase) {
         _journal->setDataFingerprint(_discoveryPhase->_dataFingerprint);
+        // blacklisted items are not reported as changes again, only a full discovery retries them
+        _journal->setSyncToken(_journal->errorBlackListEntryCount() == 0 ? _discoveryPhase->_syncToken : QByteArray());
+        // same for the folders with blacklisted files, they must be listed again
+        if (syncOptions()._skipUnchangedLocalFolders && _journal->errorBlackListEntryCount() == 0) {
+            _journal->setLocalFolderFingerprints(_discoveryPhase->_listedLocalFolderFingerprints);
+        }
     }
 
     conflictRecordMaintenance();
@@ -673,16 +868,45 @@ void SyncEngine::finalize(bool success)
 {
     qCInfo(lcEngine) << "Sync run took" << _duration.duration();
     _duration.stop();
+    if (const auto stats = _account->accessManager()->connectionStats(); stats.size() > 1) {
+        for (int i = 0; i < stats.size(); ++i) {
+            qCInfo(lcEngine) << (i == 0 ? "Metadata connection:" : "Transfer connection:") << stats[i].requests << "requests, at most"
+                             << stats[i].maximumActiveRequests << "at once";
+        }
+    }
 
     if (_discoveryPhase) {
+        // with the pipelined propagation, the discovery might still be running
+        disconnect(_discoveryPhase.get(), nullptr, this, nullptr);
         _discoveryPhase.release()->deleteLater();
     }
+    if (_conflictChecksumPrepass) {
+        // waits for the running computations, the propagation is not started anymore
+        delete std::exchange(_conflictChecksumPrepass, nullptr);
+    }
+    _journal->dropMetadataSnapshot();
+    _journal->setCommitMode(SyncJournalDb::CommitMode::Immediate);
+
+    const auto commitStatistics = _journal->commitStatistics();
+    _metrics.addJournalCommits(commitStatistics.commits - _journalCommitsAtStart, commitStatistics.duration - _journalCommitDurationAtStart);
+    _metrics.finish(success);
+    _lastSyncMetrics = _metrics;
+    if (!_timelinePath.isEmpty()) {
+        QSaveFile timelineFile(_timelinePath);
+        if (!timelineFile.open(QIODevice::WriteOnly) || timelineFile.write(_timeline.toJson()) < 0 || !timelineFile.commit()) {
+            qCWarning(lcEngine) << "Failed to write the sync timeline to" << _timelinePath << timelineFile.errorString();
+        }
+        _timeline = {};
+    }
     _syncRunning = false;
+    flushCompletedItems();
     Q_EMIT finished(success);
 
     // Delete the propagator only after emitting the signal.
     _propagator.clear();
+    _pendingItems.clear();
     _seenConflictFiles.clear();
+    _errorBlacklist.clear();
     _uniqueErrors.clear();
     _localDiscoveryPaths.clear();
     _localDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
@@ -768,7 +992,8 @@ void SyncEngine::setLocalDiscoveryOptions(LocalDiscoveryStyle style, std::set<QS
 
 bool SyncEngine::shouldDiscoverLocally(const QString &path) const
 {
-    if (_localDiscoveryStyle == LocalDiscoveryStyle::FilesystemOnly) {
+    if (_localDiscoveryStyle != LocalDiscoveryStyle::DatabaseAndFilesystem) {
+        // FilesystemUnlessUnchanged decides per folder, see ProcessDirectoryJob::isLocalFolderUnchanged()
         return true;
     }
 
@@ -810,7 +1035,8 @@ void SyncEngine::abort(const QString &reason)
     bool aborting = false;
     if (_propagator) {
         aborting = true;
-        // If we're already in the propagation phase, aborting that is sufficient
+        // If we're already in the propagation phase, aborting that is sufficient,
+        // the discovery of a pipelined propagation is stopped by finalize()
         _propagator->abort();
     } else if (_discoveryPhase) {
         aborting = true;
@@ -827,6 +1053,52 @@ void SyncEngine::abort(const QString &reason)
     }
 }
 
+void SyncEngine::planDiskSpace()
+{
+    const SyncPlan plan(_syncItems);
+    if (plan.downloadBytes() == 0 && plan.uploadBytes() == 0) {
+        return;
+    }
+
+    qint64 localBytes = Utility::freeDiskSpace(_localPath);
+    if (localBytes >= 0) {
+        localBytes = std::max<qint64>(0, localBytes - freeSpaceLimit());
+    }
+    qCInfo(lcEngine) << "Planned downloads of" << Utility::octetsToString(plan.downloadBytes()) << "with" << plan.placeholders() << "placeholders,"
+                     << "uploads of" << Utility::octetsToString(plan.uploadBytes()) << "; available locally" << localBytes << "bytes, on the server"
+                     << _remoteQuotaAvailable << "bytes";
+
+    const auto shortfall = plan.fitInto(localBytes, _remoteQuotaAvailable);
+    if (shortfall.isEmpty()) {
+        return;
+    }
+
+    for (const auto &item : shortfall.downloads) {
+        item->setInstruction(CSYNC_INSTRUCTION_ERROR);
+        // see PropagateDownloadFile::startDownload
+        item->_status = SyncFileItem::DetailError;
+        item->_errorString = tr("The download would reduce free local disk space below the limit");
+    }
+    for (const auto &item : shortfall.uploads) {
+        item->setInstruction(CSYNC_INSTRUCTION_ERROR);
+        // Necessary for blacklisting logic
+        item->_httpErrorCode = 507;
+        item->_status = SyncFileItem::DetailError;
+        item->_errorString = tr("Upload of %1 exceeds the quota for the folder").arg(Utility::octetsToString(item->_size));
+    }
+
+    if (!shortfall.downloads.isEmpty()) {
+        qCWarning(lcEngine) << "Leaving out" << shortfall.downloads.size() << "downloads of" << Utility::octetsToString(shortfall.downloadBytes)
+                            << "that don't fit on the local disk";
+        slotInsufficientLocalStorage();
+    }
+    if (!shortfall.uploads.isEmpty()) {
+        qCWarning(lcEngine) << "Leaving out" << shortfall.uploads.size() << "uploads of" << Utility::octetsToString(shortfall.uploadBytes)
+                            << "that exceed the quota";
+        slotInsufficientRemoteStorage();
+    }
+}
+
 void SyncEngine::slotSummaryError(const QString &message)
 {
     if (_uniqueErrors.contains(message))
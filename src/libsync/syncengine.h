@@ -23,11 +23,14 @@
 #include "progressdispatcher.h"
 #include "syncfileitem.h"
 #include "syncfilestatustracker.h"
+#include "syncmetrics.h"
+#include "synctimeline.h"
 
 #include <QMutex>
 #include <QThread>
 #include <QString>
 #include <QSet>
+#include <QHash>
 #include <QMap>
 #include <QStringList>
 #include <QSharedPointer>
@@ -43,6 +46,7 @@ class SyncJournalFileRecord;
 class SyncJournalDb;
 class OwncloudPropagator;
 class ProcessDirectoryJob;
+class ConflictChecksumPrepass;
 
 /**
  * @brief The SyncEngine class
@@ -51,6 +55,9 @@ class ProcessDirectoryJob;
 class OWNCLOUDSYNC_EXPORT SyncEngine : public QObject
 {
     Q_OBJECT
+    friend class ::TestLocalDiscovery;
+    friend class ::TestRemoteDiscovery;
+
 public:
     SyncEngine(AccountPtr account, const QUrl &baseUrl, const QString &localPath,
         const QString &remotePath, SyncJournalDb *journal);
@@ -64,6 +71,9 @@ public:
 
     bool isSyncRunning() const { return _syncRunning; }
 
+    /** The progress of the current sync run, as last reported with transmissionProgress() */
+    const ProgressInfo &progressInfo() const { return *_progressInfo; }
+
     const SyncOptions &syncOptions() const
     {
         Q_ASSERT(_syncOptions);
@@ -76,6 +86,20 @@ public:
     bool ignoreHiddenFiles() const { return _ignore_hidden_files; }
     void setIgnoreHiddenFiles(bool ignore) { _ignore_hidden_files = ignore; }
 
+    /** The bytes the uploads of the next sync may add on the server, negative if unknown
+     *
+     * Used with the free local disk space to leave out the transfers that can't
+     * fit before the propagation starts, see SyncPlan. Pass a negative value unless
+     * the quota is current, the server rejects the uploads that exceed it anyway.
+     */
+    void setRemoteQuotaAvailable(qint64 bytes) { _remoteQuotaAvailable = bytes; }
+
+    /** The paths the user waits for, they are propagated first in the next sync
+     *
+     * See OwncloudPropagator::setPriorityPaths().
+     */
+    void setPriorityPaths(const QSet<QString> &paths) { _priorityPaths = paths; }
+
     bool isExcluded(QStringView filePath) const;
     void addManualExclude(const QString &filePath);
     void addExcludeList(const QString &filePath);
@@ -129,6 +153,15 @@ public:
     /** Access the last sync run's local discovery style */
     LocalDiscoveryStyle lastLocalDiscoveryStyle() const { return _lastLocalDiscoveryStyle; }
 
+    /** The metrics of the last finished sync run, invalid before the first run finished */
+    const SyncMetrics &lastSyncMetrics() const { return _lastSyncMetrics; }
+
+    /** Records the lifecycle of the items of the next runs and writes it to \a path when a run finished, see SyncTimeline
+     *
+     * An empty path records nothing.
+     */
+    void setTimelinePath(const QString &path) { _timelinePath = path; }
+
     auto getPropagator() { return _propagator; } // for the test
 
 
@@ -136,12 +169,25 @@ Q_SIGNALS:
     // During update, before reconcile
     void rootEtag(const QString &, const QDateTime &);
 
+    // After the discovery, if the root was listed with its quota
+    void rootQuota(const OCC::RemoteQuota &quota);
+
     // after the above signals. with the items that actually need propagating
     void aboutToPropagate(const SyncFileItemSet &items);
 
+    // with SyncOptions::_pipelinedPropagation, after aboutToPropagate() with each further batch of items
+    void moreItemsAboutToPropagate(const SyncFileItemSet &items);
+
     // after each item completed by a job (successful or not)
     void itemCompleted(const SyncFileItemPtr &);
 
+    /** The items completed since the last event loop iteration, in the order of itemCompleted()
+     *
+     * For the listeners that don't need each item right away, like the ui. All
+     * items are delivered before finished().
+     */
+    void itemsCompleted(const QVector<OCC::SyncFileItemPtr> &items);
+
     void transmissionProgress(const ProgressInfo &progress);
 
     /// We've produced a new sync error of a type.
@@ -173,6 +219,9 @@ private Q_SLOTS:
     void slotNewItem(const SyncFileItemPtr &item);
 
     void slotItemCompleted(const SyncFileItemPtr &item);
+    /// Emits itemsCompleted() with the items collected so far
+    void flushCompletedItems();
+    void slotSubtreeDiscovered(const QString &path);
     void slotDiscoveryFinished();
     void slotPropagationFinished(bool success);
     void slotProgress(const SyncFileItem &item, qint64 curent);
@@ -186,6 +235,15 @@ private Q_SLOTS:
 
 private:
     bool checkErrorBlacklisting(SyncFileItem &item);
+    // the key of _errorBlacklist, case insensitive on case preserving file systems like the lookup of the journal
+    static QString errorBlacklistKey(const QString &path);
+
+    /** Leave out the transfers of _syncItems that don't fit into the available space
+     *
+     * The left out items are reported as errors, like the ones that run out of
+     * space during the propagation.
+     */
+    void planDiskSpace();
 
     // Cleans up unnecessary downloadinfo entries in the journal as well
     // as their temporary files.
@@ -197,15 +255,28 @@ private:
     // Removes stale error blacklist entries from the journal.
     void deleteStaleErrorBlacklistEntries(const SyncFileItemSet &syncItems);
 
+    // Removes cached checksums of files that changed, keeping those the sync may still use
+    void deleteStaleCachedChecksums(const SyncFileItemSet &syncItems);
+
     // Removes stale and adds missing conflict records after sync
     void conflictRecordMaintenance();
 
     // cleanup and Q_EMIT the finished signal
     void finalize(bool success);
 
+    void createPropagator();
+
     // Must only be acessed during update and reconcile
     SyncFileItemSet _syncItems;
 
+    /** Whether discovered top level directories are propagated while the discovery continues
+     *
+     * See SyncOptions::_pipelinedPropagation, _pendingItems holds the items
+     * that were not handed to the propagator yet, by their top level name.
+     */
+    bool _pipelined = false;
+    QHash<QString, SyncFileItemSet> _pendingItems;
+
     AccountPtr _account;
     const QUrl _baseUrl;
     bool _needsUpdate;
@@ -216,16 +287,37 @@ private:
     SyncJournalDb *_journal;
     std::unique_ptr<DiscoveryPhase> _discoveryPhase;
     QSharedPointer<OwncloudPropagator> _propagator;
+    // compares the checksums of conflicts between the discovery and the propagation
+    ConflictChecksumPrepass *_conflictChecksumPrepass = nullptr;
 
-    // List of all files with conflicts
+    // The discovered conflict files, except for the ones that are removed or renamed
     QSet<QString> _seenConflictFiles;
 
+    /** The error blacklist of the journal, read once when the sync starts
+     *
+     * The entries are compared with the start time of the sync, _errorBlacklistTime,
+     * so the retries don't depend on when an item happens to be discovered.
+     */
+    QHash<QString, SyncJournalErrorBlacklistRecord> _errorBlacklist;
+    qint64 _errorBlacklistTime = 0;
+
     QScopedPointer<ProgressInfo> _progressInfo;
+    // the completed items of the current event loop iteration, see itemsCompleted()
+    QVector<SyncFileItemPtr> _completedItems;
 
     std::unique_ptr<class ExcludedFiles> _excludedFiles;
     QScopedPointer<SyncFileStatusTracker> _syncFileStatusTracker;
     Utility::ChronoElapsedTimer _duration;
 
+    // the metrics of the running sync, copied to _lastSyncMetrics once it finished
+    SyncMetrics _metrics;
+    SyncMetrics _lastSyncMetrics;
+    quint64 _journalCommitsAtStart = 0;
+    std::chrono::nanoseconds _journalCommitDurationAtStart = {};
+
+    QString _timelinePath;
+    SyncTimeline _timeline;
+
     /**
      * Instead of downloading files from the server, upload the files to the server
      */
@@ -234,6 +326,9 @@ private:
     // If ignored files should be ignored
     bool _ignore_hidden_files = false;
 
+    qint64 _remoteQuotaAvailable = -1;
+    QSet<QString> _priorityPaths;
+
 
     int _uploadLimit;
     int _downloadLimit;
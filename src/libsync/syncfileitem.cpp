@@ -75,6 +75,42 @@ SyncFileItemPtr SyncFileItem::fromSyncJournalFileRecord(const SyncJournalFileRec
     return item;
 }
 
+QString SyncFileItem::sortKey() const
+{
+    QString key = destination();
+    key.replace(QLatin1Char('/'), QChar(QChar::Null));
+    return key;
+}
+
+void SyncFileItemSet::ensureSorted() const
+{
+    if (_sorted) {
+        return;
+    }
+    // compute the keys once instead of in each of the n log n comparisons
+    std::vector<std::pair<QString, SyncFileItemPtr>> keyed;
+    keyed.reserve(_items.size());
+    for (auto &item : _items) {
+        keyed.emplace_back(item->sortKey(), std::move(item));
+    }
+    std::sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    Q_ASSERT([&keyed] {
+        const auto it = std::adjacent_find(keyed.cbegin(), keyed.cend(), [](const auto &a, const auto &b) { return a.first == b.first; });
+        if (it != keyed.cend()) {
+            const auto &item1 = it->second;
+            const auto &item2 = std::next(it)->second;
+            qCWarning(lcFileItem) << "We already have an item for " << item1->_file << ":" << item1->instruction() << item1->_direction << "|"
+                                  << item2->instruction() << item2->_direction;
+            return false;
+        }
+        return true;
+    }());
+    for (size_t i = 0; i < keyed.size(); ++i) {
+        _items[i] = std::move(keyed[i].second);
+    }
+    _sorted = true;
+}
+
 SyncInstruction SyncFileItem::instruction() const
 {
     return _instruction;
@@ -21,7 +21,9 @@
 #include <QMetaType>
 #include <QSharedPointer>
 
+#include <algorithm>
 #include <set>
+#include <vector>
 
 #include "common/syncjournaldb.h"
 #include "common/utility.h"
@@ -168,8 +170,8 @@ public:
     friend bool operator<(const SyncFileItem &item1, const SyncFileItem &item2)
     {
         // Sort by destination
-        auto d1 = item1.destination();
-        auto d2 = item2.destination();
+        const auto &d1 = item1.destination();
+        const auto &d2 = item2.destination();
 
         // But this we need to order it so the slash come first. It should be this order:
         //  "foo", "foo/bar", "foo-bar"
@@ -199,7 +201,7 @@ public:
         return data1[prefixL] < data2[prefixL];
     }
 
-    QString destination() const
+    const QString &destination() const
     {
         if (!_renameTarget.isEmpty()) {
             return _renameTarget;
@@ -207,6 +209,13 @@ public:
         return _file;
     }
 
+    /**
+     * The destination() with the / replaced by the lowest code unit
+     *
+     * Plain string comparisons of the keys order the items like operator<.
+     */
+    QString sortKey() const;
+
     bool isEmpty() const
     {
         return _file.isEmpty();
@@ -311,6 +320,8 @@ public:
     QString _directDownloadCookies;
 
     bool _relevantDirectoyInstruction = false;
+    /// The local checksum of a conflict was compared with _checksumHeader before the propagation and differs
+    bool _conflictChecksumCompared = false;
     bool _finished = false;
 
     auto toUploadInfo() const
@@ -340,7 +351,71 @@ inline bool operator<(const SyncFileItemPtr &item1, const SyncFileItemPtr &item2
     return *item1 < *item2;
 }
 
-using SyncFileItemSet = std::set<SyncFileItemPtr>;
+/**
+ * @brief The items of a sync run, ordered like a std::set<SyncFileItemPtr>
+ * @ingroup libsync
+ *
+ * The items are kept in a flat vector instead of a node based set: the discovery
+ * appends them in any order and they are sorted once, when they are iterated
+ * the first time. This avoids an allocation and a rebalancing per item and the
+ * iteration walks contiguous memory.
+ *
+ * Adding the same destination twice is a bug, it is asserted when sorting.
+ * The lazy sorting of the const accessors makes sharing a set between threads unsafe.
+ */
+class OWNCLOUDSYNC_EXPORT SyncFileItemSet
+{
+public:
+    using value_type = SyncFileItemPtr;
+    using const_iterator = std::vector<SyncFileItemPtr>::const_iterator;
+    using iterator = const_iterator;
+    using size_type = std::vector<SyncFileItemPtr>::size_type;
+
+    void insert(const SyncFileItemPtr &item)
+    {
+        // appending in order, as the propagator does, keeps the set sorted
+        _sorted = _sorted && (_items.empty() || *_items.back() < *item);
+        _items.push_back(item);
+    }
+
+    void reserve(size_type size) { _items.reserve(size); }
+    void clear()
+    {
+        _items.clear();
+        _sorted = true;
+    }
+
+    size_type size() const { return _items.size(); }
+    bool empty() const { return _items.empty(); }
+
+    const_iterator begin() const
+    {
+        ensureSorted();
+        return _items.cbegin();
+    }
+    const_iterator end() const
+    {
+        ensureSorted();
+        return _items.cend();
+    }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    /** Removes the items matching \a pred, returns the number of removed items */
+    template <typename Predicate>
+    size_type removeIf(Predicate pred)
+    {
+        const auto oldSize = _items.size();
+        _items.erase(std::remove_if(_items.begin(), _items.end(), pred), _items.end());
+        return oldSize - _items.size();
+    }
+
+private:
+    void ensureSorted() const;
+
+    mutable std::vector<SyncFileItemPtr> _items;
+    mutable bool _sorted = true;
+};
 }
 
 Q_DECLARE_METATYPE(OCC::SyncFileItemSet)
@@ -21,43 +21,204 @@
 
 #include <QFileInfo>
 #include <QLoggingCategory>
+#include <QStringTokenizer>
+
+#include <vector>
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcStatusTracker, "sync.statustracker", QtInfoMsg)
 
-bool SyncFileStatusTracker::PathComparator::operator()( const QString& lhs, const QString& rhs ) const
+namespace {
+// The number of statuses kept in memory, more than the files of the folders a shell shows at once
+constexpr int RecentStatusesMaximum = 10000;
+}
+
+bool SyncFileStatusTracker::PathTrie::ComponentLess::operator()(QStringView lhs, QStringView rhs) const
 {
-    // This will make sure that the std::map is ordered and queried case-insensitively on macOS and Windows.
+    // This will make sure that the tree is ordered and queried case-insensitively on macOS and Windows.
     // we want don't want to pay for the runtime check on every comparison.
     static const auto sensitivity = Utility::fsCaseSensitivity();
     return lhs.compare(rhs, sensitivity) < 0;
 }
 
-SyncFileStatus::SyncFileStatusTag SyncFileStatusTracker::lookupProblem(const QString &pathToMatch, const SyncFileStatusTracker::ProblemsMap &problemMap)
-{
-    auto lower = problemMap.lower_bound(pathToMatch);
-    for (auto it = lower; it != problemMap.cend(); ++it) {
-        const QString &problemPath = it->first;
-        SyncFileStatus::SyncFileStatusTag severity = it->second;
-
-        if (problemPath.compare(pathToMatch, _caseSensitivity) == 0) {
-            return severity;
-        } else if (severity == SyncFileStatus::StatusError
-            && problemPath.startsWith(pathToMatch, _caseSensitivity)
-            && (pathToMatch.isEmpty() || problemPath.at(pathToMatch.size()) == QLatin1Char('/'))) {
-            return SyncFileStatus::StatusWarning;
-        } else if (!problemPath.startsWith(pathToMatch, _caseSensitivity)) {
-            // Starting at lower_bound we get the first path that is not smaller,
-            // since: "a/" < "a/aa" < "a/aa/aaa" < "a/ab/aba"
-            // If problemMap keys are ["a/aa/aaa", "a/ab/aba"] and pathToMatch == "a/aa",
-            // lower_bound(pathToMatch) will point to "a/aa/aaa", and the moment that
-            // problemPath.startsWith(pathToMatch) == false, we know that we've looked
-            // at everything that interest us.
+std::vector<SyncFileStatusTracker::PathTrie::Node *> SyncFileStatusTracker::PathTrie::nodesTo(QStringView path)
+{
+    std::vector<Node *> nodes = {&_root};
+    for (const auto component : qTokenize(path, QLatin1Char('/'), Qt::SkipEmptyParts)) {
+        auto &children = nodes.back()->children;
+        auto it = children.find(component);
+        if (it == children.end()) {
+            it = children.emplace(component.toString(), Node()).first;
+        }
+        nodes.push_back(&it->second);
+    }
+    return nodes;
+}
+
+const SyncFileStatusTracker::PathTrie::Node *SyncFileStatusTracker::PathTrie::find(QStringView path) const
+{
+    const Node *node = &_root;
+    for (const auto component : qTokenize(path, QLatin1Char('/'), Qt::SkipEmptyParts)) {
+        auto it = node->children.find(component);
+        if (it == node->children.end()) {
+            return nullptr;
+        }
+        node = &it->second;
+    }
+    return node;
+}
+
+void SyncFileStatusTracker::PathTrie::prune(QStringView path)
+{
+    std::vector<std::pair<Node *, std::map<QString, Node, ComponentLess>::iterator>> nodes;
+    Node *node = &_root;
+    for (const auto component : qTokenize(path, QLatin1Char('/'), Qt::SkipEmptyParts)) {
+        auto it = node->children.find(component);
+        if (it == node->children.end()) {
+            return;
+        }
+        nodes.emplace_back(node, it);
+        node = &it->second;
+    }
+    for (auto entry = nodes.rbegin(); entry != nodes.rend(); ++entry) {
+        const auto &[parent, it] = *entry;
+        if (!it->second.isEmpty()) {
             break;
         }
+        parent->children.erase(it);
+    }
+}
+
+void SyncFileStatusTracker::PathTrie::pruneChildren(Node &node)
+{
+    for (auto it = node.children.begin(); it != node.children.end();) {
+        pruneChildren(it->second);
+        if (it->second.isEmpty()) {
+            it = node.children.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SyncFileStatusTracker::PathTrie::setProblem(QStringView path, SyncFileStatus::SyncFileStatusTag problem)
+{
+    const auto nodes = nodesTo(path);
+    const int delta = (problem == SyncFileStatus::StatusError) - (nodes.back()->problem == SyncFileStatus::StatusError);
+    nodes.back()->problem = problem;
+    for (auto *node : nodes) {
+        node->errors += delta;
+    }
+}
+
+void SyncFileStatusTracker::PathTrie::removeProblem(QStringView path)
+{
+    if (!hasProblem(path)) {
+        return;
+    }
+    setProblem(path, SyncFileStatus::StatusNone);
+    prune(path);
+}
+
+bool SyncFileStatusTracker::PathTrie::hasProblem(QStringView path) const
+{
+    const Node *node = find(path);
+    return node && node->problem != SyncFileStatus::StatusNone;
+}
+
+SyncFileStatus::SyncFileStatusTag SyncFileStatusTracker::PathTrie::problem(QStringView path) const
+{
+    const Node *node = find(path);
+    if (!node) {
+        return SyncFileStatus::StatusNone;
+    }
+    if (node->problem != SyncFileStatus::StatusNone) {
+        return node->problem;
+    }
+    return node->errors > 0 ? SyncFileStatus::StatusWarning : SyncFileStatus::StatusNone;
+}
+
+std::vector<std::pair<QString, SyncFileStatus::SyncFileStatusTag>> SyncFileStatusTracker::PathTrie::takeProblems()
+{
+    std::vector<std::pair<QString, SyncFileStatus::SyncFileStatusTag>> problems;
+    auto take = [&problems](const QString &path, Node &node) {
+        if (node.problem != SyncFileStatus::StatusNone) {
+            problems.emplace_back(path, node.problem);
+            node.problem = SyncFileStatus::StatusNone;
+        }
+        node.errors = 0;
+    };
+    take(QString(), _root);
+    forEach(_root, QString(), take);
+    pruneChildren(_root);
+    return problems;
+}
+
+int SyncFileStatusTracker::PathTrie::addSyncCount(QStringView path, int delta)
+{
+    auto *node = nodesTo(path).back();
+    const bool had = node->syncCount > 0;
+    node->syncCount += delta;
+    const int count = node->syncCount;
+    _syncCounts += (count > 0) - had;
+    if (count == 0) {
+        prune(path);
+    }
+    return count;
+}
+
+int SyncFileStatusTracker::PathTrie::syncCount(QStringView path) const
+{
+    const Node *node = find(path);
+    return node ? node->syncCount : 0;
+}
+
+QStringList SyncFileStatusTracker::PathTrie::takeSyncCounts()
+{
+    QStringList paths;
+    auto take = [&paths](const QString &path, Node &node) {
+        if (node.syncCount != 0) {
+            paths.append(path);
+            node.syncCount = 0;
+        }
+    };
+    take(QString(), _root);
+    forEach(_root, QString(), take);
+    pruneChildren(_root);
+    _syncCounts = 0;
+    return paths;
+}
+
+void SyncFileStatusTracker::PathTrie::setDirty(QStringView path, bool dirty)
+{
+    if (dirty) {
+        nodesTo(path).back()->dirty = true;
+    } else if (isDirty(path)) {
+        nodesTo(path).back()->dirty = false;
+        prune(path);
     }
-    return SyncFileStatus::StatusNone;
+}
+
+bool SyncFileStatusTracker::PathTrie::isDirty(QStringView path) const
+{
+    const Node *node = find(path);
+    return node && node->dirty;
+}
+
+QStringList SyncFileStatusTracker::PathTrie::takeDirtyPaths()
+{
+    QStringList paths;
+    auto take = [&paths](const QString &path, Node &node) {
+        if (node.dirty) {
+            paths.append(path);
+            node.dirty = false;
+        }
+    };
+    take(QString(), _root);
+    forEach(_root, QString(), take);
+    pruneChildren(_root);
+    return paths;
 }
 
 /**
@@ -84,10 +245,11 @@ static inline bool hasExcludedStatus(const SyncFileItem &item)
 
 SyncFileStatusTracker::SyncFileStatusTracker(SyncEngine *syncEngine)
     : _syncEngine(syncEngine)
-    , _caseSensitivity(Utility::fsCaseSensitivity())
+    , _recentStatuses(RecentStatusesMaximum)
 {
     connect(syncEngine, &SyncEngine::aboutToPropagate,
         this, &SyncFileStatusTracker::slotAboutToPropagate);
+    connect(syncEngine, &SyncEngine::moreItemsAboutToPropagate, this, &SyncFileStatusTracker::slotMoreItemsAboutToPropagate);
     connect(syncEngine, &SyncEngine::itemCompleted,
         this, &SyncFileStatusTracker::slotItemCompleted);
     connect(syncEngine, &SyncEngine::finished, this, &SyncFileStatusTracker::slotSyncFinished);
@@ -96,6 +258,19 @@ SyncFileStatusTracker::SyncFileStatusTracker(SyncEngine *syncEngine)
 }
 
 SyncFileStatus SyncFileStatusTracker::fileStatus(const QString &relativePath)
+{
+    if (relativePath.isEmpty()) {
+        return resolveFileStatus(relativePath);
+    }
+    if (const auto *status = _recentStatuses.object(relativePath)) {
+        return *status;
+    }
+    const auto status = resolveFileStatus(relativePath);
+    _recentStatuses.insert(relativePath, new SyncFileStatus(status));
+    return status;
+}
+
+SyncFileStatus SyncFileStatusTracker::resolveFileStatus(const QString &relativePath)
 {
     OC_ASSERT(!relativePath.endsWith(QLatin1Char('/')));
 
@@ -122,7 +297,7 @@ SyncFileStatus SyncFileStatusTracker::fileStatus(const QString &relativePath)
         return SyncFileStatus(SyncFileStatus::StatusExcluded);
     }
 
-    if (_dirtyPaths.contains(relativePath))
+    if (_paths.isDirty(relativePath))
         return SyncFileStatus::StatusSync;
 
     // First look it up in the database to know if it's shared
@@ -141,26 +316,27 @@ void SyncFileStatusTracker::slotPathTouched(const QString &fileName)
 
     OC_ASSERT(fileName.startsWith(folderPath));
     QString localPath = fileName.mid(folderPath.size());
-    _dirtyPaths.insert(localPath);
+    _paths.setDirty(localPath, true);
+    _recentStatuses.remove(localPath);
 
     Q_EMIT fileStatusChanged(fileName, SyncFileStatus::StatusSync);
 }
 
 void SyncFileStatusTracker::slotAddSilentlyExcluded(const QString &folderPath)
 {
-    _syncProblems[folderPath] = SyncFileStatus::StatusExcluded;
-    Q_EMIT fileStatusChanged(getSystemDestination(folderPath), resolveSyncAndErrorStatus(folderPath, NotShared));
+    _paths.setProblem(folderPath, SyncFileStatus::StatusExcluded);
+    emitFileStatusChanged(folderPath, resolveSyncAndErrorStatus(folderPath, NotShared));
 }
 
 void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
 {
-    // Will return 0 (and increase to 1) if the path wasn't in the map yet
-    int count = _syncCount[relativePath]++;
+    // Will return 0 (and increase to 1) if the path had no count yet
+    int count = _paths.addSyncCount(relativePath, 1) - 1;
     if (!count) {
         SyncFileStatus status = sharedFlag == UnknownShared
-            ? fileStatus(relativePath)
+            ? resolveFileStatus(relativePath)
             : resolveSyncAndErrorStatus(relativePath, sharedFlag);
-        Q_EMIT fileStatusChanged(getSystemDestination(relativePath), status);
+        emitFileStatusChanged(relativePath, status);
 
         // We passed from OK to SYNC, increment the parent to keep it marked as
         // SYNC while we propagate ourselves and our own children.
@@ -175,15 +351,12 @@ void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &rela
 
 void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
 {
-    int count = --_syncCount[relativePath];
+    int count = _paths.addSyncCount(relativePath, -1);
     if (!count) {
-        // Remove from the map, same as 0
-        _syncCount.remove(relativePath);
-
         SyncFileStatus status = sharedFlag == UnknownShared
-            ? fileStatus(relativePath)
+            ? resolveFileStatus(relativePath)
             : resolveSyncAndErrorStatus(relativePath, sharedFlag);
-        Q_EMIT fileStatusChanged(getSystemDestination(relativePath), status);
+        emitFileStatusChanged(relativePath, status);
 
         // We passed from SYNC to OK, decrement our parent.
         OC_ASSERT(!relativePath.endsWith(QLatin1Char('/')));
@@ -197,21 +370,47 @@ void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &rela
 
 void SyncFileStatusTracker::slotAboutToPropagate(const SyncFileItemSet &items)
 {
-    OC_ASSERT(_syncCount.isEmpty());
+    OC_ASSERT(!_paths.hasSyncCounts());
+
+    const auto oldProblems = _paths.takeProblems();
+
+    addItemsAboutToPropagate(items);
+
+    // Some metadata status won't trigger files to be synced, make sure that we
+    // push the OK status for dirty files that don't need to be propagated.
+    // Take them first since fileStatus() reads the dirty flags to determine the status
+    const QStringList oldDirtyPaths = _paths.takeDirtyPaths();
+    for (const auto &path : oldDirtyPaths)
+        emitFileStatusChanged(path, resolveFileStatus(path));
 
-    ProblemsMap oldProblems;
-    std::swap(_syncProblems, oldProblems);
+    // Make sure to push any status that might have been resolved indirectly since the last sync
+    // (like an error file being deleted from disk)
+    for (const auto &[path, severity] : oldProblems) {
+        if (_paths.hasProblem(path))
+            continue;
+        if (severity == SyncFileStatus::StatusError)
+            invalidateParentPaths(path);
+        emitFileStatusChanged(path, resolveFileStatus(path));
+    }
+}
+
+void SyncFileStatusTracker::slotMoreItemsAboutToPropagate(const SyncFileItemSet &items)
+{
+    addItemsAboutToPropagate(items);
+}
 
+void SyncFileStatusTracker::addItemsAboutToPropagate(const SyncFileItemSet &items)
+{
     for (const auto &item : std::as_const(items)) {
         qCDebug(lcStatusTracker) << "Investigating" << item->destination() << item->_status << item->instruction();
-        _dirtyPaths.remove(item->destination());
-        _dirtyPaths.remove(item->_originalFile);
+        _paths.setDirty(item->destination(), false);
+        _paths.setDirty(item->_originalFile, false);
 
         if (hasErrorStatus(*item)) {
-            _syncProblems[item->destination()] = SyncFileStatus::StatusError;
+            _paths.setProblem(item->destination(), SyncFileStatus::StatusError);
             invalidateParentPaths(item->destination());
         } else if (hasExcludedStatus(*item)) {
-            _syncProblems[item->destination()] = SyncFileStatus::StatusExcluded;
+            _paths.setProblem(item->destination(), SyncFileStatus::StatusExcluded);
         }
 
         SharedFlag sharedFlag = item->_remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared;
@@ -219,29 +418,9 @@ void SyncFileStatusTracker::slotAboutToPropagate(const SyncFileItemSet &items)
             // Mark this path as syncing for instructions that will result in propagation.
             incSyncCountAndEmitStatusChanged(item->destination(), sharedFlag);
         } else {
-            Q_EMIT fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
+            emitFileStatusChanged(item->destination(), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
         }
     }
-
-    // Some metadata status won't trigger files to be synced, make sure that we
-    // push the OK status for dirty files that don't need to be propagated.
-    // Swap into a copy since fileStatus() reads _dirtyPaths to determine the status
-    QSet<QString> oldDirtyPaths;
-    std::swap(_dirtyPaths, oldDirtyPaths);
-    for (auto it = oldDirtyPaths.constBegin(); it != oldDirtyPaths.constEnd(); ++it)
-        Q_EMIT fileStatusChanged(getSystemDestination(*it), fileStatus(*it));
-
-    // Make sure to push any status that might have been resolved indirectly since the last sync
-    // (like an error file being deleted from disk)
-    for (auto it = _syncProblems.begin(); it != _syncProblems.end(); ++it)
-        oldProblems.erase(it->first);
-    for (auto it = oldProblems.begin(); it != oldProblems.end(); ++it) {
-        const QString &path = it->first;
-        SyncFileStatus::SyncFileStatusTag severity = it->second;
-        if (severity == SyncFileStatus::StatusError)
-            invalidateParentPaths(path);
-        Q_EMIT fileStatusChanged(getSystemDestination(path), fileStatus(path));
-    }
 }
 
 void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
@@ -249,12 +428,12 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
     qCDebug(lcStatusTracker) << "Item completed" << item->destination() << item->_status << item->instruction();
 
     if (hasErrorStatus(*item)) {
-        _syncProblems[item->destination()] = SyncFileStatus::StatusError;
+        _paths.setProblem(item->destination(), SyncFileStatus::StatusError);
         invalidateParentPaths(item->destination());
     } else if (hasExcludedStatus(*item)) {
-        _syncProblems[item->destination()] = SyncFileStatus::StatusExcluded;
+        _paths.setProblem(item->destination(), SyncFileStatus::StatusExcluded);
     } else {
-        _syncProblems.erase(item->destination());
+        _paths.removeProblem(item->destination());
     }
 
     SharedFlag sharedFlag = item->_remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared;
@@ -262,22 +441,23 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
         // decSyncCount calls *must* be symetric with incSyncCount calls in slotAboutToPropagate
         decSyncCountAndEmitStatusChanged(item->destination(), sharedFlag);
     } else {
-        Q_EMIT fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
+        emitFileStatusChanged(item->destination(), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
     }
 }
 
 void SyncFileStatusTracker::slotSyncFinished()
 {
     // Clear the sync counts to reduce the impact of unsymetrical inc/dec calls (e.g. when directory job abort)
-    QHash<QString, int> oldSyncCount;
-    std::swap(_syncCount, oldSyncCount);
-    for (auto it = oldSyncCount.begin(); it != oldSyncCount.end(); ++it)
-        Q_EMIT fileStatusChanged(getSystemDestination(it.key()), fileStatus(it.key()));
+    const QStringList oldSyncCounts = _paths.takeSyncCounts();
+    for (const auto &path : oldSyncCounts)
+        emitFileStatusChanged(path, resolveFileStatus(path));
 }
 
 void SyncFileStatusTracker::slotSyncEngineRunningChanged()
 {
-    Q_EMIT fileStatusChanged(getSystemDestination(QString()), resolveSyncAndErrorStatus(QString(), NotShared));
+    // Catch the changes we are not told about, like the ones of the exclude list
+    _recentStatuses.clear();
+    emitFileStatusChanged(QString(), resolveSyncAndErrorStatus(QString(), NotShared));
 }
 
 SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &relativePath, SharedFlag sharedFlag, PathKnownFlag isPathKnown)
@@ -285,12 +465,12 @@ SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &r
     // If it's a new file and that we're not syncing it yet,
     // don't show any icon and wait for the filesystem watcher to trigger a sync.
     SyncFileStatus status(isPathKnown ? SyncFileStatus::StatusUpToDate : SyncFileStatus::StatusNone);
-    if (_syncCount.value(relativePath)) {
+    if (_paths.syncCount(relativePath)) {
         status.set(SyncFileStatus::StatusSync);
     } else {
         // After a sync finished, we need to show the users issues from that last sync like the activity list does.
         // Also used for parent directories showing a warning for an error child.
-        SyncFileStatus::SyncFileStatusTag problemStatus = lookupProblem(relativePath, _syncProblems);
+        SyncFileStatus::SyncFileStatusTag problemStatus = _paths.problem(relativePath);
         if (problemStatus != SyncFileStatus::StatusNone)
             status.set(problemStatus);
     }
@@ -303,12 +483,22 @@ SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &r
     return status;
 }
 
+void SyncFileStatusTracker::emitFileStatusChanged(const QString &relativePath, SyncFileStatus status)
+{
+    _recentStatuses.remove(relativePath);
+    Q_EMIT fileStatusChanged(getSystemDestination(relativePath), status);
+}
+
 void SyncFileStatusTracker::invalidateParentPaths(const QString &path)
 {
-    QStringList splitPath = path.split(QLatin1Char('/'), Qt::SkipEmptyParts);
-    for (int i = 0; i < splitPath.size(); ++i) {
-        QString parentPath = QStringList(splitPath.mid(0, i)).join(QLatin1Char('/'));
-        Q_EMIT fileStatusChanged(getSystemDestination(parentPath), fileStatus(parentPath));
+    if (path.isEmpty()) {
+        return;
+    }
+    // the sync folder and every folder above path
+    emitFileStatusChanged(QString(), resolveFileStatus(QString()));
+    for (auto slash = path.indexOf(QLatin1Char('/')); slash != -1; slash = path.indexOf(QLatin1Char('/'), slash + 1)) {
+        const QString parentPath = path.left(slash);
+        emitFileStatusChanged(parentPath, resolveFileStatus(parentPath));
     }
 }
 
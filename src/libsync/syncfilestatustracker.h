@@ -20,6 +20,8 @@
 #include "syncfileitem.h"
 #include "common/syncfilestatus.h"
 #include <map>
+#include <vector>
+#include <QCache>
 #include <QSet>
 
 namespace OCC {
@@ -36,6 +38,7 @@ class OWNCLOUDSYNC_EXPORT SyncFileStatusTracker : public QObject
     Q_OBJECT
 public:
     explicit SyncFileStatusTracker(SyncEngine *syncEngine);
+    /// The status of \a relativePath, the recently queried ones are answered from memory
     SyncFileStatus fileStatus(const QString &relativePath);
 
 public Q_SLOTS:
@@ -48,23 +51,96 @@ Q_SIGNALS:
 
 private Q_SLOTS:
     void slotAboutToPropagate(const SyncFileItemSet &items);
+    void slotMoreItemsAboutToPropagate(const SyncFileItemSet &items);
     void slotItemCompleted(const SyncFileItemPtr &item);
     void slotSyncFinished();
     void slotSyncEngineRunningChanged();
 
 private:
-    struct PathComparator {
-        bool operator()( const QString& lhs, const QString& rhs ) const;
+    void addItemsAboutToPropagate(const SyncFileItemSet &items);
+
+    /**
+     * The state of the paths the tracker knows about, stored in a tree of path components
+     *
+     * This holds the problems of the last sync, the sync counts of the paths
+     * being propagated and the paths touched since the last sync. Every node
+     * counts the errors in its subtree, so the status of a file or a folder
+     * with erroneous children is found in O(depth). The paths are tokenized
+     * in place, only new nodes copy their component.
+     */
+    class PathTrie
+    {
+    public:
+        void setProblem(QStringView path, SyncFileStatus::SyncFileStatusTag problem);
+        void removeProblem(QStringView path);
+        /// Whether \a path itself has a problem
+        bool hasProblem(QStringView path) const;
+        /// The problem of \a path, StatusWarning for a folder with an error below it
+        SyncFileStatus::SyncFileStatusTag problem(QStringView path) const;
+        /// Removes all problems and returns them with their paths
+        std::vector<std::pair<QString, SyncFileStatus::SyncFileStatusTag>> takeProblems();
+
+        /// Changes the sync count of \a path by \a delta and returns the new count
+        int addSyncCount(QStringView path, int delta);
+        int syncCount(QStringView path) const;
+        bool hasSyncCounts() const { return _syncCounts > 0; }
+        /// Resets all sync counts and returns the paths that had one
+        QStringList takeSyncCounts();
+
+        void setDirty(QStringView path, bool dirty);
+        bool isDirty(QStringView path) const;
+        /// Clears all dirty flags and returns the paths that had one
+        QStringList takeDirtyPaths();
+
+    private:
+        struct ComponentLess
+        {
+            using is_transparent = void;
+            bool operator()(QStringView lhs, QStringView rhs) const;
+        };
+        struct Node
+        {
+            std::map<QString, Node, ComponentLess> children;
+            SyncFileStatus::SyncFileStatusTag problem = SyncFileStatus::StatusNone;
+            // the number of StatusError entries in this subtree, including this node
+            int errors = 0;
+            int syncCount = 0;
+            bool dirty = false;
+
+            bool isEmpty() const { return problem == SyncFileStatus::StatusNone && syncCount == 0 && !dirty && children.empty(); }
+        };
+
+        /// The nodes from the root to \a path, the missing ones are created
+        std::vector<Node *> nodesTo(QStringView path);
+        const Node *find(QStringView path) const;
+        /// Removes the nodes of \a path that no longer hold anything
+        void prune(QStringView path);
+        static void pruneChildren(Node &node);
+
+        /// Calls \a f with the path of every node below \a node
+        template <typename F>
+        static void forEach(Node &node, const QString &path, F &f)
+        {
+            for (auto &[name, child] : node.children) {
+                const QString childPath = path.isEmpty() ? name : path + QLatin1Char('/') + name;
+                f(childPath, child);
+                forEach(child, childPath, f);
+            }
+        }
+
+        Node _root;
+        // the number of nodes with a sync count
+        int _syncCounts = 0;
     };
-    typedef std::map<QString, SyncFileStatus::SyncFileStatusTag, PathComparator> ProblemsMap;
-    SyncFileStatus::SyncFileStatusTag lookupProblem(const QString &pathToMatch, const ProblemsMap &problemMap);
 
     enum SharedFlag { UnknownShared,
         NotShared,
         Shared };
     enum PathKnownFlag { PathUnknown = 0,
         PathKnown };
+    SyncFileStatus resolveFileStatus(const QString &relativePath);
     SyncFileStatus resolveSyncAndErrorStatus(const QString &relativePath, SharedFlag sharedState, PathKnownFlag isPathKnown = PathKnown);
+    void emitFileStatusChanged(const QString &relativePath, SyncFileStatus status);
 
     void invalidateParentPaths(const QString &path);
     QString getSystemDestination(const QString &relativePath);
@@ -73,15 +149,15 @@ private:
 
     SyncEngine *_syncEngine;
 
-    ProblemsMap _syncProblems;
-    QSet<QString> _dirtyPaths;
-    // Counts the number direct children currently being synced (has unfinished propagation jobs).
+    // The problems, the dirty paths and the sync counts.
+    // The sync count is the number direct children currently being synced (has unfinished propagation jobs).
     // We'll show a file/directory as SYNC as long as its sync count is > 0.
     // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
-    QHash<QString, int> _syncCount;
+    PathTrie _paths;
 
-    // case sensitivity used for path comparisons
-    Qt::CaseSensitivity _caseSensitivity;
+    // The resolved statuses of the paths the shell asked for last, e.g. while scrolling a folder.
+    // Every change we announce through fileStatusChanged drops the entry of the path.
+    QCache<QString, SyncFileStatus> _recentStatuses;
 };
 }
 
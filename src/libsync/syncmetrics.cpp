@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncmetrics.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+
+#include <algorithm>
+#include <numeric>
+
+using namespace std::chrono;
+
+namespace {
+constexpr std::array<OCC::SyncMetrics::Phase, 4> Phases = {
+    OCC::SyncMetrics::Phase::Discovery, OCC::SyncMetrics::Phase::Reconcile, OCC::SyncMetrics::Phase::Propagation, OCC::SyncMetrics::Phase::Finalize};
+
+double toSeconds(nanoseconds value)
+{
+    return duration_cast<duration<double>>(value).count();
+}
+
+QByteArray number(double value)
+{
+    return QByteArray::number(value, 'g', 10);
+}
+
+QByteArray escapeLabel(const QString &value)
+{
+    QByteArray out = value.toUtf8();
+    out.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return out;
+}
+
+/// Writes one metric family, \a samples is called with an emit function for each folder
+template <typename F>
+void writeFamily(QByteArray &out, const QByteArray &name, const QByteArray &type, const QByteArray &help, const QMap<QString, OCC::SyncMetrics> &metrics,
+    F samples)
+{
+    out += "# HELP " + name + ' ' + help + '\n';
+    out += "# TYPE " + name + ' ' + type + '\n';
+    for (auto it = metrics.cbegin(); it != metrics.cend(); ++it) {
+        const QByteArray folderLabel = "folder=\"" + escapeLabel(it.key()) + '"';
+        samples(it.value(), [&](const QByteArray &suffix, const QByteArray &labels, double value) {
+            out += name + suffix + '{' + folderLabel + (labels.isEmpty() ? QByteArray() : ',' + labels) + "} " + number(value) + '\n';
+        });
+    }
+}
+}
+
+namespace OCC {
+
+void SyncMetrics::Histogram::add(milliseconds duration)
+{
+    const auto it = std::lower_bound(Bounds.cbegin(), Bounds.cend(), duration.count());
+    buckets[std::distance(Bounds.cbegin(), it)]++;
+    count++;
+    sum += duration;
+}
+
+void SyncMetrics::start()
+{
+    *this = {};
+    _startTime = QDateTime::currentMSecsSinceEpoch();
+    setPhase(Phase::Discovery);
+}
+
+void SyncMetrics::setPhase(Phase phase)
+{
+    _phaseTimer.stop();
+    if (_phase != Phase::Idle) {
+        _phaseDurations[static_cast<int>(_phase)] += _phaseTimer.duration();
+    }
+    _phase = phase;
+    _phaseTimer.reset();
+}
+
+void SyncMetrics::finish(bool success)
+{
+    setPhase(Phase::Idle);
+    _endTime = QDateTime::currentMSecsSinceEpoch();
+    _success = success;
+}
+
+void SyncMetrics::addRequest(const QByteArray &verb, milliseconds duration, qint64 bytesSent, qint64 bytesReceived)
+{
+    _requests[verb].add(duration);
+    _bytesSent += bytesSent;
+    _bytesReceived += bytesReceived;
+}
+
+void SyncMetrics::addLocalListing(nanoseconds duration)
+{
+    _localListings++;
+    _localListingDuration += duration;
+}
+
+void SyncMetrics::addActiveJobs(int count)
+{
+    _maximumActiveJobs = std::max(_maximumActiveJobs, count);
+}
+
+void SyncMetrics::addJournalCommits(quint64 count, nanoseconds duration)
+{
+    _journalCommits += count;
+    _journalCommitDuration += duration;
+}
+
+void SyncMetrics::addChunk(qint64 nextChunkSize)
+{
+    _uploadChunks++;
+    _chunkSize = nextChunkSize;
+}
+
+void SyncMetrics::addBufferedBytes(qint64 bytes)
+{
+    _maximumBufferedBytes = std::max(_maximumBufferedBytes, bytes);
+}
+
+void SyncMetrics::addStall(milliseconds duration)
+{
+    _stalls++;
+    _maximumStall = std::max(_maximumStall, duration);
+}
+
+nanoseconds SyncMetrics::duration() const
+{
+    return std::accumulate(_phaseDurations.cbegin(), _phaseDurations.cend(), nanoseconds{});
+}
+
+QString SyncMetrics::phaseName(Phase phase)
+{
+    switch (phase) {
+    case Phase::Idle:
+        return QStringLiteral("idle");
+    case Phase::Discovery:
+        return QStringLiteral("discovery");
+    case Phase::Reconcile:
+        return QStringLiteral("reconcile");
+    case Phase::Propagation:
+        return QStringLiteral("propagation");
+    case Phase::Finalize:
+        return QStringLiteral("finalize");
+    }
+    Q_UNREACHABLE();
+}
+
+QJsonObject SyncMetrics::toJson() const
+{
+    QJsonObject phases;
+    for (const auto phase : Phases) {
+        phases.insert(phaseName(phase), toSeconds(phaseDuration(phase)));
+    }
+
+    QJsonObject requests;
+    for (auto it = _requests.cbegin(); it != _requests.cend(); ++it) {
+        QJsonArray buckets;
+        for (const auto count : it->buckets) {
+            buckets.append(static_cast<qint64>(count));
+        }
+        requests.insert(QString::fromUtf8(it.key()),
+            QJsonObject{{QStringLiteral("count"), static_cast<qint64>(it->count)}, {QStringLiteral("sum"), toSeconds(it->sum)},
+                {QStringLiteral("buckets"), buckets}});
+    }
+    QJsonArray bounds;
+    for (const auto bound : Histogram::Bounds) {
+        bounds.append(bound / 1000.0);
+    }
+
+    const double propagationSeconds = toSeconds(phaseDuration(Phase::Propagation));
+    return {
+        {QStringLiteral("start"), QDateTime::fromMSecsSinceEpoch(_startTime).toString(Qt::ISODateWithMs)},
+        {QStringLiteral("end"), QDateTime::fromMSecsSinceEpoch(_endTime).toString(Qt::ISODateWithMs)},
+        {QStringLiteral("success"), _success},
+        {QStringLiteral("duration"), toSeconds(duration())},
+        {QStringLiteral("phases"), phases},
+        {QStringLiteral("requestBuckets"), bounds},
+        {QStringLiteral("requests"), requests},
+        {QStringLiteral("bytesSent"), _bytesSent},
+        {QStringLiteral("bytesReceived"), _bytesReceived},
+        {QStringLiteral("uploadRate"), propagationSeconds > 0 ? _bytesSent / propagationSeconds : 0},
+        {QStringLiteral("downloadRate"), propagationSeconds > 0 ? _bytesReceived / propagationSeconds : 0},
+        {QStringLiteral("localListings"), static_cast<qint64>(_localListings)},
+        {QStringLiteral("localListingDuration"), toSeconds(_localListingDuration)},
+        {QStringLiteral("maximumActiveJobs"), _maximumActiveJobs},
+        {QStringLiteral("journalCommits"), static_cast<qint64>(_journalCommits)},
+        {QStringLiteral("journalCommitDuration"), toSeconds(_journalCommitDuration)},
+        {QStringLiteral("uploadChunks"), static_cast<qint64>(_uploadChunks)},
+        {QStringLiteral("chunkSize"), _chunkSize},
+        {QStringLiteral("maximumBufferedBytes"), _maximumBufferedBytes},
+        {QStringLiteral("stalls"), static_cast<qint64>(_stalls)},
+        {QStringLiteral("maximumStall"), toSeconds(_maximumStall)},
+    };
+}
+
+QByteArray SyncMetrics::toPrometheus(const QMap<QString, SyncMetrics> &metrics)
+{
+    QByteArray out;
+    writeFamily(out, "owncloud_sync_last_run_timestamp_seconds", "gauge", "End of the last sync run.", metrics, [](const SyncMetrics &m, auto sample) {
+        sample({}, {}, m._endTime / 1000.0);
+    });
+    writeFamily(out, "owncloud_sync_last_run_success", "gauge", "Whether the last sync run succeeded.", metrics, [](const SyncMetrics &m, auto sample) {
+        sample({}, {}, m._success ? 1 : 0);
+    });
+    writeFamily(out, "owncloud_sync_phase_duration_seconds", "gauge", "Duration of the phases of the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) {
+            for (const auto phase : Phases) {
+                sample({}, "phase=\"" + phaseName(phase).toUtf8() + '"', toSeconds(m.phaseDuration(phase)));
+            }
+        });
+    writeFamily(out, "owncloud_sync_request_duration_seconds", "histogram", "Duration of the requests of the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) {
+            for (auto it = m._requests.cbegin(); it != m._requests.cend(); ++it) {
+                const QByteArray verb = "verb=\"" + it.key() + '"';
+                quint64 cumulative = 0;
+                for (size_t i = 0; i < it->buckets.size(); ++i) {
+                    cumulative += it->buckets[i];
+                    const QByteArray le = i < Histogram::Bounds.size() ? number(Histogram::Bounds[i] / 1000.0) : QByteArrayLiteral("+Inf");
+                    sample("_bucket", verb + ",le=\"" + le + '"', cumulative);
+                }
+                sample("_sum", verb, toSeconds(it->sum));
+                sample("_count", verb, it->count);
+            }
+        });
+    writeFamily(out, "owncloud_sync_transferred_bytes", "gauge", "Bytes transferred by the last sync run.", metrics, [](const SyncMetrics &m, auto sample) {
+        sample({}, "direction=\"up\"", m._bytesSent);
+        sample({}, "direction=\"down\"", m._bytesReceived);
+    });
+    writeFamily(out, "owncloud_sync_local_listings", "gauge", "Local directories listed by the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, m._localListings); });
+    writeFamily(out, "owncloud_sync_local_listing_duration_seconds", "gauge", "Time spent listing local directories in the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, toSeconds(m._localListingDuration)); });
+    writeFamily(out, "owncloud_sync_active_jobs_maximum", "gauge", "Maximum number of parallel propagator jobs in the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, m._maximumActiveJobs); });
+    writeFamily(out, "owncloud_sync_journal_commits", "gauge", "Journal commits of the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, m._journalCommits); });
+    writeFamily(out, "owncloud_sync_journal_commit_duration_seconds", "gauge", "Time spent committing the journal in the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, toSeconds(m._journalCommitDuration)); });
+    writeFamily(out, "owncloud_sync_upload_chunks", "gauge", "Chunks uploaded by the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, m._uploadChunks); });
+    writeFamily(out, "owncloud_sync_upload_chunk_size_bytes", "gauge", "Chunk size at the end of the last sync run, 0 without chunked uploads.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, m._chunkSize); });
+    writeFamily(out, "owncloud_sync_reply_buffer_maximum_bytes", "gauge", "Most reply data buffered by a request of the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, m._maximumBufferedBytes); });
+    writeFamily(out, "owncloud_sync_main_thread_stalls", "gauge", "Stalls of the main thread during the last sync run, if the watchdog runs.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, m._stalls); });
+    writeFamily(out, "owncloud_sync_main_thread_stall_maximum_seconds", "gauge", "Longest stall of the main thread during the last sync run.", metrics,
+        [](const SyncMetrics &m, auto sample) { sample({}, {}, toSeconds(m._maximumStall)); });
+    return out;
+}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include "common/chronoelapsedtimer.h"
+
+#include <QJsonObject>
+#include <QMap>
+
+#include <array>
+#include <chrono>
+
+namespace OCC {
+
+/**
+ * @brief Performance metrics of a sync run
+ * @ingroup libsync
+ *
+ * The SyncEngine switches the phases and its helpers feed in the requests,
+ * local listings, job queue depths and journal commits. All of it happens on
+ * the thread of the engine, so there is no locking.
+ *
+ * The metrics of the last finished run are available from
+ * SyncEngine::lastSyncMetrics(), as json or in the Prometheus text format.
+ */
+class OWNCLOUDSYNC_EXPORT SyncMetrics
+{
+public:
+    enum class Phase {
+        Idle,
+        Discovery,
+        Reconcile,
+        Propagation,
+        Finalize,
+    };
+
+    /** A histogram of request durations with fixed buckets */
+    struct Histogram
+    {
+        // upper bounds of the buckets in ms, the last bucket has no bound
+        static constexpr std::array<int, 10> Bounds = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+        void add(std::chrono::milliseconds duration);
+
+        std::array<quint64, Bounds.size() + 1> buckets = {};
+        quint64 count = 0;
+        std::chrono::milliseconds sum = {};
+    };
+
+    /** Resets the metrics and starts the Discovery phase */
+    void start();
+    void setPhase(Phase phase);
+    void finish(bool success);
+
+    void addRequest(const QByteArray &verb, std::chrono::milliseconds duration, qint64 bytesSent, qint64 bytesReceived);
+    void addLocalListing(std::chrono::nanoseconds duration);
+    /** Called with the number of running propagator jobs, the maximum is kept */
+    void addActiveJobs(int count);
+    void addJournalCommits(quint64 count, std::chrono::nanoseconds duration);
+    /** Called for every uploaded chunk with the chunk size that is used from now on */
+    void addChunk(qint64 nextChunkSize);
+    /** Called with the most data a reply buffered, see AbstractNetworkJob::maximumBufferedBytes(), the maximum is kept */
+    void addBufferedBytes(qint64 bytes);
+    /** Called for every stall of the main thread during the run, see StallWatchdog */
+    void addStall(std::chrono::milliseconds duration);
+
+    bool isValid() const { return _startTime > 0; }
+    std::chrono::nanoseconds phaseDuration(Phase phase) const { return _phaseDurations[static_cast<int>(phase)]; }
+    std::chrono::nanoseconds duration() const;
+    const QMap<QByteArray, Histogram> &requests() const { return _requests; }
+
+    QJsonObject toJson() const;
+
+    /** The metrics of several folders in the Prometheus text format, the keys are used as folder label */
+    static QByteArray toPrometheus(const QMap<QString, SyncMetrics> &metrics);
+
+    static QString phaseName(Phase phase);
+
+private:
+    // ms since epoch
+    qint64 _startTime = 0;
+    qint64 _endTime = 0;
+    bool _success = false;
+
+    Phase _phase = Phase::Idle;
+    Utility::ChronoElapsedTimer _phaseTimer;
+    std::array<std::chrono::nanoseconds, static_cast<int>(Phase::Finalize) + 1> _phaseDurations = {};
+
+    QMap<QByteArray, Histogram> _requests;
+    qint64 _bytesSent = 0;
+    qint64 _bytesReceived = 0;
+
+    quint64 _localListings = 0;
+    std::chrono::nanoseconds _localListingDuration = {};
+
+    int _maximumActiveJobs = 0;
+
+    quint64 _journalCommits = 0;
+    std::chrono::nanoseconds _journalCommitDuration = {};
+
+    quint64 _uploadChunks = 0;
+    qint64 _chunkSize = 0;
+
+    qint64 _maximumBufferedBytes = 0;
+
+    quint64 _stalls = 0;
+    std::chrono::milliseconds _maximumStall = {};
+};
+}
@@ -16,6 +16,7 @@
 #include "common/utility.h"
 
 #include <QRegularExpression>
+#include <QThread>
 
 using namespace OCC;
 
@@ -49,6 +50,133 @@ void SyncOptions::fillFromEnvironmentVariables()
     int maxParallel = qEnvironmentVariableIntValue("OWNCLOUD_MAX_PARALLEL");
     if (maxParallel > 0)
         _parallelNetworkJobs = maxParallel;
+
+    int maxParallelDiscovery = qEnvironmentVariableIntValue("OWNCLOUD_MAX_PARALLEL_DISCOVERY");
+    if (maxParallelDiscovery > 0)
+        _parallelDiscoveryJobs = maxParallelDiscovery;
+
+    const QByteArray adaptiveParallelEnv = qgetenv("OWNCLOUD_ADAPTIVE_PARALLEL");
+    if (!adaptiveParallelEnv.isEmpty()) {
+        _transferConcurrencyMode = adaptiveParallelEnv == "0" || adaptiveParallelEnv == "false" ? TransferConcurrencyMode::Fixed
+                                                                                               : TransferConcurrencyMode::Adaptive;
+    }
+
+    if (const auto propagationOrder = propagationOrderFromName(qEnvironmentVariable("OWNCLOUD_PROPAGATION_ORDER"))) {
+        _propagationOrder = *propagationOrder;
+    }
+
+    const QByteArray deepDiscoveryEnv = qgetenv("OWNCLOUD_DEEP_DISCOVERY");
+    if (!deepDiscoveryEnv.isEmpty()) {
+        _deepRemoteDiscovery = deepDiscoveryEnv != "0" && deepDiscoveryEnv != "false";
+    }
+
+    const QByteArray deltaDiscoveryEnv = qgetenv("OWNCLOUD_DELTA_DISCOVERY");
+    if (!deltaDiscoveryEnv.isEmpty()) {
+        _deltaRemoteDiscovery = deltaDiscoveryEnv != "0" && deltaDiscoveryEnv != "false";
+    }
+
+    const QByteArray skipUnchangedEnv = qgetenv("OWNCLOUD_SKIP_UNCHANGED_LOCAL_FOLDERS");
+    if (!skipUnchangedEnv.isEmpty()) {
+        _skipUnchangedLocalFolders = skipUnchangedEnv != "0" && skipUnchangedEnv != "false";
+    }
+
+    const QByteArray journalSnapshotEnv = qgetenv("OWNCLOUD_JOURNAL_SNAPSHOT");
+    if (!journalSnapshotEnv.isEmpty()) {
+        _journalSnapshotDiscovery = journalSnapshotEnv != "0" && journalSnapshotEnv != "false";
+    }
+
+    const QByteArray batchedCommitsEnv = qgetenv("OWNCLOUD_JOURNAL_BATCHED_COMMITS");
+    if (!batchedCommitsEnv.isEmpty()) {
+        _batchedJournalCommits = batchedCommitsEnv != "0" && batchedCommitsEnv != "false";
+    }
+
+    const QByteArray pipelinedPropagationEnv = qgetenv("OWNCLOUD_PIPELINED_PROPAGATION");
+    if (!pipelinedPropagationEnv.isEmpty()) {
+        _pipelinedPropagation = pipelinedPropagationEnv != "0" && pipelinedPropagationEnv != "false";
+    }
+
+    const QByteArray boundedMemoryEnv = qgetenv("OWNCLOUD_BOUNDED_MEMORY_DISCOVERY");
+    if (!boundedMemoryEnv.isEmpty()) {
+        _boundedMemoryDiscovery = boundedMemoryEnv != "0" && boundedMemoryEnv != "false";
+    }
+
+    const QByteArray serverSideCopyEnv = qgetenv("OWNCLOUD_SERVER_SIDE_COPY");
+    if (!serverSideCopyEnv.isEmpty()) {
+        _serverSideCopy = serverSideCopyEnv != "0" && serverSideCopyEnv != "false";
+    }
+
+    const QByteArray skipUnchangedContentEnv = qgetenv("OWNCLOUD_SKIP_UNCHANGED_CONTENT_UPLOADS");
+    if (!skipUnchangedContentEnv.isEmpty()) {
+        _skipUnchangedContentUploads = skipUnchangedContentEnv != "0" && skipUnchangedContentEnv != "false";
+    }
+
+    const QByteArray snapshotUploadsEnv = qgetenv("OWNCLOUD_SNAPSHOT_UPLOADS");
+    if (!snapshotUploadsEnv.isEmpty()) {
+        _snapshotUploads = snapshotUploadsEnv != "0" && snapshotUploadsEnv != "false";
+    }
+
+    const QByteArray appendedDownloadsEnv = qgetenv("OWNCLOUD_APPENDED_DOWNLOADS");
+    if (!appendedDownloadsEnv.isEmpty()) {
+        _appendedDownloads = appendedDownloadsEnv != "0" && appendedDownloadsEnv != "false";
+    }
+
+    const int localDiscoveryThreads = qEnvironmentVariableIntValue("OWNCLOUD_LOCAL_DISCOVERY_THREADS");
+    if (localDiscoveryThreads > 0)
+        _localDiscoveryThreads = localDiscoveryThreads;
+
+    const int downloadSegments = qEnvironmentVariableIntValue("OWNCLOUD_DOWNLOAD_SEGMENTS");
+    if (downloadSegments > 0)
+        _downloadSegments = downloadSegments;
+
+    const int parallelChunkUploads = qEnvironmentVariableIntValue("OWNCLOUD_PARALLEL_CHUNK_UPLOADS");
+    if (parallelChunkUploads > 0)
+        _parallelChunkUploads = parallelChunkUploads;
+}
+
+std::optional<SyncOptions::PropagationOrder> SyncOptions::propagationOrderFromName(QStringView name)
+{
+    if (name == QLatin1String("path")) {
+        return PropagationOrder::Path;
+    } else if (name == QLatin1String("recent")) {
+        return PropagationOrder::RecentlyModifiedFirst;
+    } else if (name == QLatin1String("smallest")) {
+        return PropagationOrder::SmallestFirst;
+    }
+    return {};
+}
+
+std::optional<SyncOptions::SyncDirection> SyncOptions::syncDirectionFromName(QStringView name)
+{
+    if (name == QLatin1String("both")) {
+        return SyncDirection::Bidirectional;
+    } else if (name == QLatin1String("upload")) {
+        return SyncDirection::UploadOnly;
+    } else if (name == QLatin1String("download")) {
+        return SyncDirection::DownloadOnly;
+    }
+    return {};
+}
+
+QString SyncOptions::syncDirectionName(SyncDirection direction)
+{
+    switch (direction) {
+    case SyncDirection::Bidirectional:
+        return QStringLiteral("both");
+    case SyncDirection::UploadOnly:
+        return QStringLiteral("upload");
+    case SyncDirection::DownloadOnly:
+        return QStringLiteral("download");
+    }
+    Q_UNREACHABLE();
+}
+
+int SyncOptions::localDiscoveryThreads() const
+{
+    if (_localDiscoveryThreads > 0) {
+        return _localDiscoveryThreads;
+    }
+    // directory listings mostly wait for the disk, more threads than cores help on SSDs
+    return qBound(2, 2 * QThread::idealThreadCount(), 8);
 }
 
 void SyncOptions::verifyChunkSizes()
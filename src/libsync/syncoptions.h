@@ -23,6 +23,7 @@
 #include <QString>
 
 #include <chrono>
+#include <optional>
 
 
 namespace OCC {
@@ -66,10 +67,201 @@ public:
     /** The maximum number of active jobs in parallel  */
     int _parallelNetworkJobs = 6;
 
+    /** The maximum number of directories discovered in parallel
+     *
+     * Separate from _parallelNetworkJobs: a PROPFIND is cheap to send but its reply
+     * can take long to arrive for a large directory.
+     */
+    int _parallelDiscoveryJobs = 6;
+
+    enum class TransferConcurrencyMode {
+        /** At most 3 transfers run in parallel */
+        Fixed,
+        /** The number of parallel transfers is adjusted to the observed throughput,
+         * latency and server overload replies, bounded by _parallelNetworkJobs.
+         * See TransferConcurrency.
+         */
+        Adaptive
+    };
+
+    /** How the number of parallel transfers is determined */
+    TransferConcurrencyMode _transferConcurrencyMode = TransferConcurrencyMode::Fixed;
+
+    enum class PropagationOrder {
+        /** The items are propagated in path order */
+        Path,
+        /** The most recently modified files of a directory first */
+        RecentlyModifiedFirst,
+        /** The smallest files of a directory first */
+        SmallestFirst
+    };
+
+    /** The order in which the files are propagated
+     *
+     * Directories are ordered by their best ranked content, so a directory with
+     * a recently changed file is propagated before its siblings. The files
+     * requested by the user, see OwncloudPropagator::setPriorityPaths(), always
+     * come first.
+     */
+    PropagationOrder _propagationOrder = PropagationOrder::Path;
+
+    /** The order called \a name, "path", "recent" or "smallest" */
+    static std::optional<PropagationOrder> propagationOrderFromName(QStringView name);
+
+    enum class SyncDirection {
+        /** The changes on both sides are synced */
+        Bidirectional,
+        /** Only the local changes are synced, the remote folders are not listed
+         *
+         * The remote side is read from the journal, so the changes made on the
+         * server are neither downloaded nor detected as conflicts. For backups.
+         */
+        UploadOnly,
+        /** Only the remote changes are synced, the local folders are not listed
+         *
+         * The local side is read from the journal, so the changes made locally
+         * are neither uploaded nor protected from being overwritten by a download.
+         * For read-only distribution folders.
+         */
+        DownloadOnly
+    };
+
+    /** Which changes are synced
+     *
+     * The one-directional modes only apply once the journal has entries, the first
+     * sync of a folder lists both sides.
+     */
+    SyncDirection _syncDirection = SyncDirection::Bidirectional;
+
+    /** The direction called \a name, "both", "upload" or "download" */
+    static std::optional<SyncDirection> syncDirectionFromName(QStringView name);
+    static QString syncDirectionName(SyncDirection direction);
+
+    /** Whether remote folders without any journal entries are listed with a
+     * single Depth: infinity PROPFIND instead of one request per folder.
+     *
+     * Only used if the server supports it, see Capabilities::propfindDepthInfinity().
+     */
+    bool _deepRemoteDiscovery = false;
+
+    /** Whether only the remote directories that changed since the last sync are
+     * listed, with a single sync-collection REPORT.
+     *
+     * Only used if the server supports it, see Capabilities::syncCollectionReport().
+     */
+    bool _deltaRemoteDiscovery = false;
+
+    /** Whether the local discovery skips listing the folders that didn't change
+     *
+     * Without a reliable file watcher every folder is listed. With this option,
+     * between the periodic full local discoveries, a folder whose remote etag and
+     * local fingerprint are unchanged is read from the journal instead, see
+     * LocalDiscoveryStyle::FilesystemUnlessUnchanged. A file modified in place
+     * doesn't change the fingerprint of its folder, such a change is only picked
+     * up by the next full local discovery.
+     */
+    bool _skipUnchangedLocalFolders = false;
+
+    /** Whether discovery reads the journal from an in-memory snapshot
+     * loaded once at the start of the sync, see SyncJournalDb::loadMetadataSnapshot().
+     */
+    bool _journalSnapshotDiscovery = false;
+
+    /** Whether the journal commits of the propagation are batched
+     *
+     * This saves a disk sync per item, at the cost of losing the latest
+     * journal changes on a crash, see SyncJournalDb::CommitMode::Batched.
+     */
+    bool _batchedJournalCommits = false;
+
+    /** Whether the initial sync of a folder propagates the top level directories
+     * while the discovery of the rest of the tree continues.
+     *
+     * Only used while the journal has no file records: without a previous state
+     * there are no moves or deletions, so a completely discovered directory
+     * can't be affected by its siblings.
+     */
+    bool _pipelinedPropagation = false;
+
+    /** Whether the discovery avoids the optimizations that keep large parts of the tree in memory
+     *
+     * For very large trees on machines with little memory: the journal snapshot
+     * and the Depth: infinity listing are not used, even if enabled. Items that
+     * don't need any action are never kept beyond their discovery.
+     */
+    bool _boundedMemoryDiscovery = false;
+
+    /** Whether new files whose content is already on the server are copied there instead of uploaded
+     *
+     * The journal is searched for a file with the same size and content checksum,
+     * which is then duplicated with a WebDAV COPY. Only used for files that are
+     * not smaller than OwncloudPropagator::smallFileSize().
+     */
+    bool _serverSideCopy = false;
+
+    /** Whether changed files whose content checksum equals the journal's are not uploaded
+     *
+     * Only the modification time is set on the server with a PROPPATCH, which
+     * falls back to the upload if the server doesn't accept it. The server offers
+     * no way to build a new version from parts of the old one, so this only covers
+     * the case of no content change.
+     */
+    bool _skipUnchangedContentUploads = false;
+
+    /** Whether a file is uploaded from a copy-on-write snapshot taken before its checksum
+     *
+     * A file that keeps being written, like a database or a disk image, then
+     * uploads the consistent state of the snapshot instead of failing the
+     * checks for changes during the upload in every sync. Only used on file
+     * systems that can clone files, see FileSystem::cloneFile().
+     */
+    bool _snapshotUploads = false;
+
+    /** Whether a remote file that grew is downloaded starting from the unchanged local file
+     *
+     * Only the appended range is requested and the result is verified against the
+     * content checksum from discovery. A file that was rewritten instead of appended
+     * to fails that check and is downloaded again, costing a local copy of the old
+     * size on top of the full download.
+     */
+    bool _appendedDownloads = false;
+
+    /** Whether the sync stops after the reconcile, for measuring the discovery
+     *
+     * The items that need propagating are announced with aboutToPropagate(),
+     * but nothing is propagated and the stale journal entries are kept.
+     */
+    bool _dryRun = false;
+
+    /** The number of threads listing local directories during discovery
+     *
+     * 0 picks a value based on the number of cores, see localDiscoveryThreads().
+     */
+    int _localDiscoveryThreads = 0;
+
+    /** The effective number of local discovery threads */
+    int localDiscoveryThreads() const;
+
+    /** The maximum number of parallel range requests used to download a large file
+     *
+     * 1 downloads every file with a single request.
+     */
+    int _downloadSegments = 1;
+
+    /** The maximum number of chunks of a file that are uploaded at the same time with chunking NG
+     *
+     * The parallel chunks count against OwncloudPropagator::maximumActiveTransferJob().
+     */
+    int _parallelChunkUploads = 1;
+
     /** Reads settings from env vars where available.
      *
      * Currently reads _initialChunkSize, _minChunkSize, _maxChunkSize,
-     * _targetChunkUploadDuration, _parallelNetworkJobs.
+     * _targetChunkUploadDuration, _parallelNetworkJobs, _parallelDiscoveryJobs, _transferConcurrencyMode,
+     * _deepRemoteDiscovery, _deltaRemoteDiscovery, _journalSnapshotDiscovery, _batchedJournalCommits,
+     * _pipelinedPropagation, _boundedMemoryDiscovery, _skipUnchangedLocalFolders, _serverSideCopy,
+     * _skipUnchangedContentUploads, _snapshotUploads, _appendedDownloads, _localDiscoveryThreads, _downloadSegments,
+     * _parallelChunkUploads, _propagationOrder.
      */
     void fillFromEnvironmentVariables();
 
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncplan.h"
+
+#include <algorithm>
+
+using namespace OCC;
+
+namespace {
+bool transfersContent(const SyncFileItem &item)
+{
+    if (item.isDirectory()) {
+        return false;
+    }
+    switch (item.instruction()) {
+    case CSYNC_INSTRUCTION_NEW:
+        [[fallthrough]];
+    case CSYNC_INSTRUCTION_SYNC:
+        [[fallthrough]];
+    case CSYNC_INSTRUCTION_CONFLICT:
+        [[fallthrough]];
+    case CSYNC_INSTRUCTION_TYPE_CHANGE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+qint64 growth(const SyncFileItem &item)
+{
+    // a conflict keeps the previous file as conflict copy
+    if (item.instruction() == CSYNC_INSTRUCTION_NEW || item.instruction() == CSYNC_INSTRUCTION_CONFLICT) {
+        return item._size;
+    }
+    return std::max<qint64>(0, item._size - item._previousSize);
+}
+}
+
+SyncPlan::SyncPlan(const SyncFileItemSet &items)
+{
+    for (const auto &item : items) {
+        if (!transfersContent(*item)) {
+            continue;
+        }
+        if (item->_direction == SyncFileItem::Down) {
+            if (item->_type == ItemTypeVirtualFile) {
+                ++_placeholders;
+                continue;
+            }
+            if (const qint64 bytes = localGrowth(*item); bytes > 0) {
+                _downloads.append({item, bytes});
+                _downloadBytes += bytes;
+            }
+        } else if (item->_direction == SyncFileItem::Up) {
+            if (const qint64 bytes = remoteGrowth(*item); bytes > 0) {
+                _uploads.append({item, bytes});
+                _uploadBytes += bytes;
+            }
+        }
+    }
+}
+
+qint64 SyncPlan::localGrowth(const SyncFileItem &item)
+{
+    if (!transfersContent(item) || item._direction != SyncFileItem::Down) {
+        return 0;
+    }
+    switch (item._type) {
+    case ItemTypeVirtualFile:
+        [[fallthrough]];
+    case ItemTypeVirtualFileDehydration:
+        return 0;
+    case ItemTypeVirtualFileDownload:
+        // the placeholder had no content
+        return item._size;
+    default:
+        return growth(item);
+    }
+}
+
+qint64 SyncPlan::remoteGrowth(const SyncFileItem &item)
+{
+    if (!transfersContent(item) || item._direction != SyncFileItem::Up) {
+        return 0;
+    }
+    return growth(item);
+}
+
+SyncPlan::Shortfall SyncPlan::fitInto(qint64 localBytes, qint64 remoteBytes) const
+{
+    Shortfall shortfall;
+    shortfall.downloads = leftOut(_downloads, _downloadBytes, localBytes, &shortfall.downloadBytes);
+    shortfall.uploads = leftOut(_uploads, _uploadBytes, remoteBytes, &shortfall.uploadBytes);
+    return shortfall;
+}
+
+QVector<SyncFileItemPtr> SyncPlan::leftOut(QVector<Entry> entries, qint64 total, qint64 available, qint64 *bytes)
+{
+    QVector<SyncFileItemPtr> out;
+    if (available < 0 || total <= available) {
+        return out;
+    }
+    // leaving out the largest items first keeps the most files
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.bytes > b.bytes; });
+    for (const auto &entry : std::as_const(entries)) {
+        if (total <= available) {
+            break;
+        }
+        out.append(entry.item);
+        total -= entry.bytes;
+        *bytes += entry.bytes;
+    }
+    return out;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "syncfileitem.h"
+
+#include <QVector>
+
+namespace OCC {
+
+/**
+ * @brief The space the items of a sync need, computed before the propagation
+ * @ingroup libsync
+ *
+ * A download needs the size it adds to the local disk, new virtual files are
+ * placeholders and need nothing. An upload needs the size it adds on the
+ * server. Replaced files only need the difference to their previous size.
+ *
+ * If the space doesn't suffice for everything, fitInto() picks the items that
+ * are left out, the largest first, so that as many files as possible complete.
+ * Without a plan the propagation would run out of space in the middle of the
+ * sync, after transferring gigabytes that are thrown away.
+ */
+class OWNCLOUDSYNC_EXPORT SyncPlan
+{
+public:
+    explicit SyncPlan(const SyncFileItemSet &items);
+
+    /// The bytes the downloads add to the local disk
+    qint64 downloadBytes() const { return _downloadBytes; }
+    /// The bytes the uploads add on the server
+    qint64 uploadBytes() const { return _uploadBytes; }
+
+    /// The number of new virtual files, they use no space
+    qsizetype placeholders() const { return _placeholders; }
+
+    struct Shortfall
+    {
+        /// The downloads that don't fit into the local space
+        QVector<SyncFileItemPtr> downloads;
+        /// The uploads that don't fit into the remote quota
+        QVector<SyncFileItemPtr> uploads;
+
+        qint64 downloadBytes = 0;
+        qint64 uploadBytes = 0;
+
+        bool isEmpty() const { return downloads.isEmpty() && uploads.isEmpty(); }
+    };
+
+    /** The items that have to be left out to stay within \a localBytes and \a remoteBytes
+     *
+     * A negative value means that the space is unknown, all items of the direction fit.
+     */
+    Shortfall fitInto(qint64 localBytes, qint64 remoteBytes) const;
+
+    /// The space \a item adds locally when it is downloaded
+    static qint64 localGrowth(const SyncFileItem &item);
+    /// The space \a item adds on the server when it is uploaded
+    static qint64 remoteGrowth(const SyncFileItem &item);
+
+private:
+    struct Entry
+    {
+        SyncFileItemPtr item;
+        qint64 bytes;
+    };
+
+    static QVector<SyncFileItemPtr> leftOut(QVector<Entry> entries, qint64 total, qint64 available, qint64 *bytes);
+
+    QVector<Entry> _downloads;
+    QVector<Entry> _uploads;
+    qint64 _downloadBytes = 0;
+    qint64 _uploadBytes = 0;
+    qsizetype _placeholders = 0;
+};
+}
@@ -42,6 +42,8 @@ QString Utility::enumToDisplayName(SyncResult::Status status)
         return QStringLiteral("Undefined");
     case SyncResult::Status::NotYetStarted:
         return QStringLiteral("Awaiting sync");
+    case SyncResult::Status::Upgrading:
+        return QStringLiteral("Upgrading the database");
     case SyncResult::Status::SyncRunning:
         return QStringLiteral("Sync running");
     case SyncResult::Status::Success:
@@ -40,6 +40,7 @@ public:
         Undefined,
         Success,
         NotYetStarted,
+        Upgrading,
         SyncPrepare,
         SyncRunning,
         SyncAbortRequested,
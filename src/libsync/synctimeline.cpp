@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "synctimeline.h"
+
+#include "abstractnetworkjob.h"
+#include "httplogger.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+namespace OCC {
+
+void SyncTimeline::start()
+{
+    *this = {};
+    _start = Clock::now();
+}
+
+void SyncTimeline::instant(const QString &file, const char *name, const QJsonObject &args, Clock::time_point time)
+{
+    _events.push_back({thread(file), name, 'i', sinceStart(time), {}, args});
+}
+
+void SyncTimeline::begin(const QString &file, const char *name)
+{
+    _running[thread(file)].append({name, Clock::now()});
+}
+
+void SyncTimeline::end(const QString &file, const char *name, const QJsonObject &args)
+{
+    const auto it = _threads.constFind(file);
+    if (it == _threads.cend()) {
+        return;
+    }
+    const auto &running = _running.at(it.value());
+    const auto span = std::find_if(running.crbegin(), running.crend(), [name](const Span &span) { return qstrcmp(span.name, name) == 0; });
+    if (span != running.crend()) {
+        endSpans(it.value(), std::distance(span, running.crend()) - 1, args);
+    }
+}
+
+void SyncTimeline::endAll(const QString &file)
+{
+    const auto it = _threads.constFind(file);
+    if (it != _threads.cend()) {
+        endSpans(it.value(), 0, {});
+    }
+}
+
+void SyncTimeline::addRequest(const QString &file, const AbstractNetworkJob *job, qint64 bytes)
+{
+    const auto now = Clock::now();
+    const auto start = now - job->duration();
+    const int thread = this->thread(file);
+    const QJsonObject args{{QStringLiteral("verb"), QString::fromLatin1(HttpLogger::requestVerb(*job->reply()))},
+        {QStringLiteral("status"), job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()}, {QStringLiteral("bytes"), bytes}};
+    _events.push_back({thread, "request", 'X', sinceStart(start), duration_cast<microseconds>(now - start), args});
+    if (const auto firstByte = job->timeToFirstByte()) {
+        _events.push_back({thread, "first byte", 'i', sinceStart(start + *firstByte), {}, {}});
+    }
+}
+
+QByteArray SyncTimeline::toJson() const
+{
+    QJsonArray events;
+    for (int i = 0; i < _files.size(); ++i) {
+        events.append(QJsonObject{{QStringLiteral("name"), QStringLiteral("thread_name")}, {QStringLiteral("ph"), QStringLiteral("M")},
+            {QStringLiteral("pid"), 1}, {QStringLiteral("tid"), i}, {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), _files.at(i)}}}});
+    }
+    for (const auto &event : _events) {
+        QJsonObject out{{QStringLiteral("name"), QString::fromLatin1(event.name)}, {QStringLiteral("ph"), QString(QLatin1Char(event.phase))},
+            {QStringLiteral("pid"), 1}, {QStringLiteral("tid"), event.thread}, {QStringLiteral("ts"), static_cast<qint64>(event.time.count())}};
+        if (event.phase == 'X') {
+            out.insert(QStringLiteral("dur"), static_cast<qint64>(event.duration.count()));
+        } else {
+            // scoped to the item
+            out.insert(QStringLiteral("s"), QStringLiteral("t"));
+        }
+        if (!event.args.isEmpty()) {
+            out.insert(QStringLiteral("args"), event.args);
+        }
+        events.append(out);
+    }
+    return QJsonDocument(QJsonObject{{QStringLiteral("traceEvents"), events}, {QStringLiteral("displayTimeUnit"), QStringLiteral("ms")}})
+        .toJson(QJsonDocument::Compact);
+}
+
+int SyncTimeline::thread(const QString &file)
+{
+    auto it = _threads.find(file);
+    if (it == _threads.end()) {
+        it = _threads.insert(file, _files.size());
+        _files.append(file);
+        _running.append({});
+    }
+    return it.value();
+}
+
+microseconds SyncTimeline::sinceStart(Clock::time_point time) const
+{
+    return duration_cast<microseconds>(time - _start);
+}
+
+void SyncTimeline::endSpans(int thread, qsizetype from, const QJsonObject &args)
+{
+    const auto now = Clock::now();
+    auto &running = _running[thread];
+    // the innermost span first, so the outer span gets the args
+    for (qsizetype i = running.size() - 1; i >= from; --i) {
+        const auto &span = running.at(i);
+        _events.push_back({thread, span.name, 'X', sinceStart(span.start), duration_cast<microseconds>(now - span.start), i == from ? args : QJsonObject()});
+    }
+    running.resize(from);
+}
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+#include <chrono>
+#include <vector>
+
+namespace OCC {
+
+class AbstractNetworkJob;
+
+/**
+ * @brief The lifecycle of the items of a sync run
+ * @ingroup libsync
+ *
+ * Records when an item was discovered, how long it was queued, when its checksums
+ * were computed, its requests and when it was written to the journal. The timeline
+ * is written in the Chrome trace event format, each item is a thread of its own,
+ * so chrome://tracing or Perfetto show where the items waited for each other.
+ *
+ * The SyncEngine records a timeline if SyncEngine::setTimelinePath() is set. All of
+ * it happens on the thread of the engine, so there is no locking.
+ */
+class OWNCLOUDSYNC_EXPORT SyncTimeline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Resets the timeline, the times are relative to this call */
+    void start();
+
+    void instant(const QString &file, const char *name, const QJsonObject &args = {}, Clock::time_point time = Clock::now());
+
+    /** Spans of an item nest, end() also ends the spans begun inside \a name, an end of a span that isn't running is ignored */
+    void begin(const QString &file, const char *name);
+    void end(const QString &file, const char *name, const QJsonObject &args = {});
+    /** Ends the running spans of \a file */
+    void endAll(const QString &file);
+
+    /** Records the span and the first byte of a finished request */
+    void addRequest(const QString &file, const AbstractNetworkJob *job, qint64 bytes);
+
+    /** The timeline in the Chrome trace event format */
+    QByteArray toJson() const;
+
+private:
+    struct Span
+    {
+        const char *name;
+        Clock::time_point start;
+    };
+    struct Event
+    {
+        int thread;
+        const char *name;
+        // 'X' for a span or 'i' for an instant
+        char phase;
+        std::chrono::microseconds time;
+        std::chrono::microseconds duration;
+        QJsonObject args;
+    };
+
+    int thread(const QString &file);
+    std::chrono::microseconds sinceStart(Clock::time_point time) const;
+    void endSpans(int thread, qsizetype from, const QJsonObject &args);
+
+    Clock::time_point _start;
+    QHash<QString, int> _threads;
+    // the file and the running spans of each thread
+    QVector<QString> _files;
+    QVector<QVector<Span>> _running;
+    std::vector<Event> _events;
+};
+}
@@ -360,6 +360,8 @@ QString Theme::syncStateIconName(const SyncResult &result) const
     switch (result.status()) {
     case SyncResult::NotYetStarted:
         [[fallthrough]];
+    case SyncResult::Upgrading:
+        [[fallthrough]];
     case SyncResult::SyncRunning:
         return QStringLiteral("sync");
     case SyncResult::SyncAbortRequested:
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "transferconcurrency.h"
+
+#include <QLoggingCategory>
+#include <QtGlobal>
+
+using namespace std::chrono;
+
+namespace {
+// the limit used by the fixed mode, also the limit we start with
+constexpr int InitialLimit = 3;
+
+// relative throughput changes below these are considered noise
+constexpr double ThroughputGain = 1.05;
+constexpr double ThroughputLoss = 0.9;
+
+// a round whose average latency exceeds the best observed one by this factor counts as congested
+constexpr int LatencyCongestionFactor = 2;
+
+// overload replies arriving this long after a back off were sent under the reduced limit
+constexpr auto BackOffRoundDuration = 2s;
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcTransferConcurrency, "sync.propagator.concurrency", QtInfoMsg)
+
+TransferConcurrency::TransferConcurrency()
+    : _limit(InitialLimit)
+    , _maximum(InitialLimit)
+{
+}
+
+void TransferConcurrency::setMaximum(int maximum)
+{
+    _maximum = qMax(1, maximum);
+    _limit = qBound(1, _limit, _maximum);
+}
+
+void TransferConcurrency::reset()
+{
+    _limit = qMin(InitialLimit, _maximum);
+    _lastThroughput = 0;
+    _minLatency = milliseconds::max();
+    startRound();
+}
+
+void TransferConcurrency::startRound()
+{
+    _roundSamples = 0;
+    _roundBytes = 0;
+    _roundLatency = {};
+    _backedOffInRound = false;
+    _backOffErrorSamples = 0;
+    _backOffInFlight = 0;
+    _roundTimer.invalidate();
+    _roundTimerOffset = {};
+}
+
+void TransferConcurrency::addSample(qint64 bytes, milliseconds duration, int httpStatus)
+{
+    if (httpStatus == 429 || httpStatus == 503) {
+        // the server asks us to slow down, only react once per round as all
+        // requests of the round were likely sent under the same conditions
+        if (_backedOffInRound) {
+            // the round after a back off ends once the requests sent with the old limit
+            // were answered or its time elapsed, the overload then persists
+            ++_backOffErrorSamples;
+            if (_backOffErrorSamples < _backOffInFlight && _backOffTimer.elapsed() < duration_cast<milliseconds>(BackOffRoundDuration).count()) {
+                return;
+            }
+        }
+        const int inFlight = _limit;
+        _limit = qMax(1, _limit / 2);
+        qCInfo(lcTransferConcurrency) << "Server is overloaded, reducing parallel transfers to" << _limit;
+        startRound();
+        _backedOffInRound = true;
+        _backOffInFlight = inFlight;
+        _backOffTimer.start();
+        // the throughput measured with the old limit is no longer a useful baseline
+        _lastThroughput = 0;
+        return;
+    }
+    if (httpStatus == 0 || httpStatus >= 400) {
+        // network or application errors tell us nothing about the link capacity
+        return;
+    }
+
+    if (!_roundTimer.isValid()) {
+        // the duration of the first request belongs to the round as well
+        _roundTimer.start();
+        _roundTimerOffset = duration;
+    }
+    _roundSamples++;
+    _roundBytes += bytes;
+    _roundLatency += duration;
+    _minLatency = qMin(_minLatency, duration);
+
+    if (_roundSamples < _limit) {
+        return;
+    }
+
+    const auto elapsed = milliseconds(_roundTimer.elapsed()) + _roundTimerOffset;
+    const double throughput = static_cast<double>(_roundBytes) / qMax<qint64>(1, elapsed.count());
+    const auto averageLatency = _roundLatency / _roundSamples;
+    const bool congested = averageLatency > _minLatency * LatencyCongestionFactor;
+
+    const int oldLimit = _limit;
+    if (_lastThroughput == 0 || throughput > _lastThroughput * ThroughputGain) {
+        if (!congested || _lastThroughput == 0) {
+            _limit = qMin(_limit + 1, _maximum);
+        }
+    } else if (throughput < _lastThroughput * ThroughputLoss || congested) {
+        _limit = qMax(1, _limit - 1);
+    }
+    if (oldLimit != _limit) {
+        qCDebug(lcTransferConcurrency) << "Adjusted parallel transfers from" << oldLimit << "to" << _limit << "throughput:" << throughput
+                                       << "B/ms average latency:" << averageLatency.count() << "ms";
+    }
+
+    _lastThroughput = throughput;
+    startRound();
+}
+
+}
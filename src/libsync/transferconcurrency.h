@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QElapsedTimer>
+
+#include <chrono>
+
+namespace OCC {
+
+/**
+ * @brief Adaptive limit for the number of parallel transfers of an account
+ * @ingroup libsync
+ *
+ * The controller is fed with one sample per finished transfer request and
+ * adjusts the limit once per round, a round being as many samples as the
+ * current limit:
+ *  - the limit grows by one if the aggregated throughput of the round improved,
+ *  - it shrinks by one if the throughput dropped or the latency grew without
+ *    any throughput gain,
+ *  - it is halved on the first 429 or 503 reply of a round, and again if the
+ *    replies persist once the requests sent with the old limit were answered.
+ *
+ * The state lives on the Account, so it is shared by all folders of an account
+ * and survives between sync runs.
+ */
+class OWNCLOUDSYNC_EXPORT TransferConcurrency
+{
+public:
+    TransferConcurrency();
+
+    /** The number of transfers that should currently run in parallel */
+    int limit() const { return _limit; }
+
+    /** The upper bound of limit(), the lower bound is always 1 */
+    int maximum() const { return _maximum; }
+    void setMaximum(int maximum);
+
+    /**
+     * Report a finished transfer request
+     *
+     * \a bytes the amount of payload transferred by the request
+     * \a duration the time from sending the request to receiving the reply
+     * \a httpStatus the http status code of the reply, 0 for network errors
+     */
+    void addSample(qint64 bytes, std::chrono::milliseconds duration, int httpStatus);
+
+    /** Forget all observations and start over with the initial limit */
+    void reset();
+
+private:
+    void startRound();
+
+    int _limit;
+    int _maximum;
+
+    // the observations of the current round
+    QElapsedTimer _roundTimer;
+    std::chrono::milliseconds _roundTimerOffset = {};
+    int _roundSamples = 0;
+    qint64 _roundBytes = 0;
+    std::chrono::milliseconds _roundLatency = {};
+    bool _backedOffInRound = false;
+    // the overload replies since the last back off and the requests that were running then
+    int _backOffErrorSamples = 0;
+    int _backOffInFlight = 0;
+    QElapsedTimer _backOffTimer;
+
+    // bytes per millisecond of the last completed round
+    double _lastThroughput = 0;
+    std::chrono::milliseconds _minLatency = std::chrono::milliseconds::max();
+};
+
+}
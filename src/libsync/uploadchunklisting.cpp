@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "uploadchunklisting.h"
+#include "account.h"
+#include "networkjobs.h"
+
+#include <QLoggingCategory>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcUploadChunkListing, "sync.propagator.uploadchunklisting", QtInfoMsg)
+
+UploadChunkListing::UploadChunkListing(AccountPtr account, QObject *parent)
+    : QObject(parent)
+    , _account(std::move(account))
+{
+}
+
+QString UploadChunkListing::uploadsPath(const AccountPtr &account)
+{
+    return QLatin1String("remote.php/dav/uploads/") + account->davUser();
+}
+
+void UploadChunkListing::start()
+{
+    auto job = new PropfindJob(_account, _account->url(), uploadsPath(_account) + QLatin1Char('/'), PropfindJob::Depth::Infinity, this);
+    job->setProperties({QByteArrayLiteral("resourcetype"), QByteArrayLiteral("getcontentlength")});
+    connect(job, &PropfindJob::directoryListingIterated, this, &UploadChunkListing::addEntry);
+    connect(job, &PropfindJob::finishedWithoutError, this, [this] { finish(true); });
+    connect(job, &PropfindJob::finishedWithError, this, [this, job] {
+        // without an upload collection there are no transfers to resume
+        const int httpStatus = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        _transfers.clear();
+        finish(httpStatus == 404);
+    });
+    job->start();
+}
+
+void UploadChunkListing::addEntry(const QString &name, const QMap<QString, QString> &properties)
+{
+    const QString base = uploadsPath(_account) + QLatin1Char('/');
+    const auto index = name.indexOf(base);
+    if (index < 0) {
+        return; // the upload collection itself
+    }
+    const QString relative = name.mid(index + base.size());
+    bool ok = false;
+    const uint transferId = relative.section(QLatin1Char('/'), 0, 0).toUInt(&ok);
+    if (!ok) {
+        return;
+    }
+    auto &chunks = _transfers[transferId];
+    const QString chunkName = relative.section(QLatin1Char('/'), 1);
+    if (!chunkName.isEmpty() && !chunkName.contains(QLatin1Char('/'))) {
+        chunks.insert(chunkName, properties.value(QStringLiteral("getcontentlength")).toLongLong());
+    }
+}
+
+void UploadChunkListing::finish(bool valid)
+{
+    _valid = valid;
+    _finished = true;
+    qCInfo(lcUploadChunkListing) << "Listed" << _transfers.size() << "unfinished uploads, valid:" << valid;
+    Q_EMIT finished();
+}
+
+}
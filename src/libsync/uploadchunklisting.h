@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "accountfwd.h"
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QMap>
+#include <QObject>
+
+namespace OCC {
+
+/**
+ * @brief The unfinished chunking NG uploads on the server, listed with a single PROPFIND
+ * @ingroup libsync
+ *
+ * Resuming a chunked upload needs the chunks that are on the server already.
+ * Instead of listing the transfer of every resumed upload, the propagator lists
+ * the upload collection of the user once with Depth: infinity, see
+ * OwncloudPropagator::start(). Only used if the server supports it, see
+ * Capabilities::propfindDepthInfinity().
+ */
+class OWNCLOUDSYNC_EXPORT UploadChunkListing : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UploadChunkListing(AccountPtr account, QObject *parent = nullptr);
+
+    void start();
+
+    bool isFinished() const { return _finished; }
+
+    /** Whether the listing succeeded, otherwise every upload lists its own transfer */
+    bool isValid() const { return _valid; }
+
+    /** Whether the transfer \a transferId still exists on the server */
+    bool exists(uint transferId) const { return _transfers.contains(transferId); }
+
+    /** The sizes of the chunks of \a transferId, by their name */
+    QMap<QString, qint64> chunks(uint transferId) const { return _transfers.value(transferId); }
+
+    /** The path of the upload collection of the user, relative to the account url */
+    static QString uploadsPath(const AccountPtr &account);
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    void addEntry(const QString &name, const QMap<QString, QString> &properties);
+    void finish(bool valid);
+
+    AccountPtr _account;
+    QHash<uint, QMap<QString, qint64>> _transfers;
+    bool _finished = false;
+    bool _valid = false;
+};
+
+}
@@ -23,6 +23,7 @@ namespace OCC {
 
 VfsSuffix::VfsSuffix(QObject *parent)
     : Vfs(parent)
+    , _suffix(Theme::instance()->appDotVirtualFileSuffix())
 {
 }
 
@@ -37,7 +38,7 @@ Vfs::Mode VfsSuffix::mode() const
 
 QString VfsSuffix::fileSuffix() const
 {
-    return Theme::instance()->appDotVirtualFileSuffix();
+    return _suffix;
 }
 
 void VfsSuffix::startImpl(const VfsSetupParams &params)
@@ -46,12 +47,13 @@ void VfsSuffix::startImpl(const VfsSetupParams &params)
     // that are not marked as a virtual file. These could be real .owncloud
     // files that were synced before vfs was enabled.
     QByteArrayList toWipe;
-    params.journal->getFilesBelowPath("", [&toWipe](const SyncJournalFileRecord &rec) {
-        if (!rec.isVirtualFile() && rec._path.endsWith(Theme::instance()->appDotVirtualFileSuffix().toUtf8()))
+    const QByteArray suffix = _suffix.toUtf8();
+    params.journal->getFilesBelowPath("", [&toWipe, &suffix](const SyncJournalFileRecord &rec) {
+        if (!rec.isVirtualFile() && rec._path.endsWith(suffix))
             toWipe.append(rec._path);
     });
     for (const auto &path : toWipe) {
-        params.journal->deleteFileRecord(QString::fromUtf8(path));
+        params.journal->deleteFileRecord(path);
     }
     Q_EMIT started();
 }
@@ -119,7 +121,7 @@ Result<void, QString> VfsSuffix::createPlaceholder(const SyncFileItem &item)
 
 bool VfsSuffix::isDehydratedPlaceholder(const QString &filePath)
 {
-    if (!filePath.endsWith(fileSuffix()))
+    if (!filePath.endsWith(_suffix))
         return false;
     QFileInfo fi(filePath);
     return fi.exists() && fi.size() == 1;
@@ -127,7 +129,7 @@ bool VfsSuffix::isDehydratedPlaceholder(const QString &filePath)
 
 bool VfsSuffix::statTypeVirtualFile(csync_file_stat_t *stat, void *)
 {
-    if (stat->path.endsWith(fileSuffix())) {
+    if (stat->path.endsWith(_suffix)) {
         stat->type = ItemTypeVirtualFile;
         return true;
     }
@@ -141,12 +143,10 @@ Vfs::AvailabilityResult VfsSuffix::availability(const QString &folderPath)
 
 QString VfsSuffix::underlyingFileName(const QString &fileName) const
 {
-    {
-        if (fileName.endsWith(fileSuffix())) {
-            return fileName.chopped(fileSuffix().size());
-        }
-        return fileName;
+    if (fileName.endsWith(_suffix)) {
+        return fileName.chopped(_suffix.size());
     }
+    return fileName;
 }
 
 } // namespace OCC
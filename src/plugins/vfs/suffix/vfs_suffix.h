@@ -62,6 +62,10 @@ public Q_SLOTS:
 protected:
     Result<ConvertToPlaceholderResult, QString> updateMetadata(const SyncFileItem &item, const QString &filePath, const QString &replacesFile) override;
     void startImpl(const VfsSetupParams &params) override;
+
+private:
+    // statTypeVirtualFile() is called for every local file, so the suffix is not looked up each time
+    const QString _suffix;
 };
 
 class SuffixVfsPluginFactory : public QObject, public DefaultPluginFactory<VfsSuffix>
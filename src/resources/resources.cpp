@@ -19,8 +19,10 @@
 
 #include "common/asserts.h"
 
+#include <QCache>
 #include <QDebug>
 #include <QFileInfo>
+#include <QGuiApplication>
 #include <QImageReader>
 #include <QJsonDocument>
 #include <QLoggingCategory>
@@ -32,14 +34,22 @@ using namespace Resources;
 Q_LOGGING_CATEGORY(lcResources, "sync.resoruces", QtInfoMsg)
 
 namespace {
+// the cost of the rendered pixmaps is counted in KiB
+constexpr qsizetype pixmapCacheSize = 16 * 1024;
+
 struct IconCache
 {
     IconCache()
     {
         auto *watcher = new ThemeWatcher(qApp);
-        QObject::connect(watcher, &ThemeWatcher::themeChanged, [this]() { _cache.clear(); });
+        QObject::connect(watcher, &ThemeWatcher::themeChanged, [this]() {
+            _cache.clear();
+            _pixmaps.clear();
+        });
     }
-    QMap<QString, QIcon> _cache;
+    QHash<QString, QIcon> _cache;
+    // the pixmaps rendered for the image provider, the same icon is requested for each row of a list
+    QCache<QString, QPixmap> _pixmaps{pixmapCacheSize};
 };
 Q_GLOBAL_STATIC(IconCache, iconCache)
 
@@ -193,6 +203,15 @@ CoreImageProvider::CoreImageProvider()
 }
 QPixmap CoreImageProvider::requestPixmap(const QString &id, QSize *size, const QSize &requestedSize)
 {
+    // the id contains the colour scheme, the cache is cleared when the theme changes
+    const QString key = QStringLiteral("%1@%2x%3@%4").arg(id).arg(requestedSize.width()).arg(requestedSize.height()).arg(qGuiApp->devicePixelRatio());
+    if (const auto *cached = iconCache->_pixmaps.object(key)) {
+        if (size) {
+            *size = requestedSize;
+        }
+        return *cached;
+    }
+
     const auto qmlIcon = QMLResources::parseIcon(id);
 
     QIcon icon;
@@ -203,5 +222,7 @@ QPixmap CoreImageProvider::requestPixmap(const QString &id, QSize *size, const Q
     } else {
         icon = themeIcon(qmlIcon.iconName);
     }
-    return Resources::pixmap(requestedSize, icon, qmlIcon.enabled ? QIcon::Normal : QIcon::Disabled, size);
+    const QPixmap out = Resources::pixmap(requestedSize, icon, qmlIcon.enabled ? QIcon::Normal : QIcon::Disabled, size);
+    iconCache->_pixmaps.insert(key, new QPixmap(out), std::max<qsizetype>(1, out.width() * out.height() * out.depth() / 8 / 1024));
+    return out;
 }
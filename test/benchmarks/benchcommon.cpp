@@ -0,0 +1,297 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Micro benchmarks of the primitives in src/common.
+ *
+ * Run with -iterations n or -minimumvalue ms for stable numbers, see the QTest documentation.
+ */
+
+#include "common/c_jhash.h"
+#include "common/checksums.h"
+#include "common/filesystembase.h"
+#include "common/fixedsizeringbuffer.h"
+#include "common/ownsql.h"
+#include "common/pathhash.h"
+#include "common/remotepermissions.h"
+#include "common/syncjournaldb.h"
+#include "common/utility.h"
+#include "testutils/testutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+namespace {
+// enough entries to leave the caches, like a sync of a large folder
+constexpr int PathCount = 10000;
+
+QVector<QByteArray> makePaths(int count)
+{
+    QVector<QByteArray> out;
+    out.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        out.append(QStringLiteral("Documents/Projects %1/Subfolder %2/a rather long file name %3.docx").arg(i % 17).arg(i % 131).arg(i).toUtf8());
+    }
+    return out;
+}
+}
+
+class BenchCommon : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchJHash64_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::newRow("16 B") << 16;
+        QTest::newRow("256 B") << 256;
+        QTest::newRow("64 KiB") << 64 * 1024;
+    }
+
+    void benchJHash64()
+    {
+        QFETCH(int, size);
+        const QByteArray data(size, 'x');
+        uint64_t hash = 0;
+        QBENCHMARK {
+            hash ^= c_jhash64(reinterpret_cast<const uint8_t *>(data.constData()), data.size(), hash);
+        }
+        QVERIFY(hash != 1);
+    }
+
+    void benchPathHash_data() { benchJHash64_data(); }
+
+    void benchPathHash()
+    {
+        QFETCH(int, size);
+        const QByteArray data(size, 'x');
+        uint64_t hash = 0;
+        QBENCHMARK {
+            hash ^= PathHash::hash(data.constData(), data.size(), hash);
+        }
+        QVERIFY(hash != 1);
+    }
+
+    void benchGetPHash()
+    {
+        const auto paths = makePaths(PathCount);
+        qint64 sum = 0;
+        QBENCHMARK {
+            for (const auto &path : paths) {
+                sum += SyncJournalDb::getPHash(path);
+            }
+        }
+        QVERIFY(sum != 1);
+    }
+
+    void benchParseChecksumHeader_data()
+    {
+        QTest::addColumn<QByteArray>("header");
+        QTest::newRow("SHA1") << QByteArrayLiteral("SHA1:a9993e364706816aba3e25717850c26c9cd0d89d");
+        QTest::newRow("Adler32") << QByteArrayLiteral("Adler32:0a8f0341");
+        QTest::newRow("invalid") << QByteArrayLiteral("Unknown:0a8f0341");
+    }
+
+    void benchParseChecksumHeader()
+    {
+        QFETCH(QByteArray, header);
+        int valid = 0;
+        QBENCHMARK {
+            for (int i = 0; i < PathCount; ++i) {
+                valid += ChecksumHeader::parseChecksumHeader(header).isValid();
+            }
+        }
+        QVERIFY(valid >= 0);
+    }
+
+    void benchFindBestChecksum()
+    {
+        const QByteArray checksums = QByteArrayLiteral(
+            "ADLER32:0a8f0341 MD5:900150983cd24fb0d6963f7d28e17f72 SHA1:a9993e364706816aba3e25717850c26c9cd0d89d SHA256:"
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        int size = 0;
+        QBENCHMARK {
+            for (int i = 0; i < PathCount; ++i) {
+                size += findBestChecksum(checksums).size();
+            }
+        }
+        QVERIFY(size > 0);
+    }
+
+    void benchFixedSizeRingBuffer()
+    {
+        FixedSizeRingBuffer<qint64> buffer(1024);
+        qint64 sum = 0;
+        QBENCHMARK {
+            for (qint64 i = 0; i < 1024 * 1024; ++i) {
+                if (buffer.isFull()) {
+                    sum += buffer.at(0);
+                    buffer.pop_front();
+                }
+                buffer.push_back(std::move(i));
+            }
+        }
+        QVERIFY(sum > 0);
+    }
+
+    void benchSqlInsert()
+    {
+        auto dir = TestUtils::createTempDir();
+        SqlDatabase db;
+        QVERIFY(db.openOrCreateReadWrite(dir.filePath(QStringLiteral("bench.db"))));
+        SqlQuery create("CREATE TABLE IF NOT EXISTS bench(phash INTEGER PRIMARY KEY, path TEXT, size INTEGER);", db);
+        QVERIFY(create.exec());
+
+        const auto paths = makePaths(PathCount);
+        SqlQuery insert("INSERT OR REPLACE INTO bench (phash, path, size) VALUES (?1, ?2, ?3);", db);
+        QBENCHMARK {
+            QVERIFY(db.transaction());
+            for (const auto &path : paths) {
+                insert.reset_and_clear_bindings();
+                insert.bindValue(1, SyncJournalDb::getPHash(path));
+                insert.bindValue(2, path);
+                insert.bindValue(3, path.size());
+                QVERIFY(insert.exec());
+            }
+            QVERIFY(db.commit());
+        }
+    }
+
+    void benchSqlSelect()
+    {
+        auto dir = TestUtils::createTempDir();
+        SqlDatabase db;
+        QVERIFY(db.openOrCreateReadWrite(dir.filePath(QStringLiteral("bench.db"))));
+        SqlQuery create("CREATE TABLE IF NOT EXISTS bench(phash INTEGER PRIMARY KEY, path TEXT, size INTEGER);", db);
+        QVERIFY(create.exec());
+        const auto paths = makePaths(PathCount);
+        {
+            SqlQuery insert("INSERT INTO bench (phash, path, size) VALUES (?1, ?2, ?3);", db);
+            QVERIFY(db.transaction());
+            for (const auto &path : paths) {
+                insert.reset_and_clear_bindings();
+                insert.bindValue(1, SyncJournalDb::getPHash(path));
+                insert.bindValue(2, path);
+                insert.bindValue(3, path.size());
+                QVERIFY(insert.exec());
+            }
+            QVERIFY(db.commit());
+        }
+
+        SqlQuery select("SELECT path, size FROM bench WHERE phash=?1;", db);
+        qint64 size = 0;
+        QBENCHMARK {
+            for (const auto &path : paths) {
+                select.reset_and_clear_bindings();
+                select.bindValue(1, SyncJournalDb::getPHash(path));
+                QVERIFY(select.exec());
+                if (select.next().hasData) {
+                    size += select.baValue(0).size() + select.int64Value(1);
+                }
+            }
+        }
+        QVERIFY(size > 0);
+    }
+
+    void benchJournalSubtreeQueries()
+    {
+        auto dir = TestUtils::createTempDir();
+        SyncJournalDb journal(dir.filePath(QStringLiteral("journal.db")));
+        for (const auto &path : makePaths(PathCount)) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = ItemTypeFile;
+            record._etag = "etag";
+            record._fileId = "id-" + path;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(journal.setFileRecord(record));
+        }
+        journal.commit(QStringLiteral("benchmark"));
+
+        qint64 count = 0;
+        QBENCHMARK {
+            QVERIFY(journal.getFilesBelowPath("Documents/Projects 3", [&](const SyncJournalFileRecord &) { ++count; }));
+            QVERIFY(journal.getFilesBelowPath(QByteArray(), [&](const SyncJournalFileRecord &) { ++count; }));
+            QVERIFY(journal.listFilesInPath("Documents/Projects 3/Subfolder 3", [&](const SyncJournalFileRecord &) { ++count; }));
+        }
+        QVERIFY(count > 0);
+    }
+
+    void benchPathHelpers()
+    {
+        QStringList paths;
+        for (const auto &path : makePaths(PathCount)) {
+            paths.append(QString::fromUtf8(path));
+        }
+        const QString parent = QStringLiteral("Documents/Projects 3");
+        int count = 0;
+        QBENCHMARK {
+            for (const auto &path : std::as_const(paths)) {
+                count += FileSystem::isChildPathOf(path, parent);
+                count += Utility::isConflictFile(path);
+                count += Utility::fileNamesEqual(path, parent);
+            }
+        }
+        QVERIFY(count > 0);
+    }
+
+    void benchDecodeFileName_data()
+    {
+        QTest::addColumn<bool>("ascii");
+        QTest::newRow("ASCII") << true;
+        QTest::newRow("UTF-8") << false;
+    }
+
+    void benchDecodeFileName()
+    {
+        QFETCH(bool, ascii);
+        // the names of a large listing, decoded like csync_vio_local_readdir() does
+        QVector<QByteArray> names;
+        names.reserve(PathCount);
+        for (int i = 0; i < PathCount; ++i) {
+            names.append(FileSystem::encodeFileName((ascii ? QStringLiteral("a rather long file name %1.docx") : QStringLiteral("\u00dcbung %1.docx")).arg(i)));
+        }
+        qint64 size = 0;
+        QBENCHMARK {
+            for (const auto &name : std::as_const(names)) {
+                size += FileSystem::decodeFileName(name.constData()).size();
+            }
+        }
+        QVERIFY(size > 0);
+    }
+
+    void benchNormalizeEtag()
+    {
+        const QString etag = QStringLiteral("\"5f0a1c3b8e2d4-gzip\"");
+        int size = 0;
+        QBENCHMARK {
+            for (int i = 0; i < PathCount; ++i) {
+                size += Utility::normalizeEtag(etag).size();
+            }
+        }
+        QVERIFY(size > 0);
+    }
+
+    void benchRemotePermissions()
+    {
+        const QString serverString = QStringLiteral("SRDNVCKWM");
+        const QByteArray dbValue = RemotePermissions::fromServerString(serverString).toDbValue();
+        int count = 0;
+        QBENCHMARK {
+            for (int i = 0; i < PathCount; ++i) {
+                count += RemotePermissions::fromServerString(serverString).hasPermission(RemotePermissions::CanWrite);
+                count += RemotePermissions::fromDbValue(dbValue).hasPermission(RemotePermissions::CanRename);
+            }
+        }
+        QVERIFY(count > 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(BenchCommon)
+#include "benchcommon.moc"
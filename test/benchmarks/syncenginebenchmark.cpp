@@ -0,0 +1,306 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Times the phases of sync runs on synthetic trees, using the FakeFolder of the tests.
+ *
+ * Every iteration creates a new tree and runs these scenarios on it:
+ *  - initial:     download the whole tree into an empty folder
+ *  - unchanged:   sync again without any change
+ *  - rediscovery: list the whole remote tree again, see SyncJournalDb::forceRemoteDiscoveryNextSync()
+ *  - changes:     modify --change-rate percent of the files, half of them locally, half remotely
+ *  - rename:      rename the first top level directory locally and the second one remotely
+ *
+ * With --journal-snapshot the discovery reads the journal from the in-memory snapshot,
+ * compare the rename scenario with and without it for the cost of the move detection.
+ *
+ * The tree is generated from --seed, so runs with the same arguments are comparable.
+ */
+
+#include "account.h"
+#include "common/syncjournaldb.h"
+#include "configfile.h"
+#include "gui/networkinformation.h"
+#include "resources/loadresources.h"
+#include "syncengine.h"
+#include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace OCC;
+using namespace std::chrono;
+
+namespace {
+
+struct Options
+{
+    int files = 1000;
+    int depth = 3;
+    int fanout = 8;
+    quint64 maximumSize = 64 * 1024;
+    double changeRate = 1;
+    int iterations = 3;
+    quint32 seed = 42;
+    bool journalSnapshot = false;
+};
+
+struct Tree
+{
+    QStringList directories;
+    QStringList files;
+};
+
+Tree generateTree(FileInfo &remote, const Options &options, std::mt19937 &rng)
+{
+    Tree tree;
+    QStringList level = {QString()};
+    for (int d = 0; d < options.depth; ++d) {
+        QStringList next;
+        for (const auto &parent : std::as_const(level)) {
+            for (int i = 0; i < options.fanout; ++i) {
+                const QString path = (parent.isEmpty() ? QString() : parent + QLatin1Char('/')) + QStringLiteral("d%1").arg(i);
+                remote.mkdir(path);
+                next.append(path);
+            }
+        }
+        tree.directories.append(next);
+        level = std::move(next);
+    }
+
+    // file sizes are distributed log-uniformly, like in real trees most files are small
+    std::uniform_int_distribution<int> directory(0, static_cast<int>(tree.directories.size()));
+    std::uniform_real_distribution<double> logSize(0, std::log(static_cast<double>(options.maximumSize)));
+    for (int i = 0; i < options.files; ++i) {
+        const int index = directory(rng);
+        const QString parent = index == tree.directories.size() ? QString() : tree.directories.at(index) + QLatin1Char('/');
+        const QString path = parent + QStringLiteral("f%1").arg(i);
+        remote.insert(path, static_cast<quint64>(std::exp(logSize(rng))));
+        tree.files.append(path);
+    }
+    return tree;
+}
+
+struct Sample
+{
+    QString scenario;
+    microseconds wallTime;
+    SyncMetrics metrics;
+};
+
+bool runIteration(const Options &options, quint32 seed, QVector<Sample> &samples)
+{
+    std::mt19937 rng(seed);
+    FakeFolder fakeFolder(FileInfo{});
+    const Tree tree = generateTree(fakeFolder.remoteModifier(), options, rng);
+    if (options.journalSnapshot) {
+        auto syncOptions = fakeFolder.syncEngine().syncOptions();
+        syncOptions._journalSnapshotDiscovery = true;
+        fakeFolder.syncEngine().setSyncOptions(syncOptions);
+    }
+
+    const auto run = [&](const QString &scenario, auto &&sync) {
+        const auto start = steady_clock::now();
+        if (!sync()) {
+            std::cerr << "Sync failed in scenario " << qPrintable(scenario) << std::endl;
+            return false;
+        }
+        samples.append({scenario, duration_cast<microseconds>(steady_clock::now() - start), fakeFolder.syncEngine().lastSyncMetrics()});
+        return true;
+    };
+
+    if (!run(QStringLiteral("initial"), [&] { return fakeFolder.syncOnce(); })) {
+        return false;
+    }
+    if (!run(QStringLiteral("unchanged"), [&] { return fakeFolder.syncOnce(); })) {
+        return false;
+    }
+    fakeFolder.syncJournal().forceRemoteDiscoveryNextSync();
+    if (!run(QStringLiteral("rediscovery"), [&] { return fakeFolder.syncOnce(); })) {
+        return false;
+    }
+
+    QStringList changed = tree.files;
+    std::shuffle(changed.begin(), changed.end(), rng);
+    changed.resize(std::min<qsizetype>(changed.size(), std::llround(tree.files.size() * options.changeRate / 100)));
+    for (int i = 0; i < changed.size(); ++i) {
+        if (i % 2) {
+            fakeFolder.remoteModifier().appendByte(changed.at(i));
+        } else {
+            fakeFolder.localModifier().appendByte(changed.at(i));
+        }
+    }
+    if (!run(QStringLiteral("changes"), [&] { return fakeFolder.applyLocalModificationsAndSync(); })) {
+        return false;
+    }
+
+    if (options.depth > 0 && options.fanout > 1) {
+        fakeFolder.localModifier().rename(QStringLiteral("d0"), QStringLiteral("d0 renamed"));
+        fakeFolder.remoteModifier().rename(QStringLiteral("d1"), QStringLiteral("d1 renamed"));
+        if (!run(QStringLiteral("rename"), [&] { return fakeFolder.applyLocalModificationsAndSync(); })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double toMilliseconds(nanoseconds value)
+{
+    return duration_cast<duration<double, std::milli>>(value).count();
+}
+
+double median(QVector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    const auto size = values.size();
+    return size % 2 ? values.at(size / 2) : (values.at(size / 2 - 1) + values.at(size / 2)) / 2;
+}
+
+void report(const Options &options, const QVector<Sample> &samples, const QString &jsonPath)
+{
+    const std::array<SyncMetrics::Phase, 4> phases = {
+        SyncMetrics::Phase::Discovery, SyncMetrics::Phase::Reconcile, SyncMetrics::Phase::Propagation, SyncMetrics::Phase::Finalize};
+
+    std::cout << "files=" << options.files << " depth=" << options.depth << " fanout=" << options.fanout << " max-size=" << options.maximumSize
+              << " change-rate=" << options.changeRate << "% iterations=" << options.iterations << " seed=" << options.seed
+              << (options.journalSnapshot ? " journal-snapshot" : "") << "\n\n";
+    std::cout << "median ms      total";
+    for (const auto phase : phases) {
+        std::cout << ' ' << qPrintable(SyncMetrics::phaseName(phase).rightJustified(11));
+    }
+    std::cout << '\n';
+
+    QJsonObject results;
+    QStringList scenarios;
+    for (const auto &sample : samples) {
+        if (!scenarios.contains(sample.scenario)) {
+            scenarios.append(sample.scenario);
+        }
+    }
+    for (const auto &scenario : std::as_const(scenarios)) {
+        QVector<double> totals;
+        std::array<QVector<double>, 4> phaseTimes;
+        QJsonArray runs;
+        for (const auto &sample : samples) {
+            if (sample.scenario != scenario) {
+                continue;
+            }
+            totals.append(toMilliseconds(sample.wallTime));
+            for (size_t i = 0; i < phases.size(); ++i) {
+                phaseTimes[i].append(toMilliseconds(sample.metrics.phaseDuration(phases[i])));
+            }
+            runs.append(sample.metrics.toJson());
+        }
+
+        std::cout << qPrintable(scenario.leftJustified(11)) << qPrintable(QString::number(median(totals), 'f', 1).rightJustified(10));
+        QJsonObject medians{{QStringLiteral("total"), median(totals)}};
+        for (size_t i = 0; i < phases.size(); ++i) {
+            const double value = median(phaseTimes[i]);
+            std::cout << ' ' << qPrintable(QString::number(value, 'f', 1).rightJustified(11));
+            medians.insert(SyncMetrics::phaseName(phases[i]), value);
+        }
+        std::cout << '\n';
+        results.insert(scenario, QJsonObject{{QStringLiteral("median"), medians}, {QStringLiteral("runs"), runs}});
+    }
+    std::cout.flush();
+
+    if (!jsonPath.isEmpty()) {
+        QFile file(jsonPath);
+        if (!file.open(QIODevice::WriteOnly)) {
+            std::cerr << "Failed to write " << qPrintable(jsonPath) << ": " << qPrintable(file.errorString()) << std::endl;
+            return;
+        }
+        const QJsonObject parameters{{QStringLiteral("files"), options.files}, {QStringLiteral("depth"), options.depth},
+            {QStringLiteral("fanout"), options.fanout}, {QStringLiteral("maximumSize"), static_cast<qint64>(options.maximumSize)},
+            {QStringLiteral("changeRate"), options.changeRate}, {QStringLiteral("iterations"), options.iterations},
+            {QStringLiteral("seed"), static_cast<qint64>(options.seed)}, {QStringLiteral("journalSnapshot"), options.journalSnapshot}};
+        file.write(QJsonDocument(QJsonObject{{QStringLiteral("parameters"), parameters}, {QStringLiteral("results"), results}}).toJson());
+    }
+}
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Times the phases of sync runs on synthetic trees."));
+    parser.addHelpOption();
+    const QCommandLineOption filesOption({QStringLiteral("files")}, QStringLiteral("Number of files in the tree (default 1000)"), QStringLiteral("n"));
+    const QCommandLineOption depthOption({QStringLiteral("depth")}, QStringLiteral("Depth of the directory tree (default 3)"), QStringLiteral("n"));
+    const QCommandLineOption fanoutOption({QStringLiteral("fanout")}, QStringLiteral("Subdirectories per directory (default 8)"), QStringLiteral("n"));
+    const QCommandLineOption sizeOption({QStringLiteral("max-size")}, QStringLiteral("Maximum file size in bytes (default 65536)"), QStringLiteral("bytes"));
+    const QCommandLineOption changeRateOption(
+        {QStringLiteral("change-rate")}, QStringLiteral("Percentage of files changed in the changes scenario (default 1)"), QStringLiteral("percent"));
+    const QCommandLineOption iterationsOption({QStringLiteral("iterations")}, QStringLiteral("Number of runs (default 3)"), QStringLiteral("n"));
+    const QCommandLineOption seedOption({QStringLiteral("seed")}, QStringLiteral("Seed of the tree generator (default 42)"), QStringLiteral("n"));
+    const QCommandLineOption jsonOption({QStringLiteral("json")}, QStringLiteral("Write the results to [file]"), QStringLiteral("file"));
+    const QCommandLineOption verboseOption({QStringLiteral("verbose")}, QStringLiteral("Don't silence the sync logs"));
+    const QCommandLineOption journalSnapshotOption({QStringLiteral("journal-snapshot")}, QStringLiteral("Read the journal from an in-memory snapshot"));
+    for (const auto &option : {filesOption, depthOption, fanoutOption, sizeOption, changeRateOption, iterationsOption, seedOption, jsonOption, verboseOption,
+             journalSnapshotOption}) {
+        parser.addOption(option);
+    }
+    parser.process(app);
+
+    Options options;
+    const auto intValue = [&parser](const QCommandLineOption &option, auto &value) {
+        if (parser.isSet(option)) {
+            bool ok;
+            const qlonglong parsed = parser.value(option).toLongLong(&ok);
+            if (!ok || parsed < 0) {
+                std::cerr << "Invalid value for --" << qPrintable(option.names().constFirst()) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            value = static_cast<std::decay_t<decltype(value)>>(parsed);
+        }
+    };
+    intValue(filesOption, options.files);
+    intValue(depthOption, options.depth);
+    intValue(fanoutOption, options.fanout);
+    intValue(sizeOption, options.maximumSize);
+    intValue(iterationsOption, options.iterations);
+    intValue(seedOption, options.seed);
+    if (parser.isSet(changeRateOption)) {
+        options.changeRate = qBound(0.0, parser.value(changeRateOption).toDouble(), 100.0);
+    }
+    options.journalSnapshot = parser.isSet(journalSnapshotOption);
+    options.maximumSize = std::max<quint64>(options.maximumSize, 1);
+    options.iterations = std::max(options.iterations, 1);
+
+    if (!parser.isSet(verboseOption)) {
+        // the sync logs would dominate the measurements
+        QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false\n*.info=false"));
+    }
+
+    // the same environment as the tests, see testutilsloader.cpp
+    static const ResourcesLoader resources;
+    const auto dir = TestUtils::createTempDir();
+    ConfigFile::setConfDir(QStringLiteral("%1/config").arg(dir.path()));
+    Account::setCommonCacheDirectory(QStringLiteral("%1/cache").arg(dir.path()));
+    NetworkInformation::instance();
+
+    QVector<Sample> samples;
+    for (int i = 0; i < options.iterations; ++i) {
+        // every iteration gets its own tree, derived from the seed
+        if (!runIteration(options, options.seed + i, samples)) {
+            return EXIT_FAILURE;
+        }
+    }
+    report(options, samples, parser.value(jsonOption));
+    return EXIT_SUCCESS;
+}
@@ -11,6 +11,7 @@
 
 #include "testutils/testutils.h"
 
+#include <QSignalSpy>
 #include <QTest>
 #include <QAbstractItemModelTester>
 
@@ -48,6 +49,47 @@ private Q_SLOTS:
         });
         model->slotRemoveAccount(AccountManager::instance()->accounts().first());
     }
+
+    void testUpdate()
+    {
+        auto model = new ActivityListModel(this);
+
+        new QAbstractItemModelTester(model, this);
+
+        auto acc1 = TestUtils::createDummyAccount();
+        auto acc2 = TestUtils::createDummyAccount();
+        const auto makeActivity = [](AccountState *acc, const QString &id) {
+            return Activity{Activity::ActivityType, id, acc->account(), QStringLiteral("test"), QStringLiteral("test"), QStringLiteral("foo.cpp"),
+                QUrl(QStringLiteral("https://owncloud.com")), QDateTime::currentDateTime()};
+        };
+        const auto ids = [model] {
+            QStringList out;
+            for (const auto &activity : model->activityList()) {
+                out.append(activity.id());
+            }
+            return out;
+        };
+
+        model->updateActivities(acc1->account()->uuid(), {makeActivity(acc1.get(), QStringLiteral("1")), makeActivity(acc1.get(), QStringLiteral("2"))});
+        model->updateActivities(acc2->account()->uuid(), {makeActivity(acc2.get(), QStringLiteral("a"))});
+        QCOMPARE(ids(), QStringList({QStringLiteral("1"), QStringLiteral("2"), QStringLiteral("a")}));
+
+        QSignalSpy resetSpy(model, &QAbstractItemModel::modelReset);
+        QSignalSpy removeSpy(model, &QAbstractItemModel::rowsRemoved);
+        QSignalSpy insertSpy(model, &QAbstractItemModel::rowsInserted);
+
+        // 1 is gone, 3 is new, the activities of the other account are untouched
+        model->updateActivities(acc1->account()->uuid(), {makeActivity(acc1.get(), QStringLiteral("2")), makeActivity(acc1.get(), QStringLiteral("3"))});
+        QCOMPARE(ids(), QStringList({QStringLiteral("2"), QStringLiteral("a"), QStringLiteral("3")}));
+        QCOMPARE(removeSpy.count(), 1);
+        QCOMPARE(insertSpy.count(), 1);
+
+        // nothing changed
+        model->updateActivities(acc1->account()->uuid(), {makeActivity(acc1.get(), QStringLiteral("2")), makeActivity(acc1.get(), QStringLiteral("3"))});
+        QCOMPARE(removeSpy.count(), 1);
+        QCOMPARE(insertSpy.count(), 1);
+        QCOMPARE(resetSpy.count(), 0);
+    }
 };
 }
 
@@ -13,6 +13,7 @@
 
 #include "testutils/testutils.h"
 
+#include <QSignalSpy>
 #include <QTest>
 #include <QAbstractItemModelTester>
 #include <folder.h>
@@ -57,11 +58,15 @@ private Q_SLOTS:
         }
         model->reset(std::move(tmp));
 
-        // test some inserts
+        // test some inserts, they are inserted together
+        QSignalSpy insertSpy(model, &ProtocolItemModel::rowsInserted);
         for (int i = 0; i < 5; ++i) {
             item->_file = QString::number(i);
             model->addProtocolItem(ProtocolItem { bar, item });
         }
+        QCOMPARE(model->rowCount(), static_cast<int>(size));
+        QVERIFY(insertSpy.wait());
+        QCOMPARE(insertSpy.count(), 1);
 
         const auto oldSize = model->rowCount();
         QCOMPARE(oldSize, model->rawData().capacity());
@@ -0,0 +1,119 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/models/selectivesyncmodel.h"
+
+#include <QAbstractItemModelTester>
+#include <QSignalSpy>
+#include <QTest>
+
+namespace OCC {
+
+class TestSelectiveSyncModel : public QObject
+{
+    Q_OBJECT
+
+    static QVector<RemoteListingCache::Folder> folders(const QString &prefix, int count)
+    {
+        QVector<RemoteListingCache::Folder> out;
+        for (int i = 0; i < count; ++i) {
+            out.append({prefix + QString::number(i), QStringLiteral("etag-%1").arg(i), 10});
+        }
+        return out;
+    }
+
+    static Qt::CheckState checkState(const QModelIndex &index) { return static_cast<Qt::CheckState>(index.data(Qt::CheckStateRole).toInt()); }
+
+private Q_SLOTS:
+    void testPages()
+    {
+        SelectiveSyncModel model;
+        new QAbstractItemModelTester(&model, this);
+        model.sort(0, Qt::AscendingOrder);
+
+        model.setRoot(QStringLiteral("root"), 100, {});
+        model.setListing(QString(), folders(QStringLiteral("dir"), SelectiveSyncModel::PageSize * 2 + 10));
+        const auto root = model.rootIndex();
+        QCOMPARE(model.rowCount(root), SelectiveSyncModel::PageSize);
+        // the rows are sorted like file names
+        QCOMPARE(model.index(0, 0, root).data().toString(), QStringLiteral("dir0"));
+        QCOMPARE(model.index(1, 0, root).data().toString(), QStringLiteral("dir1"));
+        QCOMPARE(model.index(10, 0, root).data().toString(), QStringLiteral("dir10"));
+
+        // a listed folder is not fetched again, its further rows are shown in pages
+        QVERIFY(!model.canFetchMore(root));
+        QVERIFY(model.showMore(root));
+        QCOMPARE(model.rowCount(root), SelectiveSyncModel::PageSize * 2);
+        QVERIFY(model.showMore(root));
+        QCOMPARE(model.rowCount(root), SelectiveSyncModel::PageSize * 2 + 10);
+        QVERIFY(!model.showMore(root));
+
+        // a subfolder is listed once it is fetched
+        QSignalSpy requested(&model, &SelectiveSyncModel::listingRequested);
+        const auto dir = model.index(1, 0, root);
+        QVERIFY(model.hasChildren(dir));
+        QVERIFY(model.canFetchMore(dir));
+        model.fetchMore(dir);
+        QCOMPARE(requested.size(), 1);
+        QCOMPARE(requested[0][0].toString(), QStringLiteral("dir1"));
+        QCOMPARE(requested[0][1].toString(), QStringLiteral("etag-1"));
+        QVERIFY(!model.canFetchMore(dir));
+
+        model.setListing(QStringLiteral("dir1"), folders(QStringLiteral("sub"), 2));
+        QCOMPARE(model.rowCount(dir), 2);
+        QCOMPARE(model.path(model.index(0, 0, dir)), QStringLiteral("dir1/sub0"));
+
+        // a folder without subfolders has no children once it is listed
+        const auto empty = model.index(2, 0, root);
+        model.fetchMore(empty);
+        model.setListing(model.path(empty), {});
+        QVERIFY(!model.hasChildren(empty));
+    }
+
+    void testCheckStates()
+    {
+        SelectiveSyncModel model;
+        new QAbstractItemModelTester(&model, this);
+        model.sort(0, Qt::AscendingOrder);
+
+        model.setRoot(QStringLiteral("root"), 100, {QStringLiteral("dir1/"), QStringLiteral("dir2/sub0/")});
+        model.setListing(QString(), folders(QStringLiteral("dir"), SelectiveSyncModel::PageSize + 1));
+        const auto root = model.rootIndex();
+        QCOMPARE(checkState(root), Qt::PartiallyChecked);
+        QCOMPARE(checkState(model.index(0, 0, root)), Qt::Checked);
+        QCOMPARE(checkState(model.index(1, 0, root)), Qt::Unchecked);
+        QCOMPARE(checkState(model.index(2, 0, root)), Qt::PartiallyChecked);
+        // the old black list is kept for the folders that were not listed
+        QCOMPARE(model.createBlackList(), (QSet<QString>{QStringLiteral("dir1/"), QStringLiteral("dir2/sub0/")}));
+        QCOMPARE(model.estimatedSize(), qint64(-1));
+
+        // unchecking the root unchecks all folders, including the ones that are not shown yet
+        QVERIFY(model.setData(root, Qt::Unchecked, Qt::CheckStateRole));
+        QCOMPARE(checkState(root), Qt::PartiallyChecked);
+        QCOMPARE(model.createBlackList().size(), qsizetype(SelectiveSyncModel::PageSize + 1));
+        QCOMPARE(model.estimatedSize(), qint64(0));
+
+        // checking all folders checks the root
+        QVERIFY(model.setData(root, Qt::Checked, Qt::CheckStateRole));
+        QCOMPARE(checkState(root), Qt::Checked);
+        QVERIFY(model.createBlackList().isEmpty());
+        QCOMPARE(model.estimatedSize(), qint64(100));
+
+        QVERIFY(model.showMore(root));
+        const auto last = model.index(SelectiveSyncModel::PageSize, 0, root);
+        QVERIFY(model.setData(last, Qt::Unchecked, Qt::CheckStateRole));
+        QCOMPARE(checkState(root), Qt::PartiallyChecked);
+        QCOMPARE(model.createBlackList(), QSet<QString>{model.path(last) + QLatin1Char('/')});
+        QCOMPARE(model.estimatedSize(), qint64(SelectiveSyncModel::PageSize * 10));
+        QVERIFY(model.setData(last, Qt::Checked, Qt::CheckStateRole));
+        QCOMPARE(checkState(root), Qt::Checked);
+    }
+};
+}
+
+QTEST_MAIN(OCC::TestSelectiveSyncModel)
+#include "testselectivesyncmodel.moc"
@@ -0,0 +1,129 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "accessmanager.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+namespace {
+
+/// A finished reply of an encrypted connection that got the session ticket \a ticket
+class TicketReply : public QNetworkReply
+{
+public:
+    TicketReply(const QUrl &url, const QByteArray &ticket)
+        : _ticket(ticket)
+    {
+        setUrl(url);
+        open(QIODevice::ReadOnly);
+        setFinished(true);
+    }
+
+    void abort() override { }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+
+    void sslConfigurationImplementation(QSslConfiguration &configuration) const override
+    {
+        configuration = QSslConfiguration::defaultConfiguration();
+        configuration.setSessionTicket(_ticket);
+    }
+
+private:
+    QByteArray _ticket;
+};
+}
+
+class TestAccessManager : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testSessionTickets()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath(QStringLiteral("tls-sessions"));
+        const QUrl url(QStringLiteral("https://cloud.example.com/owncloud/"));
+        const QUrl otherPort(QStringLiteral("https://cloud.example.com:8443/"));
+
+        {
+            AccessManager am;
+            am.setSessionTicketFile(path);
+            TicketReply reply(url, QByteArrayLiteral("ticket"));
+            am.storeSessionTicket(&reply);
+            QVERIFY(QFile::exists(path));
+        }
+
+        // the ticket is resumed after a restart, for the same host and port only
+        AccessManager am;
+        am.setSessionTicketFile(path);
+        auto configuration = QSslConfiguration::defaultConfiguration();
+        am.applySslConfiguration(configuration, url.resolved(QUrl(QStringLiteral("remote.php/dav"))));
+        QCOMPARE(configuration.sessionTicket(), QByteArrayLiteral("ticket"));
+        QVERIFY(!configuration.testSslOption(QSsl::SslOptionDisableSessionPersistence));
+
+        configuration = QSslConfiguration::defaultConfiguration();
+        am.applySslConfiguration(configuration, otherPort);
+        QVERIFY(configuration.sessionTicket().isEmpty());
+
+        // a renewed ticket replaces the stored one
+        TicketReply reply(url, QByteArrayLiteral("renewed"));
+        am.storeSessionTicket(&reply);
+        AccessManager restarted;
+        restarted.setSessionTicketFile(path);
+        configuration = QSslConfiguration::defaultConfiguration();
+        restarted.applySslConfiguration(configuration, url);
+        QCOMPARE(configuration.sessionTicket(), QByteArrayLiteral("renewed"));
+    }
+
+    void testInvalidSessionTicketFile()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath(QStringLiteral("tls-sessions"));
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("garbage");
+        file.close();
+
+        AccessManager am;
+        am.setSessionTicketFile(path);
+        QVERIFY(am._sessionTickets.isEmpty());
+    }
+
+    void testWarmUp()
+    {
+        AccessManager am;
+        // nothing to resume for unencrypted connections
+        am.warmUp(QUrl(QStringLiteral("http://localhost:1/")));
+        QVERIFY(!am._warmedUp);
+
+        am.warmUp(QUrl(QStringLiteral("https://localhost:1/")));
+        QVERIFY(am._warmedUp);
+
+        // the connections are opened again once they were closed
+        am.clearConnections();
+        QVERIFY(!am._warmedUp);
+    }
+
+    void testTransferHttp2Configuration()
+    {
+        // the setters ignore values outside of the range of the protocol
+        const auto configuration = AccessManager::transferHttp2Configuration();
+        QCOMPARE(configuration.sessionReceiveWindowSize(), 0x7fffffffu);
+        QCOMPARE(configuration.streamReceiveWindowSize(), 32u * 1024 * 1024);
+        QCOMPARE(configuration.maxFrameSize(), 1024u * 1024);
+        QVERIFY(configuration.streamReceiveWindowSize() > QHttp2Configuration().streamReceiveWindowSize());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestAccessManager)
+#include "testaccessmanager.moc"
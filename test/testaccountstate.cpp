@@ -0,0 +1,98 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/accountstate.h"
+#include "testutils/syncenginetestutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+class TestAccountState : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testReadyForSync_data()
+    {
+        QTest::addColumn<bool>("storedCapabilities");
+
+        QTest::newRow("stored capabilities") << true;
+        QTest::newRow("no capabilities") << false;
+    }
+
+    void testReadyForSync()
+    {
+        QFETCH(bool, storedCapabilities);
+
+        FakeFolder fakeFolder(FileInfo {});
+        auto *accountState = fakeFolder.accountState();
+        if (!storedCapabilities) {
+            fakeFolder.account()->setCapabilities({fakeFolder.account()->url(), {}});
+            QVERIFY(!fakeFolder.account()->hasCapabilities());
+        }
+
+        // the server settings are requested after a connect, keep them pending
+        QList<QPointer<QNetworkReply>> settingsReplies;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.url().path().contains(QLatin1String("ocs/v2.php/cloud/"))) {
+                settingsReplies.append(new FakeHangingReply(op, request, this));
+                return settingsReplies.last();
+            }
+            return nullptr;
+        });
+
+        QSignalSpy connectedChanged(accountState, &AccountState::isConnectedChanged);
+        accountState->setState(AccountState::Connected);
+        QVERIFY(accountState->isConnected());
+        QTRY_VERIFY(accountState->_fetchCapabilitiesJob);
+        QTRY_VERIFY(!settingsReplies.isEmpty());
+
+        // the capabilities of the last session are used while they are refreshed
+        QCOMPARE(accountState->readyForSync(), storedCapabilities);
+
+        // the refresh still notifies once it is done
+        for (const auto &reply : std::as_const(settingsReplies)) {
+            if (reply) {
+                reply->abort();
+            }
+        }
+        QTRY_VERIFY(!accountState->_fetchCapabilitiesJob);
+        QVERIFY(!connectedChanged.isEmpty());
+    }
+
+    /**
+     * The accounts start connecting right after they were restored, taking them over in the
+     * gui doesn't start a second validation
+     */
+    void testCheckConnectivityOnce()
+    {
+        FakeFolder fakeFolder(FileInfo {});
+        auto *accountState = fakeFolder.accountState();
+        QCOMPARE(accountState->state(), AccountState::Disconnected);
+
+        int statusRequests = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.url().path().endsWith(QLatin1String("status.php"))) {
+                ++statusRequests;
+            }
+            return new FakeHangingReply(op, request, this);
+        });
+
+        accountState->checkConnectivity();
+        // Application only checks the accounts that are still disconnected
+        QCOMPARE(accountState->state(), AccountState::Connecting);
+        QTRY_COMPARE(statusRequests, 1);
+
+        accountState->checkConnectivity();
+        QTest::qWait(100);
+        QCOMPARE(statusRequests, 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestAccountState)
+#include "testaccountstate.moc"
@@ -0,0 +1,72 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/scheduling/bandwidthschedule.h"
+
+#include <QTest>
+
+using namespace OCC;
+
+class TestBandwidthSchedule : public QObject
+{
+    Q_OBJECT
+
+    static ConfigFile::BandwidthProfile uploadProfile(int kbytes)
+    {
+        ConfigFile::BandwidthProfile profile;
+        profile.useUploadLimit = 1;
+        profile.uploadLimit = kbytes;
+        return profile;
+    }
+
+private Q_SLOTS:
+    void testActiveProfile()
+    {
+        const ConfigFile::BandwidthProfile unlimited;
+
+        ConfigFile::BandwidthScheduleEntry officeHours;
+        officeHours.days = {Qt::Monday, Qt::Tuesday, Qt::Wednesday, Qt::Thursday, Qt::Friday};
+        officeHours.start = QTime(8, 0);
+        officeHours.end = QTime(18, 0);
+        officeHours.profile = uploadProfile(100);
+
+        ConfigFile::BandwidthScheduleEntry meteredNights;
+        meteredNights.start = QTime(22, 0);
+        meteredNights.end = QTime(6, 0);
+        meteredNights.network = ConfigFile::BandwidthScheduleEntry::Network::Metered;
+        meteredNights.profile = uploadProfile(10);
+
+        const QVector<ConfigFile::BandwidthScheduleEntry> schedule = {officeHours, meteredNights};
+        // 2024-01-01 is a Monday
+        auto at = [](int day, int hour) { return QDateTime(QDate(2024, 1, day), QTime(hour, 0)); };
+
+        QCOMPARE(BandwidthSchedule::activeProfile(unlimited, schedule, at(1, 9), false), uploadProfile(100));
+        QCOMPARE(BandwidthSchedule::activeProfile(unlimited, schedule, at(1, 18), false), unlimited);
+        // the weekend
+        QCOMPARE(BandwidthSchedule::activeProfile(unlimited, schedule, at(6, 9), false), unlimited);
+
+        // across midnight, only on metered connections
+        QCOMPARE(BandwidthSchedule::activeProfile(unlimited, schedule, at(1, 23), true), uploadProfile(10));
+        QCOMPARE(BandwidthSchedule::activeProfile(unlimited, schedule, at(2, 5), true), uploadProfile(10));
+        QCOMPARE(BandwidthSchedule::activeProfile(unlimited, schedule, at(2, 5), false), unlimited);
+    }
+
+    void testLimits()
+    {
+        ConfigFile::BandwidthProfile profile;
+        profile.useUploadLimit = 1;
+        profile.uploadLimit = 50;
+        profile.useDownloadLimit = -1;
+        const auto limits = BandwidthSchedule::limits(profile);
+        QCOMPARE(limits.upload, 50 * 1000);
+        QCOMPARE(limits.download, -75);
+        QCOMPARE(BandwidthSchedule::limits({}).upload, 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestBandwidthSchedule)
+#include "testbandwidthschedule.moc"
@@ -212,6 +212,39 @@ private Q_SLOTS:
 
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
+
+    void testBlacklistRetryWindow()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/soon"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/later"));
+        ItemCompletedSpy completeSpy(fakeFolder);
+
+        // both failed before, the first one expires within its retry window
+        const qint64 now = Utility::qDateTimeToTime_t(QDateTime::currentDateTimeUtc());
+        const auto remoteState = fakeFolder.currentRemoteState();
+        for (const auto &[name, lastTryTime] : {std::pair{QStringLiteral("A/soon"), now - 95}, std::pair{QStringLiteral("A/later"), now}}) {
+            SyncJournalErrorBlacklistRecord entry;
+            entry._file = name;
+            entry._errorString = QStringLiteral("error");
+            entry._lastTryEtag = remoteState.find(name)->etag;
+            entry._lastTryTime = lastTryTime;
+            entry._ignoreDuration = 100;
+            entry._retryCount = 1;
+            fakeFolder.syncJournal().setErrorBlacklistEntry(entry);
+        }
+
+        QVERIFY(!fakeFolder.applyLocalModificationsAndSync());
+        auto soon = completeSpy.findItem(QStringLiteral("A/soon"));
+        QCOMPARE(soon->instruction(), CSYNC_INSTRUCTION_NEW);
+        QCOMPARE(soon->_status, SyncFileItem::Success);
+        auto later = completeSpy.findItem(QStringLiteral("A/later"));
+        QCOMPARE(later->instruction(), CSYNC_INSTRUCTION_IGNORE);
+        QCOMPARE(later->_status, SyncFileItem::BlacklistedError);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestBlacklist)
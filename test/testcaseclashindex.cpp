@@ -0,0 +1,41 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "libsync/caseclashindex.h"
+
+#include <QTest>
+
+using namespace OCC;
+
+class TestCaseClashIndex : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testMayClash()
+    {
+        CaseClashIndex index;
+        // a folder that was not listed may have any clash
+        QVERIFY(index.mayClash(QStringLiteral("a")));
+
+        index.addFolder(QString(), {QStringLiteral("Dir"), QStringLiteral("dir"), QStringLiteral("other"), QStringLiteral("other"), QStringLiteral("file")});
+        QVERIFY(index.mayClash(QStringLiteral("DIR")));
+        QVERIFY(!index.mayClash(QStringLiteral("other")));
+        QVERIFY(!index.mayClash(QStringLiteral("File")));
+        // the clash of a parent folder counts too
+        QVERIFY(index.mayClash(QStringLiteral("dir/x")));
+        QVERIFY(index.mayClash(QStringLiteral("other/x")));
+
+        index.addFolder(QStringLiteral("other"), {QStringLiteral("x"), QStringLiteral("Y"), QStringLiteral("y")});
+        QVERIFY(!index.mayClash(QStringLiteral("other/x")));
+        QVERIFY(index.mayClash(QStringLiteral("other/y")));
+        QVERIFY(index.mayClash(QStringLiteral("other/x/z")));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestCaseClashIndex)
+#include "testcaseclashindex.moc"
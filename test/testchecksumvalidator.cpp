@@ -113,6 +113,28 @@ private Q_SLOTS:
         QCOMPARE(sSum, sum);
     }
 
+    void testMultipleChecksumsCalc()
+    {
+        const QVector<CheckSums::Algorithm> algorithms{CheckSums::Algorithm::ADLER32, CheckSums::Algorithm::MD5, CheckSums::Algorithm::SHA1};
+        const auto sums = ComputeChecksum::computeNowOnFile(_testfile, algorithms);
+        QCOMPARE(sums.size(), algorithms.size());
+        for (int i = 0; i < algorithms.size(); ++i) {
+            QVERIFY(!sums.at(i).isEmpty());
+            QCOMPARE(sums.at(i), ComputeChecksum::computeNowOnFile(_testfile, algorithms.at(i)));
+        }
+
+        // the incremental calculator gives the same results
+        QFile file(_testfile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray data = file.readAll();
+        for (int i = 0; i < algorithms.size(); ++i) {
+            ChecksumCalculator calculator(algorithms.at(i));
+            calculator.addData(QByteArrayView(data).first(data.size() / 3));
+            calculator.addData(QByteArrayView(data).sliced(data.size() / 3));
+            QCOMPARE(calculator.result(), sums.at(i));
+        }
+    }
+
     void testUploadChecksummingAdler() {
         ComputeChecksum *vali = new ComputeChecksum(this);
         _expectedType = CheckSums::Algorithm::ADLER32;
@@ -205,6 +227,65 @@ private Q_SLOTS:
         delete vali;
     }
 
+    void testValidateComputedChecksum()
+    {
+        ValidateChecksumHeader vali;
+        connect(&vali, &ValidateChecksumHeader::validated, this, &TestChecksumValidator::slotDownValidated);
+        connect(&vali, &ValidateChecksumHeader::validationFailed, this, &TestChecksumValidator::slotDownError);
+
+        _expected = ComputeChecksum::computeNowOnFile(_testfile, CheckSums::Algorithm::SHA1);
+
+        // the signals are emitted synchronously
+        _successDown = false;
+        vali.validate("SHA1:" + _expected, _expected);
+        QVERIFY(_successDown);
+
+        _expectedError = QStringLiteral("The downloaded file does not match the checksum, it will be resumed. '1234' != '%1'").arg(QString::fromUtf8(_expected));
+        _errorSeen = false;
+        vali.validate("SHA1:1234", _expected);
+        QVERIFY(_errorSeen);
+    }
+
+    void benchmarkComputeChecksum_data()
+    {
+        QTest::addColumn<CheckSums::Algorithm>("algorithm");
+        QTest::addColumn<bool>("streamed");
+
+        for (const auto algorithm : {CheckSums::Algorithm::ADLER32, CheckSums::Algorithm::SHA1, CheckSums::Algorithm::SHA256}) {
+            const auto name = Utility::enumToString(algorithm).toUtf8();
+            QTest::newRow(name + " computeNow") << algorithm << false;
+            QTest::newRow(name + " QIODevice") << algorithm << true;
+        }
+    }
+
+    // compares computeNow() with feeding the QIODevice to QCryptographicHash directly
+    void benchmarkComputeChecksum()
+    {
+        QFETCH(CheckSums::Algorithm, algorithm);
+        QFETCH(bool, streamed);
+
+        const QString path = _root.path() + QStringLiteral("/benchmarkFile");
+        if (!QFile::exists(path)) {
+            QVERIFY(TestUtils::writeRandomFile(path, 64 * 1024 * 1024));
+        }
+        if (streamed && algorithm == CheckSums::Algorithm::ADLER32) {
+            QSKIP("QCryptographicHash does not support Adler32");
+        }
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray expected = ComputeChecksum::computeNow(&file, algorithm);
+        QBENCHMARK {
+            file.seek(0);
+            if (streamed) {
+                QCryptographicHash crypto(static_cast<QCryptographicHash::Algorithm>(algorithm));
+                QVERIFY(crypto.addData(&file));
+                QCOMPARE(crypto.result().toHex(), expected);
+            } else {
+                QCOMPARE(ComputeChecksum::computeNow(&file, algorithm), expected);
+            }
+        }
+    }
 
     void cleanupTestCase() {
     }
@@ -116,6 +116,35 @@ private Q_SLOTS:
         QCOMPARE(fakeFolder.uploadState().children.first().name, chunkingId);
     }
 
+    void testParallelChunks()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        setChunkSize(fakeFolder.syncEngine(), 1_MiB);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelChunkUploads = 4;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        const auto size = 10_MiB;
+        fakeFolder.localModifier().insert(QStringLiteral("A/a0"), size);
+
+        int runningPuts = 0;
+        int maximumRunningPuts = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation && request.url().path().contains(QLatin1String("/remote.php/dav/uploads/"))) {
+                auto reply = new FakePutReply(fakeFolder.uploadState(), op, request, device->readAll(), this);
+                maximumRunningPuts = std::max(maximumRunningPuts, ++runningPuts);
+                connect(reply, &QNetworkReply::finished, this, [&] { --runningPuts; });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find(QStringLiteral("A/a0"))->contentSize, size);
+        QVERIFY(maximumRunningPuts > 1);
+        QVERIFY(maximumRunningPuts <= 4);
+    }
+
     // Test resuming when one of the uploaded chunks got removed
     void testResume2() {
         FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
@@ -536,6 +565,46 @@ private Q_SLOTS:
         QVERIFY(fakeFolder.uploadState().children.first().name != chunkingId);
     }
 
+    // Several interrupted uploads are resumed first, with a single listing of the upload collection
+    void testResumeWithOneListing()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        setChunkSize(fakeFolder.syncEngine(), 1_MiB);
+        auto cap = TestUtils::testCapabilities();
+        auto dav = cap.value(QStringLiteral("dav")).toMap();
+        dav.insert(QStringLiteral("propfind"), QVariantMap{{QStringLiteral("depth_infinity"), true}});
+        cap.insert(QStringLiteral("dav"), dav);
+        fakeFolder.account()->setCapabilities({fakeFolder.account()->url(), cap});
+
+        const auto size = 10_MiB;
+        fakeFolder.localModifier().insert(QStringLiteral("A/a0"), size);
+        fakeFolder.localModifier().insert(QStringLiteral("B/b0"), size);
+        QVERIFY(fakeFolder.applyLocalModificationsWithoutSync());
+        auto con = QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::transmissionProgress, [&](const ProgressInfo &progress) {
+            if (progress.completedSize() > progress.totalSize() / 3) {
+                fakeFolder.syncEngine().abort({});
+            }
+        });
+        QVERIFY(!fakeFolder.applyLocalModificationsAndSync());
+        QObject::disconnect(con);
+        QCOMPARE(fakeFolder.uploadState().children.count(), 2);
+        const auto transferIds = fakeFolder.uploadState().children.keys();
+
+        int uploadListings = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND"
+                && request.url().path().contains(QStringLiteral("/uploads/"))) {
+                uploadListings++;
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(uploadListings, 1);
+        // both transfers were continued
+        QCOMPARE(fakeFolder.uploadState().children.keys(), transferIds);
+    }
+
     // Check what happens when the connection is dropped on the PUT (non-chunking) or MOVE (chunking)
     // for on the issue #5106
     void connectionDroppedBeforeEtagRecieved_data()
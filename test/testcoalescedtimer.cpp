@@ -0,0 +1,82 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "libsync/coalescedtimer.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+#include <utility>
+
+using namespace std::chrono_literals;
+using namespace OCC;
+
+class TestCoalescedTimer : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testSharedWakeup()
+    {
+        CoalescedTimer poll;
+        poll.setInterval(200ms);
+        CoalescedTimer check;
+        check.setInterval(240ms);
+        QSignalSpy polled(&poll, &CoalescedTimer::timeout);
+        QSignalSpy checked(&check, &CoalescedTimer::timeout);
+
+        const auto wakeups = CoalescedTimer::wakeups();
+        poll.start();
+        check.start();
+        QVERIFY(polled.wait());
+        // the check was due soon, it fired in the same wakeup
+        QCOMPARE(checked.size(), 1);
+        QCOMPARE(CoalescedTimer::wakeups(), wakeups + 1);
+        QVERIFY(poll.isActive());
+        QVERIFY(check.isActive());
+
+        QVERIFY(polled.wait());
+        QCOMPARE(checked.size(), 2);
+        QCOMPARE(CoalescedTimer::wakeups(), wakeups + 2);
+    }
+
+    void testSingleShot()
+    {
+        CoalescedTimer timer;
+        timer.setSingleShot(true);
+        QSignalSpy fired(&timer, &CoalescedTimer::timeout);
+        timer.start(50ms);
+        QVERIFY(fired.wait());
+        QVERIFY(!timer.isActive());
+        QVERIFY(!fired.wait(200));
+
+        // a stopped timer doesn't fire
+        timer.start();
+        timer.stop();
+        QVERIFY(!fired.wait(200));
+        QCOMPARE(fired.size(), 1);
+    }
+
+    void testDeleteInSlot()
+    {
+        auto *first = new CoalescedTimer;
+        auto *second = new CoalescedTimer;
+        first->setInterval(50ms);
+        second->setInterval(50ms);
+        // whichever fires first deletes the other one
+        connect(first, &CoalescedTimer::timeout, this, [&second] { delete std::exchange(second, nullptr); });
+        connect(second, &CoalescedTimer::timeout, this, [&first] { delete std::exchange(first, nullptr); });
+        first->start();
+        second->start();
+        QVERIFY(QTest::qWaitFor([&] { return !first || !second; }));
+        delete first;
+        delete second;
+    }
+};
+
+QTEST_GUILESS_MAIN(TestCoalescedTimer)
+#include "testcoalescedtimer.moc"
@@ -0,0 +1,59 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "configfile.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+using namespace OCC;
+
+class TestConfigFile : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testWriteThrough()
+    {
+        QSignalSpy changed(ConfigFileNotifier::instance(), &ConfigFileNotifier::valueChanged);
+
+        ConfigFile().setUploadLimit(123);
+        QCOMPARE(ConfigFile().uploadLimit(), 123);
+        QCOMPARE(changed.size(), 1);
+        QCOMPARE(changed[0][0].toString(), QStringLiteral("BWLimit/uploadLimit"));
+        QCOMPARE(QSettings(ConfigFile::configFile(), QSettings::IniFormat).value(QStringLiteral("BWLimit/uploadLimit")).toInt(), 123);
+
+        // an unchanged value is not announced
+        ConfigFile().setUploadLimit(123);
+        QCOMPARE(changed.size(), 1);
+
+        // the values of a connection are prefixed with its group
+        ConfigFile().setRemotePollInterval(std::chrono::minutes(1));
+        QCOMPARE(ConfigFile().remotePollInterval({}).count(), std::chrono::milliseconds(std::chrono::minutes(1)).count());
+        QCOMPARE(changed.size(), 2);
+        QVERIFY(changed[1][0].toString().endsWith(QStringLiteral("/remotePollInterval")));
+    }
+
+    void testExternalChange()
+    {
+        QCOMPARE(ConfigFile().chunkSize(), qint64(10 * 1000 * 1000));
+        QSignalSpy changed(ConfigFileNotifier::instance(), &ConfigFileNotifier::valueChanged);
+        // the config file is watched once it was read
+        QCoreApplication::processEvents();
+
+        // a write that doesn't go through ConfigFile, like the one of an other process
+        QSettings settings(ConfigFile::configFile(), QSettings::IniFormat);
+        settings.setValue(QStringLiteral("chunkSize"), 5000);
+        settings.sync();
+
+        QVERIFY(QTest::qWaitFor([&] { return changed.contains(QVariantList{QStringLiteral("chunkSize")}); }));
+        QCOMPARE(ConfigFile().chunkSize(), qint64(5000));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestConfigFile)
+#include "testconfigfile.moc"
@@ -92,7 +92,8 @@ private Q_SLOTS:
         QFETCH(Values, values);
         QFETCH(ConnectionValidator::Status, status);
 
-        auto reachedStage = FailStage::Invalid;
+        // the authentication, the capabilities and the user are requested at the same time
+        QList<FailStage> reachedStages;
         FakeFolder fakeFolder({});
 
         fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
@@ -100,7 +101,7 @@ private Q_SLOTS:
             const auto verb = HttpLogger::requestVerb(op, request);
             if (op == QNetworkAccessManager::GetOperation) {
                 if (path.endsWith(QLatin1String("status.php"))) {
-                    reachedStage = FailStage::StatusPhp;
+                    reachedStages.append(FailStage::StatusPhp);
                     if (failStage == FailStage::StatusPhp) {
                         if (status == ConnectionValidator::Timeout) {
                             return new FakeHangingReply(op, request, this);
@@ -112,7 +113,7 @@ private Q_SLOTS:
                     }
                     return new FakePayloadReply(op, request, getPayloadTemplated(QStringLiteral("status.php.json.in"), values), this);
                 } else if (path.endsWith(QLatin1String("capabilities"))) {
-                    reachedStage = FailStage::Capabilities;
+                    reachedStages.append(FailStage::Capabilities);
                     if (failStage == FailStage::Capabilities) {
                         if (status == ConnectionValidator::CredentialsWrong) {
                             return new FakeErrorReply(op, request, this, 401);
@@ -122,7 +123,7 @@ private Q_SLOTS:
                     }
                     return new FakePayloadReply(op, request, getPayloadTemplated(QStringLiteral("capabilities.json.in"), values), this);
                 } else if (path.endsWith(QLatin1String("user"))) {
-                    reachedStage = FailStage::UserInfo;
+                    reachedStages.append(FailStage::UserInfo);
                     if (failStage == FailStage::UserInfo) {
                         if (status == ConnectionValidator::CredentialsWrong) {
                             return new FakeErrorReply(op, request, this, 401);
@@ -133,7 +134,7 @@ private Q_SLOTS:
                     return new FakePayloadReply(op, request, getPayload(QStringLiteral("user.json")), this);
                 }
             } else if (failStage == FailStage::AuthValidation && verb == "PROPFIND") {
-                reachedStage = FailStage::AuthValidation;
+                reachedStages.append(FailStage::AuthValidation);
                 if (status == ConnectionValidator::CredentialsWrong) {
                     return new FakeErrorReply(op, request, this, 401);
                 } else if (status == ConnectionValidator::Timeout) {
@@ -153,7 +154,51 @@ private Q_SLOTS:
         QSignalSpy spy(&val, &ConnectionValidator::connectionResult);
         QVERIFY(spy.wait());
         QCOMPARE(spy.first().first().value<ConnectionValidator::Status>(), status);
-        QCOMPARE(reachedStage, failStage);
+        QVERIFY(reachedStages.contains(failStage));
+    }
+
+    void testParallelSettings()
+    {
+        const auto values = Values{{QStringLiteral("maintenance"), QStringLiteral("false")}, {QStringLiteral("version"), QStringLiteral("10.11.0.0")},
+            {QStringLiteral("productversion"), QStringLiteral("4.0.5")}};
+        FakeFolder fakeFolder({});
+
+        QPointer<QNetworkReply> authReply;
+        QPointer<QNetworkReply> capabilitiesReply;
+        bool parallel = true;
+        bool cached = true;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto path = request.url().path();
+            if (op == QNetworkAccessManager::GetOperation) {
+                if (path.endsWith(QLatin1String("status.php"))) {
+                    return new FakePayloadReply(op, request, getPayloadTemplated(QStringLiteral("status.php.json.in"), values), this);
+                } else if (path.endsWith(QLatin1String("capabilities"))) {
+                    // requested while the authentication is still running
+                    parallel &= authReply && !authReply->isFinished();
+                    cached &= request.attribute(QNetworkRequest::CacheSaveControlAttribute).toBool();
+                    capabilitiesReply = new FakePayloadReply(op, request, getPayloadTemplated(QStringLiteral("capabilities.json.in"), values), this);
+                    return capabilitiesReply;
+                } else if (path.endsWith(QLatin1String("user"))) {
+                    // the user doesn't wait for the capabilities
+                    parallel &= capabilitiesReply && !capabilitiesReply->isFinished();
+                    cached &= request.attribute(QNetworkRequest::CacheSaveControlAttribute).toBool();
+                    return new FakePayloadReply(op, request, getPayload(QStringLiteral("user.json")), this);
+                }
+            } else if (HttpLogger::requestVerb(op, request) == "PROPFIND") {
+                authReply = new FakePropfindReply(fakeFolder.remoteModifier(), op, request, this);
+                return authReply;
+            }
+            return nullptr;
+        });
+
+        ConnectionValidator val(fakeFolder.account());
+        QSignalSpy spy(&val, &ConnectionValidator::connectionResult);
+        val.checkServer(ConnectionValidator::ValidationMode::ValidateAuthAndUpdate);
+        QVERIFY(spy.wait());
+        QCOMPARE(spy.first().first().value<ConnectionValidator::Status>(), ConnectionValidator::Connected);
+        QVERIFY(capabilitiesReply);
+        QVERIFY(parallel);
+        QVERIFY(cached);
     }
 };
 
@@ -58,7 +58,7 @@ private Q_SLOTS:
         auto setJob = creds->set(key, data);
         setFallbackEnabled(setJob);
 
-        connect(setJob, &QKeychain::Job::finished, this, [creds, data, key, setJob, this] {
+        connect(setJob, &QKeychain::Job::finished, this, [account = fakeFolder.account().data(), creds, data, key, setJob, this] {
 #ifdef Q_OS_LINUX
             if (!qEnvironmentVariableIsSet("DBUS_SESSION_BUS_ADDRESS")) {
                 QEXPECT_FAIL("", "QKeychain might not use the plaintext fallback and fail if dbus is not present", Abort);
@@ -67,18 +67,26 @@ private Q_SLOTS:
 #endif
             QCOMPARE(setJob->error(), QKeychain::NoError);
             auto getJob = creds->get(key);
-            setFallbackEnabled(getJob->_job);
-            connect(getJob, &CredentialJob::finished, this, [getJob, data, creds, this] {
+            // the value was just written, it is served from memory
+            QVERIFY(!getJob->_job);
+            connect(getJob, &CredentialJob::finished, this, [account, getJob, data, creds, key, this] {
                 QCOMPARE(getJob->error(), QKeychain::NoError);
                 QCOMPARE(getJob->data(), data);
-                const auto jobs = creds->clear();
-                for (auto &job : jobs) {
-                    setFallbackEnabled(job);
-                }
-                connect(jobs[0], &QKeychain::Job::finished, this, [creds, data, jobs, this] {
-                    QCOMPARE(jobs[0]->error(), QKeychain::NoError);
-                    QVERIFY(creds->knownKeys().isEmpty());
-                    _finished = true;
+                // a new manager reads it from the keychain
+                auto keychainGetJob = (new CredentialManager(account))->get(key);
+                setFallbackEnabled(keychainGetJob->_job);
+                connect(keychainGetJob, &CredentialJob::finished, this, [keychainGetJob, data, creds, this] {
+                    QCOMPARE(keychainGetJob->error(), QKeychain::NoError);
+                    QCOMPARE(keychainGetJob->data(), data);
+                    const auto jobs = creds->clear();
+                    for (auto &job : jobs) {
+                        setFallbackEnabled(job);
+                    }
+                    connect(jobs[0], &QKeychain::Job::finished, this, [creds, data, jobs, this] {
+                        QCOMPARE(jobs[0]->error(), QKeychain::NoError);
+                        QVERIFY(creds->knownKeys().isEmpty());
+                        _finished = true;
+                    });
                 });
             });
         });
@@ -6,9 +6,11 @@
  */
 
 
+#include "bandwidthmanager.h"
 #include "owncloudpropagator.h"
 #include "syncengine.h"
 #include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
 
 #include <QtTest>
 
@@ -50,6 +52,24 @@ public:
 };
 
 
+/** A BrokenFakeGetReply whose connection is lost after it sent 'fakeSize' bytes */
+class DroppedFakeGetReply : public BrokenFakeGetReply
+{
+    Q_OBJECT
+public:
+    using BrokenFakeGetReply::BrokenFakeGetReply;
+
+    qint64 readData(char *data, qint64 maxlen) override
+    {
+        const qint64 len = BrokenFakeGetReply::readData(data, maxlen);
+        if (fakeSize == 0) {
+            setError(RemoteHostClosedError, QStringLiteral("Connection closed"));
+        }
+        return len;
+    }
+};
+
+
 SyncFileItemPtr getItem(const QSignalSpy &spy, const QString &path)
 {
     for (const QList<QVariant> &args : spy) {
@@ -184,6 +204,150 @@ private Q_SLOTS:
         }
     }
 
+    void testResumeAfterConnectionLoss()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Dehydrated files are not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/a0"), 30_MiB);
+
+        QByteArrayList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith(QLatin1String("A/a0"))) {
+                ranges.append(request.rawHeader("Range"));
+                if (ranges.size() == 1) {
+                    return new DroppedFakeGetReply(fakeFolder.remoteModifier(), op, request, this);
+                }
+            }
+            return nullptr;
+        });
+
+        // the account state holds back the jobs until the connection was validated again
+        JobQueueGuard queueGuard(fakeFolder.account()->jobQueue());
+        connect(fakeFolder.account().data(), &Account::unknownConnectionState, this, [&] {
+            if (queueGuard.block()) {
+                QTimer::singleShot(100ms, this, [&] { queueGuard.unblock(); });
+            }
+        });
+
+        // the download continues where it stopped, in the same sync
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(ranges, (QByteArrayList{QByteArray(), QByteArrayLiteral("bytes=") + QByteArray::number(stopAfter) + '-'}));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSegmentedDownload()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Dehydrated files are not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._downloadSegments = 4;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        constexpr auto size = 64_MiB;
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big"), size);
+
+        QStringList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith(QLatin1String("A/big"))) {
+                ranges.append(QString::fromUtf8(request.rawHeader("Range")));
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        ranges.sort();
+        QCOMPARE(ranges,
+            QStringList({QStringLiteral("bytes=0-16777215"), QStringLiteral("bytes=16777216-33554431"), QStringLiteral("bytes=33554432-50331647"),
+                QStringLiteral("bytes=50331648-67108863")}));
+
+        // a server that ignores the ranges gets a single request
+        ranges.clear();
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/big"));
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith(QLatin1String("A/big"))) {
+                ranges.append(QString::fromUtf8(request.rawHeader("Range")));
+                QNetworkRequest withoutRange(request);
+                withoutRange.setRawHeader("Range", QByteArray());
+                return new FakeGetReply(fakeFolder.remoteModifier(), op, withoutRange, this);
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(ranges.size(), 5);
+        QCOMPARE(ranges.last(), QString());
+    }
+
+    void testAppendedDownload()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Dehydrated files are not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        constexpr auto size = 2_MiB;
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/log"), size);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        QStringList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith(QLatin1String("A/log"))) {
+                ranges.append(QString::fromUtf8(request.rawHeader("Range")));
+            }
+            return nullptr;
+        });
+        auto setChecksum = [&](qint64 newSize, char contentChar) {
+            fakeFolder.remoteModifier().find(QStringLiteral("A/log"))->checksums =
+                "SHA1:" + QCryptographicHash::hash(QByteArray(newSize, contentChar), QCryptographicHash::Sha1).toHex();
+        };
+
+        // by default the whole file is downloaded
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/log"));
+        setChecksum(size + 1, FileInfo::DefaultContentChar);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(ranges, QStringList{QString()});
+
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._appendedDownloads = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // only the appended data is downloaded
+        ranges.clear();
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/log"));
+        setChecksum(size + 2, FileInfo::DefaultContentChar);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(ranges, QStringList{QStringLiteral("bytes=%1-").arg(size + 1)});
+
+        // a rewritten file doesn't match its checksum and is downloaded again
+        ranges.clear();
+        fakeFolder.remoteModifier().setContents(QStringLiteral("A/log"), size + 10, 'Y');
+        setChecksum(size + 10, 'Y');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(ranges, (QStringList{QStringLiteral("bytes=%1-").arg(size + 2), QString()}));
+
+        // without a checksum the whole file is downloaded
+        ranges.clear();
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/log"));
+        fakeFolder.remoteModifier().find(QStringLiteral("A/log"))->checksums.clear();
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(ranges, QStringList{QString()});
+    }
+
     void testErrorMessage () {
         // This test's main goal is to test that the error string from the server is shown in the UI
 
@@ -302,6 +466,177 @@ private Q_SLOTS:
             QVERIFY(getItem(completeSpy, QStringLiteral("A/resendme"))->_errorString.contains(serverMessage));
         }
     }
+
+    void testLargeReadBuffer()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Nothing is downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        // downloaded at the same time, they share the read buffer
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big1"), 5_MiB, 'X');
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big2"), 3_MiB + 1, 'Y');
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/small"), 100_B, 'Z');
+
+        QMap<QString, qint64> readBufferSizes;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                auto reply = new FakeGetReply(fakeFolder.remoteModifier(), op, request, this);
+                // the job sets the buffer size once the headers arrived
+                connect(reply, &QNetworkReply::finished, reply, [&readBufferSizes, reply] {
+                    readBufferSizes[reply->url().fileName()] = reply->readBufferSize();
+                });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(readBufferSizes.value(QStringLiteral("big1")), qint64(8_MiB));
+        QCOMPARE(readBufferSizes.value(QStringLiteral("big2")), qint64(8_MiB));
+        QCOMPARE(readBufferSizes.value(QStringLiteral("small")), qint64(8_MiB));
+    }
+
+    void testAbsoluteDownloadLimit()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Nothing is downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo {}, vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big1"), 200_KiB);
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big2"), 200_KiB);
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/small"), 10_KiB);
+
+        QStringList completed;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&completed](const SyncFileItemPtr &item) {
+            if (item->_instruction == CSYNC_INSTRUCTION_NEW && !item->isDirectory()) {
+                completed.append(item->_file);
+            }
+        });
+
+        const qint64 limit = 400_KiB;
+        fakeFolder.syncEngine().setNetworkLimits(0, limit);
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        const auto elapsed = timer.elapsed();
+        // the limit is shared by all engines, don't throttle the following tests
+        fakeFolder.syncEngine().setNetworkLimits(0, 0);
+        BandwidthManager::instance()->setCurrentDownloadLimit(0);
+
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        // 410 KiB at 400 KiB/s, the bucket holds at most 200ms worth of tokens
+        QVERIFY2(elapsed >= 700, QByteArray::number(elapsed).constData());
+        // the tokens are shared fairly, the small download isn't starved by the big ones
+        QCOMPARE(completed.size(), 3);
+        QCOMPARE(completed.first(), QStringLiteral("A/small"));
+    }
+
+    void testSharedDownloadLimit()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        if (vfsMode != Vfs::Off) {
+            QSKIP("The second engine doesn't use a vfs");
+        }
+
+        FakeFolder fakeFolder(FileInfo {});
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big1"), 200_KiB);
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big2"), 200_KiB);
+
+        // a second engine downloading the same files
+        auto dir = TestUtils::createTempDir();
+        const QString localPath = dir.path() + QLatin1Char('/');
+        SyncJournalDb journal(localPath + QStringLiteral(".sync_test.db"));
+        SyncEngine engine(fakeFolder.account(), fakeFolder.account()->davUrl(), localPath, QString(), &journal);
+        engine.setSyncOptions(SyncOptions{QSharedPointer<Vfs>(VfsPluginManager::instance().createVfsFromPlugin(Vfs::Off).release())});
+        engine.addManualExclude(QStringLiteral("]*.~*"));
+
+        const qint64 limit = 400_KiB;
+        fakeFolder.syncEngine().setNetworkLimits(0, limit);
+        engine.setNetworkLimits(0, limit);
+        QSignalSpy finished(&engine, &SyncEngine::finished);
+        QSignalSpy fakeFinished(&fakeFolder.syncEngine(), &SyncEngine::finished);
+        QElapsedTimer timer;
+        timer.start();
+        engine.startSync();
+        fakeFolder.syncEngine().startSync();
+        QTRY_COMPARE(finished.size(), 1);
+        QTRY_COMPARE(fakeFinished.size(), 1);
+        const auto elapsed = timer.elapsed();
+        // the limit is shared by all engines, don't throttle the following tests
+        fakeFolder.syncEngine().setNetworkLimits(0, 0);
+        engine.setNetworkLimits(0, 0);
+        BandwidthManager::instance()->setCurrentDownloadLimit(0);
+
+        QVERIFY(finished.first().first().toBool());
+        QVERIFY(fakeFinished.first().first().toBool());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(QFileInfo(localPath + QStringLiteral("A/big2")).size(), qint64(200_KiB));
+        // 800 KiB at 400 KiB/s, one bucket for both engines holds at most 200ms worth of tokens
+        QVERIFY2(elapsed >= 1600, QByteArray::number(elapsed).constData());
+    }
+
+    void testAccountConnectionBudget()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        if (vfsMode != Vfs::Off) {
+            QSKIP("The second engine doesn't use a vfs");
+        }
+
+        FakeFolder fakeFolder(FileInfo {});
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        for (int i = 0; i < 20; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/file%1").arg(i), 10_KiB);
+        }
+        int running = 0;
+        int maxRunning = 0;
+        QObject parent;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            auto *reply = new FakeGetReply(fakeFolder.remoteModifier(), op, request, &parent);
+            maxRunning = std::max(maxRunning, ++running);
+            connect(reply, &QNetworkReply::finished, &parent, [&running] { --running; });
+            return reply;
+        });
+
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelNetworkJobs = 2;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        auto dir = TestUtils::createTempDir();
+        const QString localPath = dir.path() + QLatin1Char('/');
+        SyncJournalDb journal(localPath + QStringLiteral(".sync_test.db"));
+        SyncEngine engine(fakeFolder.account(), fakeFolder.account()->davUrl(), localPath, QString(), &journal);
+        SyncOptions engineOptions{QSharedPointer<Vfs>(VfsPluginManager::instance().createVfsFromPlugin(Vfs::Off).release())};
+        engineOptions._parallelNetworkJobs = 2;
+        engine.setSyncOptions(engineOptions);
+        engine.addManualExclude(QStringLiteral("]*.~*"));
+
+        QSignalSpy finished(&engine, &SyncEngine::finished);
+        QSignalSpy fakeFinished(&fakeFolder.syncEngine(), &SyncEngine::finished);
+        engine.startSync();
+        fakeFolder.syncEngine().startSync();
+        QTRY_COMPARE(finished.size(), 1);
+        QTRY_COMPARE(fakeFinished.size(), 1);
+        QVERIFY(finished.first().first().toBool());
+        QVERIFY(fakeFinished.first().first().toBool());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(QFileInfo(localPath + QStringLiteral("A/file19")).size(), qint64(10_KiB));
+
+        // both engines share the connections of the account
+        QCOMPARE(maxRunning, 2);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestDownload)
@@ -0,0 +1,120 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "graphapi/jobs/drives.h"
+#include "testutils/syncenginetestutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+using namespace GraphApi;
+
+class TestDrives : public QObject
+{
+    Q_OBJECT
+
+    QByteArray _payload;
+
+    struct Response
+    {
+        QByteArray etag;
+        int status = 200;
+        QByteArray body;
+    };
+
+    struct Result
+    {
+        bool finished = false;
+        bool unchanged = false;
+        qsizetype drives = 0;
+        Drives::Revision revision;
+        QByteArray ifNoneMatch;
+    };
+
+    /// Runs a Drives job against a server answering with \a response
+    Result runJob(FakeFolder &fakeFolder, const Drives::Revision &knownRevision, const Response &response)
+    {
+        Result result;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation || !request.url().path().endsWith(QLatin1String("graph/v1.0/me/drives"))) {
+                return nullptr;
+            }
+            result.ifNoneMatch = request.rawHeader("If-None-Match");
+            auto *reply = new FakePayloadReply(op, request, response.body, this);
+            reply->setAttribute(QNetworkRequest::HttpStatusCodeAttribute, response.status);
+            if (!response.etag.isEmpty()) {
+                reply->setRawHeader("ETag", response.etag);
+            }
+            return reply;
+        });
+        // the job deletes itself once it is finished
+        auto *job = new Drives(fakeFolder.account(), knownRevision);
+        connect(job, &Drives::finishedSignal, this, [job, &result] {
+            result.finished = true;
+            result.unchanged = job->isUnchanged();
+            result.drives = job->drives().size();
+            result.revision = job->revision();
+        });
+        job->start();
+        QTest::qWaitFor([&result] { return result.finished; });
+        fakeFolder.setServerOverride({});
+        return result;
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QFile f(QStringLiteral(SOURCEDIR "/test/testspacesmigration/drivespayload.json"));
+        QVERIFY(f.open(QIODevice::ReadOnly));
+        _payload = f.readAll();
+    }
+
+    void testRevision()
+    {
+        FakeFolder fakeFolder(FileInfo {});
+
+        // the first listing is parsed
+        auto result = runJob(fakeFolder, {}, {"\"1\"", 200, _payload});
+        QVERIFY(result.finished);
+        QVERIFY(result.ifNoneMatch.isEmpty());
+        QVERIFY(!result.unchanged);
+        QVERIFY(result.drives > 0);
+        const auto revision = result.revision;
+        QCOMPARE(revision.etag, QByteArrayLiteral("\"1\""));
+        QVERIFY(!revision.bodyHash.isEmpty());
+
+        // the server confirms the etag
+        result = runJob(fakeFolder, revision, {{}, 304, {}});
+        QVERIFY(result.finished);
+        QCOMPARE(result.ifNoneMatch, revision.etag);
+        QVERIFY(result.unchanged);
+        QCOMPARE(result.drives, qsizetype(0));
+        QCOMPARE(result.revision.etag, revision.etag);
+        QCOMPARE(result.revision.bodyHash, revision.bodyHash);
+
+        // a server without etags sends the same body again
+        result = runJob(fakeFolder, {{}, revision.bodyHash}, {{}, 200, _payload});
+        QVERIFY(result.finished);
+        QVERIFY(result.ifNoneMatch.isEmpty());
+        QVERIFY(result.unchanged);
+        QCOMPARE(result.drives, qsizetype(0));
+
+        // a changed body is parsed
+        QByteArray changed = _payload;
+        changed.replace("Katherine Johnson", "Katherine G. Johnson");
+        result = runJob(fakeFolder, revision, {"\"2\"", 200, changed});
+        QVERIFY(result.finished);
+        QCOMPARE(result.ifNoneMatch, revision.etag);
+        QVERIFY(!result.unchanged);
+        QVERIFY(result.drives > 0);
+        QCOMPARE(result.revision.etag, QByteArrayLiteral("\"2\""));
+        QVERIFY(result.revision.bodyHash != revision.bodyHash);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestDrives)
+#include "testdrives.moc"
@@ -0,0 +1,72 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/scheduling/etagwatcher.h"
+#include "httplogger.h"
+#include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+class TestEtagWatcher : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testParentPath()
+    {
+        QCOMPARE(ETagWatcher::parentPath(QStringLiteral("/")), QStringLiteral("/"));
+        QCOMPARE(ETagWatcher::parentPath(QStringLiteral("/A")), QStringLiteral("/"));
+        QCOMPARE(ETagWatcher::parentPath(QStringLiteral("/A/")), QStringLiteral("/"));
+        QCOMPARE(ETagWatcher::parentPath(QStringLiteral("/A/B")), QStringLiteral("/A"));
+    }
+
+    void testBatchedOC10EtagJob()
+    {
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12());
+        auto dir = TestUtils::createTempDir();
+        auto *folderMan = TestUtils::folderMan();
+
+        std::vector<Folder *> folders;
+        for (const auto &name : {QStringLiteral("A"), QStringLiteral("B"), QStringLiteral("missing")}) {
+            QVERIFY(QDir(dir.path()).mkpath(name));
+            auto definition = TestUtils::createDummyFolderDefinition(fakeFolder.account(), dir.path() + QLatin1Char('/') + name);
+            definition.setTargetPath(QLatin1Char('/') + name);
+            auto *folder = folderMan->addFolder(fakeFolder.accountState(), definition);
+            QVERIFY(folder);
+            folders.push_back(folder);
+        }
+
+        QStringList propfinds;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (HttpLogger::requestVerb(op, request) == "PROPFIND") {
+                propfinds.append(QString::fromUtf8(request.rawHeader("Depth")) + QLatin1Char(' ') + request.url().path());
+            }
+            return nullptr;
+        });
+
+        ETagWatcher watcher(folderMan, nullptr);
+        watcher.startBatchedOC10EtagJob(QStringLiteral("/"), folders);
+
+        // one listing of the parent, the folder that isn't listed is asked for on its own
+        QTRY_COMPARE(propfinds.size(), 2);
+        QVERIFY(propfinds[0].startsWith(QStringLiteral("1 ")));
+        QVERIFY(propfinds[1].startsWith(QStringLiteral("0 ")));
+        QVERIFY(propfinds[1].endsWith(QStringLiteral("/missing")));
+        QTest::qWait(100);
+        QCOMPARE(propfinds.size(), 2);
+
+        for (auto *folder : folders) {
+            folderMan->removeFolder(folder);
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(TestEtagWatcher)
+#include "testetagwatcher.moc"
@@ -113,14 +113,16 @@ private Q_SLOTS:
         QCOMPARE(check_file_full(QStringLiteral("/tmp/check_csync2/foo")), CSYNC_NOT_EXCLUDED);
         QVERIFY(excludedFiles->_allExcludes.contains(QStringLiteral("/tmp/check_csync1/*")));
 
-        QVERIFY(excludedFiles->_fullRegexFile.pattern().contains(QStringLiteral("csync1")));
-        QVERIFY(excludedFiles->_fullTraversalRegexFile.pattern().contains(QStringLiteral("csync1")));
-        QVERIFY(!excludedFiles->_bnameTraversalRegexFile.pattern().contains(QStringLiteral("csync1")));
+        QVERIFY(excludedFiles->_compiled->_fullRegexFile.pattern().contains(QStringLiteral("csync1")));
+        QVERIFY(excludedFiles->_compiled->_fullTraversalRegexFile.pattern().contains(QStringLiteral("csync1")));
+        QVERIFY(!excludedFiles->_compiled->_bnameTraversalRegexFile.pattern().contains(QStringLiteral("csync1")));
 
         excludedFiles->addManualExclude(QStringLiteral("foo"));
-        QVERIFY(excludedFiles->_bnameTraversalRegexFile.pattern().contains(QStringLiteral("foo")));
-        QVERIFY(excludedFiles->_fullRegexFile.pattern().contains(QStringLiteral("foo")));
-        QVERIFY(!excludedFiles->_fullTraversalRegexFile.pattern().contains(QStringLiteral("foo")));
+        // literal bname patterns are looked up without the regex
+        QVERIFY(!excludedFiles->_compiled->_bnameTraversalRegexFile.pattern().contains(QStringLiteral("foo")));
+        QCOMPARE(excludedFiles->_compiled->_bnameMatcherFile.match(u"foo"), CSYNC_FILE_EXCLUDE_LIST);
+        QVERIFY(excludedFiles->_compiled->_fullRegexFile.pattern().contains(QStringLiteral("foo")));
+        QVERIFY(!excludedFiles->_compiled->_fullTraversalRegexFile.pattern().contains(QStringLiteral("foo")));
     }
 
     void check_csync_excluded()
@@ -600,6 +602,66 @@ private Q_SLOTS:
         }
     }
 
+    void check_csync_bname_matcher()
+    {
+        setup();
+        excludedFiles->addManualExclude(QStringLiteral("literal"));
+        excludedFiles->addManualExclude(QStringLiteral("]removed"));
+        excludedFiles->addManualExclude(QStringLiteral("prefix*"));
+        excludedFiles->addManualExclude(QStringLiteral("*.suffix"));
+        excludedFiles->addManualExclude(QStringLiteral("dironly*/"));
+        excludedFiles->addManualExclude(QStringLiteral("]both"));
+        excludedFiles->addManualExclude(QStringLiteral("both"));
+        excludedFiles->addManualExclude(QStringLiteral("a*b"));
+        excludedFiles->addManualExclude(QStringLiteral("?x"));
+
+        const auto &fileMatcher = excludedFiles->_bnameMatcherFile;
+        const auto &dirMatcher = excludedFiles->_bnameMatcherDir;
+        QCOMPARE(fileMatcher.match(u"literal"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(fileMatcher.match(u"literals"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(fileMatcher.match(u"removed"), CSYNC_FILE_EXCLUDE_AND_REMOVE);
+        QCOMPARE(fileMatcher.match(u"prefix"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(fileMatcher.match(u"prefix.txt"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(fileMatcher.match(u"file.suffix"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(fileMatcher.match(u"file.suffix2"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(fileMatcher.match(u"dironlyfoo"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(dirMatcher.match(u"dironlyfoo"), CSYNC_FILE_EXCLUDE_LIST);
+        // like in the regex a plain exclude wins
+        QCOMPARE(fileMatcher.match(u"both"), CSYNC_FILE_EXCLUDE_LIST);
+        // the rest is left to the regex
+        QCOMPARE(fileMatcher.match(u"ab"), CSYNC_NOT_EXCLUDED);
+        QVERIFY(excludedFiles->_bnameTraversalRegexFile.pattern().contains(QStringLiteral("a[^/]*b")));
+        QVERIFY(!excludedFiles->_bnameTraversalRegexFile.pattern().contains(QStringLiteral("literal")));
+
+        // the combination of both
+        QCOMPARE(check_file_traversal(QStringLiteral("a/literal")), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal(QStringLiteral("a/removed")), CSYNC_FILE_EXCLUDE_AND_REMOVE);
+        QCOMPARE(check_file_traversal(QStringLiteral("a/aXb")), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal(QStringLiteral("a/xx")), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal(QStringLiteral("a/dironly")), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(check_dir_traversal(QStringLiteral("a/dironly")), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal(QStringLiteral("a/other")), CSYNC_NOT_EXCLUDED);
+    }
+
+    void check_csync_excluded_performance3()
+    {
+        // bnames hitting the different kinds of patterns of the default exclude list
+        setup_init();
+        const QStringList paths = {QStringLiteral("dir/.DS_Store"), QStringLiteral("dir/~$document.docx"), QStringLiteral("dir/download.part"),
+            QStringLiteral("dir/.file.swp"), QStringLiteral("dir/regular file.txt"), QStringLiteral("dir/subdir/another.pdf")};
+        const int N = 1000;
+        int totalRc = 0;
+
+        QBENCHMARK {
+            for (int i = 0; i < N; ++i) {
+                for (const auto &path : paths) {
+                    totalRc += check_file_traversal(path);
+                }
+            }
+        }
+        QVERIFY(totalRc > 0); // mainly to avoid optimization
+    }
+
     void check_csync_exclude_expand_escapes()
     {
         extern void csync_exclude_expand_escapes(QByteArray &input);
@@ -643,6 +705,27 @@ private Q_SLOTS:
         }
     }
 
+    void testSharedPatterns()
+    {
+        ExcludedFiles first;
+        ExcludedFiles second;
+        for (auto *excludes : {&first, &second}) {
+            excludes->addExcludeFilePath(excludeListFileC);
+            QVERIFY(excludes->reloadExcludeFiles());
+        }
+        // the patterns are compiled once
+        QCOMPARE(first._compiled.get(), second._compiled.get());
+
+        // a manual exclude only changes the instance it was added to
+        second.addManualExclude(QStringLiteral("foo"));
+        QVERIFY(first._compiled != second._compiled);
+        QCOMPARE(first.traversalPatternMatch(u"foo", ItemTypeFile), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(second.traversalPatternMatch(u"foo", ItemTypeFile), CSYNC_FILE_EXCLUDE_LIST);
+
+        second.clearManualExcludes();
+        QCOMPARE(first._compiled.get(), second._compiled.get());
+    }
+
 };
 
 QTEST_APPLESS_MAIN(TestExcludedFiles)
@@ -20,11 +20,19 @@
 #include "common/filesystembase.h"
 #include "csync/csync.h"
 #include "csync/vio/csync_vio_local.h"
+#include "libsync/filesystem.h"
 #include "testutils/testutils.h"
 
+#include <QFileInfo>
 #include <QTemporaryFile>
 #include <QTest>
 
+#include <map>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
 
 class TestFileSystem : public QObject
 {
@@ -205,6 +213,174 @@ private Q_SLOTS:
         }
         csync_vio_local_closedir(dh);
     }
+
+    void testFileNameEncoding_data()
+    {
+        QTest::addColumn<QString>("name");
+        QTest::newRow("ASCII") << QStringLiteral("a file name.txt");
+#ifdef Q_OS_UNIX
+        QTest::newRow("UTF-8") << QStringLiteral("\u00dcbung \u65e5\u672c.txt");
+#endif
+    }
+
+    void testFileNameEncoding()
+    {
+        QFETCH(QString, name);
+        const QByteArray encoded = OCC::FileSystem::encodeFileName(name);
+        QCOMPARE(encoded, name.toLocal8Bit());
+        QCOMPARE(OCC::FileSystem::decodeFileName(encoded.constData()), name);
+    }
+
+    void testReaddirAll()
+    {
+        auto tmp = OCC::TestUtils::createTempDir();
+        QVERIFY(OCC::FileSystem::mkpath(tmp.path(), QStringLiteral("dir")));
+        for (int i = 0; i < 1000; ++i) {
+            QFile f(tmp.path() + QStringLiteral("/file%1").arg(i));
+            QVERIFY(f.open(QFile::WriteOnly));
+            QCOMPARE(f.write(QByteArray(i, 'x')), qint64(i));
+        }
+
+        std::map<QString, csync_file_stat_t> expected;
+        auto dh = csync_vio_local_opendir(tmp.path());
+        QVERIFY(dh);
+        while (auto fs = csync_vio_local_readdir(dh, nullptr)) {
+            expected[fs->path] = *fs;
+        }
+        csync_vio_local_closedir(dh);
+        QCOMPARE(expected.size(), size_t(1001));
+
+        std::vector<csync_file_stat_t> entries;
+        dh = csync_vio_local_opendir(tmp.path());
+        QVERIFY(dh);
+        QVERIFY(csync_vio_local_readdir_all(dh, nullptr, &entries));
+        csync_vio_local_closedir(dh);
+        QCOMPARE(entries.size(), expected.size());
+        for (const auto &entry : entries) {
+            const auto it = expected.find(entry.path);
+            QVERIFY(it != expected.end());
+            QCOMPARE(entry.type, it->second.type);
+            QCOMPARE(entry.size, it->second.size);
+            QCOMPARE(entry.modtime, it->second.modtime);
+            QCOMPARE(entry.inode, it->second.inode);
+        }
+    }
+
+    void testPreallocate()
+    {
+        auto tmp = OCC::TestUtils::createTempDir();
+        QFile file(tmp.path() + QStringLiteral("/download"));
+        // only open files can be preallocated
+        QVERIFY(!OCC::FileSystem::preallocate(file, 1024 * 1024));
+
+        QVERIFY(file.open(QFile::WriteOnly));
+        QCOMPARE(file.write(QByteArray(100, 'x')), qint64(100));
+        QVERIFY(file.flush());
+        // nothing is missing
+        QVERIFY(!OCC::FileSystem::preallocate(file, 100));
+
+        const qint64 size = 8 * 1024 * 1024;
+        const bool preallocated = OCC::FileSystem::preallocate(file, size);
+#ifdef Q_OS_LINUX
+        // unless the file system doesn't support it the space is reserved
+        if (preallocated) {
+            struct stat st;
+            QCOMPARE(fstat(file.handle(), &st), 0);
+            QVERIFY(qint64(st.st_blocks) * 512 >= size);
+        }
+#else
+        Q_UNUSED(preallocated);
+#endif
+        // the size is kept, resuming downloads relies on it
+        QCOMPARE(file.size(), qint64(100));
+        QCOMPARE(QFileInfo(file.fileName()).size(), qint64(100));
+
+        QCOMPARE(file.write(QByteArray(100, 'y')), qint64(100));
+        file.close();
+        QCOMPARE(QFileInfo(file.fileName()).size(), qint64(200));
+    }
+
+    void testCopyFile()
+    {
+        auto tmp = OCC::TestUtils::createTempDir();
+        const QString source = tmp.path() + QStringLiteral("/source");
+        const QString target = tmp.path() + QStringLiteral("/target");
+        const QByteArray data = QByteArray(3 * 1024 * 1024, 'x') + QByteArray(100, 'y');
+        {
+            QFile file(source);
+            QVERIFY(file.open(QFile::WriteOnly));
+            QCOMPARE(file.write(data), qint64(data.size()));
+        }
+
+        QString error;
+        QVERIFY(OCC::FileSystem::copyFile(source, target, &error));
+        QFile copy(target);
+        QVERIFY(copy.open(QFile::ReadOnly));
+        QCOMPARE(copy.readAll(), data);
+        copy.close();
+
+        // a clone is independent of its source
+        {
+            QFile file(source);
+            QVERIFY(file.open(QFile::ReadWrite));
+            QCOMPARE(file.write("z"), qint64(1));
+        }
+        QVERIFY(copy.open(QFile::ReadOnly));
+        QCOMPARE(copy.read(1), QByteArrayLiteral("x"));
+        copy.close();
+
+        // an existing target is not overwritten
+        QVERIFY(!OCC::FileSystem::copyFile(source, target, &error));
+        QVERIFY(!error.isEmpty());
+        QVERIFY(!OCC::FileSystem::copyFile(tmp.path() + QStringLiteral("/missing"), tmp.path() + QStringLiteral("/other")));
+        QVERIFY(!QFileInfo::exists(tmp.path() + QStringLiteral("/other")));
+    }
+
+    void testFileState()
+    {
+        auto tmp = OCC::TestUtils::createTempDir();
+        const QString path = tmp.path() + QStringLiteral("/file");
+        QVERIFY(!OCC::FileSystem::fileState(path).exists);
+        QVERIFY(!OCC::FileSystem::fileChanged(OCC::FileSystem::fileState(path), 0, -1));
+
+        QFile file(path);
+        QVERIFY(file.open(QFile::WriteOnly));
+        QCOMPARE(file.write("data"), qint64(4));
+        file.close();
+        QVERIFY(OCC::FileSystem::setModTime(path, 1000000));
+
+        const auto state = OCC::FileSystem::fileState(path);
+        QVERIFY(state.exists);
+        QCOMPARE(state.size, qint64(4));
+        QCOMPARE(state.modtime, time_t(1000000));
+        quint64 inode = 0;
+        QVERIFY(OCC::FileSystem::getInode(path, &inode));
+        QCOMPARE(state.inode, inode);
+        QVERIFY(!OCC::FileSystem::fileChanged(state, 4, 1000000, inode));
+        QVERIFY(OCC::FileSystem::fileChanged(state, 5, 1000000));
+        QVERIFY(OCC::FileSystem::fileChanged(state, 4, 1000001));
+        QVERIFY(OCC::FileSystem::fileChanged(state, 4, 1000000, inode + 1));
+
+        QVERIFY(file.open(QFile::ReadOnly));
+        QCOMPARE(OCC::FileSystem::fileState(file).size, qint64(4));
+        QCOMPARE(OCC::FileSystem::fileState(file).inode, inode);
+#ifndef Q_OS_WIN
+        // the state of an open file is the one of the opened file, even after its path was replaced
+        const QString other = tmp.path() + QStringLiteral("/other");
+        {
+            QFile otherFile(other);
+            QVERIFY(otherFile.open(QFile::WriteOnly));
+            QCOMPARE(otherFile.write("other data"), qint64(10));
+        }
+        QString error;
+        QVERIFY(OCC::FileSystem::uncheckedRenameReplace(other, path, &error));
+        const auto openState = OCC::FileSystem::fileState(file);
+        QVERIFY(openState.exists);
+        QCOMPARE(openState.size, qint64(4));
+        QCOMPARE(openState.inode, inode);
+        QCOMPARE(OCC::FileSystem::fileState(path).size, qint64(10));
+#endif
+    }
 };
 
 QTEST_GUILESS_MAIN(TestFileSystem)
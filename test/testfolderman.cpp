@@ -161,6 +161,44 @@ private Q_SLOTS:
         }
     }
 
+    void testStartUpOneAtATime()
+    {
+        auto dir = TestUtils::createTempDir();
+        QVERIFY(dir.isValid());
+        FolderMan *folderman = TestUtils::folderMan();
+        // the folders of the previous tests
+        QTRY_VERIFY(folderman->_pendingStartUps.isEmpty());
+
+        auto newAccountState = TestUtils::createDummyAccount();
+        QList<Folder *> folders;
+        for (const auto &name : {QStringLiteral("one"), QStringLiteral("two"), QStringLiteral("three")}) {
+            QVERIFY(QDir(dir.path()).mkpath(name));
+            auto *folder = folderman->addFolder(
+                newAccountState.get(), TestUtils::createDummyFolderDefinition(newAccountState->account(), dir.path() + QLatin1Char('/') + name));
+            QVERIFY(folder);
+            folders.append(folder);
+        }
+        // nothing is started in the constructor
+        QCOMPARE(folderman->_pendingStartUps.size(), folders.size());
+        for (auto *folder : std::as_const(folders)) {
+            QVERIFY(!folder->isReady());
+        }
+
+        // one folder per iteration of the event loop
+        QList<qsizetype> pending;
+        connect(&folderman->_startUpTimer, &QTimer::timeout, this, [&] { pending.append(folderman->_pendingStartUps.size()); });
+        QTRY_VERIFY(folderman->_pendingStartUps.isEmpty());
+        QCOMPARE(pending, (QList<qsizetype>{2, 1, 0}));
+        for (auto *folder : std::as_const(folders)) {
+            QTRY_VERIFY(folder->isReady());
+        }
+        disconnect(&folderman->_startUpTimer, &QTimer::timeout, this, nullptr);
+
+        for (auto *folder : std::as_const(folders)) {
+            folderman->removeFolder(folder);
+        }
+    }
+
     void testFindGoodPathForNewSyncFolder()
     {
         // SETUP
@@ -20,6 +20,7 @@ class FolderWatcherForTests : public OCC::FolderWatcher
     Q_OBJECT
 public:
     using OCC::FolderWatcher::FolderWatcher;
+    using OCC::FolderWatcher::changeDetected;
 
     bool pathIsIgnored(const QString &) const override { return false; }
 };
@@ -97,7 +98,7 @@ class TestFolderWatcher : public QObject
     bool waitForPathChanged(const QString &path)
     {
         Utility::ChronoElapsedTimer t;
-        // Current interval is 10s, if we didn't get a change in 15s something did not work
+        // Changes are reported after at most 10s, if we didn't get a change in 15s something did not work
         // https://github.com/owncloud/client/blob/82b5a1e1bb2b05503e0774d3be5e328c4cd207e2/src/gui/folderwatcher.cpp#L40-L40
         while (t.duration() < 15s) {
             // Check if it was already reported as changed by the watcher
@@ -134,6 +135,8 @@ public:
         TestUtils::writeRandomFile(_rootPath + QStringLiteral("/a2/renamefile"));
         TestUtils::writeRandomFile(_rootPath + QStringLiteral("/a1/movefile"));
 
+        // the watch count checks are for the inotify backend
+        qputenv("OWNCLOUD_DISABLE_FANOTIFY", "1");
         _watcher.reset(new FolderWatcherForTests);
         _watcher->init(_rootPath);
         _pathChangedSpy.reset(new QSignalSpy(_watcher.data(), &FolderWatcher::pathChanged));
@@ -265,6 +268,30 @@ private Q_SLOTS:
         mkdir(dir);
         QVERIFY(waitForPathChanged(dir));
     }
+
+    void testAdaptiveQuietPeriod()
+    {
+        FolderWatcherForTests watcher;
+        QSignalSpy spy(&watcher, &FolderWatcher::pathChanged);
+
+        // an isolated change is reported quickly
+        watcher.changeDetected({_rootPath + QStringLiteral("/a1/document.txt")});
+        QVERIFY(watcher.quietPeriod() < 2s);
+
+        // a burst extends the quiet period
+        QSet<QString> burst;
+        for (int i = 0; i < 1000; ++i) {
+            burst.insert(_rootPath + QStringLiteral("/a1/build/file%1").arg(i));
+        }
+        watcher.changeDetected(burst);
+        QVERIFY(watcher.quietPeriod() > 2s);
+        QVERIFY(watcher.quietPeriod() < FolderWatcher::maximumDelay());
+
+        // all changes are reported at once
+        QVERIFY(spy.wait(std::chrono::milliseconds(FolderWatcher::maximumDelay() + 5s).count()));
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.first().first().value<QSet<QString>>().size(), 1001);
+    }
 };
 
 #ifdef Q_OS_MAC
@@ -0,0 +1,90 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "httplogger.h"
+#include "testutils/syncenginetestutils.h"
+
+#include <QtTest>
+
+#include <cstring>
+
+using namespace OCC;
+
+class TestHttpLogger : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _tempDir;
+
+    QString tracePath() const { return _tempDir.filePath(QStringLiteral("http.trace")); }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(_tempDir.isValid());
+        // read when the first request is logged
+        qputenv("OWNCLOUD_HTTP_TRACE_FILE", tracePath().toLocal8Bit());
+    }
+
+    void testTrace()
+    {
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12());
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/downloaded"), 1234);
+        fakeFolder.localModifier().insert(QStringLiteral("A/uploaded"), 4321);
+
+        QMap<uint64_t, QByteArray> requests;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            requests.insert(HttpLogger::traceUrlHash(request.url()), HttpLogger::requestVerb(op, request));
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QVERIFY(!requests.isEmpty());
+        HttpLogger::flushTrace();
+
+        QFile file(tracePath());
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray data = file.readAll();
+        QVERIFY(data.size() > qsizetype(sizeof(HttpLogger::TraceHeader)));
+
+        HttpLogger::TraceHeader header;
+        std::memcpy(&header, data.constData(), sizeof(header));
+        QCOMPARE(header.magic, HttpLogger::TraceHeader::Magic);
+        QCOMPARE(header.version, HttpLogger::TraceHeader::Version);
+        QCOMPARE(header.recordSize, uint32_t(sizeof(HttpLogger::TraceRecord)));
+        QCOMPARE((data.size() - sizeof(header)) % sizeof(HttpLogger::TraceRecord), size_t(0));
+
+        bool foundDownload = false;
+        bool foundUpload = false;
+        for (qsizetype pos = sizeof(header); pos < data.size(); pos += sizeof(HttpLogger::TraceRecord)) {
+            HttpLogger::TraceRecord record;
+            std::memcpy(&record, data.constData() + pos, sizeof(record));
+            QVERIFY(record.verb > 0 && record.verb <= HttpLogger::traceVerbs().size());
+            const auto it = requests.constFind(record.urlHash);
+            if (it == requests.cend()) {
+                // from the initial sync of the FakeFolder
+                continue;
+            }
+            QCOMPARE(HttpLogger::traceVerbs().at(record.verb - 1), it.value());
+            QVERIFY(!(record.flags & HttpLogger::TraceRecord::Error));
+            if (it.value() == QByteArrayLiteral("GET")) {
+                QCOMPARE(record.httpStatus, uint16_t(200));
+                foundDownload = true;
+            } else if (it.value() == QByteArrayLiteral("PUT")) {
+                QCOMPARE(record.requestSize, int64_t(4321));
+                foundUpload = true;
+            }
+            requests.erase(it);
+        }
+        // every request of the sync was traced
+        QVERIFY(requests.isEmpty());
+        QVERIFY(foundDownload);
+        QVERIFY(foundUpload);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestHttpLogger)
+#include "testhttplogger.moc"
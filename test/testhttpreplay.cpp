@@ -0,0 +1,105 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "httprecording.h"
+#include "testutils/httpreplay.h"
+#include "testutils/syncenginetestutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+class TestHttpReplay : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _tempDir;
+
+    QString recordingPath() const { return _tempDir.filePath(QStringLiteral("http.jsonl")); }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(_tempDir.isValid());
+        // read when the first request is logged
+        qputenv("OWNCLOUD_HTTP_RECORD_FILE", recordingPath().toLocal8Bit());
+    }
+
+    void testAnonymizer()
+    {
+        const HttpRecording::Anonymizer anonymizer(42);
+        QCOMPARE(anonymizer.name(QStringLiteral("report.pdf")), anonymizer.name(QStringLiteral("report.pdf")));
+        QVERIFY(anonymizer.name(QStringLiteral("report.pdf")) != HttpRecording::Anonymizer(43).name(QStringLiteral("report.pdf")));
+        QVERIFY(anonymizer.name(QStringLiteral("report.pdf")).endsWith(QLatin1String(".pdf")));
+        QVERIFY(!anonymizer.name(QStringLiteral("a.very long extension")).contains(QLatin1Char(' ')));
+        QVERIFY(anonymizer.name(QStringLiteral(".hidden")).startsWith(QLatin1Char('.')));
+        QCOMPARE(anonymizer.path(QStringLiteral("A/b/")),
+            anonymizer.name(QStringLiteral("A")) + QLatin1Char('/') + anonymizer.name(QStringLiteral("b")) + QLatin1Char('/'));
+
+        const auto split = HttpRecording::splitDavPath(QStringLiteral("/owncloud/remote.php/dav/files/admin/A/b"));
+        QVERIFY(split);
+        QCOMPARE(split->first, QStringLiteral("/owncloud/remote.php/dav/files/admin"));
+        QCOMPARE(split->second, QStringLiteral("A/b"));
+        QVERIFY(!HttpRecording::splitDavPath(QStringLiteral("/owncloud/ocs/v2.php/cloud/capabilities")));
+
+        const QByteArray body = anonymizer.body(QByteArrayLiteral("<d:response><d:href>/owncloud/remote.php/dav/files/admin/My%20Files/</d:href></d:response>"));
+        QCOMPARE(body, QByteArrayLiteral("<d:response><d:href>{dav}/") + anonymizer.name(QStringLiteral("My Files")).toUtf8() + "/</d:href></d:response>");
+    }
+
+    void testRecordAndReplay()
+    {
+        FakeFolder recorded(FileInfo{});
+        recorded.remoteModifier().mkdir(QStringLiteral("Documents"));
+        recorded.remoteModifier().insert(QStringLiteral("Documents/secret.txt"), 1234_B);
+        recorded.remoteModifier().insert(QStringLiteral("Documents/other.txt"), 2345_B);
+        recorded.remoteModifier().insert(QStringLiteral("top.txt"), 3456_B);
+
+        // only replay the sync below, not the initial one of the FakeFolder
+        HttpRecording::flush();
+        const auto recordedBefore = HttpRecording::load(recordingPath()).size();
+        QVERIFY(recorded.applyLocalModificationsAndSync());
+        HttpRecording::flush();
+
+        QFile file(recordingPath());
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray recording = file.readAll();
+        QVERIFY(!recording.contains("Documents"));
+        QVERIFY(!recording.contains("secret"));
+
+        const auto exchanges = HttpRecording::load(recordingPath()).mid(recordedBefore);
+        QVERIFY(std::any_of(exchanges.cbegin(), exchanges.cend(), [](const auto &exchange) { return exchange.verb == QByteArrayLiteral("GET"); }));
+
+        // the replaying folder has no files on its server, everything comes from the recording
+        FakeFolder replayed(FileInfo{});
+        HttpReplay replay(exchanges, {5ms, 10 * 1024 * 1024});
+        replayed.setServerOverride(replay.override());
+        QVERIFY(replayed.applyLocalModificationsAndSync());
+        QCOMPARE(replay.remaining(), 0);
+
+        const FileInfo local = replayed.currentLocalState();
+        QCOMPARE(local.children.size(), 2);
+        QList<qint64> sizes;
+        for (const auto &child : local.children) {
+            QVERIFY(child.name.startsWith(QLatin1Char('n')));
+            if (child.isDir) {
+                QCOMPARE(child.children.size(), 2);
+                for (const auto &file : child.children) {
+                    QVERIFY(file.name.endsWith(QLatin1String(".txt")));
+                    sizes.append(file.contentSize);
+                }
+            } else {
+                sizes.append(child.contentSize);
+            }
+        }
+        std::sort(sizes.begin(), sizes.end());
+        QCOMPARE(sizes, (QList<qint64>{1234, 2345, 3456}));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestHttpReplay)
+#include "testhttpreplay.moc"
@@ -7,7 +7,10 @@
 
 #include <QTest>
 
+#include <cstring>
+
 #include "common/c_jhash.h"
+#include "common/pathhash.h"
 
 #define HASHSTATE 1
 #define HASHLEN 1
@@ -295,6 +298,27 @@ private Q_SLOTS:
 #endif
         }
     }
+
+    void check_path_hash()
+    {
+        uint8_t buf[MAXLEN + 8];
+        for (uint64_t len = 0; len < MAXLEN; ++len) {
+            for (uint64_t i = 0; i < len + 8; ++i) {
+                buf[i] = static_cast<uint8_t>(i * 7);
+            }
+            // the hash doesn't depend on the alignment
+            const uint64_t ref = OCC::PathHash::hash(buf, len);
+            std::memmove(buf + 3, buf, len);
+            QCOMPARE(OCC::PathHash::hash(buf + 3, len), ref);
+            // every input byte and the length matter
+            for (uint64_t j = 0; j < len; ++j) {
+                buf[3 + j] ^= 1;
+                QVERIFY(OCC::PathHash::hash(buf + 3, len) != ref);
+                buf[3 + j] ^= 1;
+            }
+            QVERIFY(OCC::PathHash::hash(buf + 3, len + 1) != ref);
+        }
+    }
 };
 
 
@@ -128,6 +128,128 @@ private Q_SLOTS:
         }
         QVERIFY(!queue->isBlocked());
     }
+
+    void testRequestClasses()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+
+        auto queue = fakeFolder.account()->jobQueue();
+        JobQueueGuard queueGuard(queue);
+        QVERIFY(queueGuard.block());
+
+        std::vector<TestJob *> transfers;
+        for (size_t i = 0; i < JobQueue::ReleaseBatchSize + 5; ++i) {
+            auto job = new TestJob(fakeFolder.account());
+            job->setRequestClass(JobQueue::RequestClass::Transfer);
+            job->start();
+            transfers.push_back(job);
+        }
+        auto discovery = new TestJob(fakeFolder.account());
+        discovery->setRequestClass(JobQueue::RequestClass::Discovery);
+        discovery->start();
+        auto interactive = new TestJob(fakeFolder.account());
+        QCOMPARE(interactive->requestClass(), JobQueue::RequestClass::Interactive);
+        interactive->start();
+        QCOMPARE(queue->size(), transfers.size() + 2);
+
+        // the interactive job and a batch of the others, the discovery before the transfers
+        QVERIFY(queueGuard.unblock());
+        QCOMPARE(interactive->retryCount(), 1);
+        QCOMPARE(discovery->retryCount(), 1);
+        QCOMPARE(queue->size(), transfers.size() - (JobQueue::ReleaseBatchSize - 1));
+        QCOMPARE(transfers[JobQueue::ReleaseBatchSize - 2]->retryCount(), 1);
+        QCOMPARE(transfers[JobQueue::ReleaseBatchSize - 1]->retryCount(), 0);
+
+        // the remaining transfers follow
+        QTRY_COMPARE(queue->size(), 0);
+        for (auto job : transfers) {
+            QCOMPARE(job->retryCount(), 1);
+        }
+    }
+
+    void testServerBackOff()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        int requests = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (requests++ == 0) {
+                auto reply = new FakeErrorReply(op, request, this, 503);
+                reply->setRawHeader("Retry-After", "1");
+                return reply;
+            }
+            return nullptr;
+        });
+
+        auto queue = fakeFolder.account()->jobQueue();
+        (new TestJob(fakeFolder.account()))->start();
+        QTRY_VERIFY(queue->isBackingOff());
+        QVERIFY(queue->isBlocked());
+
+        // new requests are held back until the server told us to retry
+        QPointer<TestJob> held = new TestJob(fakeFolder.account());
+        held->start();
+        QCOMPARE(queue->size(), 1);
+        QCOMPARE(requests, 1);
+        QTRY_COMPARE_WITH_TIMEOUT(queue->size(), 0, 5000);
+        QVERIFY(!queue->isBackingOff());
+        QVERIFY(!queue->isBlocked());
+        QTRY_VERIFY(!held);
+        QCOMPARE(requests, 2);
+    }
+
+    void testConnectionLoss()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        int requests = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (requests++ == 0) {
+                auto reply = new FakeErrorReply(op, request, this, 0);
+                reply->setError(QNetworkReply::RemoteHostClosedError, QStringLiteral("Connection closed"));
+                return reply;
+            }
+            return nullptr;
+        });
+
+        // the account state blocks the queue while it validates the connection
+        auto queue = fakeFolder.account()->jobQueue();
+        JobQueueGuard queueGuard(queue);
+        connect(fakeFolder.account().data(), &Account::unknownConnectionState, this, [&] { queueGuard.block(); });
+
+        QPointer<TestJob> job = new TestJob(fakeFolder.account());
+        job->start();
+        QTRY_COMPARE(queue->size(), 1);
+        QVERIFY(job);
+        QCOMPARE(requests, 1);
+
+        // the job continues once the connection is back
+        QVERIFY(queueGuard.unblock());
+        QCOMPARE(job->retryCount(), 1);
+        QTRY_VERIFY(!job);
+        QCOMPARE(requests, 2);
+    }
+
+    void testParseRetryAfter_data()
+    {
+        QTest::addColumn<QByteArray>("value");
+        // the seconds, -1 if the value is invalid
+        QTest::addColumn<int>("expected");
+
+        QTest::newRow("seconds") << QByteArrayLiteral("120") << 120;
+        QTest::newRow("past date") << QByteArrayLiteral("Wed, 21 Oct 2015 07:28:00 GMT") << 0;
+        QTest::newRow("empty") << QByteArray() << -1;
+        QTest::newRow("invalid") << QByteArrayLiteral("soon") << -1;
+    }
+
+    void testParseRetryAfter()
+    {
+        QFETCH(QByteArray, value);
+        QFETCH(int, expected);
+        const auto retryAfter = JobQueue::parseRetryAfter(value);
+        QCOMPARE(retryAfter.has_value(), expected != -1);
+        if (retryAfter) {
+            QCOMPARE(retryAfter->count(), std::chrono::seconds::rep(expected));
+        }
+    }
 };
 
 QTEST_GUILESS_MAIN(TestJobQueue)
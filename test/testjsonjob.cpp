@@ -0,0 +1,69 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "networkjobs/jsonjob.h"
+#include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+class TestJsonJob : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testIfNoneMatch()
+    {
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12());
+        const QByteArray etag = QByteArrayLiteral("\"notifications-1\"");
+
+        QList<QByteArray> sentEtags;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (!request.url().path().endsWith(QLatin1String("/notifications"))) {
+                return nullptr;
+            }
+            sentEtags.append(request.rawHeader(QByteArrayLiteral("If-None-Match")));
+            FakePayloadReply *reply;
+            if (request.rawHeader(QByteArrayLiteral("If-None-Match")) == etag) {
+                reply = new FakePayloadReply(op, request, {}, this);
+                reply->setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 304);
+            } else {
+                reply = new FakePayloadReply(op, request, QByteArrayLiteral(R"({"ocs":{"meta":{"statuscode":200},"data":[{"notification_id":1}]}})"), this);
+            }
+            reply->setRawHeader(QByteArrayLiteral("ETag"), etag);
+            return reply;
+        });
+
+        const auto run = [&](const QByteArray &ifNoneMatch) {
+            auto *job = new JsonApiJob(fakeFolder.account(), QStringLiteral("ocs/v2.php/apps/notifications/api/v1/notifications"), {}, {}, this);
+            job->setIfNoneMatch(ifNoneMatch);
+            QSignalSpy finished(job, &JsonApiJob::finishedSignal);
+            job->start();
+            finished.wait();
+            return job;
+        };
+
+        auto *job = run({});
+        QVERIFY(!job->notModified());
+        QVERIFY(job->ocsSuccess());
+        QCOMPARE(job->etag(), etag);
+        QCOMPARE(job->data().value(QLatin1String("ocs")).toObject().value(QLatin1String("data")).toArray().size(), 1);
+
+        // an unchanged resource is not parsed
+        job = run(etag);
+        QVERIFY(job->notModified());
+        QCOMPARE(job->etag(), etag);
+        QVERIFY(job->data().isEmpty());
+
+        QCOMPARE(sentEtags, (QList<QByteArray>{QByteArray(), etag}));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestJsonJob)
+#include "testjsonjob.moc"
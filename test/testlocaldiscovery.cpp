@@ -8,6 +8,7 @@
 #include "testutils/syncenginetestutils.h"
 #include "testutils/testutils.h"
 
+#include <filesystem.h>
 #include <syncengine.h>
 #include <localdiscoverytracker.h>
 
@@ -192,6 +193,36 @@ private Q_SLOTS:
         QVERIFY(tracker.localDiscoveryPaths().empty());
     }
 
+    // Check that a burst of changes is collapsed into the folders and then into a full discovery
+    void testTrackerCollapse()
+    {
+        LocalDiscoveryTracker tracker;
+        const auto contains = [&](const QString &path) { return tracker.localDiscoveryPaths().count(path) == 1; };
+
+        tracker.addTouchedPath(QStringLiteral("A/B"));
+        tracker.addTouchedPath(QStringLiteral("A/B/c"));
+        // covered by A/B
+        QVERIFY(!contains(QStringLiteral("A/B/c")));
+
+        for (int i = 0; i < LocalDiscoveryTracker::collapseThreshold - 2; ++i) {
+            tracker.addTouchedPath(QStringLiteral("A/f%1").arg(i));
+        }
+        QVERIFY(contains(QStringLiteral("A/f0")));
+        tracker.addTouchedPath(QStringLiteral("A/last"));
+        QCOMPARE(tracker.localDiscoveryPaths(), std::set<QString>{QStringLiteral("A")});
+        QVERIFY(!tracker.preferFullDiscovery());
+
+        // spread over too many folders to collapse them
+        for (int folder = 0; tracker.localDiscoveryPaths().size() <= LocalDiscoveryTracker::fullDiscoveryThreshold; ++folder) {
+            for (int i = 0; i < LocalDiscoveryTracker::collapseThreshold / 2; ++i) {
+                tracker.addTouchedPath(QStringLiteral("D%1/f%2").arg(folder).arg(i));
+            }
+        }
+        QVERIFY(tracker.preferFullDiscovery());
+        tracker.startSyncFullDiscovery();
+        QVERIFY(!tracker.preferFullDiscovery());
+    }
+
     void testDirectoryAndSubDirectory()
     {
         QFETCH_GLOBAL(Vfs::Mode, vfsMode);
@@ -239,6 +270,109 @@ private Q_SLOTS:
         QVERIFY(!fakeFolder.currentRemoteState().find(QStringLiteral("C/bar")));
     }
 
+    // The entries of large directories are prepared in parallel
+    void testLargeDirectoryExcludes()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo{}, vfsMode, filesAreDehydrated);
+        fakeFolder.syncEngine().addManualExclude(QStringLiteral("*.excluded"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("big"));
+        for (int i = 0; i < 1500; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("big/file%1").arg(i), 1_B);
+            if (i % 100 == 0) {
+                fakeFolder.localModifier().insert(QStringLiteral("big/file%1.excluded").arg(i), 1_B);
+            }
+        }
+
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        auto remote = fakeFolder.currentRemoteState();
+        auto *big = remote.find(QStringLiteral("big"));
+        QVERIFY(big);
+        QCOMPARE(big->children.size(), qsizetype(1500));
+        QVERIFY(big->find(QStringLiteral("file1499")));
+        QVERIFY(!big->find(QStringLiteral("file100.excluded")));
+    }
+
+    // The prefetched listings of directories that are not processed are dropped
+    void testDropUnusedLocalListings()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo{}, vfsMode, filesAreDehydrated);
+        // new local directories below a deselected path are ignored, they are never processed
+        fakeFolder.localModifier().mkdir(QStringLiteral("B"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("B/sub"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("B/sub/deep"));
+        fakeFolder.localModifier().insert(QStringLiteral("B/sub/deep/b"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.localModifier().insert(QStringLiteral("A/a"));
+        fakeFolder.syncJournal().setSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, {QStringLiteral("B/")});
+
+        qsizetype listingsLeft = -1;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this,
+            [&] { listingsLeft = fakeFolder.syncEngine()._discoveryPhase->_localListings.size(); });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(listingsLeft, qsizetype(0));
+        QVERIFY(fakeFolder.currentRemoteState().find(QStringLiteral("A/a")));
+        QVERIFY(!fakeFolder.currentRemoteState().find(QStringLiteral("B")));
+    }
+
+    // Folders whose fingerprint and etag are unchanged are read from the db
+    void testSkipUnchangedLocalFolders()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("The content of a local file is modified");
+        }
+
+        FakeFolder fakeFolder(FileInfo{}, vfsMode, filesAreDehydrated);
+        fakeFolder.localModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.localModifier().insert(QStringLiteral("A/a1"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("A/sub"));
+        fakeFolder.localModifier().insert(QStringLiteral("A/sub/s1"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("B"));
+        fakeFolder.localModifier().insert(QStringLiteral("B/b1"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._skipUnchangedLocalFolders = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        // the fingerprint of a folder modified in the last second isn't trusted
+        const QStringList folders = {QStringLiteral("A"), QStringLiteral("A/sub"), QStringLiteral("B")};
+        for (const auto &folder : folders) {
+            QVERIFY(FileSystem::setModTime(fakeFolder.localPath() + folder, QDateTime::currentSecsSinceEpoch() - 60));
+        }
+        // a full discovery records the fingerprints
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        const auto fingerprints = fakeFolder.syncJournal().localFolderFingerprints();
+        for (const auto &folder : folders) {
+            QVERIFY(fingerprints.contains(folder));
+        }
+
+        // A is unchanged, a file modified in place doesn't change its folder
+        fakeFolder.localModifier().appendByte(QStringLiteral("A/a1"));
+        fakeFolder.localModifier().insert(QStringLiteral("A/sub/s2"));
+        fakeFolder.localModifier().insert(QStringLiteral("B/b2"));
+        fakeFolder.syncEngine().setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemUnlessUnchanged);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.syncEngine().lastLocalDiscoveryStyle(), LocalDiscoveryStyle::FilesystemUnlessUnchanged);
+        // the subfolders of an unchanged folder are checked on their own
+        QVERIFY(fakeFolder.currentRemoteState().find(QStringLiteral("A/sub/s2")));
+        QVERIFY(fakeFolder.currentRemoteState().find(QStringLiteral("B/b2")));
+        auto localState = fakeFolder.currentLocalState();
+        auto remoteState = fakeFolder.currentRemoteState();
+        QVERIFY(remoteState.find(QStringLiteral("A/a1"))->contentSize != localState.find(QStringLiteral("A/a1"))->contentSize);
+
+        // the next full discovery picks up the modification
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.syncEngine().lastLocalDiscoveryStyle(), LocalDiscoveryStyle::FilesystemOnly);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testNameNormalization_data()
     {
         QTest::addColumn<QString>("correct");
@@ -116,6 +116,54 @@ private Q_SLOTS:
         QVERIFY(temporaryDir.remove());
     }
 
+    void testBackoff()
+    {
+        auto temporaryDir = TestUtils::createTempDir();
+        const QString tmpFile = temporaryDir.filePath(QStringLiteral("file.txt"));
+        {
+            QFile tmp(tmpFile);
+            QVERIFY(tmp.open(QFile::WriteOnly));
+            QVERIFY(tmp.write("ownCloud"));
+        }
+
+        LockWatcher watcher;
+        QSignalSpy spy(&watcher, &LockWatcher::fileUnlocked);
+        // nothing to check, no timer
+        QVERIFY(!watcher._timer.isActive());
+
+#ifdef Q_OS_WIN
+        auto h = makeHandle(tmpFile, 0);
+        QVERIFY(FileSystem::isFileLocked(tmpFile, FileSystem::LockMode::Shared));
+        watcher.addFile(tmpFile, FileSystem::LockMode::Shared);
+        const auto &entry = watcher._watchedPaths.at({tmpFile, FileSystem::LockMode::Shared});
+        // checked after a second, not after the check interval
+        QVERIFY(entry.interval == 1s);
+        QVERIFY(watcher._timer.remainingTime() <= 1000);
+
+        // still locked, the interval doubles
+        QTRY_VERIFY_WITH_TIMEOUT(entry.interval == 2s, 3000);
+        QTRY_VERIFY_WITH_TIMEOUT(entry.interval == 4s, 5000);
+        QCOMPARE(spy.count(), 0);
+
+        // the check interval is the maximum
+        watcher.setCheckInterval(3s);
+        QVERIFY(entry.interval == 3s);
+        QVERIFY(watcher._timer.remainingTime() <= 3000);
+
+        CloseHandle(h);
+#else
+        watcher.addFile(tmpFile, FileSystem::LockMode::Shared);
+        // checked after a second, not after the check interval
+        QVERIFY(watcher._timer.isActive());
+        QVERIFY(watcher._timer.remainingTime() <= 1000);
+#endif
+        QVERIFY(spy.wait(5000));
+        QCOMPARE(spy.first().first().toString(), tmpFile);
+        QVERIFY(!watcher.contains(tmpFile, FileSystem::LockMode::Shared));
+        // the timer stops once nothing is watched
+        QVERIFY(!watcher._timer.isActive());
+    }
+
 #ifdef Q_OS_WIN
     void testLockedFilePropagation()
     {
@@ -192,6 +240,37 @@ private Q_SLOTS:
         QVERIFY(fakeFolder.applyLocalModificationsAndSync());
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
+
+    void testLockedFolderRename()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            fakeFolder.localModifier().appendByte(QStringLiteral("A/a1"));
+            fakeFolder.localModifier().appendByte(QStringLiteral("A/a2"));
+            QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        }
+
+        QStringList seenLockedFiles;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::seenLockedFile, &fakeFolder.syncEngine(),
+            [&](const QString &file) { seenLockedFiles.append(file); });
+
+        // the folder can't be renamed while files in it are in use, all of them are reported
+        fakeFolder.remoteModifier().rename(QStringLiteral("A"), QStringLiteral("A2"));
+        auto h1 = makeHandle(fakeFolder.localPath() + QStringLiteral("A/a1"), 0);
+        auto h2 = makeHandle(fakeFolder.localPath() + QStringLiteral("A/a2"), 0);
+        QVERIFY(!fakeFolder.applyLocalModificationsAndSync());
+        seenLockedFiles.sort();
+        QCOMPARE(seenLockedFiles, QStringList({fakeFolder.localPath() + QStringLiteral("A/a1"), fakeFolder.localPath() + QStringLiteral("A/a2")}));
+
+        CloseHandle(h1);
+        CloseHandle(h2);
+        fakeFolder.syncJournal().wipeErrorBlacklist();
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 #endif
 };
 
@@ -0,0 +1,77 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "logger.h"
+#include "testutils/testutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+class TestLogger : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _dir = TestUtils::createTempDir();
+
+    static QByteArray readFile(const QString &path)
+    {
+        QFile file(path);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    static void log(const QString &message) { Logger::instance()->doLog(QtInfoMsg, QMessageLogContext(), message); }
+
+private Q_SLOTS:
+    void cleanup()
+    {
+        // the other tests log to stdout
+        Logger::instance()->setLogFlush(false);
+        Logger::instance()->setLogFile(QStringLiteral("-"));
+    }
+
+    void testLogWhileLocked()
+    {
+        auto *logger = Logger::instance();
+        const QString path = _dir.filePath(QStringLiteral("locked.log"));
+        logger->setLogFile(path);
+        logger->setLogFlush(true);
+
+        {
+            // the writer thread waits for the mutex, the queue runs full
+            Logger::MutexLocker lock(&logger->_mutex);
+            for (int i = 0; i < 20000; ++i) {
+                log(QStringLiteral("locked %1").arg(i));
+            }
+            // everything was written before the mutex is released
+            const auto data = readFile(path);
+            QVERIFY(data.contains("locked 0\n"));
+            QVERIFY(data.contains("locked 19999\n"));
+        }
+    }
+
+    void testLogAfterClose()
+    {
+        auto *logger = Logger::instance();
+        const QString path = _dir.filePath(QStringLiteral("closed.log"));
+        logger->setLogFile(path);
+        logger->setLogFlush(true);
+        log(QStringLiteral("before close"));
+        logger->close();
+        QVERIFY(readFile(path).contains("before close\n"));
+
+        // the writer keeps running
+        QVERIFY(logger->_writerRunning);
+        const QString reopened = _dir.filePath(QStringLiteral("reopened.log"));
+        logger->setLogFile(reopened);
+        log(QStringLiteral("after close"));
+        QTRY_VERIFY(readFile(reopened).contains("after close\n"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestLogger)
+#include "testlogger.moc"
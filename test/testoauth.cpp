@@ -715,6 +715,15 @@ private Q_SLOTS:
                 oauth->refreshAuthentication(QStringLiteral("foo"));
 
                 QVERIFY(spy.wait());
+                QCOMPARE(spy.first().at(0).toString(), QStringLiteral("123"));
+                QCOMPARE(spy.first().at(2).value<std::chrono::seconds>(), std::chrono::seconds(3600));
+            }
+
+            QByteArray tokenReplyPayload() const override
+            {
+                QJsonDocument jsondata(QJsonObject{{QStringLiteral("access_token"), QStringLiteral("123")}, {QStringLiteral("refresh_token"), QStringLiteral("456")},
+                    {QStringLiteral("token_type"), QStringLiteral("Bearer")}, {QStringLiteral("expires_in"), 3600}});
+                return jsondata.toJson();
             }
 
         } test;
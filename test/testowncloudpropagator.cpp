@@ -7,9 +7,13 @@
 #include <QtTest>
 #include <QDebug>
 
+#include "chunksizecontroller.h"
 #include "owncloudpropagator_p.h"
 #include "propagatedownload.h"
+#include "propagateupload.h"
 #include "qchar.h"
+#include "syncoptions.h"
+#include "transferconcurrency.h"
 
 using namespace OCC;
 namespace OCC {
@@ -63,6 +67,166 @@ private Q_SLOTS:
             QVERIFY( tmpFileName.length() <= 254);
         }
     }
+
+    void testTransferConcurrency()
+    {
+        using namespace std::chrono_literals;
+        TransferConcurrency concurrency;
+        concurrency.setMaximum(20);
+        QCOMPARE(concurrency.limit(), 3);
+
+        // the first complete round always probes upwards
+        for (int i = 0; i < 3; ++i) {
+            concurrency.addSample(1000 * 1000, 100ms, 200);
+        }
+        QCOMPARE(concurrency.limit(), 4);
+
+        // errors are ignored
+        concurrency.addSample(0, 10ms, 404);
+        concurrency.addSample(0, 10ms, 0);
+        QCOMPARE(concurrency.limit(), 4);
+
+        // overload replies halve the limit once per round
+        concurrency.addSample(0, 10ms, 503);
+        QCOMPARE(concurrency.limit(), 2);
+        concurrency.addSample(0, 10ms, 429);
+        QCOMPARE(concurrency.limit(), 2);
+
+        // the limit never exceeds the maximum or drops below 1
+        concurrency.setMaximum(1);
+        QCOMPARE(concurrency.limit(), 1);
+        for (int i = 0; i < 10; ++i) {
+            concurrency.addSample(1000 * 1000, 100ms, 200);
+        }
+        QCOMPARE(concurrency.limit(), 1);
+
+        concurrency.setMaximum(20);
+        concurrency.reset();
+        QCOMPARE(concurrency.limit(), 3);
+    }
+
+    void testTransferConcurrencySustainedOverload()
+    {
+        using namespace std::chrono_literals;
+        TransferConcurrency concurrency;
+        concurrency.setMaximum(20);
+        for (int i = 0; i < 3; ++i) {
+            concurrency.addSample(1000 * 1000, 100ms, 200);
+        }
+        for (int i = 0; i < 4; ++i) {
+            concurrency.addSample(1000 * 1000, 100ms, 200);
+        }
+        QCOMPARE(concurrency.limit(), 5);
+
+        concurrency.addSample(0, 10ms, 429);
+        QCOMPARE(concurrency.limit(), 2);
+        // the replies to the other four requests that were running don't count twice
+        for (int i = 0; i < 4; ++i) {
+            concurrency.addSample(0, 10ms, 429);
+            QCOMPARE(concurrency.limit(), 2);
+        }
+        // without a single success the overload persists
+        concurrency.addSample(0, 10ms, 429);
+        QCOMPARE(concurrency.limit(), 1);
+        concurrency.addSample(0, 10ms, 503);
+        concurrency.addSample(0, 10ms, 503);
+        QCOMPARE(concurrency.limit(), 1);
+
+        // successful rounds end the back off, the next overload reply halves the limit right away
+        concurrency.setMaximum(20);
+        for (int i = 0; i < 2; ++i) {
+            concurrency.addSample(1000 * 1000, 100ms, 200);
+        }
+        QCOMPARE(concurrency.limit(), 2);
+        concurrency.addSample(0, 10ms, 429);
+        QCOMPARE(concurrency.limit(), 1);
+    }
+
+    void testChunkSizeController()
+    {
+        using namespace std::chrono_literals;
+        SyncOptions options(QSharedPointer<Vfs>{});
+        options._initialChunkSize = 10 * 1000 * 1000;
+        options._minChunkSize = 1000 * 1000;
+        options._maxChunkSize = 100 * 1000 * 1000;
+        options._targetChunkUploadDuration = 10s;
+
+        ChunkSizeController controller;
+        QCOMPARE(controller.chunkSize(options), options._initialChunkSize);
+
+        // 10MB in 4s is 2.5MB/s, 25MB per target duration
+        controller.addSample(10 * 1000 * 1000, 3999ms, options);
+        QCOMPARE(controller.chunkSize(options), qint64{25 * 1000 * 1000});
+
+        // parallel chunks measuring the same throughput keep the size
+        controller.addSample(25 * 1000 * 1000, 9999ms, options);
+        controller.addSample(25 * 1000 * 1000, 9999ms, options);
+        QCOMPARE(controller.chunkSize(options), qint64{25 * 1000 * 1000});
+
+        // small chunks are dominated by the latency and ignored
+        controller.addSample(1000, 1000ms, options);
+        QCOMPARE(controller.chunkSize(options), qint64{25 * 1000 * 1000});
+
+        // the size is bounded
+        for (int i = 0; i < 10; ++i) {
+            controller.addSample(100 * 1000 * 1000, 99ms, options);
+        }
+        QCOMPARE(controller.chunkSize(options), options._maxChunkSize);
+
+        // without a target duration the initial size is used
+        options._targetChunkUploadDuration = 0ms;
+        QCOMPARE(controller.chunkSize(options), options._initialChunkSize);
+
+        controller.reset();
+        options._targetChunkUploadDuration = 10s;
+        QCOMPARE(controller.chunkSize(options), options._initialChunkSize);
+    }
+
+    void testUploadDevice()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("chunked"));
+        // larger than the read-ahead window
+        QByteArray content(10 * 1024 * 1024, Qt::Uninitialized);
+        for (qsizetype i = 0; i < content.size(); ++i) {
+            content[i] = static_cast<char>(i % 251);
+        }
+        {
+            QFile f(fileName);
+            QVERIFY(f.open(QIODevice::WriteOnly));
+            QCOMPARE(f.write(content), content.size());
+        }
+
+        const qint64 start = 1024 * 1024 + 3;
+        const qint64 size = 6 * 1024 * 1024;
+        UploadDevice device(fileName, start, size, nullptr);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        QVERIFY(device.openMode() & QIODevice::Unbuffered);
+        QCOMPARE(device.size(), size);
+
+        QByteArray read;
+        while (!device.atEnd()) {
+            const QByteArray block = device.read(64 * 1024);
+            QVERIFY(!block.isEmpty());
+            read += block;
+        }
+        QCOMPARE(read.size(), size);
+        QVERIFY(read == content.mid(start, size));
+
+        // a resent request starts over
+        QVERIFY(device.seek(0));
+        QVERIFY(device.read(1000) == content.mid(start, 1000));
+        QVERIFY(device.seek(size - 10));
+        QVERIFY(device.readAll() == content.mid(start + size - 10, 10));
+        device.close();
+
+        // the last chunk ends with the file
+        UploadDevice last(fileName, 8 * 1024 * 1024, size, nullptr);
+        QVERIFY(last.open(QIODevice::ReadOnly));
+        QCOMPARE(last.size(), content.size() - 8 * 1024 * 1024);
+        QVERIFY(last.readAll() == content.mid(8 * 1024 * 1024));
+    }
 };
 
 QTEST_APPLESS_MAIN(TestOwncloudPropagator)
@@ -0,0 +1,135 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "partialhydration.h"
+#include "testutils/syncenginetestutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+namespace {
+using ByteRange = PartialHydration::ByteRange;
+using Ranges = QVector<ByteRange>;
+}
+
+class TestPartialHydration : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testRangeMath()
+    {
+        QCOMPARE(PartialHydration::merged({}, {10, 20}), (Ranges{{10, 20}}));
+        QCOMPARE(PartialHydration::merged({{0, 5}, {30, 40}}, {10, 20}), (Ranges{{0, 5}, {10, 20}, {30, 40}}));
+        // adjacent and overlapping ranges are joined
+        QCOMPARE(PartialHydration::merged({{0, 10}, {20, 30}}, {10, 20}), (Ranges{{0, 30}}));
+        QCOMPARE(PartialHydration::merged({{0, 10}, {25, 30}, {40, 50}}, {5, 26}), (Ranges{{0, 30}, {40, 50}}));
+        QCOMPARE(PartialHydration::merged({{0, 10}}, {3, 3}), (Ranges{{0, 10}}));
+
+        QCOMPARE(PartialHydration::missing({}, {10, 20}), (Ranges{{10, 20}}));
+        QCOMPARE(PartialHydration::missing({{0, 15}}, {10, 20}), (Ranges{{15, 20}}));
+        QCOMPARE(PartialHydration::missing({{12, 14}, {16, 30}}, {10, 20}), (Ranges{{10, 12}, {14, 16}}));
+        QCOMPARE(PartialHydration::missing({{0, 30}}, {10, 20}), Ranges{});
+
+        constexpr qint64 block = PartialHydration::BlockSize;
+        QCOMPARE(PartialHydration::aligned({1, 2}, 10 * block), (ByteRange{0, block}));
+        QCOMPARE(PartialHydration::aligned({block, block + 1}, 10 * block), (ByteRange{block, 2 * block}));
+        QCOMPARE(PartialHydration::aligned({block - 1, block + 1}, 10 * block), (ByteRange{0, 2 * block}));
+        QCOMPARE(PartialHydration::aligned({9 * block + 1, 10 * block}, 9 * block + 10), (ByteRange{9 * block, 9 * block + 10}));
+    }
+
+    void testHydrateBlock()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        constexpr qint64 size = 10_MiB;
+        fakeFolder.remoteModifier().insert(QStringLiteral("big"), size, 'X');
+        const QByteArray etag = fakeFolder.remoteModifier().find(QStringLiteral("big"))->etag;
+        const QString localPath = fakeFolder.localPath() + QStringLiteral("big");
+
+        int requests = 0;
+        QByteArray range;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                ++requests;
+                range = request.rawHeader("Range");
+            }
+            return nullptr;
+        });
+
+        PartialHydration hydration(fakeFolder.account(), fakeFolder.account()->davUrl(), QStringLiteral("big"), localPath, &fakeFolder.syncJournal(),
+            QStringLiteral("big"), etag, size);
+        QSignalSpy finishedSpy(&hydration, &PartialHydration::finished);
+        hydration.hydrate(5_MiB, 10);
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(finishedSpy.first().at(2).toString(), QString());
+        QCOMPARE(requests, 1);
+        // only the block containing the requested bytes
+        QCOMPARE(range, QByteArrayLiteral("bytes=4194304-8388607"));
+        QCOMPARE(hydration.ranges(), (Ranges{{4_MiB, 8_MiB}}));
+        QVERIFY(hydration.isHydrated(5_MiB, 10));
+        QVERIFY(!hydration.isHydrated(3_MiB, 10));
+        QVERIFY(!hydration.isComplete());
+
+        // the file is sparse: the hydrated block has the data, the rest is still empty
+        QFile file(localPath);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.size(), size);
+        const QByteArray data = file.readAll();
+        QCOMPARE(data.mid(4_MiB, 4_MiB), QByteArray(4_MiB, 'X'));
+        QCOMPARE(data.left(4_MiB), QByteArray(4_MiB, '\0'));
+        QCOMPARE(data.mid(8_MiB), QByteArray(2_MiB, '\0'));
+
+        // the ranges are kept for this etag only
+        QCOMPARE(fakeFolder.syncJournal().hydratedRanges("big", etag), (Ranges{{4_MiB, 8_MiB}}));
+        QVERIFY(fakeFolder.syncJournal().hydratedRanges("big", "other").isEmpty());
+
+        // a request for present bytes needs no download
+        PartialHydration again(fakeFolder.account(), fakeFolder.account()->davUrl(), QStringLiteral("big"), localPath, &fakeFolder.syncJournal(),
+            QStringLiteral("big"), etag, size);
+        QSignalSpy againSpy(&again, &PartialHydration::finished);
+        again.hydrate(6_MiB, 1_MiB);
+        QCOMPARE(againSpy.count(), 1);
+        QCOMPARE(requests, 1);
+    }
+
+    void testForegroundFirst()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        constexpr qint64 size = 10_MiB;
+        fakeFolder.remoteModifier().insert(QStringLiteral("big"), size, 'X');
+        const QByteArray etag = fakeFolder.remoteModifier().find(QStringLiteral("big"))->etag;
+
+        QVector<QNetworkRequest::Priority> priorities;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                priorities.append(request.priority());
+            }
+            return nullptr;
+        });
+
+        PartialHydration hydration(fakeFolder.account(), fakeFolder.account()->davUrl(), QStringLiteral("big"),
+            fakeFolder.localPath() + QStringLiteral("big"), &fakeFolder.syncJournal(), QStringLiteral("big"), etag, size);
+        QSignalSpy finishedSpy(&hydration, &PartialHydration::finished);
+        hydration.hydrate(0, size, PartialHydration::Priority::Background);
+        // the read of an application interrupts the background download
+        hydration.hydrate(5_MiB, 10);
+        QTRY_COMPARE(finishedSpy.count(), 2);
+
+        QCOMPARE(finishedSpy.at(0).at(0).toLongLong(), qint64(5_MiB));
+        QCOMPARE(finishedSpy.at(0).at(2).toString(), QString());
+        QCOMPARE(finishedSpy.at(1).at(0).toLongLong(), qint64(0));
+        QCOMPARE(finishedSpy.at(1).at(2).toString(), QString());
+        QVERIFY(hydration.isComplete());
+        // the interrupted download, the block of the read, then the gaps around it
+        QCOMPARE(priorities, (QVector<QNetworkRequest::Priority>{
+                                 QNetworkRequest::LowPriority, QNetworkRequest::HighPriority, QNetworkRequest::LowPriority, QNetworkRequest::LowPriority}));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestPartialHydration)
+#include "testpartialhydration.moc"
@@ -0,0 +1,72 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "httplogger.h"
+#include "networkjobs.h"
+#include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+class TestPrivateLink : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testRemembered()
+    {
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12());
+        auto cap = TestUtils::testCapabilities();
+        auto files = cap.value(QStringLiteral("files")).toMap();
+        files.insert(QStringLiteral("privateLinks"), true);
+        cap.insert(QStringLiteral("files"), files);
+        fakeFolder.account()->setCapabilities({fakeFolder.account()->url(), cap});
+
+        auto *file = fakeFolder.remoteModifier().find(QStringLiteral("A/a1"));
+        QVERIFY(file);
+        file->extraDavProperties = "<oc:privatelink>https://example.com/f/42</oc:privatelink>";
+        const QByteArray fileId = file->fileId;
+        const QUrl expected(QStringLiteral("https://example.com/f/42"));
+
+        int propfinds = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (HttpLogger::requestVerb(op, request) == "PROPFIND") {
+                ++propfinds;
+            }
+            return nullptr;
+        });
+
+        const auto fetch = [&](const QByteArray &id) {
+            std::optional<QUrl> result;
+            fetchPrivateLinkUrl(
+                fakeFolder.account(), fakeFolder.account()->davUrl(), QStringLiteral("/A/a1"), this, [&result](const QUrl &url) { result = url; }, id);
+            // never called directly
+            if (result.has_value()) {
+                return QUrl();
+            }
+            QTest::qWaitFor([&result] { return result.has_value(); });
+            return result.value_or(QUrl());
+        };
+
+        QCOMPARE(fetch(fileId), expected);
+        QCOMPARE(propfinds, 1);
+        QCOMPARE(fakeFolder.account()->privateLink(fileId), expected);
+
+        // the link of the file is known
+        QCOMPARE(fetch(fileId), expected);
+        QCOMPARE(propfinds, 1);
+
+        // without the file id it is fetched again
+        QCOMPARE(fetch({}), expected);
+        QCOMPARE(propfinds, 2);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestPrivateLink)
+#include "testprivatelink.moc"
@@ -0,0 +1,95 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "libsync/progressdispatcher.h"
+
+#include <QtTest>
+
+using namespace OCC;
+
+class TestProgressInfo : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testCompletedSize()
+    {
+        auto makeItem = [](const QString &file, SyncInstruction instruction, qint64 size) {
+            SyncFileItem item;
+            item._file = file;
+            item._type = ItemTypeFile;
+            item.setInstruction(instruction);
+            item._size = size;
+            return item;
+        };
+        const auto a = makeItem(QStringLiteral("a"), CSYNC_INSTRUCTION_NEW, 100);
+        const auto b = makeItem(QStringLiteral("b"), CSYNC_INSTRUCTION_SYNC, 50);
+        // a removal is counted as a file, but not by its size
+        const auto c = makeItem(QStringLiteral("c"), CSYNC_INSTRUCTION_REMOVE, 1000);
+
+        ProgressInfo progress;
+        for (const auto &item : {a, b, c}) {
+            progress.adjustTotalsForFile(item);
+        }
+        QCOMPARE(progress.totalSize(), qint64 { 150 });
+        QCOMPARE(progress.totalFiles(), qint64 { 3 });
+
+        progress.setProgressItem(a, 30);
+        progress.setProgressItem(b, 20);
+        progress.setProgressItem(c, 500);
+        QCOMPARE(progress.completedSize(), qint64 { 50 });
+        progress.setProgressItem(a, 60);
+        QCOMPARE(progress.completedSize(), qint64 { 80 });
+
+        progress.setProgressComplete(a);
+        QCOMPARE(progress.completedSize(), qint64 { 120 });
+        progress.setProgressComplete(c);
+        QCOMPARE(progress.completedSize(), qint64 { 120 });
+        progress.setProgressComplete(b);
+        QCOMPARE(progress.completedSize(), qint64 { 150 });
+        QCOMPARE(progress.completedFiles(), qint64 { 3 });
+
+        progress.reset();
+        progress.adjustTotalsForFile(a);
+        progress.setProgressItem(a, 10);
+        QCOMPARE(progress.completedSize(), qint64 { 10 });
+    }
+
+    void testGeneration()
+    {
+        SyncFileItem item;
+        item._file = QStringLiteral("a");
+        item._type = ItemTypeFile;
+        item.setInstruction(CSYNC_INSTRUCTION_NEW);
+        item._size = 100;
+
+        ProgressInfo progress;
+        auto generation = progress.generation();
+        progress.adjustTotalsForFile(item);
+        QVERIFY(progress.generation() > generation);
+
+        // every progress of a transfer is counted, a poll sees whether anything changed since the last one
+        generation = progress.generation();
+        progress.setProgressItem(item, 10);
+        progress.setProgressItem(item, 20);
+        QCOMPARE(progress.generation(), generation + 2);
+        generation = progress.generation();
+        QCOMPARE(progress.generation(), generation);
+
+        progress.setProgressComplete(item);
+        QVERIFY(progress.generation() > generation);
+
+        // items that are not counted don't change the progress
+        generation = progress.generation();
+        item.setInstruction(CSYNC_INSTRUCTION_IGNORE);
+        progress.setProgressItem(item, 50);
+        QCOMPARE(progress.generation(), generation);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestProgressInfo)
+#include "testprogressinfo.moc"
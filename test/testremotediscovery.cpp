@@ -35,6 +35,36 @@ struct MissingPermissionsPropfindReply : FakePropfindReply {
     }
 };
 
+// A sync-collection REPORT reply with the entries at \a paths as changes, the ones missing on the server are reported as removed
+QNetworkReply *syncCollectionReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request,
+    const QStringList &paths, const QByteArray &syncToken, QObject *parent)
+{
+    QByteArray body = "<?xml version=\"1.0\" encoding=\"utf-8\"?><d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">";
+    for (const auto &path : paths) {
+        body += "<d:response><d:href>" + request.url().path().toUtf8() + QUrl::toPercentEncoding(path, "/") + "</d:href>";
+        if (const FileInfo *fileInfo = remoteRootFileInfo.find(path)) {
+            body += "<d:propstat><d:prop>";
+            body += fileInfo->isDir ? "<d:resourcetype><d:collection/></d:resourcetype>" : "<d:resourcetype/>";
+            body += "<d:getlastmodified>" + Utility::formatRFC1123Date(fileInfo->lastModifiedInUtc()).toUtf8() + "</d:getlastmodified>";
+            body += "<d:getcontentlength>" + QByteArray::number(fileInfo->contentSize) + "</d:getcontentlength>";
+            body += "<d:getetag>\"" + fileInfo->etag + "\"</d:getetag>";
+            body += "<oc:permissions>" + (fileInfo->permissions.isNull() ? QByteArrayLiteral("RDNVCKW") : fileInfo->permissions.toString().toUtf8()) + "</oc:permissions>";
+            body += "<oc:id>" + fileInfo->fileId + "</oc:id>";
+            body += "<oc:checksums>" + fileInfo->checksums + "</oc:checksums>";
+            body += "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat>";
+        } else {
+            body += "<d:status>HTTP/1.1 404 Not Found</d:status>";
+        }
+        body += "</d:response>";
+    }
+    body += "<d:sync-token>" + syncToken + "</d:sync-token></d:multistatus>";
+
+    auto reply = new FakePayloadReply(op, request, body, parent);
+    reply->setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 207);
+    reply->setRawHeader("Content-Type", "application/xml; charset=utf-8");
+    return reply;
+}
+
 enum ErrorKind : int {
     // Lower code are corresponding to HTML error code
     InvalidXML = 1000,
@@ -192,6 +222,259 @@ private Q_SLOTS:
         QVERIFY(completeSpy.findItem(QStringLiteral("nofileid"))->_errorString.contains(QStringLiteral("id")));
         QVERIFY(completeSpy.findItem(QStringLiteral("nopermissions/A"))->_errorString.contains(QStringLiteral("permissions")));
     }
+
+    // Only the directories with changes are listed, with a single sync-collection REPORT
+    void testRemoteListingCache()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        auto account = fakeFolder.account();
+        const QUrl davUrl = account->davUrl();
+
+        // the discovery filled the cache
+        const auto cached = account->remoteListingCache()->listing(davUrl);
+        QVERIFY(cached);
+        QCOMPARE(cached->etag, QString::fromUtf8(fakeFolder.remoteModifier().etag));
+        QStringList names;
+        for (const auto &folder : cached->folders) {
+            names.append(folder.name);
+        }
+        names.sort();
+        QCOMPARE(names, QStringList({QStringLiteral("A"), QStringLiteral("B"), QStringLiteral("C"), QStringLiteral("S")}));
+
+        int propfinds = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND") {
+                ++propfinds;
+            }
+            return nullptr;
+        });
+        QStringList hrefs;
+        QHash<QString, QString> etags;
+        const auto list = [&](const QString &path, const QString &expectedEtag) {
+            auto job = new SubfolderListingJob(account, davUrl, path);
+            job->setExpectedEtag(expectedEtag);
+            QSignalSpy spy(job, &SubfolderListingJob::subfoldersListed);
+            job->start();
+            if (spy.wait()) {
+                hrefs = spy.first().at(0).toStringList();
+                etags = spy.first().at(2).value<QHash<QString, QString>>();
+            }
+        };
+        const QString rootHref = Utility::ensureTrailingSlash(davUrl.path());
+
+        // an unchanged folder is taken from the cache without a request
+        list(QString(), cached->etag);
+        QCOMPARE(propfinds, 0);
+        QCOMPARE(hrefs.size(), 5);
+        QVERIFY(hrefs.contains(rootHref + QStringLiteral("A/")));
+
+        // without an expected etag only the etag is requested
+        list(QString(), QString());
+        QCOMPARE(propfinds, 1);
+        QCOMPARE(hrefs.size(), 5);
+
+        // a changed folder is listed again, its subfolders get their new etags
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/new"));
+        list(QString(), QString());
+        QCOMPARE(propfinds, 3);
+        const QString etagA = etags.value(rootHref + QStringLiteral("A/"));
+        QCOMPARE(etagA, QString::fromUtf8(fakeFolder.remoteModifier().find(QStringLiteral("A"))->etag));
+        list(QStringLiteral("A"), etagA);
+        QCOMPARE(propfinds, 4);
+        QVERIFY(hrefs.contains(rootHref + QStringLiteral("A/new/")));
+        list(QStringLiteral("A"), etagA);
+        QCOMPARE(propfinds, 4);
+    }
+
+    void testDeltaDiscovery()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto cap = TestUtils::testCapabilities();
+        auto dav = cap.value(QStringLiteral("dav")).toMap();
+        dav.insert(QStringLiteral("reports"), QVariantList{QStringLiteral("sync-collection")});
+        cap.insert(QStringLiteral("dav"), dav);
+        fakeFolder.account()->setCapabilities({fakeFolder.account()->url(), cap});
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._deltaRemoteDiscovery = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // without a token the first sync lists every changed directory and remembers the token of the root
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/deep"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/deep/er"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/deep/er/file"));
+        fakeFolder.remoteModifier().extraDavProperties = "<d:sync-token>token1</d:sync-token>";
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.syncJournal().syncToken(), QByteArrayLiteral("token1"));
+
+        QStringList changes;
+        QByteArray reportBody;
+        int propfinds = 0;
+        int reportError = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &req, QIODevice *device) -> QNetworkReply * {
+            const auto verb = req.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray();
+            if (verb == "PROPFIND") {
+                ++propfinds;
+            } else if (verb == "REPORT") {
+                reportBody = device->peek(device->size());
+                if (reportError) {
+                    return new FakeErrorReply(op, req, this, reportError);
+                }
+                return syncCollectionReply(fakeFolder.remoteModifier(), op, req, changes, "token2", this);
+            }
+            return nullptr;
+        });
+
+        // all changed directories are reported, only the root needs a PROPFIND
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/deep/er/file"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/deep/new"));
+        fakeFolder.remoteModifier().remove(QStringLiteral("B/b1"));
+        changes = {QStringLiteral("A"), QStringLiteral("A/deep"), QStringLiteral("A/deep/er"), QStringLiteral("A/deep/er/file"),
+            QStringLiteral("A/deep/new"), QStringLiteral("B"), QStringLiteral("B/b1")};
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(reportBody.contains("<d:sync-token>token1</d:sync-token>"));
+        QCOMPARE(propfinds, 1);
+        QCOMPARE(fakeFolder.syncJournal().syncToken(), QByteArrayLiteral("token2"));
+
+        // a directory whose new etag is unknown is listed with a PROPFIND
+        propfinds = 0;
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/deep/er/file"));
+        changes = {QStringLiteral("A"), QStringLiteral("A/deep/er"), QStringLiteral("A/deep/er/file")};
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(reportBody.contains("<d:sync-token>token2</d:sync-token>"));
+        QCOMPARE(propfinds, 3);
+
+        // an expired token falls back to listing the changed directories and takes the token of the root
+        propfinds = 0;
+        reportError = 403;
+        fakeFolder.remoteModifier().extraDavProperties = "<d:sync-token>token3</d:sync-token>";
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/deep/er/file"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(propfinds, 4);
+        QCOMPARE(fakeFolder.syncJournal().syncToken(), QByteArrayLiteral("token3"));
+    }
+
+    void testPrefetchedListingsDropped()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo{}, vfsMode, filesAreDehydrated);
+        auto cap = TestUtils::testCapabilities();
+        auto dav = cap.value(QStringLiteral("dav")).toMap();
+        dav.insert(QStringLiteral("propfind"), QVariantMap{{QStringLiteral("depth_infinity"), true}});
+        cap.insert(QStringLiteral("dav"), dav);
+        fakeFolder.account()->setCapabilities({fakeFolder.account()->url(), cap});
+
+        // the whole tree is listed with the root, the skipped subtree is never processed
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/sub"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/sub/a"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("B"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("B/sub"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("B/sub/deep"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("B/sub/deep/b"));
+        fakeFolder.syncJournal().setSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, {QStringLiteral("B/")});
+
+        int prefetchedLeft = -1;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this,
+            [&] { prefetchedLeft = fakeFolder.syncEngine()._discoveryPhase->_prefetchedRemoteEntries.size(); });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(prefetchedLeft, 0);
+        QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("A/sub/a")));
+        QVERIFY(!fakeFolder.currentLocalState().find(QStringLiteral("B")));
+    }
+
+    void testBoundedMemoryDiscovery()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto cap = TestUtils::testCapabilities();
+        auto dav = cap.value(QStringLiteral("dav")).toMap();
+        dav.insert(QStringLiteral("propfind"), QVariantMap{{QStringLiteral("depth_infinity"), true}});
+        cap.insert(QStringLiteral("dav"), dav);
+        fakeFolder.account()->setCapabilities({fakeFolder.account()->url(), cap});
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._deepRemoteDiscovery = true;
+        options._journalSnapshotDiscovery = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        QByteArrayList depths;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND") {
+                depths.append(req.rawHeader("Depth"));
+            }
+            return nullptr;
+        });
+        // the snapshot is dropped at the end of the discovery
+        bool snapshot = false;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::rootEtag, this, [&] { snapshot = fakeFolder.syncJournal().hasMetadataSnapshot(); });
+
+        // both optimizations are used without the mode
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new1"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(depths.contains("infinity"));
+        QVERIFY(snapshot);
+
+        // the mode lists one level at a time and reads the records from the database
+        options._boundedMemoryDiscovery = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        depths.clear();
+        fakeFolder.remoteModifier().insert(QStringLiteral("B/new2"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!depths.isEmpty());
+        QVERIFY(!depths.contains("infinity"));
+        QVERIFY(!snapshot);
+    }
+
+    void testLargestDirectoriesDiscoveredFirst()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo{}, vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/a1"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("B"));
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("B/b%1").arg(i));
+        }
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelDiscoveryJobs = 1;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        QStringList listed;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND") {
+                listed.append(req.url().path().section(QLatin1Char('/'), -1, -1, QString::SectionSkipEmpty));
+            }
+            return nullptr;
+        });
+
+        // B has more entries in the journal, it is listed before A although A comes first
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("B/new"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(listed.contains(QStringLiteral("A")));
+        QVERIFY(listed.indexOf(QStringLiteral("B")) < listed.indexOf(QStringLiteral("A")));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestRemoteDiscovery)
@@ -0,0 +1,97 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "networkjobs/resources.h"
+#include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
+
+#include <QtTest>
+
+using namespace std::chrono_literals;
+using namespace OCC;
+
+class TestResourcesCache : public QObject
+{
+    Q_OBJECT
+
+    static bool writeFile(const QString &path, qint64 size, const QDateTime &modified)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(QByteArray(size, 'x')) != size) {
+            return false;
+        }
+        return file.setFileTime(modified, QFileDevice::FileModificationTime);
+    }
+
+private Q_SLOTS:
+    void testKeptAcrossRestarts()
+    {
+        FakeFolder fakeFolder(FileInfo {});
+        auto dir = TestUtils::createTempDir();
+        QVERIFY(dir.isValid());
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith(QLatin1String("image.svg"))) {
+                auto *reply = new FakePayloadReply(op, request, QByteArrayLiteral("<svg xmlns=\"http://www.w3.org/2000/svg\"/>"), this);
+                reply->setRawHeader("Content-Type", "image/svg+xml");
+                return reply;
+            }
+            return nullptr;
+        });
+
+        auto *cache = new ResourcesCache(dir.path(), fakeFolder.account().get());
+        // the job deletes itself once it is finished
+        auto *job = cache->makeGetJob(QStringLiteral("image.svg"), this);
+        std::optional<QIcon> icon;
+        connect(job, &ResourceJob::finishedSignal, this, [job, &icon] { icon = job->asIcon(); });
+        job->start();
+        QTRY_VERIFY(icon.has_value());
+        QVERIFY(!icon->isNull());
+        const auto files = QDir(dir.path()).entryList(QDir::Files);
+        QCOMPARE(files.size(), 1);
+        // the icon is shared by the users of the file
+        QCOMPARE(cache->icon(files.first()).cacheKey(), icon->cacheKey());
+        delete cache;
+
+        // the next run finds the file
+        cache = new ResourcesCache(dir.path(), fakeFolder.account().get());
+        QCOMPARE(QDir(dir.path()).entryList(QDir::Files), files);
+        delete cache;
+    }
+
+    void testLeftoversRemoved()
+    {
+        FakeFolder fakeFolder(FileInfo {});
+        auto dir = TestUtils::createTempDir();
+        QVERIFY(dir.isValid());
+        QVERIFY(QDir(dir.path()).mkpath(QStringLiteral("tmp.abcdef")));
+        QVERIFY(writeFile(dir.filePath(QStringLiteral("tmp.abcdef/file.png")), 10, QDateTime::currentDateTimeUtc()));
+
+        ResourcesCache cache(dir.path(), fakeFolder.account().get());
+        QVERIFY(!QFileInfo::exists(dir.filePath(QStringLiteral("tmp.abcdef"))));
+    }
+
+    void testExpire()
+    {
+        FakeFolder fakeFolder(FileInfo {});
+        auto dir = TestUtils::createTempDir();
+        QVERIFY(dir.isValid());
+        const qint64 size = ResourcesCache::maximumSize() / 2 - 1;
+        const auto now = QDateTime::currentDateTimeUtc();
+        QVERIFY(writeFile(dir.filePath(QStringLiteral("oldest.png")), size, now.addSecs(-3 * 3600)));
+        QVERIFY(writeFile(dir.filePath(QStringLiteral("older.png")), size, now.addSecs(-2 * 3600)));
+        QVERIFY(writeFile(dir.filePath(QStringLiteral("recent.png")), size, now.addSecs(-3600)));
+
+        // the least recently used file is removed until the rest fits
+        ResourcesCache cache(dir.path(), fakeFolder.account().get());
+        QVERIFY(!QFileInfo::exists(dir.filePath(QStringLiteral("oldest.png"))));
+        QVERIFY(QFileInfo::exists(dir.filePath(QStringLiteral("older.png"))));
+        QVERIFY(QFileInfo::exists(dir.filePath(QStringLiteral("recent.png"))));
+    }
+};
+
+QTEST_MAIN(TestResourcesCache)
+#include "testresourcescache.moc"
@@ -0,0 +1,51 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "serverevents.h"
+
+#include <QtTest>
+
+using namespace std::chrono_literals;
+using namespace OCC;
+
+class TestServerEvents : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testParser()
+    {
+        ServerEvents::Parser parser;
+        // a keep alive and an incomplete event
+        auto events = parser.feed(": keepalive\n\nevent: item-trashed\ndata: {\"spaceid\":");
+        QVERIFY(events.isEmpty());
+
+        events = parser.feed("\"a$b\"}\r\nid: 42\r\n\r\nretry: 3000\ndata: first\ndata: second\n\n");
+        QCOMPARE(events.size(), 2);
+        QCOMPARE(events[0].type, QByteArrayLiteral("item-trashed"));
+        QCOMPARE(events[0].data, QByteArrayLiteral("{\"spaceid\":\"a$b\"}"));
+        QCOMPARE(events[0].id, QByteArrayLiteral("42"));
+        // without an event field the type is message
+        QCOMPARE(events[1].type, QByteArrayLiteral("message"));
+        QCOMPARE(events[1].data, QByteArrayLiteral("first\nsecond"));
+        QVERIFY(events[1].id.isEmpty());
+        QCOMPARE(parser.retry(), 3000ms);
+
+        // events without data are not dispatched
+        events = parser.feed("event: nothing\n\n");
+        QVERIFY(events.isEmpty());
+    }
+
+    void testNormalizedSpaceId()
+    {
+        QCOMPARE(ServerEvents::normalizedSpaceId(QStringLiteral("storage$space!opaque")), QStringLiteral("storage$space"));
+        QCOMPARE(ServerEvents::normalizedSpaceId(QStringLiteral("storage$space")), QStringLiteral("storage$space"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestServerEvents)
+#include "testserverevents.moc"
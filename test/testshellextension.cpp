@@ -0,0 +1,80 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "StringUtil.h"
+
+#include <QtTest>
+
+#include <map>
+#include <set>
+
+class TestShellExtension : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEraseDescendants()
+    {
+        std::map<std::wstring, int> cache{{L"C:\\A", 1}, {L"C:\\A\\b", 2}, {L"C:\\A\\c\\d", 3}, {L"C:\\A b", 4}, {L"C:\\AB", 5}, {L"C:\\B", 6}};
+        // the siblings sharing the prefix are sorted in between the descendants
+        auto removed = StringUtil::eraseDescendants(cache, L"C:\\A");
+        QVERIFY(removed == (std::vector<std::wstring>{L"C:\\A", L"C:\\A\\b", L"C:\\A\\c\\d"}));
+        QVERIFY(cache == (std::map<std::wstring, int>{{L"C:\\A b", 4}, {L"C:\\AB", 5}, {L"C:\\B", 6}}));
+
+        std::set<std::wstring> listed{L"C:\\", L"C:\\A\\c", L"C:\\A\\c\\d", L"C:\\A\\cd"};
+        removed = StringUtil::eraseDescendants(listed, L"C:\\A\\c");
+        QVERIFY(removed == (std::vector<std::wstring>{L"C:\\A\\c", L"C:\\A\\c\\d"}));
+        QVERIFY(listed == (std::set<std::wstring>{L"C:\\", L"C:\\A\\cd"}));
+
+        // a drive root ends with a separator
+        removed = StringUtil::eraseDescendants(listed, L"C:\\");
+        QCOMPARE(removed.size(), size_t(2));
+        QVERIFY(listed.empty());
+
+        QVERIFY(StringUtil::eraseDescendants(listed, L"C:\\").empty());
+    }
+
+    void testAreDescendantsOf()
+    {
+        const std::vector<std::wstring> watched{L"C:\\A", L"D:\\"};
+        QVERIFY(StringUtil::areDescendantsOf(L"C:\\A", L'\x1e', watched));
+        QVERIFY(StringUtil::areDescendantsOf(L"C:\\A\\b\x1e" L"D:\\c", L'\x1e', watched));
+        // the whole selection must be in the folders to skip asking the client
+        QVERIFY(!StringUtil::areDescendantsOf(L"C:\\A\\b\x1e" L"C:\\B", L'\x1e', watched));
+        QVERIFY(!StringUtil::areDescendantsOf(L"C:\\AB", L'\x1e', watched));
+        QVERIFY(!StringUtil::areDescendantsOf(L"C:\\A\\b", L'\x1e', {}));
+    }
+
+    void testExtractJsonStringMap()
+    {
+        using Map = std::vector<std::pair<std::wstring, std::wstring>>;
+        Map statuses;
+        QVERIFY(StringUtil::extractJsonStringMap(
+            LR"({"id":"1","arguments":{"statuses":{"C:\\a":"OK","C:\\\u00e4\"b\"":"SYNC"}}})", L"statuses", statuses));
+        QVERIFY(statuses == (Map{{L"C:\\a", L"OK"}, {L"C:\\\u00e4\"b\"", L"SYNC"}}));
+
+        // the strings written by toJsonString are read back
+        const std::wstring name = L"C:\\tab\tquote\"";
+        statuses.clear();
+        QVERIFY(StringUtil::extractJsonStringMap(L"{\"statuses\":{" + StringUtil::toJsonString(name) + L":\"OK\"}}", L"statuses", statuses));
+        QVERIFY(statuses == (Map{{name, L"OK"}}));
+
+        statuses.clear();
+        QVERIFY(StringUtil::extractJsonStringMap(LR"({"statuses":{}})", L"statuses", statuses));
+        QVERIFY(statuses.empty());
+
+        // malformed replies are rejected without throwing
+        QVERIFY(!StringUtil::extractJsonStringMap(LR"({"other":{"a":"OK"}})", L"statuses", statuses));
+        QVERIFY(!StringUtil::extractJsonStringMap(LR"({"statuses":{"\uZZZZ":"OK"}})", L"statuses", statuses));
+        QVERIFY(!StringUtil::extractJsonStringMap(LR"({"statuses":{"\u12")", L"statuses", statuses));
+        QVERIFY(!StringUtil::extractJsonStringMap(LR"({"statuses":{"\u-123":"OK"}})", L"statuses", statuses));
+        QVERIFY(!StringUtil::extractJsonStringMap(LR"({"statuses":{"a":"OK")", L"statuses", statuses));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestShellExtension)
+#include "testshellextension.moc"
@@ -0,0 +1,225 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/folderman.h"
+#include "gui/socketapi/socketapi.h"
+#include "gui/socketapi/socketapi_p.h"
+
+#include "testutils/testutils.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QtTest>
+
+using namespace OCC;
+
+namespace {
+
+/// Records the messages written to it, and reports a backlog as long as it is told to
+class BackloggedDevice : public QIODevice
+{
+public:
+    BackloggedDevice() { open(QIODevice::WriteOnly); }
+
+    qint64 bytesToWrite() const override { return backlog; }
+
+    qint64 backlog = 0;
+    QStringList messages;
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *data, qint64 len) override
+    {
+        // every write is one message
+        messages.append(QString::fromUtf8(data, len).chopped(1));
+        return len;
+    }
+};
+}
+
+class TestSocketApi : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _dir = TestUtils::createTempDir();
+    AccountStatePtr _accountState;
+    Folder *_folder = nullptr;
+
+    QString folderPath() const { return _dir.path() + QStringLiteral("/folder"); }
+
+    /// Reads the messages of \a socket until one starts with \a prefix, the messages before it are appended to \a skipped
+    static QString readMessage(QLocalSocket &socket, const QString &prefix, QStringList *skipped = nullptr)
+    {
+        QString message;
+        QTest::qWaitFor([&] {
+            while (socket.canReadLine()) {
+                QString line = QString::fromUtf8(socket.readLine());
+                line.chop(1);
+                if (line.startsWith(prefix)) {
+                    message = line;
+                    return true;
+                }
+                if (skipped) {
+                    skipped->append(line);
+                }
+            }
+            return false;
+        });
+        return message;
+    }
+
+    /// The arguments of the V2 reply \a message
+    static QJsonObject replyArguments(const QString &message)
+    {
+        const auto json = message.mid(message.indexOf(QLatin1Char(':')) + 1);
+        return QJsonDocument::fromJson(json.toUtf8()).object().value(QStringLiteral("arguments")).toObject();
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(_dir.isValid());
+        QVERIFY(QDir(_dir.path()).mkpath(QStringLiteral("folder/sub")));
+        for (const auto &name : {QStringLiteral("a"), QStringLiteral("b"), QStringLiteral("sub/c")}) {
+            QVERIFY(TestUtils::writeRandomFile(folderPath() + QLatin1Char('/') + name, 10));
+        }
+        _accountState = TestUtils::createDummyAccount();
+        _folder = TestUtils::folderMan()->addFolder(_accountState.get(), TestUtils::createDummyFolderDefinition(_accountState->account(), folderPath()));
+        QVERIFY(_folder);
+
+        auto *socketApi = TestUtils::folderMan()->socketApi();
+        QVERIFY(socketApi->_localServer.listen(socketApi->_socketPath));
+    }
+
+    void cleanupTestCase()
+    {
+        TestUtils::folderMan()->removeFolder(_folder);
+    }
+
+    void testRetrieveDirectoryStatus()
+    {
+        QLocalSocket socket;
+        socket.connectToServer(TestUtils::folderMan()->socketApi()->_socketPath);
+        QVERIFY(socket.waitForConnected());
+
+        const QString outside = _dir.path() + QStringLiteral("/outside");
+        const QJsonObject query{{QStringLiteral("id"), QStringLiteral("1")},
+            {QStringLiteral("arguments"),
+                QJsonObject{{QStringLiteral("paths"), QJsonArray{folderPath() + QStringLiteral("/a")}},
+                    {QStringLiteral("directories"), QJsonArray{folderPath(), folderPath() + QStringLiteral("/sub"), outside}}}}};
+        socket.write("V2/RETRIEVE_FILE_STATUS:" + QJsonDocument(query).toJson(QJsonDocument::Compact) + '\n');
+
+        const auto reply = readMessage(socket, QStringLiteral("V2/RETRIEVE_FILE_STATUS_RESULT:"));
+        QVERIFY(!reply.isEmpty());
+        const auto statuses = replyArguments(reply).value(QStringLiteral("statuses")).toObject();
+
+        // the entries of both directories
+        for (const auto &name : {QStringLiteral("a"), QStringLiteral("b"), QStringLiteral("sub"), QStringLiteral("sub/c")}) {
+            QVERIFY(statuses.contains(QDir::toNativeSeparators(folderPath() + QLatin1Char('/') + name)));
+        }
+        // the directories outside of the sync folders are ignored
+        for (const auto &path : statuses.keys()) {
+            QVERIFY(path.startsWith(QDir::toNativeSeparators(folderPath())));
+        }
+    }
+
+    void testRetrieveFileStatus()
+    {
+        QLocalSocket socket;
+        socket.connectToServer(TestUtils::folderMan()->socketApi()->_socketPath);
+        QVERIFY(socket.waitForConnected());
+
+        const QString a = folderPath() + QStringLiteral("/a");
+        const QString outside = _dir.path() + QStringLiteral("/outside");
+        const QJsonObject query{{QStringLiteral("id"), QStringLiteral("1")},
+            {QStringLiteral("arguments"), QJsonObject{{QStringLiteral("paths"), QJsonArray{a, outside}}}}};
+        socket.write("V2/RETRIEVE_FILE_STATUS:" + QJsonDocument(query).toJson(QJsonDocument::Compact) + '\n');
+
+        const auto reply = readMessage(socket, QStringLiteral("V2/RETRIEVE_FILE_STATUS_RESULT:"));
+        QVERIFY(!reply.isEmpty());
+        const auto statuses = replyArguments(reply).value(QStringLiteral("statuses")).toObject();
+        QCOMPARE(statuses.size(), 2);
+        QVERIFY(statuses.contains(QDir::toNativeSeparators(a)));
+        // a path outside of the sync folders has no status
+        QCOMPARE(statuses.value(QDir::toNativeSeparators(outside)).toString(), QStringLiteral("NOP"));
+    }
+
+    void testBatchedStatusPushes()
+    {
+        auto *socketApi = TestUtils::folderMan()->socketApi();
+        QLocalSocket socket;
+        socket.connectToServer(socketApi->_socketPath);
+        QVERIFY(socket.waitForConnected());
+
+        // asking for a status makes the client push the changes of the directory
+        const QString a = folderPath() + QStringLiteral("/a");
+        const QString b = folderPath() + QStringLiteral("/b");
+        const QJsonObject query{{QStringLiteral("id"), QStringLiteral("1")},
+            {QStringLiteral("arguments"), QJsonObject{{QStringLiteral("paths"), QJsonArray{a}}}}};
+        socket.write("V2/RETRIEVE_FILE_STATUS:" + QJsonDocument(query).toJson(QJsonDocument::Compact) + '\n');
+        QVERIFY(!readMessage(socket, QStringLiteral("V2/RETRIEVE_FILE_STATUS_RESULT:")).isEmpty());
+
+        // the changes are collected, only the latest status of a path is sent
+        QElapsedTimer timer;
+        timer.start();
+        socketApi->broadcastStatusPushMessage(a, SyncFileStatus(SyncFileStatus::StatusSync));
+        socketApi->broadcastStatusPushMessage(b, SyncFileStatus(SyncFileStatus::StatusSync));
+        socketApi->broadcastStatusPushMessage(a, SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QVERIFY(socketApi->_statusPushTimer.isActive());
+        QCOMPARE(socketApi->_pendingStatusPushes.size(), 2);
+
+        const auto push = readMessage(socket, QStringLiteral("V2/STATUS:"));
+        QVERIFY(!push.isEmpty());
+        QVERIFY2(timer.elapsed() >= 90, QByteArray::number(timer.elapsed()).constData());
+        const auto statuses = replyArguments(push).value(QStringLiteral("statuses")).toObject();
+        QCOMPARE(statuses,
+            (QJsonObject{{QDir::toNativeSeparators(a), QStringLiteral("OK")}, {QDir::toNativeSeparators(b), QStringLiteral("SYNC")}}));
+        QVERIFY(socketApi->_pendingStatusPushes.isEmpty());
+    }
+
+    void testHeldBackStatuses()
+    {
+        BackloggedDevice device;
+        SocketListener listener(&device);
+
+        listener.sendStatusPushes({{QStringLiteral("/a"), QStringLiteral("SYNC")}});
+        QCOMPARE(device.messages, QStringList{QStringLiteral("STATUS:SYNC:/a")});
+        device.messages.clear();
+
+        // the shell doesn't keep up, only the latest status of a path is kept
+        device.backlog = 1024 * 1024;
+        listener.sendStatusPushes({{QStringLiteral("/a"), QStringLiteral("SYNC")}, {QStringLiteral("/b"), QStringLiteral("SYNC")}});
+        listener.sendStatusPushes({{QStringLiteral("/a"), QStringLiteral("OK")}});
+        listener.sendHeldBackStatuses();
+        QVERIFY(device.messages.isEmpty());
+
+        device.backlog = 0;
+        listener.sendHeldBackStatuses();
+        device.messages.sort();
+        QCOMPARE(device.messages, (QStringList{QStringLiteral("STATUS:OK:/a"), QStringLiteral("STATUS:SYNC:/b")}));
+        device.messages.clear();
+        listener.sendHeldBackStatuses();
+        QVERIFY(device.messages.isEmpty());
+
+        // the held back statuses are sent before any other message
+        device.backlog = 1024 * 1024;
+        listener.batchedStatusPushes = true;
+        listener.sendStatusPushes({{QStringLiteral("/a"), QStringLiteral("SYNC")}, {QStringLiteral("/b"), QStringLiteral("OK")}});
+        QVERIFY(device.messages.isEmpty());
+        listener.sendMessage(QStringLiteral("UPDATE_VIEW:/"));
+        QCOMPARE(device.messages.size(), 2);
+        QVERIFY(device.messages[0].startsWith(QStringLiteral("V2/STATUS:")));
+        const auto statuses = replyArguments(device.messages[0]).value(QStringLiteral("statuses")).toObject();
+        QCOMPARE(statuses, (QJsonObject{{QStringLiteral("/a"), QStringLiteral("SYNC")}, {QStringLiteral("/b"), QStringLiteral("OK")}}));
+        QCOMPARE(device.messages[1], QStringLiteral("UPDATE_VIEW:/"));
+    }
+};
+
+QTEST_MAIN(TestSocketApi)
+#include "testsocketapi.moc"
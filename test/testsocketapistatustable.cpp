@@ -0,0 +1,235 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/socketapi/socketapistatustable.h"
+
+#include "testutils/testutils.h"
+
+#include <QScopeGuard>
+#include <QtTest>
+
+#ifdef Q_OS_WIN
+#include "StatusTable.h"
+#endif
+
+using namespace OCC;
+
+namespace {
+const QStringList StatusStrings = {QStringLiteral("NOP"), QStringLiteral("SYNC"), QStringLiteral("SYNC+SWM"), QStringLiteral("IGNORE"),
+    QStringLiteral("IGNORE+SWM"), QStringLiteral("OK"), QStringLiteral("OK+SWM"), QStringLiteral("ERROR"), QStringLiteral("ERROR+SWM")};
+}
+
+class TestSocketApiStatusTable : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _dir = TestUtils::createTempDir();
+    int _tables = 0;
+
+    /// A name for a new table
+    QString tableName()
+    {
+#ifdef Q_OS_WIN
+        return QStringLiteral("Local\\TestSocketApiStatusTable-%1-%2").arg(QCoreApplication::applicationPid()).arg(++_tables);
+#else
+        return _dir.filePath(QStringLiteral("status-%1.table").arg(++_tables));
+#endif
+    }
+
+    /// Looks up \a nativePath like a shell extension does, returns an empty string on a miss
+    static QString lookup(const QString &name, const QString &nativePath)
+    {
+#ifdef Q_OS_WIN
+        StatusTable table;
+        std::wstring status;
+        if (!table.open(name.toStdWString()) || !table.lookup(nativePath.toStdWString(), &status)) {
+            return {};
+        }
+        return QString::fromStdWString(status);
+#else
+        // mirrors the reader of the Finder extension
+        QFile file(name);
+        if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(SocketApiStatusTable::Header))) {
+            return {};
+        }
+        const uchar *data = file.map(0, file.size());
+        if (!data) {
+            return {};
+        }
+        const auto unmap = qScopeGuard([&] { file.unmap(const_cast<uchar *>(data)); });
+        const auto *header = reinterpret_cast<const SocketApiStatusTable::Header *>(data);
+        if (header->magic.load(std::memory_order_acquire) != SocketApiStatusTable::Magic || header->version != SocketApiStatusTable::Version) {
+            return {};
+        }
+        const auto tableSequence = header->sequence.load(std::memory_order_acquire);
+        if (tableSequence & 1) {
+            return {};
+        }
+        const auto *slots = reinterpret_cast<const SocketApiStatusTable::Slot *>(data + sizeof(SocketApiStatusTable::Header));
+        const auto hash = SocketApiStatusTable::hash(nativePath);
+        uint32_t code = 0;
+        for (uint32_t i = 0; i < SocketApiStatusTable::MaximumProbes; ++i) {
+            const auto &slot = slots[(hash + i) % header->slotCount];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto status = slot.status.load(std::memory_order_relaxed);
+            const auto slotHash = slot.hash.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((sequence & 1) || slot.sequence.load(std::memory_order_relaxed) != sequence || status == 0) {
+                return {};
+            }
+            if (status == SocketApiStatusTable::Removed) {
+                continue;
+            }
+            if (slotHash == hash) {
+                code = status;
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (code == 0 || code > uint32_t(StatusStrings.size()) || header->sequence.load(std::memory_order_relaxed) != tableSequence) {
+            return {};
+        }
+        return StatusStrings.at(code - 1);
+#endif
+    }
+
+    static QString nativePath(const QString &path) { return QDir::toNativeSeparators(QStringLiteral("/sync") + path); }
+
+private Q_SLOTS:
+    void testInsertAndUpdate()
+    {
+        const QString name = tableName();
+        SocketApiStatusTable table(name);
+        QVERIFY(table.isValid());
+
+        const QString a = nativePath(QStringLiteral("/a"));
+        const QString b = nativePath(QStringLiteral("/b"));
+        table.insert(a, SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        table.insert(b, SyncFileStatus(SyncFileStatus::StatusSync));
+        QCOMPARE(table.size(), 2);
+        QCOMPARE(lookup(name, a), QStringLiteral("OK"));
+        QCOMPARE(lookup(name, b), QStringLiteral("SYNC"));
+        QCOMPARE(lookup(name, nativePath(QStringLiteral("/c"))), QString());
+
+        QVERIFY(table.update(a, SyncFileStatus(SyncFileStatus::StatusError)));
+        QCOMPARE(lookup(name, a), QStringLiteral("ERROR"));
+        // only the paths the shell asked for are published
+        QVERIFY(!table.update(nativePath(QStringLiteral("/c")), SyncFileStatus(SyncFileStatus::StatusSync)));
+        QCOMPARE(lookup(name, nativePath(QStringLiteral("/c"))), QString());
+    }
+
+    void testRemove()
+    {
+        const QString name = tableName();
+        SocketApiStatusTable table(name);
+        QVERIFY(table.isValid());
+
+        // two paths on the same probe sequence
+        QString first;
+        QString second;
+        QHash<uint32_t, QString> buckets;
+        for (int i = 0; second.isEmpty(); ++i) {
+            const QString path = nativePath(QStringLiteral("/file%1").arg(i));
+            const uint32_t bucket = SocketApiStatusTable::hash(path) % SocketApiStatusTable::SlotCount;
+            if (buckets.contains(bucket)) {
+                first = buckets.value(bucket);
+                second = path;
+            }
+            buckets.insert(bucket, path);
+        }
+        table.insert(first, SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        table.insert(second, SyncFileStatus(SyncFileStatus::StatusSync));
+
+        // the lookup continues over the removed slot
+        QVERIFY(table.remove(first));
+        QVERIFY(!table.remove(first));
+        QCOMPARE(lookup(name, first), QString());
+        QCOMPARE(lookup(name, second), QStringLiteral("SYNC"));
+        QCOMPARE(table.size(), 1);
+
+        // the removed slot is reused
+        table.insert(first, SyncFileStatus(SyncFileStatus::StatusWarning));
+        QCOMPARE(lookup(name, first), QStringLiteral("IGNORE"));
+        QCOMPARE(lookup(name, second), QStringLiteral("SYNC"));
+    }
+
+    void testRemoveDescendants()
+    {
+        const QString name = tableName();
+        SocketApiStatusTable table(name);
+        QVERIFY(table.isValid());
+
+        const QStringList removed = {nativePath(QStringLiteral("/dir")), nativePath(QStringLiteral("/dir/x")), nativePath(QStringLiteral("/dir/y/z"))};
+        const QStringList kept = {nativePath(QStringLiteral("/dir x")), nativePath(QStringLiteral("/dirx")), nativePath(QStringLiteral("/other"))};
+        for (const auto &path : removed + kept) {
+            table.insert(path, SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        }
+
+        table.removeDescendants(nativePath(QStringLiteral("/dir")));
+        for (const auto &path : removed) {
+            QCOMPARE(lookup(name, path), QString());
+        }
+        // the siblings sharing the prefix are kept
+        for (const auto &path : kept) {
+            QCOMPARE(lookup(name, path), QStringLiteral("OK"));
+        }
+        QCOMPARE(table.size(), kept.size());
+    }
+
+    void testCompaction()
+    {
+        const QString name = tableName();
+        SocketApiStatusTable table(name);
+        QVERIFY(table.isValid());
+
+        // fill the table until no more paths fit
+        QStringList paths;
+        for (uint32_t i = 0; i < SocketApiStatusTable::SlotCount; ++i) {
+            paths.append(nativePath(QStringLiteral("/fill%1").arg(i)));
+            table.insert(paths.last(), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        }
+        const auto full = table.size();
+        QVERIFY(full < qsizetype(SocketApiStatusTable::SlotCount));
+        const QString late = nativePath(QStringLiteral("/late"));
+        table.insert(late, SyncFileStatus(SyncFileStatus::StatusSync));
+        QCOMPARE(table.size(), full);
+
+        // once paths are removed there is room again
+        for (qsizetype i = 0; i < paths.size(); i += 2) {
+            table.remove(paths.at(i));
+        }
+        const auto remaining = table.size();
+        table.insert(late, SyncFileStatus(SyncFileStatus::StatusSync));
+        QCOMPARE(table.size(), remaining + 1);
+        QCOMPARE(lookup(name, late), QStringLiteral("SYNC"));
+        for (qsizetype i = 1; i < paths.size(); i += 2) {
+            if (!lookup(name, paths.at(i)).isEmpty()) {
+                continue;
+            }
+            // the path never fit into the table
+            QVERIFY(!table.remove(paths.at(i)));
+        }
+        QCOMPARE(lookup(name, paths.at(0)), QString());
+    }
+
+    void testDestroyedTable()
+    {
+        const QString name = tableName();
+        const QString a = nativePath(QStringLiteral("/a"));
+        {
+            SocketApiStatusTable table(name);
+            QVERIFY(table.isValid());
+            table.insert(a, SyncFileStatus(SyncFileStatus::StatusUpToDate));
+            QCOMPARE(lookup(name, a), QStringLiteral("OK"));
+        }
+        // a reader must not use the entries of a client that is gone
+        QCOMPARE(lookup(name, a), QString());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSocketApiStatusTable)
+#include "testsocketapistatustable.moc"
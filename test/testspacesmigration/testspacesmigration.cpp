@@ -11,6 +11,8 @@
 #include "common/depreaction.h"
 #include "gui/spacemigration.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QJsonObject>
 
 using namespace OCC;
@@ -110,6 +112,50 @@ private Q_SLOTS:
         QCOMPARE(folder->webDavUrl(), personalUrl);
         QCOMPARE(folder->remotePath(), QStringLiteral("/"));
     }
+
+    void testOnlyMigratingAccountWaits()
+    {
+        FolderMan::instance()->unloadAndDeleteAllFolders();
+
+        FakeFolder fakeFolder({});
+        QJsonArray requestedFolders;
+        QPointer<QNetworkReply> migrationReply;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PostOperation && request.url().path().endsWith(QLatin1String("migration/spaces"))) {
+                requestedFolders = QJsonDocument::fromJson(device->readAll()).object().value(QStringLiteral("remotefolder")).toArray();
+                migrationReply = new FakeHangingReply(op, request, this);
+                return migrationReply;
+            }
+            return nullptr;
+        });
+
+        auto migratingAccountState = AccountState::fromNewAccount(fakeFolder.account());
+        auto otherAccountState = TestUtils::createDummyAccount();
+        auto *migratingFolder = addFolder(migratingAccountState.get(), QStringLiteral("/migrating"), QStringLiteral("/migrating"));
+        auto *otherFolder = addFolder(otherAccountState.get(), QStringLiteral("/other"), QStringLiteral("/other"));
+        QVERIFY(migratingFolder);
+        QVERIFY(otherFolder);
+
+        auto *migr = new SpaceMigration(migratingAccountState.get(), QStringLiteral("migration/spaces"), this);
+        QSignalSpy spy(migr, &SpaceMigration::finished);
+        migr->start();
+        QTRY_VERIFY(migrationReply);
+        QCOMPARE(requestedFolders, QJsonArray{QStringLiteral("/migrating")});
+
+        // the folders of the other account keep syncing
+        QVERIFY(migratingAccountState->_spaceMigrationRunning);
+        QVERIFY(!migratingAccountState->readyForSync());
+        QVERIFY(!otherAccountState->_spaceMigrationRunning);
+
+        // a failed migration releases the folders as well
+        migrationReply->abort();
+        QTRY_COMPARE(spy.size(), 1);
+        QVERIFY(!migratingAccountState->_spaceMigrationRunning);
+        QCOMPARE(migratingFolder->webDavUrl(), fakeFolder.account()->davUrl());
+        migr->deleteLater();
+
+        FolderMan::instance()->unloadAndDeleteAllFolders();
+    }
 };
 
 QTEST_MAIN(TestSpacesMigration)
@@ -0,0 +1,50 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "libsync/stallwatchdog.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+#include <thread>
+
+using namespace std::chrono_literals;
+using namespace OCC;
+
+class TestStallWatchdog : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testStall()
+    {
+        auto *watchdog = StallWatchdog::instance();
+        QSignalSpy stalled(watchdog, &StallWatchdog::stalled);
+        watchdog->start(50ms);
+        QVERIFY(watchdog->isRunning());
+
+        // an idle event loop answers in time
+        QTest::qWait(200);
+        QCOMPARE(stalled.size(), 0);
+
+        {
+            const StallWatchdog::Activity outer("discovery", QStringLiteral("A"));
+            const StallWatchdog::Activity inner("start", QStringLiteral("A/a1"));
+            std::this_thread::sleep_for(300ms);
+        }
+        QVERIFY(stalled.wait());
+        QVERIFY(stalled[0][0].value<std::chrono::milliseconds>() >= 250ms);
+        // the innermost activity first
+        QCOMPARE(stalled[0][1].toString(), QStringLiteral("start of A/a1, discovery of A"));
+
+        watchdog->stop();
+        QVERIFY(!watchdog->isRunning());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestStallWatchdog)
+#include "teststallwatchdog.moc"
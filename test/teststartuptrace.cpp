@@ -0,0 +1,62 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/startuptrace.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace OCC;
+
+class TestStartupTrace : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testTrace()
+    {
+        QTemporaryDir dir;
+        const QString path = dir.filePath(QStringLiteral("trace.json"));
+        auto &trace = StartupTrace::instance();
+        trace.setOutputFile(path);
+        {
+            StartupTrace::Span outer(QStringLiteral("outer"));
+            {
+                const StartupTrace::Span inner(QStringLiteral("inner"), {{QStringLiteral("path"), QStringLiteral("/A")}});
+                QTest::qWait(1);
+            }
+            outer.end();
+        }
+        trace.finish();
+        // the trace is written only once
+        {
+            const StartupTrace::Span late(QStringLiteral("late"));
+        }
+        trace.finish();
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto events = QJsonDocument::fromJson(file.readAll()).object().value(QStringLiteral("traceEvents")).toArray();
+        QCOMPARE(events.size(), 3);
+        const auto inner = events.at(0).toObject();
+        const auto outer = events.at(1).toObject();
+        QCOMPARE(inner.value(QStringLiteral("name")).toString(), QStringLiteral("inner"));
+        QCOMPARE(inner.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+        QCOMPARE(inner.value(QStringLiteral("args")).toObject().value(QStringLiteral("path")).toString(), QStringLiteral("/A"));
+        QCOMPARE(outer.value(QStringLiteral("name")).toString(), QStringLiteral("outer"));
+        QVERIFY(outer.value(QStringLiteral("ts")).toInteger() <= inner.value(QStringLiteral("ts")).toInteger());
+        QVERIFY(outer.value(QStringLiteral("dur")).toInteger() >= inner.value(QStringLiteral("dur")).toInteger());
+        QVERIFY(inner.value(QStringLiteral("dur")).toInteger() >= 1000);
+        QCOMPARE(events.at(2).toObject().value(QStringLiteral("name")).toString(), QStringLiteral("startup"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestStartupTrace)
+#include "teststartuptrace.moc"
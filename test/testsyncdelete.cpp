@@ -79,6 +79,40 @@ private Q_SLOTS:
         QVERIFY(fakeFolder.currentRemoteState().find(QStringLiteral("B/b1")));
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
+
+    void testRemoveLocalTree()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        for (int i = 0; i < 10; ++i) {
+            const QString dir = QStringLiteral("T/sub%1").arg(i);
+            fakeFolder.remoteModifier().mkdir(dir);
+            for (int j = 0; j < 10; ++j) {
+                fakeFolder.remoteModifier().insert(dir + QStringLiteral("/file%1").arg(j));
+            }
+        }
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // the tree is removed while the other items propagate
+        fakeFolder.remoteModifier().remove(QStringLiteral("T"));
+        fakeFolder.remoteModifier().remove(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("B/new"));
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        auto dbState = fakeFolder.dbState();
+        QVERIFY(!dbState.find(QStringLiteral("T")));
+        QVERIFY(!dbState.find(QStringLiteral("A")));
+        QVERIFY(dbState.find(QStringLiteral("B/new")));
+        for (const auto &path : {QStringLiteral("T"), QStringLiteral("A"), QStringLiteral("B/new")}) {
+            QVERIFY(completeSpy.findItem(path));
+            QCOMPARE(completeSpy.findItem(path)->_status, SyncFileItem::Success);
+        }
+        QVERIFY(!QFileInfo::exists(fakeFolder.localPath() + QStringLiteral("T")));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncDelete)
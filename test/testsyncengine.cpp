@@ -7,6 +7,9 @@
 
 #include <syncengine.h>
 
+#include "accessmanager.h"
+#include "httplogger.h"
+#include "networkjobs.h"
 #include "testutils/syncenginetestutils.h"
 #include "testutils/testutils.h"
 
@@ -146,6 +149,164 @@ private Q_SLOTS:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void testRemoteDeleteOfDirectory()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/sub"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/sub/s1"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        QStringList deletes;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::DeleteOperation) {
+                deletes.append(getFilePathFromUrl(request.url()));
+            }
+            return nullptr;
+        });
+
+        // the content of a removed directory is removed by the one request for the directory
+        fakeFolder.localModifier().remove(QStringLiteral("A"));
+        fakeFolder.localModifier().remove(QStringLiteral("B/b1"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        deletes.sort();
+        QCOMPARE(deletes, (QStringList{QStringLiteral("A"), QStringLiteral("B/b1")}));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    // the metadata only updates of a directory are done in bulks
+    void testMetadataUpdatesInBulk()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo{}, vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        QStringList files;
+        // more than fit into a single bulk
+        for (int i = 0; i < 600; ++i) {
+            files.append(QStringLiteral("A/f%1").arg(i));
+            fakeFolder.remoteModifier().insert(files.last(), 16_B);
+        }
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        // a new file id only needs an update of the journal
+        for (const auto &file : std::as_const(files)) {
+            fakeFolder.remoteModifier().find(file, true)->fileId = file.toUtf8() + "-new";
+        }
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        for (const auto &file : std::as_const(files)) {
+            QByteArrayList paths;
+            QVERIFY(fakeFolder.syncJournal().getFileRecordsByFileId(file.toUtf8() + "-new", [&](const SyncJournalFileRecord &record) { paths.append(record._path); }));
+            QCOMPARE(paths.size(), 1);
+            const auto item = completeSpy.findItem(QString::fromUtf8(paths.first()));
+            QVERIFY(item);
+            QCOMPARE(item->instruction(), CSYNC_INSTRUCTION_UPDATE_METADATA);
+            QCOMPARE(item->_status, SyncFileItem::Success);
+        }
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    // a new etag for content we already have is only a metadata update
+    void testEtagOnlyChange()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Dehydrated files are never downloaded.");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        const auto size = fakeFolder.currentRemoteState().find(QStringLiteral("A/a1"))->contentSize;
+        fakeFolder.remoteModifier().setContents(QStringLiteral("A/a1"), size, 'C');
+        fakeFolder.remoteModifier().find(QStringLiteral("A/a1"))->checksums =
+            "SHA1:" + QCryptographicHash::hash(QByteArray(size, 'C'), QCryptographicHash::Sha1).toHex();
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        OperationCounter counter(fakeFolder);
+        ItemCompletedSpy completeSpy(fakeFolder);
+        fakeFolder.remoteModifier().find(QStringLiteral("A/a1"), true)->etag = "migrated-a1";
+        // without a checksum the content has to be downloaded to be sure
+        fakeFolder.remoteModifier().find(QStringLiteral("A/a2"), true)->etag = "migrated-a2";
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(counter.nGET, 1);
+        QCOMPARE(completeSpy.findItem(QStringLiteral("A/a1"))->instruction(), CSYNC_INSTRUCTION_UPDATE_METADATA);
+        QCOMPARE(completeSpy.findItem(QStringLiteral("A/a2"))->instruction(), CSYNC_INSTRUCTION_SYNC);
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/a1"), &record));
+        QCOMPARE(record._etag, QByteArrayLiteral("migrated-a1"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    // the listing of the root provides its quota
+    void testRootQuota()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        QSignalSpy quotaSpy(&fakeFolder.syncEngine(), &SyncEngine::rootQuota);
+        fakeFolder.remoteModifier().extraDavProperties = "<d:quota-available-bytes>1000</d:quota-available-bytes><d:quota-used-bytes>24.5</d:quota-used-bytes>";
+        fakeFolder.remoteModifier().find(QStringLiteral("A"))->extraDavProperties = "<d:quota-available-bytes>5</d:quota-available-bytes>";
+        fakeFolder.syncJournal().forceRemoteDiscoveryNextSync();
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        QCOMPARE(quotaSpy.size(), 1);
+        const auto quota = quotaSpy[0][0].value<RemoteQuota>();
+        QCOMPARE(quota.availableBytes, qint64(1000));
+        QCOMPARE(quota.usedBytes, qint64(24));
+    }
+
+    void testTimeline()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto dir = TestUtils::createTempDir();
+        const QString timelinePath = dir.filePath(QStringLiteral("timeline.json"));
+        fakeFolder.syncEngine().setTimelinePath(timelinePath);
+        fakeFolder.localModifier().insert(QStringLiteral("A/new"), 100_B);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        QFile timelineFile(timelinePath);
+        QVERIFY(timelineFile.open(QIODevice::ReadOnly));
+        const auto events = QJsonDocument::fromJson(timelineFile.readAll()).object().value(QLatin1String("traceEvents")).toArray();
+        int thread = -1;
+        for (const auto &event : events) {
+            const auto object = event.toObject();
+            if (object.value(QLatin1String("ph")).toString() == QLatin1String("M")
+                && object.value(QLatin1String("args")).toObject().value(QLatin1String("name")).toString() == QLatin1String("A/new")) {
+                thread = object.value(QLatin1String("tid")).toInt();
+            }
+        }
+        QVERIFY(thread >= 0);
+
+        QMap<QString, QJsonObject> steps;
+        for (const auto &event : events) {
+            const auto object = event.toObject();
+            if (object.value(QLatin1String("tid")).toInt() == thread && object.value(QLatin1String("ph")).toString() != QLatin1String("M")) {
+                steps.insert(object.value(QLatin1String("name")).toString(), object);
+            }
+        }
+        for (const auto &name : {"discovered", "queued", "propagation", "request", "first byte", "journal", "done"}) {
+            QVERIFY2(steps.contains(QString::fromLatin1(name)), name);
+        }
+        const int status = steps.value(QStringLiteral("request")).value(QLatin1String("args")).toObject().value(QLatin1String("status")).toInt();
+        QVERIFY(status >= 200 && status < 300);
+        // the steps follow each other
+        const auto time = [&](const char *name) { return steps.value(QString::fromLatin1(name)).value(QLatin1String("ts")).toInteger(); };
+        QVERIFY(time("discovered") <= time("queued"));
+        QVERIFY(time("queued") <= time("propagation"));
+        QVERIFY(time("propagation") <= time("request"));
+        QVERIFY(time("request") <= time("first byte"));
+        QVERIFY(time("first byte") <= time("journal"));
+        QVERIFY(time("journal") <= time("done"));
+    }
+
     void testEmlLocalChecksum() {
         QFETCH_GLOBAL(Vfs::Mode, vfsMode);
         QFETCH_GLOBAL(bool, filesAreDehydrated);
@@ -259,6 +420,43 @@ private Q_SLOTS:
         }
     }
 
+    void testSelectiveSyncNestedBlackList()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        if (vfsMode == Vfs::WindowsCfApi) {
+            QSKIP("selective sync is not supported with winvfs");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/sub"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A b"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A b/new"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        // a path within an other one of the list must not hide the outer path from the lookup
+        const QSet<QString> blackList = {QStringLiteral("A/"), QStringLiteral("A/sub/"), QStringLiteral("C/")};
+        auto *journal = fakeFolder.syncEngine().journal();
+        journal->setSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, blackList);
+        bool ok = false;
+        QCOMPARE(journal->getSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, &ok), blackList);
+        QVERIFY(ok);
+        for (const auto &path : blackList) {
+            journal->schedulePathForRemoteDiscovery(path.toUtf8());
+        }
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/sub/new"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        const auto local = fakeFolder.currentLocalState();
+        QVERIFY(!local.find(QStringLiteral("A")));
+        QVERIFY(!local.find(QStringLiteral("C")));
+        // a sibling that shares the prefix of a black listed folder is synced
+        QVERIFY(local.find(QStringLiteral("A b")));
+        QVERIFY(local.find(QStringLiteral("B")));
+    }
+
     void abortAfterFailedMkdir() {
         QFETCH_GLOBAL(Vfs::Mode, vfsMode);
         QFETCH_GLOBAL(bool, filesAreDehydrated);
@@ -275,6 +473,45 @@ private Q_SLOTS:
         QCOMPARE(finishedSpy.first().first().toBool(), false);
     }
 
+    void testAbortDuringLocalIo()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().rename(QStringLiteral("A/a1"), QStringLiteral("A/renamed"));
+
+        QSemaphore ioBlocked;
+        int activeJobs = -1;
+        auto con = connect(&fakeFolder.syncEngine(), &SyncEngine::transmissionProgress, this, [&](const ProgressInfo &progress) {
+            if (activeJobs != -1 || progress.status() != ProgressInfo::Propagation || progress._currentItems.isEmpty()) {
+                return;
+            }
+            activeJobs = 0;
+            auto propagator = fakeFolder.syncEngine().getPropagator();
+            // the rename reports its progress right before its operation is queued behind this one
+            std::ignore = propagator->runLocalIo([&ioBlocked] { ioBlocked.acquire(); });
+            QTimer::singleShot(0, propagator.data(), [&activeJobs, &ioBlocked, propagator] {
+                activeJobs = propagator->_activeJobList.size();
+                propagator->abort();
+                ioBlocked.release();
+            });
+        });
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(!fakeFolder.syncOnce());
+        disconnect(con);
+
+        // the rename waiting for the I/O thread counts as an active job
+        QCOMPARE(activeJobs, 1);
+        // and it is done once its operation returned
+        const auto item = completeSpy.findItem(QStringLiteral("A/renamed"));
+        QVERIFY(item);
+        QCOMPARE(item->_status, SyncFileItem::SoftError);
+
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     /**
      * Verify that an incompletely propagated directory doesn't have the server's
      * etag stored in the database yet.
@@ -447,6 +684,61 @@ private Q_SLOTS:
         QCOMPARE(counter.nGET, expectedGET);
     }
 
+    // Conflicts of identical files are resolved before the propagation, in one pass
+    void testFakeConflictsResolvedBeforePropagation()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Dehydrated files are never compared.");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        OperationCounter counter(fakeFolder);
+
+        auto mtime = QDateTime::currentDateTimeUtc().addDays(-4);
+        mtime.setMSecsSinceEpoch(mtime.toMSecsSinceEpoch() / 1000 * 1000);
+
+        const QStringList identical = {QStringLiteral("A/a1"), QStringLiteral("A/a2"), QStringLiteral("B/b1")};
+        for (const auto &path : identical) {
+            const auto size = fakeFolder.currentRemoteState().find(path)->contentSize;
+            fakeFolder.localModifier().setContents(path, size, 'C');
+            fakeFolder.localModifier().setModTime(path, mtime);
+            fakeFolder.remoteModifier().setContents(path, size, 'C');
+            fakeFolder.remoteModifier().setModTime(path, mtime.addDays(1));
+            fakeFolder.remoteModifier().find(path)->checksums =
+                "SHA1:" + QCryptographicHash::hash(QByteArray(size, 'C'), QCryptographicHash::Sha1).toHex();
+        }
+        // same size, but different content
+        const auto b2size = fakeFolder.currentRemoteState().find(QStringLiteral("B/b2"))->contentSize;
+        fakeFolder.localModifier().setContents(QStringLiteral("B/b2"), b2size, 'D');
+        fakeFolder.remoteModifier().setContents(QStringLiteral("B/b2"), b2size, 'E');
+        fakeFolder.remoteModifier().find(QStringLiteral("B/b2"))->checksums =
+            "SHA1:" + QCryptographicHash::hash(QByteArray(b2size, 'E'), QCryptographicHash::Sha1).toHex();
+
+        int resolved = 0;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, [&](const SyncFileItemSet &items) {
+            for (const auto &item : items) {
+                if (identical.contains(item->_file)) {
+                    QCOMPARE(item->instruction(), CSYNC_INSTRUCTION_UPDATE_METADATA);
+                    ++resolved;
+                } else if (item->_file == QLatin1String("B/b2")) {
+                    QCOMPARE(item->instruction(), CSYNC_INSTRUCTION_CONFLICT);
+                }
+            }
+        });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(resolved, identical.size());
+        // only the real conflict is downloaded
+        QCOMPARE(counter.nGET, 1);
+        QCOMPARE(fakeFolder.currentLocalState().find(QStringLiteral("B/b2"))->contentChar, 'E');
+        for (const auto &path : identical) {
+            SyncJournalFileRecord record;
+            QVERIFY(fakeFolder.syncJournal().getFileRecord(path, &record));
+            QCOMPARE(record._modtime, (qint64)FileSystem::getModTime(fakeFolder.localPath() + path));
+        }
+    }
+
     /**
      * Checks whether SyncFileItems have the expected properties before start
      * of propagation.
@@ -878,6 +1170,774 @@ private Q_SLOTS:
         QVERIFY(!fakeFolder.currentLocalState().find(QStringLiteral("A")));
         QVERIFY(!fakeFolder.currentLocalState().find(QStringLiteral("S")));
     }
+
+    void testPipelinedPropagation()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("A dehydrated file is not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo {}, vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._pipelinedPropagation = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // A is discovered long before the deep D
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/a1"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("D"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("D/1"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("D/1/2"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("D/1/2/3"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("D/1/2/3/d1"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("rootFile"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("L"));
+        fakeFolder.localModifier().insert(QStringLiteral("L/l1"));
+
+        bool downloading = false;
+        int propfindsWhileDownloading = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                downloading = true;
+            } else if (downloading && request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND") {
+                propfindsWhileDownloading++;
+            }
+            return nullptr;
+        });
+        int batches = 0;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this, [&] { batches++; });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::moreItemsAboutToPropagate, this, [&] { batches++; });
+
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(batches > 1);
+        QVERIFY(propfindsWhileDownloading > 0);
+
+        // with a previous state everything is propagated at once
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/a2"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("D/d2"));
+        batches = 0;
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(batches, 1);
+    }
+
+    void testPropagationOrder()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("A dehydrated file is not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo {}, vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelNetworkJobs = 1;
+        options._propagationOrder = SyncOptions::PropagationOrder::SmallestFirst;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        QStringList downloads;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                downloads.append(request.url().path().section(QLatin1Char('/'), -1));
+            }
+            return nullptr;
+        });
+
+        fakeFolder.remoteModifier().insert(QStringLiteral("a"), 300);
+        fakeFolder.remoteModifier().insert(QStringLiteral("b"), 100);
+        fakeFolder.remoteModifier().insert(QStringLiteral("c"), 200);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(downloads, (QStringList{QStringLiteral("b"), QStringLiteral("c"), QStringLiteral("a")}));
+
+        // the files the user waits for come first, directories are ranked by their files
+        downloads.clear();
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/d"), 10);
+        fakeFolder.remoteModifier().insert(QStringLiteral("e"), 20);
+        fakeFolder.remoteModifier().insert(QStringLiteral("f"), 500);
+        fakeFolder.syncEngine().setPriorityPaths({QStringLiteral("f")});
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(downloads, (QStringList{QStringLiteral("f"), QStringLiteral("d"), QStringLiteral("e")}));
+    }
+
+    void testSchedulingLanesKeepOrder()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("A dehydrated file is not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        // one slot for large transfers, one for everything else
+        options._parallelNetworkJobs = 2;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        QStringList requests;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray();
+            if (verb == "MOVE") {
+                requests.append(QStringLiteral("MOVE"));
+            } else if (op == QNetworkAccessManager::GetOperation || op == QNetworkAccessManager::PutOperation) {
+                requests.append(request.url().path().section(QLatin1Char('/'), -1));
+            }
+            return nullptr;
+        });
+
+        // the directory move must finish before anything after it starts, in either lane
+        fakeFolder.localModifier().rename(QStringLiteral("A"), QStringLiteral("A2"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("big"), 1024 * 1024);
+        fakeFolder.remoteModifier().insert(QStringLiteral("B/small"), 10);
+        fakeFolder.localModifier().insert(QStringLiteral("C/bigUp"), 1024 * 1024);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(requests.size(), 4);
+        QCOMPARE(requests.first(), QStringLiteral("MOVE"));
+    }
+
+    void testBulkUpload()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto cap = TestUtils::testCapabilities();
+        auto dav = cap[QStringLiteral("dav")].toMap();
+        dav.insert(QStringLiteral("bulkupload"), QStringLiteral("1.0"));
+        cap[QStringLiteral("dav")] = dav;
+        fakeFolder.syncEngine().account()->setCapabilities({fakeFolder.account()->url(), cap});
+
+        QStringList bulkFiles;
+        bool md5Matches = true;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::PostOperation || !request.url().path().endsWith(QLatin1String("/remote.php/dav/bulk"))) {
+                return nullptr;
+            }
+            const QByteArray boundary = "--" + request.header(QNetworkRequest::ContentTypeHeader).toByteArray().split('=').last();
+            const QByteArray body = outgoingData->readAll();
+            QJsonObject result;
+            qsizetype pos = body.indexOf(boundary);
+            while (pos != -1 && body.mid(pos + boundary.size(), 2) != "--") {
+                const qsizetype headerStart = pos + boundary.size() + 2;
+                const qsizetype headerEnd = body.indexOf("\r\n\r\n", headerStart);
+                QMap<QByteArray, QByteArray> headers;
+                for (const auto &line : body.mid(headerStart, headerEnd - headerStart).split('\n')) {
+                    const qsizetype colon = line.indexOf(':');
+                    headers.insert(line.left(colon), line.mid(colon + 1).trimmed());
+                }
+                const QByteArray data = body.mid(headerEnd + 4, headers.value("Content-Length").toLongLong());
+                md5Matches &= QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex() == headers.value("X-File-MD5");
+                const QString path = QString::fromUtf8(headers.value("X-File-Path")).mid(1);
+                bulkFiles.append(path);
+                fakeFolder.remoteModifier().insert(path, data.size(), data.isEmpty() ? 'W' : data.at(0));
+                auto *fileInfo = fakeFolder.remoteModifier().find(path);
+                fileInfo->setLastModifiedFromSecondsUTC(headers.value("X-File-Mtime").toLongLong());
+                result.insert(QString::fromUtf8(headers.value("X-File-Path")),
+                    QJsonObject{{QStringLiteral("etag"), QString::fromUtf8(fileInfo->etag)}, {QStringLiteral("fileid"), QString::fromUtf8(fileInfo->fileId)}});
+                pos = body.indexOf(boundary, headerEnd + 4 + data.size());
+            }
+            return new FakePayloadReply(op, request, QJsonDocument(result).toJson(), this);
+        });
+
+        fakeFolder.localModifier().insert(QStringLiteral("A/new1"), 10);
+        fakeFolder.localModifier().insert(QStringLiteral("A/new2"), 20);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        bulkFiles.sort();
+        QCOMPARE(bulkFiles, (QStringList{QStringLiteral("A/new1"), QStringLiteral("A/new2")}));
+        QVERIFY(md5Matches);
+
+        // a file that changes after its checksum was computed is not uploaded with the wrong size
+        bulkFiles.clear();
+        fakeFolder.localModifier().insert(QStringLiteral("B/changing"), 10);
+        fakeFolder.localModifier().insert(QStringLiteral("B/other"), 10);
+        QVERIFY(fakeFolder.applyLocalModificationsWithoutSync());
+        const QString changingPath = fakeFolder.localPath() + QStringLiteral("B/changing");
+        bool changed = false;
+        auto con = connect(&fakeFolder.syncEngine(), &SyncEngine::transmissionProgress, this, [&](const ProgressInfo &progress) {
+            if (!changed && progress._currentItems.contains(QStringLiteral("B/changing"))) {
+                changed = true;
+                const auto modTime = FileSystem::getModTime(changingPath);
+                QFile file(changingPath);
+                QVERIFY(file.open(QIODevice::Append));
+                file.write("X");
+                file.close();
+                FileSystem::setModTime(changingPath, modTime);
+            }
+        });
+        ItemCompletedSpy completeSpy(fakeFolder);
+        fakeFolder.syncOnce();
+        disconnect(con);
+        QVERIFY(changed);
+        QCOMPARE(bulkFiles, QStringList{QStringLiteral("B/other")});
+        QCOMPARE(completeSpy.findItem(QStringLiteral("B/changing"))->_status, SyncFileItem::Message);
+        QVERIFY(!fakeFolder.currentRemoteState().find(QStringLiteral("B/changing")));
+        QVERIFY(fakeFolder.syncEngine().isAnotherSyncNeeded());
+
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentRemoteState().find(QStringLiteral("B/changing"))->contentSize, quint64(11));
+    }
+
+    void testArchiveDownload()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("Dehydrated files are not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo{}, vfsMode, filesAreDehydrated);
+        auto cap = TestUtils::testCapabilities();
+        auto files = cap[QStringLiteral("files")].toMap();
+        files.insert(QStringLiteral("archivers"),
+            QVariantList{QVariantMap{{QStringLiteral("enabled"), true}, {QStringLiteral("formats"), QStringList{QStringLiteral("tar"), QStringLiteral("zip")}},
+                {QStringLiteral("archiver_url"), QStringLiteral("/archiver")}}});
+        cap[QStringLiteral("files")] = files;
+        fakeFolder.account()->setCapabilities({fakeFolder.account()->url(), cap});
+
+        // the name doesn't fit into a ustar header, it is sent in a pax header
+        const QString longName = QStringLiteral("long").repeated(30);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/a1"), 10, 'a');
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/a2"), 600, 'b');
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/") + longName, 20, 'c');
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/missing"), 30, 'd');
+        fakeFolder.remoteModifier().find(QStringLiteral("A/a2"))->checksums =
+            "SHA1:" + QCryptographicHash::hash(QByteArray(600, 'b'), QCryptographicHash::Sha1).toHex();
+
+        const auto tarEntry = [](char type, const QByteArray &name, const QByteArray &data) {
+            QByteArray header(512, '\0');
+            header.replace(0, qMin<qsizetype>(name.size(), 100), name.left(100));
+            header.replace(100, 7, "0000644");
+            header.replace(124, 11, QByteArray::number(data.size(), 8).rightJustified(11, '0'));
+            header[156] = type;
+            header.replace(257, 8, QByteArray("ustar\0" "00", 8));
+            header.replace(148, 8, QByteArray(8, ' '));
+            int sum = 0;
+            for (const char c : std::as_const(header)) {
+                sum += uchar(c);
+            }
+            header.replace(148, 7, QByteArray::number(sum, 8).rightJustified(6, '0') + '\0');
+            return header + data + QByteArray((512 - data.size() % 512) % 512, '\0');
+        };
+        std::function<const FileInfo *(const FileInfo &, const QByteArray &)> findById = [&](const FileInfo &dir, const QByteArray &id) -> const FileInfo * {
+            for (const auto &child : dir.children) {
+                if (child.fileId == id) {
+                    return &child;
+                }
+                if (const auto *found = findById(child, id)) {
+                    return found;
+                }
+            }
+            return nullptr;
+        };
+
+        QString outputFormat;
+        QStringList archived;
+        QStringList downloaded;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            if (!request.url().path().endsWith(QLatin1String("/archiver"))) {
+                downloaded.append(request.url().path().section(QLatin1Char('/'), -1));
+                return nullptr;
+            }
+            const QUrlQuery query(request.url());
+            outputFormat = query.queryItemValue(QStringLiteral("output-format"));
+            QByteArray tar;
+            for (const auto &id : query.allQueryItemValues(QStringLiteral("id"))) {
+                const auto *file = findById(fakeFolder.remoteModifier(), id.toUtf8());
+                // the archiver leaves out what it can't find
+                if (!file || file->name == QLatin1String("missing")) {
+                    continue;
+                }
+                archived.append(file->name);
+                const QByteArray name = file->name.toUtf8();
+                if (name.size() > 100) {
+                    QByteArray record = " path=" + name + '\n';
+                    record.prepend(QByteArray::number(record.size() + QByteArray::number(record.size()).size()));
+                    tar += tarEntry('x', "PaxHeaders/" + name.left(80), record);
+                }
+                tar += tarEntry('0', name, QByteArray(file->contentSize, file->contentChar));
+            }
+            tar += QByteArray(2 * 512, '\0');
+            return new FakePayloadReply(op, request, tar, this);
+        });
+
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(outputFormat, QStringLiteral("tar"));
+        archived.sort();
+        QCOMPARE(archived, (QStringList{QStringLiteral("a1"), QStringLiteral("a2"), longName}));
+        // only the file that was not in the archive was downloaded on its own
+        QVERIFY(downloaded.contains(QStringLiteral("missing")));
+        QVERIFY(!downloaded.contains(QStringLiteral("a1")));
+        QVERIFY(!downloaded.contains(QStringLiteral("a2")));
+    }
+
+    void testServerSideCopy()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("The local and remote state of dehydrated files differ");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._serverSideCopy = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        constexpr quint64 size = 1000 * 1000;
+        fakeFolder.localModifier().insert(QStringLiteral("A/big"), size, 'X');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        int nPUT = 0;
+        int nCOPY = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation) {
+                nPUT++;
+            } else if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "COPY") {
+                nCOPY++;
+            }
+            return nullptr;
+        });
+
+        // the copy of a synced file is copied on the server
+        fakeFolder.localModifier().insert(QStringLiteral("B/big copy"), size, 'X');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(nCOPY, 1);
+        QCOMPARE(nPUT, 0);
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QStringLiteral("B/big copy"), &record));
+        QCOMPARE(record._etag, fakeFolder.currentRemoteState().find(QStringLiteral("B/big copy"))->etag);
+        QVERIFY(record._fileId != fakeFolder.currentRemoteState().find(QStringLiteral("A/big"))->fileId);
+
+        // different content is uploaded
+        nCOPY = 0;
+        fakeFolder.localModifier().insert(QStringLiteral("B/other"), size, 'Y');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(nCOPY, 0);
+        QCOMPARE(nPUT, 1);
+
+        // the sources changed on the server since they were synced, the copy fails and the file is uploaded
+        nPUT = 0;
+        fakeFolder.remoteModifier().setContents(QStringLiteral("A/big"), size, 'Z');
+        fakeFolder.remoteModifier().setContents(QStringLiteral("B/big copy"), size, 'Z');
+        fakeFolder.localModifier().insert(QStringLiteral("C/big copy"), size, 'X');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find(QStringLiteral("C/big copy"))->contentChar, 'X');
+        QCOMPARE(nPUT, 1);
+    }
+
+    void testSyncDirection()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._syncDirection = SyncOptions::SyncDirection::UploadOnly;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        int nPROPFIND = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == QByteArrayLiteral("PROPFIND")) {
+                ++nPROPFIND;
+            }
+            return nullptr;
+        });
+
+        // the remote change is not noticed
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/remote"));
+        fakeFolder.localModifier().insert(QStringLiteral("B/local"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(nPROPFIND, 0);
+        QVERIFY(fakeFolder.currentRemoteState().find(QStringLiteral("B/local")));
+        QVERIFY(!fakeFolder.currentLocalState().find(QStringLiteral("A/remote")));
+
+        options._syncDirection = SyncOptions::SyncDirection::DownloadOnly;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // the local change is not noticed
+        fakeFolder.localModifier().insert(QStringLiteral("C/local"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("C/remote"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QVERIFY(nPROPFIND > 0);
+        QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("A/remote")));
+        QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("C/remote")));
+        QVERIFY(!fakeFolder.currentRemoteState().find(QStringLiteral("C/local")));
+
+        options._syncDirection = SyncOptions::SyncDirection::Bidirectional;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testItemsCompletedBatches()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        QStringList completed;
+        QStringList batched;
+        int batches = 0;
+        bool finished = false;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&](const SyncFileItemPtr &item) { completed.append(item->_file); });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemsCompleted, this, [&](const QVector<SyncFileItemPtr> &items) {
+            QVERIFY(!finished);
+            QVERIFY(!items.isEmpty());
+            ++batches;
+            for (const auto &item : items) {
+                batched.append(item->_file);
+            }
+        });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::finished, this, [&] { finished = true; });
+
+        for (int i = 0; i < 20; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/new%1").arg(i), 10_B);
+            fakeFolder.remoteModifier().insert(QStringLiteral("B/new%1").arg(i), 10_B);
+        }
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QVERIFY(finished);
+        // all items arrive in the same order, in fewer signals
+        QCOMPARE(batched, completed);
+        QVERIFY(batches < completed.size());
+    }
+
+    void testSkipUnchangedContentUploads()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("The local and remote state of dehydrated files differ");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._skipUnchangedContentUploads = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        constexpr quint64 size = 1000 * 1000;
+        fakeFolder.localModifier().insert(QStringLiteral("A/big"), size, 'X');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        const auto etag = fakeFolder.currentRemoteState().find(QStringLiteral("A/big"))->etag;
+
+        int nPUT = 0;
+        int nPROPPATCH = 0;
+        bool failProppatch = false;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation) {
+                ++nPUT;
+            } else if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == QByteArrayLiteral("PROPPATCH")) {
+                ++nPROPPATCH;
+                if (failProppatch) {
+                    return new FakeErrorReply(op, request, this, 403);
+                }
+            }
+            return nullptr;
+        });
+        auto touch = [&](int days) {
+            auto mtime = QDateTime::currentDateTimeUtc().addDays(-days);
+            mtime.setMSecsSinceEpoch(mtime.toMSecsSinceEpoch() / 1000 * 1000);
+            fakeFolder.localModifier().setModTime(QStringLiteral("A/big"), mtime);
+        };
+
+        // a file that was only touched is not uploaded, only its modification time is set
+        touch(1);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(nPUT, 0);
+        QCOMPARE(nPROPPATCH, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        const auto touchedEtag = fakeFolder.currentRemoteState().find(QStringLiteral("A/big"))->etag;
+        QVERIFY(touchedEtag != etag);
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QStringLiteral("A/big"), &record));
+        QCOMPARE(record._etag, touchedEtag);
+
+        // the next sync has nothing to do
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(nPUT, 0);
+        QCOMPARE(nPROPPATCH, 1);
+
+        // a server that doesn't accept the modification time gets the upload
+        failProppatch = true;
+        touch(2);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(nPUT, 1);
+        QCOMPARE(nPROPPATCH, 2);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // changed content of the same size is uploaded
+        fakeFolder.localModifier().setContents(QStringLiteral("A/big"), size, 'Y');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(nPUT, 2);
+        QCOMPARE(nPROPPATCH, 2);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSnapshotUploads()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._snapshotUploads = true;
+        // upload the large file in chunks
+        options._initialChunkSize = options._minChunkSize = options._maxChunkSize = 1000 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // without copy-on-write support in the file system the files themselves are uploaded
+        fakeFolder.localModifier().insert(QStringLiteral("A/small"), 100_B);
+        fakeFolder.localModifier().insert(QStringLiteral("A/big"), 3 * 1000 * 1000, 'X');
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        // no snapshots are left behind
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testPropfindAcceptEncoding()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        int propfinds = 0;
+        int propfindsWithAcceptEncoding = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            // Qt negotiates the compression of the replies only if no Accept-Encoding is set
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND") {
+                ++propfinds;
+                if (request.hasRawHeader("Accept-Encoding")) {
+                    ++propfindsWithAcceptEncoding;
+                }
+            }
+            return nullptr;
+        });
+
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(propfinds > 0);
+        QCOMPARE(propfindsWithAcceptEncoding, 0);
+    }
+
+    void testSyncMetrics()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("A dehydrated file is not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        QVERIFY(!fakeFolder.syncEngine().lastSyncMetrics().isValid());
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/newRemoteFile"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        const auto &metrics = fakeFolder.syncEngine().lastSyncMetrics();
+        QVERIFY(metrics.isValid());
+        QVERIFY(metrics.requests().contains("PROPFIND"));
+        QCOMPARE(metrics.requests().value("GET").count, 1);
+        QVERIFY(metrics.toJson().value(QStringLiteral("success")).toBool());
+        QCOMPARE(metrics.toJson().value(QStringLiteral("bytesReceived")).toInteger(), fakeFolder.currentLocalState().find(QStringLiteral("A/newRemoteFile"))->size);
+        // the listings and the download were read while they arrived, within the bounds of their buffers
+        const auto buffered = metrics.toJson().value(QStringLiteral("maximumBufferedBytes")).toInteger();
+        QVERIFY(buffered > 0);
+        QVERIFY(buffered <= PropfindJob::ReadBufferSize);
+
+        const QByteArray prometheus = SyncMetrics::toPrometheus({{QStringLiteral("folder \"1\""), metrics}});
+        QVERIFY(prometheus.contains("# TYPE owncloud_sync_request_duration_seconds histogram\n"));
+        QVERIFY(prometheus.contains("owncloud_sync_request_duration_seconds_count{folder=\"folder \\\"1\\\"\",verb=\"GET\"} 1\n"));
+        QVERIFY(prometheus.contains("owncloud_sync_request_duration_seconds_bucket{folder=\"folder \\\"1\\\"\",verb=\"GET\",le=\"+Inf\"} 1\n"));
+    }
+
+    /**
+     * Only the requests that move file contents may use the separate HTTP/2 transfer connections
+     */
+    void testTransferRequestsMarked()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("A dehydrated file is not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/download"));
+        fakeFolder.localModifier().insert(QStringLiteral("B/upload"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("C/newdir"));
+
+        QMap<QByteArray, bool> transferVerbs;
+        bool consistent = true;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const bool transfer = request.attribute(AccessManager::TransferAttribute).toBool();
+            const auto verb = HttpLogger::requestVerb(op, request);
+            // a verb is either always a transfer or never
+            consistent &= transferVerbs.value(verb, transfer) == transfer;
+            transferVerbs.insert(verb, transfer);
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(consistent);
+
+        QCOMPARE(transferVerbs.value("GET", false), true);
+        QCOMPARE(transferVerbs.value("PUT", false), true);
+        QCOMPARE(transferVerbs.value("PROPFIND", true), false);
+        QCOMPARE(transferVerbs.value("MKCOL", true), false);
+    }
+
+    /**
+     * Several engines can sync with one account at the same time, as owncloudcmd does for a batch file
+     */
+    void testEnginesShareAccount()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        if (vfsMode != Vfs::Off) {
+            QSKIP("owncloudcmd doesn't use a vfs");
+        }
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12());
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"), 100);
+
+        auto dir = TestUtils::createTempDir();
+        const QString localPath = dir.path() + QLatin1Char('/');
+        SyncJournalDb journal(localPath + QStringLiteral(".sync_test.db"));
+        SyncEngine engine(fakeFolder.account(), fakeFolder.account()->davUrl(), localPath, QString(), &journal);
+        engine.setSyncOptions(SyncOptions{QSharedPointer<Vfs>(VfsPluginManager::instance().createVfsFromPlugin(Vfs::Off).release())});
+        engine.addManualExclude(QStringLiteral("]*.~*"));
+
+        QSignalSpy finished(&engine, &SyncEngine::finished);
+        QSignalSpy fakeFinished(&fakeFolder.syncEngine(), &SyncEngine::finished);
+        engine.startSync();
+        fakeFolder.syncEngine().startSync();
+        QVERIFY(engine.isSyncRunning());
+        QVERIFY(fakeFolder.syncEngine().isSyncRunning());
+
+        QTRY_COMPARE(finished.size(), 1);
+        QTRY_COMPARE(fakeFinished.size(), 1);
+        QVERIFY(finished.first().first().toBool());
+        QVERIFY(fakeFinished.first().first().toBool());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        for (const auto &path : {QStringLiteral("A/a1"), QStringLiteral("A/new"), QStringLiteral("S/s2")}) {
+            QCOMPARE(QFileInfo(localPath + path).size(), fakeFolder.currentRemoteState().find(path)->size);
+        }
+    }
+
+    /**
+     * The tuning options of owncloudcmd override the parallelism of the propagator
+     */
+    void testParallelNetworkJobs()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+        if (filesAreDehydrated) {
+            QSKIP("A dehydrated file is not downloaded");
+        }
+
+        FakeFolder fakeFolder(FileInfo {}, vfsMode, filesAreDehydrated);
+        int running = 0;
+        int maxRunning = 0;
+        QObject parent;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            auto *reply = new FakeGetReply(fakeFolder.remoteModifier(), op, request, &parent);
+            maxRunning = std::max(maxRunning, ++running);
+            connect(reply, &QNetworkReply::finished, &parent, [&running] { --running; });
+            return reply;
+        });
+        const auto syncFiles = [&](const QString &dirName) {
+            fakeFolder.remoteModifier().mkdir(dirName);
+            for (int i = 0; i < 10; ++i) {
+                fakeFolder.remoteModifier().insert(dirName + QStringLiteral("/file%1").arg(i), 1024 * 1024);
+            }
+            maxRunning = 0;
+            return fakeFolder.applyLocalModificationsAndSync();
+        };
+
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelNetworkJobs = 1;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QVERIFY(syncFiles(QStringLiteral("A")));
+        QCOMPARE(maxRunning, 1);
+
+        // the adaptive mode is bounded by the parallel jobs, the limit is shared by the account
+        options._parallelNetworkJobs = 4;
+        options._transferConcurrencyMode = SyncOptions::TransferConcurrencyMode::Adaptive;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QVERIFY(syncFiles(QStringLiteral("B")));
+        QCOMPARE(fakeFolder.account()->transferConcurrency()->maximum(), 4);
+        QVERIFY(maxRunning >= 1 && maxRunning <= 4);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    /**
+     * A dry run announces the items but changes nothing, see owncloudcmd --dry-run
+     */
+    void testDryRun()
+    {
+        QFETCH_GLOBAL(Vfs::Mode, vfsMode);
+        QFETCH_GLOBAL(bool, filesAreDehydrated);
+
+        FakeFolder fakeFolder(FileInfo::A12_B12_C12_S12(), vfsMode, filesAreDehydrated);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._dryRun = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/remoteNew"));
+        fakeFolder.remoteModifier().remove(QStringLiteral("B/b1"));
+        fakeFolder.localModifier().insert(QStringLiteral("C/localNew"));
+        const FileInfo remoteBefore = fakeFolder.currentRemoteState();
+        const FileInfo dbBefore = fakeFolder.dbState();
+
+        QStringList requests;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto verb = HttpLogger::requestVerb(op, request);
+            if (verb != QByteArrayLiteral("PROPFIND")) {
+                requests.append(QString::fromUtf8(verb));
+            }
+            return nullptr;
+        });
+        QMap<QString, SyncInstruction> announced;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this, [&announced](const SyncFileItemSet &items) {
+            for (const auto &item : items) {
+                announced.insert(item->destination(), item->_instruction);
+            }
+        });
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+
+        QCOMPARE(announced.value(QStringLiteral("A/remoteNew")), CSYNC_INSTRUCTION_NEW);
+        QCOMPARE(announced.value(QStringLiteral("B/b1")), CSYNC_INSTRUCTION_REMOVE);
+        QCOMPARE(announced.value(QStringLiteral("C/localNew")), CSYNC_INSTRUCTION_NEW);
+        QCOMPARE(requests, QStringList());
+        QCOMPARE(fakeFolder.currentRemoteState(), remoteBefore);
+        QCOMPARE(fakeFolder.dbState(), dbBefore);
+        QVERIFY(!fakeFolder.currentLocalState().find(QStringLiteral("A/remoteNew")));
+        QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("B/b1")));
+
+        // the real sync finds the same changes
+        options._dryRun = false;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(fakeFolder.currentRemoteState().find(QStringLiteral("C/localNew")));
+        QVERIFY(!fakeFolder.currentRemoteState().find(QStringLiteral("B/b1")));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
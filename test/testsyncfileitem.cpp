@@ -7,6 +7,7 @@
 #include <QtTest>
 
 #include "syncfileitem.h"
+#include "syncplan.h"
 
 using namespace OCC;
 
@@ -62,6 +63,87 @@ private Q_SLOTS:
         QVERIFY(!(a < a));
         QVERIFY(!(b < b));
         QVERIFY(!(c < c));
+
+        // the sort keys order the same way
+        QVERIFY(a.sortKey() < b.sortKey());
+        QVERIFY(b.sortKey() < c.sortKey());
+    }
+
+    void testSet_data() { testComparator_data(); }
+
+    void testSet()
+    {
+        QFETCH(SyncFileItem, a);
+        QFETCH(SyncFileItem, b);
+        QFETCH(SyncFileItem, c);
+
+        const auto ptrA = SyncFileItemPtr::create(a);
+        const auto ptrB = SyncFileItemPtr::create(b);
+        const auto ptrC = SyncFileItemPtr::create(c);
+
+        SyncFileItemSet set;
+        set.insert(ptrC);
+        set.insert(ptrA);
+        set.insert(ptrB);
+        QCOMPARE(set.size(), 3);
+        QVERIFY(std::is_sorted(set.begin(), set.end()));
+        QCOMPARE(*set.begin(), ptrA);
+
+        QCOMPARE(set.removeIf([&](const SyncFileItemPtr &item) { return item == ptrB; }), 1);
+        QCOMPARE(std::vector<SyncFileItemPtr>(set.begin(), set.end()), (std::vector<SyncFileItemPtr>{ptrA, ptrC}));
+
+        // appending in order doesn't need to sort again
+        set.clear();
+        set.insert(ptrA);
+        set.insert(ptrB);
+        set.insert(ptrC);
+        QCOMPARE(std::vector<SyncFileItemPtr>(set.begin(), set.end()), (std::vector<SyncFileItemPtr>{ptrA, ptrB, ptrC}));
+    }
+
+    void testSyncPlan()
+    {
+        auto makeItem = [](const QString &file, SyncFileItem::Direction direction, qint64 size, ItemType type = ItemTypeFile) {
+            auto item = SyncFileItemPtr::create();
+            item->_file = file;
+            item->_direction = direction;
+            item->_size = size;
+            item->_type = type;
+            item->setInstruction(CSYNC_INSTRUCTION_NEW);
+            return item;
+        };
+
+        const auto small = makeItem(QStringLiteral("a"), SyncFileItem::Down, 10);
+        const auto large = makeItem(QStringLiteral("b"), SyncFileItem::Down, 100);
+        const auto medium = makeItem(QStringLiteral("c"), SyncFileItem::Down, 50);
+        const auto placeholder = makeItem(QStringLiteral("d"), SyncFileItem::Down, 1000, ItemTypeVirtualFile);
+        const auto upload = makeItem(QStringLiteral("e"), SyncFileItem::Up, 30);
+        // only the growth of a changed file counts
+        const auto changed = makeItem(QStringLiteral("f"), SyncFileItem::Up, 25);
+        changed->setInstruction(CSYNC_INSTRUCTION_SYNC);
+        changed->_previousSize = 20;
+
+        SyncFileItemSet items;
+        for (const auto &item : {small, large, medium, placeholder, upload, changed}) {
+            items.insert(item);
+        }
+        const SyncPlan plan(items);
+        QCOMPARE(plan.downloadBytes(), qint64(160));
+        QCOMPARE(plan.uploadBytes(), qint64(35));
+        QCOMPARE(plan.placeholders(), qsizetype(1));
+
+        QVERIFY(plan.fitInto(-1, -1).isEmpty());
+        QVERIFY(plan.fitInto(160, 35).isEmpty());
+
+        // the largest downloads are left out first
+        auto shortfall = plan.fitInto(60, -1);
+        QCOMPARE(shortfall.downloads, QVector<SyncFileItemPtr>{large});
+        QCOMPARE(shortfall.downloadBytes, qint64(100));
+        QVERIFY(shortfall.uploads.isEmpty());
+
+        shortfall = plan.fitInto(59, 5);
+        QCOMPARE(shortfall.downloads, (QVector<SyncFileItemPtr>{large, medium}));
+        QCOMPARE(shortfall.uploads, QVector<SyncFileItemPtr>{upload});
+        QCOMPARE(shortfall.uploadBytes, qint64(30));
     }
 };
 
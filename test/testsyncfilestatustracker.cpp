@@ -435,6 +435,48 @@ private Q_SLOTS:
     // Even for status pushes immediately following each other, macOS
     // can sometimes have 1s delays between updates, so make sure that
     // children are marked as OK before their parents do.
+    void deepPathsGetWarningStatusForError() {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/x"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/x/y"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/x/y/z"));
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        auto &tracker = fakeFolder.syncEngine().syncFileStatusTracker();
+        const QStringList parents = {QString(), QStringLiteral("A"), QStringLiteral("A/x"), QStringLiteral("A/x/y")};
+
+        // A touched file is syncing until a sync looked at it, its parents are not
+        tracker.slotPathTouched(fakeFolder.localPath() + QStringLiteral("A/x/y/z"));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/x/y/z")), SyncFileStatus(SyncFileStatus::StatusSync));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/x/y")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+
+        fakeFolder.serverErrorPaths().append(QStringLiteral("A/x/y/z"));
+        fakeFolder.localModifier().appendByte(QStringLiteral("A/x/y/z"));
+        QVERIFY(fakeFolder.applyLocalModificationsWithoutSync());
+        StatusPushSpy statusSpy(fakeFolder.syncEngine());
+        fakeFolder.scheduleSync();
+        fakeFolder.execUntilFinished();
+        verifyThatPushMatchesPull(fakeFolder, statusSpy);
+        // Every parent shows the error below it
+        for (const auto &path : parents) {
+            QCOMPARE(statusSpy.statusOf(path), SyncFileStatus(SyncFileStatus::StatusWarning));
+        }
+        QCOMPARE(statusSpy.statusOf(QStringLiteral("A/x/y/z")), SyncFileStatus(SyncFileStatus::StatusError));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("B")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        statusSpy.clear();
+
+        // Once the error is resolved, the warnings of all parents are gone
+        fakeFolder.serverErrorPaths().clear();
+        fakeFolder.syncEngine().journal()->wipeErrorBlacklistEntry(QStringLiteral("A/x/y/z"));
+        fakeFolder.scheduleSync();
+        fakeFolder.execUntilFinished();
+        verifyThatPushMatchesPull(fakeFolder, statusSpy);
+        for (const auto &path : parents) {
+            QCOMPARE(statusSpy.statusOf(path), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        }
+        QCOMPARE(statusSpy.statusOf(QStringLiteral("A/x/y/z")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void childOKEmittedBeforeParent() {
         FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
         fakeFolder.localModifier().appendByte(QStringLiteral("B/b1"));
@@ -492,6 +534,30 @@ private Q_SLOTS:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void queriedStatusFollowsChanges() {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto &tracker = fakeFolder.syncEngine().syncFileStatusTracker();
+        // query them before the sync, as a shell showing the folder does
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/a1")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/a2")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+
+        fakeFolder.serverErrorPaths().append(QStringLiteral("A/a1"));
+        fakeFolder.localModifier().appendByte(QStringLiteral("A/a1"));
+        QVERIFY(fakeFolder.applyLocalModificationsWithoutSync());
+
+        fakeFolder.scheduleSync();
+        fakeFolder.execUntilBeforePropagation();
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A")), SyncFileStatus(SyncFileStatus::StatusSync));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/a1")), SyncFileStatus(SyncFileStatus::StatusSync));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/a2")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+
+        fakeFolder.execUntilFinished();
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A")), SyncFileStatus(SyncFileStatus::StatusWarning));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/a1")), SyncFileStatus(SyncFileStatus::StatusError));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("A/a2")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+    }
+
     void renameError() {
         FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
         fakeFolder.serverErrorPaths().append(QStringLiteral("A/a1"));
@@ -8,6 +8,7 @@
 
 #include <sqlite3.h>
 
+#include "common/c_jhash.h"
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
 
@@ -170,6 +171,97 @@ private Q_SLOTS:
         QVERIFY(!wipedRecord._valid);
     }
 
+    void testBatchedWrites()
+    {
+        _db.setCommitMode(SyncJournalDb::CommitMode::Batched);
+        _db.commit(QStringLiteral("testBatchedWrites"));
+
+        const auto modtime = dropMsecs(QDateTime::currentDateTime());
+        const auto makeRecord = [modtime](int i) {
+            SyncJournalFileRecord record;
+            record._path = "batched/" + QByteArray::number(i);
+            record._inode = i + 1;
+            record._modtime = modtime;
+            record._type = ItemTypeFile;
+            record._etag = "etag" + QByteArray::number(i);
+            record._fileId = "id" + QByteArray::number(i);
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._fileSize = i;
+            record._checksumHeader = "MD5:" + QByteArray::number(i);
+            return record;
+        };
+
+        // changes of the same path are coalesced
+        QVERIFY(_db.setFileRecord(makeRecord(0)));
+        auto updated = makeRecord(0);
+        updated._etag = "updated";
+        QVERIFY(_db.setFileRecord(updated));
+        QVERIFY(_db.setFileRecord(makeRecord(1)));
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("batched/1")));
+        SyncJournalDb::DownloadInfo download;
+        download._tmpfile = QStringLiteral("batched/.0.part");
+        download._etag = "etag0";
+        download._valid = true;
+        _db.setDownloadInfo(QStringLiteral("batched/0"), download);
+        SyncJournalDb::UploadInfo upload;
+        upload._chunk = 3;
+        upload._transferid = 42;
+        upload._size = 100;
+        upload._valid = true;
+        _db.setUploadInfo(QStringLiteral("batched/0"), upload);
+        QCOMPARE(_db.pendingWriteCount(), qsizetype(4));
+
+        // reading writes the queue first
+        SyncJournalFileRecord stored;
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("batched/0"), &stored));
+        QCOMPARE(_db.pendingWriteCount(), qsizetype(0));
+        QVERIFY(stored == updated);
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("batched/1"), &stored));
+        QVERIFY(!stored.isValid());
+        QVERIFY(_db.getDownloadInfo(QStringLiteral("batched/0")) == download);
+        QCOMPARE(_db.getUploadInfo(QStringLiteral("batched/0"))._transferid, uint(42));
+
+        _db.setDownloadInfo(QStringLiteral("batched/0"), {});
+        _db.setUploadInfo(QStringLiteral("batched/0"), {});
+        QVERIFY(!_db.getDownloadInfo(QStringLiteral("batched/0"))._valid);
+        QVERIFY(!_db.getUploadInfo(QStringLiteral("batched/0"))._valid);
+
+        // more rows than fit into a single statement, the queue is written once it is full
+        const int count = 1200;
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(_db.setFileRecord(makeRecord(i)));
+        }
+        QVERIFY(_db.pendingWriteCount() < count);
+        for (int i = 0; i < count; i += 2) {
+            QVERIFY(_db.deleteFileRecord(QString::fromUtf8(makeRecord(i)._path)));
+        }
+
+        // switching back writes the queue
+        _db.setCommitMode(SyncJournalDb::CommitMode::Immediate);
+        QCOMPARE(_db.pendingWriteCount(), qsizetype(0));
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(_db.getFileRecord(makeRecord(i)._path, &stored));
+            if (i % 2 == 0) {
+                QVERIFY(!stored.isValid());
+            } else {
+                QVERIFY(stored == makeRecord(i));
+            }
+        }
+
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("batched"), true));
+    }
+
+    void testChangeJournalPosition()
+    {
+        QVERIFY(_db.changeJournalPosition().isEmpty());
+        _db.setChangeJournalPosition("uuid/42");
+        QCOMPARE(_db.changeJournalPosition(), QByteArray("uuid/42"));
+        _db.setChangeJournalPosition("uuid/43");
+        QCOMPARE(_db.changeJournalPosition(), QByteArray("uuid/43"));
+        _db.setChangeJournalPosition({});
+        QVERIFY(_db.changeJournalPosition().isEmpty());
+    }
+
     void testConflictRecord()
     {
         ConflictRecord record;
@@ -192,6 +284,115 @@ private Q_SLOTS:
         QVERIFY(!_db.conflictRecord(record.path).isValid());
     }
 
+    void testHydrationHistory()
+    {
+        QCOMPARE(_db.hydrationTime("a"), qint64(0));
+
+        _db.setHydrationTime("a", 1000);
+        _db.setHydrationTime("b", 1500);
+        _db.setHydrationTime("c", 5000);
+        QCOMPARE(_db.hydrationTime("a"), qint64(1000));
+
+        QCOMPARE(_db.hydratedAround(1000, 600, 10), QByteArrayList({"a", "b"}));
+        QCOMPARE(_db.hydratedAround(1400, 600, 10), QByteArrayList({"b", "a"}));
+        QCOMPARE(_db.hydratedAround(1400, 600, 1), QByteArrayList({"b"}));
+        QCOMPARE(_db.hydratedAround(3000, 600, 10), QByteArrayList());
+
+        // a new hydration replaces the old one
+        _db.setHydrationTime("a", 4800);
+        QCOMPARE(_db.hydratedAround(5000, 600, 10), QByteArrayList({"c", "a"}));
+
+        _db.deleteHydrationsBefore(4900);
+        QCOMPARE(_db.hydrationTime("a"), qint64(0));
+        QCOMPARE(_db.hydrationTime("b"), qint64(0));
+        QCOMPARE(_db.hydrationTime("c"), qint64(5000));
+    }
+
+    void testLeastRecentlyUsedFiles()
+    {
+        const auto makeEntry = [&](const QByteArray &path, ItemType type, qint64 size, qint64 modtime) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._fileSize = size;
+            record._modtime = modtime;
+            record._etag = "etag";
+            record._fileId = path;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(_db.setFileRecord(record));
+        };
+        makeEntry("lru/a", ItemTypeFile, 10, 100);
+        makeEntry("lru/b", ItemTypeFile, 20, 300);
+        makeEntry("lru/c", ItemTypeFile, 30, 200);
+        makeEntry("lru/virtual", ItemTypeVirtualFile, 1000, 50);
+        const qint64 sizeBefore = _db.hydratedFilesSize();
+        QVERIFY(sizeBefore >= 60);
+
+        // without access times the modification time is used
+        auto files = _db.leastRecentlyUsedFiles(100, 0);
+        QByteArrayList paths;
+        for (const auto &file : std::as_const(files)) {
+            if (file.path.startsWith("lru/")) {
+                paths.append(file.path);
+            }
+        }
+        QCOMPARE(paths, QByteArrayList({"lru/a", "lru/c", "lru/b"}));
+
+        _db.setAccessTime("lru/a", 400 * 1000);
+        files = _db.leastRecentlyUsedFiles(100, 0);
+        paths.clear();
+        for (const auto &file : std::as_const(files)) {
+            if (file.path.startsWith("lru/")) {
+                paths.append(file.path);
+            }
+        }
+        QCOMPARE(paths, QByteArrayList({"lru/c", "lru/b", "lru/a"}));
+        const auto a = std::find_if(files.cbegin(), files.cend(), [](const auto &file) { return file.path == "lru/a"; });
+        QVERIFY(a != files.cend());
+        QCOMPARE(a->accessTime, qint64(400 * 1000));
+
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("lru/a")));
+        QCOMPARE(_db.hydratedFilesSize(), sizeBefore - 10);
+        _db.deleteStaleAccessTimes();
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("lru"), true));
+    }
+
+    void testChecksumCache()
+    {
+        const auto sha1 = CheckSums::Algorithm::SHA1;
+        QVERIFY(_db.cachedChecksum(4711, 100, 10, sha1).isEmpty());
+        _db.setCachedChecksum(4711, 100, 10, sha1, "abc");
+        _db.setCachedChecksum(4712, 100, 10, sha1, "def");
+        QCOMPARE(_db.cachedChecksum(4711, 100, 10, sha1), QByteArray("abc"));
+        // the file changed
+        QVERIFY(_db.cachedChecksum(4711, 101, 10, sha1).isEmpty());
+        QVERIFY(_db.cachedChecksum(4711, 100, 11, sha1).isEmpty());
+        QVERIFY(_db.cachedChecksum(4711, 100, 10, CheckSums::Algorithm::MD5).isEmpty());
+        // a new version replaces the old one
+        _db.setCachedChecksum(4711, 200, 20, sha1, "ghi");
+        QVERIFY(_db.cachedChecksum(4711, 100, 10, sha1).isEmpty());
+        QCOMPARE(_db.cachedChecksum(4711, 200, 20, sha1), QByteArray("ghi"));
+
+        // the checksum of a file in sync with its record is kept
+        SyncJournalFileRecord record;
+        record._path = "checksumcache";
+        record._inode = 4711;
+        record._modtime = 200;
+        record._fileSize = 20;
+        record._type = ItemTypeFile;
+        record._etag = "etag";
+        record._fileId = "checksumcache";
+        record._remotePerm = RemotePermissions::fromDbValue("RW");
+        QVERIFY(_db.setFileRecord(record));
+        _db.deleteStaleCachedChecksums({4712});
+        QCOMPARE(_db.cachedChecksum(4711, 200, 20, sha1), QByteArray("ghi"));
+        QCOMPARE(_db.cachedChecksum(4712, 100, 10, sha1), QByteArray("def"));
+        _db.deleteStaleCachedChecksums({});
+        QCOMPARE(_db.cachedChecksum(4711, 200, 20, sha1), QByteArray("ghi"));
+        QVERIFY(_db.cachedChecksum(4712, 100, 10, sha1).isEmpty());
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("checksumcache")));
+    }
+
     void testAvoidReadFromDbOnNextSync()
     {
         auto invalidEtag = QByteArray("_invalid_");
@@ -312,6 +513,533 @@ private Q_SLOTS:
         QVERIFY(checkElements());
     }
 
+    void testRebasePaths()
+    {
+        SyncJournalDb db(_tempDir.path() + QStringLiteral("/rebase.db"));
+        auto makeEntry = [&](const QByteArray &path, ItemType type) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._etag = "etag_" + path;
+            record._fileId = "id_" + path;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(db.setFileRecord(record));
+        };
+        auto etag = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            db.getFileRecord(path, &record);
+            return record.isValid() ? record._etag : QByteArray();
+        };
+
+        makeEntry("sub", ItemTypeDirectory);
+        makeEntry("sub/a", ItemTypeFile);
+        makeEntry("sub/\xc3\xa4", ItemTypeFile);
+        makeEntry("sub/sub", ItemTypeDirectory);
+        makeEntry("sub/sub/a", ItemTypeFile);
+        makeEntry("subway", ItemTypeFile);
+        makeEntry("other", ItemTypeDirectory);
+        makeEntry("other/a", ItemTypeFile);
+        SyncJournalDb::DownloadInfo info;
+        info._etag = "etag_sub/a";
+        info._valid = true;
+        db.setDownloadInfo(QStringLiteral("sub/a"), info);
+        db.setSyncToken("token");
+
+        // the root moves into "sub"
+        QVERIFY(db.rebasePaths("sub", ""));
+        QCOMPARE(etag("a"), QByteArray("etag_sub/a"));
+        QCOMPARE(etag("\xc3\xa4"), QByteArray("etag_sub/\xc3\xa4"));
+        QCOMPARE(etag("sub"), QByteArray("etag_sub/sub"));
+        QCOMPARE(etag("sub/a"), QByteArray("etag_sub/sub/a"));
+        QVERIFY(etag("subway").isEmpty());
+        QVERIFY(etag("other/a").isEmpty());
+        QVERIFY(etag("sub/sub").isEmpty());
+        QVERIFY(db.getDownloadInfo(QStringLiteral("a"))._valid);
+        QVERIFY(!db.getDownloadInfo(QStringLiteral("sub/a"))._valid);
+        QVERIFY(db.syncToken().isEmpty());
+
+        // and back to the parent
+        QVERIFY(db.rebasePaths("", "sub"));
+        QCOMPARE(etag("sub/a"), QByteArray("etag_sub/a"));
+        QCOMPARE(etag("sub/sub/a"), QByteArray("etag_sub/sub/a"));
+        QVERIFY(etag("a").isEmpty());
+
+        int sampled = 0;
+        QVERIFY(db.getFileRecordsSample("sub/sub", 10, [&](const SyncJournalFileRecord &record) {
+            QCOMPARE(record._path, QByteArray("sub/sub/a"));
+            ++sampled;
+        }));
+        QCOMPARE(sampled, 1);
+    }
+
+    void testMaintenance()
+    {
+        SyncJournalDb db(_tempDir.path() + QStringLiteral("/maintenance.db"));
+        for (int i = 0; i < 5000; ++i) {
+            SyncJournalFileRecord record;
+            record._path = "dir/file" + QByteArray::number(i) + QByteArray(100, 'x');
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(db.setFileRecord(record));
+        }
+        SyncJournalFileRecord kept;
+        kept._path = "kept";
+        kept._remotePerm = RemotePermissions::fromDbValue("RW");
+        QVERIFY(db.setFileRecord(kept));
+        QVERIFY(db.deleteFileRecord(QStringLiteral("dir"), true));
+        db.walCheckpoint();
+        const qint64 sizeBefore = QFileInfo(db.databaseFilePath()).size();
+
+        db.runMaintenance(std::chrono::seconds(10));
+        QVERIFY(QFileInfo(db.databaseFilePath()).size() < sizeBefore / 2);
+
+        SyncJournalFileRecord record;
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("kept"), &record));
+        QVERIFY(record.isValid());
+        // the journal is still writable
+        kept._path = "kept2";
+        QVERIFY(db.setFileRecord(kept));
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("kept2"), &record));
+        QVERIFY(record.isValid());
+    }
+
+    void testRunAsync()
+    {
+        SyncJournalDb db(_tempDir.path() + QStringLiteral("/async.db"));
+
+        // the requests are handled in order on the journal thread, the results arrive in the thread of the context
+        QList<int> results;
+        QList<bool> inJournalThread;
+        QList<bool> inContextThread;
+        for (int i = 0; i < 10; ++i) {
+            db.runAsync(
+                this,
+                [i](SyncJournalDb *journal) {
+                    SyncJournalFileRecord record;
+                    record._path = "async" + QByteArray::number(i);
+                    record._remotePerm = RemotePermissions::fromDbValue("RW");
+                    journal->setFileRecord(record);
+                    return std::make_pair(i, QThread::currentThread() != qApp->thread());
+                },
+                [&](std::pair<int, bool> result) {
+                    inContextThread.append(QThread::currentThread() == thread());
+                    results.append(result.first);
+                    inJournalThread.append(result.second);
+                });
+        }
+        QTRY_COMPARE(results.size(), 10);
+        QCOMPARE(results, (QList<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+        QVERIFY(!inJournalThread.contains(false));
+        QVERIFY(!inContextThread.contains(false));
+        SyncJournalFileRecord record;
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("async9"), &record));
+        QVERIFY(record.isValid());
+
+        // the callback is dropped with its context
+        bool called = false;
+        bool done = false;
+        auto context = std::make_unique<QObject>();
+        db.runAsync(context.get(), [](SyncJournalDb *) { QThread::msleep(100); }, [&called] { called = true; });
+        context.reset();
+        db.runAsync(this, [](SyncJournalDb *) {}, [&done] { done = true; });
+        QTRY_VERIFY(done);
+        QVERIFY(!called);
+    }
+
+    void testMaintenanceLetsReadersIn()
+    {
+        SyncJournalDb db(_tempDir.path() + QStringLiteral("/maintenancereaders.db"));
+        for (int i = 0; i < 20000; ++i) {
+            SyncJournalFileRecord record;
+            record._path = "dir/file" + QByteArray::number(i);
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._checksumHeader = "SHA1:" + QByteArray(500, 'x');
+            QVERIFY(db.setFileRecord(record));
+        }
+        SyncJournalFileRecord kept;
+        kept._path = "kept";
+        kept._remotePerm = RemotePermissions::fromDbValue("RW");
+        QVERIFY(db.setFileRecord(kept));
+        QVERIFY(db.deleteFileRecord(QStringLiteral("dir"), true));
+        db.walCheckpoint();
+
+        // the maintenance frees the pages in several steps on the journal thread
+        std::atomic<bool> started = false;
+        std::atomic<bool> finished = false;
+        std::atomic<qint64> duration = 0;
+        db.runAsync(
+            this,
+            [&](SyncJournalDb *journal) {
+                QElapsedTimer timer;
+                started = true;
+                timer.start();
+                journal->runMaintenance(std::chrono::seconds(10));
+                duration = timer.nsecsElapsed();
+                finished = true;
+                return true;
+            },
+            [](bool) {});
+
+        QTRY_VERIFY(started);
+        qint64 longestRead = 0;
+        while (!finished) {
+            QElapsedTimer timer;
+            timer.start();
+            SyncJournalFileRecord record;
+            QVERIFY(db.getFileRecord(QByteArrayLiteral("kept"), &record));
+            QVERIFY(record.isValid());
+            longestRead = std::max(longestRead, timer.nsecsElapsed());
+        }
+        // a reader waits for a single step, not for the whole maintenance
+        QVERIFY2(longestRead < duration / 2, qPrintable(QStringLiteral("%1 %2").arg(longestRead).arg(duration.load())));
+    }
+
+    void testPerformanceProfile()
+    {
+        const QString path = _tempDir.path() + QStringLiteral("/profile.db");
+        {
+            SyncJournalDb db(path);
+            SyncJournalDb::PerformanceProfile profile;
+            profile.mmapSize = 64 * 1024 * 1024;
+            profile.cacheSize = 16 * 1024;
+            profile.pageSize = 16384;
+            profile.walAutoCheckpoint = 2000;
+            db.setPerformanceProfile(profile);
+            QVERIFY(db.performanceProfile() == profile);
+
+            SyncJournalFileRecord record;
+            record._path = "foo";
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(db.setFileRecord(record));
+            QVERIFY(db.getFileRecord(QByteArrayLiteral("foo"), &record));
+            QVERIFY(record.isValid());
+            db.walCheckpoint();
+            db.close();
+        }
+
+        // the page size is the only setting stored in the database
+        SqlDatabase db;
+        QVERIFY(db.openReadOnly(path));
+        SqlQuery query("PRAGMA page_size;", db);
+        QVERIFY(query.exec());
+        QVERIFY(query.next().hasData);
+        QCOMPARE(query.intValue(0), 16384);
+    }
+
+    void testCompactRecords()
+    {
+        const QString path = _tempDir.path() + QStringLiteral("/compact.db");
+        const QByteArray sha1 = "0beec7b5ea3f0fdbc95d0dd47f3c5bc275da8a33";
+        {
+            // a journal written with text checksums and permissions
+            SqlDatabase db;
+            QVERIFY(db.openOrCreateReadWrite(path));
+            SqlQuery query(db);
+            for (const auto &sql : {QByteArrayLiteral("CREATE TABLE metadata(phash INTEGER(8), pathlen INTEGER, path VARCHAR(4096), inode INTEGER,"
+                                                      " uid INTEGER, gid INTEGER, mode INTEGER, modtime INTEGER(8), type INTEGER, md5 VARCHAR(32),"
+                                                      " fileid VARCHAR(128), remotePerm VARCHAR(128), filesize BIGINT, ignoredChildrenRemote INT,"
+                                                      " contentChecksum TEXT, contentChecksumTypeId INTEGER, hasDirtyPlaceholder BOOLEAN, PRIMARY KEY(phash));"),
+                     QByteArrayLiteral("CREATE TABLE checksumtype(id INTEGER PRIMARY KEY, name TEXT UNIQUE);"),
+                     QByteArrayLiteral("INSERT INTO checksumtype (id, name) VALUES (1, 'SHA1'), (2, 'ADLER32');")}) {
+                QCOMPARE(query.prepare(sql), SQLITE_OK);
+                QVERIFY(query.exec());
+            }
+            QCOMPARE(query.prepare("INSERT INTO metadata (phash, pathlen, path, inode, modtime, type, md5, fileid, remotePerm, filesize,"
+                                   " contentChecksum, contentChecksumTypeId) VALUES (?1, 1, ?2, 1, 1, 0, 'etag', 'id', ?3, 100, ?4, ?5);"),
+                SQLITE_OK);
+            const std::tuple<QByteArray, QByteArray, QByteArray, int> rows[] = {{"a", "WD", sha1, 1}, {"b", "WD", "abc123f", 2}, {"c", "", "", 0}};
+            for (const auto &[name, perm, checksum, typeId] : rows) {
+                query.bindValue(1, SyncJournalDb::getPHash(name));
+                query.bindValue(2, name);
+                query.bindValue(3, perm);
+                query.bindValue(4, checksum);
+                query.bindValue(5, typeId);
+                QVERIFY(query.exec());
+                query.reset_and_clear_bindings();
+            }
+        }
+
+        SyncJournalDb db(path);
+        SyncJournalFileRecord record;
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("a"), &record));
+        QCOMPARE(record._checksumHeader, "SHA1:" + sha1);
+        QCOMPARE(record._remotePerm, RemotePermissions::fromDbValue("WD"));
+        // an odd length checksum stays text
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("b"), &record));
+        QCOMPARE(record._checksumHeader, QByteArrayLiteral("ADLER32:abc123f"));
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("c"), &record));
+        QVERIFY(record._remotePerm.isNull());
+        QVERIFY(record._checksumHeader.isEmpty());
+
+        // new records are stored the same way
+        record._path = "d";
+        record._remotePerm = RemotePermissions::fromDbValue("WD");
+        record._checksumHeader = "SHA1:" + sha1;
+        QVERIFY(db.setFileRecord(record));
+        QByteArrayList found;
+        QVERIFY(db.getFileRecordsByContentChecksum("SHA1:" + sha1, 100, [&](const SyncJournalFileRecord &rec) { found.append(rec._path); }));
+        found.sort();
+        QCOMPARE(found, (QByteArrayList{"a", "d"}));
+        db.walCheckpoint();
+        db.close();
+
+        SqlDatabase raw;
+        QVERIFY(raw.openReadOnly(path));
+        SqlQuery query("SELECT path, typeof(contentChecksum), remotePerm IS NULL FROM metadata ORDER BY path;", raw);
+        QVERIFY(query.exec());
+        QStringList stored;
+        while (query.next().hasData) {
+            stored.append(query.stringValue(0) + QLatin1Char(' ') + query.stringValue(1) + QLatin1Char(' ') + query.stringValue(2));
+        }
+        QCOMPARE(stored, (QStringList{QStringLiteral("a blob 1"), QStringLiteral("b text 1"), QStringLiteral("c text 1"), QStringLiteral("d blob 1")}));
+        SqlQuery permissions("SELECT count(*) FROM remotepermissions;", raw);
+        QVERIFY(permissions.next().hasData);
+        QCOMPARE(permissions.intValue(0), 1);
+    }
+
+    void testPathHashMigration()
+    {
+        const QString path = _tempDir.path() + QStringLiteral("/jhash.db");
+        {
+            // a journal written with the Jenkins hashes of older clients
+            SqlDatabase db;
+            QVERIFY(db.openOrCreateReadWrite(path));
+            SqlQuery query(db);
+            QCOMPARE(query.prepare("CREATE TABLE metadata(phash INTEGER(8), pathlen INTEGER, path VARCHAR(4096), inode INTEGER,"
+                                   " uid INTEGER, gid INTEGER, mode INTEGER, modtime INTEGER(8), type INTEGER, md5 VARCHAR(32),"
+                                   " fileid VARCHAR(128), remotePerm VARCHAR(128), filesize BIGINT, ignoredChildrenRemote INT,"
+                                   " contentChecksum TEXT, contentChecksumTypeId INTEGER, hasDirtyPlaceholder BOOLEAN, PRIMARY KEY(phash));"),
+                SQLITE_OK);
+            QVERIFY(query.exec());
+            QCOMPARE(query.prepare("INSERT INTO metadata (phash, pathlen, path, inode, modtime, type, md5, fileid, filesize)"
+                                   " VALUES (?1, ?2, ?3, 1, 1, ?4, 'etag', 'id', 100);"),
+                SQLITE_OK);
+            const std::pair<QByteArray, ItemType> rows[] = {{"dir", ItemTypeDirectory}, {"dir/a", ItemTypeFile}, {"dir/b", ItemTypeFile}};
+            for (const auto &[name, type] : rows) {
+                query.bindValue(1, static_cast<qint64>(c_jhash64(reinterpret_cast<const uint8_t *>(name.constData()), name.size(), 0)));
+                query.bindValue(2, name.size());
+                query.bindValue(3, name);
+                query.bindValue(4, type);
+                QVERIFY(query.exec());
+                query.reset_and_clear_bindings();
+            }
+        }
+
+        SyncJournalDb db(path);
+        SyncJournalFileRecord record;
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("dir/a"), &record));
+        QVERIFY(record.isValid());
+        QByteArrayList listed;
+        QVERIFY(db.listFilesInPath("dir", [&](const SyncJournalFileRecord &rec) { listed.append(rec._path); }));
+        QCOMPARE(listed, (QByteArrayList{"dir/a", "dir/b"}));
+        db.close();
+
+        SqlDatabase raw;
+        QVERIFY(raw.openReadOnly(path));
+        SqlQuery query("SELECT phash FROM metadata WHERE path = 'dir/b';", raw);
+        QVERIFY(query.next().hasData);
+        QCOMPARE(query.int64Value(0), SyncJournalDb::getPHash("dir/b"));
+    }
+
+    void testUpgradeInBackground()
+    {
+        const QString path = _tempDir.path() + QStringLiteral("/upgrade.db");
+        {
+            SyncJournalDb db(path);
+            QSignalSpy progress(&db, &SyncJournalDb::upgradeProgress);
+            SyncJournalFileRecord record;
+            record._path = "dir/a";
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(db.setFileRecord(record));
+            // a new journal is not upgraded
+            QVERIFY(progress.isEmpty());
+            db.close();
+        }
+        {
+            // pretend a client older than the path hashes used the journal
+            SqlDatabase raw;
+            QVERIFY(raw.openOrCreateReadWrite(path));
+            SqlQuery query("UPDATE version SET major = 2, minor = 11, patch = 0;", raw);
+            QVERIFY(query.exec());
+        }
+
+        SyncJournalDb db(path);
+        QList<std::pair<int, int>> steps;
+        connect(&db, &SyncJournalDb::upgradeProgress, this, [&](int step, int stepCount) { steps.append({step, stepCount}); });
+        bool opened = false;
+        db.runAsync(this, [](SyncJournalDb *journal) { return journal->open(); }, [&opened](bool result) { opened = result; });
+        QTRY_VERIFY(opened);
+        QTRY_VERIFY(!steps.isEmpty() && steps.last().first == steps.last().second);
+        QCOMPARE(steps.first().first, 0);
+        QVERIFY(std::is_sorted(steps.cbegin(), steps.cend()));
+
+        SyncJournalFileRecord record;
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("dir/a"), &record));
+        QVERIFY(record.isValid());
+        db.close();
+
+        // the index dropped by the migration is back
+        SqlDatabase raw;
+        QVERIFY(raw.openReadOnly(path));
+        SqlQuery query("SELECT name FROM sqlite_master WHERE type = 'index' AND name = 'metadata_parent';", raw);
+        QVERIFY(query.next().hasData);
+    }
+
+    void testPathHashesAfterDowngrade()
+    {
+        const QString path = _tempDir.path() + QStringLiteral("/downgrade.db");
+        {
+            SyncJournalDb db(path);
+            SyncJournalFileRecord record;
+            record._path = "dir";
+            record._type = ItemTypeDirectory;
+            record._etag = "etag";
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(db.setFileRecord(record));
+            record._path = "dir/a";
+            record._type = ItemTypeFile;
+            QVERIFY(db.setFileRecord(record));
+            db.close();
+        }
+        auto openJournal = [&path](QList<int> *steps) {
+            SyncJournalDb db(path);
+            connect(&db, &SyncJournalDb::upgradeProgress, [steps](int step, int) { steps->append(step); });
+            SyncJournalFileRecord record;
+            QVERIFY(db.getFileRecord(QByteArrayLiteral("dir"), &record));
+            db.close();
+        };
+        auto etagOf = [&path](const QByteArray &name) {
+            SqlDatabase raw;
+            raw.openReadOnly(path);
+            SqlQuery query(raw);
+            query.prepare("SELECT md5 FROM metadata WHERE path = ?1;");
+            query.bindValue(1, name);
+            QByteArrayList etags;
+            query.exec();
+            while (query.next().hasData) {
+                etags.append(query.baValue(0));
+            }
+            return etags;
+        };
+
+        {
+            // an upgrade from a client that already knew the path hashes
+            SqlDatabase raw;
+            QVERIFY(raw.openOrCreateReadWrite(path));
+            SqlQuery query("UPDATE version SET major = 2, minor = 11, patch = 0, pathhashclient = '2.11.0';", raw);
+            QVERIFY(query.exec());
+        }
+        QList<int> steps;
+        openJournal(&steps);
+        QVERIFY(!steps.isEmpty());
+        QVERIFY(!steps.contains(0));
+        QCOMPARE(etagOf("dir"), QByteArrayList{"etag"});
+
+        {
+            // a client that didn't know them opened the journal in between and wrote its own row
+            SqlDatabase raw;
+            QVERIFY(raw.openOrCreateReadWrite(path));
+            SqlQuery query("UPDATE version SET major = 2, minor = 11, patch = 0;", raw);
+            QVERIFY(query.exec());
+            QCOMPARE(query.prepare("INSERT INTO metadata (phash, pathlen, path, inode, modtime, type, md5, fileid, filesize)"
+                                   " VALUES (?1, 5, 'dir/a', 1, 1, 0, 'downgraded', 'id', 100);"),
+                SQLITE_OK);
+            query.bindValue(1, static_cast<qint64>(c_jhash64(reinterpret_cast<const uint8_t *>("dir/a"), 5, 0)));
+            QVERIFY(query.exec());
+        }
+        steps.clear();
+        openJournal(&steps);
+        QVERIFY(steps.contains(0));
+        QCOMPARE(etagOf("dir/a"), QByteArrayList{"downgraded"});
+        // the etags the newer client stored are outdated
+        QCOMPARE(etagOf("dir"), QByteArrayList{"_invalid_"});
+    }
+
+    void testMetadataSnapshot()
+    {
+        quint64 inode = 1000;
+        auto makeEntry = [&](const QByteArray &path, ItemType type) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._inode = ++inode;
+            record._etag = "etag-" + path;
+            record._fileId = "id-" + path;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._checksumHeader = "MD5:" + path;
+            QVERIFY(_db.setFileRecord(record));
+        };
+        makeEntry("snap", ItemTypeDirectory);
+        makeEntry("snap/b", ItemTypeFile);
+        makeEntry("snap/a", ItemTypeFile);
+        makeEntry("snap/sub", ItemTypeDirectory);
+        makeEntry("snap/sub/c", ItemTypeFile);
+        makeEntry("snap-2", ItemTypeFile);
+
+        auto list = [&](const QByteArray &path) {
+            QByteArrayList paths;
+            _db.listFilesInPath(path, [&](const SyncJournalFileRecord &rec) { paths.append(rec._path); });
+            std::sort(paths.begin(), paths.end());
+            return paths;
+        };
+        auto listPages = [&](const QByteArray &path, int limit) {
+            QByteArrayList paths;
+            QByteArray after;
+            while (true) {
+                int count = 0;
+                _db.listFilesInPath(path, after, limit, [&](const SyncJournalFileRecord &rec) {
+                    paths.append(rec._path);
+                    after = rec._path;
+                    ++count;
+                });
+                if (count < limit) {
+                    return paths;
+                }
+            }
+        };
+        const auto fromDb = list("snap");
+        // the pages are in the byte order of the names
+        QCOMPARE(listPages("snap", 2), (QByteArrayList{"snap/a", "snap/b", "snap/sub"}));
+        QCOMPARE(listPages("snap", 1), (QByteArrayList{"snap/a", "snap/b", "snap/sub"}));
+        QCOMPARE(listPages("", 1), list(""));
+        SyncJournalFileRecord dbRecord;
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("snap/sub/c"), &dbRecord));
+
+        QVERIFY(_db.loadMetadataSnapshot());
+        QVERIFY(_db.hasMetadataSnapshot());
+        QCOMPARE(list("snap"), fromDb);
+        QCOMPARE(list("snap"), (QByteArrayList{"snap/a", "snap/b", "snap/sub"}));
+        QCOMPARE(list("snap/sub"), QByteArrayList{"snap/sub/c"});
+        QCOMPARE(listPages("snap", 2), (QByteArrayList{"snap/a", "snap/b", "snap/sub"}));
+        QCOMPARE(listPages("snap", 1), (QByteArrayList{"snap/a", "snap/b", "snap/sub"}));
+        QCOMPARE(listPages("", 1), list(""));
+        SyncJournalFileRecord record;
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("snap/sub/c"), &record));
+        QVERIFY(record == dbRecord);
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("snap/missing"), &record));
+        QVERIFY(!record.isValid());
+
+        // the move detection lookups
+        QVERIFY(_db.getFileRecordByInode(dbRecord._inode, &record));
+        QVERIFY(record == dbRecord);
+        QVERIFY(_db.getFileRecordByInode(42, &record));
+        QVERIFY(!record.isValid());
+        QByteArrayList byFileId;
+        QVERIFY(_db.getFileRecordsByFileId("id-snap/b", [&](const SyncJournalFileRecord &rec) { byFileId.append(rec._path); }));
+        QCOMPARE(byFileId, QByteArrayList{"snap/b"});
+        byFileId.clear();
+        QVERIFY(_db.getFileRecordsByFileId("id-snap/missing", [&](const SyncJournalFileRecord &rec) { byFileId.append(rec._path); }));
+        QVERIFY(byFileId.isEmpty());
+        QVERIFY(_db.hasMetadataSnapshot());
+
+        // writes go to the database and invalidate the snapshot
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("snap/a")));
+        QVERIFY(!_db.hasMetadataSnapshot());
+        QCOMPARE(list("snap"), (QByteArrayList{"snap/b", "snap/sub"}));
+
+        _db.deleteFileRecord(QStringLiteral("snap"), true);
+        _db.deleteFileRecord(QStringLiteral("snap-2"));
+    }
+
     void testPinState()
     {
         auto make = [&](const QByteArray &path, PinState state) {
@@ -443,11 +1171,23 @@ private Q_SLOTS:
         QCOMPARE(getRaw("online"), PinState::Inherited);
         list = _db.internalPinStates().rawList();
         QCOMPARE(list->size(), 0);
+
+        // The states are cached, check them against the database after a reopen
+        make("cached", PinState::OnlineOnly);
+        make("cached/local", PinState::AlwaysLocal);
+        make("cached/local", PinState::Inherited);
+        QCOMPARE(getRecursive("cached"), PinState::OnlineOnly);
+        _db.close();
+        _db.allowReopen();
+        QCOMPARE(getRaw("cached/local"), PinState::Inherited);
+        QCOMPARE(get("cached/local"), PinState::OnlineOnly);
+        QCOMPARE(getRecursive("cached"), PinState::OnlineOnly);
+        _db.internalPinStates().wipeForPathAndBelow("");
     }
 
 private:
     SyncJournalDb _db;
 };
 
-QTEST_APPLESS_MAIN(TestSyncJournalDB)
+QTEST_GUILESS_MAIN(TestSyncJournalDB)
 #include "testsyncjournaldb.moc"
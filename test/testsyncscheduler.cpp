@@ -0,0 +1,134 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "gui/folderman.h"
+#include "gui/scheduling/folderpriorityqueue.h"
+#include "gui/scheduling/syncscheduler.h"
+
+#include "testutils/testutils.h"
+
+#include <QScopeGuard>
+#include <QtTest>
+
+using namespace OCC;
+
+class TestSyncScheduler : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _dir = TestUtils::createTempDir();
+    AccountStatePtr _accountState;
+    QList<Folder *> _folders;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(_dir.isValid());
+        _accountState = TestUtils::createDummyAccount();
+        for (const auto &name : {QStringLiteral("polled"), QStringLiteral("changed"), QStringLiteral("forced")}) {
+            QVERIFY(QDir(_dir.path()).mkpath(name));
+            auto *folder = TestUtils::folderMan()->addFolder(
+                _accountState.get(), TestUtils::createDummyFolderDefinition(_accountState->account(), _dir.path() + QLatin1Char('/') + name));
+            QVERIFY(folder);
+            _folders.append(folder);
+        }
+    }
+
+    void cleanupTestCase()
+    {
+        for (auto *folder : std::as_const(_folders)) {
+            TestUtils::folderMan()->removeFolder(folder);
+        }
+    }
+
+    void testPriorities()
+    {
+        auto *polled = _folders[0];
+        auto *changed = _folders[1];
+        auto *forced = _folders[2];
+
+        FolderPriorityQueue queue;
+        queue.enqueueFolder(polled, SyncScheduler::Priority::Low);
+        // a local change doesn't wait for the folders found by the polling
+        queue.enqueueFolder(changed, SyncScheduler::Priority::Medium);
+        queue.enqueueFolder(forced, SyncScheduler::Priority::High);
+        // enqueued only once
+        queue.enqueueFolder(changed, SyncScheduler::Priority::Low);
+        QCOMPARE(queue.size(), size_t(3));
+
+        QCOMPARE(queue.pop(), std::make_pair(forced, SyncScheduler::Priority::High));
+        QCOMPARE(queue.pop(), std::make_pair(changed, SyncScheduler::Priority::Medium));
+        QCOMPARE(queue.pop(), std::make_pair(polled, SyncScheduler::Priority::Low));
+        QVERIFY(queue.empty());
+
+        // a higher priority moves a folder ahead
+        queue.enqueueFolder(polled, SyncScheduler::Priority::Low);
+        queue.enqueueFolder(changed, SyncScheduler::Priority::Low);
+        queue.enqueueFolder(changed, SyncScheduler::Priority::Medium);
+        QCOMPARE(queue.pop().first, changed);
+        QCOMPARE(queue.pop().first, polled);
+        QVERIFY(queue.empty());
+    }
+
+    void testAging()
+    {
+        auto *polled = _folders[0];
+        auto *changed = _folders[1];
+        auto *forced = _folders[2];
+
+        FolderPriorityQueue queue;
+        const auto longAgo = std::chrono::steady_clock::now() - std::chrono::minutes(10);
+        queue.enqueueFolder(polled, SyncScheduler::Priority::Low, longAgo);
+        queue.enqueueFolder(changed, SyncScheduler::Priority::Medium);
+        // a folder waiting that long is synced before the Medium ones
+        std::chrono::steady_clock::time_point enqueued;
+        QCOMPARE(queue.pop(&enqueued), std::make_pair(polled, SyncScheduler::Priority::Low));
+        QVERIFY(enqueued == longAgo);
+
+        // a folder that has to wait keeps its time, and its place before the folders enqueued later
+        queue.enqueueFolder(forced, SyncScheduler::Priority::Low);
+        queue.enqueueFolder(polled, SyncScheduler::Priority::Low, enqueued);
+        QCOMPARE(queue.pop().first, polled);
+        QCOMPARE(queue.pop().first, changed);
+        QCOMPARE(queue.pop().first, forced);
+        QVERIFY(queue.empty());
+    }
+
+    void testConcurrencyLimit()
+    {
+        auto *scheduler = TestUtils::folderMan()->scheduler();
+        auto *running = _folders[0];
+        auto *forced = _folders[2];
+        while (!scheduler->_queue->empty()) {
+            scheduler->_queue->pop();
+        }
+        const auto maxConcurrentSyncs = scheduler->_maxConcurrentSyncs;
+        const auto wasRunning = scheduler->_running;
+        auto restore = qScopeGuard([&] {
+            scheduler->_runningSyncs.clear();
+            while (!scheduler->_queue->empty()) {
+                scheduler->_queue->pop();
+            }
+            scheduler->_maxConcurrentSyncs = maxConcurrentSyncs;
+            scheduler->_running = wasRunning;
+        });
+
+        scheduler->_maxConcurrentSyncs = 1;
+        scheduler->_running = true;
+        scheduler->_runningSyncs = {running};
+
+        // a sync forced by the user waits for a free slot as well
+        scheduler->_queue->enqueueFolder(forced, SyncScheduler::Priority::High);
+        scheduler->startNext();
+        QCOMPARE(scheduler->_runningSyncs.size(), size_t(1));
+        QCOMPARE(scheduler->_runningSyncs.front(), QPointer<Folder>(running));
+        QCOMPARE(scheduler->_queue->size(), size_t(1));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncScheduler)
+#include "testsyncscheduler.moc"
@@ -1013,6 +1013,47 @@ private Q_SLOTS:
         QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("unspec/file1") + Theme::instance()->appDotVirtualFileSuffix()));
     }
 
+    // New placeholders are created in bulks, with a journal commit per bulk
+    void testBulkPlaceholders()
+    {
+        FakeFolder fakeFolder{FileInfo()};
+        setupVfs(fakeFolder);
+        ItemCompletedSpy completeSpy(fakeFolder);
+
+        QStringList files;
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/B"));
+        // more than fit into a single bulk
+        for (int i = 0; i < 600; ++i) {
+            files.append(QStringLiteral("f%1").arg(i));
+        }
+        for (int i = 0; i < 10; ++i) {
+            files.append(QStringLiteral("A/a%1").arg(i));
+            files.append(QStringLiteral("A/B/b%1").arg(i));
+        }
+        for (const auto &file : std::as_const(files)) {
+            fakeFolder.remoteModifier().insert(file, 64_B);
+        }
+
+        const auto commitsBefore = fakeFolder.syncJournal().commitStatistics().commits;
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QVERIFY(fakeFolder.syncJournal().commitStatistics().commits - commitsBefore < 50);
+
+        for (const auto &file : std::as_const(files)) {
+            const QString placeholder = file + Theme::instance()->appDotVirtualFileSuffix();
+            QVERIFY(!fakeFolder.currentLocalState().find(file));
+            QVERIFY(fakeFolder.currentLocalState().find(placeholder));
+            QCOMPARE(itemInstruction(completeSpy, placeholder), CSYNC_INSTRUCTION_NEW);
+            QCOMPARE(completeSpy.findItem(placeholder)->_status, SyncFileItem::Success);
+            QCOMPARE(dbRecord(fakeFolder, placeholder)._type, ItemTypeVirtualFile);
+        }
+
+        // Another sync doesn't lead to changes
+        completeSpy.clear();
+        QVERIFY(fakeFolder.applyLocalModificationsAndSync());
+        QVERIFY(completeSpy.isEmpty());
+    }
+
     // Check what happens if vfs-suffixed files exist on the server or in the db
     void testExtraFilesLocalDehydrated()
     {
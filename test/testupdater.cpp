@@ -19,18 +19,24 @@ private Q_SLOTS:
     void testDownload_data()
     {
         QTest::addColumn<QString>("url");
+        QTest::addColumn<QString>("patchUrl");
         QTest::addColumn<OCUpdater::DownloadState>("result");
         // a redirect to attic
-        QTest::newRow("redirect") << "https://download.owncloud.com/desktop/stable/ownCloud-2.2.4.6408-setup.exe" << OCUpdater::DownloadComplete;
-        QTest::newRow("broken url") << "https://&" << OCUpdater::DownloadFailed;
+        QTest::newRow("redirect") << "https://download.owncloud.com/desktop/stable/ownCloud-2.2.4.6408-setup.exe" << QString() << OCUpdater::DownloadComplete;
+        QTest::newRow("broken url") << "https://&" << QString() << OCUpdater::DownloadFailed;
+        // the full installer is downloaded if the patch is not available
+        QTest::newRow("broken patch url") << "https://download.owncloud.com/desktop/stable/ownCloud-2.2.4.6408-setup.exe"
+                                          << "https://&/ownCloud-2.2.4.6408.msp" << OCUpdater::DownloadComplete;
     }
 
     void testDownload()
     {
         QFETCH(QString, url);
+        QFETCH(QString, patchUrl);
         QFETCH(OCUpdater::DownloadState, result);
         UpdateInfo info;
         info.setDownloadUrl(url);
+        info.setPatchUrl(patchUrl);
         info.setVersionString(QStringLiteral("ownCloud 2.2.4 (build 6408)"));
         // esnure we do the update
         info.setVersion(QStringLiteral("100.2.4.6408"));
@@ -0,0 +1,118 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "httpreplay.h"
+
+#include "httplogger.h"
+
+using namespace std::chrono;
+using namespace OCC;
+
+HttpReplay::HttpReplay(const QVector<HttpRecording::Exchange> &exchanges, const Options &options)
+    : _options(options)
+{
+    for (const auto &exchange : exchanges) {
+        _exchanges[{exchange.verb, exchange.path}].enqueue(exchange);
+    }
+}
+
+FakeAM::Override HttpReplay::override()
+{
+    return [this](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+        const auto split = HttpRecording::splitDavPath(request.url().path());
+        if (!split) {
+            return nullptr;
+        }
+        const auto it = _exchanges.find({HttpLogger::requestVerb(op, request), split->second});
+        if (it == _exchanges.end() || it->isEmpty()) {
+            return nullptr;
+        }
+        const auto exchange = it->dequeue();
+
+        QByteArray body = exchange.body;
+        if (!body.isEmpty()) {
+            body.replace(HttpRecording::davRootPlaceholder().toUtf8(), QUrl::toPercentEncoding(split->first, "/"));
+        } else if (op != QNetworkAccessManager::HeadOperation) {
+            body = QByteArray(exchange.bodySize, 'R');
+        }
+
+        milliseconds delay = exchange.duration;
+        if (!_options.recordedTiming) {
+            delay = _options.latency;
+            if (_options.bytesPerSecond > 0) {
+                delay += milliseconds(body.size() * 1000 / _options.bytesPerSecond);
+            }
+        }
+        return new FakeReplayReply(exchange, body, delay, op, request, nullptr);
+    };
+}
+
+qsizetype HttpReplay::remaining() const
+{
+    qsizetype out = 0;
+    for (const auto &queue : _exchanges) {
+        out += queue.size();
+    }
+    return out;
+}
+
+FakeReplayReply::FakeReplayReply(const HttpRecording::Exchange &exchange, const QByteArray &body, milliseconds delay, QNetworkAccessManager::Operation op,
+    const QNetworkRequest &request, QObject *parent)
+    : FakeReply{parent}
+    , _body(body)
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(op);
+    open(QIODevice::ReadOnly);
+    for (const auto &[name, value] : exchange.headers) {
+        setRawHeader(name, value);
+    }
+    setHeader(QNetworkRequest::ContentLengthHeader, _body.size());
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, exchange.status);
+    if (exchange.status >= 400) {
+        switch (exchange.status) {
+        case 401:
+            setError(AuthenticationRequiredError, QStringLiteral("Replayed credentials error"));
+            break;
+        case 403:
+            setError(ContentAccessDenied, QStringLiteral("Replayed access denied error"));
+            break;
+        case 404:
+            setError(ContentNotFoundError, QStringLiteral("Replayed not found error"));
+            break;
+        default:
+            setError(InternalServerError, QStringLiteral("Replayed server error"));
+        }
+    }
+    QTimer::singleShot(delay, this, &FakeReplayReply::respond);
+}
+
+void FakeReplayReply::respond()
+{
+    if (isFinished()) {
+        return;
+    }
+    Q_EMIT metaDataChanged();
+    if (bytesAvailable()) {
+        Q_EMIT readyRead();
+    }
+    checkedFinished();
+}
+
+qint64 FakeReplayReply::readData(char *buf, qint64 max)
+{
+    max = qMin<qint64>(max, _body.size());
+    memcpy(buf, _body.constData(), max);
+    _body = _body.mid(max);
+    return max;
+}
+
+qint64 FakeReplayReply::bytesAvailable() const
+{
+    return _body.size() + QIODevice::bytesAvailable();
+}
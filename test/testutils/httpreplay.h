@@ -0,0 +1,67 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+#pragma once
+
+#include "httprecording.h"
+#include "syncenginetestutils.h"
+
+#include <QHash>
+#include <QQueue>
+
+#include <chrono>
+
+/**
+ * Replays a recording of OCC::HttpRecording through the FakeAM
+ *
+ * A request is answered with the first exchange of the recording with the same verb
+ * and path below the dav root, the requests that were not recorded are passed on to the
+ * fake server. The file names in a recording are pseudonyms, so the replaying FakeFolder
+ * sees the pseudonyms as well.
+ *
+ * The replies arrive after the latency and the time their body takes at the bandwidth,
+ * or after the recorded duration, so the sync runs with the same order of replies each time.
+ */
+class HttpReplay
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds latency = {};
+        // 0 for no limit
+        qint64 bytesPerSecond = 0;
+        // use the recorded durations instead of the latency and the bandwidth
+        bool recordedTiming = false;
+    };
+
+    explicit HttpReplay(const QVector<OCC::HttpRecording::Exchange> &exchanges, const Options &options = {});
+
+    /** For FakeFolder::setServerOverride() */
+    FakeAM::Override override();
+
+    /** The number of exchanges that were not replayed yet */
+    qsizetype remaining() const;
+
+private:
+    Options _options;
+    QHash<QPair<QByteArray, QString>, QQueue<OCC::HttpRecording::Exchange>> _exchanges;
+};
+
+class FakeReplayReply : public FakeReply
+{
+    Q_OBJECT
+public:
+    FakeReplayReply(const OCC::HttpRecording::Exchange &exchange, const QByteArray &body, std::chrono::milliseconds delay,
+        QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
+
+    Q_INVOKABLE void respond();
+
+    qint64 readData(char *buf, qint64 max) override;
+    qint64 bytesAvailable() const override;
+
+private:
+    QByteArray _body;
+};
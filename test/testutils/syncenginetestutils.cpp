@@ -14,6 +14,9 @@
 #include "libsync/configfile.h"
 #include "libsync/syncresult.h"
 
+#include <QXmlStreamReader>
+
+#include <functional>
 #include <thread>
 #include <vio/csync_vio_local.h>
 
@@ -259,9 +262,9 @@ FileInfo *FileInfo::createDir(const QString &relativePath)
     const PathComponents pathComponents { relativePath };
     FileInfo *parent = findInvalidatingEtags(pathComponents.parentDirComponents());
     Q_ASSERT(parent);
+    const QString parentPath = parent->childParentPath();
     FileInfo &child = parent->children[pathComponents.fileName()] = FileInfo { pathComponents.fileName() };
-    child.parentPath = parent->path();
-    child.etag = generateEtag();
+    child.parentPath = parentPath;
     return &child;
 }
 
@@ -270,10 +273,10 @@ FileInfo *FileInfo::create(const QString &relativePath, quint64 size, char conte
     const PathComponents pathComponents { relativePath };
     FileInfo *parent = findInvalidatingEtags(pathComponents.parentDirComponents());
     Q_ASSERT(parent);
+    const QString parentPath = parent->childParentPath();
     FileInfo &child = parent->children[pathComponents.fileName()] = FileInfo { pathComponents.fileName(), size };
-    child.parentPath = parent->path();
+    child.parentPath = parentPath;
     child.contentChar = contentChar;
-    child.etag = generateEtag();
     return &child;
 }
 
@@ -311,9 +314,9 @@ bool FileInfo::equals(const FileInfo &other, CompareWhat compareWhat) const
         return false;
     }
 
-    for (auto it = children.constBegin(), eit = children.constEnd(); it != eit; ++it) {
-        auto oit = other.children.constFind(it.key());
-        if (oit == other.children.constEnd()) {
+    // both are sorted by name, compare them in lockstep instead of looking up every child
+    for (auto it = children.constBegin(), oit = other.children.constBegin(), eit = children.constEnd(); it != eit; ++it, ++oit) {
+        if (it.key() != oit.key()) {
             qDebug() << "6" << name << "!=" << other.name;
             return false;
         } else if (!it.value().equals(oit.value(), compareWhat)) {
@@ -330,6 +333,12 @@ QString FileInfo::path() const
     return (parentPath.isEmpty() ? QString() : (parentPath + QLatin1Char('/'))) + name;
 }
 
+QString FileInfo::childParentPath() const
+{
+    // share the string with the siblings instead of a copy per child
+    return children.isEmpty() ? path() : children.first().parentPath;
+}
+
 QString FileInfo::absolutePath() const
 {
     if (parentPath.endsWith(QLatin1Char('/'))) {
@@ -412,8 +421,16 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
 
     writeFileResponse(*fileInfo);
 
-    const int depth = request.rawHeader(QByteArrayLiteral("Depth")).toInt();
-    if (depth > 0) {
+    const QByteArray depth = request.rawHeader(QByteArrayLiteral("Depth"));
+    if (depth == "infinity") {
+        std::function<void(const FileInfo &)> writeTree = [&](const FileInfo &parent) {
+            for (const FileInfo &childFileInfo : parent.children) {
+                writeFileResponse(childFileInfo);
+                writeTree(childFileInfo);
+            }
+        };
+        writeTree(*fileInfo);
+    } else if (depth.toInt() > 0) {
         for (const FileInfo &childFileInfo : fileInfo->children) {
             writeFileResponse(childFileInfo);
         }
@@ -579,6 +596,47 @@ void FakeMoveReply::respond()
     checkedFinished();
 }
 
+FakeCopyReply::FakeCopyReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+    : FakeReply { parent }
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(op);
+    open(QIODevice::ReadOnly);
+
+    QString fileName = getFilePathFromUrl(request.url());
+    Q_ASSERT(!fileName.isEmpty());
+    QString dest = getFilePathFromUrl(QUrl::fromEncoded(request.rawHeader("Destination")));
+    Q_ASSERT(!dest.isEmpty());
+    const FileInfo *source = remoteRootFileInfo.find(fileName);
+    if (!source || source->isDir) {
+        _httpCode = 404;
+    } else if (request.hasRawHeader("If-Match") && request.rawHeader("If-Match") != '"' + source->etag + '"') {
+        _httpCode = 412;
+    } else if (remoteRootFileInfo.find(dest)) {
+        // Overwrite: F
+        _httpCode = 412;
+    } else {
+        const FileInfo original = *source;
+        FileInfo *copy = remoteRootFileInfo.create(dest, original.contentSize, original.contentChar);
+        copy->checksums = original.checksums;
+        copy->setLastModifiedFromSecondsUTC(original.lastModifiedInSecondsUTC());
+    }
+    QMetaObject::invokeMethod(this, &FakeCopyReply::respond, Qt::QueuedConnection);
+}
+
+void FakeCopyReply::respond()
+{
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _httpCode);
+    if (_httpCode == 404) {
+        setError(ContentNotFoundError, QStringLiteral("Not Found"));
+    } else if (_httpCode != 201) {
+        setError(InternalServerError, QStringLiteral("Precondition Failed"));
+    }
+    Q_EMIT metaDataChanged();
+    checkedFinished();
+}
+
 FakeGetReply::FakeGetReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
     : FakeReply { parent }
     , _range(parseRange(request))
@@ -633,18 +691,22 @@ void FakeGetReply::respond()
             break;
         case State::Ok:
             payload = fileInfo->contentChar;
-            if (_range.second != 0) {
-                if (_range.second == -1) {
-                    size = fileInfo->contentSize - _range.first;
-                } else {
-                    size = _range.second - _range.first;
-                }
+            if (_range.second == -1) {
+                size = fileInfo->contentSize - _range.first;
                 setRawHeader("Content-Range", QByteArrayLiteral("bytes ") + QByteArray::number(_range.first) + '-');
+                setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+            } else if (_range.second != 0) {
+                // the end of a range is inclusive
+                size = _range.second - _range.first + 1;
+                setRawHeader("Content-Range",
+                    QByteArrayLiteral("bytes ") + QByteArray::number(_range.first) + '-' + QByteArray::number(_range.second) + '/'
+                        + QByteArray::number(fileInfo->contentSize));
+                setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 206);
             } else {
                 size = fileInfo->contentSize;
+                setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
             }
             setHeader(QNetworkRequest::ContentLengthHeader, size);
-            setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
             setRawHeader("OC-ETag", fileInfo->etag);
             setRawHeader("ETag", fileInfo->etag);
             setRawHeader("OC-FileId", fileInfo->fileId);
@@ -816,6 +878,48 @@ qint64 FakePayloadReply::bytesAvailable() const
     return _body.size();
 }
 
+FakeProppatchReply::FakeProppatchReply(
+    FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &body, QObject *parent)
+    : FakePayloadReply { op, request, {}, parent }
+{
+    const QString fileName = getFilePathFromUrl(request.url());
+    Q_ASSERT(!fileName.isEmpty());
+    const FileInfo *fileInfo = remoteRootFileInfo.find(fileName);
+    if (!fileInfo) {
+        _httpCode = 404;
+        return;
+    }
+    if (request.hasRawHeader("If-Match") && request.rawHeader("If-Match") != '"' + fileInfo->etag + '"') {
+        _httpCode = 412;
+        return;
+    }
+
+    QXmlStreamReader reader(body);
+    while (!reader.atEnd()) {
+        if (reader.readNext() == QXmlStreamReader::StartElement && reader.name() == QLatin1String("lastmodified")) {
+            remoteRootFileInfo.setModTime(fileName, QDateTime::fromSecsSinceEpoch(reader.readElementText().toLongLong(), QTimeZone::utc()));
+        }
+    }
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _httpCode);
+    setHeader(QNetworkRequest::ContentTypeHeader, QByteArrayLiteral("application/xml; charset=utf-8"));
+    _body = QByteArrayLiteral("<?xml version=\"1.0\" encoding=\"utf-8\"?><d:multistatus xmlns:d=\"DAV:\"><d:response><d:href>")
+        + request.url().path().toUtf8()
+        + QByteArrayLiteral("</d:href><d:propstat><d:prop><d:lastmodified/></d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat>"
+                            "</d:response></d:multistatus>");
+}
+
+void FakeProppatchReply::respond()
+{
+    if (_httpCode != 207) {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _httpCode);
+        setError(_httpCode == 404 ? ContentNotFoundError : InternalServerError, QStringLiteral("PROPPATCH failed"));
+        Q_EMIT metaDataChanged();
+        checkedFinished();
+        return;
+    }
+    FakePayloadReply::respond();
+}
+
 FakeErrorReply::FakeErrorReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent, int httpErrorCode, const QByteArray &body)
     : FakeReply { parent }
     , _body(body)
@@ -920,6 +1024,10 @@ QNetworkReply *FakeAM::createRequest(QNetworkAccessManager::Operation op, const
             reply = new FakeDeleteReply { info, op, newRequest, this };
         else if (verb == QByteArrayLiteral("MOVE") && !isUpload)
             reply = new FakeMoveReply { info, op, newRequest, this };
+        else if (verb == QByteArrayLiteral("COPY"))
+            reply = new FakeCopyReply { info, op, newRequest, this };
+        else if (verb == QByteArrayLiteral("PROPPATCH"))
+            reply = new FakeProppatchReply { info, op, newRequest, outgoingData->readAll(), this };
         else if (verb == QByteArrayLiteral("MOVE") && isUpload)
             reply = new FakeChunkMoveReply { info, _remoteRootFileInfo, op, newRequest, this };
         else {
@@ -1025,7 +1133,6 @@ FileInfo FakeFolder::currentLocalState()
     QDir rootDir { _tempDir.path() };
     FileInfo rootTemplate;
     fromDisk(rootDir, rootTemplate);
-    rootTemplate.fixupParentPathRecursively();
     return rootTemplate;
 }
 
@@ -1100,6 +1207,8 @@ void FakeFolder::fromDisk(QDir &dir, FileInfo &templateFi)
     if (!dh) {
         return;
     }
+    // set while reading, a second pass over large trees is expensive
+    const QString parentPath = templateFi.path();
     while (true) {
         auto dirent = csync_vio_local_readdir(dh, nullptr);
         if (!dirent)
@@ -1114,10 +1223,12 @@ void FakeFolder::fromDisk(QDir &dir, FileInfo &templateFi)
             QDir subDir = dir;
             subDir.cd(dirent->path);
             FileInfo &subFi = templateFi.children[dirent->path] = FileInfo{dirent->path};
+            subFi.parentPath = parentPath;
             subFi.setLastModified(QDateTime::fromSecsSinceEpoch(dirent->modtime, QTimeZone::utc()));
             fromDisk(subDir, subFi);
         } else {
             FileInfo fi(dirent->path);
+            fi.parentPath = parentPath;
             fi.isDir = false;
             fi.fileSize = dirent->size;
             fi.isDehydratedPlaceholder = isDehydratedPlaceholder(absolutePathItem);
@@ -1138,7 +1249,7 @@ void FakeFolder::fromDisk(QDir &dir, FileInfo &templateFi)
                 fi.contentSize = fi.fileSize;
             }
 
-            templateFi.children.insert(fi.name, fi);
+            templateFi.children[dirent->path] = std::move(fi);
         }
     }
     csync_vio_local_closedir(dh);
@@ -27,6 +27,7 @@
 #include <QtTest>
 #include <cookiejar.h>
 
+#include <atomic>
 #include <chrono>
 
 using namespace OCC::FileSystem::SizeLiterals;
@@ -38,13 +39,19 @@ using namespace OCC::FileSystem::SizeLiterals;
 QString getFilePathFromUrl(const QUrl &url);
 
 
+// Etags and file ids are unique within the test process, random ids of 32 bits collide in large trees
+inline quint64 generateUniqueId()
+{
+    static std::atomic<quint64> id = 0;
+    return ++id;
+}
 inline QByteArray generateEtag()
 {
-    return QByteArray::number(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch(), 16) + QByteArray::number(QRandomGenerator::global()->generate(), 16);
+    return QByteArray::number(generateUniqueId(), 16);
 }
 inline QByteArray generateFileId()
 {
-    return QByteArray::number(QRandomGenerator::global()->generate(), 16);
+    return QByteArray::number(generateUniqueId(), 16);
 }
 
 class PathComponents : public QStringList
@@ -251,6 +258,8 @@ public:
 
     QString path() const;
     QString absolutePath() const;
+    /// The parentPath of the children of this directory
+    QString childParentPath() const;
 
     void fixupParentPathRecursively();
 
@@ -388,6 +397,21 @@ public:
     qint64 readData(char *, qint64) override { return 0; }
 };
 
+class FakeCopyReply : public FakeReply
+{
+    Q_OBJECT
+
+public:
+    FakeCopyReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
+
+    Q_INVOKABLE void respond();
+
+    qint64 readData(char *, qint64) override { return 0; }
+
+private:
+    int _httpCode = 201;
+};
+
 class FakeGetReply : public FakeReply
 {
     Q_OBJECT
@@ -451,6 +475,19 @@ public:
     QByteArray _body;
 };
 
+/// Sets the modification time of a file, the only property the client changes with a PROPPATCH
+class FakeProppatchReply : public FakePayloadReply
+{
+    Q_OBJECT
+public:
+    FakeProppatchReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &body,
+        QObject *parent);
+
+    void respond() override;
+
+private:
+    int _httpCode = 207;
+};
 
 class FakeErrorReply : public FakeReply
 {
@@ -464,6 +501,7 @@ public:
     // make public to give tests easy interface
     using QNetworkReply::setAttribute;
     using QNetworkReply::setError;
+    using QNetworkReply::setRawHeader;
 
 public Q_SLOTS:
     void slotSetFinished();
@@ -575,6 +613,7 @@ public:
     void switchToVfs(QSharedPointer<OCC::Vfs> vfs);
 
     OCC::AccountPtr account() const { return _accountState->account(); }
+    OCC::AccountState *accountState() const { return _accountState.get(); }
     OCC::SyncEngine &syncEngine() const { return *_syncEngine; }
     OCC::SyncJournalDb &syncJournal() const { return *_journalDb; }
 
@@ -6,10 +6,74 @@
 
 #include <QtTest>
 
+#include "common/utility.h"
 #include "networkjobs.h"
 
+#include <atomic>
+
 using namespace OCC;
 
+#ifdef __GLIBC__
+namespace {
+std::atomic<bool> countingAllocations = false;
+std::atomic<qint64> allocations = 0;
+}
+
+// count the allocations of the parser, operator new and the Qt containers end up here
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    if (countingAllocations) {
+        ++allocations;
+    }
+    return __libc_malloc(size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (countingAllocations) {
+        ++allocations;
+    }
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+namespace {
+// A listing of the files in /oc/remote.php/webdav/folder, without the folder itself
+QByteArray largeListing(int entries)
+{
+    QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+                         "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">";
+    for (int i = 0; i < entries; ++i) {
+        testXml += "<d:response>"
+                   "<d:href>/oc/remote.php/webdav/folder/file"
+            + QByteArray::number(i)
+            + "</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>0000"
+            + QByteArray::number(i)
+            + "ocobzus5kn6s</oc:id>"
+              "<oc:permissions>RDNVW</oc:permissions>"
+              "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652dea0\"</d:getetag>"
+              "<d:resourcetype/>"
+              "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+              "<d:getcontentlength>121780</d:getcontentlength>"
+              "<oc:checksums><oc:checksum>SHA1:2ef6cb1b8e1ed0ab9a1bfd5f9b2a7c8a6c1e1b2f</oc:checksum></oc:checksums>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>";
+    }
+    testXml += "</d:multistatus>";
+    return testXml;
+}
+}
+
 class TestXmlParse : public QObject
 {
     Q_OBJECT
@@ -118,6 +182,247 @@ private Q_SLOTS:
         QVERIFY(_subdirs.size() == 1);
     }
 
+    void testParserIncremental()
+    {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+                                   "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">"
+                                   "<d:response>"
+                                   "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>"
+                                   "<d:propstat>"
+                                   "<d:prop>"
+                                   "<oc:permissions>RDNVCK</oc:permissions>"
+                                   "<d:resourcetype>"
+                                   "<d:collection/>"
+                                   "</d:resourcetype>"
+                                   "</d:prop>"
+                                   "<d:status>HTTP/1.1 200 OK</d:status>"
+                                   "</d:propstat>"
+                                   "</d:response>"
+                                   "<d:response>"
+                                   "<d:href>/oc/remote.php/webdav/sharefolder/quitte.pdf</d:href>"
+                                   "<d:propstat>"
+                                   "<d:prop>"
+                                   "<oc:permissions>RDNVW</oc:permissions>"
+                                   "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652dea0\"</d:getetag>"
+                                   "<d:resourcetype/>"
+                                   "</d:prop>"
+                                   "<d:status>HTTP/1.1 200 OK</d:status>"
+                                   "</d:propstat>"
+                                   "<d:propstat>"
+                                   "<d:prop>"
+                                   "<oc:downloadURL/>"
+                                   "</d:prop>"
+                                   "<d:status>HTTP/1.1 404 Not Found</d:status>"
+                                   "</d:propstat>"
+                                   "</d:response>"
+                                   "</d:multistatus>";
+
+        LsColXMLParser parser;
+
+        QMap<QString, QMap<QString, QString>> properties;
+        connect(&parser, &LsColXMLParser::directoryListingSubfolders, this, &TestXmlParse::slotDirectoryListingSubFolders);
+        connect(&parser, &LsColXMLParser::directoryListingIterated, this, &TestXmlParse::slotDirectoryListingIterated);
+        connect(&parser, &LsColXMLParser::directoryListingIterated, this,
+            [&properties](const QString &item, const QMap<QString, QString> &map) { properties.insert(item, map); });
+        connect(&parser, &LsColXMLParser::finishedWithoutError, this, &TestXmlParse::slotFinishedSuccessfully);
+
+        // feed the response in small pieces, splitting elements and texts
+        const int endOfFirstResponse = testXml.indexOf("</d:response>") + int(qstrlen("</d:response>"));
+        parser.begin(nullptr, QStringLiteral("/oc/remote.php/webdav/sharefolder"));
+        for (int i = 0; i < testXml.size(); i += 7) {
+            QVERIFY(parser.addData(testXml.mid(i, 7)));
+            if (i >= endOfFirstResponse) {
+                // entries are reported as soon as they are complete
+                QVERIFY(_items.contains(QStringLiteral("/oc/remote.php/webdav/sharefolder")));
+            }
+        }
+        QVERIFY(!_success);
+        QVERIFY(parser.finish());
+        QVERIFY(_success);
+
+        QCOMPARE(_items.size(), 2);
+        QCOMPARE(properties.value(QStringLiteral("/oc/remote.php/webdav/sharefolder/quitte.pdf")).value(QStringLiteral("getetag")),
+            QStringLiteral("\"2fa2f0d9ed49ea0c3e409d49e652dea0\""));
+        QVERIFY(!properties.value(QStringLiteral("/oc/remote.php/webdav/sharefolder/quitte.pdf")).contains(QStringLiteral("downloadURL")));
+        QCOMPARE(properties.value(QStringLiteral("/oc/remote.php/webdav/sharefolder")).value(QStringLiteral("resourcetype")), QStringLiteral("<collection></collection>"));
+        QCOMPARE(_subdirs, QStringList{QStringLiteral("/oc/remote.php/webdav/sharefolder/")});
+    }
+
+    void testParserSharesRepeatedValues()
+    {
+        QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+                             "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">";
+        for (int i = 0; i < 2; ++i) {
+            testXml += "<d:response>"
+                       "<d:href>/oc/remote.php/webdav/file"
+                + QByteArray::number(i)
+                + "</d:href>"
+                  "<d:propstat>"
+                  "<d:prop>"
+                  "<oc:permissions>RDNVW</oc:permissions>"
+                  "<d:getetag>\"etag"
+                + QByteArray::number(i)
+                + "\"</d:getetag>"
+                  "</d:prop>"
+                  "<d:status>HTTP/1.1 200 OK</d:status>"
+                  "</d:propstat>"
+                  "</d:response>";
+        }
+        testXml += "</d:multistatus>";
+
+        LsColXMLParser parser;
+        QList<QMap<QString, QString>> properties;
+        connect(&parser, &LsColXMLParser::directoryListingIterated, this,
+            [&properties](const QString &, const QMap<QString, QString> &map) { properties.append(map); });
+        QVERIFY(parser.parse(testXml, nullptr, QStringLiteral("/oc/remote.php/webdav")));
+
+        QCOMPARE(properties.size(), 2);
+        QCOMPARE(properties[0].value(QStringLiteral("permissions")), QStringLiteral("RDNVW"));
+        QCOMPARE(properties[0].value(QStringLiteral("getetag")), QStringLiteral("\"etag0\""));
+        QCOMPARE(properties[1].value(QStringLiteral("getetag")), QStringLiteral("\"etag1\""));
+        // the permissions are the same string instance
+        QCOMPARE(properties[0].value(QStringLiteral("permissions")).constData(), properties[1].value(QStringLiteral("permissions")).constData());
+    }
+
+    void testParserDecodesEntries()
+    {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+                                   "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">"
+                                   "<d:response>"
+                                   "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>"
+                                   "<d:propstat>"
+                                   "<d:prop>"
+                                   "<oc:permissions>RDNVCKS</oc:permissions>"
+                                   "<oc:size>121780</oc:size>"
+                                   "<oc:share-types><oc:share-type>0</oc:share-type></oc:share-types>"
+                                   "<d:resourcetype><d:collection/></d:resourcetype>"
+                                   "<oc:data-fingerprint></oc:data-fingerprint>"
+                                   "</d:prop>"
+                                   "<d:status>HTTP/1.1 200 OK</d:status>"
+                                   "</d:propstat>"
+                                   "</d:response>"
+                                   "<d:response>"
+                                   "<d:href>/oc/remote.php/webdav/sharefolder/quitte.pdf</d:href>"
+                                   "<d:propstat>"
+                                   "<d:prop>"
+                                   "<oc:id>00004215ocobzus5kn6s</oc:id>"
+                                   "<oc:permissions>RDNVW</oc:permissions>"
+                                   "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652dea0\"</d:getetag>"
+                                   "<d:resourcetype/>"
+                                   "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+                                   "<d:getcontentlength>-5</d:getcontentlength>"
+                                   "<oc:checksums><oc:checksum>MD5:abc SHA1:def</oc:checksum></oc:checksums>"
+                                   "</d:prop>"
+                                   "<d:status>HTTP/1.1 200 OK</d:status>"
+                                   "</d:propstat>"
+                                   "<d:propstat>"
+                                   "<d:prop>"
+                                   "<oc:downloadURL>https://example.com/file</oc:downloadURL>"
+                                   "</d:prop>"
+                                   "<d:status>HTTP/1.1 404 Not Found</d:status>"
+                                   "</d:propstat>"
+                                   "</d:response>"
+                                   "</d:multistatus>";
+
+        LsColXMLParser parser;
+        parser.setDecodeEntries(true);
+        QStringList names;
+        QList<ListingEntry> entries;
+        connect(&parser, &LsColXMLParser::directoryListingIterated, this, [] { QFAIL("no property map is built"); });
+        connect(&parser, &LsColXMLParser::directoryListingEntry, this, [&](const QString &name, const ListingEntry &entry) {
+            names.append(name);
+            entries.append(entry);
+        });
+        connect(&parser, &LsColXMLParser::directoryListingSubfolders, this, &TestXmlParse::slotDirectoryListingSubFolders);
+        QVERIFY(parser.parse(testXml, nullptr, QStringLiteral("/oc/remote.php/webdav/sharefolder")));
+
+        QCOMPARE(names,
+            (QStringList{QStringLiteral("/oc/remote.php/webdav/sharefolder"), QStringLiteral("/oc/remote.php/webdav/sharefolder/quitte.pdf")}));
+        QCOMPARE(_subdirs, QStringList{QStringLiteral("/oc/remote.php/webdav/sharefolder/")});
+
+        const auto &folder = entries.at(0);
+        QVERIFY(folder.isDirectory);
+        QVERIFY(folder.isShared);
+        QVERIFY(folder.hasPermissions);
+        QVERIFY(folder.remotePerm.hasPermission(RemotePermissions::CanAddSubDirectories));
+        QCOMPARE(folder.folderSize, qint64(121780));
+        QCOMPARE(folder.size, qint64(-1));
+        QVERIFY(folder.hasDataFingerprint);
+        QVERIFY(folder.dataFingerprint.isEmpty());
+
+        const auto &file = entries.at(1);
+        QVERIFY(!file.isDirectory);
+        QVERIFY(!file.isShared);
+        QCOMPARE(file.fileId, QByteArrayLiteral("00004215ocobzus5kn6s"));
+        QCOMPARE(file.etag, QStringLiteral("2fa2f0d9ed49ea0c3e409d49e652dea0"));
+        QCOMPARE(qint64(file.modtime), Utility::parseRFC1123Date(QStringLiteral("Fri, 06 Feb 2015 13:49:55 GMT")).toSecsSinceEpoch());
+        QCOMPARE(file.size, qint64(0));
+        QCOMPARE(file.checksumHeader, QByteArrayLiteral("SHA1:def"));
+        // from the 404 propstat
+        QVERIFY(file.directDownloadUrl.isEmpty());
+        QVERIFY(!file.hasDataFingerprint);
+    }
+
+    void testDecodedEntriesAllocations()
+    {
+#ifdef __GLIBC__
+        const int entries = 1000;
+        const QByteArray testXml = largeListing(entries);
+
+        const auto countAllocations = [&](bool decode) {
+            LsColXMLParser parser;
+            parser.setDecodeEntries(decode);
+            int count = 0;
+            connect(&parser, &LsColXMLParser::directoryListingIterated, this, [&count](const QString &, const QMap<QString, QString> &) { ++count; });
+            connect(&parser, &LsColXMLParser::directoryListingEntry, this, [&count](const QString &, const ListingEntry &) { ++count; });
+            allocations = 0;
+            countingAllocations = true;
+            const bool ok = parser.parse(testXml, nullptr, QStringLiteral("/oc/remote.php/webdav/folder"));
+            countingAllocations = false;
+            return ok && count == entries ? allocations.load() : -1;
+        };
+        const qint64 mapAllocations = countAllocations(false);
+        const qint64 decodedAllocations = countAllocations(true);
+        qInfo() << "allocations per entry, property map:" << mapAllocations / entries << "decoded:" << decodedAllocations / entries;
+        QVERIFY(mapAllocations > 0);
+        QVERIFY(decodedAllocations > 0);
+        // the map still has to be decoded by its users, this only counts the parsing
+        QVERIFY(decodedAllocations * 2 < mapAllocations);
+#else
+        QSKIP("Allocations are only counted with glibc");
+#endif
+    }
+
+    void benchmarkParseLargeListing()
+    {
+        const QByteArray testXml = largeListing(10000);
+
+        QBENCHMARK {
+            LsColXMLParser parser;
+            parser.setDecodeEntries(true);
+            int count = 0;
+            connect(&parser, &LsColXMLParser::directoryListingEntry, this, [&count](const QString &, const ListingEntry &) { ++count; });
+            QVERIFY(parser.parse(testXml, nullptr, QStringLiteral("/oc/remote.php/webdav/folder")));
+            QCOMPARE(count, 10000);
+        }
+    }
+
+    void testParserIncompleteXml()
+    {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+                                   "<d:multistatus xmlns:d=\"DAV:\">"
+                                   "<d:response>"
+                                   "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>";
+
+        LsColXMLParser parser;
+        connect(&parser, &LsColXMLParser::finishedWithoutError, this, &TestXmlParse::slotFinishedSuccessfully);
+
+        parser.begin(nullptr, QStringLiteral("/oc/remote.php/webdav/sharefolder"));
+        QVERIFY(parser.addData(testXml));
+        QVERIFY(!parser.finish());
+        QVERIFY(!_success);
+    }
+
     void testParserBrokenXml()
     {
         const QByteArray testXml = "X<?xml version='1.0' encoding='utf-8'?>"